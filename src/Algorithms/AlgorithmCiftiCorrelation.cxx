@@ -30,6 +30,7 @@
 #include "CaretOMP.h"
 #include "FileInformation.h"
 #include "CaretPointer.h"
+#include "CaretProfiler.h"
 #include "dot_wrapper.h"
 #include <fstream>
 #include <utility>
@@ -38,6 +39,12 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const int TILE_ROWS = 16;//rows read at once by each thread, each one is reused against a whole block of chunk rows
+    const int CHUNK_BLOCK = 64;//chunk rows per sddotmat call, small enough that the block stays in cache while the tile is processed
+}
+
 AString AlgorithmCiftiCorrelation::getCommandSwitch()
 {
     return "-cifti-correlation";
@@ -79,13 +86,21 @@ OperationParameters* AlgorithmCiftiCorrelation::getParameters()
     OptionalParameter* memLimitOpt = ret->createOptionalParameter(6, "-mem-limit", "restrict memory usage");
     memLimitOpt->addDoubleParameter(1, "limit-GB", "memory limit in gigabytes");
     
+    OptionalParameter* int16Opt = ret->createOptionalParameter(9, "-int16", "store the output as scaled 16-bit integers, for half the file size");
+    OptionalParameter* int16RangeOpt = int16Opt->createOptionalParameter(1, "-range", "specify the range of values to store");
+    int16RangeOpt->addDoubleParameter(1, "min", "the lowest value that can be stored");
+    int16RangeOpt->addDoubleParameter(2, "max", "the highest value that can be stored");
+    
     ret->setHelpText(
         AString("For each row (or each row inside an roi if -roi-override is specified), correlate to all other rows.  ") +
         "The -cifti-roi suboption to -roi-override may not be specified with any other -*-roi suboption, but you may specify the other -*-roi suboptions together.\n\n" +
         "When using the -fisher-z option, the output is NOT a Z-score, it is artanh(r), to do further math on this output, consider using -cifti-math.\n\n" +
         "Restricting the memory usage will make it calculate the output in chunks, and if the input file size is more than 70% of the memory limit, " +
         "it will also read through the input file as rows are required, resulting in several passes through the input file (once per chunk).  " +
-        "Memory limit does not need to be an integer, you may also specify 0 to calculate a single output row at a time (this may be very slow)."
+        "Memory limit does not need to be an integer, you may also specify 0 to calculate a single output row at a time (this may be very slow).\n\n" +
+        "The -int16 option writes the output with the INT16 datatype and a scaling slope and intercept in the nifti header, which is read back as floating point by any program that follows the nifti standard.  " +
+        "By default, the stored range is -1 to 1, or the full range of the -fisher-z output, which gives a precision of roughly 0.00003 or 0.0002, respectively.  " +
+        "When using -covariance, you must specify the -range suboption, and values outside the range are clamped to it."
     );
     return ret;
 }
@@ -174,13 +189,33 @@ void AlgorithmCiftiCorrelation::useParameters(OperationParameters* myParams, Pro
     }
     bool noDemean = myParams->getOptionalParameter(7)->m_present;
     bool covariance = myParams->getOptionalParameter(8)->m_present;
+    OptionalParameter* int16Opt = myParams->getOptionalParameter(9);
+    if (int16Opt->m_present)
+    {
+        double minval = -1.0, maxval = 1.0;
+        if (fisherZ)
+        {
+            maxval = 0.5 * log((1 + 0.999999) / (1 - 0.999999));//same clamping as finishCorrelation
+            minval = -maxval;
+        }
+        OptionalParameter* int16RangeOpt = int16Opt->getOptionalParameter(1);
+        if (int16RangeOpt->m_present)
+        {
+            minval = int16RangeOpt->getDouble(1);
+            maxval = int16RangeOpt->getDouble(2);
+            if (!(minval < maxval)) throw AlgorithmException("-range minimum must be less than maximum");
+        } else {
+            if (covariance) throw AlgorithmException("-int16 with -covariance requires the -range suboption");
+        }
+        myCiftiOut->setWritingDataTypeAndScaling(NIFTI_TYPE_INT16, minval, maxval);//must happen before the algorithm starts writing rows
+    }
     if (roiOverrideMode)
     {
         if (ciftiRoiMode)
         {
-            AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, ciftiRoi, weights, fisherZ, memLimitGB, noDemean);
+            AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, ciftiRoi, weights, fisherZ, memLimitGB, noDemean, covariance);
         } else {
-            AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, leftRoi, rightRoi, cerebRoi, volRoi, weights, fisherZ, memLimitGB, noDemean);
+            AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, leftRoi, rightRoi, cerebRoi, volRoi, weights, fisherZ, memLimitGB, noDemean, covariance);
         }
     } else {
         AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, weights, fisherZ, memLimitGB, noDemean, covariance);
@@ -216,6 +251,7 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
         CaretLogInfo("computing " + AString::number(numCacheRows) + " rows at a time, reading rows as needed during processing");
     }
     vector<CaretArray<float> > outRows;
+    vector<int> chunkRows;
     if (cacheFullInput)
     {
         for (int i = 0; i < numRows; ++i)
@@ -228,6 +264,7 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
         int endrow = startrow + numCacheRows;
         if (endrow > numRows) endrow = numRows;
         outRows.resize(endrow - startrow);
+        chunkRows.resize(endrow - startrow);
         for (int i = startrow; i < endrow; ++i)
         {
             if (!cacheFullInput)
@@ -238,38 +275,9 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             {
                 outRows[i - startrow] = CaretArray<float>(numRows);
             }
+            chunkRows[i - startrow] = i;
         }
-        int curRow = 0;//because we can't trust the order threads hit the critical section
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < numRows; ++i)
-        {
-            float movingRrs;
-            int myrow;
-            const float* movingRow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myrow, movingRrs);
-            }
-            for (int j = startrow; j < endrow; ++j)
-            {
-                if (myrow >= startrow && myrow < endrow)//check whether we are in the output memory area
-                {
-                    if (j >= myrow)//if so, only compute one half, and store both places
-                    {
-                        float cacheRrs;
-                        const float* cacheRow = getRow(j, cacheRrs, true);
-                        outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                        outRows[myrow - startrow][j] = outRows[j - startrow][myrow];
-                    }
-                } else {
-                    float cacheRrs;
-                    const float* cacheRow = getRow(j, cacheRrs, true);
-                    outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                }
-            }
-        }
+        computeChunk(chunkRows, outRows, fisherZ);
         for (int i = startrow; i < endrow; ++i)
         {
             myCiftiOut->setRow(outRows[i - startrow], i);
@@ -402,6 +410,7 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
         CaretLogInfo("computing " + AString::number(numCacheRows) + " rows at a time, reading rows as needed during processing");
     }
     vector<CaretArray<float> > outRows;
+    vector<int> chunkRows;
     if (cacheFullInput)
     {
         for (int i = 0; i < numRows; ++i)
@@ -409,13 +418,12 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             cacheRow(i);
         }
     }
-    CaretArray<int> indexReverse(numRows, -1);
     for (int startrow = 0; startrow < numSelected; startrow += numCacheRows)
     {
         int endrow = startrow + numCacheRows;
         if (endrow > numSelected) endrow = numSelected;
         outRows.resize(endrow - startrow);
-        int curRow = 0;//because we can't trust the order threads hit the critical section
+        chunkRows.resize(endrow - startrow);
         for (int i = startrow; i < endrow; ++i)
         {
             if (!cacheFullInput)
@@ -426,42 +434,12 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             {
                 outRows[i - startrow] = CaretArray<float>(numRows);
             }
-            indexReverse[ciftiIndexList[i].first] = i;
-        }
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < numRows; ++i)
-        {
-            float movingRrs;
-            int myrow;
-            const float* movingRow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myrow, movingRrs);
-            }
-            for (int j = startrow; j < endrow; ++j)
-            {
-                if (indexReverse[myrow] != -1)//check if we are on a row that is in the output memory range
-                {
-                    if (indexReverse[myrow] <= j)//if so, only compute one of the elements, then store it both places
-                    {
-                        float cacheRrs;
-                        const float* cacheRow = getRow(ciftiIndexList[j].first, cacheRrs, true);
-                        outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                        outRows[indexReverse[myrow] - startrow][ciftiIndexList[j].first] = outRows[j - startrow][myrow];
-                    }
-                } else {
-                    float cacheRrs;
-                    const float* cacheRow = getRow(ciftiIndexList[j].first, cacheRrs, true);
-                    outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                }
-            }
+            chunkRows[i - startrow] = ciftiIndexList[i].first;
         }
+        computeChunk(chunkRows, outRows, fisherZ);
         for (int i = startrow; i < endrow; ++i)
         {
             myCiftiOut->setRow(outRows[i - startrow], ciftiIndexList[i].second);
-            indexReverse[ciftiIndexList[i].first] = -1;
         }
         if (!cacheFullInput)
         {
@@ -517,17 +495,85 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
     AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, leftRoiPtr, rightRoiPtr, cerebRoiPtr, volRoiPtr, weights, fisherZ, memLimitGB, noDemean, covariance);//HACK: pass through our progress object
 }
 
-float AlgorithmCiftiCorrelation::correlate(const float* row1, const float& rrs1, const float* row2, const float& rrs2, const bool& fisherZ)
-{
+void AlgorithmCiftiCorrelation::computeChunk(const vector<int>& chunkRows, vector<CaretArray<float> >& outRows, const bool& fisherZ)
+{//outRows[i][j] gets the correlation of row chunkRows[i] with row j, chunk rows must be cached
+    CaretProfileScope profileScope("correlation chunk");
+    CaretProfiler::addCounter("openmp regions");
+    const int numRows = m_inputCifti->getNumberOfRows(), numChunk = (int)chunkRows.size();
+    const int dotLength = (m_weightedMode ? (int)m_weightIndexes.size() : m_numCols);//weighted mode compacts the rows to only nonzero weights
+    vector<const float*> chunkPtrs(numChunk);
+    vector<float> chunkRrs(numChunk);
+    for (int i = 0; i < numChunk; ++i)
+    {
+        chunkPtrs[i] = getRow(chunkRows[i], chunkRrs[i], true);
+    }
+    vector<int> chunkIndex(numRows, -1);//which chunk row each cifti row is, so the part of the output that is symmetric is only computed once
+    for (int i = 0; i < numChunk; ++i)
+    {
+        chunkIndex[chunkRows[i]] = i;
+    }
+    const int numTiles = (numRows + TILE_ROWS - 1) / TILE_ROWS;
+#pragma omp CARET_PAR
+    {
+        vector<double> dots(TILE_ROWS * CHUNK_BLOCK);
+        const float* tilePtrs[TILE_ROWS];
+        float tileRrs[TILE_ROWS];
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int tile = 0; tile < numTiles; ++tile)
+        {//CiftiFile reading is thread-safe and doesn't lock for on-disk files, and dynamic scheduling still requests rows in nearly sequential order
+            const int tileStart = tile * TILE_ROWS, tileSize = min(TILE_ROWS, numRows - tileStart);
+            int tileMinIndex = numChunk;//lowest chunk index in the tile, -1 if any tile row is outside the chunk
+            for (int i = 0; i < tileSize; ++i)
+            {
+                tilePtrs[i] = getRow(tileStart + i, tileRrs[i], false, i);
+                if (chunkIndex[tileStart + i] == -1 || tileMinIndex == -1)
+                {
+                    tileMinIndex = -1;
+                } else {
+                    tileMinIndex = min(tileMinIndex, chunkIndex[tileStart + i]);
+                }
+            }
+            //block over the chunk rows too, so the block stays in cache while the whole tile uses it
+            for (int blockStart = 0; blockStart < numChunk; blockStart += CHUNK_BLOCK)
+            {
+                const int blockSize = min(CHUNK_BLOCK, numChunk - blockStart);
+                if (tileMinIndex >= blockStart + blockSize) continue;//whole block is below the diagonal, those get stored by the threads with the other rows
+                sddotmat(tilePtrs, tileSize, chunkPtrs.data() + blockStart, blockSize, dotLength, dots.data(), CHUNK_BLOCK);//same result as sddot
+                for (int i = 0; i < tileSize; ++i)
+                {
+                    const int myrow = tileStart + i, myIndex = chunkIndex[myrow];
+                    for (int j = 0; j < blockSize; ++j)
+                    {
+                        if (myIndex != -1)//check whether we are in the output memory area
+                        {
+                            if (blockStart + j >= myIndex)//if so, only compute one half, and store both places
+                            {
+                                float value = finishCorrelation(dots[i * CHUNK_BLOCK + j], tileRrs[i], chunkRrs[blockStart + j],
+                                                                chunkRows[blockStart + j] == myrow, fisherZ);
+                                outRows[blockStart + j][myrow] = value;
+                                outRows[myIndex][chunkRows[blockStart + j]] = value;
+                            }
+                        } else {
+                            outRows[blockStart + j][myrow] = finishCorrelation(dots[i * CHUNK_BLOCK + j], tileRrs[i], chunkRrs[blockStart + j],
+                                                                               false, fisherZ);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+float AlgorithmCiftiCorrelation::finishCorrelation(const double& accum, const float& rrs1, const float& rrs2, const bool& sameRow, const bool& fisherZ)
+{//accum is the dot product of the two demeaned (and weighted) rows
     double r;
-    if (row1 == row2 && !m_covariance)
+    if (sameRow && !m_covariance)
     {
         r = 1.0;//short circuit for same row
     } else {
         if (m_weightedMode)
         {
             int numWeights = (int)m_weightIndexes.size();//because we compacted the data in the row to not include any zero weights
-            double accum = sddot(row1, row2, numWeights);//these have already had the weighted row means subtracted out, and weights applied
             if (m_covariance)
             {
                 if (m_binaryWeights)
@@ -537,10 +583,9 @@ float AlgorithmCiftiCorrelation::correlate(const float* row1, const float& rrs1,
                     r = accum / rrs1;//NOTE: will equal rrs2 as it only depends on weights, and is not square root
                 }
             } else {
-                r = accum / (rrs1 * rrs2);//as do these
+                r = accum / (rrs1 * rrs2);
             }
         } else {
-            double accum = sddot(row1, row2, m_numCols);//these have already had the row means subtracted out
             if (m_covariance)
             {
                 r = accum / m_numCols;
@@ -572,6 +617,13 @@ void AlgorithmCiftiCorrelation::init(const CiftiFile* input, const vector<float>
     m_rowInfo.resize(m_inputCifti->getNumberOfRows());
     m_cacheUsed = 0;
     m_numCols = m_inputCifti->getNumberOfColumns();
+#ifdef CARET_OMP
+    m_tempRows.resize(omp_get_max_threads());//allocate temp rows up front, so getTempRow never resizes inside the parallel loop
+    for (int i = 0; i < (int)m_tempRows.size(); ++i)
+    {
+        m_tempRows[i] = CaretArray<float>(TILE_ROWS * m_numCols);
+    }
+#endif
     if (weights != NULL)
     {
         m_weightedMode = true;
@@ -638,7 +690,7 @@ void AlgorithmCiftiCorrelation::clearCache()
     m_cacheUsed = 0;
 }
 
-const float* AlgorithmCiftiCorrelation::getRow(const int& ciftiIndex, float& rootResidSqr, const bool& mustBeCached)
+const float* AlgorithmCiftiCorrelation::getRow(const int& ciftiIndex, float& rootResidSqr, const bool& mustBeCached, const int& tempIndex)
 {
     float* ret;
     CaretAssertVectorIndex(m_rowInfo, ciftiIndex);
@@ -651,7 +703,7 @@ const float* AlgorithmCiftiCorrelation::getRow(const int& ciftiIndex, float& roo
         {
             throw AlgorithmException("something very bad happened, notify the developers");
         }
-        ret = getTempRow();
+        ret = getTempRow(tempIndex);
         m_inputCifti->getRow(ret, ciftiIndex);
         if (!m_rowInfo[ciftiIndex].m_haveCalculated)
         {
@@ -710,7 +762,7 @@ void AlgorithmCiftiCorrelation::computeRowStats(const float* row, float& mean, f
             {
                 accum += m_weights[i];
             }
-            rootResidSqr = accum;//repurpose this variable to store the weight sum - NOTE: don't take sqrt in case negative sum (whatever that means), so must not divide by both in correlate() in covariance mode
+            rootResidSqr = accum;//repurpose this variable to store the weight sum - NOTE: don't take sqrt in case negative sum (whatever that means), so must not divide by both in finishCorrelation() in covariance mode
         }
     } else {
         if (m_weightedMode)
@@ -769,8 +821,9 @@ void AlgorithmCiftiCorrelation::doSubtract(float* row, const float& mean)
     }
 }
 
-float* AlgorithmCiftiCorrelation::getTempRow()
-{
+float* AlgorithmCiftiCorrelation::getTempRow(const int& tempIndex)
+{//each thread gets a tile of rows, so computeChunk can have a tile of uncached rows at once
+    CaretAssert(tempIndex >= 0 && tempIndex < TILE_ROWS);
 #ifdef CARET_OMP
     int oldsize = (int)m_tempRows.size();
     int threadNum = omp_get_thread_num();
@@ -779,17 +832,17 @@ float* AlgorithmCiftiCorrelation::getTempRow()
         m_tempRows.resize(threadNum + 1);
         for (int i = oldsize; i <= threadNum; ++i)
         {
-            m_tempRows[i] = CaretArray<float>(m_numCols);
+            m_tempRows[i] = CaretArray<float>(TILE_ROWS * m_numCols);
         }
     }
-    return m_tempRows[threadNum].getArray();
+    return m_tempRows[threadNum].getArray() + tempIndex * m_numCols;
 #else
     if (m_tempRows.size() == 0)
     {
         m_tempRows.resize(1);
-        m_tempRows[0] = CaretArray<float>(m_numCols);
+        m_tempRows[0] = CaretArray<float>(TILE_ROWS * m_numCols);
     }
-    return m_tempRows[0].getArray();
+    return m_tempRows[0].getArray() + tempIndex * m_numCols;
 #endif
 }
 
@@ -800,9 +853,9 @@ int AlgorithmCiftiCorrelation::numRowsForMem(const float& memLimitGB, bool& cach
     int64_t targetBytes = (int64_t)(memLimitGB * 1024 * 1024 * 1024);
     if (m_inputCifti->isInMemory()) targetBytes -= numRows * m_numCols * 4;//count in-memory input against the total too
 #ifdef CARET_OMP
-    targetBytes -= inrowBytes * omp_get_max_threads();
+    targetBytes -= (inrowBytes * TILE_ROWS + sizeof(double) * TILE_ROWS * CHUNK_BLOCK) * omp_get_max_threads();
 #else
-    targetBytes -= inrowBytes;//1 row in memory that isn't a reference to cache
+    targetBytes -= inrowBytes * TILE_ROWS + sizeof(double) * TILE_ROWS * CHUNK_BLOCK;//1 tile of rows in memory that aren't references to cache, and its dot products
 #endif
     targetBytes -= numRows * sizeof(RowInfo);//storage for mean, stdev, and info about caching
     int64_t perRowBytes = inrowBytes + outrowBytes;//cache and memory collation for output rows
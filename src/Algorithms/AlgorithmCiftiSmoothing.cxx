@@ -84,7 +84,8 @@ OperationParameters* AlgorithmCiftiSmoothing::getParameters()
         "for the reduction of structure in a group average surface.  It is better to smooth the data on individuals before averaging, when feasible.\n\n" +
         "The -fix-zeros-* options will treat values of zero as lack of data, and not use that value when generating the smoothed values, but will fill zeros with extrapolated values.  " +
         "The ROI should have a brain models mapping along columns, exactly matching the mapping of the chosen direction in the input file.  " +
-        "Data outside the ROI is ignored."
+        "Data outside the ROI is ignored.\n\n" +
+        "The -resample-cache global option also saves the surface smoothing weights, so smoothing on the same surfaces with the same kernel and ROI again skips computing them."
     );
     return ret;
 }
@@ -83,6 +83,16 @@ AlgorithmCiftiTranspose::AlgorithmCiftiTranspose(ProgressObject* myProgObj, cons
     outXML.setMap(1, *(inXML.getMap(0)));
     ciftiOut->setCiftiXML(outXML);
     int rowSize = outXML.getDimensionLength(CiftiXML::ALONG_ROW), colSize = outXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
+    if (ciftiIn->hasColumnSidecar())
+    {//input columns are contiguous on disk, so just copy them
+        vector<float> scratchRow(rowSize);
+        for (int i = 0; i < colSize; ++i)
+        {
+            ciftiIn->getColumn(scratchRow.data(), i);
+            ciftiOut->setRow(scratchRow.data(), i);
+        }
+        return;
+    }
     int64_t outRowBytes = rowSize * sizeof(float);
     int numCacheRows = colSize;
     if (memLimitGB >= 0.0f)
@@ -135,9 +135,11 @@ AlgorithmFiberDotProducts::AlgorithmFiberDotProducts(ProgressObject* myProgObj,
         myFSampOut->setColumnName(i, "Fiber " + AString::number(i + 1) + " population mean f");
     }
     const float* coordData = mySurf->getCoordinateData();
+    vector<int64_t> closestSample(numNodes);
+    myLocator.closestPoints(coordData, numNodes, closestSample.data());
     for (int i = 0; i < numNodes; ++i)
     {
-        int closest = myLocator.closestPoint(coordData + i * 3);
+        int64_t closest = closestSample[i];
         if (closest != -1)
         {
             myFibers->getRow(rowScratch.data(), coordIndices[closest]);
@@ -155,7 +155,7 @@ AlgorithmMetricFalseCorrelation::AlgorithmMetricFalseCorrelation(ProgressObject*
                 counter = 0;
                 for (set<LocatorInfo>::iterator iter = inRange.begin(); iter != inRange.end(); ++iter)
                 {
-                    if (roiCol == NULL || (roiCol[iter->index] > 0.0f))
+                    if ((roiCol == NULL || (roiCol[iter->index] > 0.0f)) && geoDists[counter] >= 0.0f)//-1 means not connected to n on the surface, so it is neither a neighbor nor a crossing
                     {
                         float dist3D = (myCoord - iter->coords).length();
                         if (iter->index == n || geoDists[counter] / dist3D < distRatioCutoff)
@@ -22,6 +22,8 @@
 #include "AlgorithmException.h"
 
 #include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "ClusterHelper.h"
 #include "GeodesicHelper.h"
 #include "MetricFile.h"
 #include "SurfaceFile.h"
@@ -152,12 +154,12 @@ namespace
         double area;
     };
     
-    void processColumn(const float* data, const float* roiData, const float* nodeAreas, TopologyHelper* myTopoHelp, GeodesicHelper* myGeoHelp,
-                       const float& threshVal, const float& minArea, const bool& lessThan, const float& areaRatio, const float& distanceCutoff,
-                       float* outData, int& markVal)
+    void findColumnClusters(const float* data, const float* roiData, const ClusterHelper& myClusterHelp, GeodesicHelper* myGeoHelp,
+                            const float& threshVal, const float& minArea, const bool& lessThan, const float& areaRatio, const float& distanceCutoff,
+                            ClusterHelper::Workspace& myWork, vector<Cluster>& clusters)
     {
-        int numNodes = myTopoHelp->getNumberOfNodes();
-        vector<int> marked(numNodes, 0);
+        int numNodes = (int)myClusterHelp.getNumberOfElements();
+        vector<char> marked(numNodes, 0);
         if (lessThan)
         {
             for (int i = 0; i < numNodes; ++i)
@@ -176,41 +178,25 @@ namespace
                 }
             }
         }
-        vector<Cluster> clusters;
+        ClusterHelper::ClusterList allClusters;
+        myClusterHelp.findClusters(marked.data(), allClusters, myWork);
+        clusters.clear();
         float biggestSize = 0.0f;
         int biggestCluster = -1;
-        for (int i = 0; i < numNodes; ++i)
+        int64_t numFound = allClusters.getNumberOfClusters();
+        for (int64_t c = 0; c < numFound; ++c)
         {
-            if (marked[i])
+            if (allClusters.m_sizes[c] > minArea)
             {
                 Cluster newCluster;
-                newCluster.members.push_back(i);
-                marked[i] = 0;//unmark it when added to list to prevent multiples
-                for (int index = 0; index < (int)newCluster.members.size(); ++index)//NOTE: vector grows inside loop
+                newCluster.area = allClusters.m_sizes[c];
+                newCluster.members.assign(allClusters.m_members.begin() + allClusters.m_memberStart[c], allClusters.m_members.begin() + allClusters.m_memberStart[c + 1]);
+                if (newCluster.area > biggestSize)
                 {
-                    int node = newCluster.members[index];//keep list around so we can put it into the output immediately if it is large enough
-                    newCluster.area += nodeAreas[node];
-                    const vector<int32_t>& neighbors = myTopoHelp->getNodeNeighbors(node);
-                    int numNeigh = (int)neighbors.size();
-                    for (int n = 0; n < numNeigh; ++n)
-                    {
-                        const int32_t& neighbor = neighbors[n];
-                        if (marked[neighbor])
-                        {
-                            newCluster.members.push_back(neighbor);
-                            marked[neighbor] = 0;
-                        }
-                    }
-                }
-                if (newCluster.area > minArea)
-                {
-                    if (newCluster.area > biggestSize)
-                    {
-                        biggestSize = newCluster.area;
-                        biggestCluster = (int)clusters.size();
-                    }
-                    clusters.push_back(newCluster);
+                    biggestSize = newCluster.area;
+                    biggestCluster = (int)clusters.size();
                 }
+                clusters.push_back(newCluster);
             }
         }
         vector<int32_t> pathScratch;
@@ -248,6 +234,10 @@ namespace
                 }
             }
         }
+    }
+    
+    void markClusters(const vector<Cluster>& clusters, float* outData, int& markVal)
+    {//separate from finding, because the mark values depend on how many clusters the previous columns had
         for (size_t i = 0; i < clusters.size(); ++i)
         {
             if (markVal == 0)
@@ -303,40 +293,54 @@ AlgorithmMetricFindClusters::AlgorithmMetricFindClusters(ProgressObject* myProgO
         nodeAreas = myAreas->getValuePointerForColumn(0);
     }
     CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();
-    CaretPointer<GeodesicHelper> myGeoHelp;
+    ClusterHelper myClusterHelp(myTopoHelp, nodeAreas);
     CaretPointer<GeodesicHelperBase> myGeoBase;
-    if (distanceCutoff > 0.0f)//geodesic is only needed for distance cutoff
+    if (distanceCutoff > 0.0f && myAreas != NULL)//geodesic is only needed for distance cutoff
     {
-        if (myAreas == NULL)
-        {
-            myGeoHelp = mySurf->getGeodesicHelper();
-        } else {
-            myGeoBase.grabNew(new GeodesicHelperBase(mySurf, myAreas->getValuePointerForColumn(0)));
-            myGeoHelp.grabNew(new GeodesicHelper(myGeoBase));
-        }
+        myGeoBase.grabNew(new GeodesicHelperBase(mySurf, myAreas->getValuePointerForColumn(0)));
     }
-    vector<int> toSearch;
-    int markVal = startVal;//give each cluster a different value, including across maps
+    vector<int> columnList;
     if (columnNum == -1)
     {
-        myMetricOut->setNumberOfNodesAndColumns(numNodes, numCols);
-        myMetricOut->setStructure(mySurf->getStructure());
         for (int c = 0; c < numCols; ++c)
         {
-            myMetricOut->setColumnName(c, myMetric->getColumnName(c));
-            vector<float> outData(numNodes, 0.0f);
-            const float* data = myMetric->getValuePointerForColumn(c);
-            processColumn(data, roiData, nodeAreas, myTopoHelp, myGeoHelp, threshVal, minArea, lessThan, areaRatio, distanceCutoff, outData.data(), markVal);
-            myMetricOut->setValuesForColumn(c, outData.data());
+            columnList.push_back(c);
         }
     } else {
-        myMetricOut->setNumberOfNodesAndColumns(numNodes, 1);
-        myMetricOut->setStructure(mySurf->getStructure());
-        myMetricOut->setColumnName(0, myMetric->getColumnName(columnNum));
-        vector<float> outData(numNodes, 0.0f);
-        const float* data = myMetric->getValuePointerForColumn(columnNum);
-        processColumn(data, roiData, nodeAreas, myTopoHelp, myGeoHelp, threshVal, minArea, lessThan, areaRatio, distanceCutoff, outData.data(), markVal);
-        myMetricOut->setValuesForColumn(0, outData.data());
+        columnList.push_back(columnNum);
+    }
+    int numOutCols = (int)columnList.size();
+    vector<vector<Cluster> > columnClusters(numOutCols);
+#pragma omp CARET_PAR
+    {
+        ClusterHelper::Workspace myWork;
+        CaretPointer<GeodesicHelper> myGeoHelp;//geodesic helpers aren't thread safe, so each thread gets its own
+        if (distanceCutoff > 0.0f)
+        {
+            if (myGeoBase != NULL)
+            {
+                myGeoHelp.grabNew(new GeodesicHelper(myGeoBase));
+            } else {
+                mySurf->getGeodesicHelper(myGeoHelp);
+            }
+        }
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int i = 0; i < numOutCols; ++i)
+        {
+            findColumnClusters(myMetric->getValuePointerForColumn(columnList[i]), roiData, myClusterHelp, myGeoHelp, threshVal, minArea, lessThan, areaRatio, distanceCutoff,
+                               myWork, columnClusters[i]);
+        }
+    }
+    myMetricOut->setNumberOfNodesAndColumns(numNodes, numOutCols);
+    myMetricOut->setStructure(mySurf->getStructure());
+    int markVal = startVal;//give each cluster a different value, including across maps
+    vector<float> outData(numNodes);
+    for (int i = 0; i < numOutCols; ++i)
+    {
+        myMetricOut->setColumnName(i, myMetric->getColumnName(columnList[i]));
+        outData.assign(numNodes, 0.0f);
+        markClusters(columnClusters[i], outData.data(), markVal);
+        myMetricOut->setValuesForColumn(i, outData.data());
     }
     if (endVal != NULL) *endVal = markVal;
 }
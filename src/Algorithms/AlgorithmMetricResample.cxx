@@ -203,10 +203,12 @@ AlgorithmMetricResample::AlgorithmMetricResample(ProgressObject* myProgObj, cons
         if (largest)
         {
             myHelp.resampleLargest(metricIn->getValuePointerForColumn(i), colScratch.data());
-        } else {
-            myHelp.resampleNormal(metricIn->getValuePointerForColumn(i), colScratch.data());
+            metricOut->setValuesForColumn(i, colScratch.data());
         }
-        metricOut->setValuesForColumn(i, colScratch.data());
+    }
+    if (!largest)
+    {
+        myHelp.resampleMetric(metricIn, metricOut);
     }
 }
 
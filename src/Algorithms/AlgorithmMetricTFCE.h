@@ -23,15 +23,14 @@
 
 #include "AbstractAlgorithm.h"
 
+#include "TFCEHelper.h"
+
 namespace caret {
     
-    class TopologyHelper;
-    
     class AlgorithmMetricTFCE : public AbstractAlgorithm
     {
         AlgorithmMetricTFCE();
-        void processColumn(const SurfaceFile* mySurf, const float* colData, float* outData, const float* roiData, const float& param_e, const float& param_h, const float* areaData);
-        void tfce_pos(TopologyHelper* myHelper, const float* colData, double* accumData, const float* roiData, const float& param_e, const float& param_h, const float* areaData);
+        void processColumn(const TFCEHelper& myTFCE, const float* colData, float* outData, const float* roiData, const float& param_e, const float& param_h, TFCEHelper::Workspace& myWork);
     protected:
         static float getSubAlgorithmWeight();
         static float getAlgorithmInternalWeight();
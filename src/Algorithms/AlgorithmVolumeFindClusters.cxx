@@ -23,10 +23,11 @@
 
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "CaretPointer.h"
 #include "CaretPointLocator.h"
+#include "ClusterHelper.h"
 #include "VolumeFile.h"
-#include "VoxelIJK.h"
 
 #include <cmath>
 #include <vector>
@@ -135,23 +136,16 @@ void AlgorithmVolumeFindClusters::useParameters(OperationParameters* myParams, P
 
 namespace
 {
-    void processSubvol(const float* inFrame, VolumeFile* volOut, const int64_t& outSubvol, const int64_t& outComponent, const float& threshValue, const float& minVolume,
-                       const bool& lessThan, const float* roiFrame, const float& sizeRatio, const float& distanceCutoff, int& markVal)
+    void findFrameClusters(const float* inFrame, const VolumeSpace& mySpace, const ClusterHelper& myClusterHelp, const float& threshValue, const float& minVolume,
+                           const bool& lessThan, const float* roiFrame, const float& sizeRatio, const float& distanceCutoff, ClusterHelper::Workspace& myWork,
+                           vector<vector<int64_t> >& clusters)
     {
-        vector<int64_t> dims = volOut->getDimensions();
+        const int64_t* dims = mySpace.getDims();
         int64_t frameSize = dims[0] * dims[1] * dims[2];
-        const VolumeSpace& mySpace = volOut->getVolumeSpace();
         Vector3D ivec, jvec, kvec, origin;
         mySpace.getSpacingVectors(ivec, jvec, kvec, origin);
         float voxelVolume = abs(ivec.dot(jvec.cross(kvec)));
         int64_t minVoxels = (int64_t)ceil(minVolume / voxelVolume);
-        vector<VoxelIJK> neighbors;
-        neighbors.push_back(VoxelIJK(1, 0, 0));
-        neighbors.push_back(VoxelIJK(-1, 0, 0));
-        neighbors.push_back(VoxelIJK(0, 1, 0));
-        neighbors.push_back(VoxelIJK(0, -1, 0));
-        neighbors.push_back(VoxelIJK(0, 0, 1));
-        neighbors.push_back(VoxelIJK(0, 0, -1));
         vector<char> marked(frameSize, 0);
         if (lessThan)
         {
@@ -171,51 +165,23 @@ namespace
                 }
             }
         }
-        vector<vector<VoxelIJK> > clusters;
+        ClusterHelper::ClusterList allClusters;
+        myClusterHelp.findClusters(marked.data(), allClusters, myWork);
+        clusters.clear();
         size_t biggestCount = 0;
         int64_t biggestCluster = -1;
-        for (int64_t k = 0; k < dims[2]; ++k)
+        int64_t numFound = allClusters.getNumberOfClusters();
+        for (int64_t c = 0; c < numFound; ++c)
         {
-            for (int64_t j = 0; j < dims[1]; ++j)
+            size_t thisCount = (size_t)(allClusters.m_memberStart[c + 1] - allClusters.m_memberStart[c]);
+            if ((int64_t)thisCount >= minVoxels)
             {
-                for (int64_t i = 0; i < dims[0]; ++i)
+                if (thisCount > biggestCount)
                 {
-                    int64_t myIndex = mySpace.getIndex(i, j, k);
-                    if (marked[myIndex])
-                    {
-                        vector<VoxelIJK> voxelList;
-                        voxelList.push_back(VoxelIJK(i, j, k));
-                        marked[myIndex] = 0;//don't let voxels get duplicated in the list
-                        for (int64_t index = 0; index < (int64_t)voxelList.size(); ++index)//NOTE: vector grows inside loop
-                        {
-                            const VoxelIJK& thisVoxel = voxelList[index];
-                            for (int n = 0; n < (int)neighbors.size(); ++n)
-                            {
-                                VoxelIJK neighVox(thisVoxel.m_ijk[0] + neighbors[n].m_ijk[0],
-                                                    thisVoxel.m_ijk[1] + neighbors[n].m_ijk[1],
-                                                    thisVoxel.m_ijk[2] + neighbors[n].m_ijk[2]);
-                                if (mySpace.indexValid(neighVox.m_ijk))
-                                {
-                                    int64_t neighIndex = mySpace.getIndex(neighVox.m_ijk);
-                                    if (marked[neighIndex])
-                                    {
-                                        voxelList.push_back(neighVox);
-                                        marked[neighIndex] = 0;
-                                    }
-                                }
-                            }
-                        }
-                        if ((int64_t)voxelList.size() >= minVoxels)
-                        {
-                            if (voxelList.size() > biggestCount)
-                            {
-                                biggestCount = voxelList.size();
-                                biggestCluster = (int64_t)clusters.size();
-                            }
-                            clusters.push_back(voxelList);
-                        }
-                    }
+                    biggestCount = thisCount;
+                    biggestCluster = (int64_t)clusters.size();
                 }
+                clusters.push_back(vector<int64_t>(allClusters.m_members.begin() + allClusters.m_memberStart[c], allClusters.m_members.begin() + allClusters.m_memberStart[c + 1]));
             }
         }
         if (!clusters.empty()) CaretAssert(biggestCluster != -1);
@@ -229,7 +195,8 @@ namespace
                 for (size_t i = 0; i < clusters[biggestCluster].size(); ++i)
                 {
                     float thisCoord[3];
-                    mySpace.indexToSpace(clusters[biggestCluster][i].m_ijk, thisCoord);
+                    int64_t index = clusters[biggestCluster][i];
+                    mySpace.indexToSpace(index % dims[0], (index / dims[0]) % dims[1], index / (dims[0] * dims[1]), thisCoord);
                     biggestCoords.push_back(thisCoord[0]);
                     biggestCoords.push_back(thisCoord[1]);
                     biggestCoords.push_back(thisCoord[2]);
@@ -251,7 +218,8 @@ namespace
                         for (size_t j = 0; j < clusters[i].size(); ++j)
                         {
                             float thisCoord[3];
-                            mySpace.indexToSpace(clusters[i][j].m_ijk, thisCoord);
+                            int64_t index = clusters[i][j];
+                            mySpace.indexToSpace(index % dims[0], (index / dims[0]) % dims[1], index / (dims[0] * dims[1]), thisCoord);
                             int32_t ret = myLocator->closestPointLimited(thisCoord, distanceCutoff);
                             if (ret == -1)
                             {
@@ -269,6 +237,10 @@ namespace
                 }
             }
         }
+    }
+    
+    void markClusters(const vector<vector<int64_t> >& clusters, float* outFrame, int& markVal)
+    {//separate from finding, because the mark values depend on how many clusters the previous frames had
         for (size_t i = 0; i < clusters.size(); ++i)
         {
             if (markVal == 0)
@@ -280,7 +252,7 @@ namespace
             if ((int)tempVal != markVal) throw AlgorithmException("too many clusters, unable to mark them uniquely");
             for (size_t index = 0; index < clusters[i].size(); ++index)
             {
-                volOut->setValue(tempVal, clusters[i][index].m_ijk, outSubvol, outComponent);
+                outFrame[clusters[i][index]] = tempVal;
             }
             ++markVal;
         }
@@ -304,30 +276,46 @@ AlgorithmVolumeFindClusters::AlgorithmVolumeFindClusters(ProgressObject* myProgO
         roiFrame = myRoi->getFrame();
     }
     vector<int64_t> dims = volIn->getDimensions();
-    int markVal = startVal;
+    vector<int64_t> subvolList;
     if (subvolNum == -1)
     {
-        volOut->reinitialize(volIn->getOriginalDimensions(), volIn->getSform(), dims[4]);
-        volOut->setValueAllVoxels(0.0f);
-        for (int64_t c = 0; c < dims[4]; ++c)
+        for (int64_t s = 0; s < dims[3]; ++s)
         {
-            for (int64_t s = 0; s < dims[3]; ++s)
-            {
-                const float* inFrame = volIn->getFrame(s, c);
-                processSubvol(inFrame, volOut, s, c, threshValue, minVolume, lessThan, roiFrame, sizeRatio, distanceCutoff, markVal);
-            }
+            subvolList.push_back(s);
         }
     } else {
-        vector<int64_t> outDims = volIn->getOriginalDimensions();
-        outDims.resize(3);
-        volOut->reinitialize(outDims, volIn->getSform(), dims[4]);
-        volOut->setValueAllVoxels(0.0f);
-        for (int64_t c = 0; c < dims[4]; ++c)
+        subvolList.push_back(subvolNum);
+    }
+    int64_t numOutSubvols = (int64_t)subvolList.size(), numFrames = numOutSubvols * dims[4];
+    ClusterHelper myClusterHelp(mySpace);
+    vector<vector<vector<int64_t> > > frameClusters(numFrames);//frame order is subvolumes within components, like the old serial loop
+    if (numFrames == 1)
+    {//a single frame gets labeled with parallel slabs instead
+        ClusterHelper::Workspace myWork;
+        findFrameClusters(volIn->getFrame(subvolList[0], 0), mySpace, myClusterHelp, threshValue, minVolume, lessThan, roiFrame, sizeRatio, distanceCutoff, myWork, frameClusters[0]);
+    } else {
+#pragma omp CARET_PAR
         {
-            const float* inFrame = volIn->getFrame(subvolNum, c);
-            processSubvol(inFrame, volOut, 0, c, threshValue, minVolume, lessThan, roiFrame, sizeRatio, distanceCutoff, markVal);
+            ClusterHelper::Workspace myWork;
+#pragma omp CARET_FOR schedule(dynamic)
+            for (int64_t f = 0; f < numFrames; ++f)
+            {
+                const float* inFrame = volIn->getFrame(subvolList[f % numOutSubvols], f / numOutSubvols);
+                findFrameClusters(inFrame, mySpace, myClusterHelp, threshValue, minVolume, lessThan, roiFrame, sizeRatio, distanceCutoff, myWork, frameClusters[f]);
+            }
         }
     }
+    vector<int64_t> outDims = volIn->getOriginalDimensions();
+    if (subvolNum != -1) outDims.resize(3);
+    volOut->reinitialize(outDims, volIn->getSform(), dims[4]);
+    int markVal = startVal;
+    vector<float> outFrame(dims[0] * dims[1] * dims[2]);
+    for (int64_t f = 0; f < numFrames; ++f)
+    {
+        outFrame.assign(outFrame.size(), 0.0f);
+        markClusters(frameClusters[f], outFrame.data(), markVal);
+        volOut->setFrame(outFrame.data(), f % numOutSubvols, f / numOutSubvols);
+    }
     if (endVal != NULL) *endVal = markVal;
 }
 
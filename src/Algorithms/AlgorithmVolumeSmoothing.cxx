@@ -22,9 +22,13 @@
 #include "AlgorithmException.h"
 #include "VolumeFile.h"
 #include "Vector3D.h"
+#include "CaretFFT.h"
 #include "CaretLogger.h"
 #include "CaretOMP.h"
 #include "CaretAssert.h"
+#include "CaretPointer.h"
+#include "CaretProfiler.h"
+#include <algorithm>
 #include <cmath>
 
 using namespace caret;
@@ -62,8 +66,10 @@ OperationParameters* AlgorithmVolumeSmoothing::getParameters()
     
     ret->setHelpText(
         AString("Gaussian smoothing for volumes.  By default, smooths all subvolumes with no ROI, if ROI is given, only ") +
-        "positive voxels in the ROI volume have their values used, and all other voxels are set to zero.  Smoothing a non-orthogonal volume will " +
-        "be significantly slower, because the operation cannot be separated into 1-dimensional smoothings without distorting the kernel shape.\n\n" +
+        "positive voxels in the ROI volume have their values used, and all other voxels are set to zero.  Orthogonal volumes are smoothed with three " +
+        "1-dimensional passes.  Smoothing a non-orthogonal volume with a small kernel will be slower, because the operation cannot be separated into " +
+        "1-dimensional smoothings without distorting the kernel shape.  When the kernel is large compared to the voxel size, the convolution is done " +
+        "with FFTs instead, which gives the same result to within floating point precision.\n\n" +
         "The -fix-zeros option causes the smoothing to not use an input value if it is zero, but still write a smoothed value to the voxel.  " +
         "This is useful for zeros that indicate lack of information, preventing them from pulling down the intensity of nearby voxels, while " +
         "giving the zero an extrapolated value."
@@ -97,7 +103,7 @@ void AlgorithmVolumeSmoothing::useParameters(OperationParameters* myParams, Prog
     AlgorithmVolumeSmoothing(myProgObj, myVol, myKernel, myOutVol, roiVol, fixZeros, subvolNum);
 }
 
-AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, const VolumeFile* inVol, const float& kernel, VolumeFile* outVol, const VolumeFile* roiVol, const bool& fixZeros, const int& subvol) : AbstractAlgorithm(myProgObj)
+AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, const VolumeFile* inVol, const float& kernel, VolumeFile* outVol, const VolumeFile* roiVol, const bool& fixZeros, const int& subvol, const FFTMode& fftMode) : AbstractAlgorithm(myProgObj)
 {
     CaretAssert(inVol != NULL);
     CaretAssert(outVol != NULL);
@@ -116,7 +122,8 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
     {
         throw AlgorithmException("kernel too small");
     }
-    CaretArray<float> scratchFrame(myDims[0] * myDims[1] * myDims[2]);//it could be faster to preinitialize with zeros, then generate a usable voxels list if there is a small ROI...
+    const int64_t frameSize = myDims[0] * myDims[1] * myDims[2];
+    CaretArray<float> scratchFrame(frameSize);
     float kernBox = kernel * 3.0f;
     vector<vector<float> > volSpace = inVol->getSform();
     Vector3D ivec, jvec, kvec, origin, ijorth, jkorth, kiorth;
@@ -124,24 +131,28 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
     ivec[1] = volSpace[1][0]; jvec[1] = volSpace[1][1]; kvec[1] = volSpace[1][2]; origin[1] = volSpace[1][3];
     ivec[2] = volSpace[2][0]; jvec[2] = volSpace[2][1]; kvec[2] = volSpace[2][2]; origin[2] = volSpace[2][3];
     const float ORTH_TOLERANCE = 0.001f;//tolerate this much deviation from orthogonal (dot product divided by product of lengths) to use orthogonal assumptions to smooth
-    if (abs(ivec.dot(jvec.normal())) / ivec.length() < ORTH_TOLERANCE && abs(jvec.dot(kvec.normal())) / jvec.length() < ORTH_TOLERANCE && abs(kvec.dot(ivec.normal())) / kvec.length() < ORTH_TOLERANCE)
-    {//if our axes are orthogonal, optimize by doing three 1-dimensional smoothings for O(voxels * (ki + kj + kk)) instead of O(voxels * (ki * kj * kk))
-        CaretArray<float> scratchFrame2(myDims[0] * myDims[1] * myDims[2]), scratchWeights(myDims[0] * myDims[1] * myDims[2]), scratchWeights2(myDims[0] * myDims[1] * myDims[2]), scratchFrame3;
-        if (roiVol != NULL)
-        {
-            scratchFrame3 = CaretArray<float> (myDims[0] * myDims[1] * myDims[2]);
-        }
+    bool isOrth = (abs(ivec.dot(jvec.normal())) / ivec.length() < ORTH_TOLERANCE && abs(jvec.dot(kvec.normal())) / jvec.length() < ORTH_TOLERANCE && abs(kvec.dot(ivec.normal())) / kvec.length() < ORTH_TOLERANCE);
+    int irange, jrange, krange;
+    CaretArray<float> iweights, jweights, kweights;//for separable smoothing
+    CaretArray<float**> weights;//full 3D kernel, for non-orthogonal or FFT
+    CaretArray<float*> weights2;
+    CaretArray<float> weights3;
+    int64_t numNonzeroWeights = 0;
+    if (isOrth)
+    {//if our axes are orthogonal, we can do three 1-dimensional smoothings for O(voxels * (ki + kj + kk)) instead of O(voxels * (ki * kj * kk))
         float ispace = ivec.length(), jspace = jvec.length(), kspace = kvec.length();
-        int irange = (int)floor(kernBox / ispace);
-        int jrange = (int)floor(kernBox / jspace);
-        int krange = (int)floor(kernBox / kspace);
+        irange = (int)floor(kernBox / ispace);
+        jrange = (int)floor(kernBox / jspace);
+        krange = (int)floor(kernBox / kspace);
         if (irange < 1) irange = 1;//don't underflow
         if (jrange < 1) jrange = 1;
         if (krange < 1) krange = 1;
         int isize = irange * 2 + 1;//and construct a precomputed kernel in the box
         int jsize = jrange * 2 + 1;
         int ksize = krange * 2 + 1;
-        CaretArray<float> iweights(isize), jweights(jsize), kweights(ksize);
+        iweights = CaretArray<float>(isize);
+        jweights = CaretArray<float>(jsize);
+        kweights = CaretArray<float>(ksize);
         for (int i = 0; i < isize; ++i)
         {
             float tempf = ispace * (i - irange) / kernel;
@@ -157,68 +168,22 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
             float tempf = kspace * (k - krange) / kernel;
             kweights[k] = exp(-tempf * tempf / 2.0f);
         }
-        if (subvol == -1)
-        {
-            vector<int64_t> origDims = inVol->getOriginalDimensions();
-            outVol->reinitialize(origDims, volSpace, myDims[4]);
-            vector<int> lists[3];
-            for (int s = 0; s < myDims[3]; ++s)
-            {
-                outVol->setMapName(s, inVol->getMapName(s) + ", smooth " + AString::number(kernel));
-                for (int c = 0; c < myDims[4]; ++c)
-                {
-                    const float* inFrame = inVol->getFrame(s, c);
-                    if (roiVol == NULL)
-                    {
-                        smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, inVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
-                    } else {
-                        smoothFrameROI(inFrame, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
-                    }
-                    outVol->setFrame(scratchFrame, s, c);
-                }
-            }
-        } else {
-            vector<int64_t> origDims = inVol->getOriginalDimensions(), newDims;
-            newDims.resize(3);
-            newDims[0] = origDims[0];
-            newDims[1] = origDims[1];
-            newDims[2] = origDims[2];
-            outVol->reinitialize(newDims, volSpace, myDims[4]);
-            vector<int> lists[3];
-            outVol->setMapName(0, inVol->getMapName(subvol) + ", smooth " + AString::number(kernel));
-            for (int c = 0; c < myDims[4]; ++c)
-            {
-                const float* inFrame = inVol->getFrame(subvol, c);
-                if (roiVol == NULL)
-                {
-                    smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, inVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
-                } else {
-                    smoothFrameROI(inFrame, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
-                }
-                outVol->setFrame(scratchFrame, 0, c);
-            }
-        }
     } else {
-        if (!haveWarned)
-        {
-            CaretLogWarning("input volume is not orthogonal, smoothing will take longer");
-            haveWarned = true;
-        }
         ijorth = ivec.cross(jvec).normal();//find the bounding box that encloses a sphere of radius kernBox
         jkorth = jvec.cross(kvec).normal();
         kiorth = kvec.cross(ivec).normal();
-        int irange = (int)floor(abs(kernBox / ivec.dot(jkorth)));
-        int jrange = (int)floor(abs(kernBox / jvec.dot(kiorth)));
-        int krange = (int)floor(abs(kernBox / kvec.dot(ijorth)));
+        irange = (int)floor(abs(kernBox / ivec.dot(jkorth)));
+        jrange = (int)floor(abs(kernBox / jvec.dot(kiorth)));
+        krange = (int)floor(abs(kernBox / kvec.dot(ijorth)));
         if (irange < 1) irange = 1;//don't underflow
         if (jrange < 1) jrange = 1;
         if (krange < 1) krange = 1;
         int isize = irange * 2 + 1;//and construct a precomputed kernel in the box
         int jsize = jrange * 2 + 1;
         int ksize = krange * 2 + 1;
-        CaretArray<float**> weights(ksize);//so I don't need to explicitly delete[] if I throw
-        CaretArray<float*> weights2(ksize * jsize);//construct flat arrays and index them into 3D
-        CaretArray<float> weights3(ksize * jsize * isize);//index i comes last because that is linear for volume frames
+        weights = CaretArray<float**>(ksize);//so I don't need to explicitly delete[] if I throw
+        weights2 = CaretArray<float*>(ksize * jsize);//construct flat arrays and index them into 3D
+        weights3 = CaretArray<float>(ksize * jsize * isize);//index i comes last because that is linear for volume frames
         Vector3D kscratch, jscratch, iscratch;
         for (int k = 0; k < ksize; ++k)
         {
@@ -237,343 +202,343 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
                         weights[k][j][i] = 0.0f;//test for zero to avoid some multiplies/adds, cheaper or cleaner than checking bounds on indexes from an index list
                     } else {
                         weights[k][j][i] = exp(-tempf * tempf / kernel / kernel / 2.0f);//optimization here isn't critical
+                        ++numNonzeroWeights;
                     }
                 }
             }
         }
-        if (subvol == -1)
-        {
-            vector<int64_t> origDims = inVol->getOriginalDimensions();
-            outVol->reinitialize(origDims, volSpace, myDims[4]);
-            for (int s = 0; s < myDims[3]; ++s)
+    }
+    int64_t fftDims[3] = { CaretFFT::goodSize(max(myDims[0] + irange, (int64_t)(2 * irange + 1))),//pad so the kernel can't wrap around onto data
+                           CaretFFT::goodSize(max(myDims[1] + jrange, (int64_t)(2 * jrange + 1))),
+                           CaretFFT::goodSize(max(myDims[2] + krange, (int64_t)(2 * krange + 1))) };
+    double fftSize = (double)fftDims[0] * fftDims[1] * fftDims[2];
+    const double FFT_COST = 10.0;//rough flops per padded voxel per log2 of size, for one complex transform, including the strided line gathers
+    double fftCost = 2.0 * FFT_COST * log(fftSize) / log(2.0) * fftSize / frameSize;//forward and inverse transforms
+    double directCost;//multiply-adds per voxel, counting the weight sum
+    if (isOrth)
+    {
+        directCost = 2.0 * ((irange * 2 + 1) + (jrange * 2 + 1) + (krange * 2 + 1));
+    } else {
+        directCost = 2.0 * numNonzeroWeights;
+    }
+    //the data and the weight sums are already packed into one complex transform as its real and imaginary parts, so a real-to-complex transform
+    //wouldn't save anything - instead, don't use FFT when the padded scratch plus the kernel transform would be much larger than a typical frame
+    const double FFT_MEMORY_LIMIT = 1024.0 * 1024.0 * 1024.0;//bytes
+    double fftMemory = fftSize * (sizeof(complex<double>) + sizeof(double));
+    SmoothEngine myEngine = (isOrth ? SEPARABLE : DIRECT);
+    switch (fftMode)
+    {
+        case FFT_AUTO:
+            if (directCost > fftCost)
             {
-                outVol->setMapName(s, inVol->getMapName(s) + ", smooth " + AString::number(kernel));
-                for (int c = 0; c < myDims[4]; ++c)
+                if (fftMemory > FFT_MEMORY_LIMIT)
                 {
-                    const float* inFrame = inVol->getFrame(s, c);
-                    smoothFrameNonOrth(inFrame, myDims, scratchFrame, inVol, roiVol, weights, irange, jrange, krange, fixZeros);
-                    outVol->setFrame(scratchFrame, s, c);
+                    CaretLogFine("not using FFT convolution, it would need " + AString::number(fftMemory / 1024.0 / 1024.0) + " MiB of scratch memory");
+                } else {
+                    myEngine = FFT;
                 }
             }
-        } else {
-            vector<int64_t> origDims = inVol->getOriginalDimensions(), newDims;
-            newDims.resize(3);
-            newDims[0] = origDims[0];
-            newDims[1] = origDims[1];
-            newDims[2] = origDims[2];
-            outVol->reinitialize(newDims, volSpace, myDims[4]);
-            outVol->setMapName(0, inVol->getMapName(subvol) + ", smooth " + AString::number(kernel));
-            for (int c = 0; c < myDims[4]; ++c)
-            {
-                const float* inFrame = inVol->getFrame(subvol, c);
-                smoothFrameNonOrth(inFrame, myDims, scratchFrame, inVol, roiVol, weights, irange, jrange, krange, fixZeros);
-                outVol->setFrame(scratchFrame, 0, c);
-            }
-        }
+            break;
+        case FFT_NEVER:
+            break;
+        case FFT_ALWAYS:
+            myEngine = FFT;
+            break;
     }
-}
-
-void AlgorithmVolumeSmoothing::smoothFrame(const float* inFrame, vector<int64_t> myDims, CaretArray<float> scratchFrame, CaretArray<float> scratchFrame2, CaretArray<float> scratchWeights, CaretArray<float> scratchWeights2, const VolumeFile* inVol, CaretArray<float> iweights, CaretArray<float> jweights, CaretArray<float> kweights, int irange, int jrange, int krange, const bool& fixZeros)
-{//this function should ONLY get invoked when the volume is orthogonal (axes are perpendicular, not necessarily aligned with x, y, z, and not necessarily equal spacing)
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int k = 0; k < myDims[2]; ++k)//smooth along i axis
+    CaretPointer<CaretFFT3D> myFFT;
+    vector<double> kernelFFT;
+    vector<complex<double> > fftScratch;
+    double minWeight = 0.0;
+    CaretArray<float> scratchSum, scratchWeights, scratchSum2, scratchWeights2;
+    int64_t roiBox[6] = { 0, myDims[0], 0, myDims[1], 0, myDims[2] };//one-after convention for the upper bounds
+    const float* roiFrame = NULL;
+    if (roiVol != NULL) roiFrame = roiVol->getFrame();
+    switch (myEngine)
     {
-        for (int j = 0; j < myDims[1]; ++j)
+        case SEPARABLE:
+            CaretLogFine("smoothing with separable 1D passes");
+            scratchSum = CaretArray<float>(frameSize);
+            scratchWeights = CaretArray<float>(frameSize);
+            scratchSum2 = CaretArray<float>(frameSize);
+            scratchWeights2 = CaretArray<float>(frameSize);
+            if (roiFrame != NULL)
+            {//only compute within the bounding box of the roi, for when the roi is small
+                roiBox[0] = myDims[0]; roiBox[1] = 0; roiBox[2] = myDims[1]; roiBox[3] = 0; roiBox[4] = myDims[2]; roiBox[5] = 0;
+                for (int64_t k = 0; k < myDims[2]; ++k)
+                {
+                    for (int64_t j = 0; j < myDims[1]; ++j)
+                    {
+                        for (int64_t i = 0; i < myDims[0]; ++i)
+                        {
+                            if (roiFrame[inVol->getIndex(i, j, k)] > 0.0f)
+                            {
+                                roiBox[0] = min(roiBox[0], i); roiBox[1] = max(roiBox[1], i + 1);
+                                roiBox[2] = min(roiBox[2], j); roiBox[3] = max(roiBox[3], j + 1);
+                                roiBox[4] = min(roiBox[4], k); roiBox[5] = max(roiBox[5], k + 1);
+                            }
+                        }
+                    }
+                }
+            }
+            break;
+        case DIRECT:
+            if (!haveWarned)
+            {
+                CaretLogWarning("input volume is not orthogonal, smoothing will take longer");
+                haveWarned = true;
+            }
+            break;
+        case FFT:
         {
-            for (int i = 0; i < myDims[0]; ++i)
+            CaretLogFine("smoothing with FFT convolution, padded size " + AString::number(fftDims[0]) + "x" + AString::number(fftDims[1]) + "x" + AString::number(fftDims[2]));
+            myFFT.grabNew(new CaretFFT3D(fftDims));
+            int64_t fftTotal = fftDims[0] * fftDims[1] * fftDims[2];
+            vector<complex<double> > kernelScratch(fftTotal, complex<double>(0.0, 0.0));
+            minWeight = 1.0;
+            for (int k = -krange; k <= krange; ++k)
             {
-                int imin = i - irange, imax = i + irange + 1;//one-after array size convention
-                if (imin < 0) imin = 0;
-                if (imax > myDims[0]) imax = myDims[0];
-                float sum = 0.0f, weightsum = 0.0f;
-                int64_t baseInd = inVol->getIndex(0, j, k, 0);//extra 0 on a default parameter is to prevent int->pointer vs int->int64 conversion ambiguity
-                int64_t curInd = baseInd + i;
-                for (int ikern = imin; ikern < imax; ++ikern)
+                for (int j = -jrange; j <= jrange; ++j)
                 {
-                    int64_t thisIndex = baseInd + ikern;
-                    if ((!fixZeros || inFrame[thisIndex] != 0.0f))
+                    for (int i = -irange; i <= irange; ++i)
                     {
-                        float weight = iweights[ikern - i + irange];
-                        weightsum += weight;
-                        sum += weight * inFrame[thisIndex];
+                        float weight;
+                        if (isOrth)
+                        {
+                            weight = iweights[i + irange] * jweights[j + jrange] * kweights[k + krange];//same kernel as the separable passes
+                        } else {
+                            weight = weights[k + krange][j + jrange][i + irange];
+                        }
+                        if (weight != 0.0f)
+                        {
+                            int64_t index = ((i + fftDims[0]) % fftDims[0]) + fftDims[0] * (((j + fftDims[1]) % fftDims[1]) + fftDims[1] * ((k + fftDims[2]) % fftDims[2]));
+                            kernelScratch[index] = complex<double>(weight, 0.0);
+                            if (weight < minWeight) minWeight = weight;
+                        }
                     }
                 }
-                scratchWeights[curInd] = weightsum;
-                scratchFrame[curInd] = sum;//don't divide yet, we will divide later after we gather the weighted sums of the weighted sums of the weight sums (yes, that repetition is right)
             }
+            minWeight *= 0.5;//any voxel that has data within the kernel gets at least the smallest weight, anything less is roundoff
+            myFFT->transform(kernelScratch.data());
+            kernelFFT.resize(fftTotal);
+            for (int64_t i = 0; i < fftTotal; ++i)
+            {
+                kernelFFT[i] = kernelScratch[i].real() / fftTotal;//kernel is symmetric, so its transform is real - also fold in the normalization of the inverse transform
+            }
+            break;
         }
     }
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int k = 0; k < myDims[2]; ++k)//now j
+    vector<int> frameList;
+    if (subvol == -1)
     {
-        for (int i = 0; i < myDims[0]; ++i)
+        vector<int64_t> origDims = inVol->getOriginalDimensions();
+        outVol->reinitialize(origDims, volSpace, myDims[4]);
+        for (int s = 0; s < myDims[3]; ++s)
         {
-            for (int j = 0; j < myDims[1]; ++j)//step along the dimension being smoothed last for best cache coherence
-            {
-                int jmin = j - jrange, jmax = j + jrange + 1;//one-after array size convention
-                if (jmin < 0) jmin = 0;
-                if (jmax > myDims[1]) jmax = myDims[1];
-                float sum = 0.0f, weightsum = 0.0f;
-                int64_t baseInd = inVol->getIndex(i, 0, k);
-                int64_t curInd = baseInd + j * myDims[0];
-                for (int jkern = jmin; jkern < jmax; ++jkern)
-                {
-                    int64_t thisIndex = baseInd + jkern * myDims[0];
-                    float weight = jweights[jkern - j + jrange];
-                    weightsum += weight * scratchWeights[thisIndex];
-                    sum += weight * scratchFrame[thisIndex];
-                }
-                scratchWeights2[curInd] = weightsum;
-                scratchFrame2[curInd] = sum;//we now have the weighted sum of the weight sums
-            }
+            frameList.push_back(s);
         }
+    } else {
+        vector<int64_t> origDims = inVol->getOriginalDimensions(), newDims;
+        newDims.resize(3);
+        newDims[0] = origDims[0];
+        newDims[1] = origDims[1];
+        newDims[2] = origDims[2];
+        outVol->reinitialize(newDims, volSpace, myDims[4]);
+        frameList.push_back(subvol);
     }
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int j = 0; j < myDims[1]; ++j)//and finally k
+    CaretProfileScope profileScope("volume smoothing frames");
+    for (int outSubvol = 0; outSubvol < (int)frameList.size(); ++outSubvol)
     {
-        for (int i = 0; i < myDims[0]; ++i)
+        int s = frameList[outSubvol];
+        outVol->setMapName(outSubvol, inVol->getMapName(s) + ", smooth " + AString::number(kernel));
+        for (int c = 0; c < myDims[4]; ++c)
         {
-            for (int k = 0; k < myDims[2]; ++k)//ditto
+            const float* inFrame = inVol->getFrame(s, c);
+            switch (myEngine)
             {
-                int64_t baseInd = inVol->getIndex(i, j, 0);
-                int64_t curInd = baseInd + k * myDims[0] * myDims[1];
-                int kmin = k - krange, kmax = k + krange + 1;//one-after array size convention
-                if (kmin < 0) kmin = 0;
-                if (kmax > myDims[2]) kmax = myDims[2];
-                float sum = 0.0f, weightsum = 0.0f;
-                for (int kkern = kmin; kkern < kmax; ++kkern)
-                {
-                    int64_t thisIndex = baseInd + kkern * myDims[0] * myDims[1];
-                    float weight = kweights[kkern - k + krange];
-                    weightsum += weight * scratchWeights2[thisIndex];
-                    sum += weight * scratchFrame2[thisIndex];
-                }
-                if (weightsum != 0.0f)
-                {
-                    scratchFrame[curInd] = sum / weightsum;//NOW we can divide
-                } else {
-                    scratchFrame[curInd] = 0.0f;
-                }
+                case SEPARABLE:
+                    smoothFrameSeparable(inFrame, myDims, scratchFrame, roiFrame, roiBox, scratchSum, scratchWeights, scratchSum2, scratchWeights2, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
+                    break;
+                case DIRECT:
+                    smoothFrameNonOrth(inFrame, myDims, scratchFrame, inVol, roiVol, weights, irange, jrange, krange, fixZeros);
+                    break;
+                case FFT:
+                    smoothFrameFFT(inFrame, myDims, scratchFrame, roiFrame, *myFFT, kernelFFT, minWeight, fixZeros, fftScratch);
+                    break;
             }
+            outVol->setFrame(scratchFrame, outSubvol, c);
+            CaretProfiler::addCounter("volume frames smoothed");
         }
     }
 }
 
-void AlgorithmVolumeSmoothing::smoothFrameROI(const float* inFrame, vector<int64_t> myDims, CaretArray<float> scratchFrame, CaretArray<float> scratchFrame2, CaretArray<float> scratchFrame3,
-                                              CaretArray<float> scratchWeights, CaretArray<float> scratchWeights2, vector<int> lists[3],
-                                              const VolumeFile* inVol, const VolumeFile* roiVol, CaretArray<float> iweights, CaretArray<float> jweights, CaretArray<float> kweights,
-                                              int irange, int jrange, int krange, const bool& fixZeros)
-{//optimized for orthogonal, plus lists of voxels for ROI smoothing
-    if (lists[0].size() == 0)
-    {//this is our first time into this function, we must populate the lists
-        const float* roiFrame = roiVol->getFrame();
-        CaretArray<int> markROI(myDims[0] * myDims[1] * myDims[2], 0);//need a temporary array to sort out ROI zeros from -fix-zeros zeros
-#pragma omp CARET_PARFOR
-        for (int k = 0; k < myDims[2]; ++k)//smooth along i axis
+void AlgorithmVolumeSmoothing::smoothFrameSeparable(const float* inFrame, const vector<int64_t>& myDims, float* outFrame, const float* roiFrame, const int64_t roiBox[6],
+                                                    float* scratchSum, float* scratchWeights, float* scratchSum2, float* scratchWeights2,
+                                                    const float* iweights, const float* jweights, const float* kweights, const int& irange, const int& jrange, const int& krange, const bool& fixZeros)
+{//this function should ONLY get invoked when the volume is orthogonal (axes are perpendicular, not necessarily aligned with x, y, z, and not necessarily equal spacing)
+    const int64_t rowSize = myDims[0], sliceSize = myDims[0] * myDims[1], frameSize = sliceSize * myDims[2];
+    for (int64_t i = 0; i < frameSize; ++i)
+    {
+        outFrame[i] = 0.0f;
+    }
+    const int64_t ilo = roiBox[0], ihi = roiBox[1], jlo = roiBox[2], jhi = roiBox[3], klo = roiBox[4], khi = roiBox[5];
+    if (ilo >= ihi) return;//empty roi
+    const int64_t jloGrow = max((int64_t)0, jlo - jrange), jhiGrow = min(myDims[1], jhi + jrange);//the earlier passes must also cover voxels that the later kernels reach
+    const int64_t kloGrow = max((int64_t)0, klo - krange), khiGrow = min(myDims[2], khi + krange);
+    const int64_t iloSource = max((int64_t)0, ilo - irange), ihiSource = min(myDims[0], ihi + irange);
+    //all inner loops are over contiguous voxels along i, so they vectorize - for each output voxel, the kernel offsets are still summed in increasing order
+#pragma omp CARET_PAR
+    {
+        vector<float> rowVals(rowSize), rowMask(rowSize);
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t k = kloGrow; k < khiGrow; ++k)//smooth along i axis, tracking the sum of the weights of voxels that were used, in the same way as data
         {
-            for (int j = 0; j < myDims[1]; ++j)
+            for (int64_t j = jloGrow; j < jhiGrow; ++j)
             {
-                for (int i = 0; i < myDims[0]; ++i)//don't test whether intermediate voxel is insode ROI, or we lose some data
+                int64_t baseInd = k * sliceSize + j * rowSize;
+                for (int64_t i = iloSource; i < ihiSource; ++i)
                 {
-                    int imin = i - irange, imax = i + irange + 1;//one-after array size convention
-                    if (imin < 0) imin = 0;
-                    if (imax > myDims[0]) imax = myDims[0];
-                    float sum = 0.0f, weightsum = 0.0f;
-                    int64_t baseInd = inVol->getIndex(0, j, k, 0);
-                    int64_t curInd = baseInd + i;
-                    bool used = false;
-                    for (int ikern = imin; ikern < imax; ++ikern)
+                    float value = inFrame[baseInd + i];
+                    if ((roiFrame == NULL || roiFrame[baseInd + i] > 0.0f) && (!fixZeros || value != 0.0f))
                     {
-                        int64_t thisIndex = baseInd + ikern;
-                        if (roiFrame[thisIndex] > 0.0f)//only test source and final voxels for being in ROI
-                        {
-                            if (!used)//keep a list of voxels whose i-kernel intersects the ROI
-                            {
-                                used = true;
-                                markROI[curInd] = 1;
-#pragma omp critical
-                                {
-                                    lists[0].push_back(i);
-                                    lists[0].push_back(j);
-                                    lists[0].push_back(k);
-                                }
-                            }
-                            if (!fixZeros || inFrame[thisIndex] != 0.0f)
-                            {
-                                float weight = iweights[ikern - i + irange];
-                                weightsum += weight;
-                                sum += weight * inFrame[thisIndex];
-                            }
-                        }
+                        rowVals[i] = value;
+                        rowMask[i] = 1.0f;
+                    } else {
+                        rowVals[i] = 0.0f;
+                        rowMask[i] = 0.0f;
+                    }
+                }
+                float* sumOut = scratchSum + baseInd;
+                float* weightOut = scratchWeights + baseInd;
+                for (int64_t i = ilo; i < ihi; ++i)
+                {
+                    sumOut[i] = 0.0f;
+                    weightOut[i] = 0.0f;
+                }
+                for (int offset = -irange; offset <= irange; ++offset)
+                {
+                    const float weight = iweights[offset + irange];
+                    const int64_t start = max(ilo, (int64_t)-offset), end = min(ihi, myDims[0] - offset);
+                    const float* valsIn = rowVals.data() + offset;
+                    const float* maskIn = rowMask.data() + offset;
+                    for (int64_t i = start; i < end; ++i)
+                    {
+                        sumOut[i] += weight * valsIn[i];
+                        weightOut[i] += weight * maskIn[i];
                     }
-                    scratchWeights[curInd] = weightsum;
-                    scratchFrame3[curInd] = sum;//don't divide yet, we will divide later after we gather the weighted sums of the weighted sums of the weight sums (yes, that repetition is right)
                 }
             }
         }
-#pragma omp CARET_PARFOR
-        for (int k = 0; k < myDims[2]; ++k)//now j
+    }
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t k = kloGrow; k < khiGrow; ++k)//now j, weighted sums of the weighted sums and of the weight sums
+    {
+        for (int64_t j = jlo; j < jhi; ++j)
         {
-            for (int i = 0; i < myDims[0]; ++i)
+            float* sumOut = scratchSum2 + k * sliceSize + j * rowSize;
+            float* weightOut = scratchWeights2 + k * sliceSize + j * rowSize;
+            for (int64_t i = ilo; i < ihi; ++i)
             {
-                for (int j = 0; j < myDims[1]; ++j)//step along the dimension being smoothed last for best cache coherence
+                sumOut[i] = 0.0f;
+                weightOut[i] = 0.0f;
+            }
+            int64_t jmin = max((int64_t)0, j - jrange), jmax = min(myDims[1], j + jrange + 1);//one-after array size convention
+            for (int64_t jkern = jmin; jkern < jmax; ++jkern)
+            {
+                const float weight = jweights[jkern - j + jrange];
+                const float* sumIn = scratchSum + k * sliceSize + jkern * rowSize;
+                const float* weightIn = scratchWeights + k * sliceSize + jkern * rowSize;
+                for (int64_t i = ilo; i < ihi; ++i)
                 {
-                    int jmin = j - jrange, jmax = j + jrange + 1;//one-after array size convention
-                    if (jmin < 0) jmin = 0;
-                    if (jmax > myDims[1]) jmax = myDims[1];
-                    float sum = 0.0f, weightsum = 0.0f;
-                    int64_t baseInd = inVol->getIndex(i, 0, k);
-                    int64_t curInd = baseInd + j * myDims[0];
-                    bool used = false;
-                    for (int jkern = jmin; jkern < jmax; ++jkern)
-                    {
-                        int64_t thisIndex = baseInd + jkern * myDims[0];//DO NOT test for this source voxel being outside ROI, or you will skip good data
-                        if ((markROI[thisIndex] & 1) == 1)
-                        {//skip voxels whose i-kernels don't touch the ROI, they will always have 0/0
-                            if (!used)
-                            {
-                                used = true;
-                                markROI[curInd] |= 2;//bitwise so i can track all 3 lists separately in one array
-#pragma omp critical
-                                {
-                                    lists[1].push_back(i);
-                                    lists[1].push_back(j);
-                                    lists[1].push_back(k);
-                                }
-                            }
-                            float weight = jweights[jkern - j + jrange];
-                            weightsum += weight * scratchWeights[thisIndex];
-                            sum += weight * scratchFrame3[thisIndex];
-                        }
-                    }
-                    scratchWeights2[curInd] = weightsum;
-                    scratchFrame2[curInd] = sum;//we now have the weighted sum of the weight sums
+                    sumOut[i] += weight * sumIn[i];
+                    weightOut[i] += weight * weightIn[i];
                 }
             }
         }
-#pragma omp CARET_PARFOR
-        for (int j = 0; j < myDims[1]; ++j)//and finally k
+    }
+#pragma omp CARET_PAR
+    {
+        vector<float> rowSum(rowSize), rowWeight(rowSize);
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t k = klo; k < khi; ++k)//and finally k
         {
-            for (int i = 0; i < myDims[0]; ++i)
+            int64_t kmin = max((int64_t)0, k - krange), kmax = min(myDims[2], k + krange + 1);//one-after array size convention
+            for (int64_t j = jlo; j < jhi; ++j)
             {
-                for (int k = 0; k < myDims[2]; ++k)//ditto
+                for (int64_t i = ilo; i < ihi; ++i)
                 {
-                    int64_t baseInd = inVol->getIndex(i, j, 0);
-                    int64_t curInd = baseInd + k * myDims[0] * myDims[1];
-                    if (roiFrame[curInd] > 0.0f)
+                    rowSum[i] = 0.0f;
+                    rowWeight[i] = 0.0f;
+                }
+                for (int64_t kkern = kmin; kkern < kmax; ++kkern)
+                {
+                    const float weight = kweights[kkern - k + krange];
+                    const float* sumIn = scratchSum2 + kkern * sliceSize + j * rowSize;
+                    const float* weightIn = scratchWeights2 + kkern * sliceSize + j * rowSize;
+                    for (int64_t i = ilo; i < ihi; ++i)
                     {
-#pragma omp critical
-                        {
-                            lists[2].push_back(i);//third list is a little different, since we don't output stuff outside the ROI, we can drop the voxels that "grew" from the ROI
-                            lists[2].push_back(j);//we do need to calculate those grown voxels, though, since we use some of them within the k-kernel
-                            lists[2].push_back(k);
-                        }
-                        int kmin = k - krange, kmax = k + krange + 1;//one-after array size convention
-                        if (kmin < 0) kmin = 0;
-                        if (kmax > myDims[2]) kmax = myDims[2];
-                        float sum = 0.0f, weightsum = 0.0f;
-                        for (int kkern = kmin; kkern < kmax; ++kkern)
-                        {
-                            int64_t thisIndex = baseInd + kkern * myDims[0] * myDims[1];//ditto
-                            float weight = kweights[kkern - k + krange];
-                            weightsum += weight * scratchWeights2[thisIndex];
-                            sum += weight * scratchFrame2[thisIndex];
-                        }
-                        if (weightsum != 0.0f)
-                        {
-                            scratchFrame[curInd] = sum / weightsum;//NOW we can divide
-                        } else {
-                            scratchFrame[curInd] = 0.0f;
-                        }
-                    } else {
-                        scratchFrame[curInd] = 0.0f;
+                        rowSum[i] += weight * sumIn[i];
+                        rowWeight[i] += weight * weightIn[i];
+                    }
+                }
+                int64_t baseInd = k * sliceSize + j * rowSize;
+                for (int64_t i = ilo; i < ihi; ++i)
+                {
+                    if ((roiFrame == NULL || roiFrame[baseInd + i] > 0.0f) && rowWeight[i] != 0.0f)
+                    {
+                        outFrame[baseInd + i] = rowSum[i] / rowWeight[i];//NOW we can divide
                     }
                 }
             }
         }
-        if (lists[0].size() == 0)
-        {
-            lists[0].push_back(-1);//to keep it from scanning the ROI again when the ROI has no voxels, slightly hacky
-        }
-    } else {//lists already made, use them
-        const float* roiFrame = roiVol->getFrame();
-        int64_t ibasesize = (int64_t)lists[0].size();
-        if (ibasesize < 3) return;//handle the case of empty ROI here (ibasesize will be 1)
-        int64_t jbasesize = (int64_t)lists[1].size();
-        int64_t kbasesize = (int64_t)lists[2].size();
+    }
+}
+
+void AlgorithmVolumeSmoothing::smoothFrameFFT(const float* inFrame, const vector<int64_t>& myDims, float* outFrame, const float* roiFrame, const CaretFFT3D& myFFT,
+                                              const vector<double>& kernelFFT, const double& minWeight, const bool& fixZeros, vector<complex<double> >& scratch)
+{//convolve data and the mask of used voxels at the same time, as the real and imaginary parts - the kernel is real, so they don't mix
+    const int64_t* fftDims = myFFT.getDims();
+    int64_t fftTotal = fftDims[0] * fftDims[1] * fftDims[2];
+    scratch.assign(fftTotal, complex<double>(0.0, 0.0));
 #pragma omp CARET_PARFOR schedule(dynamic)
-        for (int ibase = 0; ibase < ibasesize; ibase += 3)
+    for (int64_t k = 0; k < myDims[2]; ++k)
+    {
+        for (int64_t j = 0; j < myDims[1]; ++j)
         {
-            int i = lists[0][ibase];
-            int j = lists[0][ibase + 1];
-            int k = lists[0][ibase + 2];
-            int imin = i - irange, imax = i + irange + 1;//one-after array size convention
-            if (imin < 0) imin = 0;
-            if (imax > myDims[0]) imax = myDims[0];
-            float sum = 0.0f, weightsum = 0.0f;
-            int64_t baseInd = inVol->getIndex(0, j, k, 0);
-            int64_t curInd = baseInd + i;
-            for (int ikern = imin; ikern < imax; ++ikern)
+            int64_t inBase = myDims[0] * (j + myDims[1] * k), fftBase = fftDims[0] * (j + fftDims[1] * k);
+            for (int64_t i = 0; i < myDims[0]; ++i)
             {
-                int64_t thisIndex = baseInd + ikern;
-                if (roiFrame[thisIndex] > 0.0f && (!fixZeros || inFrame[thisIndex] != 0.0f))
+                float value = inFrame[inBase + i];
+                if ((roiFrame == NULL || roiFrame[inBase + i] > 0.0f) && (!fixZeros || value != 0.0f))
                 {
-                    float weight = iweights[ikern - i + irange];
-                    weightsum += weight;
-                    sum += weight * inFrame[thisIndex];
+                    scratch[fftBase + i] = complex<double>(value, 1.0);
                 }
             }
-            scratchWeights[curInd] = weightsum;
-            scratchFrame3[curInd] = sum;//don't divide yet, we will divide later after we gather the weighted sums of the weighted sums of the weight sums (yes, that repetition is right)
         }
+    }
+    myFFT.transform(scratch.data());
+#pragma omp CARET_PARFOR schedule(static)
+    for (int64_t i = 0; i < fftTotal; ++i)
+    {
+        scratch[i] *= kernelFFT[i];
+    }
+    myFFT.transform(scratch.data(), true);
 #pragma omp CARET_PARFOR schedule(dynamic)
-        for (int jbase = 0; jbase < jbasesize; jbase += 3)
+    for (int64_t k = 0; k < myDims[2]; ++k)
+    {
+        for (int64_t j = 0; j < myDims[1]; ++j)
         {
-            int i = lists[1][jbase];
-            int j = lists[1][jbase + 1];
-            int k = lists[1][jbase + 2];
-            int jmin = j - jrange, jmax = j + jrange + 1;//one-after array size convention
-            if (jmin < 0) jmin = 0;
-            if (jmax > myDims[1]) jmax = myDims[1];
-            float sum = 0.0f, weightsum = 0.0f;
-            int64_t baseInd = inVol->getIndex(i, 0, k);
-            int64_t curInd = baseInd + j * myDims[0];
-            for (int jkern = jmin; jkern < jmax; ++jkern)
+            int64_t outBase = myDims[0] * (j + myDims[1] * k), fftBase = fftDims[0] * (j + fftDims[1] * k);
+            for (int64_t i = 0; i < myDims[0]; ++i)
             {
-                int64_t thisIndex = baseInd + jkern * myDims[0];//DO NOT test for this source voxel having zero data, or it will skip good data
-                float weight = jweights[jkern - j + jrange];
-                weightsum += weight * scratchWeights[thisIndex];
-                sum += weight * scratchFrame3[thisIndex];
+                const complex<double>& result = scratch[fftBase + i];
+                if ((roiFrame == NULL || roiFrame[outBase + i] > 0.0f) && result.imag() > minWeight)
+                {
+                    outFrame[outBase + i] = (float)(result.real() / result.imag());
+                } else {
+                    outFrame[outBase + i] = 0.0f;
+                }
             }
-            scratchWeights2[curInd] = weightsum;
-            scratchFrame2[curInd] = sum;//we now have the weighted sum of the weight sums
         }
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int kbase = 0; kbase < kbasesize; kbase += 3)
-        {
-            int i = lists[2][kbase];
-            int j = lists[2][kbase + 1];
-            int k = lists[2][kbase + 2];
-            int64_t baseInd = inVol->getIndex(i, j, 0);
-            int64_t curInd = baseInd + k * myDims[0] * myDims[1];
-            int kmin = k - krange, kmax = k + krange + 1;//one-after array size convention
-            if (kmin < 0) kmin = 0;
-            if (kmax > myDims[2]) kmax = myDims[2];
-            float sum = 0.0f, weightsum = 0.0f;
-            for (int kkern = kmin; kkern < kmax; ++kkern)
-            {
-                int64_t thisIndex = baseInd + kkern * myDims[0] * myDims[1];//ditto
-                float weight = kweights[kkern - k + krange];
-                weightsum += weight * scratchWeights2[thisIndex];
-                sum += weight * scratchFrame2[thisIndex];
-            }
-            if (weightsum != 0.0f)
-            {
-                scratchFrame[curInd] = sum / weightsum;//NOW we can divide
-            } else {
-                scratchFrame[curInd] = 0.0f;
-            }
-        }//the frame should be zeroed outside the ROI already due to the first time through
     }
 }
 
@@ -23,26 +23,42 @@
 
 #include "AbstractAlgorithm.h"
 
+#include <complex>
+
 namespace caret {
     
+    class CaretFFT3D;
+    
     class AlgorithmVolumeSmoothing : public AbstractAlgorithm
     {
         AlgorithmVolumeSmoothing();
         static bool haveWarned;
+    public:
+        enum FFTMode
+        {
+            FFT_AUTO,//use FFT convolution when it is estimated to be faster and the padded volume is not too large
+            FFT_NEVER,
+            FFT_ALWAYS
+        };
     protected:
         static float getSubAlgorithmWeight();
         static float getAlgorithmInternalWeight();
-        void smoothFrame(const float* inFrame, std::vector<int64_t> myDims, CaretArray<float> scratchFrame, CaretArray<float> scratchFrame2, CaretArray<float> scratchWeights,
-                         CaretArray<float> scratchWeights2, const VolumeFile* inVol, CaretArray<float> iweights, CaretArray<float> jweights, CaretArray<float> kweights,
-                         int irange, int jrange, int krange, const bool& fixZeros);
-        void smoothFrameROI(const float* inFrame, std::vector<int64_t> myDims, CaretArray<float> scratchFrame, CaretArray<float> scratchFrame2, CaretArray<float> scratchFrame3,
-                                              CaretArray<float> scratchWeights, CaretArray<float> scratchWeights2, std::vector<int> lists[3],
-                                              const VolumeFile* inVol, const VolumeFile* roiVol, CaretArray<float> iweights, CaretArray<float> jweights, CaretArray<float> kweights,
-                                              int irange, int jrange, int krange, const bool& fixZeros);
+        enum SmoothEngine
+        {
+            SEPARABLE,
+            DIRECT,
+            FFT
+        };
+        void smoothFrameSeparable(const float* inFrame, const std::vector<int64_t>& myDims, float* outFrame, const float* roiFrame, const int64_t roiBox[6],
+                                  float* scratchSum, float* scratchWeights, float* scratchSum2, float* scratchWeights2,
+                                  const float* iweights, const float* jweights, const float* kweights, const int& irange, const int& jrange, const int& krange, const bool& fixZeros);
+        void smoothFrameFFT(const float* inFrame, const std::vector<int64_t>& myDims, float* outFrame, const float* roiFrame, const CaretFFT3D& myFFT,
+                            const std::vector<double>& kernelFFT, const double& minWeight, const bool& fixZeros, std::vector<std::complex<double> >& scratch);
         void smoothFrameNonOrth(const float* inFrame, const std::vector<int64_t>& myDims, CaretArray<float>& scratchFrame, const VolumeFile* inVol, const VolumeFile* roiVol, const CaretArray<float**>& weights, const int& irange, const int& jrange, const int& krange, const bool& fixZeros);
     public:
         AlgorithmVolumeSmoothing(ProgressObject* myProgObj, const VolumeFile* inVol, const float& kernel, VolumeFile* outVol,
-                                 const VolumeFile* roiVol = NULL, const bool& fixZeros = false, const int& subvol = -1);
+                                 const VolumeFile* roiVol = NULL, const bool& fixZeros = false, const int& subvol = -1,
+                                 const FFTMode& fftMode = FFT_AUTO);//fftMode is for comparing the smoothing engines against each other
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
@@ -30,6 +30,7 @@
 #include "Vector3D.h"
 #include "VolumeFile.h"
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 
@@ -388,75 +389,45 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
             weightsOut->setValue(vertexWeights[i].weight, vertexWeights[i].ijk);
         }
     }
-    CaretArray<float> myScratchArray(numNodes);
-    float* myScratch = myScratchArray.getArray();
-    if (mySubVol == -1)
+    RibbonMappingWeights compactWeights(myWeights, myVolDims.data());//sparse matrix form, so each block of frames is one pass over the weights
+    vector<int64_t> colBrick(numColumns), colComponent(numColumns);
+    for (int64_t thisCol = 0; thisCol < numColumns; ++thisCol)
     {
-        for (int64_t i = 0; i < myVolDims[3]; ++i)
+        int64_t i = mySubVol, j = thisCol;
+        if (mySubVol == -1)
         {
-            for (int64_t j = 0; j < myVolDims[4]; ++j)
-            {
-                int64_t thisCol = i * myVolDims[4] + j;
-                AString metricLabel = myVolume->getMapName(i);
-                if (myVolDims[4] != 1)
-                {
-                    metricLabel += " component " + AString::number(j);
-                }
-                metricLabel += " ribbon constrained";
-                myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR schedule(dynamic)
-                for (int64_t node = 0; node < numNodes; ++node)
-                {
-                    myScratch[node] = 0.0f;
-                    float totalWeight = 0.0f;
-                    int numVoxels = (int)myWeights[node].size();
-                    for (int voxel = 0; voxel < numVoxels; ++voxel)
-                    {
-                        float thisWeight = myWeights[node][voxel].weight;
-                        totalWeight += thisWeight;
-                        myScratch[node] += thisWeight * myVolume->getValue(myWeights[node][voxel].ijk, i, j);
-                    }
-                    if (totalWeight != 0.0f)
-                    {
-                        myScratch[node] /= totalWeight;
-                    } else {
-                        myScratch[node] = 0.0f;
-                    }
-                }
-                myMetricOut->setValuesForColumn(thisCol, myScratch);
-            }
+            i = thisCol / myVolDims[4];
+            j = thisCol % myVolDims[4];
         }
-    } else {
-        for (int64_t j = 0; j < myVolDims[4]; ++j)
+        colBrick[thisCol] = i;
+        colComponent[thisCol] = j;
+        AString metricLabel = myVolume->getMapName(i);
+        if (myVolDims[4] != 1)
+        {
+            metricLabel += " component " + AString::number(j);
+        }
+        metricLabel += " ribbon constrained";
+        myMetricOut->setColumnName(thisCol, metricLabel);
+    }
+    const int64_t FRAME_BLOCK = 32;
+    int64_t blockSize = min(numColumns, FRAME_BLOCK);
+    vector<const float*> framePointers(blockSize);
+    vector<float> blockOut(numNodes * blockSize), myScratch(numNodes);
+    for (int64_t start = 0; start < numColumns; start += blockSize)
+    {
+        int64_t thisBlock = min(blockSize, numColumns - start);
+        for (int64_t b = 0; b < thisBlock; ++b)
+        {
+            framePointers[b] = myVolume->getFrame(colBrick[start + b], colComponent[start + b]);
+        }
+        compactWeights.mapFrames(framePointers.data(), thisBlock, blockOut.data());
+        for (int64_t b = 0; b < thisBlock; ++b)
         {
-            AString metricLabel = myVolume->getMapName(mySubVol);
-            if (myVolDims[4] != 1)
-            {
-                metricLabel += " component " + AString::number(j);
-            }
-            metricLabel += " ribbon constrained";
-            int64_t thisCol = j;
-            myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR schedule(dynamic)
             for (int64_t node = 0; node < numNodes; ++node)
             {
-                    myScratch[node] = 0.0f;
-                    float totalWeight = 0.0f;
-                    int numVoxels = (int)myWeights[node].size();
-                    for (int voxel = 0; voxel < numVoxels; ++voxel)
-                    {
-                        float thisWeight = myWeights[node][voxel].weight;
-                        totalWeight += thisWeight;
-                        myScratch[node] += thisWeight * myVolume->getValue(myWeights[node][voxel].ijk, mySubVol, j);
-                    }
-                    if (totalWeight != 0.0f)
-                    {
-                        myScratch[node] /= totalWeight;
-                    } else {
-                        myScratch[node] = 0.0f;
-                    }
+                myScratch[node] = blockOut[node * thisBlock + b];
             }
-            myMetricOut->setValuesForColumn(thisCol, myScratch);
+            myMetricOut->setValuesForColumn(start + b, myScratch.data());
         }
     }
 }
@@ -0,0 +1,326 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AlgorithmVolumeToSurfaceMappingStream.h"
+#include "AlgorithmException.h"
+
+#include "CaretBinaryFile.h"
+#include "CaretLogger.h"
+#include "CiftiFile.h"
+#include "MetricFile.h"
+#include "NiftiIO.h"
+#include "RibbonMappingHelper.h"
+#include "SurfaceFile.h"
+#include "VolumeFile.h"
+#include "VolumeSpace.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+AString AlgorithmVolumeToSurfaceMappingStream::getCommandSwitch()
+{
+    return "-volume-to-surface-mapping-stream";
+}
+
+AString AlgorithmVolumeToSurfaceMappingStream::getShortDescription()
+{
+    return "RIBBON MAP A LARGE VOLUME TO SURFACE IN BLOCKS OF FRAMES";
+}
+
+OperationParameters* AlgorithmVolumeToSurfaceMappingStream::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    ret->addStringParameter(1, "volume", "the volume file to map data from");
+    
+    ret->addSurfaceParameter(2, "surface", "the surface to map the data onto");
+    
+    ret->addSurfaceParameter(3, "inner-surf", "the inner surface of the ribbon");
+    
+    ret->addSurfaceParameter(4, "outer-surf", "the outer surface of the ribbon");
+    
+    OptionalParameter* metricOutOpt = ret->createOptionalParameter(5, "-metric-out", "output a metric file");
+    metricOutOpt->addMetricOutputParameter(1, "metric-out", "the output metric file");
+    
+    OptionalParameter* ciftiOutOpt = ret->createOptionalParameter(6, "-cifti-out", "output a dtseries cifti file");
+    ciftiOutOpt->addCiftiOutputParameter(1, "cifti-out", "the output cifti file");
+    OptionalParameter* seriesOpt = ciftiOutOpt->createOptionalParameter(2, "-series", "set the timestep and start of the output series");
+    seriesOpt->addDoubleParameter(1, "step", "increment between frames, in seconds (default 1)");
+    seriesOpt->addDoubleParameter(2, "start", "time of the first frame, in seconds (default 0)");
+    
+    OptionalParameter* roiVol = ret->createOptionalParameter(7, "-volume-roi", "use a volume roi");
+    roiVol->addVolumeParameter(1, "roi-volume", "the volume file");
+    
+    OptionalParameter* ribbonSubdiv = ret->createOptionalParameter(8, "-voxel-subdiv", "voxel divisions while estimating voxel weights");
+    ribbonSubdiv->addIntegerParameter(1, "subdiv-num", "number of subdivisions, default 3");
+    
+    OptionalParameter* memLimitOpt = ret->createOptionalParameter(9, "-mem-limit", "restrict memory used for blocks of input frames");
+    memLimitOpt->addDoubleParameter(1, "limit-GB", "memory limit in gigabytes, default 1");
+    
+    ret->setHelpText(
+        AString("Does the same mapping as -volume-to-surface-mapping with -ribbon-constrained, but without loading the whole input volume into memory.  ") +
+        "The ribbon weights are computed once, and then the input is read a block of frames at a time, as many frames as fit in the memory limit.  " +
+        "The output is the same as the ribbon method, but any map names in the input volume are not copied.\n\n" +
+        "At least one of -metric-out and -cifti-out must be specified.  " +
+        "The cifti output contains all vertices of <surface>, with the structure of <surface>.  " +
+        "Because cifti rows are vertex time courses, when there is more than one block, each mapped block is written to a scratch file next to the cifti output, " +
+        "and the rows are assembled from it afterwards, as many rows at a time as fit in the memory limit.  " +
+        "A metric file must be in memory in its entirety before it can be written, so -metric-out holds the mapped data for all frames.\n\n" +
+        "Only uncompressed or gzipped NIfTI files with one component per voxel are supported, and only the first 4 dimensions are used.  " +
+        "The -resample-cache global option also applies to the ribbon weights computed here."
+    );
+    return ret;
+}
+
+void AlgorithmVolumeToSurfaceMappingStream::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    AString volumeFileName = myParams->getString(1);
+    SurfaceFile* mySurface = myParams->getSurface(2);
+    SurfaceFile* innerSurf = myParams->getSurface(3);
+    SurfaceFile* outerSurf = myParams->getSurface(4);
+    MetricFile* myMetricOut = NULL;
+    OptionalParameter* metricOutOpt = myParams->getOptionalParameter(5);
+    if (metricOutOpt->m_present)
+    {
+        myMetricOut = metricOutOpt->getOutputMetric(1);
+    }
+    CiftiFile* myCiftiOut = NULL;
+    float timestep = 1.0f, timestart = 0.0f;
+    OptionalParameter* ciftiOutOpt = myParams->getOptionalParameter(6);
+    if (ciftiOutOpt->m_present)
+    {
+        myCiftiOut = ciftiOutOpt->getOutputCifti(1);
+        OptionalParameter* seriesOpt = ciftiOutOpt->getOptionalParameter(2);
+        if (seriesOpt->m_present)
+        {
+            timestep = (float)seriesOpt->getDouble(1);
+            timestart = (float)seriesOpt->getDouble(2);
+        }
+    }
+    VolumeFile* myRoiVol = NULL;
+    OptionalParameter* roiVol = myParams->getOptionalParameter(7);
+    if (roiVol->m_present)
+    {
+        myRoiVol = roiVol->getVolume(1);
+    }
+    int32_t subdivisions = 3;
+    OptionalParameter* ribbonSubdiv = myParams->getOptionalParameter(8);
+    if (ribbonSubdiv->m_present)
+    {
+        subdivisions = ribbonSubdiv->getInteger(1);
+        if (subdivisions < 1)
+        {
+            throw AlgorithmException("invalid number of subdivisions specified");
+        }
+    }
+    float memLimitGB = 1.0f;
+    OptionalParameter* memLimitOpt = myParams->getOptionalParameter(9);
+    if (memLimitOpt->m_present)
+    {
+        memLimitGB = (float)memLimitOpt->getDouble(1);
+        if (memLimitGB <= 0.0f)
+        {
+            throw AlgorithmException("memory limit must be positive");
+        }
+    }
+    AlgorithmVolumeToSurfaceMappingStream(myProgObj, volumeFileName, mySurface, innerSurf, outerSurf, myMetricOut, myCiftiOut, myRoiVol, subdivisions, memLimitGB, timestep, timestart);
+}
+
+AlgorithmVolumeToSurfaceMappingStream::AlgorithmVolumeToSurfaceMappingStream(ProgressObject* myProgObj, const AString& volumeFileName, const SurfaceFile* mySurface,
+                                                                             const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, MetricFile* myMetricOut, CiftiFile* myCiftiOut,
+                                                                             const VolumeFile* roiVol, const int32_t& subdivisions, const float& memLimitGB,
+                                                                             const float& timestep, const float& timestart) : AbstractAlgorithm(myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    if (myMetricOut == NULL && myCiftiOut == NULL)
+    {
+        throw AlgorithmException("at least one of -metric-out and -cifti-out must be specified");
+    }
+    if (!mySurface->hasNodeCorrespondence(*outerSurf) || !mySurface->hasNodeCorrespondence(*innerSurf))
+    {
+        throw AlgorithmException("all surfaces must have vertex correspondence");
+    }
+    NiftiIO myIO;
+    myIO.openRead(volumeFileName);//not mapped, so file pages don't add to resident memory
+    if (myIO.getNumComponents() != 1)
+    {
+        throw AlgorithmException("input volume must have one component per voxel");
+    }
+    vector<int64_t> myDims = myIO.getDimensions();
+    int fullDims = 3;
+    if (myDims.size() < 3) fullDims = (int)myDims.size();
+    while (myDims.size() < 3) myDims.push_back(1);
+    int64_t numFrames = (myDims.size() > 3 ? myDims[3] : 1);
+    for (int i = 4; i < (int)myDims.size(); ++i)
+    {
+        if (myDims[i] != 1) throw AlgorithmException("input volume has more than 4 dimensions");
+    }
+    VolumeSpace mySpace(myDims.data(), myIO.getHeader().getSForm());
+    const float* roiFrame = NULL;
+    if (roiVol != NULL)
+    {
+        if (!roiVol->getVolumeSpace().matches(mySpace))
+        {
+            throw AlgorithmException("roi volume is not in the same volume space as input volume");
+        }
+        roiFrame = roiVol->getFrame();
+    }
+    int64_t numNodes = mySurface->getNumberOfNodes();
+    if (myCiftiOut != NULL)
+    {
+        if (mySurface->getStructure() == StructureEnum::INVALID)
+        {
+            throw AlgorithmException("surface must have a structure set for cifti output");
+        }
+        CiftiBrainModelsMap denseMap;
+        denseMap.addSurfaceModel(numNodes, mySurface->getStructure());
+        CiftiSeriesMap seriesMap;
+        seriesMap.setUnit(CiftiSeriesMap::SECOND);
+        seriesMap.setStart(timestart);
+        seriesMap.setStep(timestep);
+        seriesMap.setLength(numFrames);
+        CiftiXML myXML;
+        myXML.setNumberOfDimensions(2);
+        myXML.setMap(CiftiXML::ALONG_COLUMN, denseMap);
+        myXML.setMap(CiftiXML::ALONG_ROW, seriesMap);
+        myCiftiOut->setCiftiXML(myXML);
+    }
+    if (myMetricOut != NULL)
+    {
+        myMetricOut->setNumberOfNodesAndColumns(numNodes, numFrames);
+        myMetricOut->setStructure(mySurface->getStructure());
+    }
+    vector<vector<VoxelWeight> > myWeights;
+    RibbonMappingHelper::computeWeightsRibbon(myWeights, mySpace, innerSurf, outerSurf, roiFrame, subdivisions);
+    RibbonMappingWeights compactWeights(myWeights, myDims.data());
+    myWeights.clear();
+    const int64_t memLimitBytes = (int64_t)(memLimitGB * 1024 * 1024 * 1024);
+    int64_t frameSize = myDims[0] * myDims[1] * myDims[2];
+    int64_t blockFrames = max((int64_t)1, min(numFrames, memLimitBytes / (int64_t)(frameSize * sizeof(float))));
+    int64_t numBlocks = (numFrames + blockFrames - 1) / blockFrames;
+    CaretLogFine("mapping " + AString::number(numFrames) + " frames in blocks of " + AString::number(blockFrames));
+    vector<float> frameBlock(frameSize * blockFrames), blockOut(numNodes * blockFrames), scratch(numNodes);
+    vector<const float*> framePointers(blockFrames);
+    for (int64_t b = 0; b < blockFrames; ++b)
+    {
+        framePointers[b] = frameBlock.data() + b * frameSize;
+    }
+    //cifti rows are vertex time courses, so with more than one block, write each finished block to a scratch file and assemble the rows afterwards
+    CaretBinaryFile scratchFile;
+    AString scratchName;
+    if (myCiftiOut != NULL && numBlocks > 1)
+    {
+        AString scratchBase = myCiftiOut->getFileName();
+        if (scratchBase == "") scratchBase = QDir::tempPath() + "/wb_volume_mapping_stream";
+        scratchName = scratchBase + "." + AString::number(QCoreApplication::applicationPid()) + ".blocks";
+        scratchFile.open(scratchName, CaretBinaryFile::READ_WRITE_TRUNCATE);
+    }
+    try
+    {
+        vector<int64_t> indexSelect(myDims.size() - 3, 0);
+        for (int64_t start = 0; start < numFrames; start += blockFrames)
+        {
+            int64_t thisBlock = min(blockFrames, numFrames - start);
+            for (int64_t b = 0; b < thisBlock; ++b)
+            {
+                if (!indexSelect.empty()) indexSelect[0] = start + b;
+                myIO.readData(frameBlock.data() + b * frameSize, fullDims, indexSelect);
+            }
+            compactWeights.mapFrames(framePointers.data(), thisBlock, blockOut.data());//vertex-major
+            if (myMetricOut != NULL)
+            {
+                for (int64_t b = 0; b < thisBlock; ++b)
+                {
+                    for (int64_t node = 0; node < numNodes; ++node)
+                    {
+                        scratch[node] = blockOut[node * thisBlock + b];
+                    }
+                    myMetricOut->setColumnName(start + b, "#" + AString::number(start + b + 1) + " ribbon constrained");
+                    myMetricOut->setValuesForColumn(start + b, scratch.data());
+                }
+            }
+            if (myCiftiOut != NULL)
+            {
+                if (numBlocks == 1)
+                {//the block has whole rows
+                    for (int64_t node = 0; node < numNodes; ++node)
+                    {
+                        myCiftiOut->setRow(blockOut.data() + node * numFrames, node);
+                    }
+                } else {
+                    scratchFile.writeAt(blockOut.data(), numNodes * thisBlock * sizeof(float), numNodes * start * sizeof(float));
+                }
+            }
+        }
+        myIO.close();
+        if (myCiftiOut != NULL && numBlocks > 1)
+        {//each block has a contiguous run of frames for every vertex, so a group of rows needs one read per block
+            frameBlock = vector<float>();//free the input frames before making the rows
+            int64_t groupRows = max((int64_t)1, min(numNodes, memLimitBytes / (int64_t)(numFrames * sizeof(float))));
+            vector<float> rowGroup(groupRows * numFrames);
+            for (int64_t groupStart = 0; groupStart < numNodes; groupStart += groupRows)
+            {
+                int64_t thisGroup = min(groupRows, numNodes - groupStart);
+                for (int64_t start = 0; start < numFrames; start += blockFrames)
+                {
+                    int64_t thisBlock = min(blockFrames, numFrames - start);
+                    scratchFile.readAt(blockOut.data(), thisGroup * thisBlock * sizeof(float), (numNodes * start + groupStart * thisBlock) * sizeof(float));
+                    for (int64_t node = 0; node < thisGroup; ++node)
+                    {
+                        for (int64_t b = 0; b < thisBlock; ++b)
+                        {
+                            rowGroup[node * numFrames + start + b] = blockOut[node * thisBlock + b];
+                        }
+                    }
+                }
+                for (int64_t node = 0; node < thisGroup; ++node)
+                {
+                    myCiftiOut->setRow(rowGroup.data() + node * numFrames, groupStart + node);
+                }
+            }
+            scratchFile.close();
+            QFile::remove(scratchName);
+        }
+    } catch (...) {
+        if (scratchName != "")
+        {
+            scratchFile.close();
+            QFile::remove(scratchName);
+        }
+        throw;
+    }
+}
+
+float AlgorithmVolumeToSurfaceMappingStream::getAlgorithmInternalWeight()
+{
+    return 1.0f;//override this if needed, if the progress bar isn't smooth
+}
+
+float AlgorithmVolumeToSurfaceMappingStream::getSubAlgorithmWeight()
+{
+    //return AlgorithmInsertNameHere::getAlgorithmWeight();//if you use a subalgorithm
+    return 0.0f;
+}
@@ -0,0 +1,49 @@
+#ifndef __ALGORITHM_VOLUME_TO_SURFACE_MAPPING_STREAM_H__
+#define __ALGORITHM_VOLUME_TO_SURFACE_MAPPING_STREAM_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AbstractAlgorithm.h"
+
+namespace caret {
+    
+    class AlgorithmVolumeToSurfaceMappingStream : public AbstractAlgorithm
+    {
+        AlgorithmVolumeToSurfaceMappingStream();
+    protected:
+        static float getSubAlgorithmWeight();
+        static float getAlgorithmInternalWeight();
+    public:
+        AlgorithmVolumeToSurfaceMappingStream(ProgressObject* myProgObj, const AString& volumeFileName, const SurfaceFile* mySurface,
+                                              const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, MetricFile* myMetricOut, CiftiFile* myCiftiOut,
+                                              const VolumeFile* roiVol = NULL, const int32_t& subdivisions = 3, const float& memLimitGB = 1.0f,
+                                              const float& timestep = 1.0f, const float& timestart = 0.0f);
+        static OperationParameters* getParameters();
+        static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
+        static AString getCommandSwitch();
+        static AString getShortDescription();
+    };
+
+    typedef TemplateAutoOperation<AlgorithmVolumeToSurfaceMappingStream> AutoAlgorithmVolumeToSurfaceMappingStream;
+
+}
+
+#endif //__ALGORITHM_VOLUME_TO_SURFACE_MAPPING_STREAM_H__
@@ -0,0 +1,210 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiColumnSidecar.h"
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CaretProfiler.h"
+#include "CiftiFile.h"
+#include "DataFileException.h"
+#include "FileInformation.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+QString CiftiColumnSidecar::s_directory;
+bool CiftiColumnSidecar::s_autoBuild = false;
+
+namespace
+{
+    //sidecar layout, native byte order: header, then float32 columns of numRows values each, in column order
+    const char SIDECAR_MAGIC[8] = { 'w', 'b', 'c', 'o', 'l', 'u', 'm', 'n' };
+    const int32_t SIDECAR_VERSION = 1;
+    const int32_t SIDECAR_BYTE_ORDER = 0x01020304;
+    QAtomicInt s_tempCounter(0);//batch lines in one process can build the same sidecar at once
+
+    struct SidecarHeader
+    {
+        char magic[8];
+        int32_t version;
+        int32_t byteOrder;
+        int64_t numRows;
+        int64_t numCols;
+        int64_t sourceSize;//the cifti file when the sidecar was built, so a rewritten file doesn't use stale data
+        int64_t sourceModified;//milliseconds since epoch
+        char sourceSample[24];//sha1 of the start and end of the file, for rewrites within the timestamp resolution, zero padded
+    };
+
+    void getSourceInfo(const QString& ciftiFileName, int64_t& sizeOut, int64_t& modifiedOut, char sampleOut[24])
+    {
+        QFileInfo myInfo(ciftiFileName);
+        sizeOut = myInfo.size();
+        modifiedOut = myInfo.lastModified().toMSecsSinceEpoch();
+        const int64_t SAMPLE_BYTES = 65536;//covers the header and xml of most files
+        QCryptographicHash hasher(QCryptographicHash::Sha1);
+        QFile myFile(ciftiFileName);
+        if (myFile.open(QIODevice::ReadOnly))
+        {
+            hasher.addData(myFile.read(SAMPLE_BYTES));
+            if (sizeOut > SAMPLE_BYTES && myFile.seek(max(SAMPLE_BYTES, sizeOut - SAMPLE_BYTES)))
+            {
+                hasher.addData(myFile.read(SAMPLE_BYTES));
+            }
+        }
+        memset(sampleOut, 0, 24);
+        QByteArray result = hasher.result();
+        memcpy(sampleOut, result.constData(), min(result.size(), 24));
+    }
+}
+
+CiftiColumnSidecar::CiftiColumnSidecar()
+{
+    m_mapped = NULL;
+    m_numRows = 0;
+    m_numCols = 0;
+}
+
+QString CiftiColumnSidecar::getSidecarFileName(const QString& ciftiFileName)
+{
+    QString canonical = FileInformation(ciftiFileName).getCanonicalFilePath();
+    if (canonical == "") canonical = FileInformation(ciftiFileName).getAbsoluteFilePath();
+    if (s_directory == "") return canonical + ".wbcolumns";
+    QString hashed(QCryptographicHash::hash(canonical.toUtf8(), QCryptographicHash::Sha1).toHex());//different directories can have files with the same name
+    return s_directory + "/" + QFileInfo(canonical).fileName() + "." + hashed + ".wbcolumns";
+}
+
+CaretPointer<CiftiColumnSidecar> CiftiColumnSidecar::open(const QString& ciftiFileName, const int64_t& numRows, const int64_t& numCols)
+{
+    CaretAssert(sizeof(SidecarHeader) == 72);
+    CaretPointer<CiftiColumnSidecar> ret;
+    QString sidecarName = getSidecarFileName(ciftiFileName);
+    if (!QFile::exists(sidecarName)) return ret;
+    CaretPointer<CiftiColumnSidecar> candidate(new CiftiColumnSidecar());
+    SidecarHeader myHeader;
+    int64_t fileSize = QFileInfo(sidecarName).size();
+    try
+    {
+        if (fileSize < (int64_t)sizeof(SidecarHeader)) throw DataFileException("file is too short");
+        candidate->m_file.open(sidecarName);
+        candidate->m_file.readAt(&myHeader, sizeof(SidecarHeader), 0);
+    } catch (CaretException& e) {
+        CaretLogFine("ignoring cifti column sidecar '" + sidecarName + "': " + e.whatString());
+        return ret;
+    }
+    int64_t sourceSize, sourceModified;
+    char sourceSample[24];
+    getSourceInfo(ciftiFileName, sourceSize, sourceModified, sourceSample);
+    if (memcmp(myHeader.magic, SIDECAR_MAGIC, 8) != 0 || myHeader.version != SIDECAR_VERSION || myHeader.byteOrder != SIDECAR_BYTE_ORDER ||
+        myHeader.numRows != numRows || myHeader.numCols != numCols || fileSize != (int64_t)sizeof(SidecarHeader) + numRows * numCols * (int64_t)sizeof(float))
+    {
+        CaretLogFine("ignoring cifti column sidecar '" + sidecarName + "': wrong format or size");
+        return ret;
+    }
+    if (myHeader.sourceSize != sourceSize || myHeader.sourceModified != sourceModified || memcmp(myHeader.sourceSample, sourceSample, 24) != 0)
+    {
+        CaretLogFine("ignoring cifti column sidecar '" + sidecarName + "': cifti file has changed since it was built");
+        return ret;
+    }
+    candidate->m_numRows = numRows;
+    candidate->m_numCols = numCols;
+    int64_t mappedSize = 0;
+    const char* mapped = candidate->m_file.mapForRead(mappedSize);
+    if (mapped != NULL && mappedSize == fileSize)
+    {
+        candidate->m_mapped = (const float*)(mapped + sizeof(SidecarHeader));
+    }
+    CaretLogFine("using cifti column sidecar '" + sidecarName + "'");
+    ret = candidate;
+    return ret;
+}
+
+void CiftiColumnSidecar::build(const CiftiFile& ciftiFile, const QString& ciftiFileName, const int64_t& memLimitBytes)
+{
+    CaretProfileScope myProfile("cifti column sidecar build");
+    const vector<int64_t>& dims = ciftiFile.getDimensions();
+    if (dims.size() != 2) throw DataFileException("column sidecars are only supported for 2D cifti files");
+    const int64_t numRows = dims[1], numCols = dims[0];
+    SidecarHeader myHeader;
+    memset(&myHeader, 0, sizeof(SidecarHeader));
+    memcpy(myHeader.magic, SIDECAR_MAGIC, 8);
+    myHeader.version = SIDECAR_VERSION;
+    myHeader.byteOrder = SIDECAR_BYTE_ORDER;
+    myHeader.numRows = numRows;
+    myHeader.numCols = numCols;
+    getSourceInfo(ciftiFileName, myHeader.sourceSize, myHeader.sourceModified, myHeader.sourceSample);//before reading, so changes during the build make it stale
+    QString sidecarName = getSidecarFileName(ciftiFileName);
+    QString tempName = sidecarName + "." + QString::number(QCoreApplication::applicationPid()) + "." + QString::number(s_tempCounter.fetchAndAddOrdered(1)) + ".tmp";//other processes and threads never see a partial file
+    int64_t colsPerPass = max((int64_t)1, min(numCols, memLimitBytes / (int64_t)sizeof(float) / numRows));
+    int64_t numPasses = (numCols + colsPerPass - 1) / colsPerPass;
+    if (numPasses > 1) CaretLogInfo("building cifti column sidecar for '" + ciftiFileName + "' in " + QString::number(numPasses) + " passes");
+    try
+    {
+        CaretBinaryFile outFile(tempName, CaretBinaryFile::WRITE_TRUNCATE);
+        outFile.write(&myHeader, sizeof(SidecarHeader));
+        vector<float> rowScratch(numCols), block(colsPerPass * numRows);
+        for (int64_t colStart = 0; colStart < numCols; colStart += colsPerPass)
+        {
+            const int64_t colEnd = min(numCols, colStart + colsPerPass), blockCols = colEnd - colStart;
+            for (int64_t row = 0; row < numRows; ++row)
+            {//rows are sequential reads, and usually come straight out of the memory mapping
+                ciftiFile.getRow(rowScratch.data(), row);
+                for (int64_t col = 0; col < blockCols; ++col)
+                {
+                    block[col * numRows + row] = rowScratch[colStart + col];
+                }
+            }
+            outFile.write(block.data(), blockCols * numRows * sizeof(float));//columns in a pass are contiguous in the sidecar, so the file is written in order
+        }
+        outFile.close();
+    } catch (CaretException& e) {
+        QFile::remove(tempName);
+        throw DataFileException("failed to write cifti column sidecar '" + sidecarName + "': " + e.whatString());
+    }
+    QFile::remove(sidecarName);//rename won't overwrite
+    if (!QFile::rename(tempName, sidecarName))
+    {
+        QFile::remove(tempName);
+        throw DataFileException("failed to rename cifti column sidecar into place: '" + sidecarName + "'");
+    }
+    CaretLogFine("saved cifti column sidecar '" + sidecarName + "'");
+}
+
+void CiftiColumnSidecar::getColumn(float* dataOut, const int64_t& index) const
+{
+    CaretAssert(index >= 0 && index < m_numCols);
+    if (m_mapped != NULL)
+    {
+        memcpy(dataOut, m_mapped + index * m_numRows, m_numRows * sizeof(float));
+    } else {
+        m_file.readAt(dataOut, m_numRows * sizeof(float), sizeof(SidecarHeader) + index * m_numRows * (int64_t)sizeof(float));
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef __CIFTI_COLUMN_SIDECAR_H__
+#define __CIFTI_COLUMN_SIDECAR_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretBinaryFile.h"
+#include "CaretPointer.h"
+
+#include <QString>
+
+#include "stdint.h"
+
+namespace caret
+{
+
+    class CiftiFile;
+
+    ///column-major copy of the data of a 2D on-disk cifti file, so that getColumn is one contiguous read instead of one read per row
+    ///stored next to the cifti file as <file>.wbcolumns, or in the sidecar directory if one is set, and ignored once the cifti file changes
+    class CiftiColumnSidecar
+    {
+        mutable CaretBinaryFile m_file;//positional reads are thread safe, but not const
+        const float* m_mapped;//NULL if the file couldn't be mapped
+        int64_t m_numRows, m_numCols;
+        static QString s_directory;
+        static bool s_autoBuild;
+        CiftiColumnSidecar();
+    public:
+        ///where sidecars are found and written, empty for next to the cifti file
+        static void setDirectory(const QString& directory) { s_directory = directory; }
+        static const QString& getDirectory() { return s_directory; }
+
+        ///whether CiftiFile builds a sidecar the first time getColumn is used on an on-disk file without one
+        static void setAutoBuild(const bool& autoBuild) { s_autoBuild = autoBuild; }
+        static bool getAutoBuild() { return s_autoBuild; }
+
+        static QString getSidecarFileName(const QString& ciftiFileName);
+
+        ///returns NULL if there is no usable sidecar for this file and matrix size, including when the cifti file was modified after the sidecar was built
+        static CaretPointer<CiftiColumnSidecar> open(const QString& ciftiFileName, const int64_t& numRows, const int64_t& numCols);
+
+        ///reads the rows of the file in as few passes as fit in memLimitBytes, writes to a temporary file and renames it into place
+        static void build(const CiftiFile& ciftiFile, const QString& ciftiFileName, const int64_t& memLimitBytes = ((int64_t)512) << 20);
+
+        ///thread safe
+        void getColumn(float* dataOut, const int64_t& index) const;
+    };
+
+}
+
+#endif //__CIFTI_COLUMN_SIDECAR_H__
@@ -24,12 +24,18 @@
 #include "CaretAssert.h"
 #include "CaretHttpManager.h"
 #include "CaretLogger.h"
+#include "CaretProfiler.h"
+#include "CiftiRemoteBlockCache.h"
 #include "DataFileException.h"
 #include "FileInformation.h"
 #include "MultiDimArray.h"
 #include "MultiDimIterator.h"
 #include "NiftiIO.h"
 
+#include <cstring>
+#include <limits>
+#include <list>
+
 using namespace std;
 using namespace caret;
 
@@ -38,20 +44,34 @@ namespace
 {
     class CiftiOnDiskImpl : public CiftiFile::WriteImplInterface
     {
+    protected:
         mutable NiftiIO m_nifti;//because file objects aren't stateless (current position), so reading "changes" them
         CiftiXML m_xml;//because we need to parse it to set up the dimensions anyway
     public:
-        CiftiOnDiskImpl(const QString& filename);//read-only
-        CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, const CiftiVersion& version, const bool& swapEndian);//make new empty file with read/write
+        CiftiOnDiskImpl(const QString& filename, const bool& tryMap = false);//read-only
+        CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, const CiftiVersion& version, const bool& swapEndian,
+                        const int16_t& dataType = NIFTI_TYPE_FLOAT32, const bool& doScale = false, const double& minval = 0.0, const double& maxval = 0.0);//make new empty file with read/write
         void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const;
         void getColumn(float* dataOut, const int64_t& index) const;
         const CiftiXML& getCiftiXML() const { return m_xml; }
         QString getFilename() const { return m_nifti.getFilename(); }
         bool isSwapped() const { return m_nifti.getHeader().isSwapped(); }
+        int16_t getDataType() const { return m_nifti.getHeader().getDataType(); }
+        bool getDataScaling(double& mult, double& offset) const { return m_nifti.getHeader().getDataScaling(mult, offset); }
         void setRow(const float* dataIn, const std::vector<int64_t>& indexSelect);
         void setColumn(const float* dataIn, const int64_t& index);
     };
     
+    class CiftiMappedImpl : public CiftiOnDiskImpl
+    {//read-only, rows of native-endian unscaled float32 files come straight out of the memory mapping
+        bool m_direct;
+        int64_t m_rowLength;
+    public:
+        CiftiMappedImpl(const QString& filename);
+        void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const;
+        const float* getRowPointer(const std::vector<int64_t>& indexSelect) const;
+    };
+    
     class CiftiMemoryImpl : public CiftiFile::WriteImplInterface
     {
         MultiDimArray<float> m_array;
@@ -66,11 +86,33 @@ namespace
     
     class CiftiXnatImpl : public CiftiFile::ReadImplInterface
     {
+        struct RowBlock
+        {
+            int64_t m_index;
+            std::vector<float> m_data;
+        };
+        struct RowRequest
+        {
+            size_t m_block;//index into the blocks being fetched
+            int64_t m_firstRow, m_numRows;//within the block
+        };
         CiftiXML m_xml;//because we need to parse it to check the dimensions anyway
         CaretHttpRequest m_baseRequest;
+        int64_t m_rowsPerBlock;
+        AString m_etag;//empty if the server doesn't send one, which disables the disk cache
+        mutable bool m_rangedRows;//cleared the first time the server ignores row-count, after that blocks are fetched as pipelined single rows
+        mutable int64_t m_lastBlock;//to detect sequential reading, which gets read-ahead
+        mutable std::list<RowBlock> m_blocks;//in memory, most recently used first
+        mutable CaretMutex m_requestMutex;//the http manager isn't thread-safe, and CiftiFile reading needs to be
         void init(const QString& url);
         void getReqAsFloats(float* data, const int64_t& dataSize, CaretHttpRequest& request) const;
         int64_t getSizeFromReq(CaretHttpRequest& request);
+        int64_t getBlockRows(const int64_t& block) const;
+        const RowBlock& getBlock(const int64_t& block) const;//with m_requestMutex locked
+        void fetchBlocks(const std::vector<int64_t>& blocks) const;//ditto
+        void requestRows(const std::vector<int64_t>& blocks, const std::vector<RowRequest>& rowRequests, std::vector<std::vector<float> >& blockData,
+                         std::vector<size_t>& singleRowRepliesOut) const;
+        void addBlock(const int64_t& block, std::vector<float>& data) const;//ditto, swaps data into the memory cache
     public:
         CiftiXnatImpl(const QString& url, const QString& user, const QString& pass);
         CiftiXnatImpl(const QString& url);//reuse existing user/pass, or access non-protected url - in the future, maybe only the second use (private http manager)
@@ -95,6 +137,45 @@ namespace
         return (endian == CiftiFile::ANY);
     }
     
+    bool getIntegerTypeRange(const int16_t& type, double& typeMin, double& typeMax)
+    {
+        switch (type)
+        {
+            case NIFTI_TYPE_UINT8:
+                typeMin = numeric_limits<uint8_t>::min(); typeMax = numeric_limits<uint8_t>::max();
+                return true;
+            case NIFTI_TYPE_INT8:
+                typeMin = numeric_limits<int8_t>::min(); typeMax = numeric_limits<int8_t>::max();
+                return true;
+            case NIFTI_TYPE_UINT16:
+                typeMin = numeric_limits<uint16_t>::min(); typeMax = numeric_limits<uint16_t>::max();
+                return true;
+            case NIFTI_TYPE_INT16:
+                typeMin = numeric_limits<int16_t>::min(); typeMax = numeric_limits<int16_t>::max();
+                return true;
+            case NIFTI_TYPE_UINT32:
+                typeMin = numeric_limits<uint32_t>::min(); typeMax = numeric_limits<uint32_t>::max();
+                return true;
+            case NIFTI_TYPE_INT32:
+                typeMin = numeric_limits<int32_t>::min(); typeMax = numeric_limits<int32_t>::max();
+                return true;
+            default:
+                return false;
+        }
+    }
+    
+    //the header scaling that writing with these settings produces, returns false for no scaling, like NiftiHeader::getDataScaling
+    bool getWriteScaling(const int16_t& type, const bool& doScale, const double& minval, const double& maxval, double& multOut, double& offsetOut)
+    {
+        multOut = 1.0;//if the range is empty, any nonzero slope represents the single value exactly - zero slope means "no scaling" in the nifti spec
+        offsetOut = 0.0;
+        double typeMin, typeMax;
+        if (!doScale || !getIntegerTypeRange(type, typeMin, typeMax)) return false;
+        if (maxval > minval) multOut = (maxval - minval) / (typeMax - typeMin);
+        offsetOut = minval - typeMin * multOut;
+        return !(multOut == 1.0 && offsetOut == 0.0);
+    }
+
 }
 
 CiftiFile::ReadImplInterface::~ReadImplInterface()
@@ -108,26 +189,35 @@ CiftiFile::WriteImplInterface::~WriteImplInterface()
 CiftiFile::CiftiFile(const QString& fileName)
 {
     m_endianPref = NATIVE;
+    m_sidecarBuilding = false;
+    m_sidecarFailed = false;
+    setWritingDataTypeNoScaling();
     openFile(fileName);
 }
 
 void CiftiFile::openFile(const QString& fileName)
 {
+    CaretProfileScope myProfile("cifti open");//includes xml parsing
     m_writingImpl.grabNew(NULL);
     m_readingImpl.grabNew(NULL);//to make sure it closes everything first, even if the open throws
     m_dims.clear();
-    CaretPointer<CiftiOnDiskImpl> newRead(new CiftiOnDiskImpl(FileInformation(fileName).getAbsoluteFilePath()));//this constructor opens existing file read-only
+    CaretPointer<CiftiOnDiskImpl> newRead(new CiftiMappedImpl(FileInformation(fileName).getAbsoluteFilePath()));//opens existing file read-only, falls back to normal reads if it can't map
     m_readingImpl = newRead;//it should be noted that if the constructor throws (if the file isn't readable), new guarantees the memory allocated for the object will be freed
     m_xml = newRead->getCiftiXML();
     m_dims = m_xml.getDimensions();
     m_onDiskVersion = m_xml.getParsedVersion();
     m_fileName = fileName;
+    CaretMutexLocker locked(&m_sidecarMutex);
+    m_columnSidecar.grabNew(NULL);
+    m_sidecarFailed = false;
+    if (m_dims.size() == 2) m_columnSidecar = CiftiColumnSidecar::open(newRead->getFilename(), m_dims[1], m_dims[0]);
 }
 
 void CiftiFile::openURL(const QString& url, const QString& user, const QString& pass)
 {
     m_writingImpl.grabNew(NULL);
     m_readingImpl.grabNew(NULL);//to make sure it closes everything first, even if the open throws
+    m_columnSidecar.grabNew(NULL);
     m_dims.clear();
     CaretPointer<CiftiXnatImpl> newRead(new CiftiXnatImpl(url, user, pass));
     m_readingImpl = newRead;
@@ -140,6 +230,7 @@ void CiftiFile::openURL(const QString& url)
 {
     m_writingImpl.grabNew(NULL);
     m_readingImpl.grabNew(NULL);//to make sure it closes everything first, even if the open throws
+    m_columnSidecar.grabNew(NULL);
     m_dims.clear();
     CaretPointer<CiftiXnatImpl> newRead(new CiftiXnatImpl(url));
     m_readingImpl = newRead;
@@ -157,8 +248,33 @@ void CiftiFile::setWritingFile(const QString& fileName, const CiftiVersion& writ
     m_endianPref = endian;
 }
 
+void CiftiFile::setWritingDataTypeNoScaling(const int16_t& type)
+{
+    double typeMin, typeMax;
+    if (type != NIFTI_TYPE_FLOAT32 && type != NIFTI_TYPE_FLOAT64 && !getIntegerTypeRange(type, typeMin, typeMax))
+    {
+        throw DataFileException("unsupported datatype for writing cifti file: " + QString::number(type));
+    }
+    m_writingDataType = type;
+    m_doWriteScaling = false;
+    m_minScalingVal = 0.0;
+    m_maxScalingVal = 0.0;
+}
+
+void CiftiFile::setWritingDataTypeAndScaling(const int16_t& type, const double& minval, const double& maxval)
+{
+    double typeMin, typeMax;
+    if (!getIntegerTypeRange(type, typeMin, typeMax)) throw DataFileException("data scaling when writing cifti is only supported for integer datatypes");
+    if (!(minval <= maxval)) throw DataFileException("minimum scaling value must not be greater than the maximum");//also catches NaN
+    m_writingDataType = type;
+    m_doWriteScaling = true;
+    m_minScalingVal = minval;
+    m_maxScalingVal = maxval;
+}
+
 void CiftiFile::writeFile(const QString& fileName, const CiftiVersion& writingVersion, const ENDIAN& endian)
 {
+    CaretProfileScope myProfile("cifti write");
     if (m_readingImpl == NULL || m_dims.empty()) throw DataFileException("writeFile called on uninitialized CiftiFile");
     bool writeSwapped = shouldSwap(endian);
     FileInformation myInfo(fileName);
@@ -167,14 +283,21 @@ void CiftiFile::writeFile(const QString& fileName, const CiftiVersion& writingVe
     bool collision = false, hadWriter = (m_writingImpl != NULL);
     if (testImpl != NULL && canonicalFilename != "" && FileInformation(testImpl->getFilename()).getCanonicalFilePath() == canonicalFilename)
     {//empty string test is so that we don't say collision if both are nonexistant - could happen if file is removed/unlinked while reading on some filesystems
-        if (m_onDiskVersion == writingVersion && !m_xml.mutablesModified() && (dontRewrite(endian) || writeSwapped == testImpl->isSwapped())) return;//don't need to copy to itself
+        double fileMult, fileOffset, writeMult, writeOffset;
+        bool fileScaled = testImpl->getDataScaling(fileMult, fileOffset);
+        bool writeScaled = getWriteScaling(m_writingDataType, m_doWriteScaling, m_minScalingVal, m_maxScalingVal, writeMult, writeOffset);
+        bool sameScaling = (fileScaled == writeScaled && fileMult == writeMult && fileOffset == writeOffset);//both are 1 and 0 when not scaled
+        if (m_onDiskVersion == writingVersion && !m_xml.mutablesModified() && (dontRewrite(endian) || writeSwapped == testImpl->isSwapped()) &&
+            testImpl->getDataType() == m_writingDataType && sameScaling) return;//don't need to copy to itself
         collision = true;//we need to copy to memory temporarily
         CaretPointer<WriteImplInterface> tempMemory(new CiftiMemoryImpl(m_xml));
         copyImplData(m_readingImpl, tempMemory, m_dims);
         m_readingImpl = tempMemory;//we are about to make the old reading impl very unhappy, replace it so that if we get an error while writing, we hang onto the memory version
+        m_columnSidecar.grabNew(NULL);//and the file is about to change
         m_writingImpl.grabNew(NULL);//and make it re-magic the writing implementation again if data is set
     }
-    CaretPointer<WriteImplInterface> tempWrite(new CiftiOnDiskImpl(myInfo.getAbsoluteFilePath(), m_xml, writingVersion, writeSwapped));
+    CaretPointer<WriteImplInterface> tempWrite(new CiftiOnDiskImpl(myInfo.getAbsoluteFilePath(), m_xml, writingVersion, writeSwapped,
+                                                                   m_writingDataType, m_doWriteScaling, m_minScalingVal, m_maxScalingVal));
     copyImplData(m_readingImpl, tempWrite, m_dims);
     if (collision)//if we rewrote the file, we need the handle to the new file, and to dump the temporary in-memory version
     {
@@ -197,6 +320,7 @@ void CiftiFile::convertToInMemory()
     copyImplData(m_readingImpl, tempWrite, m_dims);
     m_writingImpl = tempWrite;
     m_readingImpl = tempWrite;
+    m_columnSidecar.grabNew(NULL);
 }
 
 bool CiftiFile::isInMemory() const
@@ -213,6 +337,7 @@ void CiftiFile::getRow(float* dataOut, const vector<int64_t>& indexSelect, const
 {
     if (m_dims.empty()) throw DataFileException("getRow called on uninitialized CiftiFile");
     if (m_readingImpl == NULL) return;//NOT an error because we are pretending to have a matrix already, while we are waiting for setRow to actually start writing the file
+    CaretProfiler::addCounter("cifti rows read");
     m_readingImpl->getRow(dataOut, indexSelect, tolerateShortRead);
 }
 
@@ -221,7 +346,71 @@ void CiftiFile::getColumn(float* dataOut, const int64_t& index) const
     if (m_dims.empty()) throw DataFileException("getColumn called on uninitialized CiftiFile");
     if (m_dims.size() != 2) throw DataFileException("getColumn called on non-2D CiftiFile");
     if (m_readingImpl == NULL) return;//NOT an error because we are pretending to have a matrix already, while we are waiting for setRow to actually start writing the file
-    m_readingImpl->getColumn(dataOut, index);
+    CaretProfiler::addCounter("cifti columns read");
+    CaretPointer<CiftiColumnSidecar> mySidecar = getColumnSidecar();
+    if (mySidecar != NULL)
+    {
+        mySidecar->getColumn(dataOut, index);
+    } else {
+        m_readingImpl->getColumn(dataOut, index);
+    }
+}
+
+CaretPointer<CiftiColumnSidecar> CiftiFile::getColumnSidecar() const
+{
+    AString fileName;
+    {
+        CaretMutexLocker locked(&m_sidecarMutex);//copy the pointer while locked, so another thread finishing a build can't swap it out from under us
+        if (m_columnSidecar != NULL || m_sidecarBuilding || m_sidecarFailed || !CiftiColumnSidecar::getAutoBuild()) return m_columnSidecar;
+        const CiftiMappedImpl* readOnlyImpl = dynamic_cast<const CiftiMappedImpl*>(m_readingImpl.getPointer());
+        if (readOnlyImpl == NULL || m_writingImpl != NULL || m_dims.size() != 2) return m_columnSidecar;//in-memory, remote, or being written
+        fileName = readOnlyImpl->getFilename();
+        m_sidecarBuilding = true;//other threads keep reading columns from the cifti file until it is done
+    }
+    CaretPointer<CiftiColumnSidecar> built;
+    try
+    {
+        CiftiColumnSidecar::build(*this, fileName);
+        built = CiftiColumnSidecar::open(fileName, m_dims[1], m_dims[0]);
+        if (built == NULL) throw DataFileException("failed to open newly built column sidecar for '" + fileName + "'");
+    } catch (CaretException& e) {
+        CaretLogWarning(e.whatString() + ", reading columns without it");
+    }
+    CaretMutexLocker locked(&m_sidecarMutex);
+    m_sidecarBuilding = false;
+    if (built == NULL)
+    {
+        m_sidecarFailed = true;//only for this file, other files can still build theirs
+    } else {
+        m_columnSidecar = built;
+    }
+    return m_columnSidecar;
+}
+
+void CiftiFile::buildColumnSidecar()
+{
+    if (m_dims.size() != 2) throw DataFileException("column sidecars are only supported for 2D cifti files");
+    const CiftiMappedImpl* readOnlyImpl = dynamic_cast<const CiftiMappedImpl*>(m_readingImpl.getPointer());
+    if (readOnlyImpl == NULL || m_writingImpl != NULL) throw DataFileException("column sidecars can only be built for cifti files opened from disk and not modified");
+    CiftiColumnSidecar::build(*this, readOnlyImpl->getFilename());
+    CaretPointer<CiftiColumnSidecar> built = CiftiColumnSidecar::open(readOnlyImpl->getFilename(), m_dims[1], m_dims[0]);
+    if (built == NULL) throw DataFileException("failed to open newly built column sidecar for '" + readOnlyImpl->getFilename() + "'");
+    CaretMutexLocker locked(&m_sidecarMutex);
+    m_columnSidecar = built;
+    m_sidecarFailed = false;
+}
+
+bool CiftiFile::hasColumnSidecar() const
+{
+    CaretMutexLocker locked(&m_sidecarMutex);
+    return (m_columnSidecar != NULL);
+}
+
+const float* CiftiFile::getRowPointer(const vector<int64_t>& indexSelect) const
+{
+    if (m_dims.empty()) throw DataFileException("getRowPointer called on uninitialized CiftiFile");
+    if (m_readingImpl == NULL) return NULL;
+    return m_readingImpl->getRowPointer(indexSelect);
 }
 
 void CiftiFile::setCiftiXML(const CiftiXML& xml, const bool useOldMetadata)
@@ -234,6 +423,7 @@ void CiftiFile::setCiftiXML(const CiftiXML& xml, const bool useOldMetadata)
     }
     m_readingImpl.grabNew(NULL);//drop old implementation, as it is now invalid due to XML (and therefore matrix size) change
     m_writingImpl.grabNew(NULL);
+    m_columnSidecar.grabNew(NULL);
     if (useOldMetadata)
     {
         const GiftiMetaData* oldmd = m_xml.getFileMetaData();
@@ -278,6 +468,7 @@ void CiftiFile::setCiftiXML(const CiftiXMLOld& xml, const bool useOldMetadata)
 void CiftiFile::setRow(const float* dataIn, const vector<int64_t>& indexSelect)
 {
     verifyWriteImpl();
+    CaretProfiler::addCounter("cifti rows written");
     m_writingImpl->setRow(dataIn, indexSelect);
 }
 
@@ -352,13 +543,15 @@ void CiftiFile::verifyWriteImpl()
                 }
             }
         }
-        m_writingImpl.grabNew(new CiftiOnDiskImpl(m_writingFile, m_xml, m_onDiskVersion, shouldSwap(m_endianPref)));//this constructor makes new file for writing
+        m_writingImpl.grabNew(new CiftiOnDiskImpl(m_writingFile, m_xml, m_onDiskVersion, shouldSwap(m_endianPref),
+                                                  m_writingDataType, m_doWriteScaling, m_minScalingVal, m_maxScalingVal));//this constructor makes new file for writing
         if (m_readingImpl != NULL)
         {
             copyImplData(m_readingImpl, m_writingImpl, m_dims);
         }
     }
     m_readingImpl = m_writingImpl;//read-only implementations are set up in specialized functions
+    m_columnSidecar.grabNew(NULL);
 }
 
 void CiftiFile::copyImplData(const ReadImplInterface* from, WriteImplInterface* to, const vector<int64_t>& dims)
@@ -424,9 +617,9 @@ void CiftiMemoryImpl::setColumn(const float* dataIn, const int64_t& index)
     }
 }
 
-CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename)
+CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename, const bool& tryMap)
 {//opens existing file for reading
-    m_nifti.openRead(filename);//read-only, so we don't need write permission to read a cifti file
+    m_nifti.openRead(filename, tryMap);//read-only, so we don't need write permission to read a cifti file
     if (m_nifti.getNumComponents() != 1) throw DataFileException("complex or rgb datatype found in file '" + filename + "', these are not supported in cifti");
     const NiftiHeader& myHeader = m_nifti.getHeader();
     int numExts = (int)myHeader.m_extensions.size(), whichExt = -1;
@@ -570,11 +763,17 @@ namespace
     }
 }
 
-CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, const CiftiVersion& version, const bool& swapEndian)
+CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, const CiftiVersion& version, const bool& swapEndian,
+                                 const int16_t& dataType, const bool& doScale, const double& minval, const double& maxval)
 {//starts writing new file
     warnForBadExtension(filename, xml);
     NiftiHeader outHeader;
-    outHeader.setDataType(NIFTI_TYPE_FLOAT32);//actually redundant currently, default is float32
+    outHeader.setDataType(dataType);
+    double mult, offset;
+    if (getWriteScaling(dataType, doScale, minval, maxval, mult, offset))
+    {//map [minval, maxval] onto the full range of the type, NiftiIO's conversion kernels round and clamp on write, and undo the scaling on read
+        outHeader.setDataScaling(mult, offset);
+    }
     char intentName[16];
     int32_t intentCode = xml.getIntentInfo(version, intentName);
     outHeader.setIntent(intentCode, intentName);
@@ -648,6 +847,78 @@ void CiftiOnDiskImpl::setColumn(const float* dataIn, const int64_t& index)
     }
 }
 
+CiftiMappedImpl::CiftiMappedImpl(const QString& filename) : CiftiOnDiskImpl(filename, true)
+{
+    m_rowLength = m_xml.getDimensionLength(CiftiXML::ALONG_ROW);
+    m_direct = m_nifti.isMapped() && m_nifti.getHeader().getDataType() == NIFTI_TYPE_FLOAT32 && !m_nifti.isConversionNeeded() &&
+               m_nifti.getHeader().getDataOffset() % sizeof(float) == 0;//mmap is page-aligned, so only the data offset matters for alignment
+}
+
+const float* CiftiMappedImpl::getRowPointer(const vector<int64_t>& indexSelect) const
+{
+    if (!m_direct) return NULL;
+    return (const float*)m_nifti.getMappedData(5, indexSelect);//NULL if the file is truncated
+}
+
+void CiftiMappedImpl::getRow(float* dataOut, const vector<int64_t>& indexSelect, const bool& tolerateShortRead) const
+{
+    const float* rowPtr = getRowPointer(indexSelect);
+    if (rowPtr == NULL)
+    {//swapped, scaled, or different datatype - NiftiIO still converts from the mapping without locking unless swapped
+        CiftiOnDiskImpl::getRow(dataOut, indexSelect, tolerateShortRead);
+        return;
+    }
+    memcpy(dataOut, rowPtr, m_rowLength * sizeof(float));
+}
+
+namespace
+{
+    const int64_t XNAT_BLOCK_BYTES = ((int64_t)1) << 20;//target size of one ranged request
+    const size_t XNAT_MEMORY_BLOCKS = 32;
+    const int64_t XNAT_READ_AHEAD = 4;//blocks in flight together when reading rows in order
+
+    //replies are an int32 count followed by that many float32, little endian
+    int64_t getReplySize(const CaretHttpResponse& response)
+    {
+        if (!response.m_ok)
+        {
+            throw DataFileException("Error getting row, response code: " + AString::number(response.m_responseCode));
+        }
+        if (response.m_body.size() % 4 != 0 || response.m_body.size() < 4)//expect a multiple of 4 bytes
+        {
+            throw DataFileException("Bad reply, number of bytes is not a multiple of 4");
+        }
+        int32_t numItems = *((const int32_t*)response.m_body.data());
+        if (ByteOrderEnum::isSystemBigEndian())
+        {
+            ByteSwapping::swap(numItems);
+        }
+        if ((int64_t)numItems * 4 + 4 != (int64_t)response.m_body.size())
+        {
+            throw DataFileException("Bad reply, number of items does not match length of reply");
+        }
+        return numItems;
+    }
+
+    void getReplyFloats(const CaretHttpResponse& response, float* data, const int64_t& numItems)
+    {
+        memcpy(data, response.m_body.data() + 4, numItems * sizeof(float));//skip the first element (which is an int32)
+        if (ByteOrderEnum::isSystemBigEndian())
+        {
+            ByteSwapping::swapArray(data, numItems);
+        }
+    }
+
+    AString getETag(const CaretHttpResponse& response)
+    {
+        for (map<AString, AString>::const_iterator iter = response.m_headers.begin(); iter != response.m_headers.end(); ++iter)
+        {
+            if (iter->first.compare("ETag", Qt::CaseInsensitive) == 0) return iter->second;//header names aren't case sensitive
+        }
+        return "";
+    }
+}
+
 CiftiXnatImpl::CiftiXnatImpl(const QString& url, const QString& user, const QString& pass)
 {
     CaretHttpManager::setAuthentication(url, user, pass);
@@ -696,6 +967,7 @@ void CiftiXnatImpl::init(const QString& url)
     }
     myResponse.m_body.push_back('\0');//null terminate it so we can construct an AString easily - CaretHttpManager is nice and pre-reserves this room for this purpose
     AString theBody(myResponse.m_body.data());
+    m_etag = getETag(myResponse);
     m_xml.readXML(theBody);
     if (m_xml.getNumberOfDimensions() != 2)
     {
@@ -713,6 +985,14 @@ void CiftiXnatImpl::init(const QString& url)
         columnRequest.m_queries.push_back(make_pair(AString("column-index"), AString("0")));
         m_xml.getSeriesMap(CiftiXML::ALONG_COLUMN).setLength(getSizeFromReq(columnRequest));
     }
+    m_rowsPerBlock = max((int64_t)1, min(m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN),
+                                         XNAT_BLOCK_BYTES / max((int64_t)1, m_xml.getDimensionLength(CiftiXML::ALONG_ROW) * (int64_t)sizeof(float))));
+    m_rangedRows = true;
+    m_lastBlock = -2;//so that reading row 0 first isn't counted as sequential
+    if (m_etag == "" && CiftiRemoteBlockCache::getDirectory() != "")
+    {
+        CaretLogFine("server did not send an ETag for URL '" + url + "', rows will not be cached on disk");
+    }
     CaretLogFine("Connected URL: "
                    + url
                    + "\nRow/Column length:"
@@ -724,69 +1004,190 @@ void CiftiXnatImpl::init(const QString& url)
 void CiftiXnatImpl::getReqAsFloats(float* data, const int64_t& dataSize, CaretHttpRequest& request) const
 {
     CaretHttpResponse myResponse;
-    CaretHttpManager::httpRequest(request, myResponse);
-    if (!myResponse.m_ok)
     {
-        throw DataFileException("Error getting row, response code: " + AString::number(myResponse.m_responseCode));
-    }
-    if (myResponse.m_body.size() % 4 != 0)//expect a multiple of 4 bytes
-    {
-        throw DataFileException("Bad reply, number of bytes is not a multiple of 4");
-    }
-    int32_t numItems = *((int32_t*)myResponse.m_body.data());
-    if (ByteOrderEnum::isSystemBigEndian())
-    {
-        ByteSwapping::swap(numItems);
-    }
-    if (numItems * 4 + 4 != (int64_t)myResponse.m_body.size())
-    {
-        throw DataFileException("Bad reply, number of items does not match length of reply");
+        CaretMutexLocker locked(&m_requestMutex);
+        CaretHttpManager::httpRequest(request, myResponse);
     }
+    int64_t numItems = getReplySize(myResponse);
     if (dataSize != numItems)
     {
         throw DataFileException("Bad reply, number of items does not match header");
     }
-    float* myPointer = (float*)(myResponse.m_body.data() + 4);//skip the first element (which is an int32)
-    for (int i = 0; i < numItems; ++i)
-    {
-        data[i] = myPointer[i];
-    }
-    if (ByteOrderEnum::isSystemBigEndian())
-    {
-        ByteSwapping::swapArray(data, numItems);
-    }
+    getReplyFloats(myResponse, data, numItems);
 }
 
 int64_t CiftiXnatImpl::getSizeFromReq(CaretHttpRequest& request)
 {
     CaretHttpResponse myResponse;
     CaretHttpManager::httpRequest(request, myResponse);
-    if (!myResponse.m_ok)
+    return getReplySize(myResponse);
+}
+
+int64_t CiftiXnatImpl::getBlockRows(const int64_t& block) const
+{
+    return min(m_rowsPerBlock, m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN) - block * m_rowsPerBlock);
+}
+
+void CiftiXnatImpl::getRow(float* dataOut, const vector<int64_t>& indexSelect, const bool&) const
+{
+    CaretAssert(indexSelect.size() == 1);
+    const int64_t rowLength = m_xml.getDimensionLength(CiftiXML::ALONG_ROW);
+    const int64_t block = indexSelect[0] / m_rowsPerBlock;
+    CaretMutexLocker locked(&m_requestMutex);
+    const RowBlock& myBlock = getBlock(block);
+    memcpy(dataOut, myBlock.m_data.data() + (indexSelect[0] - block * m_rowsPerBlock) * rowLength, rowLength * sizeof(float));
+}
+
+const CiftiXnatImpl::RowBlock& CiftiXnatImpl::getBlock(const int64_t& block) const
+{
+    const bool sequential = (block == m_lastBlock + 1);
+    m_lastBlock = block;
+    for (list<RowBlock>::iterator iter = m_blocks.begin(); iter != m_blocks.end(); ++iter)
+    {
+        if (iter->m_index == block)
+        {
+            m_blocks.splice(m_blocks.begin(), m_blocks, iter);
+            return m_blocks.front();
+        }
+    }
+    vector<int64_t> toFetch(1, block);
+    if (sequential)
+    {//a scan through the file, so request the next few blocks along with this one
+        const int64_t numBlocks = (m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN) + m_rowsPerBlock - 1) / m_rowsPerBlock;
+        for (int64_t ahead = block + 1; ahead < min(numBlocks, block + XNAT_READ_AHEAD); ++ahead)
+        {
+            bool found = false;
+            for (list<RowBlock>::iterator iter = m_blocks.begin(); iter != m_blocks.end(); ++iter)
+            {
+                if (iter->m_index == ahead)
+                {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) toFetch.push_back(ahead);
+        }
+    }
+    fetchBlocks(toFetch);
+    CaretAssert(m_blocks.front().m_index == block);
+    return m_blocks.front();
+}
+
+void CiftiXnatImpl::fetchBlocks(const vector<int64_t>& blocks) const
+{
+    const int64_t rowLength = m_xml.getDimensionLength(CiftiXML::ALONG_ROW);
+    vector<vector<float> > blockData(blocks.size());
+    vector<RowRequest> rowRequests;
+    vector<size_t> fetched;
+    for (size_t i = 0; i < blocks.size(); ++i)
     {
-        throw DataFileException("Error getting row, response code: " + AString::number(myResponse.m_responseCode));
+        const int64_t numRows = getBlockRows(blocks[i]);
+        blockData[i].resize(numRows * rowLength);
+        if (CiftiRemoteBlockCache::load(m_baseRequest.m_url, m_etag, blocks[i] * m_rowsPerBlock, numRows, rowLength, blockData[i].data()))
+        {
+            CaretProfiler::addCounter("remote cifti disk cache hits");
+            continue;
+        }
+        fetched.push_back(i);
+        RowRequest myRequest;
+        myRequest.m_block = i;
+        if (m_rangedRows)
+        {
+            myRequest.m_firstRow = 0;
+            myRequest.m_numRows = numRows;
+            rowRequests.push_back(myRequest);
+        } else {
+            myRequest.m_numRows = 1;
+            for (int64_t row = 0; row < numRows; ++row)
+            {
+                myRequest.m_firstRow = row;
+                rowRequests.push_back(myRequest);
+            }
+        }
     }
-    if (myResponse.m_body.size() % 4 != 0)//expect a multiple of 4 bytes
+    if (!rowRequests.empty())
     {
-        throw DataFileException("Bad reply, number of bytes is not a multiple of 4");
+        CaretProfileScope myProfile("remote cifti row requests");
+        vector<size_t> singleRowReplies;
+        requestRows(blocks, rowRequests, blockData, singleRowReplies);
+        if (!singleRowReplies.empty())
+        {//server doesn't know row-count, and sent only the first row of each block
+            CaretLogFine("server for URL '" + m_baseRequest.m_url + "' does not support row-count, using one request per row");
+            m_rangedRows = false;
+            vector<RowRequest> remainingRows;
+            for (size_t i = 0; i < singleRowReplies.size(); ++i)
+            {
+                RowRequest myRequest = rowRequests[singleRowReplies[i]];
+                const int64_t endRow = myRequest.m_firstRow + myRequest.m_numRows;
+                myRequest.m_numRows = 1;
+                for (++myRequest.m_firstRow; myRequest.m_firstRow < endRow; ++myRequest.m_firstRow)
+                {
+                    remainingRows.push_back(myRequest);
+                }
+            }
+            requestRows(blocks, remainingRows, blockData, singleRowReplies);
+            CaretAssert(singleRowReplies.empty());
+        }
+        for (size_t i = 0; i < fetched.size(); ++i)
+        {
+            const size_t which = fetched[i];
+            CiftiRemoteBlockCache::store(m_baseRequest.m_url, m_etag, blocks[which] * m_rowsPerBlock, getBlockRows(blocks[which]), rowLength, blockData[which].data());
+        }
     }
-    int32_t numItems = *((int32_t*)myResponse.m_body.data());
-    if (ByteOrderEnum::isSystemBigEndian())
+    for (size_t i = blocks.size(); i > 0; --i)
+    {//the first block ends up most recently used, it is the one that was asked for
+        addBlock(blocks[i - 1], blockData[i - 1]);
+    }
+}
+
+void CiftiXnatImpl::requestRows(const vector<int64_t>& blocks, const vector<RowRequest>& rowRequests, vector<vector<float> >& blockData,
+                                vector<size_t>& singleRowRepliesOut) const
+{
+    const int64_t rowLength = m_xml.getDimensionLength(CiftiXML::ALONG_ROW);
+    vector<CaretHttpRequest> requests(rowRequests.size(), m_baseRequest);
+    for (size_t i = 0; i < rowRequests.size(); ++i)
     {
-        ByteSwapping::swap(numItems);
+        const RowRequest& myRequest = rowRequests[i];
+        requests[i].m_queries.push_back(make_pair(AString("row-index"), AString::number(blocks[myRequest.m_block] * m_rowsPerBlock + myRequest.m_firstRow)));
+        if (myRequest.m_numRows > 1)
+        {//servers that don't know this parameter ignore it and send one row
+            requests[i].m_queries.push_back(make_pair(AString("row-count"), AString::number(myRequest.m_numRows)));
+        }
     }
-    if (numItems * 4 + 4 != (int64_t)myResponse.m_body.size())
+    vector<CaretHttpResponse> responses;
+    CaretHttpManager::httpRequests(requests, responses);
+    CaretProfiler::addCounter("remote cifti requests", (int64_t)requests.size());
+    singleRowRepliesOut.clear();
+    for (size_t i = 0; i < rowRequests.size(); ++i)
     {
-        throw DataFileException("Bad reply, number of items does not match length of reply");
+        const RowRequest& myRequest = rowRequests[i];
+        int64_t numItems = getReplySize(responses[i]);
+        if (numItems != myRequest.m_numRows * rowLength && (myRequest.m_numRows == 1 || numItems != rowLength))
+        {
+            throw DataFileException("Bad reply, number of items does not match header");
+        }
+        getReplyFloats(responses[i], blockData[myRequest.m_block].data() + myRequest.m_firstRow * rowLength, numItems);
+        if (numItems != myRequest.m_numRows * rowLength) singleRowRepliesOut.push_back(i);
     }
-    return numItems;
 }
 
-void CiftiXnatImpl::getRow(float* dataOut, const vector<int64_t>& indexSelect, const bool&) const
+void CiftiXnatImpl::addBlock(const int64_t& block, vector<float>& data) const
 {
-    CaretAssert(indexSelect.size() == 1);
-    CaretHttpRequest rowRequest = m_baseRequest;
-    rowRequest.m_queries.push_back(make_pair(AString("row-index"), AString::number(indexSelect[0])));
-    getReqAsFloats(dataOut, m_xml.getDimensionLength(CiftiXML::ALONG_ROW), rowRequest);
+    for (list<RowBlock>::iterator iter = m_blocks.begin(); iter != m_blocks.end(); ++iter)
+    {
+        if (iter->m_index == block)
+        {
+            m_blocks.erase(iter);
+            break;
+        }
+    }
+    m_blocks.push_front(RowBlock());
+    m_blocks.front().m_index = block;
+    m_blocks.front().m_data.swap(data);
+    while (m_blocks.size() > XNAT_MEMORY_BLOCKS)
+    {
+        m_blocks.pop_back();
+    }
 }
 
 void CiftiXnatImpl::getColumn(float* dataOut, const int64_t& index) const
@@ -21,12 +21,16 @@
  */
 /*LICENSE_END*/
 
+#include "CaretMutex.h"
 #include "CaretPointer.h"
+#include "CiftiColumnSidecar.h"
 #include "CiftiInterface.h"
 #include "CiftiXML.h"
 #include "CiftiXMLOld.h"
 #include "MultiDimIterator.h"
 
+#include "nifti1.h"
+
 #include <QString>
 
 #include <vector>
@@ -45,13 +49,15 @@ namespace caret
             BIG
         };
 
-        CiftiFile() { m_endianPref = NATIVE; }
+        CiftiFile() { m_endianPref = NATIVE; m_sidecarBuilding = false; m_sidecarFailed = false; setWritingDataTypeNoScaling(); }
         explicit CiftiFile(const QString &fileName);//calls openFile
         void openFile(const QString& fileName);//starts on-disk reading
         void openURL(const QString& url, const QString& user, const QString& pass);//open from XNAT
         void openURL(const QString& url);//same, without user/pass (or curently, reusing existing auth if the server matches
         void setWritingFile(const QString& fileName, const CiftiVersion& writingVersion = CiftiVersion(), const ENDIAN& endian = NATIVE);//starts on-disk writing
         void writeFile(const QString& fileName, const CiftiVersion& writingVersion = CiftiVersion(), const ENDIAN& endian = ANY);//leaves current state as-is, rewrites if already writing to that filename and version mismatch
+        void setWritingDataTypeNoScaling(const int16_t& type = NIFTI_TYPE_FLOAT32);//doesn't change a file that has already started being written, call before setRow or writeFile
+        void setWritingDataTypeAndScaling(const int16_t& type, const double& minval, const double& maxval);//for integer types, values outside [minval, maxval] get clamped
         void convertToInMemory();
         QString getFileName() const { return m_fileName; }
         
@@ -62,7 +68,10 @@ namespace caret
         {
             return MultiDimIterator<int64_t>(std::vector<int64_t>(m_dims.begin() + 1, m_dims.end()));
         }
-        void getColumn(float* dataOut, const int64_t& index) const;//for 2D only, will be slow if on disk!
+        void getColumn(float* dataOut, const int64_t& index) const;//for 2D only, will be slow if on disk, unless there is a column sidecar
+        void buildColumnSidecar();//for 2D on-disk files, save a column-major copy of the data so getColumn is one read, reused whenever the unchanged file is opened again
+        bool hasColumnSidecar() const;
+        const float* getRowPointer(const std::vector<int64_t>& indexSelect) const;//returns NULL if the row can't be accessed without copying, otherwise valid until the file is closed or modified
         
         void setCiftiXML(const CiftiXML& xml, const bool useOldMetadata = true);
         void setCiftiXML(const CiftiXMLOld &xml, const bool useOldMetadata = true);//set xml from old implementation
@@ -81,6 +90,7 @@ namespace caret
         public:
             virtual void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const = 0;
             virtual void getColumn(float* dataOut, const int64_t& index) const = 0;
+            virtual const float* getRowPointer(const std::vector<int64_t>&) const { return NULL; }//only for implementations that have the data as float already
             virtual bool isInMemory() const { return false; }
             virtual ~ReadImplInterface();
         };
@@ -96,12 +106,19 @@ namespace caret
         std::vector<int64_t> m_dims;
         CaretPointer<WriteImplInterface> m_writingImpl;//this will be equal to m_readingImpl when non-null
         CaretPointer<ReadImplInterface> m_readingImpl;
+        mutable CaretPointer<CiftiColumnSidecar> m_columnSidecar;//only used while m_readingImpl is a read-only on-disk file, can be built during getColumn
+        mutable CaretMutex m_sidecarMutex;//protects the sidecar pointer and flags, not held while building
+        mutable bool m_sidecarBuilding, m_sidecarFailed;//don't start a second build, and don't retry a failed one on every column
         QString m_writingFile, m_fileName;
         //CiftiXML m_xml;//uncomment when we drop CiftiInterface
         CiftiVersion m_onDiskVersion;
         ENDIAN m_endianPref;
+        int16_t m_writingDataType;
+        bool m_doWriteScaling;
+        double m_minScalingVal, m_maxScalingVal;
         
         void verifyWriteImpl();
+        CaretPointer<CiftiColumnSidecar> getColumnSidecar() const;
         static void copyImplData(const ReadImplInterface* from, WriteImplInterface* to, const std::vector<int64_t>& dims);
     };
     
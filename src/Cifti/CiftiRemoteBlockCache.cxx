@@ -0,0 +1,184 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiRemoteBlockCache.h"
+
+#include "CaretBinaryFile.h"
+#include "CaretLogger.h"
+#include "CaretMutex.h"
+#include "DataFileException.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <cstring>
+
+using namespace caret;
+using namespace std;
+
+QString CiftiRemoteBlockCache::s_directory;
+int64_t CiftiRemoteBlockCache::s_maxBytes = ((int64_t)1) << 30;
+int64_t CiftiRemoteBlockCache::s_usedBytes = -1;
+
+namespace
+{
+    //block layout, native byte order: header, then numRows float32 rows of rowLength values each
+    const char BLOCK_MAGIC[8] = { 'w', 'b', 'r', 'b', 'l', 'o', 'c', 'k' };
+    const int32_t BLOCK_VERSION = 1;
+    const int32_t BLOCK_BYTE_ORDER = 0x01020304;
+
+    struct BlockHeader
+    {
+        char magic[8];
+        int32_t version;
+        int32_t byteOrder;
+        int64_t firstRow;
+        int64_t numRows;
+        int64_t rowLength;
+    };
+
+    CaretMutex s_cacheMutex;//protects the size count, blocks are written from whichever thread is reading a file
+    QAtomicInt s_tempCounter(0);//threads in one process can store the same block at once
+}
+
+CiftiRemoteBlockCache::CiftiRemoteBlockCache()
+{
+}
+
+void CiftiRemoteBlockCache::setDirectory(const QString& directory)
+{
+    CaretMutexLocker locked(&s_cacheMutex);
+    s_directory = directory;
+    s_usedBytes = -1;
+}
+
+QString CiftiRemoteBlockCache::getBlockFileName(const QString& url, const QString& etag, const int64_t& firstRow, const int64_t& numRows, const int64_t& rowLength)
+{
+    QString key = url + "\n" + etag + "\n" + QString::number(firstRow) + "\n" + QString::number(numRows) + "\n" + QString::number(rowLength);
+    return s_directory + "/" + QString(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex()) + ".wbblock";
+}
+
+bool CiftiRemoteBlockCache::load(const QString& url, const QString& etag, const int64_t& firstRow, const int64_t& numRows, const int64_t& rowLength, float* dataOut)
+{
+    if (s_directory == "" || etag == "") return false;//without an etag, there is no way to know if the server's file changed
+    QString blockName = getBlockFileName(url, etag, firstRow, numRows, rowLength);
+    QFileInfo blockInfo(blockName);
+    if (!blockInfo.exists()) return false;
+    const int64_t dataBytes = numRows * rowLength * (int64_t)sizeof(float);
+    if (blockInfo.size() != (int64_t)sizeof(BlockHeader) + dataBytes) return false;
+    BlockHeader myHeader;
+    try
+    {
+        CaretBinaryFile myFile(blockName);
+        myFile.readAt(&myHeader, sizeof(BlockHeader), 0);
+        if (memcmp(myHeader.magic, BLOCK_MAGIC, 8) != 0 || myHeader.version != BLOCK_VERSION || myHeader.byteOrder != BLOCK_BYTE_ORDER ||
+            myHeader.firstRow != firstRow || myHeader.numRows != numRows || myHeader.rowLength != rowLength)
+        {
+            return false;
+        }
+        myFile.readAt(dataOut, dataBytes, sizeof(BlockHeader));
+    } catch (CaretException& e) {
+        CaretLogFine("ignoring cached block '" + blockName + "': " + e.whatString());
+        return false;
+    }
+#if QT_VERSION >= 0x050A00
+    QFile touchFile(blockName);
+    if (touchFile.open(QIODevice::ReadWrite))
+    {//mark it as recently used, so eviction is least recently used rather than oldest written
+        touchFile.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+#endif
+    return true;
+}
+
+void CiftiRemoteBlockCache::store(const QString& url, const QString& etag, const int64_t& firstRow, const int64_t& numRows, const int64_t& rowLength, const float* data)
+{
+    if (s_directory == "" || etag == "") return;
+    const int64_t dataBytes = numRows * rowLength * (int64_t)sizeof(float);
+    if (s_maxBytes > 0 && dataBytes > s_maxBytes) return;
+    BlockHeader myHeader;
+    memset(&myHeader, 0, sizeof(BlockHeader));
+    memcpy(myHeader.magic, BLOCK_MAGIC, 8);
+    myHeader.version = BLOCK_VERSION;
+    myHeader.byteOrder = BLOCK_BYTE_ORDER;
+    myHeader.firstRow = firstRow;
+    myHeader.numRows = numRows;
+    myHeader.rowLength = rowLength;
+    QString blockName = getBlockFileName(url, etag, firstRow, numRows, rowLength);
+    QString tempName = blockName + "." + QString::number(QCoreApplication::applicationPid()) + "." + QString::number(s_tempCounter.fetchAndAddOrdered(1)) + ".tmp";//other processes and threads never see a partial file
+    try
+    {
+        CaretBinaryFile outFile(tempName, CaretBinaryFile::WRITE_TRUNCATE);
+        outFile.write(&myHeader, sizeof(BlockHeader));
+        outFile.write(data, dataBytes);
+        outFile.close();
+    } catch (CaretException& e) {
+        QFile::remove(tempName);
+        CaretLogWarning("failed to write cached block '" + blockName + "': " + e.whatString());
+        return;
+    }
+    CaretMutexLocker locked(&s_cacheMutex);
+    int64_t replacedBytes = 0;
+    QFileInfo oldInfo(blockName);
+    if (oldInfo.exists())
+    {
+        replacedBytes = oldInfo.size();
+        QFile::remove(blockName);//rename won't overwrite
+    }
+    if (!QFile::rename(tempName, blockName))
+    {
+        QFile::remove(tempName);
+        CaretLogWarning("failed to rename cached block into place: '" + blockName + "'");
+        return;
+    }
+    if (s_maxBytes <= 0) return;
+    if (s_usedBytes < 0)
+    {//first write since the directory was set, count what is already there (including this block)
+        s_usedBytes = evictBlocks(s_maxBytes, blockName);
+        return;
+    }
+    s_usedBytes += (int64_t)sizeof(BlockHeader) + dataBytes - replacedBytes;
+    if (s_usedBytes > s_maxBytes)
+    {//other processes may have added or removed blocks, so recount while evicting, and leave some room so the next few writes don't list the directory again
+        s_usedBytes = evictBlocks(s_maxBytes - s_maxBytes / 4, blockName);
+    }
+}
+
+int64_t CiftiRemoteBlockCache::evictBlocks(const int64_t& targetBytes, const QString& keepName)
+{
+    QFileInfoList blockList = QDir(s_directory).entryInfoList(QStringList("*.wbblock"), QDir::Files, QDir::Time);//most recently used first
+    QString keepPath = QFileInfo(keepName).absoluteFilePath();
+    int64_t totalBytes = 0;
+    for (int i = 0; i < blockList.size(); ++i)
+    {
+        totalBytes += blockList[i].size();
+        if (totalBytes > targetBytes && blockList[i].absoluteFilePath() != keepPath)
+        {//another process may have just removed it, that is fine
+            QFile::remove(blockList[i].absoluteFilePath());
+            totalBytes -= blockList[i].size();
+        }
+    }
+    return totalBytes;
+}
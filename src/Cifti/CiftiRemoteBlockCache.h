@@ -0,0 +1,61 @@
+#ifndef __CIFTI_REMOTE_BLOCK_CACHE_H__
+#define __CIFTI_REMOTE_BLOCK_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <QString>
+
+#include "stdint.h"
+
+namespace caret
+{
+
+    ///size-bounded on-disk cache of blocks of rows read from cifti URLs, shared between processes through the filesystem
+    ///blocks are keyed by URL and the ETag the server sent with the metadata, so a changed file on the server never uses stale blocks
+    ///when full, the least recently used blocks are removed (recency is the file modification time, which is updated on each use)
+    ///the size of the directory is counted once and then tracked as blocks are written, it is only listed again when the count goes over the limit
+    class CiftiRemoteBlockCache
+    {
+        static QString s_directory;
+        static int64_t s_maxBytes;
+        static int64_t s_usedBytes;//-1 until the directory has been counted
+        CiftiRemoteBlockCache();
+        static int64_t evictBlocks(const int64_t& targetBytes, const QString& keepName);//with the cache mutex locked, returns the size left
+    public:
+        ///empty (the default) disables the disk cache
+        static void setDirectory(const QString& directory);
+        static const QString& getDirectory() { return s_directory; }
+
+        static void setMaxBytes(const int64_t& maxBytes) { s_maxBytes = maxBytes; }
+        static int64_t getMaxBytes() { return s_maxBytes; }
+
+        static QString getBlockFileName(const QString& url, const QString& etag, const int64_t& firstRow, const int64_t& numRows, const int64_t& rowLength);
+
+        ///returns false if the block isn't cached, or the cached file doesn't match
+        static bool load(const QString& url, const QString& etag, const int64_t& firstRow, const int64_t& numRows, const int64_t& rowLength, float* dataOut);
+
+        ///writes to a temporary file and renames it into place, then removes the least recently used blocks if over the size limit, failures are only logged
+        static void store(const QString& url, const QString& etag, const int64_t& firstRow, const int64_t& numRows, const int64_t& rowLength, const float* data);
+    };
+
+}
+
+#endif //__CIFTI_REMOTE_BLOCK_CACHE_H__
@@ -0,0 +1,425 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CommandBatchRunner.h"
+
+#include "CaretCommandLine.h"
+#include "CaretException.h"
+#include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "CaretPointer.h"
+#include "CommandException.h"
+#include "CommandFileCache.h"
+#include "CommandOperation.h"
+#include "CommandOperationManager.h"
+#include "CommandParser.h"
+#include "ElapsedTimer.h"
+#include "ProgramParameters.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+
+using namespace caret;
+using namespace std;
+
+bool CommandBatchRunner::s_running = false;
+int CommandBatchRunner::s_lastPeakJobs = 0;
+
+namespace
+{
+    struct BatchCommand
+    {
+        enum State
+        {
+            WAITING,
+            RUNNING,
+            DONE
+        };
+        int64_t m_lineNumber;
+        vector<AString> m_tokens;
+        AString m_switch;
+        vector<AString> m_inputs, m_outputs;//normalized paths
+        bool m_barrier;//global options or non-processing commands, wait for everything before, and block everything after
+        State m_state;
+        BatchCommand() { m_lineNumber = 0; m_barrier = false; m_state = WAITING; }
+    };
+
+    struct BatchState
+    {
+        QMutex m_mutex;//protects everything else
+        QWaitCondition m_changed;//signalled when a command is added or finishes, or input ends
+        vector<CaretPointer<BatchCommand> > m_commands;
+        int64_t m_firstUnfinished;//everything before this is DONE, to keep the scan short on long scripts
+        bool m_inputFinished, m_failed;
+        int64_t m_failedLine;
+        AString m_failedMessage;
+        int m_numRunning, m_peakRunning;
+        BatchState() { m_firstUnfinished = 0; m_inputFinished = false; m_failed = false; m_failedLine = -1; m_numRunning = 0; m_peakRunning = 0; }
+    };
+
+    AString normalizePath(const AString& path)
+    {
+        return QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+    }
+
+    bool filesConflict(const BatchCommand& first, const BatchCommand& second)
+    {//reading the same file is fine, anything involving a write is not
+        for (size_t i = 0; i < first.m_outputs.size(); ++i)
+        {
+            for (size_t j = 0; j < second.m_inputs.size(); ++j)
+            {
+                if (first.m_outputs[i] == second.m_inputs[j]) return true;
+            }
+            for (size_t j = 0; j < second.m_outputs.size(); ++j)
+            {
+                if (first.m_outputs[i] == second.m_outputs[j]) return true;
+            }
+        }
+        for (size_t i = 0; i < first.m_inputs.size(); ++i)
+        {
+            for (size_t j = 0; j < second.m_outputs.size(); ++j)
+            {
+                if (first.m_inputs[i] == second.m_outputs[j]) return true;
+            }
+        }
+        return false;
+    }
+
+    void classifyCommand(CommandOperationManager* manager, BatchCommand& myCommand)
+    {
+        if (!myCommand.m_tokens.empty()) myCommand.m_switch = myCommand.m_tokens[0];
+        vector<AString> shared;//surfaces and volumes from the file cache are read concurrently, their lazily computed members are locked
+        myCommand.m_barrier = !CommandBatchRunner::getLineFiles(manager, myCommand.m_tokens, myCommand.m_inputs, myCommand.m_outputs, shared);
+    }
+
+    //must hold the mutex, returns NULL if nothing can start right now
+    BatchCommand* findReadyCommand(BatchState& myState, bool& allDoneOut)
+    {
+        allDoneOut = false;
+        int64_t numCommands = (int64_t)myState.m_commands.size();
+        while (myState.m_firstUnfinished < numCommands && myState.m_commands[myState.m_firstUnfinished]->m_state == BatchCommand::DONE)
+        {
+            ++myState.m_firstUnfinished;
+        }
+        if (myState.m_firstUnfinished == numCommands)
+        {
+            allDoneOut = myState.m_inputFinished;
+            return NULL;
+        }
+        if (myState.m_failed) return NULL;//let running commands finish, but don't start more
+        bool anyRunning = false;
+        for (int64_t i = myState.m_firstUnfinished; i < numCommands; ++i)
+        {
+            BatchCommand* myCommand = myState.m_commands[i];
+            if (myCommand->m_state == BatchCommand::RUNNING)
+            {
+                if (myCommand->m_barrier) return NULL;
+                anyRunning = true;
+            }
+        }
+        for (int64_t i = myState.m_firstUnfinished; i < numCommands; ++i)
+        {
+            BatchCommand* myCommand = myState.m_commands[i];
+            if (myCommand->m_state != BatchCommand::WAITING) continue;
+            if (myCommand->m_barrier)
+            {
+                if (!anyRunning && i == myState.m_firstUnfinished) return myCommand;
+                return NULL;//nothing after a barrier can start
+            }
+            bool ready = true;
+            for (int64_t j = myState.m_firstUnfinished; ready && j < i; ++j)
+            {
+                const BatchCommand* earlier = myState.m_commands[j];
+                if (earlier->m_state != BatchCommand::DONE && filesConflict(*earlier, *myCommand))
+                {
+                    ready = false;
+                }
+            }
+            if (ready) return myCommand;
+        }
+        return NULL;
+    }
+
+    class BatchWorkerThread : public QThread
+    {
+        BatchState* m_state;
+        int m_numThreads;
+    public:
+        BatchWorkerThread(BatchState* state, const int& numThreads) { m_state = state; m_numThreads = numThreads; }
+        void run()
+        {
+#ifdef CARET_OMP
+            omp_set_num_threads(m_numThreads);//per thread setting, so concurrent commands split the cores instead of each starting a full team
+#endif
+            QMutexLocker locked(&(m_state->m_mutex));
+            while (true)
+            {
+                bool allDone = false;
+                BatchCommand* myCommand = findReadyCommand(*m_state, allDone);
+                if (myCommand == NULL)
+                {
+                    if (allDone || (m_state->m_failed && m_state->m_inputFinished)) break;
+                    m_state->m_changed.wait(&(m_state->m_mutex));
+                    continue;
+                }
+                myCommand->m_state = BatchCommand::RUNNING;
+                ++(m_state->m_numRunning);
+                m_state->m_peakRunning = max(m_state->m_peakRunning, m_state->m_numRunning);
+                locked.unlock();
+                AString errorMessage;
+                bool failed = false;
+                ElapsedTimer myTimer;
+                myTimer.start();
+                CommandFileCache::resetThreadStatistics();
+                try
+                {
+                    ProgramParameters myParameters;
+                    for (size_t i = 0; i < myCommand->m_tokens.size(); ++i)
+                    {
+                        myParameters.addParameter(myCommand->m_tokens[i]);
+                    }
+                    CaretPointer<CommandOperationManager> lineManager(CommandOperationManager::createIndependentManager());//command objects have state, so each line gets its own
+                    lineManager->runCommand(myParameters, caret_format_commandLine("wb_command", myCommand->m_tokens));
+                } catch (CaretException& e) {
+                    failed = true;
+                    errorMessage = e.whatString();
+                } catch (exception& e) {
+                    failed = true;
+                    errorMessage = e.what();
+                }
+                CommandFileCache::releaseModified();
+                double seconds = myTimer.getElapsedTimeSeconds();
+                int64_t hits = 0, misses = 0;
+                CommandFileCache::getThreadStatistics(hits, misses);
+                locked.relock();
+                myCommand->m_state = BatchCommand::DONE;
+                --(m_state->m_numRunning);
+                if (failed)
+                {
+                    cerr << "\nWhile running line " << myCommand->m_lineNumber << " of batch:\n" << caret_format_commandLine("wb_command", myCommand->m_tokens)
+                         << "\n\nERROR: " << errorMessage << endl << endl;
+                    if (!m_state->m_failed || myCommand->m_lineNumber < m_state->m_failedLine)
+                    {
+                        m_state->m_failedLine = myCommand->m_lineNumber;
+                        m_state->m_failedMessage = errorMessage;
+                    }
+                    m_state->m_failed = true;
+                } else {
+                    cout << "batch line " << myCommand->m_lineNumber << ": " << myCommand->m_switch << " finished in " << seconds << "s";
+                    if (hits + misses > 0) cout << ", reused " << hits << " of " << (hits + misses) << " input files";
+                    cout << endl;
+                }
+                myCommand->m_tokens.clear();//don't keep long command lines of finished commands
+                m_state->m_changed.wakeAll();
+            }
+        }
+    };
+}
+
+bool CommandBatchRunner::getLineFiles(CommandOperationManager* manager, const vector<AString>& tokens, vector<AString>& inputsOut,
+                                      vector<AString>& outputsOut, vector<AString>& sharedOut)
+{
+    inputsOut.clear();
+    outputsOut.clear();
+    sharedOut.clear();
+    if (tokens.empty()) return false;
+    vector<CommandOperation*> operations = manager->getCommandOperations();
+    CommandParser* myParser = NULL;
+    for (size_t i = 0; i < operations.size(); ++i)
+    {
+        if (operations[i]->getCommandLineSwitch() == tokens[0])
+        {
+            myParser = dynamic_cast<CommandParser*>(operations[i]);
+            break;
+        }
+    }
+    if (myParser == NULL) return false;//global options, informational switches, deprecated or non-parser commands all run alone
+    if (tokens.size() < 2) return false;//prints help
+    ProgramParameters dryParameters;
+    for (size_t i = 1; i < tokens.size(); ++i)
+    {
+        dryParameters.addParameter(tokens[i]);
+    }
+    vector<AString> inputs, outputs, shared;
+    try
+    {
+        myParser->getFileArguments(dryParameters, inputs, outputs, shared);
+    } catch (...) {
+        return false;//let the real parse report the error, in order
+    }
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        inputsOut.push_back(normalizePath(inputs[i]));
+    }
+    for (size_t i = 0; i < outputs.size(); ++i)
+    {
+        outputsOut.push_back(normalizePath(outputs[i]));
+    }
+    for (size_t i = 0; i < shared.size(); ++i)
+    {
+        sharedOut.push_back(normalizePath(shared[i]));
+    }
+    return true;
+}
+
+bool CommandBatchRunner::tokenizeLine(const AString& line, vector<AString>& tokensOut)
+{
+    tokensOut.clear();
+    AString current;
+    bool inToken = false;
+    const int length = line.size();
+    for (int i = 0; i < length; ++i)
+    {
+        QChar c = line[i];
+        if (c == '\'')
+        {//no escapes inside single quotes
+            int end = line.indexOf('\'', i + 1);
+            if (end == -1) return false;
+            current += line.mid(i + 1, end - i - 1);
+            inToken = true;
+            i = end;
+        } else if (c == '"') {
+            ++i;
+            while (i < length && line[i] != '"')
+            {
+                if (line[i] == '\\' && i + 1 < length && (line[i + 1] == '"' || line[i + 1] == '\\'))
+                {
+                    ++i;
+                }
+                current += line[i];
+                ++i;
+            }
+            if (i == length) return false;
+            inToken = true;
+        } else if (c == '\\') {
+            if (i + 1 == length) return false;//continued on the next line
+            ++i;
+            current += line[i];
+            inToken = true;
+        } else if (c == '#' && !inToken) {
+            break;//comment
+        } else if (c.isSpace()) {
+            if (inToken)
+            {
+                tokensOut.push_back(current);
+                current = "";
+                inToken = false;
+            }
+        } else {
+            current += c;
+            inToken = true;
+        }
+    }
+    if (inToken) tokensOut.push_back(current);
+    if (!tokensOut.empty() && (tokensOut[0] == "wb_command" || tokensOut[0].endsWith("/wb_command")))
+    {//allow pasting lines from a shell script
+        tokensOut.erase(tokensOut.begin());
+    }
+    return true;
+}
+
+void CommandBatchRunner::run(CommandOperationManager* manager, const AString& scriptName, const int& numJobs)
+{
+    if (s_running) throw CommandException("-batch can't be used inside a batch script");
+    if (numJobs < 1) throw CommandException("number of batch jobs must be positive");
+    QFile scriptFile;
+    bool opened = false;
+    if (scriptName == "-")
+    {
+        opened = scriptFile.open(stdin, QIODevice::ReadOnly);
+    } else {
+        scriptFile.setFileName(scriptName);
+        opened = scriptFile.open(QIODevice::ReadOnly);
+    }
+    if (!opened) throw CommandException("unable to open batch script '" + scriptName + "'");
+    s_running = true;
+    CommandFileCache::enable();
+    BatchState myState;
+    int threadsPerJob = 1;
+#ifdef CARET_OMP
+    threadsPerJob = max(1, omp_get_max_threads() / numJobs);
+#endif
+    vector<CaretPointer<BatchWorkerThread> > workers(numJobs);
+    for (int i = 0; i < numJobs; ++i)
+    {
+        workers[i].grabNew(new BatchWorkerThread(&myState, threadsPerJob));
+        workers[i]->start();
+    }
+    ElapsedTimer myTimer;
+    myTimer.start();
+    int64_t lineNumber = 0, startLine = 1;
+    AString pending;
+    while (true)
+    {
+        QByteArray rawLine = scriptFile.readLine();//blocks until a line arrives, for a pipe or fifo
+        if (rawLine.isEmpty()) break;//end of file, blank lines still contain the newline
+        ++lineNumber;
+        AString line = AString::fromLocal8Bit(rawLine);
+        while (line.endsWith('\n') || line.endsWith('\r')) line.chop(1);
+        if (pending.isEmpty()) startLine = lineNumber;
+        if (!pending.isEmpty() && pending.endsWith('\\'))
+        {
+            pending.chop(1);//continuation backslash joins lines
+        } else if (!pending.isEmpty()) {
+            pending += "\n";//newline inside quotes
+        }
+        pending += line;
+        CaretPointer<BatchCommand> myCommand(new BatchCommand());
+        if (!tokenizeLine(pending, myCommand->m_tokens)) continue;
+        pending = "";
+        if (myCommand->m_tokens.empty()) continue;
+        myCommand->m_lineNumber = startLine;
+        classifyCommand(manager, *myCommand);
+        QMutexLocker locked(&myState.m_mutex);
+        if (myState.m_failed) break;
+        myState.m_commands.push_back(myCommand);
+        myState.m_changed.wakeAll();
+    }
+    {
+        QMutexLocker locked(&myState.m_mutex);
+        myState.m_inputFinished = true;
+        myState.m_changed.wakeAll();
+    }
+    for (int i = 0; i < numJobs; ++i)
+    {
+        workers[i]->wait();
+    }
+    CommandFileCache::disable();
+    s_running = false;
+    s_lastPeakJobs = myState.m_peakRunning;
+    if (!pending.isEmpty())
+    {
+        CaretLogWarning("batch script ended with an incomplete line (unterminated quote or trailing backslash), it was not run");
+    }
+    cout << "batch: " << myState.m_commands.size() << " commands finished in " << myTimer.getElapsedTimeSeconds() << "s using " << numJobs << " job(s), at most " << myState.m_peakRunning << " at once" << endl;
+    if (myState.m_failed)
+    {
+        throw CommandException("batch command on line " + AString::number(myState.m_failedLine) + " failed: " + myState.m_failedMessage);
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef __COMMAND_BATCH_RUNNER_H__
+#define __COMMAND_BATCH_RUNNER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+
+#include <vector>
+
+namespace caret {
+
+    class CommandOperationManager;
+
+    ///runs many wb_command command lines in one process, so input files and the helpers built from them (topology, geodesic, point locator) are reused
+    ///commands start as soon as the commands before them that they depend on (through file names) are finished, up to the given number at a time
+    class CommandBatchRunner
+    {
+        static bool s_running;
+        static int s_lastPeakJobs;
+        CommandBatchRunner();
+    public:
+        ///run the commands in a script file, or from standard input when the name is "-", lines are read as they arrive, so a fifo can be used to feed commands to a running process
+        static void run(CommandOperationManager* manager, const AString& scriptName, const int& numJobs);
+
+        static bool isRunning() { return s_running; }
+
+        ///the most lines that ran at the same time during the last batch
+        static int getLastPeakJobs() { return s_lastPeakJobs; }
+
+        ///split a line into arguments the way a shell would for simple quoting, returns false if the line has an unterminated quote or ends with a continuation backslash
+        static bool tokenizeLine(const AString& line, std::vector<AString>& tokensOut);
+
+        ///find the files a batch line reads and writes (as normalized absolute paths), and the inputs it gets as shared objects from the file cache
+        ///returns false if the line must run alone (global options, informational or non-parser commands, or parse errors)
+        static bool getLineFiles(CommandOperationManager* manager, const std::vector<AString>& tokens, std::vector<AString>& inputsOut,
+                                 std::vector<AString>& outputsOut, std::vector<AString>& sharedOut);
+    };
+
+}
+
+#endif //__COMMAND_BATCH_RUNNER_H__
@@ -0,0 +1,244 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CommandFileCache.h"
+
+#include "CaretLogger.h"
+#include "CaretProfiler.h"
+#include "DataFileException.h"
+#include "LabelFile.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+#include "VolumeFile.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QThread>
+
+#include <algorithm>
+
+using namespace caret;
+using namespace std;
+
+bool CommandFileCache::s_enabled = false;
+int64_t CommandFileCache::s_maxMemorySize = 0;
+int64_t CommandFileCache::s_curMemorySize = 0;
+uint64_t CommandFileCache::s_useCounter = 0;
+map<AString, CommandFileCache::CacheEntry> CommandFileCache::s_entries;
+map<void*, CommandFileCache::CacheStatistics> CommandFileCache::s_statistics;
+CaretMutex CommandFileCache::s_mutex;
+
+namespace
+{
+    //estimates of memory use, the on-disk size can be much smaller due to compression
+    int64_t memorySize(const LabelFile* file) { return file->getDataSizeUncompressedInBytes(); }
+    int64_t memorySize(const MetricFile* file) { return file->getDataSizeUncompressedInBytes(); }
+    int64_t memorySize(const VolumeFile* file) { return file->getDataSizeUncompressedInBytes(); }
+    int64_t memorySize(const SurfaceFile* file)
+    {//coordinates, normals and triangles, the helpers can be larger, but are only made when used
+        return ((int64_t)file->getNumberOfNodes()) * 6 * sizeof(float) + ((int64_t)file->getNumberOfTriangles()) * 3 * sizeof(int32_t);
+    }
+
+    //labels and metrics are given out as copies, the cached object is never given out, so copying it doesn't race with anything
+    CaretPointer<LabelFile> handOut(const CaretPointer<LabelFile>& cached) { return CaretPointer<LabelFile>(new LabelFile(*cached)); }
+    CaretPointer<MetricFile> handOut(const CaretPointer<MetricFile>& cached) { return CaretPointer<MetricFile>(new MetricFile(*cached)); }
+    //copying would lose the helpers, batch mode doesn't run commands that share one at the same time
+    CaretPointer<SurfaceFile> handOut(const CaretPointer<SurfaceFile>& cached) { return cached; }
+    //VolumeFile can't be copied, so volumes are shared like surfaces
+    CaretPointer<VolumeFile> handOut(const CaretPointer<VolumeFile>& cached) { return cached; }
+}
+
+void CommandFileCache::enable(const int64_t& maxMemorySize)
+{
+    CaretMutexLocker locked(&s_mutex);
+    s_maxMemorySize = maxMemorySize;
+    evictToSize(s_maxMemorySize);
+    s_enabled = true;
+}
+
+void CommandFileCache::disable()
+{
+    CaretMutexLocker locked(&s_mutex);
+    s_enabled = false;
+    s_entries.clear();
+    s_curMemorySize = 0;
+}
+
+template <typename T>
+CaretPointer<T> CommandFileCache::getFile(const AString& fileName, CaretPointer<T> CacheEntry::* member)
+{
+    QFileInfo myInfo(fileName);
+    if (!myInfo.exists())
+    {
+        throw DataFileException(fileName, "file does not exist");
+    }
+    AString key = myInfo.canonicalFilePath();
+    int64_t modifiedTime = myInfo.lastModified().toMSecsSinceEpoch(), diskSize = myInfo.size();
+    void* thisThread = QThread::currentThread();
+    CaretPointer<T> cached;
+    {
+        CaretMutexLocker locked(&s_mutex);
+        map<AString, CacheEntry>::iterator iter = s_entries.find(key);
+        if (iter != s_entries.end())
+        {
+            CacheEntry& myEntry = iter->second;
+            if (myEntry.m_modifiedTime == modifiedTime && myEntry.m_diskSize == diskSize && (myEntry.*member) != NULL)
+            {
+                myEntry.m_lastUsed = ++s_useCounter;
+                ++(s_statistics[thisThread].m_hits);
+                CaretProfiler::addCounter("file cache hits");
+                CaretLogFine("using cached file '" + fileName + "'");
+                cached = myEntry.*member;
+            } else {
+                s_curMemorySize -= myEntry.m_memorySize;//changed on disk, or the same file name used as a different type
+                s_entries.erase(iter);
+            }
+        }
+        if (cached == NULL)
+        {
+            ++(s_statistics[thisThread].m_misses);
+            CaretProfiler::addCounter("file cache misses");
+        }
+    }
+    if (cached != NULL) return handOut(cached);//copy outside the lock
+    CaretPointer<T> ret(new T());
+    ret->readFile(fileName);//don't hold the lock while reading, other commands may be waiting on already cached files
+    CacheEntry newEntry;
+    newEntry.m_modifiedTime = modifiedTime;
+    newEntry.m_diskSize = diskSize;
+    newEntry.m_memorySize = max(diskSize, memorySize(ret.getPointer()));
+    newEntry.*member = ret;
+    {
+        CaretMutexLocker locked(&s_mutex);
+        map<AString, CacheEntry>::iterator iter = s_entries.find(key);
+        if (iter != s_entries.end())
+        {//another command read the same file while we did, keep the first one
+            if (iter->second.m_modifiedTime == modifiedTime && iter->second.m_diskSize == diskSize && (iter->second.*member) != NULL)
+            {
+                iter->second.m_lastUsed = ++s_useCounter;
+                cached = iter->second.*member;
+            } else {
+                s_curMemorySize -= iter->second.m_memorySize;
+                s_entries.erase(iter);
+            }
+        }
+        if (cached == NULL)
+        {
+            if (newEntry.m_memorySize > s_maxMemorySize) return ret;//too big to cache at all
+            evictToSize(s_maxMemorySize - newEntry.m_memorySize);
+            newEntry.m_lastUsed = ++s_useCounter;
+            s_entries[key] = newEntry;
+            s_curMemorySize += newEntry.m_memorySize;
+            cached = ret;
+        }
+    }
+    return handOut(cached);
+}
+
+void CommandFileCache::evictToSize(const int64_t& maxSize)
+{
+    while (s_curMemorySize > maxSize && !s_entries.empty())
+    {//linear search is fine, there won't be many files in memory
+        map<AString, CacheEntry>::iterator oldest = s_entries.begin();
+        for (map<AString, CacheEntry>::iterator iter = s_entries.begin(); iter != s_entries.end(); ++iter)
+        {
+            if (iter->second.m_lastUsed < oldest->second.m_lastUsed) oldest = iter;
+        }
+        s_curMemorySize -= oldest->second.m_memorySize;
+        s_entries.erase(oldest);//commands still using it keep their reference
+    }
+}
+
+CaretPointer<LabelFile> CommandFileCache::getLabel(const AString& fileName)
+{
+    return getFile(fileName, &CacheEntry::m_label);
+}
+
+CaretPointer<MetricFile> CommandFileCache::getMetric(const AString& fileName)
+{
+    return getFile(fileName, &CacheEntry::m_metric);
+}
+
+CaretPointer<SurfaceFile> CommandFileCache::getSurface(const AString& fileName)
+{
+    return getFile(fileName, &CacheEntry::m_surface);
+}
+
+CaretPointer<VolumeFile> CommandFileCache::getVolume(const AString& fileName)
+{
+    return getFile(fileName, &CacheEntry::m_volume);
+}
+
+void CommandFileCache::invalidate(const AString& fileName)
+{
+    QFileInfo myInfo(fileName);
+    if (!myInfo.exists()) return;
+    CaretMutexLocker locked(&s_mutex);
+    map<AString, CacheEntry>::iterator iter = s_entries.find(myInfo.canonicalFilePath());
+    if (iter != s_entries.end())
+    {
+        s_curMemorySize -= iter->second.m_memorySize;
+        s_entries.erase(iter);
+    }
+}
+
+void CommandFileCache::releaseModified()
+{
+    CaretMutexLocker locked(&s_mutex);
+    map<AString, CacheEntry>::iterator iter = s_entries.begin();
+    while (iter != s_entries.end())
+    {
+        const CacheEntry& myEntry = iter->second;
+        bool modified = (myEntry.m_label != NULL && myEntry.m_label->isModified()) ||
+                        (myEntry.m_metric != NULL && myEntry.m_metric->isModified()) ||
+                        (myEntry.m_surface != NULL && myEntry.m_surface->isModified()) ||
+                        (myEntry.m_volume != NULL && myEntry.m_volume->isModified());
+        if (modified)
+        {
+            CaretLogInfo("dropping in-memory modified file '" + iter->first + "' from the file cache");
+            s_curMemorySize -= myEntry.m_memorySize;
+            s_entries.erase(iter++);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+void CommandFileCache::clear()
+{
+    CaretMutexLocker locked(&s_mutex);
+    s_entries.clear();
+    s_curMemorySize = 0;
+    s_statistics.clear();
+}
+
+void CommandFileCache::getThreadStatistics(int64_t& hitsOut, int64_t& missesOut)
+{
+    CaretMutexLocker locked(&s_mutex);
+    const CacheStatistics& myStats = s_statistics[QThread::currentThread()];
+    hitsOut = myStats.m_hits;
+    missesOut = myStats.m_misses;
+}
+
+void CommandFileCache::resetThreadStatistics()
+{
+    CaretMutexLocker locked(&s_mutex);
+    s_statistics[QThread::currentThread()] = CacheStatistics();
+}
@@ -0,0 +1,94 @@
+#ifndef __COMMAND_FILE_CACHE_H__
+#define __COMMAND_FILE_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+#include "CaretMutex.h"
+#include "CaretPointer.h"
+
+#include "stdint.h"
+#include <map>
+
+namespace caret {
+
+    class LabelFile;
+    class MetricFile;
+    class SurfaceFile;
+    class VolumeFile;
+
+    ///cache of input files for batch mode, so that commands in one batch that use the same surface (and its topology/geodesic helpers), etc, only read it once
+    ///files are keyed on canonical path, modification time and size, so a file that changes on disk is read again
+    ///labels and metrics are handed out as private copies, so commands can modify them or fill lazily computed members freely
+    ///surfaces (to keep their helpers) and volumes (which can't be copied) are shared, their lazily computed members are locked so commands can read them at the same time,
+    ///and releaseModified() drops one that a command changed
+    class CommandFileCache
+    {
+        struct CacheEntry
+        {
+            int64_t m_modifiedTime, m_diskSize, m_memorySize;
+            uint64_t m_lastUsed;
+            CaretPointer<LabelFile> m_label;//only one of these is set
+            CaretPointer<MetricFile> m_metric;
+            CaretPointer<SurfaceFile> m_surface;
+            CaretPointer<VolumeFile> m_volume;
+        };
+        struct CacheStatistics
+        {
+            int64_t m_hits, m_misses;
+            CacheStatistics() { m_hits = 0; m_misses = 0; }
+        };
+        static bool s_enabled;
+        static int64_t s_maxMemorySize, s_curMemorySize;
+        static uint64_t s_useCounter;
+        static std::map<AString, CacheEntry> s_entries;
+        static std::map<void*, CacheStatistics> s_statistics;//per thread, so batch mode can report reuse per command
+        static CaretMutex s_mutex;
+
+        template <typename T>
+        static CaretPointer<T> getFile(const AString& fileName, CaretPointer<T> CacheEntry::* member);
+        static void evictToSize(const int64_t& maxSize);//must hold the mutex
+
+        CommandFileCache();
+    public:
+        static void enable(const int64_t& maxMemorySize = ((int64_t)4) * 1024 * 1024 * 1024);
+        static void disable();
+        static bool isEnabled() { return s_enabled; }
+
+        static CaretPointer<LabelFile> getLabel(const AString& fileName);
+        static CaretPointer<MetricFile> getMetric(const AString& fileName);
+        static CaretPointer<SurfaceFile> getSurface(const AString& fileName);
+        static CaretPointer<VolumeFile> getVolume(const AString& fileName);
+
+        ///remove the entry for a file that is about to be overwritten
+        static void invalidate(const AString& fileName);
+        ///remove entries that a command modified in memory
+        static void releaseModified();
+        static void clear();
+
+        ///hits and misses on the current thread since the last reset
+        static void getThreadStatistics(int64_t& hitsOut, int64_t& missesOut);
+        static void resetThreadStatistics();
+    };
+
+}
+
+#endif //__COMMAND_FILE_CACHE_H__
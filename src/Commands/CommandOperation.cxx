@@ -21,6 +21,7 @@
 #include "CommandOperation.h"
 
 #include "CaretAssert.h"
+#include "CaretCommandLine.h"
 
 using namespace caret;
 
@@ -61,11 +62,33 @@ CommandOperation::~CommandOperation()
  */
 void 
 CommandOperation::execute(ProgramParameters& parameters, const bool& preventProvenance)
+{
+    execute(parameters, preventProvenance, caret_global_commandLine);
+}
+
+/**
+ * Execute the command, with a command line other than the one
+ * the program was started with (batch mode).
+ * 
+ * @param parameters
+ *   Parameters for the operation.
+ * @param preventProvenance
+ *   Don't add provenance to the output files.
+ * @param commandLine
+ *   Command line to record in provenance.
+ * @throws CommandException
+ *   If the command failed.
+ */
+void
+CommandOperation::execute(ProgramParameters& parameters, const bool& preventProvenance, const AString& commandLine)
 {
     if (preventProvenance)
     {
         disableProvenance();//let provenance-ignorant commands not need to deal with an unused parameter
+    } else {
+        enableProvenance();//in batch mode, the same command may run again without the option
     }
+    this->commandLine = commandLine;
     this->executeOperation(parameters);
 }
 
@@ -73,6 +96,19 @@ void CommandOperation::disableProvenance()
 {
 }
 
+void CommandOperation::enableProvenance()
+{
+}
+
+/**
+ * Get the command line that is being executed.
+ */
+AString
+CommandOperation::getCommandLine() const
+{
+    return this->commandLine;
+}
+
 AString CommandOperation::doCompletion(ProgramParameters&, const bool&)
 {
     return "";
@@ -39,6 +39,8 @@ namespace caret {
         
         void execute(ProgramParameters& parameters, const bool& preventProvenance);
         
+        void execute(ProgramParameters& parameters, const bool& preventProvenance, const AString& commandLine);
+        
         virtual AString doCompletion(ProgramParameters& parameters, const bool& useExtGlob);
         
     protected:
@@ -56,6 +58,10 @@ namespace caret {
         
         virtual void disableProvenance();
         
+        virtual void enableProvenance();
+        
+        AString getCommandLine() const;
+        
         CommandOperation(const AString& commandLineSwitch,
                          const AString& operationShortDescription);
         
@@ -82,6 +88,9 @@ namespace caret {
         
         /** Switch on command line */
         AString commandLineSwitch;
+        
+        /** Command line being executed, for provenance */
+        AString commandLine;
     };
     
 } // namespace
@@ -133,6 +133,7 @@
 #include "AlgorithmVolumeSmoothing.h"
 #include "AlgorithmVolumeTFCE.h"
 #include "AlgorithmVolumeToSurfaceMapping.h"
+#include "AlgorithmVolumeToSurfaceMappingStream.h"
 #include "AlgorithmVolumeVectorOperation.h"
 #include "AlgorithmVolumeWarpfieldResample.h"
 
@@ -204,9 +205,11 @@
 #include "OperationSurfaceCutResample.h"
 #include "OperationSurfaceFlipNormals.h"
 #include "OperationSurfaceGeodesicDistance.h"
+#include "OperationSurfaceGeodesicDistanceAllToAll.h"
 #include "OperationSurfaceGeodesicROIs.h"
 #include "OperationSurfaceInformation.h"
 #include "OperationSurfaceNormals.h"
+#include "OperationSurfaceResampleWeights.h"
 #include "OperationSurfaceVertexAreas.h"
 #include "OperationVolumeCapturePlane.h"
 #include "OperationVolumeCopyExtensions.h"
@@ -220,12 +223,15 @@
 #include "OperationVolumeSetSpace.h"
 #include "OperationVolumeStats.h"
 #include "OperationVolumeWeightedStats.h"
+#include "OperationWbsparseConvert.h"
 #include "OperationWbsparseMergeDense.h"
 #include "OperationZipSceneFile.h"
 #include "OperationZipSpecFile.h"
 
 #include "AlgorithmException.h"
 #include "ApplicationInformation.h"
+#include "CaretCommandLine.h"
+#include "CommandBatchRunner.h"
 #include "CommandParser.h"
 #include "OperationException.h"
 
@@ -239,14 +245,57 @@
 #include "ProgramParameters.h"
 
 #include "CaretLogger.h"
+#include "CaretProfiler.h"
+#include "CiftiColumnSidecar.h"
+#include "CiftiRemoteBlockCache.h"
 #include "dot_wrapper.h"
+#include "GiftiFile.h"
+#include "MetricSmoothingObject.h"
+#include "RibbonMappingHelper.h"
 #include "StructureEnum.h"
+#include "SurfaceResamplingHelper.h"
+
+#include <QDir>
 
 #include <iostream>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    ///prints the profile when the command finishes, including when it throws, since a failing command can still be slow
+    class ProfileReporter
+    {
+        bool m_active;
+        AString m_traceFile;
+    public:
+        ProfileReporter() { m_active = false; }
+        void start(const AString& traceFile)
+        {
+            if (CaretProfiler::isEnabled()) return;//batch mode lines with -profile don't restart an outer profile
+            m_active = true;
+            m_traceFile = traceFile;
+            CaretProfiler::enable(traceFile != "");
+        }
+        ~ProfileReporter()
+        {
+            if (!m_active) return;
+            CaretProfiler::disable();
+            cerr << CaretProfiler::getReport();
+            if (m_traceFile != "")
+            {
+                try
+                {
+                    CaretProfiler::writeTrace(m_traceFile);
+                } catch (CaretException& e) {
+                    CaretLogWarning(e.whatString());
+                }
+            }
+        }
+    };
+}
+
 /**
  * Get the command operation manager.
  *
@@ -275,6 +324,19 @@ CommandOperationManager::deleteCommandOperationManager()
     }
 }
 
+/**
+ * Create a manager that is not the singleton, with its own instances
+ * of all commands, for batch lines that run at the same time.
+ *
+ * @return
+ *   New manager, the caller must delete it.
+ */
+CommandOperationManager*
+CommandOperationManager::createIndependentManager()
+{
+    return new CommandOperationManager();
+}
+
 /**
  * Constructor.
  */
@@ -390,6 +452,7 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmVolumeSmoothing()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmVolumeTFCE()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmVolumeToSurfaceMapping()));
+    this->commandOperations.push_back(new CommandParser(new AutoAlgorithmVolumeToSurfaceMappingStream()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmVolumeVectorOperation()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmVolumeWarpfieldResample()));
     
@@ -456,9 +519,11 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceCutResample()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceFlipNormals()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceGeodesicDistance()));
+    this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceGeodesicDistanceAllToAll()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceGeodesicROIs()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceInformation()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceNormals()));
+    this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceResampleWeights()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceVertexAreas()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationVolumeCapturePlane()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationVolumeCopyExtensions()));
@@ -472,6 +537,7 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoOperationVolumeSetSpace()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationVolumeStats()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationVolumeWeightedStats()));
+    this->commandOperations.push_back(new CommandParser(new AutoOperationWbsparseConvert()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationWbsparseMergeDense()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationZipSceneFile()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationZipSpecFile()));
@@ -523,9 +589,40 @@ CommandOperationManager::~CommandOperationManager()
  */
 void 
 CommandOperationManager::runCommand(ProgramParameters& parameters)
+{
+    runCommand(parameters, caret_global_commandLine);
+}
+
+/**
+ * Run a command, with a command line other than the one the program
+ * was started with (batch mode).
+ * 
+ * @param parameters
+ *    Reference to the command's parameters.
+ * @param commandLine
+ *    Command line to record in provenance.
+ * @throws CommandException
+ *    If the command failed.
+ */
+void
+CommandOperationManager::runCommand(ProgramParameters& parameters, const AString& commandLine)
 {
     vector<AString> globalOptionArgs;
     bool preventProvenance = getGlobalOption(parameters, "-disable-provenance", 0, globalOptionArgs);//check these BEFORE we test if we have a command switch, because they remove the switch and arguments from the ProgramParameters
+    if (CommandBatchRunner::isRunning())
+    {//the rest are process-wide settings, on a batch line they would stay set for the following lines and change the commands running alongside it
+        const int NUM_PROCESS_OPTIONS = 9;
+        const char* processOptions[NUM_PROCESS_OPTIONS] = { "-logging", "-simd", "-gifti-compression", "-gifti-external-binary", "-resample-cache",
+                                                            "-cifti-column-cache", "-cifti-remote-cache", "-profile-trace", "-profile" };
+        const int processOptionArgs[NUM_PROCESS_OPTIONS] = { 1, 1, 1, 1, 1, 1, 2, 1, 0 };
+        for (int i = 0; i < NUM_PROCESS_OPTIONS; ++i)
+        {
+            if (getGlobalOption(parameters, processOptions[i], processOptionArgs[i], globalOptionArgs))
+            {
+                throw CommandException("global option '" + AString(processOptions[i]) + "' can't be used on a batch line, give it before -batch to apply it to the whole batch");
+            }
+        }
+    }
     if (getGlobalOption(parameters, "-logging", 1, globalOptionArgs))
     {
         bool valid = false;
@@ -544,6 +641,63 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
             CaretLogWarning("SIMD type '" + DotSIMDEnum::toName(impl) + "' not supported (could be cpu, compiler, or build options), using '" + DotSIMDEnum::toName(retval) + "'");
         }
     }
+    if (getGlobalOption(parameters, "-gifti-compression", 1, globalOptionArgs))
+    {
+        bool valid = false;
+        const int level = globalOptionArgs[0].toInt(&valid);
+        if (!valid || level < 0 || level > 9) throw CommandException("gifti compression level must be an integer from 0 to 9, got '" + globalOptionArgs[0] + "'");
+        GiftiFile::setCompressionLevelForWriting(level);
+    }
+    if (getGlobalOption(parameters, "-gifti-external-binary", 1, globalOptionArgs))
+    {
+        bool valid = false;
+        const double megabytes = globalOptionArgs[0].toDouble(&valid);
+        if (!valid || megabytes <= 0.0) throw CommandException("gifti external binary size must be a positive number of megabytes, got '" + globalOptionArgs[0] + "'");
+        GiftiFile::setExternalBinaryThresholdForWriting((int64_t)(megabytes * 1024 * 1024));
+    }
+    if (getGlobalOption(parameters, "-resample-cache", 1, globalOptionArgs))
+    {
+        QDir cacheDir(globalOptionArgs[0]);
+        if (!cacheDir.exists() && !cacheDir.mkpath("."))
+        {
+            throw CommandException("unable to create resampling cache directory: '" + globalOptionArgs[0] + "'");
+        }
+        SurfaceResamplingHelper::setCacheDirectory(cacheDir.absolutePath());
+        RibbonMappingHelper::setCacheDirectory(cacheDir.absolutePath());
+        MetricSmoothingObject::setCacheDirectory(cacheDir.absolutePath());
+    }
+    if (getGlobalOption(parameters, "-cifti-column-cache", 1, globalOptionArgs))
+    {
+        QDir cacheDir(globalOptionArgs[0]);
+        if (!cacheDir.exists() && !cacheDir.mkpath("."))
+        {
+            throw CommandException("unable to create cifti column cache directory: '" + globalOptionArgs[0] + "'");
+        }
+        CiftiColumnSidecar::setDirectory(cacheDir.absolutePath());
+        CiftiColumnSidecar::setAutoBuild(true);
+    }
+    if (getGlobalOption(parameters, "-cifti-remote-cache", 2, globalOptionArgs))
+    {
+        QDir cacheDir(globalOptionArgs[0]);
+        if (!cacheDir.exists() && !cacheDir.mkpath("."))
+        {
+            throw CommandException("unable to create remote cifti cache directory: '" + globalOptionArgs[0] + "'");
+        }
+        bool valid = false;
+        const double megabytes = globalOptionArgs[1].toDouble(&valid);
+        if (!valid || megabytes <= 0.0) throw CommandException("remote cifti cache size must be a positive number of megabytes, got '" + globalOptionArgs[1] + "'");
+        CiftiRemoteBlockCache::setDirectory(cacheDir.absolutePath());
+        CiftiRemoteBlockCache::setMaxBytes((int64_t)(megabytes * 1024 * 1024));
+    }
+    ProfileReporter myProfile;
+    if (getGlobalOption(parameters, "-profile-trace", 1, globalOptionArgs))
+    {
+        myProfile.start(globalOptionArgs[0]);
+    }
+    if (getGlobalOption(parameters, "-profile", 0, globalOptionArgs))
+    {
+        myProfile.start("");
+    }
 
     const uint64_t numberOfCommands = this->commandOperations.size();
     const uint64_t numberOfDeprecated = this->deprecatedOperations.size();
@@ -573,6 +727,17 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
         printDeprecatedCommands();
     } else if (commandSwitch == "-all-commands-help") {
         printAllCommandsHelpInfo("wb_command");
+    } else if (commandSwitch == "-batch") {
+        AString scriptName = parameters.nextString("batch script");
+        int numJobs = 1;
+        if (parameters.hasNext())
+        {
+            AString jobsSwitch = parameters.nextString("batch option");
+            if (jobsSwitch != "-jobs") throw CommandException("unrecognized option to -batch: '" + jobsSwitch + "'");
+            numJobs = (int)parameters.nextLong("number of jobs");
+        }
+        parameters.verifyAllParametersProcessed();
+        CommandBatchRunner::run(this, scriptName, numJobs);
     } else {
         
         CommandOperation* operation = NULL;
@@ -609,7 +774,7 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
             {
                 cout << operation->getHelpInformation("wb_command") << endl;
             } else {
-                operation->execute(parameters, preventProvenance);
+                operation->execute(parameters, preventProvenance, commandLine);
             }
         }
     }
@@ -645,12 +810,35 @@ AString CommandOperationManager::doCompletion(ProgramParameters& parameters, con
         }
         return ret;
     }
-    ret = "wordlist -disable-provenance\\ -logging\\ -simd";//we could prevent suggesting an already-provided global option, but that would be a bit surprising
+    /*OptionInfo compressionInfo = */parseGlobalOption(parameters, "-gifti-compression", 1, globalOptionArgs, true);//numbers, nothing to complete
+    /*OptionInfo externalInfo = */parseGlobalOption(parameters, "-gifti-external-binary", 1, globalOptionArgs, true);
+    OptionInfo cacheInfo = parseGlobalOption(parameters, "-resample-cache", 1, globalOptionArgs, true);
+    if (cacheInfo.specified && !cacheInfo.complete)
+    {//a directory, there is no directory-only hint, so glob everything
+        return "fileglob *";
+    }
+    OptionInfo columnCacheInfo = parseGlobalOption(parameters, "-cifti-column-cache", 1, globalOptionArgs, true);
+    if (columnCacheInfo.specified && !columnCacheInfo.complete)
+    {
+        return "fileglob *";
+    }
+    OptionInfo remoteCacheInfo = parseGlobalOption(parameters, "-cifti-remote-cache", 2, globalOptionArgs, true);
+    if (remoteCacheInfo.specified && !remoteCacheInfo.complete)
+    {//directory first, then a number, don't bother distinguishing
+        return "fileglob *";
+    }
+    OptionInfo traceInfo = parseGlobalOption(parameters, "-profile-trace", 1, globalOptionArgs, true);
+    if (traceInfo.specified && !traceInfo.complete)
+    {
+        return "fileglob *.json";
+    }
+    /*OptionInfo profileInfo = */parseGlobalOption(parameters, "-profile", 0, globalOptionArgs, true);
+    ret = "wordlist -cifti-column-cache\\ -cifti-remote-cache\\ -disable-provenance\\ -gifti-compression\\ -gifti-external-binary\\ -logging\\ -profile\\ -profile-trace\\ -resample-cache\\ -simd";//we could prevent suggesting an already-provided global option, but that would be a bit surprising
     const uint64_t numberOfCommands = this->commandOperations.size();
     const uint64_t numberOfDeprecated = this->deprecatedOperations.size();
     if (!parameters.hasNext())
     {//suggest all commands, including deprecated and informational (order doesn't matter, bash sorts them before displaying)
-        ret += "\\ -help\\ -arguments-help\\ -cifti-help\\ -gifti-help\\ -version\\ -list-commands\\ -list-deprecated-commands\\ -all-commands-help";
+        ret += "\\ -batch\\ -help\\ -arguments-help\\ -cifti-help\\ -gifti-help\\ -version\\ -list-commands\\ -list-deprecated-commands\\ -all-commands-help";
         for (uint64_t i = 0; i < numberOfCommands; i++)
         {
             ret += "\\ " + commandOperations[i]->getCommandLineSwitch();
@@ -904,8 +1092,30 @@ void CommandOperationManager::printHelpInfo()
     cout << "   -list-deprecated-commands   list deprecated subcommands" << endl;
     cout << "   -all-commands-help          show all processing subcommands and their help" << endl;
     cout << "                                  info - VERY LONG" << endl;
+    cout << endl << "Batch mode:" << endl;
+    cout << "   -batch <script> [-jobs <n>] run the commands in a script (one per line," << endl;
+    cout << "                                  '-' reads from standard input or a fifo)" << endl;
+    cout << "                                  in one process, reusing input files and" << endl;
+    cout << "                                  surface helpers between commands, and" << endl;
+    cout << "                                  running up to <n> commands at once when" << endl;
+    cout << "                                  they don't depend on each other's outputs" << endl;
+    cout << "                                  (global options other than -disable-provenance" << endl;
+    cout << "                                  go before -batch, not on lines of the script)" << endl;
     cout << endl << "Global options (can be added to any command):" << endl;
+    cout << "   -cifti-column-cache <dir>   save a column-major copy of 2D cifti inputs in" << endl;
+    cout << "                                  the given directory the first time a" << endl;
+    cout << "                                  command reads them by column, and reuse it" << endl;
+    cout << "                                  while the input file is unchanged" << endl;
+    cout << "   -cifti-remote-cache <dir> <MB>" << endl;
+    cout << "                               keep up to <MB> megabytes of rows read from" << endl;
+    cout << "                                  cifti URLs in the given directory, reused" << endl;
+    cout << "                                  while the server reports the same ETag" << endl;
     cout << "   -disable-provenance         don't generate provenance info in output files" << endl;
+    cout << "   -gifti-compression <level>  compression level for gzip gifti output, 0 to" << endl;
+    cout << "                                  9, default 6, lower is faster but larger" << endl;
+    cout << "   -gifti-external-binary <MB> write gifti data arrays of at least this many" << endl;
+    cout << "                                  megabytes to an external binary file" << endl;
+    cout << "                                  (<output>.data), which is much faster" << endl;
     cout << "   -logging <level>            set the logging level, valid values are:" << endl;
     vector<LogLevelEnum::Enum> logLevels;
     LogLevelEnum::getAllEnums(logLevels);
@@ -915,6 +1125,15 @@ void CommandOperationManager::printHelpInfo()
         cout << "            " << LogLevelEnum::toName(*iter) << endl;
     }
     cout << endl;//add a line after the logging types for readability
+    cout << "   -profile                    print a tree of time spent in file reading," << endl;
+    cout << "                                  computation, and writing to standard" << endl;
+    cout << "                                  error when the command finishes" << endl;
+    cout << "   -profile-trace <file>       also write every timed section to a json file" << endl;
+    cout << "                                  viewable in chrome://tracing or perfetto" << endl;
+    cout << "   -resample-cache <directory> save surface resampling, ribbon mapping and" << endl;
+    cout << "                                  surface smoothing weights in the given" << endl;
+    cout << "                                  directory, and reuse them when the inputs" << endl;
+    cout << "                                  are the same" << endl;
     //guide for wrap, assuming 80 columns:                                                  |
     cout << "   -simd <type>                set the SIMD implementation to use (currently" << endl;
     cout << "                                  used only for correlation, default AUTO which" << endl;
@@ -40,10 +40,15 @@ namespace caret {
         
         static void deleteCommandOperationManager();
         
+        ///create a separate manager with its own command objects, so batch lines can run the same command at the same time
+        static CommandOperationManager* createIndependentManager();
+        
         ~CommandOperationManager();
         
         void runCommand(ProgramParameters& parameters);
         
+        void runCommand(ProgramParameters& parameters, const AString& commandLine);
+        
         AString doCompletion(ProgramParameters& parameters, const bool& useExtGlob);
         
         std::vector<CommandOperation*> getCommandOperations();
@@ -27,7 +27,9 @@
 #include "CaretCommandLine.h"
 #include "CaretDataFileHelper.h"
 #include "CaretLogger.h"
+#include "CaretProfiler.h"
 #include "CiftiFile.h"
+#include "CommandFileCache.h"
 #include "DataFileException.h"
 #include "FileInformation.h"
 #include "FociFile.h"
@@ -55,6 +57,7 @@ CommandParser::CommandParser(AutoOperationInterface* myAutoOper) :
     OperationParserInterface(myAutoOper)
 {
     m_doProvenance = true;
+    m_profileName = getCommandLineSwitch().toLocal8Bit();
 }
 
 void CommandParser::disableProvenance()
@@ -62,22 +65,35 @@ void CommandParser::disableProvenance()
     m_doProvenance = false;
 }
 
+void CommandParser::enableProvenance()
+{
+    m_doProvenance = true;
+}
+
 void CommandParser::executeOperation(ProgramParameters& parameters)
 {
     CaretPointer<OperationParameters> myAlgParams(m_autoOper->getParameters());//could be an autopointer, but this is safer
     vector<OutputAssoc> myOutAssoc;
-    m_provenance = caret_global_commandLine;
+    m_provenance = getCommandLine();
     //the idea is to have m_provenance set before the command executes, so it can be overridden, but have m_parentProvenance set AFTER the processing is complete
     //the parent provenance should never be generated manually
     m_parentProvenance = "";//in case someone tries to use the same instance more than once
+    m_inputCiftiNames.clear();//batch mode does use the same instance more than once, and the files from the previous run are gone
     m_workingDir = QDir::currentPath();//get the current path, in case some stupid command changes the working directory
-    //these get set on output files during writeOutput (and for on-disk in provenanceBeforeOperation)
-    parseComponent(myAlgParams.getPointer(), parameters, myOutAssoc);//parsing block
-    parameters.verifyAllParametersProcessed();
-    makeOnDiskOutputs(myOutAssoc);//check for input on-disk files used as output on-disk files
+    CaretProfileScope commandScope(m_profileName.constData());
+    {
+        CaretProfileScope inputScope("read inputs");
+        //these get set on output files during writeOutput (and for on-disk in provenanceBeforeOperation)
+        parseComponent(myAlgParams.getPointer(), parameters, myOutAssoc);//parsing block
+        parameters.verifyAllParametersProcessed();
+        makeOnDiskOutputs(myOutAssoc);//check for input on-disk files used as output on-disk files
+    }
     //code to show what arguments map to what parameters should go here
     if (m_doProvenance) provenanceBeforeOperation(myOutAssoc);
-    m_autoOper->useParameters(myAlgParams.getPointer(), NULL);//TODO: progress status for caret_command? would probably get messed up by any command info output
+    {
+        CaretProfileScope computeScope("compute");
+        m_autoOper->useParameters(myAlgParams.getPointer(), NULL);//TODO: progress status for caret_command? would probably get messed up by any command info output
+    }
     vector<AString> uncheckedWarnings = myAlgParams->findUncheckedParams("the command");
     for (size_t i = 0; i < uncheckedWarnings.size(); ++i)
     {
@@ -85,6 +101,7 @@ void CommandParser::executeOperation(ProgramParameters& parameters)
     }
     if (m_doProvenance) provenanceAfterOperation(myOutAssoc);
     //TODO: deallocate input files - give abstract parameter a virtual deallocate method? use CaretPointer and rely on reference counting?
+    CaretProfileScope outputScope("write outputs");
     writeOutput(myOutAssoc);
 }
 
@@ -246,8 +263,14 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::LABEL:
                 {
-                    CaretPointer<LabelFile> myFile(new LabelFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<LabelFile> myFile;
+                    if (CommandFileCache::isEnabled())
+                    {
+                        myFile = CommandFileCache::getLabel(nextArg);
+                    } else {
+                        myFile.grabNew(new LabelFile());
+                        myFile->readFile(nextArg);
+                    }
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -270,8 +293,14 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::METRIC:
                 {
-                    CaretPointer<MetricFile> myFile(new MetricFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<MetricFile> myFile;
+                    if (CommandFileCache::isEnabled())
+                    {
+                        myFile = CommandFileCache::getMetric(nextArg);
+                    } else {
+                        myFile.grabNew(new MetricFile());
+                        myFile->readFile(nextArg);
+                    }
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -304,8 +333,14 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::SURFACE:
                 {
-                    CaretPointer<SurfaceFile> myFile(new SurfaceFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<SurfaceFile> myFile;
+                    if (CommandFileCache::isEnabled())
+                    {
+                        myFile = CommandFileCache::getSurface(nextArg);
+                    } else {
+                        myFile.grabNew(new SurfaceFile());
+                        myFile->readFile(nextArg);
+                    }
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -328,8 +363,14 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::VOLUME:
                 {
-                    CaretPointer<VolumeFile> myFile(new VolumeFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<VolumeFile> myFile;
+                    if (CommandFileCache::isEnabled())
+                    {
+                        myFile = CommandFileCache::getVolume(nextArg);
+                    } else {
+                        myFile.grabNew(new VolumeFile());
+                        myFile->readFile(nextArg);
+                    }
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -532,6 +573,137 @@ void CommandParser::parseRemainingOptions(ParameterComponent* myComponent, Progr
     }
 }
 
+void CommandParser::getFileArguments(ProgramParameters& parameters, vector<AString>& inputFilesOut, vector<AString>& outputFilesOut, vector<AString>& sharedFilesOut)
+{
+    CaretPointer<OperationParameters> myAlgParams(m_autoOper->getParameters());//could be an autopointer, but this is safer
+    FileArguments myArgs;
+    fileArgumentsComponent(myAlgParams.getPointer(), parameters, myArgs);
+    parameters.verifyAllParametersProcessed();
+    inputFilesOut = myArgs.m_inputs;
+    outputFilesOut = myArgs.m_outputs;
+    sharedFilesOut = myArgs.m_shared;
+    //strings that look like file names are usually side inputs (label lists, templates), but commands with no outputs of their own
+    //(-set-structure, -metric-palette, ...) modify files named by a string in place
+    bool modifiesInPlace = outputFilesOut.empty();
+    for (int i = 0; i < (int)myArgs.m_strings.size(); ++i)
+    {
+        inputFilesOut.push_back(myArgs.m_strings[i]);
+        if (modifiesInPlace) outputFilesOut.push_back(myArgs.m_strings[i]);
+    }
+}
+
+void CommandParser::fileArgumentsComponent(ParameterComponent* myComponent, ProgramParameters& parameters, FileArguments& argsOut)
+{//IMPORTANT: keep this in sync with parseComponent(), but don't open any files
+    for (int i = 0; i < (int)myComponent->m_paramList.size(); ++i)
+    {
+        AString nextArg = parameters.nextString(myComponent->m_paramList[i]->m_shortName).fixUnicodeHyphens();
+        if (!nextArg.isEmpty() && nextArg[0] == '-')
+        {
+            if (fileArgumentsOption(nextArg, myComponent, parameters, argsOut))
+            {
+                --i;
+                continue;
+            }
+        }
+        switch (myComponent->m_paramList[i]->getType())
+        {
+            case OperationParametersEnum::SURFACE:
+            case OperationParametersEnum::VOLUME:
+                argsOut.m_inputs.push_back(nextArg);
+                argsOut.m_shared.push_back(nextArg);//CommandFileCache gives every command the same object for these
+                break;
+            case OperationParametersEnum::BORDER:
+            case OperationParametersEnum::CIFTI:
+            case OperationParametersEnum::FOCI:
+            case OperationParametersEnum::LABEL:
+            case OperationParametersEnum::METRIC:
+                argsOut.m_inputs.push_back(nextArg);
+                break;
+            case OperationParametersEnum::STRING:
+            {//some commands take file names as strings, and may read or write them
+                bool isNumber = false;
+                nextArg.toDouble(&isNumber);
+                if (!isNumber && (nextArg.contains('/') || nextArg.contains('.')))
+                {
+                    const AbstractParameter* myParam = myComponent->m_paramList[i];
+                    if (myParam->m_shortName.contains("out", Qt::CaseInsensitive) || myParam->m_description.startsWith("out", Qt::CaseInsensitive))
+                    {//faked output formatting, see for instance -cifti-label-export-table
+                        argsOut.m_outputs.push_back(nextArg);
+                    } else {
+                        argsOut.m_strings.push_back(nextArg);//decided once the whole command is seen
+                    }
+                }
+                break;
+            }
+            case OperationParametersEnum::BOOL:
+            case OperationParametersEnum::DOUBLE:
+            case OperationParametersEnum::INT:
+                break;
+        }
+    }
+    for (int i = 0; i < (int)myComponent->m_outputList.size(); ++i)
+    {
+        AString nextArg = parameters.nextString(myComponent->m_outputList[i]->m_shortName).fixUnicodeHyphens();
+        if (!nextArg.isEmpty() && nextArg[0] == '-')
+        {
+            if (!fileArgumentsOption(nextArg, myComponent, parameters, argsOut))
+            {
+                throw ProgramParametersException("Invalid option \"" + nextArg + "\" while next reqired argument is <" + myComponent->m_outputList[i]->m_shortName +
+                ">, option is either incorrect, or incorrectly placed");
+            }
+            --i;
+            continue;
+        }
+        switch (myComponent->m_outputList[i]->getType())
+        {
+            case OperationParametersEnum::BOOL://primitive outputs only get printed
+            case OperationParametersEnum::DOUBLE:
+            case OperationParametersEnum::INT:
+            case OperationParametersEnum::STRING:
+                break;
+            default:
+                argsOut.m_outputs.push_back(nextArg);
+                break;
+        }
+    }
+    while (parameters.hasNext())
+    {
+        AString nextArg = parameters.nextString("option").fixUnicodeHyphens();
+        if (nextArg.isEmpty() || nextArg[0] != '-' || !fileArgumentsOption(nextArg, myComponent, parameters, argsOut))
+        {
+            parameters.backup();
+            return;
+        }
+    }
+}
+
+bool CommandParser::fileArgumentsOption(const AString& mySwitch, ParameterComponent* myComponent, ProgramParameters& parameters, FileArguments& argsOut)
+{
+    for (uint32_t i = 0; i < myComponent->m_optionList.size(); ++i)
+    {
+        if (mySwitch == myComponent->m_optionList[i]->m_optionSwitch)
+        {
+            if (myComponent->m_optionList[i]->m_present)
+            {
+                throw ProgramParametersException("Option \"" + mySwitch + "\" specified more than once");
+            }
+            myComponent->m_optionList[i]->m_present = true;
+            fileArgumentsComponent(myComponent->m_optionList[i], parameters, argsOut);
+            return true;
+        }
+    }
+    for (uint32_t i = 0; i < myComponent->m_repeatableOptions.size(); ++i)
+    {
+        if (mySwitch == myComponent->m_repeatableOptions[i]->m_optionSwitch)
+        {
+            myComponent->m_repeatableOptions[i]->m_instances.push_back(new ParameterComponent(myComponent->m_repeatableOptions[i]->m_template));
+            fileArgumentsComponent(myComponent->m_repeatableOptions[i]->m_instances.back(), parameters, argsOut);
+            return true;
+        }
+    }
+    return false;
+}
+
 AString CommandParser::doCompletion(ProgramParameters& parameters, const bool& useExtGlob)
 {
     CaretPointer<OperationParameters> myAlgParams(m_autoOper->getParameters());//could be an autopointer, but this is safer
@@ -959,6 +1131,7 @@ void CommandParser::writeOutput(const vector<OutputAssoc>& outAssociation)
     for (uint32_t i = 0; i < outAssociation.size(); ++i)
     {
         AbstractParameter* myParam = outAssociation[i].m_param;
+        if (CommandFileCache::isEnabled()) CommandFileCache::invalidate(outAssociation[i].m_fileName);//don't let a later command get the old contents
         switch (myParam->getType())
         {
             case OperationParametersEnum::BOOL://ignores the name you give the output for now, but what gives primitive type output and how is it used?
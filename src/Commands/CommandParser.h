@@ -37,6 +37,7 @@ namespace caret {
         int m_minIndent, m_maxIndent, m_indentIncrement, m_maxWidth;
         AString m_provenance, m_parentProvenance, m_workingDir;
         bool m_doProvenance;
+        QByteArray m_profileName;//the profiler keeps scope names by pointer, so this has to live as long as the parser
         const static AString PROVENANCE_NAME, PARENT_PROVENANCE_NAME, PROGRAM_PROVENANCE_NAME, CWD_PROVENANCE_NAME;//TODO: put this elsewhere?
         std::map<AString, const CiftiFile*> m_inputCiftiNames;
         struct OutputAssoc
@@ -68,10 +69,20 @@ namespace caret {
         CompletionInfo completionOption(const AString& mySwitch, ParameterComponent* myComponent, ProgramParameters& parameters, const bool& useExtGlob);
         AString completionOptionHints(ParameterComponent* myComponent, const bool& useExtGlob);
         CompletionInfo completionRemainingOptions(ParameterComponent* myComponent, ProgramParameters& parameters, const bool& useExtGlob);
+        struct FileArguments
+        {
+            std::vector<AString> m_inputs, m_outputs, m_shared, m_strings;//strings that look like file names are sorted out at the end
+        };
+        void fileArgumentsComponent(ParameterComponent* myComponent, ProgramParameters& parameters, FileArguments& argsOut);
+        bool fileArgumentsOption(const AString& mySwitch, ParameterComponent* myComponent, ProgramParameters& parameters, FileArguments& argsOut);
     public:
         CommandParser(AutoOperationInterface* myAutoOper);
         void disableProvenance();
+        void enableProvenance();
         void executeOperation(ProgramParameters& parameters);
+        ///find the files a command line will read and write, without opening any files (for scheduling batch mode commands)
+        ///sharedFilesOut gets the inputs that batch mode gives to commands as shared objects (surfaces and volumes), which must not be used by two commands at once
+        void getFileArguments(ProgramParameters& parameters, std::vector<AString>& inputFilesOut, std::vector<AString>& outputFilesOut, std::vector<AString>& sharedFilesOut);
         void showParsedOperation(ProgramParameters& parameters);
         AString doCompletion(ProgramParameters& parameters, const bool& useExtGlob);
         AString getHelpInformation(const AString& programName);
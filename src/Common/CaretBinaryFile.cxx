@@ -33,7 +33,13 @@
 #include <QFile>
 #include "zlib.h"
 
+#ifndef CARET_OS_WINDOWS
+#include <cerrno>
+#include <unistd.h>
+#endif
+
 #include <algorithm>
+#include <limits>
 
 using namespace caret;
 using namespace std;
@@ -63,14 +69,20 @@ namespace caret
     class QFileImpl : public CaretBinaryFile::ImplInterface
     {
         QFile m_file;
+        uchar* m_mapped;
+        int64_t m_mappedSize;
+        bool m_readOnly;//QFile buffers writes, so only bypass it for positional reads when we never write
         const static int64_t CHUNK_SIZE;
     public:
+        QFileImpl() { m_mapped = NULL; m_mappedSize = 0; m_readOnly = false; }
         void open(const QString& filename, const CaretBinaryFile::OpenMode& opmode);
         void close();
         void seek(const int64_t& position);
         int64_t pos();
         void read(void* dataOut, const int64_t& count, int64_t* numRead);
         void write(const void* dataIn, const int64_t& count);
+        const char* map(int64_t& sizeOut);
+        void readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead);
     };
     
     const int64_t QFileImpl::CHUNK_SIZE = 1<<30;//1GiB, QT4 apparently chokes at more than 2GiB via buffer.read using int32
@@ -154,6 +166,42 @@ void CaretBinaryFile::write(const void* dataIn, const int64_t& count)
     m_impl->write(dataIn, count);
 }
 
+const char* CaretBinaryFile::mapForRead(int64_t& sizeOut)
+{
+    if (m_curMode == NONE) throw DataFileException("file is not open, can't map");
+    return m_impl->map(sizeOut);
+}
+
+void CaretBinaryFile::readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead)
+{
+    CaretAssert(count >= 0);
+    CaretAssert(position >= 0);
+    if (!getOpenForRead()) throw DataFileException("file is not open for reading");
+    m_impl->readAt(dataOut, count, position, numRead);
+}
+
+void CaretBinaryFile::writeAt(const void* dataIn, const int64_t& count, const int64_t& position)
+{
+    CaretAssert(count >= 0);
+    CaretAssert(position >= 0);
+    if (!getOpenForWrite()) throw DataFileException("file is not open for writing");
+    m_impl->writeAt(dataIn, count, position);
+}
+
+void CaretBinaryFile::ImplInterface::readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead)
+{
+    CaretMutexLocker locked(&m_positionalMutex);
+    seek(position);
+    read(dataOut, count, numRead);
+}
+
+void CaretBinaryFile::ImplInterface::writeAt(const void* dataIn, const int64_t& count, const int64_t& position)
+{
+    CaretMutexLocker locked(&m_positionalMutex);
+    seek(position);
+    write(dataIn, count);
+}
+
 #ifdef ZLIB_VERSION
 void ZFileImpl::open(const QString& filename, const CaretBinaryFile::OpenMode& opmode)
 {
@@ -281,6 +329,7 @@ void QFileImpl::open(const QString& filename, const CaretBinaryFile::OpenMode& o
     if (opmode & CaretBinaryFile::READ) mode |= QIODevice::ReadOnly;
     if (opmode & CaretBinaryFile::WRITE) mode |= QIODevice::WriteOnly;
     if (opmode & CaretBinaryFile::TRUNCATE) mode |= QIODevice::Truncate;//expect QFile to recognize silliness like TRUNCATE by itself
+    m_readOnly = (opmode == CaretBinaryFile::READ);
     m_file.setFileName(filename);
     if (!m_file.open(mode))
     {
@@ -310,9 +359,38 @@ void QFileImpl::open(const QString& filename, const CaretBinaryFile::OpenMode& o
 
 void QFileImpl::close()
 {
+    if (m_mapped != NULL)
+    {
+        m_file.unmap(m_mapped);
+        m_mapped = NULL;
+        m_mappedSize = 0;
+    }
     m_file.close();
 }
 
+const char* QFileImpl::map(int64_t& sizeOut)
+{
+    if (m_mapped == NULL)
+    {
+        int64_t fileSize = m_file.size();
+        if (fileSize <= 0 || (uint64_t)fileSize > (uint64_t)numeric_limits<size_t>::max())
+        {//can't map empty files, or files larger than the address space (32-bit)
+            sizeOut = 0;
+            return NULL;
+        }
+        m_mapped = m_file.map(0, fileSize);//QFile doesn't let us request read-only mapping explicitly, but it follows the open mode
+        if (m_mapped == NULL)
+        {
+            CaretLogFine("unable to memory map file '" + m_fileName + "', using normal reads");
+            sizeOut = 0;
+            return NULL;
+        }
+        m_mappedSize = fileSize;
+    }
+    sizeOut = m_mappedSize;
+    return (const char*)m_mapped;
+}
+
 void QFileImpl::read(void* dataOut, const int64_t& count, int64_t* numRead)
 {
     int64_t total = 0;
@@ -336,6 +414,38 @@ void QFileImpl::read(void* dataOut, const int64_t& count, int64_t* numRead)
     }
 }
 
+void QFileImpl::readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead)
+{
+#ifndef CARET_OS_WINDOWS
+    if (m_readOnly)
+    {//pread doesn't touch the file position, so no lock is needed - QFile's read buffer is bypassed, which is fine since we never write
+        int fd = m_file.handle();
+        int64_t total = 0;
+        int64_t readret = -1;
+        while (total < count)
+        {
+            int64_t maxToRead = min(count - total, CHUNK_SIZE);
+            readret = ::pread(fd, ((char*)dataOut) + total, maxToRead, position + total);
+            if (readret < 0 && errno == EINTR) continue;
+            if (readret < 1) break;//0 or -1 means error or eof
+            total += readret;
+        }
+        if (numRead == NULL)
+        {
+            if (total != count)
+            {
+                if (readret < 0) throw DataFileException("error while reading file '" + m_fileName + "'");
+                throw DataFileException("premature end of file in '" + m_fileName + "'");
+            }
+        } else {
+            *numRead = total;
+        }
+        return;
+    }
+#endif
+    CaretBinaryFile::ImplInterface::readAt(dataOut, count, position, numRead);
+}
+
 void QFileImpl::seek(const int64_t& position)
 {
     if (!m_file.seek(position)) throw DataFileException("seek failed in file '" + m_fileName + "'");
@@ -21,6 +21,7 @@
  */
 /*LICENSE_END*/
 
+#include "CaretMutex.h"
 #include "CaretPointer.h"
 
 #include <QString>
@@ -55,8 +56,14 @@ namespace caret {
         int64_t pos();
         void read(void* dataOut, const int64_t& count, int64_t* numRead = NULL);//throw if numRead is NULL and (error or end of file reached early)
         void write(const void* dataIn, const int64_t& count);//failure to complete write is always an exception
+        const char* mapForRead(int64_t& sizeOut);//read-only view of the whole file, NULL if the implementation can't map (compressed), only valid until close()
+        //positional versions don't use or change the current position, and can be called from multiple threads at once
+        //don't mix them with seek/read/write from other threads, as the fallback implementation must still seek
+        void readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead = NULL);
+        void writeAt(const void* dataIn, const int64_t& count, const int64_t& position);
         class ImplInterface
         {
+            CaretMutex m_positionalMutex;//for the default positional functions
         protected:
             QString m_fileName;//filename is tracked here so error messages can be implementation-specific
         public:
@@ -67,6 +74,9 @@ namespace caret {
             virtual int64_t pos() = 0;
             virtual void read(void* dataOut, const int64_t& count, int64_t* numRead) = 0;
             virtual void write(const void* dataIn, const int64_t& count) = 0;
+            virtual const char* map(int64_t& sizeOut) { sizeOut = 0; return NULL; }//default is to not support mapping
+            virtual void readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead);//default locks, seeks and reads
+            virtual void writeAt(const void* dataIn, const int64_t& count, const int64_t& position);//default locks, seeks and writes
             virtual ~ImplInterface();
         };
     private:
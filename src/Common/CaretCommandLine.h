@@ -23,6 +23,8 @@
 
 #include "AString.h"
 
+#include <vector>
+
 namespace caret {
     
     class ProgramParameters;
@@ -33,6 +35,9 @@ namespace caret {
     
     void caret_global_commandLine_init(const int& argc, const char *const * argv);
     
+    ///format a command line the same way as caret_global_commandLine, without changing it (for commands run in batch mode)
+    AString caret_format_commandLine(const AString& programName, const std::vector<AString>& params);
+    
 }
 
 #endif //__CARET_COMMAND_LINE_H__
@@ -0,0 +1,194 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretFFT.h"
+
+#include "CaretAssert.h"
+#include "CaretException.h"
+#include "CaretOMP.h"
+
+#include <cmath>
+
+using namespace caret;
+using namespace std;
+
+CaretFFT::CaretFFT(const int64_t& size)
+{
+    if (size < 1) throw CaretException("FFT size must be positive");
+    m_size = size;
+    m_maxRadix = 1;
+    int64_t remaining = size, radix = 2;
+    while (remaining > 1)
+    {
+        while (remaining % radix != 0)
+        {
+            if (radix * radix > remaining)
+            {
+                radix = remaining;//remaining is prime
+            } else {
+                radix = (radix == 2 ? 3 : radix + 2);
+            }
+        }
+        remaining /= radix;
+        m_factors.push_back(radix);
+        m_factors.push_back(remaining);
+        if (radix > m_maxRadix) m_maxRadix = radix;
+    }
+    if (m_factors.empty())
+    {//size 1, treat as a single radix 1 stage
+        m_factors.push_back(1);
+        m_factors.push_back(1);
+    }
+    m_twiddles.resize(size);
+    for (int64_t i = 0; i < size; ++i)
+    {
+        double phase = -2.0 * 3.14159265358979323846 * i / size;
+        m_twiddles[i] = complex<double>(cos(phase), sin(phase));
+    }
+}
+
+int64_t CaretFFT::goodSize(const int64_t& minSize)
+{
+    if (minSize <= 1) return 1;
+    for (int64_t ret = minSize; ; ++ret)
+    {
+        int64_t remaining = ret;
+        while (remaining % 2 == 0) remaining /= 2;
+        while (remaining % 3 == 0) remaining /= 3;
+        while (remaining % 5 == 0) remaining /= 5;
+        if (remaining == 1) return ret;
+    }
+}
+
+void CaretFFT::transform(const complex<double>* input, complex<double>* output, const bool& inverse, const int64_t& inputStride) const
+{
+    CaretAssert(input != output);
+    const int64_t SMALL_RADIX = 8;
+    complex<double> smallScratch[SMALL_RADIX];
+    vector<complex<double> > bigScratch;
+    complex<double>* scratch = smallScratch;
+    if (m_maxRadix > SMALL_RADIX)
+    {
+        bigScratch.resize(m_maxRadix);
+        scratch = bigScratch.data();
+    }
+    work(output, input, 1, inputStride, m_factors.data(), inverse, scratch);
+}
+
+void CaretFFT::work(complex<double>* out, const complex<double>* in, const int64_t& fstride, const int64_t& inStride, const int64_t* factors,
+                    const bool& inverse, complex<double>* scratch) const
+{//decimation in time, recursing on the remaining length, the input is read with a stride that grows with each stage
+    const int64_t p = factors[0], m = factors[1];
+    complex<double>* outEnd = out + p * m;
+    complex<double>* outIter = out;
+    if (m == 1)
+    {
+        for (; outIter != outEnd; ++outIter)
+        {
+            *outIter = *in;
+            in += fstride * inStride;
+        }
+    } else {
+        for (; outIter != outEnd; outIter += m)
+        {
+            work(outIter, in, fstride * p, inStride, factors + 2, inverse, scratch);
+            in += fstride * inStride;
+        }
+    }
+    butterfly(out, fstride, m, p, inverse, scratch);
+}
+
+void CaretFFT::butterfly(complex<double>* out, const int64_t& fstride, const int64_t& m, const int64_t& p, const bool& inverse, complex<double>* scratch) const
+{
+    if (p == 2)
+    {//most common case, do it without the generic loops
+        for (int64_t u = 0; u < m; ++u)
+        {
+            complex<double> twiddle = m_twiddles[u * fstride];
+            if (inverse) twiddle = conj(twiddle);
+            complex<double> temp = out[u + m] * twiddle;
+            out[u + m] = out[u] - temp;
+            out[u] += temp;
+        }
+        return;
+    }
+    for (int64_t u = 0; u < m; ++u)
+    {
+        int64_t k = u;
+        for (int64_t q1 = 0; q1 < p; ++q1)
+        {
+            scratch[q1] = out[k];
+            k += m;
+        }
+        k = u;
+        for (int64_t q1 = 0; q1 < p; ++q1)
+        {
+            int64_t twiddleIndex = 0;
+            complex<double> accum = scratch[0];
+            for (int64_t q = 1; q < p; ++q)
+            {
+                twiddleIndex += fstride * k;
+                if (twiddleIndex >= m_size) twiddleIndex -= m_size;
+                if (inverse)
+                {
+                    accum += scratch[q] * conj(m_twiddles[twiddleIndex]);
+                } else {
+                    accum += scratch[q] * m_twiddles[twiddleIndex];
+                }
+            }
+            out[k] = accum;
+            k += m;
+        }
+    }
+}
+
+CaretFFT3D::CaretFFT3D(const int64_t dims[3])
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        m_dims[i] = dims[i];
+        m_plans.push_back(CaretFFT(dims[i]));
+    }
+}
+
+void CaretFFT3D::transform(complex<double>* data, const bool& inverse) const
+{
+    const int64_t strides[3] = { 1, m_dims[0], m_dims[0] * m_dims[1] };
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        int otherA = (axis == 0 ? 1 : 0), otherB = (axis == 2 ? 1 : 2);//the two axes that aren't being transformed
+        int64_t numLines = m_dims[otherA] * m_dims[otherB];
+        const CaretFFT& myPlan = m_plans[axis];
+#pragma omp CARET_PAR
+        {
+            vector<complex<double> > lineOut(m_dims[axis]);
+#pragma omp CARET_FOR schedule(dynamic, 16)
+            for (int64_t line = 0; line < numLines; ++line)
+            {
+                complex<double>* lineStart = data + (line % m_dims[otherA]) * strides[otherA] + (line / m_dims[otherA]) * strides[otherB];
+                myPlan.transform(lineStart, lineOut.data(), inverse, strides[axis]);
+                for (int64_t i = 0; i < m_dims[axis]; ++i)
+                {
+                    lineStart[i * strides[axis]] = lineOut[i];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef __CARET_FFT_H__
+#define __CARET_FFT_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "stdint.h"
+#include <complex>
+#include <vector>
+
+namespace caret
+{
+    ///mixed radix complex FFT of a fixed size, fastest when the size has only small prime factors (see goodSize)
+    ///the plan is immutable after construction, so one plan can be used from many threads at once
+    class CaretFFT
+    {
+        int64_t m_size, m_maxRadix;
+        std::vector<int64_t> m_factors;//pairs of (radix, remaining length)
+        std::vector<std::complex<double> > m_twiddles;
+        void work(std::complex<double>* out, const std::complex<double>* in, const int64_t& fstride, const int64_t& inStride, const int64_t* factors,
+                  const bool& inverse, std::complex<double>* scratch) const;
+        void butterfly(std::complex<double>* out, const int64_t& fstride, const int64_t& m, const int64_t& p, const bool& inverse, std::complex<double>* scratch) const;
+    public:
+        explicit CaretFFT(const int64_t& size);
+
+        int64_t getSize() const { return m_size; }
+
+        ///unnormalized transform, so inverse(forward(x)) is size * x - input and output must not overlap, input may be strided
+        void transform(const std::complex<double>* input, std::complex<double>* output, const bool& inverse = false, const int64_t& inputStride = 1) const;
+
+        ///smallest size at least minSize that has no prime factors larger than 5
+        static int64_t goodSize(const int64_t& minSize);
+    };
+
+    ///3D transform built from 1D plans, data is indexed with dimension 0 fastest, like volume frames
+    class CaretFFT3D
+    {
+        int64_t m_dims[3];
+        std::vector<CaretFFT> m_plans;
+    public:
+        explicit CaretFFT3D(const int64_t dims[3]);
+
+        const int64_t* getDims() const { return m_dims; }
+
+        ///in place, unnormalized, uses openmp over lines
+        void transform(std::complex<double>* data, const bool& inverse = false) const;
+    };
+}
+
+#endif //__CARET_FFT_H__
@@ -173,11 +173,68 @@ void CaretHttpManager::httpRequest(const CaretHttpRequest &request, CaretHttpRes
 //     */
 //    response.m_headers.clear();
 
+    httpRequestPrivate(request,
+                       response);
+    followRedirect(request, response);
+}
+
+void CaretHttpManager::httpRequests(const vector<CaretHttpRequest>& requests, vector<CaretHttpResponse>& responses)
+{
+    const int numRequests = (int)requests.size();
+    responses.resize(numRequests);
+    if (numRequests == 0) return;
+    QEventLoop myLoop;
+    vector<QNetworkRequest> myRequests(numRequests);
+    vector<QUrl> myUrls(numRequests);
+    vector<CaretPointer<QFile> > postUploadFiles(numRequests);
+    vector<QNetworkReply*> myReplies(numRequests, (QNetworkReply*)NULL);
+    try
+    {
+        for (int i = 0; i < numRequests; ++i)
+        {
+            myReplies[i] = startRequest(requests[i], myRequests[i], myUrls[i], postUploadFiles[i]);
+            QObject::connect(myReplies[i], SIGNAL(finished()), &myLoop, SLOT(quit()));//same reasoning as in httpRequestPrivate
+        }
+    } catch (...) {
+        for (int i = 0; i < numRequests; ++i)
+        {
+            if (myReplies[i] != NULL)
+            {
+                myReplies[i]->abort();
+                delete myReplies[i];
+            }
+        }
+        throw;
+    }
+    while (true)
+    {//finished signals only arrive inside exec(), and any of them stops it, so check them all again each time
+        bool allFinished = true;
+        for (int i = 0; i < numRequests; ++i)
+        {
+            if (!myReplies[i]->isFinished())
+            {
+                allFinished = false;
+                break;
+            }
+        }
+        if (allFinished) break;
+        myLoop.exec();
+    }
+    for (int i = 0; i < numRequests; ++i)
+    {
+        finishRequest(requests[i], myRequests[i], myUrls[i], myReplies[i], responses[i]);
+    }
+    for (int i = 0; i < numRequests; ++i)
+    {//redirects are rare, just follow them one at a time
+        followRedirect(requests[i], responses[i]);
+    }
+}
+
+void CaretHttpManager::followRedirect(const CaretHttpRequest& request, CaretHttpResponse& response)
+{
     /*
      * Code for redirection is from the Qt HTTP example httpwindow.cpp. 
      */
-    httpRequestPrivate(request,
-                       response);
     if (response.m_responseCode == 302) {
         if (response.m_redirectionUrlValid) {
             CaretHttpRequest redirectedRequest = request;
@@ -212,6 +269,22 @@ void CaretHttpManager::httpRequestPrivate(const CaretHttpRequest &request, Caret
 {
     QEventLoop myLoop;
     QNetworkRequest myRequest;
+    QUrl myUrl;
+    CaretPointer<QFile> postUploadFile; // file needs to remain in scope until upload finished
+    QNetworkReply* myReply = startRequest(request, myRequest, myUrl, postUploadFile);
+    //QObject::connect(myReply, SIGNAL(sslErrors(QList<QSslError>)), &myLoop, SLOT(quit()));
+    //QObject::connect(myQNetMgr, SIGNAL(authenticationRequired(QNetworkReply*,QAuthenticator*)), myCaretMgr, SLOT(authenticationCallback(QNetworkReply*,QAuthenticator*)));
+    QObject::connect(myReply, SIGNAL(finished()), &myLoop, SLOT(quit()));//this is safe, because nothing will hand this thread events except queued through this thread's event mechanism
+    /*QObject::connect(myReply,
+        SIGNAL(sslErrors(const QList<QSslError> & )),
+        CaretHttpManager::getHttpManager(),
+        SLOT(handleSslErrors(const QList<QSslError> & )));//*/
+    myLoop.exec();//so, they can only be delivered after myLoop.exec() starts
+    finishRequest(request, myRequest, myUrl, myReply, response);
+}
+
+QNetworkReply* CaretHttpManager::startRequest(const CaretHttpRequest& request, QNetworkRequest& myRequest, QUrl& myUrl, CaretPointer<QFile>& postUploadFile)
+{
     myRequest.setSslConfiguration(QSslConfiguration::defaultConfiguration());
     CaretHttpManager* myCaretMgr = getHttpManager();
     AString myServerString = getServerString(request.m_url);
@@ -235,7 +308,7 @@ void CaretHttpManager::httpRequestPrivate(const CaretHttpRequest &request, Caret
 /*
  * QUrl::addQueryItem() deprecated in Qt5: http://wiki.qt.io/Transition_from_Qt_4.x_to_Qt5
  */
-    QUrl myUrl = QUrl::fromUserInput(request.m_url);
+    myUrl = QUrl::fromUserInput(request.m_url);
 #if QT_VERSION >= 0x050000
     QUrlQuery myUrlQuery(QUrl::fromUserInput(request.m_url));
     for (int32_t i = 0; i < (int32_t)request.m_queries.size(); ++i)
@@ -252,7 +325,6 @@ void CaretHttpManager::httpRequestPrivate(const CaretHttpRequest &request, Caret
     QNetworkAccessManager* myQNetMgr = &(myCaretMgr->m_netMgr);
     bool first = true;
     QByteArray postData;
-    CaretPointer<QFile> postUploadFile; // file needs to remain in scope until upload finished
     switch (request.m_method)
     {
     case POST_ARGUMENTS:
@@ -340,14 +412,15 @@ void CaretHttpManager::httpRequestPrivate(const CaretHttpRequest &request, Caret
         myReply = myQNetMgr->head(myRequest);
         break;
     };
-    //QObject::connect(myReply, SIGNAL(sslErrors(QList<QSslError>)), &myLoop, SLOT(quit()));
-    //QObject::connect(myQNetMgr, SIGNAL(authenticationRequired(QNetworkReply*,QAuthenticator*)), myCaretMgr, SLOT(authenticationCallback(QNetworkReply*,QAuthenticator*)));
-    QObject::connect(myReply, SIGNAL(finished()), &myLoop, SLOT(quit()));//this is safe, because nothing will hand this thread events except queued through this thread's event mechanism
-    /*QObject::connect(myReply,
-        SIGNAL(sslErrors(const QList<QSslError> & )),
-        CaretHttpManager::getHttpManager(),
-        SLOT(handleSslErrors(const QList<QSslError> & )));//*/
-    myLoop.exec();//so, they can only be delivered after myLoop.exec() starts
+    if (myReply == NULL)
+    {
+        throw NetworkException("unable to open file for upload: " + request.m_uploadFileName);
+    }
+    return myReply;
+}
+
+void CaretHttpManager::finishRequest(const CaretHttpRequest& request, const QNetworkRequest& myRequest, const QUrl& myUrl, QNetworkReply* myReply, CaretHttpResponse& response)
+{
     response.m_method = request.m_method;
     response.m_ok = false;
     response.m_redirectionUrlValid = false;
@@ -25,6 +25,7 @@
 #include <vector>
 #include "stdint.h"
 #include "AString.h"
+#include "CaretPointer.h"
 
 namespace caret {
 
@@ -46,6 +47,9 @@ namespace caret {
         std::vector<AuthEntry> m_authList;
         static AString getServerString(const AString& url);        
         static void httpRequestPrivate(const CaretHttpRequest& request, CaretHttpResponse& response);
+        static QNetworkReply* startRequest(const CaretHttpRequest& request, QNetworkRequest& myRequest, QUrl& myUrl, CaretPointer<QFile>& postUploadFile);
+        static void finishRequest(const CaretHttpRequest& request, const QNetworkRequest& myRequest, const QUrl& myUrl, QNetworkReply* myReply, CaretHttpResponse& response);
+        static void followRedirect(const CaretHttpRequest& request, CaretHttpResponse& response);
         
         static void getHeaders(const QNetworkReply& reply,
                                std::map<AString, AString>& headersOut);
@@ -60,6 +64,8 @@ namespace caret {
         static CaretHttpManager* getHttpManager();
         static void deleteHttpManager();
         static void httpRequest(const CaretHttpRequest& request, CaretHttpResponse& response);
+        ///issues all requests before waiting for any, so they are in flight together (over as many connections as the server allows), responses are in request order
+        static void httpRequests(const std::vector<CaretHttpRequest>& requests, std::vector<CaretHttpResponse>& responses);
         static QNetworkAccessManager* getQNetManager();
         static void setAuthentication(const AString& url, const AString& user, const AString& password);
     public slots:
@@ -0,0 +1,338 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretKdTree.h"
+
+#include "CaretAssert.h"
+#include "CaretOMP.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    struct BuildPoint
+    {//coordinates travel with the index during the build, so the partitioning reads memory in order
+        float m_coords[3];
+        int64_t m_index;
+    };
+
+    struct CoordLess
+    {
+        int m_dim;
+        CoordLess(const int& dim) : m_dim(dim) { }
+        bool operator()(const BuildPoint& left, const BuildPoint& right) const { return left.m_coords[m_dim] < right.m_coords[m_dim]; }
+    };
+
+    struct StackEntry
+    {
+        int64_t m_node;
+        float m_dist2;
+    };
+}
+
+CaretKdTree::CaretKdTree(const float* coordsIn, const int64_t& numCoords)
+{
+    m_depth = 0;
+    m_firstLeaf = 0;
+    if (numCoords < 1) return;
+    while (((numCoords - 1) >> m_depth) + 1 > LEAF_SIZE) ++m_depth;//the largest leaf of repeated halving has ceil(numCoords / 2^depth) points
+    CaretAssert(m_depth <= MAX_DEPTH);
+    m_firstLeaf = (((int64_t)1) << m_depth) - 1;
+    m_nodes.resize(2 * m_firstLeaf + 1);
+    vector<BuildPoint> points(numCoords);
+    for (int64_t i = 0; i < numCoords; ++i)
+    {
+        points[i].m_coords[0] = coordsIn[i * 3];
+        points[i].m_coords[1] = coordsIn[i * 3 + 1];
+        points[i].m_coords[2] = coordsIn[i * 3 + 2];
+        points[i].m_index = i;
+    }
+    m_nodes[0].m_start = 0;
+    m_nodes[0].m_end = numCoords;
+    for (int d = 0; d < 3; ++d)
+    {
+        m_nodes[0].m_min[d] = m_nodes[0].m_max[d] = points[0].m_coords[d];
+    }
+    for (int64_t i = 1; i < numCoords; ++i)
+    {
+        for (int d = 0; d < 3; ++d)
+        {
+            m_nodes[0].m_min[d] = min(m_nodes[0].m_min[d], points[i].m_coords[d]);
+            m_nodes[0].m_max[d] = max(m_nodes[0].m_max[d], points[i].m_coords[d]);
+        }
+    }
+    for (int level = 0; level < m_depth; ++level)
+    {//nodes within a level cover disjoint ranges, so they can be split in parallel
+        const int64_t levelStart = (((int64_t)1) << level) - 1, levelEnd = 2 * levelStart + 1;
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int64_t node = levelStart; node < levelEnd; ++node)
+        {//while splitting, node boxes are the parent's box cut at the split, which is enough for picking the widest axis
+            const Node& myNode = m_nodes[node];
+            int splitDim = 0;
+            for (int d = 1; d < 3; ++d)
+            {
+                if (myNode.m_max[d] - myNode.m_min[d] > myNode.m_max[splitDim] - myNode.m_min[splitDim]) splitDim = d;
+            }
+            const int64_t mid = myNode.m_start + (myNode.m_end - myNode.m_start) / 2;//splitting by count rather than value keeps the tree complete, even with duplicate points
+            nth_element(points.begin() + myNode.m_start, points.begin() + mid, points.begin() + myNode.m_end, CoordLess(splitDim));
+            Node& left = m_nodes[2 * node + 1];
+            Node& right = m_nodes[2 * node + 2];
+            left = myNode;
+            right = myNode;
+            left.m_end = mid;
+            left.m_max[splitDim] = points[mid].m_coords[splitDim];
+            right.m_start = mid;
+            right.m_min[splitDim] = points[mid].m_coords[splitDim];
+        }
+    }
+#pragma omp CARET_PARFOR schedule(dynamic, 64)
+    for (int64_t node = m_firstLeaf; node < (int64_t)m_nodes.size(); ++node)
+    {//then shrink the boxes to fit, leaves from their points, parents from their children
+        Node& myNode = m_nodes[node];
+        for (int d = 0; d < 3; ++d)
+        {
+            myNode.m_min[d] = myNode.m_max[d] = points[myNode.m_start].m_coords[d];
+        }
+        for (int64_t i = myNode.m_start + 1; i < myNode.m_end; ++i)
+        {
+            for (int d = 0; d < 3; ++d)
+            {
+                myNode.m_min[d] = min(myNode.m_min[d], points[i].m_coords[d]);
+                myNode.m_max[d] = max(myNode.m_max[d], points[i].m_coords[d]);
+            }
+        }
+    }
+    for (int64_t node = m_firstLeaf - 1; node >= 0; --node)
+    {
+        const Node& left = m_nodes[2 * node + 1];
+        const Node& right = m_nodes[2 * node + 2];
+        for (int d = 0; d < 3; ++d)
+        {
+            m_nodes[node].m_min[d] = min(left.m_min[d], right.m_min[d]);
+            m_nodes[node].m_max[d] = max(left.m_max[d], right.m_max[d]);
+        }
+    }
+    m_x.resize(numCoords);
+    m_y.resize(numCoords);
+    m_z.resize(numCoords);
+    m_index.resize(numCoords);
+    m_treePosition.resize(numCoords);
+    for (int64_t i = 0; i < numCoords; ++i)
+    {
+        m_x[i] = points[i].m_coords[0];
+        m_y[i] = points[i].m_coords[1];
+        m_z[i] = points[i].m_coords[2];
+        m_index[i] = points[i].m_index;
+        m_treePosition[m_index[i]] = i;
+    }
+}
+
+namespace
+{
+    inline float boxDistSquared(const float boxMin[3], const float boxMax[3], const float target[3])
+    {
+        float ret = 0.0f;
+        for (int d = 0; d < 3; ++d)
+        {
+            float outside = max(boxMin[d] - target[d], target[d] - boxMax[d]);
+            if (outside > 0.0f) ret += outside * outside;
+        }
+        return ret;
+    }
+
+    inline float boxFarthestSquared(const float boxMin[3], const float boxMax[3], const float target[3])
+    {
+        float ret = 0.0f;
+        for (int d = 0; d < 3; ++d)
+        {
+            float farthest = max(target[d] - boxMin[d], boxMax[d] - target[d]);
+            ret += farthest * farthest;
+        }
+        return ret;
+    }
+}
+
+void CaretKdTree::getPoint(const int64_t& index, float coordsOut[3]) const
+{
+    CaretAssertVectorIndex(m_treePosition, index);
+    const int64_t position = m_treePosition[index];
+    coordsOut[0] = m_x[position];
+    coordsOut[1] = m_y[position];
+    coordsOut[2] = m_z[position];
+}
+
+int64_t CaretKdTree::closestPosition(const float target[3], float& bestDist2InOut) const
+{
+    if (m_nodes.empty()) return -1;
+    float bestDist2 = bestDist2InOut;
+    int64_t bestPos = -1;
+    StackEntry myStack[MAX_DEPTH + 1];//depth first, at most one deferred sibling per level
+    int stackSize = 0;
+    myStack[0].m_node = 0;
+    myStack[0].m_dist2 = boxDistSquared(m_nodes[0].m_min, m_nodes[0].m_max, target);
+    stackSize = 1;
+    float leafDist2[LEAF_SIZE];
+    while (stackSize > 0)
+    {
+        --stackSize;
+        if (myStack[stackSize].m_dist2 > bestDist2) continue;//not >=, so exact ties can still find a lower index
+        int64_t node = myStack[stackSize].m_node;
+        while (node < m_firstLeaf)
+        {//descend into the nearer child, defer the farther one
+            const Node& left = m_nodes[2 * node + 1];
+            const Node& right = m_nodes[2 * node + 2];
+            float leftDist2 = boxDistSquared(left.m_min, left.m_max, target), rightDist2 = boxDistSquared(right.m_min, right.m_max, target);
+            int64_t nearNode = 2 * node + 1, farNode = 2 * node + 2;
+            if (rightDist2 < leftDist2)
+            {
+                swap(nearNode, farNode);
+                swap(leftDist2, rightDist2);
+            }
+            if (rightDist2 <= bestDist2)
+            {
+                CaretAssert(stackSize <= MAX_DEPTH);
+                myStack[stackSize].m_node = farNode;
+                myStack[stackSize].m_dist2 = rightDist2;
+                ++stackSize;
+            }
+            if (leftDist2 > bestDist2)
+            {
+                node = -1;
+                break;
+            }
+            node = nearNode;
+        }
+        if (node < 0) continue;
+        const int64_t start = m_nodes[node].m_start, count = m_nodes[node].m_end - start;
+        const float* leafX = m_x.data() + start;
+        const float* leafY = m_y.data() + start;
+        const float* leafZ = m_z.data() + start;
+        for (int64_t i = 0; i < count; ++i)
+        {//no dependencies between iterations, so this vectorizes
+            const float dx = leafX[i] - target[0], dy = leafY[i] - target[1], dz = leafZ[i] - target[2];
+            leafDist2[i] = dx * dx + dy * dy + dz * dz;
+        }
+        for (int64_t i = 0; i < count; ++i)
+        {
+            if (leafDist2[i] < bestDist2 || (leafDist2[i] == bestDist2 && (bestPos == -1 || m_index[start + i] < m_index[bestPos])))
+            {
+                bestDist2 = leafDist2[i];
+                bestPos = start + i;
+            }
+        }
+    }
+    bestDist2InOut = bestDist2;
+    return bestPos;
+}
+
+int64_t CaretKdTree::closestPoint(const float target[3], float* distSquaredOut) const
+{
+    float bestDist2 = numeric_limits<float>::infinity();
+    int64_t position = closestPosition(target, bestDist2);
+    if (position < 0) return -1;
+    if (distSquaredOut != NULL) *distSquaredOut = bestDist2;
+    return m_index[position];
+}
+
+int64_t CaretKdTree::closestPointLimited(const float target[3], const float& maxDist, float* distSquaredOut) const
+{
+    float bestDist2 = maxDist * maxDist;
+    int64_t position = closestPosition(target, bestDist2);
+    if (position < 0) return -1;
+    if (distSquaredOut != NULL) *distSquaredOut = bestDist2;
+    return m_index[position];
+}
+
+void CaretKdTree::pointsInRange(const float target[3], const float& maxDist, vector<int64_t>& indicesOut) const
+{
+    if (m_nodes.empty()) return;
+    const float maxDist2 = maxDist * maxDist;
+    int64_t myStack[MAX_DEPTH + 2];//both children are pushed, the deferred one per level plus the current pair
+    int stackSize = 1;
+    myStack[0] = 0;
+    while (stackSize > 0)
+    {
+        const int64_t node = myStack[--stackSize];
+        const Node& myNode = m_nodes[node];
+        if (boxDistSquared(myNode.m_min, myNode.m_max, target) > maxDist2) continue;
+        if (boxFarthestSquared(myNode.m_min, myNode.m_max, target) <= maxDist2)
+        {//entirely inside
+            indicesOut.insert(indicesOut.end(), m_index.begin() + myNode.m_start, m_index.begin() + myNode.m_end);
+            continue;
+        }
+        if (node < m_firstLeaf)
+        {
+            CaretAssert(stackSize + 2 <= MAX_DEPTH + 2);
+            myStack[stackSize++] = 2 * node + 2;
+            myStack[stackSize++] = 2 * node + 1;
+            continue;
+        }
+        for (int64_t i = myNode.m_start; i < myNode.m_end; ++i)
+        {
+            const float dx = m_x[i] - target[0], dy = m_y[i] - target[1], dz = m_z[i] - target[2];
+            if (dx * dx + dy * dy + dz * dz <= maxDist2) indicesOut.push_back(m_index[i]);
+        }
+    }
+}
+
+bool CaretKdTree::anyInRange(const float target[3], const float& maxDist) const
+{
+    if (m_nodes.empty()) return false;
+    const float maxDist2 = maxDist * maxDist;
+    int64_t myStack[MAX_DEPTH + 2];
+    int stackSize = 1;
+    myStack[0] = 0;
+    while (stackSize > 0)
+    {
+        const int64_t node = myStack[--stackSize];
+        const Node& myNode = m_nodes[node];
+        if (boxDistSquared(myNode.m_min, myNode.m_max, target) >= maxDist2) continue;
+        if (node < m_firstLeaf)
+        {
+            myStack[stackSize++] = 2 * node + 2;
+            myStack[stackSize++] = 2 * node + 1;
+            continue;
+        }
+        for (int64_t i = myNode.m_start; i < myNode.m_end; ++i)
+        {
+            const float dx = m_x[i] - target[0], dy = m_y[i] - target[1], dz = m_z[i] - target[2];
+            if (dx * dx + dy * dy + dz * dz < maxDist2) return true;
+        }
+    }
+    return false;
+}
+
+void CaretKdTree::closestPoints(const float* targets, const int64_t& numTargets, int64_t* indicesOut, const float& maxDist) const
+{
+#pragma omp CARET_PARFOR schedule(dynamic, 256)
+    for (int64_t i = 0; i < numTargets; ++i)
+    {
+        if (maxDist < 0.0f)
+        {
+            indicesOut[i] = closestPoint(targets + i * 3);
+        } else {
+            indicesOut[i] = closestPointLimited(targets + i * 3, maxDist);
+        }
+    }
+}
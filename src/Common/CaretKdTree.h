@@ -0,0 +1,75 @@
+#ifndef __CARET_KD_TREE_H__
+#define __CARET_KD_TREE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "stdint.h"
+#include <cstddef>
+#include <vector>
+
+namespace caret
+{
+
+    ///static 3D point tree in flat arrays: an implicit binary tree of bounding boxes over points sorted into tree order
+    ///built by median splits on the widest axis, leaves hold at most LEAF_SIZE points stored as separate x, y, z arrays so distance loops vectorize
+    ///all queries are const, thread safe, and don't allocate (except to grow the caller's output vector)
+    class CaretKdTree
+    {
+        struct Node
+        {
+            float m_min[3], m_max[3];
+            int64_t m_start, m_end;//range of points in tree order
+        };
+        std::vector<Node> m_nodes;//children of node i are 2i + 1 and 2i + 2, every leaf is on the last level
+        std::vector<float> m_x, m_y, m_z;//coordinates in tree order
+        std::vector<int64_t> m_index;//original index of each point in tree order
+        std::vector<int64_t> m_treePosition;//inverse of m_index
+        int m_depth;
+        int64_t m_firstLeaf;
+        static const int LEAF_SIZE = 16;
+        static const int MAX_DEPTH = 48;//query stacks are fixed size arrays
+        int64_t closestPosition(const float target[3], float& bestDist2InOut) const;
+    public:
+        ///coordinates are xyz triples, the point indices are their position in this array
+        CaretKdTree(const float* coordsIn, const int64_t& numCoords);
+
+        int64_t getNumberOfPoints() const { return (int64_t)m_index.size(); }
+        void getPoint(const int64_t& index, float coordsOut[3]) const;
+
+        ///returns -1 only if there are no points, on exact ties the lower index wins
+        int64_t closestPoint(const float target[3], float* distSquaredOut = NULL) const;
+
+        ///returns -1 if no point is within maxDist (inclusive)
+        int64_t closestPointLimited(const float target[3], const float& maxDist, float* distSquaredOut = NULL) const;
+
+        ///appends the indices of all points within maxDist (inclusive) in no particular order, clear it first if needed
+        void pointsInRange(const float target[3], const float& maxDist, std::vector<int64_t>& indicesOut) const;
+
+        ///whether any point is closer than maxDist (exclusive)
+        bool anyInRange(const float target[3], const float& maxDist) const;
+
+        ///closest point to each of numTargets xyz triples in parallel, maxDist < 0 means unlimited, otherwise -1 where no point is within it
+        void closestPoints(const float* targets, const int64_t& numTargets, int64_t* indicesOut, const float& maxDist = -1.0f) const;
+    };
+
+}
+
+#endif //__CARET_KD_TREE_H__
@@ -22,7 +22,9 @@
 #include "CaretException.h"
 #include "CaretLogger.h"
 #include "CaretMathExpression.h"
+#include "CaretOMP.h"
 
+#include <algorithm>
 #include <cmath>
 
 using namespace caret;
@@ -39,6 +41,7 @@ CaretMathExpression::CaretMathExpression(const AString& expression)
         throw CaretException("extra characters on end of expression input: '" + m_input.mid(m_position) + "'");
     }
     CaretLogFiner("parsed '" + expression + "' as '" + toString() + "'");
+    compile();
 }
 
 double CaretMathExpression::evaluate(const vector<float>& variableValues) const
@@ -392,6 +395,362 @@ double CaretMathExpression::MathNode::eval(const vector<float>& values) const
     return ret;
 }
 
+bool CaretMathExpression::MathNode::hasVariables() const
+{
+    if (m_type == VAR) return true;
+    for (int i = 0; i < (int)m_arguments.size(); ++i)
+    {
+        if (m_arguments[i]->hasVariables()) return true;
+    }
+    return false;
+}
+
+namespace
+{
+    const int64_t EVAL_BLOCK_SIZE = 512;//elements per register, small enough that all registers of typical expressions stay in cache
+    
+    //these must be kept identical to the expressions used in MathNode::eval
+    double opSin(double x) { return sin(x); }
+    double opCos(double x) { return cos(x); }
+    double opTan(double x) { return tan(x); }
+    double opAsin(double x) { return asin(x); }
+    double opAcos(double x) { return acos(x); }
+    double opAtan(double x) { return atan(x); }
+    double opSinh(double x) { return sinh(x); }
+    double opCosh(double x) { return cosh(x); }
+    double opTanh(double x) { return tanh(x); }
+    double opAsinh(double x)
+    {
+        if (x > 0)
+        {
+            return log(x + sqrt(x * x + 1));
+        } else {
+            return -log(-x + sqrt(x * x + 1));
+        }
+    }
+    double opAcosh(double x) { return log(x + sqrt(x * x - 1)); }
+    double opAtanh(double x) { return 0.5 * log((1 + x) / (1 - x)); }
+    double opLn(double x) { return log(x); }
+    double opExp(double x) { return exp(x); }
+    double opLog(double x) { return log10(x); }
+    double opSqrt(double x) { return sqrt(x); }
+    double opAbs(double x) { return abs(x); }
+    double opFloor(double x) { return floor(x); }
+    double opRound(double x)
+    {
+        if (x > 0.0)
+        {
+            return floor(x + 0.5);
+        } else {
+            return ceil(x - 0.5);
+        }
+    }
+    double opCeil(double x) { return ceil(x); }
+    
+    template<double (*FUNC)(double)>
+    void unaryLoop(double* out, const double* in, const int64_t& count)
+    {
+        for (int64_t i = 0; i < count; ++i)
+        {
+            out[i] = FUNC(in[i]);
+        }
+    }
+}
+
+void CaretMathExpression::compile()
+{
+    m_program.clear();
+    m_constValues.clear();
+    m_numTempRegisters = 0;
+    int result = compileNode(m_root, 0);
+    for (int i = 0; i < (int)m_program.size(); ++i)
+    {//now that we know how many temporaries there are, put the constants after them
+        for (int j = 0; j < 3; ++j)
+        {
+            if (m_program[i].m_op != Instruction::LOAD_VAR && m_program[i].m_src[j] < -1)//-1 means unused
+            {
+                m_program[i].m_src[j] = m_numTempRegisters - 2 - m_program[i].m_src[j];
+            }
+        }
+    }
+    if (result < 0)
+    {
+        m_resultRegister = m_numTempRegisters - 2 - result;
+    } else {
+        m_resultRegister = result;
+    }
+}
+
+int CaretMathExpression::compileNode(const MathNode* node, const int& dest)
+{
+    if (!node->hasVariables())
+    {//can't depend on the element, so evaluate it once with the same code as evaluate() uses
+        m_constValues.push_back(node->eval(vector<float>()));
+        return -1 - (int)m_constValues.size();//first constant is -2, so that -1 can mean an unused argument
+    }
+    if (dest >= m_numTempRegisters) m_numTempRegisters = dest + 1;
+    int numArgs = (int)node->m_arguments.size();
+    switch (node->m_type)
+    {
+        case MathNode::VAR:
+            m_program.push_back(Instruction(Instruction::LOAD_VAR, dest, node->m_varIndex));
+            return dest;
+        case MathNode::NOT:
+        case MathNode::NEGATE:
+        {
+            CaretAssert(numArgs == 1);
+            int arg = compileNode(node->m_arguments[0], dest);
+            m_program.push_back(Instruction(node->m_type == MathNode::NOT ? Instruction::NOT : Instruction::NEGATE, dest, arg));
+            return dest;
+        }
+        case MathNode::POW:
+        {
+            CaretAssert(numArgs == 2);
+            int first = compileNode(node->m_arguments[0], dest);
+            int second = compileNode(node->m_arguments[1], dest + 1);
+            m_program.push_back(Instruction(Instruction::POW, dest, first, second));
+            return dest;
+        }
+        case MathNode::FUNC:
+        {
+            CaretAssert(numArgs >= 1 && numArgs <= 3);
+            Instruction temp(Instruction::FUNC, dest);
+            temp.m_function = node->m_function;
+            for (int i = 0; i < numArgs; ++i)
+            {
+                temp.m_src[i] = compileNode(node->m_arguments[i], dest + i);
+            }
+            m_program.push_back(temp);
+            return dest;
+        }
+        case MathNode::OR:
+        case MathNode::AND:
+        case MathNode::EQUAL:
+        case MathNode::GREATERLESS:
+        case MathNode::ADDSUB:
+        case MathNode::MULTDIV:
+        {//left to right chains, accumulate into dest
+            CaretAssert(numArgs > 1);
+            int accum = compileNode(node->m_arguments[0], dest);
+            for (int i = 1; i < numArgs; ++i)
+            {
+                int arg = compileNode(node->m_arguments[i], dest + 1);
+                Instruction::OpCode op = Instruction::ADD;
+                switch (node->m_type)
+                {
+                    case MathNode::OR:
+                        op = Instruction::OR;
+                        break;
+                    case MathNode::AND:
+                        op = Instruction::AND;
+                        break;
+                    case MathNode::EQUAL:
+                        op = node->m_invert[i] ? Instruction::NOT_EQUAL : Instruction::EQUAL;
+                        break;
+                    case MathNode::GREATERLESS:
+                        if (node->m_inclusive[i])
+                        {
+                            op = node->m_invert[i] ? Instruction::LESS_EQUAL : Instruction::GREATER_EQUAL;
+                        } else {
+                            op = node->m_invert[i] ? Instruction::LESS : Instruction::GREATER;
+                        }
+                        break;
+                    case MathNode::ADDSUB:
+                        op = node->m_invert[i] ? Instruction::SUB : Instruction::ADD;
+                        break;
+                    case MathNode::MULTDIV:
+                        op = node->m_invert[i] ? Instruction::DIV : Instruction::MULT;
+                        break;
+                    default:
+                        CaretAssert(0);
+                }
+                m_program.push_back(Instruction(op, dest, accum, arg));
+                accum = dest;
+            }
+            return dest;
+        }
+        case MathNode::CONST://handled by the constant check above
+        case MathNode::INVALID:
+            break;
+    }
+    CaretAssertMessage(0, "unhandled MathNode type in compile");
+    throw CaretException("parsing problem in CaretMathExpression");
+}
+
+void CaretMathExpression::evaluateMultiple(const vector<const float*>& variableArrays, const int64_t& count, float* resultsOut) const
+{
+    CaretAssert(variableArrays.size() == m_varNames.size());
+    int64_t numBlocks = (count + EVAL_BLOCK_SIZE - 1) / EVAL_BLOCK_SIZE;
+    int numConsts = (int)m_constValues.size();
+#pragma omp CARET_PAR if (numBlocks > 1)
+    {
+        vector<double> registers((m_numTempRegisters + numConsts) * EVAL_BLOCK_SIZE);//each thread gets its own register file
+        for (int c = 0; c < numConsts; ++c)
+        {
+            double* constReg = registers.data() + (m_numTempRegisters + c) * EVAL_BLOCK_SIZE;
+            for (int64_t i = 0; i < EVAL_BLOCK_SIZE; ++i)
+            {
+                constReg[i] = m_constValues[c];
+            }
+        }
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t block = 0; block < numBlocks; ++block)
+        {
+            int64_t start = block * EVAL_BLOCK_SIZE;
+            runProgram(variableArrays, start, min(EVAL_BLOCK_SIZE, count - start), registers.data(), resultsOut);
+        }
+    }
+}
+
+void CaretMathExpression::runProgram(const vector<const float*>& variableArrays, const int64_t& start, const int64_t& count, double* registers, float* resultsOut) const
+{
+    int numInstructions = (int)m_program.size();
+    for (int inst = 0; inst < numInstructions; ++inst)
+    {
+        const Instruction& thisInst = m_program[inst];
+        double* out = registers + thisInst.m_dest * EVAL_BLOCK_SIZE;
+        if (thisInst.m_op == Instruction::LOAD_VAR)
+        {
+            const float* in = variableArrays[thisInst.m_src[0]] + start;
+            for (int64_t i = 0; i < count; ++i)
+            {
+                out[i] = in[i];
+            }
+            continue;
+        }
+        const double* a = registers + thisInst.m_src[0] * EVAL_BLOCK_SIZE;
+        const double* b = (thisInst.m_src[1] < 0 ? NULL : registers + thisInst.m_src[1] * EVAL_BLOCK_SIZE);
+        const double* c = (thisInst.m_src[2] < 0 ? NULL : registers + thisInst.m_src[2] * EVAL_BLOCK_SIZE);
+        switch (thisInst.m_op)
+        {
+            case Instruction::LOAD_VAR:
+                break;
+            case Instruction::OR:
+                for (int64_t i = 0; i < count; ++i) out[i] = (a[i] > 0.0 || b[i] > 0.0) ? 1.0 : 0.0;
+                break;
+            case Instruction::AND:
+                for (int64_t i = 0; i < count; ++i) out[i] = (a[i] > 0.0 && b[i] > 0.0) ? 1.0 : 0.0;
+                break;
+            case Instruction::EQUAL:
+            case Instruction::NOT_EQUAL:
+            {
+                double equalVal = (thisInst.m_op == Instruction::EQUAL ? 1.0 : 0.0);
+                for (int64_t i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(a[i]), abs(b[i])) / 1000000;//same fudge factor as in eval
+                    bool equal = (a[i] >= b[i] - adjust) && (a[i] <= b[i] + adjust);
+                    out[i] = equal ? equalVal : 1.0 - equalVal;
+                }
+                break;
+            }
+            case Instruction::GREATER:
+                for (int64_t i = 0; i < count; ++i) out[i] = (a[i] > b[i] ? 1.0 : 0.0);
+                break;
+            case Instruction::LESS:
+                for (int64_t i = 0; i < count; ++i) out[i] = (a[i] < b[i] ? 1.0 : 0.0);
+                break;
+            case Instruction::GREATER_EQUAL:
+                for (int64_t i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(a[i]), abs(b[i])) / 1000000;
+                    out[i] = (a[i] >= b[i] - adjust ? 1.0 : 0.0);
+                }
+                break;
+            case Instruction::LESS_EQUAL:
+                for (int64_t i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(a[i]), abs(b[i])) / 1000000;
+                    out[i] = (a[i] <= b[i] + adjust ? 1.0 : 0.0);
+                }
+                break;
+            case Instruction::ADD:
+                for (int64_t i = 0; i < count; ++i) out[i] = a[i] + b[i];
+                break;
+            case Instruction::SUB:
+                for (int64_t i = 0; i < count; ++i) out[i] = a[i] - b[i];
+                break;
+            case Instruction::MULT:
+                for (int64_t i = 0; i < count; ++i) out[i] = a[i] * b[i];
+                break;
+            case Instruction::DIV:
+                for (int64_t i = 0; i < count; ++i) out[i] = a[i] / b[i];
+                break;
+            case Instruction::NOT:
+                for (int64_t i = 0; i < count; ++i) out[i] = (a[i] > 0.0) ? 0.0 : 1.0;
+                break;
+            case Instruction::NEGATE:
+                for (int64_t i = 0; i < count; ++i) out[i] = -a[i];
+                break;
+            case Instruction::POW:
+                for (int64_t i = 0; i < count; ++i) out[i] = pow(a[i], b[i]);
+                break;
+            case Instruction::FUNC:
+                switch (thisInst.m_function)
+                {
+                    case MathFunctionEnum::SIN: unaryLoop<opSin>(out, a, count); break;
+                    case MathFunctionEnum::COS: unaryLoop<opCos>(out, a, count); break;
+                    case MathFunctionEnum::TAN: unaryLoop<opTan>(out, a, count); break;
+                    case MathFunctionEnum::ASIN: unaryLoop<opAsin>(out, a, count); break;
+                    case MathFunctionEnum::ACOS: unaryLoop<opAcos>(out, a, count); break;
+                    case MathFunctionEnum::ATAN: unaryLoop<opAtan>(out, a, count); break;
+                    case MathFunctionEnum::SINH: unaryLoop<opSinh>(out, a, count); break;
+                    case MathFunctionEnum::COSH: unaryLoop<opCosh>(out, a, count); break;
+                    case MathFunctionEnum::TANH: unaryLoop<opTanh>(out, a, count); break;
+                    case MathFunctionEnum::ASINH: unaryLoop<opAsinh>(out, a, count); break;
+                    case MathFunctionEnum::ACOSH: unaryLoop<opAcosh>(out, a, count); break;
+                    case MathFunctionEnum::ATANH: unaryLoop<opAtanh>(out, a, count); break;
+                    case MathFunctionEnum::LN: unaryLoop<opLn>(out, a, count); break;
+                    case MathFunctionEnum::EXP: unaryLoop<opExp>(out, a, count); break;
+                    case MathFunctionEnum::LOG: unaryLoop<opLog>(out, a, count); break;
+                    case MathFunctionEnum::SQRT: unaryLoop<opSqrt>(out, a, count); break;
+                    case MathFunctionEnum::ABS: unaryLoop<opAbs>(out, a, count); break;
+                    case MathFunctionEnum::FLOOR: unaryLoop<opFloor>(out, a, count); break;
+                    case MathFunctionEnum::ROUND: unaryLoop<opRound>(out, a, count); break;
+                    case MathFunctionEnum::CEIL: unaryLoop<opCeil>(out, a, count); break;
+                    case MathFunctionEnum::ATAN2:
+                        for (int64_t i = 0; i < count; ++i) out[i] = atan2(a[i], b[i]);
+                        break;
+                    case MathFunctionEnum::MIN:
+                        for (int64_t i = 0; i < count; ++i) out[i] = (a[i] > b[i] ? b[i] : a[i]);//same NaN behavior as eval
+                        break;
+                    case MathFunctionEnum::MAX:
+                        for (int64_t i = 0; i < count; ++i) out[i] = (a[i] < b[i] ? b[i] : a[i]);
+                        break;
+                    case MathFunctionEnum::MOD:
+                        for (int64_t i = 0; i < count; ++i)
+                        {
+                            if (b[i] == 0.0)
+                            {
+                                out[i] = 0.0;
+                            } else {
+                                out[i] = a[i] - b[i] * floor(a[i] / b[i]);
+                            }
+                        }
+                        break;
+                    case MathFunctionEnum::CLAMP:
+                        for (int64_t i = 0; i < count; ++i)
+                        {
+                            double temp = a[i];
+                            if (temp < b[i]) temp = b[i];
+                            if (temp > c[i]) temp = c[i];
+                            out[i] = temp;
+                        }
+                        break;
+                    case MathFunctionEnum::INVALID:
+                        CaretAssertMessage(0, "Instruction is type FUNC but INVALID function");
+                        throw CaretException("parsing problem in CaretMathExpression");
+                }
+                break;
+        }
+    }
+    const double* result = registers + m_resultRegister * EVAL_BLOCK_SIZE;
+    float* outPtr = resultsOut + start;
+    for (int64_t i = 0; i < count; ++i)
+    {
+        outPtr[i] = (float)result[i];
+    }
+}
+
 AString CaretMathExpression::MathNode::toString(const std::vector<AString>& varNames) const
 {
     AString ret = "";
@@ -19,55 +19,22 @@
 /*LICENSE_END*/
 
 #include "CaretPointLocator.h"
-#include "CaretHeap.h"
-#include <cmath>
+
+#include "CaretAssert.h"
+#include "CaretOMP.h"
 
 using namespace caret;
 using namespace std;
 
-void CaretPointLocator::addPoint(Oct<LeafVector<Point> >* thisOct, const float point[3], const int64_t index, const int32_t pointSet)
+CaretPointLocator::CaretPointLocator(const float* coordsIn, const int64_t numCoords)
 {
-    if (thisOct->m_leaf)
-    {
-        thisOct->m_data.m_vector->push_back(Point(point, index, pointSet));
-        int curSize = (int)thisOct->m_data.m_vector->size();
-        if (curSize > NUM_POINTS_SPLIT)
-        {//test that not all points are the same, or that they have some minimum percentage spread, or...
-            vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
-            Vector3D minBox = myVecRef[0].m_point, maxBox = myVecRef[0].m_point, tempvec;
-            tempvec[0] = thisOct->m_bounds[0][2] - thisOct->m_bounds[0][0];
-            tempvec[1] = thisOct->m_bounds[1][2] - thisOct->m_bounds[1][0];
-            tempvec[2] = thisOct->m_bounds[2][2] - thisOct->m_bounds[2][0];
-            float diagonal = tempvec.length();
-            bool safeToSplit = false;
-            for (int i = 1; i < curSize; ++i)
-            {//this will slow down if lots of stuff is continuously put in an Oct that is far too big - use random sampling?
-                if (myVecRef[i].m_point[0] < minBox[0]) minBox[0] = myVecRef[i].m_point[0];
-                if (myVecRef[i].m_point[1] < minBox[1]) minBox[1] = myVecRef[i].m_point[1];
-                if (myVecRef[i].m_point[2] < minBox[2]) minBox[2] = myVecRef[i].m_point[2];
-                if (myVecRef[i].m_point[0] > maxBox[0]) maxBox[0] = myVecRef[i].m_point[0];
-                if (myVecRef[i].m_point[1] > maxBox[1]) maxBox[1] = myVecRef[i].m_point[1];
-                if (myVecRef[i].m_point[2] > maxBox[2]) maxBox[2] = myVecRef[i].m_point[2];
-                tempvec = minBox - maxBox;
-                if (tempvec.length() > 0.01f * diagonal)//make sure points aren't all identical, would go to infinity recursively
-                {
-                    safeToSplit = true;
-                    break;
-                }
-            }
-            if (safeToSplit)
-            {
-                thisOct->makeChildren();
-                for (int i = 0; i < curSize; ++i)
-                {
-                    addPoint(thisOct->containingChild(myVecRef[i].m_point), myVecRef[i].m_point, myVecRef[i].m_index, myVecRef[i].m_mySet);
-                }
-                thisOct->m_data.freeData();
-            }
-        }
-    } else {
-        addPoint(thisOct->containingChild(point), point, index, pointSet);
-    }
+    m_nextSetIndex = 0;
+    addPointSet(coordsIn, numCoords);//this is set #0
+}
+
+CaretPointLocator::CaretPointLocator(const float[3], const float[3])
+{
+    m_nextSetIndex = 0;
 }
 
 int32_t CaretPointLocator::addPointSet(const float* coordsIn, const int64_t numCoords)
@@ -75,278 +42,133 @@ int32_t CaretPointLocator::addPointSet(const float* coordsIn, const int64_t numC
     CaretMutexLocker locked(&m_modifyMutex);
     int32_t setNum = newIndex();
     if (numCoords < 1) return setNum;
-    if (m_tree == NULL)
-    {
-        Vector3D minBox, maxBox;
-        minBox = maxBox = coordsIn;//hack - first triple
-        for (int64_t i = 1; i < numCoords; ++i)
-        {
-            int64_t i3 = i * 3;
-            if (coordsIn[i3] < minBox[0]) minBox[0] = coordsIn[i3];
-            if (coordsIn[i3 + 1] < minBox[1]) minBox[1] = coordsIn[i3 + 1];
-            if (coordsIn[i3 + 2] < minBox[2]) minBox[2] = coordsIn[i3 + 2];
-            if (coordsIn[i3] > maxBox[0]) maxBox[0] = coordsIn[i3];
-            if (coordsIn[i3 + 1] > maxBox[1]) maxBox[1] = coordsIn[i3 + 1];
-            if (coordsIn[i3 + 2] > maxBox[2]) maxBox[2] = coordsIn[i3 + 2];
-        }
-        m_tree = new Oct<LeafVector<Point> >(minBox, maxBox);
-    }
-    for (int64_t i = 0; i < numCoords; ++i)
-    {
-        int64_t i3 = i * 3;
-        m_tree = m_tree->makeContains(coordsIn + i3);//make new root if needed
-        addPoint(m_tree, coordsIn + i3, i, setNum);//and add the point
-    }
+    PointSet mySet;
+    mySet.m_tree.grabNew(new CaretKdTree(coordsIn, numCoords));
+    mySet.m_setIndex = setNum;
+    m_sets.push_back(mySet);
     return setNum;
 }
 
-CaretPointLocator::CaretPointLocator(const float* coordsIn, const int64_t numCoords)
+int64_t CaretPointLocator::closestPoint(const float target[3], LocatorInfo* infoOut) const
 {
-    m_nextSetIndex = 1;//next set will be set #1
-    m_tree = NULL;
-    if (numCoords >= 1)
+    float bestDist2 = -1.0f;
+    int64_t bestIndex = -1;
+    int32_t bestSet = -1, bestWhich = -1;
+    for (int32_t i = 0; i < (int32_t)m_sets.size(); ++i)
     {
-        Vector3D minBox, maxBox;
-        minBox = maxBox = coordsIn;//hack - first triple
-        for (int64_t i = 1; i < numCoords; ++i)
+        float tempf;
+        int64_t tempIndex = m_sets[i].m_tree->closestPoint(target, &tempf);
+        if (tempIndex != -1 && (bestIndex == -1 || tempf < bestDist2))
         {
-            int64_t i3 = i * 3;
-            if (coordsIn[i3] < minBox[0]) minBox[0] = coordsIn[i3];
-            if (coordsIn[i3 + 1] < minBox[1]) minBox[1] = coordsIn[i3 + 1];
-            if (coordsIn[i3 + 2] < minBox[2]) minBox[2] = coordsIn[i3 + 2];
-            if (coordsIn[i3] > maxBox[0]) maxBox[0] = coordsIn[i3];
-            if (coordsIn[i3 + 1] > maxBox[1]) maxBox[1] = coordsIn[i3 + 1];
-            if (coordsIn[i3 + 2] > maxBox[2]) maxBox[2] = coordsIn[i3 + 2];
+            bestDist2 = tempf;
+            bestIndex = tempIndex;
+            bestSet = m_sets[i].m_setIndex;
+            bestWhich = i;
         }
-        m_tree = new Oct<LeafVector<Point> >(minBox, maxBox);
-        for (int64_t i = 0; i < numCoords; ++i)
+    }
+    if (infoOut != NULL)
+    {
+        infoOut->whichSet = bestSet;
+        infoOut->index = bestIndex;
+        if (bestIndex != -1)
         {
-            int64_t i3 = i * 3;
-            addPoint(m_tree, coordsIn + i3, i, 0);//this is set #0
+            float coords[3];
+            m_sets[bestWhich].m_tree->getPoint(bestIndex, coords);
+            infoOut->coords = coords;
         }
     }
+    return bestIndex;
 }
 
-CaretPointLocator::CaretPointLocator(const float minBounds[3], const float maxBounds[3])
-{
-    m_nextSetIndex = 0;
-    m_tree = new Oct<LeafVector<Point> >(minBounds, maxBounds);
-}
-
-int64_t CaretPointLocator::closestPoint(const float target[3], LocatorInfo* infoOut) const
+int64_t CaretPointLocator::closestPointLimited(const float target[3], const float& maxDist, LocatorInfo* infoOut) const
 {
-    if (m_tree == NULL) return -1;
-    CaretSimpleMinHeap<Oct<LeafVector<Point> >*, float> myHeap;
-    bool first = true;
-    float bestDist2 = -1.0f, bestDist = -1.0f, tempf, curDist = m_tree->distToPoint(target);
-    Vector3D bestPoint;
+    float bestDist2 = -1.0f;
     int64_t bestIndex = -1;
-    int32_t bestSet = -1;
-    myHeap.push(m_tree, curDist);
-    while (curDist < bestDist || first)
+    int32_t bestSet = -1, bestWhich = -1;
+    for (int32_t i = 0; i < (int32_t)m_sets.size(); ++i)
     {
-        Oct<LeafVector<Point> >* thisOct = myHeap.pop();
-        if (thisOct->m_leaf)
-        {
-            vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
-            int curSize = (int)myVecRef.size();
-            for (int i = 0; i < curSize; ++i)
-            {
-                tempf = MathFunctions::distanceSquared3D(myVecRef[i].m_point, target);
-                if (tempf < bestDist2 || first)
-                {
-                    first = false;
-                    bestDist2 = tempf;
-                    bestPoint = myVecRef[i].m_point;
-                    bestSet = myVecRef[i].m_mySet;
-                    bestIndex = myVecRef[i].m_index;
-                }
-            }
-            bestDist = sqrt(bestDist2);
-        } else {
-            for (int ii = 0; ii < 2; ++ii)
-            {
-                for (int ij = 0; ij < 2; ++ij)
-                {
-                    for (int ik = 0; ik < 2; ++ik)
-                    {
-                        tempf = thisOct->m_children[ii][ij][ik]->distToPoint(target);
-                        if (tempf < bestDist || first)
-                        {
-                            myHeap.push(thisOct->m_children[ii][ij][ik], tempf);
-                        }
-                    }
-                }
-            }
-        }
-        if (myHeap.isEmpty())
+        float tempf;
+        int64_t tempIndex = m_sets[i].m_tree->closestPointLimited(target, maxDist, &tempf);
+        if (tempIndex != -1 && (bestIndex == -1 || tempf < bestDist2))
         {
-            break;//allows us to use top() without violating an assertion
+            bestDist2 = tempf;
+            bestIndex = tempIndex;
+            bestSet = m_sets[i].m_setIndex;
+            bestWhich = i;
         }
-        myHeap.top(&curDist);//get the key for the next item
     }
     if (infoOut != NULL)
     {
         infoOut->whichSet = bestSet;
-        infoOut->coords = bestPoint;
         infoOut->index = bestIndex;
+        if (bestIndex != -1)
+        {
+            float coords[3];
+            m_sets[bestWhich].m_tree->getPoint(bestIndex, coords);
+            infoOut->coords = coords;
+        }
     }
     return bestIndex;
 }
 
-int64_t CaretPointLocator::closestPointLimited(const float target[3], const float& maxDist, LocatorInfo* infoOut) const
+void CaretPointLocator::closestPoints(const float* targets, const int64_t& numTargets, int64_t* indicesOut, const float& maxDist, int32_t* whichSetOut) const
 {
-    if (m_tree == NULL) return -1;
-    float curDist2 = m_tree->distSquaredToPoint(target), maxDist2 = maxDist * maxDist;
-    if (curDist2 > maxDist2)
+    if (m_sets.size() == 1 && whichSetOut == NULL)
     {
-        if (infoOut != NULL)
-        {
-            infoOut->whichSet = -1;
-            infoOut->index = -1;
-        }
-        return -1;
+        m_sets[0].m_tree->closestPoints(targets, numTargets, indicesOut, maxDist);
+        return;
     }
-    CaretSimpleMinHeap<Oct<LeafVector<Point> >*, float> myHeap;
-    bool first = true;
-    float bestDist2 = -1.0f, tempf;
-    Vector3D bestPoint;
-    int64_t bestIndex = -1;
-    int32_t bestSet = -1;
-    myHeap.push(m_tree, curDist2);
-    while (curDist2 < bestDist2 || first)
+#pragma omp CARET_PARFOR schedule(dynamic, 256)
+    for (int64_t i = 0; i < numTargets; ++i)
     {
-        Oct<LeafVector<Point> >* thisOct = myHeap.pop();
-        if (thisOct->m_leaf)
+        LocatorInfo myInfo(-1, -1, Vector3D());
+        if (maxDist < 0.0f)
         {
-            vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
-            int curSize = (int)myVecRef.size();
-            for (int i = 0; i < curSize; ++i)
-            {
-                tempf = MathFunctions::distanceSquared3D(myVecRef[i].m_point, target);
-                if (tempf < bestDist2 || (first && tempf <= maxDist2))
-                {
-                    first = false;
-                    bestDist2 = tempf;
-                    bestPoint = myVecRef[i].m_point;
-                    bestSet = myVecRef[i].m_mySet;
-                    bestIndex = myVecRef[i].m_index;
-                }
-            }
+            indicesOut[i] = closestPoint(targets + i * 3, &myInfo);
         } else {
-            for (int ii = 0; ii < 2; ++ii)
-            {
-                for (int ij = 0; ij < 2; ++ij)
-                {
-                    for (int ik = 0; ik < 2; ++ik)
-                    {
-                        tempf = thisOct->m_children[ii][ij][ik]->distSquaredToPoint(target);
-                        if (tempf < bestDist2 || (first && tempf <= maxDist2))
-                        {
-                            myHeap.push(thisOct->m_children[ii][ij][ik], tempf);
-                        }
-                    }
-                }
-            }
+            indicesOut[i] = closestPointLimited(targets + i * 3, maxDist, &myInfo);
         }
-        if (myHeap.isEmpty())
-        {
-            break;//allows us to use top() without violating an assertion
-        }
-        myHeap.top(&curDist2);//get the key for the next item
-    }
-    if (infoOut != NULL)
-    {
-        infoOut->whichSet = bestSet;
-        infoOut->coords = bestPoint;
-        infoOut->index = bestIndex;
+        if (whichSetOut != NULL) whichSetOut[i] = myInfo.whichSet;
     }
-    return bestIndex;
 }
 
 set<LocatorInfo> CaretPointLocator::pointsInRange(const float target[3], const float& maxDist) const
 {
     set<LocatorInfo> ret;
-    if (m_tree == NULL) return ret;
-    float curDist2 = m_tree->distSquaredToPoint(target), maxDist2 = maxDist * maxDist;
-    if (curDist2 > maxDist2) return ret;
-    vector<Oct<LeafVector<Point> >*> myStack;//since we don't need the points sorted by distance
-    myStack.push_back(m_tree);
-    while (!myStack.empty())
+    vector<int64_t> indices;
+    for (int32_t i = 0; i < (int32_t)m_sets.size(); ++i)
     {
-        Oct<LeafVector<Point> >* thisOct = myStack.back();
-        myStack.pop_back();
-        if (thisOct->m_leaf)
+        indices.clear();
+        m_sets[i].m_tree->pointsInRange(target, maxDist, indices);
+        for (size_t j = 0; j < indices.size(); ++j)
         {
-            vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
-            int curSize = (int)myVecRef.size();
-            for (int i = 0; i < curSize; ++i)
-            {
-                float tempf = MathFunctions::distanceSquared3D(myVecRef[i].m_point, target);
-                if (tempf <= maxDist2)
-                {
-                    ret.insert(LocatorInfo(myVecRef[i].m_index, myVecRef[i].m_mySet, myVecRef[i].m_point));
-                }
-            }
-        } else {
-            for (int ii = 0; ii < 2; ++ii)
-            {
-                for (int ij = 0; ij < 2; ++ij)
-                {
-                    for (int ik = 0; ik < 2; ++ik)
-                    {
-                        float tempf = thisOct->m_children[ii][ij][ik]->distSquaredToPoint(target);
-                        if (tempf <= maxDist2)
-                        {
-                            myStack.push_back(thisOct->m_children[ii][ij][ik]);
-                        }
-                    }
-                }
-            }
+            float coords[3];
+            m_sets[i].m_tree->getPoint(indices[j], coords);
+            ret.insert(LocatorInfo(indices[j], m_sets[i].m_setIndex, coords));
         }
     }
     return ret;
 }
 
-bool CaretPointLocator::anyInRange(const float target[3], const float& maxDist) const
+void CaretPointLocator::pointsInRange(const float target[3], const float& maxDist, vector<int64_t>& indicesOut, const int32_t whichSet) const
 {
-    if (m_tree == NULL) return false;
-    float curDist2 = m_tree->distSquaredToPoint(target), maxDist2 = maxDist * maxDist, tempf;
-    if (curDist2 > maxDist2) return false;
-    CaretSimpleMinHeap<Oct<LeafVector<Point> >*, float> myHeap;//closer octs are more likely to contain a close enough point
-    myHeap.push(m_tree, curDist2);
-    while (!myHeap.isEmpty())
+    indicesOut.clear();
+    for (int32_t i = 0; i < (int32_t)m_sets.size(); ++i)
     {
-        Oct<LeafVector<Point> >* thisOct = myHeap.pop(&curDist2);
-        if (thisOct->m_leaf)
+        if (m_sets[i].m_setIndex == whichSet)
         {
-            vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
-            int curSize = (int)myVecRef.size();
-            for (int i = 0; i < curSize; ++i)
-            {
-                tempf = MathFunctions::distanceSquared3D(myVecRef[i].m_point, target);
-                if (tempf < maxDist2)
-                {
-                    return true;
-                }
-            }
-        } else {
-            for (int ii = 0; ii < 2; ++ii)
-            {
-                for (int ij = 0; ij < 2; ++ij)
-                {
-                    for (int ik = 0; ik < 2; ++ik)
-                    {
-                        tempf = thisOct->m_children[ii][ij][ik]->distSquaredToPoint(target);
-                        if (tempf <= maxDist2)
-                        {
-                            myHeap.push(thisOct->m_children[ii][ij][ik], tempf);
-                        }
-                    }
-                }
-            }
+            m_sets[i].m_tree->pointsInRange(target, maxDist, indicesOut);
+            return;
         }
     }
+}
+
+bool CaretPointLocator::anyInRange(const float target[3], const float& maxDist) const
+{
+    for (int32_t i = 0; i < (int32_t)m_sets.size(); ++i)
+    {
+        if (m_sets[i].m_tree->anyInRange(target, maxDist)) return true;
+    }
     return false;
 }
 
@@ -366,48 +188,12 @@ void CaretPointLocator::removePointSet(int32_t whichSet)
 {
     CaretMutexLocker locked(&m_modifyMutex);
     m_unusedIndexes.push_back(whichSet);
-    removeSetHelper(m_tree, whichSet);
-}
-
-void CaretPointLocator::removeSetHelper(Oct<LeafVector<CaretPointLocator::Point> >* thisOct, int32_t thisSet)
-{
-    if (thisOct == NULL) return;
-    if (thisOct->m_leaf)
+    for (int32_t i = 0; i < (int32_t)m_sets.size(); ++i)
     {
-        vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
-        int curSize = (int)myVecRef.size();
-        bool match = false;
-        for (int i = 0; i < curSize; ++i)//make sure something gets removed, so we don't have to do an allocation if it isn't needed
-        {
-            if (myVecRef[i].m_mySet == thisSet)
-            {
-                match = true;
-                break;
-            }
-        }
-        if (match)
-        {
-            vector<Point> tempvec;
-            tempvec.reserve(curSize - 1);//because at least one is getting removed
-            for (int i = 0; i < curSize; ++i)
-            {
-                if (myVecRef[i].m_mySet != thisSet)
-                {
-                    tempvec.push_back(myVecRef[i]);
-                }
-            }
-            myVecRef = tempvec;
-        }
-    } else {
-        for (int ii = 0; ii < 2; ++ii)
+        if (m_sets[i].m_setIndex == whichSet)
         {
-            for (int ij = 0; ij < 2; ++ij)
-            {
-                for (int ik = 0; ik < 2; ++ik)
-                {
-                    removeSetHelper(thisOct->m_children[ii][ij][ik], thisSet);
-                }
-            }
+            m_sets.erase(m_sets.begin() + i);
+            return;
         }
     }
 }
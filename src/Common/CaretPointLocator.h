@@ -22,8 +22,9 @@
  */
 /*LICENSE_END*/
 
+#include "CaretKdTree.h"
 #include "CaretMutex.h"
-#include "OctTree.h"
+#include "CaretPointer.h"
 #include "Vector3D.h"
 
 #include <set>
@@ -51,29 +52,19 @@ namespace caret {
     
     class CaretPointLocator
     {
-        struct Point
+        struct PointSet
         {
-            Vector3D m_point;
-            int64_t m_index;
-            int32_t m_mySet;
-            Point(const float point[3], const int64_t index, const int32_t mySet)
-            {
-                m_point = point;
-                m_index = index;
-                m_mySet = mySet;
-            }
+            CaretPointer<CaretKdTree> m_tree;
+            int32_t m_setIndex;
         };
         CaretMutex m_modifyMutex;//thread safety, don't let multiple threads modify the point sets at once
-        Oct<LeafVector<Point> >* m_tree;
+        std::vector<PointSet> m_sets;//each point set is its own static tree, usually there is only one
         int32_t m_nextSetIndex;
         std::vector<int32_t> m_unusedIndexes;
-        void addPoint(Oct<LeafVector<Point> >* thisOct, const float point[3], const int64_t index, const int32_t pointSet);
         int32_t newIndex();
-        static const int NUM_POINTS_SPLIT = 100;
-        void removeSetHelper(Oct<LeafVector<Point> >* thisOct, const int32_t thisSet);
         CaretPointLocator();
     public:
-        ///make an empty point locator with given bounding box (bounding box can expand later, but may be less efficient
+        ///make an empty point locator, the bounds are not needed anymore
         CaretPointLocator(const float minBounds[3], const float maxBounds[3]);
         ///make a point locator with the bounding box of this point set, and use this point set as set #0
         CaretPointLocator(const float* coordsIn, const int64_t numCoords);
@@ -84,7 +75,11 @@ namespace caret {
         ///returns the index of the closest point, and optionally which point set and the coords
         int64_t closestPoint(const float target[3], LocatorInfo* infoOut = NULL) const;
         int64_t closestPointLimited(const float target[3], const float& maxDist, LocatorInfo* infoOut = NULL) const;
+        ///closest point for each xyz triple in targets, computed in parallel, maxDist < 0 means unlimited, otherwise -1 where none are within it
+        void closestPoints(const float* targets, const int64_t& numTargets, int64_t* indicesOut, const float& maxDist = -1.0f, int32_t* whichSetOut = NULL) const;
         std::set<LocatorInfo> pointsInRange(const float target[3], const float& maxDist) const;
+        ///indices of the points of one set within range, unsorted, replaces the contents of indicesOut so reusing it avoids allocation
+        void pointsInRange(const float target[3], const float& maxDist, std::vector<int64_t>& indicesOut, const int32_t whichSet = 0) const;
         bool anyInRange(const float target[3], const float& maxDist) const;
     };
 }
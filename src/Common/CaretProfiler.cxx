@@ -0,0 +1,442 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretProfiler.h"
+
+#include "CaretException.h"
+#include "CaretMutex.h"
+#include "CaretOMP.h"
+#include "CaretPointer.h"
+#include "ElapsedTimer.h"
+
+#include <QFile>
+#include <QThreadStorage>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+QAtomicInt CaretProfiler::s_enabled(0);
+
+namespace
+{
+    struct ProfileNode
+    {
+        AString m_name;
+        int32_t m_parent;
+        map<AString, int32_t> m_children;
+        int64_t m_calls;
+        double m_totalMs;
+        map<AString, int64_t> m_counters;
+        ProfileNode(const AString& name, const int32_t& parent) : m_name(name) { m_parent = parent; m_calls = 0; m_totalMs = 0.0; }
+    };
+
+    struct TraceEvent
+    {
+        int32_t m_node;//-1 for counter samples
+        int32_t m_threadId;
+        double m_startMs, m_durationMs;
+        const char* m_counterName;
+        int64_t m_counterValue;//for samples, the amount added on this thread since its previous sample
+    };
+
+    struct ScopeTiming
+    {
+        int64_t m_calls;
+        double m_totalMs;
+        ScopeTiming() { m_calls = 0; m_totalMs = 0.0; }
+    };
+
+    struct CounterSample
+    {
+        double m_lastMs;
+        int64_t m_pending;
+        CounterSample() { m_lastMs = -1.0; m_pending = 0; }
+    };
+
+    //per thread accumulation, merged into the shared tree when a report or trace is made, or when the thread exits
+    struct ProfileThreadState
+    {
+        CaretMutex m_mutex;//taken by the owning thread for every update, only contended while merging
+        vector<int32_t> m_stack;
+        int32_t m_threadId;
+        bool m_isMain;
+        map<pair<int32_t, const char*>, int32_t> m_childCache;//(parent, name pointer) to node, so known scopes don't need the shared lock
+        map<int32_t, ScopeTiming> m_timing;
+        map<pair<int32_t, const char*>, int64_t> m_counters;//(node, name pointer), names are only made into strings when merging
+        map<const char*, CounterSample> m_samples;
+        vector<TraceEvent> m_trace;
+        ProfileThreadState() { m_threadId = -1; m_isMain = false; }
+        ~ProfileThreadState();
+    };
+
+    //the shared tree and everything below is protected by this mutex, when both are needed, take it before any thread's mutex
+    CaretMutex s_profileMutex;
+    vector<ProfileNode> s_nodes;
+    vector<TraceEvent> s_trace;
+    map<AString, int64_t> s_counterTotals;
+    vector<ProfileThreadState*> s_liveStates;
+    bool s_recordTrace = false;
+    int32_t s_nextThreadId = 0;
+    QAtomicInt s_mainCurrentNode(0);//innermost scope of the thread that enabled profiling, for openmp workers inside a region started from a scope
+    CaretPointer<ElapsedTimer> s_timer;
+    QThreadStorage<ProfileThreadState*> s_threadStates;//deletes the states when threads exit
+
+    int32_t loadMainNode()
+    {
+#if QT_VERSION >= 0x050000
+        return s_mainCurrentNode.loadAcquire();
+#else
+        return s_mainCurrentNode;
+#endif
+    }
+
+    //must hold the shared mutex and not the thread's mutex
+    void mergeThreadState(ProfileThreadState* myState)
+    {
+        CaretMutexLocker locked(&(myState->m_mutex));
+        const int32_t numNodes = (int32_t)s_nodes.size();//a worker can add to a scope from before a restart, drop those
+        for (map<int32_t, ScopeTiming>::const_iterator iter = myState->m_timing.begin(); iter != myState->m_timing.end(); ++iter)
+        {
+            if (iter->first >= numNodes) continue;
+            ProfileNode& myNode = s_nodes[iter->first];
+            myNode.m_calls += iter->second.m_calls;
+            myNode.m_totalMs += iter->second.m_totalMs;
+        }
+        myState->m_timing.clear();
+        for (map<pair<int32_t, const char*>, int64_t>::const_iterator iter = myState->m_counters.begin(); iter != myState->m_counters.end(); ++iter)
+        {
+            if (iter->first.first >= numNodes) continue;
+            AString myName(iter->first.second);
+            s_nodes[iter->first.first].m_counters[myName] += iter->second;
+            s_counterTotals[myName] += iter->second;
+        }
+        myState->m_counters.clear();
+        for (size_t i = 0; i < myState->m_trace.size(); ++i)
+        {
+            if (myState->m_trace[i].m_node < numNodes) s_trace.push_back(myState->m_trace[i]);
+        }
+        myState->m_trace.clear();
+        for (map<const char*, CounterSample>::iterator iter = myState->m_samples.begin(); iter != myState->m_samples.end(); ++iter)
+        {
+            if (iter->second.m_pending != 0)
+            {
+                TraceEvent myEvent;
+                myEvent.m_node = -1;
+                myEvent.m_threadId = myState->m_threadId;
+                myEvent.m_startMs = s_timer->getElapsedTimeMilliseconds();
+                myEvent.m_durationMs = 0.0;
+                myEvent.m_counterName = iter->first;
+                myEvent.m_counterValue = iter->second.m_pending;
+                s_trace.push_back(myEvent);
+                iter->second.m_pending = 0;
+            }
+        }
+    }
+
+    //must hold the shared mutex
+    void mergeAllThreadStates()
+    {
+        for (size_t i = 0; i < s_liveStates.size(); ++i)
+        {
+            mergeThreadState(s_liveStates[i]);
+        }
+    }
+
+    ProfileThreadState::~ProfileThreadState()
+    {//thread is exiting, keep what it collected
+        CaretMutexLocker locked(&s_profileMutex);
+        if (!s_nodes.empty()) mergeThreadState(this);
+        s_liveStates.erase(remove(s_liveStates.begin(), s_liveStates.end(), this), s_liveStates.end());
+        if (m_isMain) s_mainCurrentNode.fetchAndStoreOrdered(0);
+    }
+
+    //must not hold any profiler mutex
+    ProfileThreadState* getThreadState()
+    {
+        if (!s_threadStates.hasLocalData())
+        {
+            ProfileThreadState* newState = new ProfileThreadState();
+            {
+                CaretMutexLocker locked(&s_profileMutex);
+                newState->m_threadId = s_nextThreadId++;
+                s_liveStates.push_back(newState);
+            }
+            s_threadStates.setLocalData(newState);
+        }
+        return s_threadStates.localData();
+    }
+
+    //must hold the thread's mutex
+    int32_t getCurrentNode(ProfileThreadState* myState)
+    {
+        if (!myState->m_stack.empty()) return myState->m_stack.back();
+        return loadMainNode();
+    }
+
+    bool publishesScope(ProfileThreadState* myState)
+    {//inside a parallel region, the main thread is just one of the workers, keep showing the others the scope that started the region
+#ifdef CARET_OMP
+        return myState->m_isMain && !omp_in_parallel();
+#else
+        return myState->m_isMain;
+#endif
+    }
+
+    //must hold the thread's mutex
+    void pushScope(ProfileThreadState* myState, const int32_t& node)
+    {
+        myState->m_stack.push_back(node);
+        if (publishesScope(myState)) s_mainCurrentNode.fetchAndStoreOrdered(node);
+    }
+
+    //must hold the thread's mutex
+    void popScope(ProfileThreadState* myState)
+    {
+        myState->m_stack.pop_back();
+        if (publishesScope(myState)) s_mainCurrentNode.fetchAndStoreOrdered(myState->m_stack.empty() ? 0 : myState->m_stack.back());
+    }
+
+    AString escapeJson(const AString& in)
+    {
+        AString ret = in;
+        ret.replace("\\", "\\\\");
+        ret.replace("\"", "\\\"");
+        return ret;
+    }
+
+    bool sampleLess(const TraceEvent& left, const TraceEvent& right)
+    {
+        return left.m_startMs < right.m_startMs;
+    }
+
+    void addNodeReport(AString& report, const int32_t& node, const int& depth)
+    {
+        const ProfileNode& myNode = s_nodes[node];
+        double childMs = 0.0;
+        for (map<AString, int32_t>::const_iterator iter = myNode.m_children.begin(); iter != myNode.m_children.end(); ++iter)
+        {
+            childMs += s_nodes[iter->second].m_totalMs;
+        }
+        AString indent(depth * 2, ' ');
+        if (node != 0)
+        {
+            double selfMs = max(0.0, myNode.m_totalMs - childMs);//children in openmp workers can add up to more than the parent
+            report += AString::number(myNode.m_totalMs, 'f', 1).rightJustified(12) + AString::number(selfMs, 'f', 1).rightJustified(12) +
+                      AString::number(myNode.m_calls).rightJustified(9) + "  " + indent + myNode.m_name + "\n";
+        }
+        for (map<AString, int64_t>::const_iterator iter = myNode.m_counters.begin(); iter != myNode.m_counters.end(); ++iter)
+        {
+            report += AString(35, ' ') + indent + "  [" + iter->first + ": " + AString::number(iter->second) + "]\n";
+        }
+        vector<pair<double, int32_t> > children;//show the slowest first
+        for (map<AString, int32_t>::const_iterator iter = myNode.m_children.begin(); iter != myNode.m_children.end(); ++iter)
+        {
+            children.push_back(make_pair(-s_nodes[iter->second].m_totalMs, iter->second));
+        }
+        sort(children.begin(), children.end());
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            addNodeReport(report, children[i].second, (node == 0 ? depth : depth + 1));
+        }
+    }
+}
+
+void CaretProfiler::enable(const bool& recordTrace)
+{
+    ProfileThreadState* myState = getThreadState();
+    CaretMutexLocker locked(&s_profileMutex);
+    s_nodes.clear();
+    s_nodes.push_back(ProfileNode("", -1));//root
+    s_trace.clear();
+    s_counterTotals.clear();
+    s_recordTrace = recordTrace;
+    for (size_t i = 0; i < s_liveStates.size(); ++i)
+    {//node numbers from a previous run mean nothing now
+        ProfileThreadState* thisState = s_liveStates[i];
+        CaretMutexLocker stateLocked(&(thisState->m_mutex));
+        thisState->m_stack.clear();
+        thisState->m_isMain = (thisState == myState);
+        thisState->m_childCache.clear();
+        thisState->m_timing.clear();
+        thisState->m_counters.clear();
+        thisState->m_samples.clear();
+        thisState->m_trace.clear();
+    }
+    s_mainCurrentNode.fetchAndStoreOrdered(0);
+    s_timer.grabNew(new ElapsedTimer());
+    s_timer->start();
+    s_enabled.fetchAndStoreOrdered(1);
+}
+
+void CaretProfiler::disable()
+{
+    s_enabled.fetchAndStoreOrdered(0);
+}
+
+int32_t CaretProfiler::enterScope(const char* name, double& startMsOut)
+{
+    ProfileThreadState* myState = getThreadState();
+    int32_t parent, ret = -1;
+    pair<int32_t, const char*> key;
+    {
+        CaretMutexLocker locked(&(myState->m_mutex));
+        parent = getCurrentNode(myState);
+        key = make_pair(parent, name);
+        map<pair<int32_t, const char*>, int32_t>::const_iterator iter = myState->m_childCache.find(key);
+        if (iter != myState->m_childCache.end()) ret = iter->second;
+    }
+    if (ret == -1)
+    {//first time this thread has seen this scope here
+        CaretMutexLocker locked(&s_profileMutex);
+        if (parent >= (int32_t)s_nodes.size()) parent = 0;//profiling was restarted by another thread
+        AString myName(name);
+        map<AString, int32_t>::iterator iter = s_nodes[parent].m_children.find(myName);
+        if (iter == s_nodes[parent].m_children.end())
+        {
+            ret = (int32_t)s_nodes.size();
+            s_nodes.push_back(ProfileNode(myName, parent));//invalidates references into s_nodes, so don't hold any
+            s_nodes[parent].m_children[myName] = ret;
+        } else {
+            ret = iter->second;
+        }
+        CaretMutexLocker stateLocked(&(myState->m_mutex));
+        myState->m_childCache[key] = ret;
+        pushScope(myState, ret);
+    } else {
+        CaretMutexLocker locked(&(myState->m_mutex));
+        pushScope(myState, ret);
+    }
+    startMsOut = s_timer->getElapsedTimeMilliseconds();
+    return ret;
+}
+
+void CaretProfiler::exitScope(const int32_t& node, const double& startMs)
+{
+    double duration = s_timer->getElapsedTimeMilliseconds() - startMs;
+    ProfileThreadState* myState = getThreadState();
+    CaretMutexLocker locked(&(myState->m_mutex));
+    if (myState->m_stack.empty() || myState->m_stack.back() != node) return;//profiling was restarted while this scope was open
+    popScope(myState);
+    ScopeTiming& myTiming = myState->m_timing[node];
+    ++myTiming.m_calls;
+    myTiming.m_totalMs += duration;
+    if (s_recordTrace)
+    {
+        TraceEvent myEvent;
+        myEvent.m_node = node;
+        myEvent.m_threadId = myState->m_threadId;
+        myEvent.m_startMs = startMs;
+        myEvent.m_durationMs = duration;
+        myEvent.m_counterName = NULL;
+        myEvent.m_counterValue = 0;
+        myState->m_trace.push_back(myEvent);
+    }
+}
+
+void CaretProfiler::addCounterImpl(const char* name, const int64_t& amount)
+{
+    ProfileThreadState* myState = getThreadState();
+    CaretMutexLocker locked(&(myState->m_mutex));
+    myState->m_counters[make_pair(getCurrentNode(myState), name)] += amount;
+    if (s_recordTrace)
+    {//counters can be updated per row, so only sample them once per millisecond per thread
+        CounterSample& mySample = myState->m_samples[name];
+        mySample.m_pending += amount;
+        double now = s_timer->getElapsedTimeMilliseconds();
+        if (mySample.m_lastMs < 0.0 || now - mySample.m_lastMs >= 1.0)
+        {
+            TraceEvent myEvent;
+            myEvent.m_node = -1;
+            myEvent.m_threadId = myState->m_threadId;
+            myEvent.m_startMs = now;
+            myEvent.m_durationMs = 0.0;
+            myEvent.m_counterName = name;
+            myEvent.m_counterValue = mySample.m_pending;
+            myState->m_trace.push_back(myEvent);
+            mySample.m_lastMs = now;
+            mySample.m_pending = 0;
+        }
+    }
+}
+
+AString CaretProfiler::getReport()
+{
+    CaretMutexLocker locked(&s_profileMutex);
+    if (s_nodes.empty()) return "";
+    mergeAllThreadStates();
+    AString ret = "profile, " + AString::number(s_timer->getElapsedTimeSeconds(), 'f', 3) + "s wall time:\n";
+    ret += "  total (ms)   self (ms)    calls  scope\n";
+    addNodeReport(ret, 0, 0);
+    if (!s_counterTotals.empty())
+    {
+        ret += "counter totals:\n";
+        for (map<AString, int64_t>::const_iterator iter = s_counterTotals.begin(); iter != s_counterTotals.end(); ++iter)
+        {
+            ret += "  " + iter->first + ": " + AString::number(iter->second) + "\n";
+        }
+    }
+    return ret;
+}
+
+void CaretProfiler::writeTrace(const AString& fileName)
+{
+    AString text = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    {
+        CaretMutexLocker locked(&s_profileMutex);
+        if (!s_nodes.empty()) mergeAllThreadStates();
+        vector<TraceEvent> samples;
+        bool first = true;
+        for (size_t i = 0; i < s_trace.size(); ++i)
+        {
+            const TraceEvent& myEvent = s_trace[i];
+            if (myEvent.m_node == -1)
+            {
+                samples.push_back(myEvent);
+                continue;
+            }
+            if (!first) text += ",\n";
+            first = false;
+            text += "{\"name\": \"" + escapeJson(s_nodes[myEvent.m_node].m_name) + "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " + AString::number(myEvent.m_threadId) +
+                    ", \"ts\": " + AString::number(myEvent.m_startMs * 1000.0, 'f', 1) + ", \"dur\": " + AString::number(myEvent.m_durationMs * 1000.0, 'f', 1) + "}";
+        }
+        stable_sort(samples.begin(), samples.end(), sampleLess);//samples hold per-thread increments, the trace shows the running total over all threads
+        map<AString, int64_t> runningTotals;
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            AString myName(samples[i].m_counterName);
+            int64_t& total = runningTotals[myName];
+            total += samples[i].m_counterValue;
+            if (!first) text += ",\n";
+            first = false;
+            text += "{\"name\": \"" + escapeJson(myName) + "\", \"ph\": \"C\", \"pid\": 1, \"ts\": " + AString::number(samples[i].m_startMs * 1000.0, 'f', 1) +
+                    ", \"args\": {\"value\": " + AString::number(total) + "}}";
+        }
+    }
+    text += "\n]}\n";
+    QFile traceFile(fileName);
+    if (!traceFile.open(QIODevice::WriteOnly | QIODevice::Truncate) || traceFile.write(text.toUtf8()) == -1)
+    {
+        throw CaretException("failed to write profile trace file '" + fileName + "'");
+    }
+}
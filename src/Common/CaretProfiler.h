@@ -0,0 +1,93 @@
+#ifndef __CARET_PROFILER_H__
+#define __CARET_PROFILER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+
+#include <QAtomicInt>
+
+#include "stdint.h"
+
+namespace caret {
+
+    ///lightweight hierarchical timing and counters, for finding where time goes in a command (wb_command -profile)
+    ///when not enabled, scopes and counters cost one load of a static flag, so they can stay in release code
+    ///times and counters are accumulated per thread and merged into the report, so counters can be used per row inside parallel loops
+    ///scopes should be coarse (a file read, a weight computation, a compute loop), not per row or per vertex, use counters for those
+    class CaretProfiler
+    {
+        static QAtomicInt s_enabled;//set by the thread that starts profiling, read by all threads
+        static bool enabledFlag()
+        {
+#if QT_VERSION >= 0x050000
+            return s_enabled.loadAcquire() != 0;
+#else
+            return s_enabled != 0;
+#endif
+        }
+        CaretProfiler();
+        static int32_t enterScope(const char* name, double& startMsOut);
+        static void exitScope(const int32_t& node, const double& startMs);
+        static void addCounterImpl(const char* name, const int64_t& amount);
+        friend class CaretProfileScope;
+    public:
+        ///start collecting, recordTrace also keeps every scope instance for writeTrace()
+        static void enable(const bool& recordTrace = false);
+        static bool isEnabled() { return enabledFlag(); }
+        static void disable();
+
+        ///counters are attributed to the innermost scope of the calling thread, or for threads without a scope (OpenMP workers), the innermost scope of the thread that enabled profiling
+        ///the name must be a string literal (or otherwise outlive profiling), it is stored by pointer until merged
+        static void addCounter(const char* name, const int64_t& amount = 1)
+        {
+            if (enabledFlag()) addCounterImpl(name, amount);
+        }
+
+        ///tree of scopes with call counts, total and self times, and counters
+        static AString getReport();
+
+        ///Chrome trace-event format, view with chrome://tracing or perfetto
+        static void writeTrace(const AString& fileName);
+    };
+
+    ///times from construction to destruction, nested scopes on the same thread form the hierarchy, the name must be a string literal
+    class CaretProfileScope
+    {
+        int32_t m_node;
+        double m_startMs;
+        CaretProfileScope(const CaretProfileScope&);
+        CaretProfileScope& operator=(const CaretProfileScope&);
+    public:
+        explicit CaretProfileScope(const char* name)
+        {
+            m_node = -1;
+            if (CaretProfiler::enabledFlag()) m_node = CaretProfiler::enterScope(name, m_startMs);
+        }
+        ~CaretProfileScope()
+        {
+            if (m_node != -1) CaretProfiler::exitScope(m_node, m_startMs);
+        }
+    };
+
+}
+
+#endif //__CARET_PROFILER_H__
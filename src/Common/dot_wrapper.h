@@ -23,6 +23,12 @@ inline double sddot (const float *a, const float *b, int n)
     sum += a[k] * b[k];
   return sum;
 }  // sddot()
+inline void sddotmat (const float **a, int na, const float **b, int nb, int n, double *c, int ldc)
+{
+  for (int i = 0; i < na; i++)
+    for (int j = 0; j < nb; j++)
+      c[i*ldc+j] = sddot(a[i], b[j], n);
+}  // sddotmat()
 //copy enum from dot.h
 //renamed to dot_flags in both files for less conflict chance
 typedef enum {
@@ -24,14 +24,95 @@
 #include "ByteSwapping.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "DataCompressZLib.h"
 #include "FileInformation.h"
 
 #include <QByteArray>
 
+#include <limits>
+
 using namespace caret;
 using namespace std;
 
-const char magic[] = "\0\0\0\0cst\0";
+const char magic[] = "\0\0\0\0cst\0";//the last byte is the version, 0 for version 1
+const int MAGIC_VERSION_BYTE = 7;
+
+namespace
+{//version 2 row encoding: one byte of row encoding type, for zlib a varint of the decompressed size, then the (decompressed) payload:
+ //varint nonzero count, varint first index, varints of (delta - 1) for the remaining indices, then for each value, varints of its high and low 32 bits
+    enum RowEncoding
+    {
+        ROW_VARINT = 0,
+        ROW_VARINT_ZLIB = 1
+    };
+    
+    void appendVarint(vector<unsigned char>& bytes, uint64_t value)
+    {
+        while (value >= 128)
+        {
+            bytes.push_back((unsigned char)(value | 128));
+            value >>= 7;
+        }
+        bytes.push_back((unsigned char)value);
+    }
+    
+    uint64_t readVarint(const unsigned char*& data, const unsigned char* end)
+    {
+        uint64_t ret = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (data >= end) throw DataFileException("wbsparse row data is truncated");
+            unsigned char thisByte = *data;
+            ++data;
+            if (shift == 63 && (thisByte & 126) != 0) throw DataFileException("invalid varint in wbsparse row data");//only one bit is left at shift 63, more would overflow
+            ret |= ((uint64_t)(thisByte & 127)) << shift;
+            if ((thisByte & 128) == 0) return ret;
+        }
+        throw DataFileException("invalid varint in wbsparse row data");
+    }
+    
+    void encodeRowPayload(vector<unsigned char>& bytes, const vector<int64_t>& indices, const vector<int64_t>& values)
+    {
+        size_t numNonzero = indices.size();
+        appendVarint(bytes, numNonzero);
+        int64_t lastIndex = -1;
+        for (size_t i = 0; i < numNonzero; ++i)
+        {
+            appendVarint(bytes, indices[i] - lastIndex - 1);//caller checks that indices are increasing
+            lastIndex = indices[i];
+        }
+        for (size_t i = 0; i < numNonzero; ++i)
+        {
+            uint64_t bits = values[i];
+            appendVarint(bytes, bits >> 32);
+            appendVarint(bytes, bits & 0xFFFFFFFFULL);
+        }
+    }
+    
+    void decodeRowPayload(const unsigned char* data, const unsigned char* end, const int64_t& rowLength, vector<int64_t>& indicesOut, vector<int64_t>& valuesOut)
+    {
+        uint64_t numNonzero = readVarint(data, end);
+        if (numNonzero > (uint64_t)rowLength) throw DataFileException("impossible nonzero count found in wbsparse file");
+        indicesOut.resize(numNonzero);
+        valuesOut.resize(numNonzero);
+        int64_t lastIndex = -1;
+        for (uint64_t i = 0; i < numNonzero; ++i)
+        {
+            uint64_t delta = readVarint(data, end);
+            if (delta >= (uint64_t)(rowLength - lastIndex - 1)) throw DataFileException("impossible index value found in file");
+            lastIndex += delta + 1;
+            indicesOut[i] = lastIndex;
+        }
+        for (uint64_t i = 0; i < numNonzero; ++i)
+        {
+            uint64_t high = readVarint(data, end);
+            uint64_t low = readVarint(data, end);
+            if (high > 0xFFFFFFFFULL || low > 0xFFFFFFFFULL) throw DataFileException("invalid value found in wbsparse file");
+            valuesOut[i] = (int64_t)((high << 32) | low);
+        }
+        if (data != end) throw DataFileException("extra data found in wbsparse row");
+    }
+}
 
 CaretSparseFile::CaretSparseFile(const AString& fileName)
 {
@@ -51,7 +132,7 @@ void CaretSparseFile::readFile(const AString& filename)
     m_file.read(buf, 8);
     for (int i = 0; i < 8; ++i)
     {
-        if (buf[i] != magic[i]) throw DataFileException("file has the wrong magic string");
+        if (i != MAGIC_VERSION_BYTE && buf[i] != magic[i]) throw DataFileException("file has the wrong magic string");
     }
     m_file.read(m_dims, 2 * sizeof(int64_t));
     if (ByteOrderEnum::isSystemBigEndian())
@@ -59,21 +140,21 @@ void CaretSparseFile::readFile(const AString& filename)
         ByteSwapping::swapBytes(m_dims, 2);
     }
     if (m_dims[0] < 1 || m_dims[1] < 1) throw DataFileException("both dimensions must be positive");
-    m_indexArray.resize(m_dims[1] + 1);
-    vector<int64_t> lengthArray(m_dims[1]);
-    m_file.read(lengthArray.data(), m_dims[1] * sizeof(int64_t));
-    if (ByteOrderEnum::isSystemBigEndian())
-    {
-        ByteSwapping::swapBytes(lengthArray.data(), m_dims[1]);
-    }
-    m_indexArray[0] = 0;
-    for (int64_t i = 0; i < m_dims[1]; ++i)
+    int64_t xml_offset = -1;
+    switch (buf[MAGIC_VERSION_BYTE])
     {
-        if (lengthArray[i] > m_dims[0] || lengthArray[i] < 0) throw DataFileException("impossible value found in length array");
-        m_indexArray[i + 1] = m_indexArray[i] + lengthArray[i];
+        case 0:
+            m_version = 1;
+            xml_offset = readIndexV1();
+            break;
+        case 2:
+            m_version = 2;
+            xml_offset = readIndexV2();
+            break;
+        default:
+            throw DataFileException("unsupported wbsparse version: " + AString::number((int)buf[MAGIC_VERSION_BYTE]));
     }
-    m_valuesOffset = 8 + 2 * sizeof(int64_t) + m_dims[1] * sizeof(int64_t);
-    int64_t xml_offset = m_valuesOffset + m_indexArray[m_dims[1]] * 2 * sizeof(int64_t);
+    if (xml_offset < 0) throw DataFileException("impossible data size in wbsparse file");
     if (xml_offset >= fileInfo.size()) throw DataFileException("file is truncated");
     int64_t xml_length = fileInfo.size() - xml_offset;
     if (xml_length < 1) throw DataFileException("file is truncated");
@@ -96,6 +177,83 @@ void CaretSparseFile::readFile(const AString& filename)
     }
 }
 
+int64_t CaretSparseFile::readIndexV1()
+{
+    m_indexArray.resize(m_dims[1] + 1);
+    vector<int64_t> lengthArray(m_dims[1]);
+    m_file.read(lengthArray.data(), m_dims[1] * sizeof(int64_t));
+    if (ByteOrderEnum::isSystemBigEndian())
+    {
+        ByteSwapping::swapBytes(lengthArray.data(), m_dims[1]);
+    }
+    m_indexArray[0] = 0;
+    for (int64_t i = 0; i < m_dims[1]; ++i)
+    {
+        if (lengthArray[i] > m_dims[0] || lengthArray[i] < 0) throw DataFileException("impossible value found in length array");
+        m_indexArray[i + 1] = m_indexArray[i] + lengthArray[i];
+    }
+    m_valuesOffset = 8 + 2 * sizeof(int64_t) + m_dims[1] * sizeof(int64_t);
+    return m_valuesOffset + m_indexArray[m_dims[1]] * 2 * sizeof(int64_t);
+}
+
+int64_t CaretSparseFile::readIndexV2()
+{//row byte offsets are stored directly, one past the end for the last row
+    const int64_t headerSize = 8 + 2 * sizeof(int64_t), maxOffset = numeric_limits<int64_t>::max();
+    if (m_dims[1] > (maxOffset - headerSize) / (int64_t)sizeof(uint64_t) - 1) throw DataFileException("impossible number of rows in wbsparse file");
+    m_indexArray.resize(m_dims[1] + 1);
+    m_file.read(m_indexArray.data(), (m_dims[1] + 1) * sizeof(uint64_t));
+    if (ByteOrderEnum::isSystemBigEndian())
+    {
+        ByteSwapping::swapBytes(m_indexArray.data(), m_dims[1] + 1);
+    }
+    if (m_indexArray[0] != 0) throw DataFileException("impossible value found in row offset array");
+    for (int64_t i = 0; i < m_dims[1]; ++i)
+    {
+        if (m_indexArray[i + 1] < m_indexArray[i]) throw DataFileException("impossible value found in row offset array");
+    }
+    m_valuesOffset = headerSize + (m_dims[1] + 1) * sizeof(uint64_t);
+    if (m_indexArray[m_dims[1]] > (uint64_t)(maxOffset - m_valuesOffset)) throw DataFileException("impossible value found in row offset array");//the end of the data must fit in a file offset
+    return m_valuesOffset + m_indexArray[m_dims[1]];
+}
+
+void CaretSparseFile::getRowSparseV2(const int64_t& index, vector<int64_t>& indicesOut, vector<int64_t>& valuesOut)
+{
+    CaretAssert(index >= 0 && index < m_dims[1]);
+    int64_t start = m_indexArray[index], numBytes = m_indexArray[index + 1] - start;
+    if (numBytes == 0)
+    {
+        indicesOut.clear();
+        valuesOut.clear();
+        return;
+    }
+    m_scratchBytes.resize(numBytes);
+    m_file.seek(m_valuesOffset + start);
+    m_file.read(m_scratchBytes.data(), numBytes);//one read per row
+    const unsigned char* data = m_scratchBytes.data() + 1, *end = m_scratchBytes.data() + numBytes;
+    switch (m_scratchBytes[0])
+    {
+        case ROW_VARINT:
+            break;
+        case ROW_VARINT_ZLIB:
+        {
+            uint64_t decodedSize = readVarint(data, end);
+            if (decodedSize > (uint64_t)(m_dims[0] + 1) * 30) throw DataFileException("impossible row size found in wbsparse file");//count, 10 bytes per index, 20 bytes per value at most
+            m_scratchDecompressed.resize(decodedSize);
+            DataCompressZLib decompressor;
+            if (decompressor.uncompressData(data, end - data, m_scratchDecompressed.data(), decodedSize) != decodedSize)
+            {
+                throw DataFileException("failed to decompress row " + AString::number(index) + " of wbsparse file");
+            }
+            data = m_scratchDecompressed.data();
+            end = data + decodedSize;
+            break;
+        }
+        default:
+            throw DataFileException("unknown row encoding found in wbsparse file");
+    }
+    decodeRowPayload(data, end, m_dims[0], indicesOut, valuesOut);
+}
+
 CaretSparseFile::~CaretSparseFile()
 {
 }
@@ -103,6 +261,20 @@ CaretSparseFile::~CaretSparseFile()
 void CaretSparseFile::getRow(const int64_t& index, int64_t* rowOut)
 {
     CaretAssert(index >= 0 && index < m_dims[1]);
+    if (m_version == 2)
+    {
+        getRowSparseV2(index, m_scratchIndices, m_scratchArray);
+        for (int64_t i = 0; i < m_dims[0]; ++i)
+        {
+            rowOut[i] = 0;
+        }
+        size_t numNonzero = m_scratchIndices.size();
+        for (size_t i = 0; i < numNonzero; ++i)
+        {
+            rowOut[m_scratchIndices[i]] = m_scratchArray[i];
+        }
+        return;
+    }
     int64_t start = m_indexArray[index], end = m_indexArray[index + 1];
     int64_t numToRead = (end - start) * 2;
     m_scratchArray.resize(numToRead);
@@ -135,6 +307,11 @@ void CaretSparseFile::getRow(const int64_t& index, int64_t* rowOut)
 void CaretSparseFile::getRowSparse(const int64_t& index, vector<int64_t>& indicesOut, vector<int64_t>& valuesOut)
 {
     CaretAssert(index >= 0 && index < m_dims[1]);
+    if (m_version == 2)
+    {
+        getRowSparseV2(index, indicesOut, valuesOut);
+        return;
+    }
     int64_t start = m_indexArray[index], end = m_indexArray[index + 1];
     int64_t numToRead = (end - start) * 2, numNonzero = end - start;
     m_scratchArray.resize(numToRead);
@@ -206,12 +383,16 @@ void FiberFractions::zero()
     distance = 0.0f;
 }
 
-CaretSparseFileWriter::CaretSparseFileWriter(const AString& fileName, const CiftiXML& xml)
+CaretSparseFileWriter::CaretSparseFileWriter(const AString& fileName, const CiftiXML& xml, const int& version, const bool& compressRows)
 {
     if (!fileName.endsWith(".trajTEMP.wbsparse"))
     {//for now (and maybe forever), this format is single-purpose
         CaretLogWarning("sparse trajectory file '" + fileName + "' should be saved ending in .trajTEMP.wbsparse");
     }
+    if (version != 1 && version != 2) throw DataFileException("wbsparse version must be 1 or 2");
+    if (version == 1 && compressRows) throw DataFileException("row compression requires wbsparse version 2");
+    m_version = version;
+    m_compressRows = compressRows;
     m_finished = false;
     int64_t dimensions[2] = { xml.getDimensionLength(CiftiXML::ALONG_ROW), xml.getDimensionLength(CiftiXML::ALONG_COLUMN) };
     if (dimensions[0] < 1 || dimensions[1] < 1) throw DataFileException("both dimensions must be positive");
@@ -223,23 +404,82 @@ CaretSparseFileWriter::CaretSparseFileWriter(const AString& fileName, const Cift
         throw DataFileException("wbsparse files cannot be written compressed");
     }//because after we finish writing the data, we have to come back and write the lengths array
     m_file.open(fileName, CaretBinaryFile::WRITE_TRUNCATE);
-    m_file.write(magic, 8);
+    char tempMagic[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        tempMagic[i] = magic[i];
+    }
+    if (m_version == 2) tempMagic[MAGIC_VERSION_BYTE] = 2;
+    m_file.write(tempMagic, 8);
     int64_t tempdims[2] = { m_dims[0], m_dims[1] };
     if (ByteOrderEnum::isSystemBigEndian())
     {
         ByteSwapping::swapBytes(tempdims, 2);
     }
     m_file.write(tempdims, 2 * sizeof(int64_t));
-    m_lengthArray.resize(m_dims[1], 0);//initialize the memory so that valgrind won't complain
-    m_file.write(m_lengthArray.data(), m_dims[1] * sizeof(uint64_t));//write it to get the file to the correct length
+    int64_t indexLength = (m_version == 2 ? m_dims[1] + 1 : m_dims[1]);//version 2 stores row byte offsets, including the end of the last row
+    m_lengthArray.resize(indexLength, 0);//initialize the memory so that valgrind won't complain
+    m_file.write(m_lengthArray.data(), indexLength * sizeof(uint64_t));//write it to get the file to the correct length
     m_nextRowIndex = 0;
-    m_valuesOffset = 8 + 2 * sizeof(int64_t) + m_dims[1] * sizeof(int64_t);
+    m_valuesOffset = 8 + 2 * sizeof(int64_t) + indexLength * sizeof(int64_t);
+}
+
+void CaretSparseFileWriter::writeRowBytesV2(const int64_t& index, const vector<int64_t>& indices, const vector<int64_t>& values)
+{//m_lengthArray[m_nextRowIndex] is always the current end of the row data
+    uint64_t curOffset = m_lengthArray[m_nextRowIndex];
+    while (m_nextRowIndex < index)
+    {
+        ++m_nextRowIndex;
+        m_lengthArray[m_nextRowIndex] = curOffset;//skipped rows are empty
+    }
+    if (indices.size() != 0)
+    {
+        m_scratchBytes.clear();
+        m_scratchBytes.push_back(ROW_VARINT);
+        encodeRowPayload(m_scratchBytes, indices, values);
+        if (m_compressRows)
+        {
+            uint64_t payloadSize = m_scratchBytes.size() - 1;
+            DataCompressZLib compressor;
+            m_scratchCompressed.clear();
+            m_scratchCompressed.push_back(ROW_VARINT_ZLIB);
+            appendVarint(m_scratchCompressed, payloadSize);
+            size_t headerSize = m_scratchCompressed.size();
+            m_scratchCompressed.resize(headerSize + compressor.getMaximumCompressionSpace(payloadSize));
+            uint64_t compressedSize = compressor.compressData(m_scratchBytes.data() + 1, payloadSize, m_scratchCompressed.data() + headerSize, m_scratchCompressed.size() - headerSize);
+            if (compressedSize != 0 && headerSize + compressedSize < m_scratchBytes.size())
+            {//only use it if it helps, short rows often get larger
+                m_scratchCompressed.resize(headerSize + compressedSize);
+                m_scratchBytes.swap(m_scratchCompressed);
+            }
+        }
+        m_file.write(m_scratchBytes.data(), m_scratchBytes.size());
+        curOffset += m_scratchBytes.size();
+    }
+    m_nextRowIndex = index + 1;
+    m_lengthArray[m_nextRowIndex] = curOffset;
 }
 
 void CaretSparseFileWriter::writeRow(const int64_t& index, const int64_t* row)
 {
     CaretAssert(index < m_dims[1]);
     CaretAssert(index >= m_nextRowIndex);
+    if (m_version == 2)
+    {
+        m_scratchIndices.clear();
+        m_scratchArray.clear();
+        for (int64_t i = 0; i < m_dims[0]; ++i)
+        {
+            if (row[i] != 0)
+            {
+                m_scratchIndices.push_back(i);
+                m_scratchArray.push_back(row[i]);
+            }
+        }
+        writeRowBytesV2(index, m_scratchIndices, m_scratchArray);
+        if (m_nextRowIndex == m_dims[1]) finish();
+        return;
+    }
     while (m_nextRowIndex < index)
     {
         m_lengthArray[m_nextRowIndex] = 0;
@@ -271,6 +511,18 @@ void CaretSparseFileWriter::writeRowSparse(const int64_t& index, const vector<in
     CaretAssert(index < m_dims[1]);
     CaretAssert(index >= m_nextRowIndex);
     CaretAssert(indices.size() == values.size());
+    if (m_version == 2)
+    {
+        int64_t lastIndex = -1;
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            if (indices[i] <= lastIndex || indices[i] >= m_dims[0]) throw DataFileException("indices must be sorted when writing sparse rows");
+            lastIndex = indices[i];
+        }
+        writeRowBytesV2(index, indices, values);
+        if (m_nextRowIndex == m_dims[1]) finish();
+        return;
+    }
     while (m_nextRowIndex < index)
     {
         m_lengthArray[m_nextRowIndex] = 0;
@@ -326,10 +578,19 @@ void CaretSparseFileWriter::finish()
 {
     if (m_finished) return;
     m_finished = true;
-    while (m_nextRowIndex < m_dims[1])
+    if (m_version == 2)
     {
-        m_lengthArray[m_nextRowIndex] = 0;
-        ++m_nextRowIndex;
+        while (m_nextRowIndex < m_dims[1])
+        {
+            m_lengthArray[m_nextRowIndex + 1] = m_lengthArray[m_nextRowIndex];
+            ++m_nextRowIndex;
+        }
+    } else {
+        while (m_nextRowIndex < m_dims[1])
+        {
+            m_lengthArray[m_nextRowIndex] = 0;
+            ++m_nextRowIndex;
+        }
     }
     QByteArray myXMLBytes = m_xml.writeXMLToQByteArray();
     m_file.write(myXMLBytes.constData(), myXMLBytes.size());
@@ -44,13 +44,21 @@ namespace caret {
     {
         static void decodeFibers(const uint64_t& coded, FiberFractions& decoded);//takes a uint because right shift on signed is implementation dependent
         CaretBinaryFile m_file;
+        int m_version;
         int64_t m_dims[2], m_valuesOffset;
-        std::vector<uint64_t> m_indexArray, m_scratchRow;
-        std::vector<int64_t> m_scratchArray, m_scratchSparseRow;
+        std::vector<uint64_t> m_indexArray, m_scratchRow;//version 1: nonzero entry offsets, version 2: byte offsets of rows
+        std::vector<int64_t> m_scratchArray, m_scratchSparseRow, m_scratchIndices;
+        std::vector<unsigned char> m_scratchBytes, m_scratchDecompressed;
         CaretSparseFile(const CaretSparseFile& rhs);
         CiftiXML m_xml;
+        int64_t readIndexV1();//return the offset of the XML
+        int64_t readIndexV2();
+        void getRowSparseV2(const int64_t& index, std::vector<int64_t>& indicesOut, std::vector<int64_t>& valuesOut);
     public:
         const int64_t* getDimensions() { return m_dims; }
+        
+        ///1 for the original format with 16 bytes per nonzero, 2 for the compact encoding with a row offset index
+        int getVersion() const { return m_version; }
 
         CaretSparseFile() {};
         
@@ -79,14 +87,18 @@ namespace caret {
         static void encodeFibers(const FiberFractions& orig, uint64_t& coded);
         static uint32_t myclamp(const int& x);
         CaretBinaryFile m_file;
+        int m_version;
         int64_t m_dims[2], m_valuesOffset, m_nextRowIndex;
-        bool m_finished;
-        std::vector<uint64_t> m_lengthArray, m_scratchRow;
-        std::vector<int64_t> m_scratchArray, m_scratchSparseRow;
+        bool m_finished, m_compressRows;
+        std::vector<uint64_t> m_lengthArray, m_scratchRow;//version 1: nonzero count per row, version 2: byte offsets of rows
+        std::vector<int64_t> m_scratchArray, m_scratchSparseRow, m_scratchIndices;
+        std::vector<unsigned char> m_scratchBytes, m_scratchCompressed;
         CaretSparseFileWriter(const CaretSparseFileWriter& rhs);
         CiftiXML m_xml;
+        void writeRowBytesV2(const int64_t& index, const std::vector<int64_t>& indices, const std::vector<int64_t>& values);
     public:
-        CaretSparseFileWriter(const AString& fileName, const CiftiXML& xml);
+        ///version 2 is much smaller, but older wb_command can't read it, compressRows additionally uses zlib on each row (only for version 2, and only if it helps)
+        CaretSparseFileWriter(const AString& fileName, const CiftiXML& xml, const int& version = 1, const bool& compressRows = false);
         
         ~CaretSparseFileWriter();
         
@@ -372,10 +372,7 @@ CiftiConnectivityMatrixDenseDynamicFile::preComputeRowMeanAndSumSquared()
         }
         else {
             std::vector<float> data(m_numberOfTimePoints);
-#pragma omp critical
-            {//TSC: this can do disk access, which is not currently thread-safe
-                m_parentDataSeriesCiftiFile->getRow(&data[0], iRow);
-            }
+            m_parentDataSeriesCiftiFile->getRow(&data[0], iRow);//CiftiFile reading is thread-safe, and on-disk reads use positional reads, so don't serialize
             computeDataMeanAndSumSquared(&data[0],
                                          m_numberOfTimePoints,
                                          m_rowData[iRow].m_mean,
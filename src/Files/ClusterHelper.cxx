@@ -0,0 +1,191 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ClusterHelper.h"
+
+#include "CaretAssert.h"
+#include "CaretOMP.h"
+#include "TopologyHelper.h"
+#include "VolumeSpace.h"
+
+#include <algorithm>
+
+using namespace caret;
+using namespace std;
+
+/*
+ * Two pass labeling: the first pass unions every marked element with its marked lower index neighbors, always linking the higher
+ * root under the lower one, so every root is the lowest index in its cluster.  The second pass walks the elements in index order,
+ * giving each new root the next cluster number, which is the same cluster order the previous flood fill implementations produced.
+ */
+
+ClusterHelper::ClusterHelper(const TopologyHelper* topoHelp, const float* areaData)
+{
+    CaretAssert(areaData != NULL);
+    int numNodes = topoHelp->getNumberOfNodes();
+    m_numTotal = numNodes;
+    m_isVolume = false;
+    m_elemSize = vector<float>(areaData, areaData + numNodes);
+    m_neighStart.resize(numNodes + 1);
+    m_neighStart[0] = 0;
+    for (int i = 0; i < numNodes; ++i)
+    {
+        const vector<int32_t>& neighbors = topoHelp->getNodeNeighbors(i);
+        int numNeigh = (int)neighbors.size();
+        for (int j = 0; j < numNeigh; ++j)
+        {
+            if (neighbors[j] < i) m_lowerNeighbors.push_back(neighbors[j]);
+        }
+        m_neighStart[i + 1] = (int64_t)m_lowerNeighbors.size();
+    }
+}
+
+ClusterHelper::ClusterHelper(const VolumeSpace& volSpace)
+{
+    const int64_t* dims = volSpace.getDims();
+    m_dims[0] = dims[0];
+    m_dims[1] = dims[1];
+    m_dims[2] = dims[2];
+    m_numTotal = dims[0] * dims[1] * dims[2];
+    m_isVolume = true;
+}
+
+void ClusterHelper::findClusters(const char* mask, ClusterList& clustersOut, Workspace& work) const
+{
+    work.m_parent.resize(m_numTotal);
+    if (m_isVolume)
+    {
+        unionVolume(mask, work.m_parent.data());
+    } else {
+        unionSurface(mask, work.m_parent.data());
+    }
+    collectClusters(mask, clustersOut, work);
+}
+
+void ClusterHelper::unionSurface(const char* mask, int64_t* parent) const
+{
+    for (int64_t i = 0; i < m_numTotal; ++i)
+    {
+        if (!mask[i]) continue;
+        parent[i] = i;
+        const int64_t neighEnd = m_neighStart[i + 1];
+        for (int64_t n = m_neighStart[i]; n < neighEnd; ++n)
+        {
+            const int32_t neighbor = m_lowerNeighbors[n];
+            if (mask[neighbor]) unite(parent, i, neighbor);
+        }
+    }
+}
+
+void ClusterHelper::unionVolume(const char* mask, int64_t* parent) const
+{
+    int64_t numSlabs = 1;
+#ifdef CARET_OMP
+    if (!omp_in_parallel()) numSlabs = min((int64_t)omp_get_max_threads(), m_dims[2]);//when columns are already parallel, one slab per frame avoids the merge
+#endif
+    if (numSlabs < 2)
+    {
+        unionVolumeSlab(mask, parent, 0, m_dims[2]);
+        return;
+    }
+    vector<int64_t> slabStart(numSlabs + 1);
+    for (int64_t s = 0; s <= numSlabs; ++s)
+    {
+        slabStart[s] = m_dims[2] * s / numSlabs;
+    }
+#pragma omp CARET_PARFOR schedule(static, 1)
+    for (int64_t s = 0; s < numSlabs; ++s)
+    {//slabs only union within themselves, so they never touch each other's part of the forest
+        unionVolumeSlab(mask, parent, slabStart[s], slabStart[s + 1]);
+    }
+    const int64_t sliceSize = m_dims[0] * m_dims[1];
+    for (int64_t s = 1; s < numSlabs; ++s)
+    {//merge across the slab boundaries, the lowest member is still the root afterwards
+        const int64_t base = slabStart[s] * sliceSize;
+        for (int64_t i = 0; i < sliceSize; ++i)
+        {
+            if (mask[base + i] && mask[base + i - sliceSize]) unite(parent, base + i, base + i - sliceSize);
+        }
+    }
+}
+
+void ClusterHelper::unionVolumeSlab(const char* mask, int64_t* parent, const int64_t& kStart, const int64_t& kEnd) const
+{
+    const int64_t rowSize = m_dims[0], sliceSize = m_dims[0] * m_dims[1];
+    for (int64_t k = kStart; k < kEnd; ++k)
+    {
+        for (int64_t j = 0; j < m_dims[1]; ++j)
+        {
+            const int64_t rowBase = k * sliceSize + j * rowSize;
+            for (int64_t i = 0; i < m_dims[0]; ++i)
+            {
+                const int64_t index = rowBase + i;
+                if (!mask[index]) continue;
+                parent[index] = index;
+                if (i > 0 && mask[index - 1]) unite(parent, index, index - 1);
+                if (j > 0 && mask[index - rowSize]) unite(parent, index, index - rowSize);
+                if (k > kStart && mask[index - sliceSize]) unite(parent, index, index - sliceSize);
+            }
+        }
+    }
+}
+
+void ClusterHelper::collectClusters(const char* mask, ClusterList& clustersOut, Workspace& work) const
+{
+    int64_t* parent = work.m_parent.data();
+    work.m_label.resize(m_numTotal);
+    int64_t* label = work.m_label.data();
+    clustersOut.m_sizes.clear();
+    clustersOut.m_memberStart.assign(1, 0);
+    vector<int64_t>& counts = clustersOut.m_memberStart;//count into the start array, then prefix sum it
+    for (int64_t i = 0; i < m_numTotal; ++i)
+    {
+        if (!mask[i]) continue;
+        const int64_t root = parent[parent[i]];//parents are lower indices, so they are already flattened
+        parent[i] = root;
+        if (root == i)
+        {
+            label[i] = (int64_t)clustersOut.m_sizes.size();
+            clustersOut.m_sizes.push_back(0.0);
+            counts.push_back(0);
+        } else {
+            label[i] = label[root];
+        }
+        const int64_t myLabel = label[i];
+        ++counts[myLabel + 1];
+        if (m_isVolume)
+        {
+            clustersOut.m_sizes[myLabel] += 1.0;
+        } else {
+            clustersOut.m_sizes[myLabel] += m_elemSize[i];
+        }
+    }
+    const int64_t numClusters = clustersOut.getNumberOfClusters();
+    for (int64_t c = 0; c < numClusters; ++c)
+    {
+        counts[c + 1] += counts[c];
+    }
+    clustersOut.m_members.resize(counts[numClusters]);
+    vector<int64_t> fillPos(counts.begin(), counts.end() - 1);
+    for (int64_t i = 0; i < m_numTotal; ++i)
+    {
+        if (mask[i]) clustersOut.m_members[fillPos[label[i]]++] = i;
+    }
+}
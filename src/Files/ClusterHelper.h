@@ -0,0 +1,99 @@
+#ifndef __CLUSTER_HELPER_H__
+#define __CLUSTER_HELPER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "stdint.h"
+#include <vector>
+
+namespace caret
+{
+
+    class TopologyHelper;
+    class VolumeSpace;
+
+    ///connected component labeling over a fixed neighbor graph with union-find, built once and reused for any number of columns
+    class ClusterHelper
+    {
+    public:
+        ///the clusters of one column, in order of their lowest member index (the order a flood fill in index order finds them)
+        struct ClusterList
+        {
+            std::vector<double> m_sizes;//area for surfaces, number of voxels for volumes
+            std::vector<int64_t> m_memberStart;//compressed rows, cluster i is m_members[m_memberStart[i]] up to m_members[m_memberStart[i + 1]]
+            std::vector<int64_t> m_members;//increasing index order within each cluster
+            int64_t getNumberOfClusters() const { return (int64_t)m_sizes.size(); }
+        };
+
+        ///per-thread scratch memory, reuse it across columns to avoid reallocation
+        class Workspace
+        {
+            std::vector<int64_t> m_parent;//union-find forest, a parent always has a lower index than its child, so roots are the lowest member
+            std::vector<int64_t> m_label;
+            friend class ClusterHelper;
+        };
+
+        ///surface neighbors, sizes are summed vertex areas
+        ClusterHelper(const TopologyHelper* topoHelp, const float* areaData);
+
+        ///face neighbors in a volume frame, sizes are voxel counts, labeling of a single frame is split into slabs along k when not already in a parallel region
+        ClusterHelper(const VolumeSpace& volSpace);
+
+        int64_t getNumberOfElements() const { return m_numTotal; }
+
+        ///find the connected components of elements with nonzero mask values
+        void findClusters(const char* mask, ClusterList& clustersOut, Workspace& work) const;
+    private:
+        int64_t m_numTotal;
+        bool m_isVolume;
+        int64_t m_dims[3];
+        std::vector<int64_t> m_neighStart;//compressed row lists of only the lower index neighbors of each vertex, so each edge is visited once
+        std::vector<int32_t> m_lowerNeighbors;
+        std::vector<float> m_elemSize;//empty for volumes
+
+        void unionSurface(const char* mask, int64_t* parent) const;
+        void unionVolume(const char* mask, int64_t* parent) const;
+        void unionVolumeSlab(const char* mask, int64_t* parent, const int64_t& kStart, const int64_t& kEnd) const;
+        void collectClusters(const char* mask, ClusterList& clustersOut, Workspace& work) const;
+        static int64_t findRoot(int64_t* parent, int64_t elem)
+        {
+            while (parent[elem] != elem)
+            {
+                parent[elem] = parent[parent[elem]];//path halving
+                elem = parent[elem];
+            }
+            return elem;
+        }
+        static void unite(int64_t* parent, const int64_t& first, const int64_t& second)
+        {
+            int64_t firstRoot = findRoot(parent, first), secondRoot = findRoot(parent, second);
+            if (firstRoot < secondRoot)
+            {
+                parent[secondRoot] = firstRoot;
+            } else if (secondRoot < firstRoot) {
+                parent[firstRoot] = secondRoot;
+            }
+        }
+    };
+
+}
+
+#endif //__CLUSTER_HELPER_H__
@@ -678,6 +678,7 @@ void GeodesicHelper::dijkstra(const int32_t root, const std::vector<int32_t>& in
         {
             ++remain;
             marked[whichnode] = 2;//interested, not expanded, no valid value
+            output[whichnode] = -1.0f;//if it can't be reached, don't return a stale value from a previous search
             changed[numChanged++] = whichnode;
         }
     }
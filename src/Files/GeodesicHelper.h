@@ -119,7 +119,7 @@ namespace caret {
         /// Get distances from all nodes to all nodes, passes back NULL if cannot allocate, if successful you must eventually delete the memory
         float** getGeoAllToAll(const bool smooth = true);//i really don't think this needs an overloaded function that outputs parents
 
-        /// Get distances to a restricted set of nodes - output vector is in the SAME ORDER and same size as the input vector ofInterest
+        /// Get distances to a restricted set of nodes - output vector is in the SAME ORDER and same size as the input vector ofInterest, nodes that can't be reached get -1
         void getGeoToTheseNodes(const int32_t root, const std::vector<int32_t>& ofInterest, std::vector<float>& distsOut, bool smoothflag = true);
         
         ///get the distances and nodes along the path to a node - NOTE: default is not smooth distances, so that all nodes in the path are connected in the surface
@@ -21,17 +21,44 @@
 #include "MetricSmoothingObject.h"
 
 #include "CaretAssert.h"
+#include "CaretBinaryFile.h"
 #include "CaretException.h"
+#include "CaretLogger.h"
+#include "CaretProfiler.h"
 #include "SurfaceFile.h"
 #include "MetricFile.h"
 #include "GeodesicHelper.h"
 #include "TopologyHelper.h"
 #include "CaretOMP.h"
+#include "WeightCacheFile.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <limits>
 
 using namespace std;
 using namespace caret;
 
+AString MetricSmoothingObject::s_cacheDirectory;
+
+namespace
+{
+    //weight file layout, native byte order: header, int64 row starts for each node plus one-after, int32 neighbor nodes, float weights
+    const char SMOOTHING_FILE_MAGIC[8] = { 'w', 'b', 's', 'm', 'o', 'o', 't', 'h' };
+    const int32_t SMOOTHING_FILE_VERSION = 1;
+    
+    struct SmoothingFileHeader
+    {
+        WeightCacheFile::Header common;
+        int64_t numNodes;
+        int64_t numElems;
+    };
+}
+
 MetricSmoothingObject::MetricSmoothingObject(const SurfaceFile* mySurf, const float& kernel, const MetricFile* myRoi, Method myMethod, const float* nodeAreas)
 {
     CaretAssert(mySurf != NULL);
@@ -39,242 +66,419 @@ MetricSmoothingObject::MetricSmoothingObject(const SurfaceFile* mySurf, const fl
     {
         throw CaretException("roi number of nodes doesn't match the surface");
     }
+    CaretProfileScope myProfile("smoothing weights");
+    if (s_cacheDirectory == "")
+    {
+        precomputeWeights(mySurf, kernel, myRoi, myMethod, nodeAreas);
+        return;
+    }
+    AString cacheKey = computeCacheKey(mySurf, kernel, myRoi, myMethod, nodeAreas);
+    AString cacheFile = WeightCacheFile::getCacheFileName(s_cacheDirectory, cacheKey, ".wbsmw");
+    if (QFile::exists(cacheFile))
+    {
+        AString errorMessage;
+        if (readWeightFile(cacheFile, errorMessage, cacheKey))
+        {
+            CaretLogFine("using cached smoothing weights from '" + cacheFile + "'");
+            return;
+        }
+        CaretLogWarning("removing unusable smoothing weight cache file '" + cacheFile + "': " + errorMessage);
+        QFile::remove(cacheFile);
+    }
     precomputeWeights(mySurf, kernel, myRoi, myMethod, nodeAreas);
+    AString tempFile = WeightCacheFile::getTempFileName(cacheFile);
+    try
+    {
+        writeWeightFile(tempFile, cacheKey);
+        if (WeightCacheFile::moveIntoPlace(tempFile, cacheFile))
+        {
+            CaretLogFine("saved smoothing weights to cache file '" + cacheFile + "'");
+        } else {
+            CaretLogWarning("failed to rename smoothing weight cache file into place: '" + cacheFile + "'");
+        }
+    } catch (CaretException& e) {
+        QFile::remove(tempFile);
+        CaretLogWarning("failed to write smoothing weight cache file '" + cacheFile + "': " + e.whatString());
+    }
+}
+
+MetricSmoothingObject::MetricSmoothingObject(const AString& weightFile)
+{
+    AString errorMessage;
+    if (!readWeightFile(weightFile, errorMessage))
+    {
+        throw CaretException("failed to read smoothing weight file '" + weightFile + "': " + errorMessage);
+    }
+}
+
+void MetricSmoothingObject::writeToFile(const AString& weightFile) const
+{
+    writeWeightFile(weightFile, "");
+}
+
+AString MetricSmoothingObject::computeCacheKey(const SurfaceFile* mySurf, const float& myKernel, const MetricFile* theRoi, const Method& myMethod, const float* nodeAreas)
+{
+    QCryptographicHash hasher(QCryptographicHash::Sha1);
+    const char versionString[] = "MetricSmoothingObject weights 1";//change this if the weight computation changes
+    WeightCacheFile::addHashData(hasher, versionString, sizeof(versionString));
+    int32_t methodInt = (int32_t)myMethod, hasRoi = (theRoi != NULL ? 1 : 0);
+    int32_t hasAreas = (nodeAreas != NULL && myMethod == GEO_GAUSS_AREA ? 1 : 0);//other methods don't use the areas, and NULL means areas computed from the surface
+    WeightCacheFile::addHashData(hasher, &methodInt, sizeof(int32_t));
+    WeightCacheFile::addHashData(hasher, &myKernel, sizeof(float));
+    WeightCacheFile::addHashData(hasher, &hasRoi, sizeof(int32_t));
+    WeightCacheFile::addHashData(hasher, &hasAreas, sizeof(int32_t));
+    WeightCacheFile::addHashSurface(hasher, mySurf);
+    int64_t numNodes = mySurf->getNumberOfNodes();
+    if (hasRoi) WeightCacheFile::addHashData(hasher, theRoi->getValuePointerForColumn(0), numNodes * sizeof(float));//the constructor only uses the first column
+    if (hasAreas) WeightCacheFile::addHashData(hasher, nodeAreas, numNodes * sizeof(float));
+    return WeightCacheFile::getKey(hasher);
+}
+
+void MetricSmoothingObject::writeWeightFile(const AString& filename, const AString& key) const
+{
+    SmoothingFileHeader myHeader;
+    WeightCacheFile::initHeader(myHeader.common, SMOOTHING_FILE_MAGIC, SMOOTHING_FILE_VERSION, key);
+    myHeader.numNodes = getNumberOfNodes();
+    myHeader.numElems = (int64_t)m_weights.size();
+    CaretBinaryFile myFile(filename, CaretBinaryFile::WRITE_TRUNCATE);
+    myFile.write(&myHeader, sizeof(SmoothingFileHeader));
+    if (myHeader.numNodes > 0) myFile.write(m_weightStart.data(), m_weightStart.size() * sizeof(int64_t));
+    if (myHeader.numElems > 0)
+    {
+        myFile.write(m_weightNodes.data(), m_weightNodes.size() * sizeof(int32_t));
+        myFile.write(m_weights.data(), m_weights.size() * sizeof(float));
+    }
+    myFile.close();
+}
+
+bool MetricSmoothingObject::readWeightFile(const AString& filename, AString& errorOut, const AString& expectedKey)
+{
+    CaretAssert(sizeof(SmoothingFileHeader) == 72);
+    SmoothingFileHeader myHeader;
+    vector<int64_t> weightStart;
+    vector<int32_t> weightNodes;
+    vector<float> weights;
+    try
+    {
+        CaretBinaryFile myFile(filename);
+        int64_t numRead = 0;
+        myFile.read(&myHeader, sizeof(SmoothingFileHeader), &numRead);
+        if (numRead != (int64_t)sizeof(SmoothingFileHeader))
+        {
+            errorOut = "file is too short";
+            return false;
+        }
+        if (!WeightCacheFile::checkHeader(myHeader.common, SMOOTHING_FILE_MAGIC, SMOOTHING_FILE_VERSION, expectedKey, "smoothing weight", errorOut))
+        {
+            return false;
+        }
+        if (myHeader.numNodes < 0 || myHeader.numNodes > numeric_limits<int32_t>::max() || myHeader.numElems < 0)
+        {
+            errorOut = "invalid header";
+            return false;
+        }
+        if (myHeader.numNodes > 0)
+        {
+            weightStart.resize(myHeader.numNodes + 1);
+            myFile.read(weightStart.data(), weightStart.size() * sizeof(int64_t));
+        }
+        if (myHeader.numElems > 0)
+        {
+            weightNodes.resize(myHeader.numElems);
+            weights.resize(myHeader.numElems);
+            myFile.read(weightNodes.data(), weightNodes.size() * sizeof(int32_t));
+            myFile.read(weights.data(), weights.size() * sizeof(float));
+        }
+    } catch (CaretException& e) {
+        errorOut = e.whatString();
+        return false;
+    }
+    if (myHeader.numNodes > 0)
+    {
+        if (weightStart[0] != 0 || weightStart[myHeader.numNodes] != myHeader.numElems)
+        {
+            errorOut = "weight offsets are corrupt";
+            return false;
+        }
+        for (int64_t node = 0; node < myHeader.numNodes; ++node)
+        {
+            if (weightStart[node + 1] < weightStart[node])
+            {
+                errorOut = "weight offsets are corrupt";
+                return false;
+            }
+        }
+    } else if (myHeader.numElems != 0) {
+        errorOut = "weight offsets are corrupt";
+        return false;
+    }
+    for (int64_t elem = 0; elem < myHeader.numElems; ++elem)
+    {
+        if (weightNodes[elem] < 0 || weightNodes[elem] >= myHeader.numNodes)
+        {
+            errorOut = "weights refer to a vertex outside the surface";
+            return false;
+        }
+    }
+    if (myHeader.numNodes == 0) weightStart.assign(1, 0);
+    m_weightStart.swap(weightStart);
+    m_weightNodes.swap(weightNodes);
+    m_weights.swap(weights);
+    computeWeightSums();
+    return true;
+}
+
+void MetricSmoothingObject::setFromGather(const vector<WeightList>& gatherLists)
+{
+    int32_t numNodes = (int32_t)gatherLists.size();
+    m_weightStart.resize(numNodes + 1);
+    m_weightStart[0] = 0;
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        m_weightStart[i + 1] = m_weightStart[i] + (int64_t)gatherLists[i].m_nodes.size();
+    }
+    m_weightNodes.resize(m_weightStart[numNodes]);
+    m_weights.resize(m_weightStart[numNodes]);
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        copy(gatherLists[i].m_nodes.begin(), gatherLists[i].m_nodes.end(), m_weightNodes.begin() + m_weightStart[i]);
+        copy(gatherLists[i].m_weights.begin(), gatherLists[i].m_weights.end(), m_weights.begin() + m_weightStart[i]);
+    }
+    computeWeightSums();
+}
+
+void MetricSmoothingObject::setFromScatter(const vector<WeightList>& scatterLists)
+{//convert scattering kernels to gathering kernels by counting, then filling in scattering node order, which is the order the gathering lists used to be appended in
+    int32_t numNodes = (int32_t)scatterLists.size();
+    m_weightStart.assign(numNodes + 1, 0);
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        int32_t numNeigh = (int32_t)scatterLists[i].m_nodes.size();
+        for (int32_t j = 0; j < numNeigh; ++j)
+        {
+            ++m_weightStart[scatterLists[i].m_nodes[j] + 1];
+        }
+    }
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        m_weightStart[i + 1] += m_weightStart[i];
+    }
+    m_weightNodes.resize(m_weightStart[numNodes]);
+    m_weights.resize(m_weightStart[numNodes]);
+    vector<int64_t> fillPos(m_weightStart.begin(), m_weightStart.end() - 1);
+    for (int32_t i = 0; i < numNodes; ++i)//random access writes, but into one flat array instead of many growing vectors
+    {
+        int32_t numNeigh = (int32_t)scatterLists[i].m_nodes.size();
+        for (int32_t j = 0; j < numNeigh; ++j)
+        {
+            int64_t pos = fillPos[scatterLists[i].m_nodes[j]]++;
+            m_weightNodes[pos] = i;
+            m_weights[pos] = scatterLists[i].m_weights[j];
+        }
+    }
+    computeWeightSums();
+}
+
+void MetricSmoothingObject::computeWeightSums()
+{
+    int32_t numNodes = (int32_t)m_weightStart.size() - 1;
+    m_weightSums.resize(numNodes);
+#pragma omp CARET_PARFOR schedule(dynamic, 1024)
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        float sum = 0.0f;
+        for (int64_t j = m_weightStart[i]; j < m_weightStart[i + 1]; ++j)
+        {
+            sum += m_weights[j];
+        }
+        m_weightSums[i] = sum;
+    }
 }
 
 void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* columnOut, const MetricFile* roi, const bool& fixZeros) const
 {
     CaretAssert(metricIn != NULL);
     CaretAssert(columnOut != NULL);
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    int32_t numNodes = getNumberOfNodes();
+    if (metricIn->getNumberOfNodes() != numNodes)
     {
         throw CaretException("metric does not match surface number of nodes");
     }
-    if (whichColumn < -1 || whichColumn >= metricIn->getNumberOfColumns())
+    if (whichColumn < 0 || whichColumn >= metricIn->getNumberOfColumns())
     {
         throw CaretException("invalid column number");
     }
-    if (columnOut->getNumberOfNodes() != (int32_t)m_weightLists.size() || columnOut->getNumberOfColumns() != 1)
+    if (columnOut->getNumberOfNodes() != numNodes || columnOut->getNumberOfColumns() != 1)
     {
-        columnOut->setNumberOfNodesAndColumns(m_weightLists.size(), 1);
+        columnOut->setNumberOfNodesAndColumns(numNodes, 1);
     }
-    vector<float> scratch(metricIn->getNumberOfNodes());
+    vector<float> scratch(numNodes);
+    const float* roiColumn = NULL;
     if (roi != NULL)
     {
-        if (roi->getNumberOfNodes() != (int32_t)m_weightLists.size())
+        if (roi->getNumberOfNodes() != numNodes)
         {
             throw CaretException("roi does not match surface number of nodes");
         }
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, columnOut, 0, roi, 0, fixZeros);
-    } else {
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, columnOut, 0, fixZeros);
+        roiColumn = roi->getValuePointerForColumn(0);
     }
+    smoothMultiple(metricIn->getValuePointerForColumn(whichColumn), scratch.data(), 1, roiColumn, fixZeros);
+    columnOut->setValuesForColumn(0, scratch.data());
 }
 
 void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const
 {
     CaretAssert(metricIn != NULL);
     CaretAssert(metricOut != NULL);
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    int32_t numNodes = getNumberOfNodes();
+    if (metricIn->getNumberOfNodes() != numNodes)
     {
         throw CaretException("metric does not match surface number of nodes");
     }
-    if (metricOut->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricOut->getNumberOfNodes() != numNodes)
     {
         throw CaretException("output metric does not match surface number of nodes");
     }
-    if (roi != NULL && (roi->getNumberOfNodes() != (int32_t)m_weightLists.size()))
+    if (roi != NULL && (roi->getNumberOfNodes() != numNodes))
     {
         throw CaretException("roi does not match surface number of nodes");
     }
-    if (whichColumn < -1 || whichColumn >= metricIn->getNumberOfColumns())
+    if (whichColumn < 0 || whichColumn >= metricIn->getNumberOfColumns())
     {
         throw CaretException("invalid input column number");
     }
-    if (whichOutColumn < -1 || whichOutColumn >= metricOut->getNumberOfColumns())
+    if (whichOutColumn < 0 || whichOutColumn >= metricOut->getNumberOfColumns())
     {
         throw CaretException("invalid output column number");
     }
-    if (roi != NULL && (whichRoiColumn < -1 || whichRoiColumn >= roi->getNumberOfColumns()))
+    if (roi != NULL && (whichRoiColumn < 0 || whichRoiColumn >= roi->getNumberOfColumns()))
     {
-        throw CaretException("invalid input column number");
-    }
-    vector<float> scratch(metricIn->getNumberOfNodes());
-    if (roi != NULL)
-    {
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, metricOut, whichOutColumn, roi, whichRoiColumn, fixZeros);
-    } else {
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, metricOut, whichOutColumn, fixZeros);
+        throw CaretException("invalid roi column number");
     }
+    vector<float> scratch(numNodes);
+    smoothMultiple(metricIn->getValuePointerForColumn(whichColumn), scratch.data(), 1, (roi != NULL ? roi->getValuePointerForColumn(whichRoiColumn) : NULL), fixZeros);
+    metricOut->setValuesForColumn(whichOutColumn, scratch.data());
 }
 
 void MetricSmoothingObject::smoothMetric(const MetricFile* metricIn, MetricFile* metricOut, const MetricFile* roi, const bool& fixZeros) const
 {
     CaretAssert(metricIn != NULL);
     CaretAssert(metricOut != NULL);
-    int32_t numCols = metricIn->getNumberOfColumns();
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    int32_t numCols = metricIn->getNumberOfColumns(), numNodes = getNumberOfNodes();
+    if (metricIn->getNumberOfNodes() != numNodes)
     {
         throw CaretException("metric does not match surface number of nodes");
     }
-    if (metricOut->getNumberOfNodes() != (int32_t)m_weightLists.size() || metricOut->getNumberOfColumns() != numCols)
+    if (metricOut->getNumberOfNodes() != numNodes || metricOut->getNumberOfColumns() != numCols)
     {
-        metricOut->setNumberOfNodesAndColumns(m_weightLists.size(), numCols);
+        metricOut->setNumberOfNodesAndColumns(numNodes, numCols);
     }
-    vector<float> scratch(metricIn->getNumberOfNodes());
+    const float* roiColumn = NULL;
     if (roi != NULL)
     {
-        if (roi->getNumberOfNodes() != (int32_t)m_weightLists.size())
+        if (roi->getNumberOfNodes() != numNodes)
         {
             throw CaretException("roi does not match surface number of nodes");
         }
-        for (int32_t i = 0; i < numCols; ++i)
+        roiColumn = roi->getValuePointerForColumn(0);
+    }
+    const int32_t BLOCK_COLUMNS = 64;//smooth blocks of columns in interleaved form, so each pass over the weights does many columns
+    int32_t blockCols = min(numCols, BLOCK_COLUMNS);
+    vector<float> inBlock((int64_t)numNodes * blockCols), outBlock((int64_t)numNodes * blockCols), scratch(numNodes);
+    for (int32_t start = 0; start < numCols; start += blockCols)
+    {
+        int32_t thisBlock = min(blockCols, numCols - start);
+        for (int32_t b = 0; b < thisBlock; ++b)
         {
-            smoothColumnInternal(scratch.data(), metricIn, i, metricOut, i, roi, 0, fixZeros);
+            const float* inCol = metricIn->getValuePointerForColumn(start + b);
+            for (int32_t i = 0; i < numNodes; ++i)
+            {
+                inBlock[(int64_t)i * thisBlock + b] = inCol[i];
+            }
         }
-    } else {
-        for (int32_t i = 0; i < numCols; ++i)
+        smoothMultiple(inBlock.data(), outBlock.data(), thisBlock, roiColumn, fixZeros);
+        for (int32_t b = 0; b < thisBlock; ++b)
         {
-            smoothColumnInternal(scratch.data(), metricIn, i, metricOut, i, fixZeros);
+            for (int32_t i = 0; i < numNodes; ++i)
+            {
+                scratch[i] = outBlock[(int64_t)i * thisBlock + b];
+            }
+            metricOut->setValuesForColumn(start + b, scratch.data());
         }
     }
 }
 
-void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const bool& fixZeros) const
-{
-    CaretAssert(metricIn != NULL);//asserts only, and only basic checks, these functions are private
-    CaretAssert(metricOut != NULL);
-    CaretAssert(scratch != NULL);
-    CaretAssert(whichColumn >= 0 && whichColumn < metricIn->getNumberOfColumns());
-    CaretAssert(whichOutColumn >= 0 && whichOutColumn < metricOut->getNumberOfColumns());
-    const float* myColumn = metricIn->getValuePointerForColumn(whichColumn);
-    int32_t numNodes = metricIn->getNumberOfNodes();
-    if (fixZeros)//special case early to keep branching down
-    {
-#pragma omp CARET_PARFOR schedule(dynamic)
+void MetricSmoothingObject::smoothMultiple(const float* input, float* output, const int64_t& numColumns, const float* roi, const bool& fixZeros) const
+{//one pass over the weights for the whole block, each weight reads a contiguous run of input values, and each column gets the same arithmetic as when smoothed alone
+    CaretProfileScope myProfile("smoothing kernel");
+    CaretProfiler::addCounter("openmp regions");
+    CaretAssert(input != NULL);
+    CaretAssert(output != NULL);
+    int32_t numNodes = getNumberOfNodes();
+#pragma omp CARET_PAR
+    {
+        vector<float> sums(numColumns), weightSums(numColumns);
+#pragma omp CARET_FOR schedule(dynamic, 64)
         for (int32_t i = 0; i < numNodes; ++i)
         {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (myWeightRef.m_weightSum != 0.0f)//skip nodes with no neighbors quickly
+            float* outRow = output + (int64_t)i * numColumns;
+            if ((roi != NULL && !(roi[i] > 0.0f)) || m_weightSums[i] == 0.0f)//skip nodes with no neighbors quickly
             {
-                float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
+                for (int64_t c = 0; c < numColumns; ++c)
                 {
-                    float value = myColumn[myWeightRef.m_nodes[j]];
-                    if (value != 0.0f)
-                    {
-                        float weight = myWeightRef.m_weights[j];
-                        sum += weight * value;
-                        weightsum += weight;
-                    }
+                    outRow[c] = 0.0f;//but we do need to zero what we skip
                 }
-                if (weightsum != 0.0f)
-                {
-                    scratch[i] = sum / weightsum;
-                } else {
-                    scratch[i] = 0.0f;
-                }
-            } else {
-                scratch[i] = 0.0f;//but we do need to zero what we skip, so a list of nodes to check may not help
+                continue;
             }
-        }
-    } else {
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int32_t i = 0; i < numNodes; ++i)
-        {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (myWeightRef.m_weightSum != 0.0f)
+            for (int64_t c = 0; c < numColumns; ++c)
             {
-                float sum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
-                {
-                    sum += myWeightRef.m_weights[j] * myColumn[myWeightRef.m_nodes[j]];
-                }
-                scratch[i] = sum / myWeightRef.m_weightSum;
-            } else {
-                scratch[i] = 0.0f;
+                sums[c] = 0.0f;
+                weightSums[c] = 0.0f;
             }
-        }
-    }
-    metricOut->setValuesForColumn(whichOutColumn, scratch);
-}
-
-void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const
-{
-    CaretAssert(metricIn != NULL);//asserts only, and only basic checks, these functions are private
-    CaretAssert(metricOut != NULL);
-    CaretAssert(scratch != NULL);
-    CaretAssert(roi != NULL);
-    CaretAssert(whichColumn >= 0 && whichColumn < metricIn->getNumberOfColumns());
-    CaretAssert(whichOutColumn >= 0 && whichOutColumn < metricOut->getNumberOfColumns());
-    CaretAssert(whichRoiColumn >= 0 && whichRoiColumn < roi->getNumberOfColumns());
-    const float* myColumn = metricIn->getValuePointerForColumn(whichColumn);
-    const float* roiColumn = roi->getValuePointerForColumn(whichRoiColumn);
-    int32_t numNodes = metricIn->getNumberOfNodes();
-    if (fixZeros)//special case early to keep branching down
-    {
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int32_t i = 0; i < numNodes; ++i)
-        {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (roiColumn[i] > 0.0f && myWeightRef.m_weightSum != 0.0f)//skip nodes with no neighbors quickly
+            float roiWeightSum = 0.0f;//without fixZeros, which neighbors are used doesn't depend on the column
+            const int64_t rowEnd = m_weightStart[i + 1];
+            for (int64_t j = m_weightStart[i]; j < rowEnd; ++j)
             {
-                float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
+                const int32_t neighbor = m_weightNodes[j];
+                if (roi != NULL && !(roi[neighbor] > 0.0f)) continue;
+                const float weight = m_weights[j];
+                const float* inRow = input + (int64_t)neighbor * numColumns;
+                if (fixZeros)
                 {
-                    int32_t neighbor = myWeightRef.m_nodes[j];
-                    float value = myColumn[neighbor];
-                    if (roiColumn[neighbor] > 0.0f && value != 0.0f)
+                    for (int64_t c = 0; c < numColumns; ++c)
                     {
-                        float weight = myWeightRef.m_weights[j];
-                        sum += weight * value;
-                        weightsum += weight;
+                        const float value = inRow[c];
+                        const float useWeight = (value != 0.0f ? weight : 0.0f);//adding 0 * 0 leaves the sums unchanged, so this matches skipping zeros
+                        sums[c] += useWeight * value;
+                        weightSums[c] += useWeight;
                     }
-                }
-                if (weightsum != 0.0f)
-                {
-                    scratch[i] = sum / weightsum;
                 } else {
-                    scratch[i] = 0.0f;
+                    for (int64_t c = 0; c < numColumns; ++c)
+                    {
+                        sums[c] += weight * inRow[c];
+                    }
+                    roiWeightSum += weight;
                 }
-            } else {
-                scratch[i] = 0.0f;//but we do need to zero what we skip, so a list of nodes to check may not help
             }
-        }
-    } else {
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int32_t i = 0; i < numNodes; ++i)
-        {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (roiColumn[i] > 0.0f && myWeightRef.m_weightSum != 0.0f)
+            if (fixZeros)
             {
-                float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
+                for (int64_t c = 0; c < numColumns; ++c)
                 {
-                    int32_t neighbor = myWeightRef.m_nodes[j];
-                    if (roiColumn[neighbor] > 0.0f)
-                    {
-                        float weight = myWeightRef.m_weights[j];
-                        sum += weight * myColumn[neighbor];
-                        weightsum += weight;
-                    }
+                    outRow[c] = (weightSums[c] != 0.0f ? sums[c] / weightSums[c] : 0.0f);
                 }
-                if (weightsum != 0.0f)
+            } else if (roi != NULL) {
+                for (int64_t c = 0; c < numColumns; ++c)
                 {
-                    scratch[i] = sum / weightsum;
-                } else {
-                    scratch[i] = 0.0f;
+                    outRow[c] = (roiWeightSum != 0.0f ? sums[c] / roiWeightSum : 0.0f);
                 }
             } else {
-                scratch[i] = 0.0f;
+                for (int64_t c = 0; c < numColumns; ++c)
+                {
+                    outRow[c] = sums[c] / m_weightSums[i];
+                }
             }
         }
     }
-    metricOut->setValuesForColumn(whichOutColumn, scratch);
 }
 
 void MetricSmoothingObject::precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel)
@@ -282,7 +486,7 @@ void MetricSmoothingObject::precomputeWeightsGeoGauss(const SurfaceFile* mySurf,
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
     float gaussianDenom = -0.5f / myKernel / myKernel;
-    m_weightLists.resize(numNodes);
+    vector<WeightList> gatherLists(numNodes);
 #pragma omp CARET_PAR
     {
         CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();//don't really need one per thread here, but good practice in case we want getNeighborsToDepth
@@ -291,24 +495,23 @@ void MetricSmoothingObject::precomputeWeightsGeoGauss(const SurfaceFile* mySurf,
 #pragma omp CARET_FOR schedule(dynamic)
         for (int32_t i = 0; i < numNodes; ++i)
         {
-            myGeoHelp->getNodesToGeoDist(i, myGeoDist, m_weightLists[i].m_nodes, distances, true);
+            myGeoHelp->getNodesToGeoDist(i, myGeoDist, gatherLists[i].m_nodes, distances, true);
             if (distances.size() < 7)
             {
-                m_weightLists[i].m_nodes = myTopoHelp->getNodeNeighbors(i);
-                m_weightLists[i].m_nodes.push_back(i);
-                myGeoHelp->getGeoToTheseNodes(i, m_weightLists[i].m_nodes, distances, true);
+                gatherLists[i].m_nodes = myTopoHelp->getNodeNeighbors(i);
+                gatherLists[i].m_nodes.push_back(i);
+                myGeoHelp->getGeoToTheseNodes(i, gatherLists[i].m_nodes, distances, true);
             }
             int32_t numNeigh = (int32_t)distances.size();
-            m_weightLists[i].m_weights.resize(numNeigh);
-            m_weightLists[i].m_weightSum = 0.0f;
+            gatherLists[i].m_weights.resize(numNeigh);
             for (int32_t j = 0; j < numNeigh; ++j)
             {
                 float weight = exp(distances[j] * distances[j] * gaussianDenom);//exp(- dist ^ 2 / (2 * sigma ^ 2))
-                m_weightLists[i].m_weights[j] = weight;
-                m_weightLists[i].m_weightSum += weight;
+                gatherLists[i].m_weights[j] = weight;
             }
         }
     }
+    setFromGather(gatherLists);
 }
 
 void MetricSmoothingObject::precomputeWeightsROIGeoGauss(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi)
@@ -316,7 +519,7 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGauss(const SurfaceFile* mySu
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
     float gaussianDenom = -0.5f / myKernel / myKernel;
-    m_weightLists.resize(numNodes);
+    vector<WeightList> gatherLists(numNodes);
     const float* myRoiColumn = theRoi->getValuePointerForColumn(0);
 #pragma omp CARET_PAR
     {
@@ -337,22 +540,21 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGauss(const SurfaceFile* mySu
                     myGeoHelp->getGeoToTheseNodes(i, nodes, distances, true);
                 }
                 int32_t numNeigh = (int32_t)distances.size();
-                m_weightLists[i].m_weights.reserve(numNeigh);
-                m_weightLists[i].m_nodes.reserve(numNeigh);
-                m_weightLists[i].m_weightSum = 0.0f;
+                gatherLists[i].m_weights.reserve(numNeigh);
+                gatherLists[i].m_nodes.reserve(numNeigh);
                 for (int32_t j = 0; j < numNeigh; ++j)
                 {
                     if (myRoiColumn[nodes[j]] > 0.0f)
                     {
                         float weight = exp(distances[j] * distances[j] * gaussianDenom);//exp(- dist ^ 2 / (2 * sigma ^ 2))
-                        m_weightLists[i].m_weights.push_back(weight);
-                        m_weightLists[i].m_nodes.push_back(nodes[j]);
-                        m_weightLists[i].m_weightSum += weight;
+                        gatherLists[i].m_weights.push_back(weight);
+                        gatherLists[i].m_nodes.push_back(nodes[j]);
                     }
                 }
             }
         }
     }
+    setFromGather(gatherLists);
 }
 
 void MetricSmoothingObject::precomputeWeightsGeoGaussArea(const SurfaceFile* mySurf, float myKernel, const float* nodeAreas)
@@ -396,26 +598,7 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussArea(const SurfaceFile* myS
             tempList[i].m_weightSum = nodeAreas[i];
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
-    for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
-    {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
-        size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes (geodesic distance should be symmetric except for rounding errors, so it should usually be exact)
-        m_weightLists[i].m_weights.reserve(neighborCount);
-    }
-    for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
-    {
-        int32_t numNeigh = tempList[i].m_nodes.size();
-        for (int32_t j = 0; j < numNeigh; ++j)
-        {
-            int32_t node = tempList[i].m_nodes[j];
-            float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
-        }
-    }
+    setFromScatter(tempList);//now convert it to gathering kernels
 }
 
 void MetricSmoothingObject::precomputeWeightsROIGeoGaussArea(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, const float* nodeAreas)
@@ -468,26 +651,7 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussArea(const SurfaceFile*
             }
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
-    for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
-    {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
-        size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes, again, should be exact except for rounding errors in geodesic distance
-        m_weightLists[i].m_weights.reserve(neighborCount);
-    }
-    for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
-    {
-        int32_t numNeigh = tempList[i].m_nodes.size();
-        for (int32_t j = 0; j < numNeigh; ++j)
-        {
-            int32_t node = tempList[i].m_nodes[j];
-            float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
-        }
-    }
+    setFromScatter(tempList);//now convert it to gathering kernels
 }
 
 void MetricSmoothingObject::precomputeWeightsGeoGaussEqual(const SurfaceFile* mySurf, float myKernel)
@@ -530,26 +694,7 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussEqual(const SurfaceFile* my
             tempList[i].m_weightSum = 1.0f;
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
-    for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
-    {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
-        size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes (geodesic distance should be symmetric except for rounding errors, so it should usually be exact)
-        m_weightLists[i].m_weights.reserve(neighborCount);
-    }
-    for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
-    {
-        int32_t numNeigh = tempList[i].m_nodes.size();
-        for (int32_t j = 0; j < numNeigh; ++j)
-        {
-            int32_t node = tempList[i].m_nodes[j];
-            float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
-        }
-    }
+    setFromScatter(tempList);//now convert it to gathering kernels
 }
 
 void MetricSmoothingObject::precomputeWeightsROIGeoGaussEqual(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi)
@@ -601,26 +746,7 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussEqual(const SurfaceFile*
             }
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
-    for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
-    {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
-        size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes, again, should be exact except for rounding errors in geodesic distance
-        m_weightLists[i].m_weights.reserve(neighborCount);
-    }
-    for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
-    {
-        int32_t numNeigh = tempList[i].m_nodes.size();
-        for (int32_t j = 0; j < numNeigh; ++j)
-        {
-            int32_t node = tempList[i].m_nodes[j];
-            float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
-        }
-    }
+    setFromScatter(tempList);//now convert it to gathering kernels
 }
 
 void MetricSmoothingObject::precomputeWeights(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, Method myMethod, const float* nodeAreas)
@@ -30,6 +30,8 @@
 //NOTE: for a static ROI, it is (sometimes much) more efficient to use it in the constructor, and provide no ROI (NULL) to the functions, using both an ROI in constructor and in method
 //      will result in the effective ROI being the logical AND of the two (intersection).
 
+#include "AString.h"
+
 #include "stdint.h"
 #include "stddef.h"
 #include <vector>
@@ -48,20 +50,40 @@ namespace caret {
             GEO_GAUSS_EQUAL,
             GEO_GAUSS
         };
+        ///uses the cache directory, if set, to avoid recomputing weights for the same surface, kernel, method, roi and areas
         MetricSmoothingObject(const SurfaceFile* mySurf, const float& kernel, const MetricFile* myRoi = NULL, Method myMethod = GEO_GAUSS_AREA, const float* nodeAreas = NULL);
+        ///load weights previously saved with writeToFile
+        explicit MetricSmoothingObject(const AString& weightFile);
+        ///save the weights, so the geodesic search can be skipped next time
+        void writeToFile(const AString& weightFile) const;
+        ///directory to keep computed weights in, empty to disable caching
+        static void setCacheDirectory(const AString& directory) { s_cacheDirectory = directory; }
+        static const AString& getCacheDirectory() { return s_cacheDirectory; }
+        int32_t getNumberOfNodes() const { return (int32_t)m_weightSums.size(); }
         void smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* columnOut, const MetricFile* roi = NULL, const bool& fixZeros = false) const;
         void smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi = NULL, const int& whichRoiColumn = 0, const bool& fixZeros = false) const;
+        ///smooths blocks of columns in one pass over the weights each, results are identical to smoothing each column separately
         void smoothMetric(const MetricFile* metricIn, MetricFile* metricOut, const MetricFile* roi = NULL, const bool& fixZeros = false) const;
+        ///smooth many columns at once, input and output are interleaved (node-major, numColumns values per node), roi is one value per node, or NULL
+        void smoothMultiple(const float* input, float* output, const int64_t& numColumns, const float* roi = NULL, const bool& fixZeros = false) const;
     private:
         struct WeightList
-        {
+        {//only used while computing weights
             std::vector<int32_t> m_nodes;
             std::vector<float> m_weights;
             float m_weightSum;
         };
-        std::vector<WeightList> m_weightLists;
-        void smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const bool& fixZeros) const;
-        void smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const;
+        std::vector<int64_t> m_weightStart;//compressed rows, the gathering kernel of node i is m_weightStart[i] up to m_weightStart[i + 1]
+        std::vector<int32_t> m_weightNodes;
+        std::vector<float> m_weights;
+        std::vector<float> m_weightSums;//summed in row order, the same order the separate lists used to be summed in
+        static AString s_cacheDirectory;
+        static AString computeCacheKey(const SurfaceFile* mySurf, const float& myKernel, const MetricFile* theRoi, const Method& myMethod, const float* nodeAreas);
+        bool readWeightFile(const AString& filename, AString& errorOut, const AString& expectedKey = "");
+        void writeWeightFile(const AString& filename, const AString& key) const;
+        void setFromGather(const std::vector<WeightList>& gatherLists);
+        void setFromScatter(const std::vector<WeightList>& scatterLists);
+        void computeWeightSums();
         void precomputeWeights(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, Method myMethod, const float* nodeAreas);
         void precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel);
         void precomputeWeightsROIGeoGauss(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi);
@@ -188,68 +188,41 @@ NodeAndVoxelColoring::colorScalarsWithPalettePrivate(const FastStatistics* stati
     palette->getPaletteColor(1.0,
                              interpolateFlag,
                              rgbaPositiveOne);
-    const bool rgbaPositiveOneValid = (rgbaPositiveOne[3] > 0.0);
+    if (rgbaPositiveOne[3] <= 0.0) {
+        rgbaPositiveOne[0] = 0.0;
+        rgbaPositiveOne[1] = 0.0;
+        rgbaPositiveOne[2] = 0.0;
+        rgbaPositiveOne[3] = 0.0;
+    }
     palette->getPaletteColor(-1.0,
                              interpolateFlag,
                              rgbaNegativeOne);
-    const bool rgbaNegativeOneValid = (rgbaNegativeOne[3] > 0.0);
+    if (rgbaNegativeOne[3] <= 0.0) {
+        rgbaNegativeOne[0] = 0.0;
+        rgbaNegativeOne[1] = 0.0;
+        rgbaNegativeOne[2] = 0.0;
+        rgbaNegativeOne[3] = 0.0;
+    }
+    
+    /*
+     * Colors for other normalized values come from the palette's
+     * lookup table, interpolating between the table's colors.  Only
+     * intervals of the table that contain a palette scalar need
+     * to search the palette.
+     */
+    const CaretPointer<const PaletteLookupTable> lookupTable = palette->getLookupTable(interpolateFlag);
+    const float* lookupRGBA = &lookupTable->rgba[0];
+    const uint8_t* lookupLinearFlags = &lookupTable->linearFlags[0];
+    const int32_t lookupLastStep = PaletteLookupTable::NUM_STEPS - 1;
+    const float lookupHalfSteps = PaletteLookupTable::NUM_STEPS / 2;
     
     /*
      * Color all scalars.
      */
 #pragma omp CARET_PARFOR schedule(dynamic, 4096)
-        for (int64_t i = 0; i < numberOfScalars; i++) {
-        const int64_t i4 = i * 4;
-        
-        /*
-         * Initialize coloring for node since one of the
-         * continue statements below may cause moving
-         * on to next node
-         */
-        switch (colorDataType) {
-            case COLOR_TYPE_FLOAT:
-                rgbaFloat[i4]   =  0.0;
-                rgbaFloat[i4+1] =  0.0;
-                rgbaFloat[i4+2] =  0.0;
-                rgbaFloat[i4+3] =  0.0;
-                break;
-            case COLOR_TYPE_UNSIGNED_BTYE:
-                rgbaUnsignedByte[i4]   =  0;
-                rgbaUnsignedByte[i4+1] =  0;
-                rgbaUnsignedByte[i4+2] =  0;
-                rgbaUnsignedByte[i4+3] =  0;
-                break;
-        }
-        
-        float scalar = scalarValues[i];
-        const float threshold = thresholdValues[i];
-        
+    for (int64_t i = 0; i < numberOfScalars; i++) {
         /*
-         * Positive/Zero/Negative Test
-         */
-        if (scalar > PaletteColorMapping::SMALL_POSITIVE) {   // JWH 24 April 2015    NodeAndVoxelColoring::SMALL_POSITIVE) {
-            if (hidePositiveValues) {
-                continue;
-            }
-        }
-        else if (scalar < PaletteColorMapping::SMALL_NEGATIVE) {  // JWH 24 April 2015  NodeAndVoxelColoring::SMALL_NEGATIVE) {
-            if (hideNegativeValues) {
-                continue;
-            }
-        }
-        else {
-            /*
-             * May be very near zero so force to zero.
-             */
-            normalizedValues[i] = 0.0;
-            if (hideZeroValues) {
-                continue;
-            }
-        }
-        
-        /*
-         * Temporary for rgba coloring now that past possible
-         * continue statements
+         * Stays transparent black if the scalar is not displayed
          */
         float rgbaOut[4] = {
              0.0,
@@ -258,92 +231,102 @@ NodeAndVoxelColoring::colorScalarsWithPalettePrivate(const FastStatistics* stati
              0.0
         };
         
-        const float normalValue = normalizedValues[i];
+        const float scalar = scalarValues[i];
+        const float threshold = thresholdValues[i];
         
         /*
-         * RGBA colors have been mapped for extreme values
+         * Positive/Zero/Negative Test
+         * Values very near zero are forced to zero.
          */
-        if (normalValue >= 1.0) {
-            if (rgbaPositiveOneValid) {
+        const bool positiveFlag = (scalar > PaletteColorMapping::SMALL_POSITIVE);
+        const bool negativeFlag = (scalar < PaletteColorMapping::SMALL_NEGATIVE);
+        const bool zeroFlag = ( ! positiveFlag) && ( ! negativeFlag);
+        const bool displayFlag = ((positiveFlag && ( ! hidePositiveValues))
+                                  || (negativeFlag && ( ! hideNegativeValues))
+                                  || (zeroFlag && ( ! hideZeroValues)));
+        
+        if (displayFlag) {
+            const float normalValue = (zeroFlag ? 0.0f : normalizedValues[i]);
+            
+            if (normalValue >= 1.0) {
                 rgbaOut[0] = rgbaPositiveOne[0];
                 rgbaOut[1] = rgbaPositiveOne[1];
                 rgbaOut[2] = rgbaPositiveOne[2];
                 rgbaOut[3] = rgbaPositiveOne[3];
             }
-        }
-        else if (normalValue <= -1.0) {
-            if (rgbaNegativeOneValid) {
+            else if (normalValue <= -1.0) {
                 rgbaOut[0] = rgbaNegativeOne[0];
                 rgbaOut[1] = rgbaNegativeOne[1];
                 rgbaOut[2] = rgbaNegativeOne[2];
                 rgbaOut[3] = rgbaNegativeOne[3];
             }
-        }
-        else {
+            else {
+                const float position = (normalValue + 1.0f) * lookupHalfSteps;
+                int32_t step = (int32_t)position;
+                if (step > lookupLastStep) step = lookupLastStep;
+                
+                float rgba[4];
+                if (lookupLinearFlags[step]) {
+                    const float fraction = position - step;
+                    const float* below = lookupRGBA + step * 4;
+                    const float* above = below + 4;
+                    rgba[0] = below[0] + fraction * (above[0] - below[0]);
+                    rgba[1] = below[1] + fraction * (above[1] - below[1]);
+                    rgba[2] = below[2] + fraction * (above[2] - below[2]);
+                    rgba[3] = below[3] + fraction * (above[3] - below[3]);
+                }
+                else {
+                    palette->getPaletteColor(normalValue,
+                                             interpolateFlag,
+                                             rgba);
+                }
+                if (rgba[3] > 0.0f) {
+                    rgbaOut[0] = rgba[0];
+                    rgbaOut[1] = rgba[1];
+                    rgbaOut[2] = rgba[2];
+                    rgbaOut[3] = rgba[3];
+                }
+            }
+            
             /*
-             * Color scalar using palette
+             * Threshold Test
+             * Threshold is done last so colors are still set
+             * but if threshold test fails, alpha is set invalid.
              */
-            float rgba[4];
-            palette->getPaletteColor(normalValue,
-                                     interpolateFlag,
-                                     rgba);
-            if (rgba[3] > 0.0f) {
-                rgbaOut[0] = rgba[0];
-                rgbaOut[1] = rgba[1];
-                rgbaOut[2] = rgba[2];
-                rgbaOut[3] = rgba[3];
-            }
-        }
-        
-        /*
-         * Threshold Test
-         * Threshold is done last so colors are still set
-         * but if threshold test fails, alpha is set invalid.
-         */
-        bool thresholdPassedFlag = false;
-        if (skipThresholdTesting) {
-            thresholdPassedFlag = true;
-        }
-        else if (showOutsideFlag) {
-            if (threshold > thresholdMaximum) {
-                thresholdPassedFlag = true;
-            }
-            else if (threshold < thresholdMinimum) {
-                thresholdPassedFlag = true;
-            }
-        }
-        else {
-            if ((threshold >= thresholdMinimum) &&
-                (threshold <= thresholdMaximum)) {
-                thresholdPassedFlag = true;
-            }
-        }
-        if (thresholdPassedFlag == false) {
-            rgbaOut[3] = 0.0;
-            if (showMappedThresholdFailuresInGreen) {
-                if (thresholdType == PaletteThresholdTypeEnum::THRESHOLD_TYPE_MAPPED) {
-                    if (threshold > 0.0f) {
-                        if ((threshold < thresholdMappedPositive) &&
-                            (threshold > thresholdMappedPositiveAverageArea)) {
-                            rgbaOut[0] = positiveThresholdGreenColor[0];
-                            rgbaOut[1] = positiveThresholdGreenColor[1];
-                            rgbaOut[2] = positiveThresholdGreenColor[2];
-                            rgbaOut[3] = positiveThresholdGreenColor[3];
+            const bool insideFlag = ((threshold >= thresholdMinimum) &&
+                                     (threshold <= thresholdMaximum));
+            const bool outsideFlag = ((threshold > thresholdMaximum) ||
+                                      (threshold < thresholdMinimum));
+            const bool thresholdPassedFlag = (skipThresholdTesting
+                                              || (showOutsideFlag ? outsideFlag : insideFlag));
+            if (thresholdPassedFlag == false) {
+                rgbaOut[3] = 0.0;
+                if (showMappedThresholdFailuresInGreen) {
+                    if (thresholdType == PaletteThresholdTypeEnum::THRESHOLD_TYPE_MAPPED) {
+                        if (threshold > 0.0f) {
+                            if ((threshold < thresholdMappedPositive) &&
+                                (threshold > thresholdMappedPositiveAverageArea)) {
+                                rgbaOut[0] = positiveThresholdGreenColor[0];
+                                rgbaOut[1] = positiveThresholdGreenColor[1];
+                                rgbaOut[2] = positiveThresholdGreenColor[2];
+                                rgbaOut[3] = positiveThresholdGreenColor[3];
+                            }
                         }
-                    }
-                    else if (threshold < 0.0f) {
-                        if ((threshold > thresholdMappedNegative) &&
-                            (threshold < thresholdMappedNegativeAverageArea)) {
-                            rgbaOut[0] = negativeThresholdGreenColor[0];
-                            rgbaOut[1] = negativeThresholdGreenColor[1];
-                            rgbaOut[2] = negativeThresholdGreenColor[2];
-                            rgbaOut[3] = negativeThresholdGreenColor[3];
+                        else if (threshold < 0.0f) {
+                            if ((threshold > thresholdMappedNegative) &&
+                                (threshold < thresholdMappedNegativeAverageArea)) {
+                                rgbaOut[0] = negativeThresholdGreenColor[0];
+                                rgbaOut[1] = negativeThresholdGreenColor[1];
+                                rgbaOut[2] = negativeThresholdGreenColor[2];
+                                rgbaOut[3] = negativeThresholdGreenColor[3];
+                            }
                         }
                     }
                 }
             }
         }
-
+        
+        const int64_t i4 = i * 4;
         switch (colorDataType) {
             case COLOR_TYPE_FLOAT:
                 CaretAssertArrayIndex(rgbaFloat, numberOfScalars * 4, i*4+3);
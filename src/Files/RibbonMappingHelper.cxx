@@ -47,18 +47,30 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include "RibbonMappingHelper.h"
 
+#include "CaretAssert.h"
+#include "CaretBinaryFile.h"
 #include "CaretException.h"
+#include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "FloatMatrix.h"
 #include "MathFunctions.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
 #include "VolumeSpace.h"
+#include "WeightCacheFile.h"
 
+#include <QCryptographicHash>
+#include <QFile>
+
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 using namespace caret;
 using namespace std;
 
+AString RibbonMappingHelper::s_cacheDirectory;
+
 //private namespace for implementation details
 namespace
 {
@@ -242,6 +254,74 @@ namespace
 
 void RibbonMappingHelper::computeWeightsRibbon(vector<vector<VoxelWeight> >& myWeightsOut, const VolumeSpace& myVolSpace, const SurfaceFile* innerSurf, const SurfaceFile* outerSurf,
                                                const float* roiFrame, const int& numDivisions)
+{
+    if (s_cacheDirectory == "")
+    {
+        computeWeightsRibbonImpl(myWeightsOut, myVolSpace, innerSurf, outerSurf, roiFrame, numDivisions);
+        return;
+    }
+    if (!innerSurf->hasNodeCorrespondence(*outerSurf))
+    {
+        throw CaretException("input surfaces to ribbon mapping do not have vertex correspondence");
+    }
+    AString cacheKey = computeCacheKey(myVolSpace, innerSurf, outerSurf, roiFrame, numDivisions);
+    AString cacheFile = WeightCacheFile::getCacheFileName(s_cacheDirectory, cacheKey, ".wbribw");
+    if (QFile::exists(cacheFile))
+    {
+        RibbonMappingWeights cached;
+        AString errorMessage;
+        if (cached.readFile(cacheFile, errorMessage, cacheKey))
+        {
+            CaretLogFine("using cached ribbon mapping weights from '" + cacheFile + "'");
+            cached.getVoxelWeights(myWeightsOut);
+            return;
+        }
+        CaretLogWarning("removing unusable ribbon mapping weight cache file '" + cacheFile + "': " + errorMessage);
+        QFile::remove(cacheFile);
+    }
+    computeWeightsRibbonImpl(myWeightsOut, myVolSpace, innerSurf, outerSurf, roiFrame, numDivisions);
+    AString tempFile = WeightCacheFile::getTempFileName(cacheFile);
+    try
+    {
+        RibbonMappingWeights(myWeightsOut, myVolSpace.getDims()).writeFile(tempFile, cacheKey);
+        if (WeightCacheFile::moveIntoPlace(tempFile, cacheFile))
+        {
+            CaretLogFine("saved ribbon mapping weights to cache file '" + cacheFile + "'");
+        } else {
+            CaretLogWarning("failed to rename ribbon mapping weight cache file into place: '" + cacheFile + "'");
+        }
+    } catch (CaretException& e) {
+        QFile::remove(tempFile);
+        CaretLogWarning("failed to write ribbon mapping weight cache file '" + cacheFile + "': " + e.whatString());
+    }
+}
+
+AString RibbonMappingHelper::computeCacheKey(const VolumeSpace& myVolSpace, const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const float* roiFrame, const int& numDivisions)
+{
+    QCryptographicHash hasher(QCryptographicHash::Sha1);
+    const char versionString[] = "RibbonMappingHelper weights 1";//change this if the weight computation changes
+    WeightCacheFile::addHashData(hasher, versionString, sizeof(versionString));
+    const int64_t* dims = myVolSpace.getDims();
+    WeightCacheFile::addHashData(hasher, dims, 3 * sizeof(int64_t));
+    const vector<vector<float> >& sform = myVolSpace.getSform();
+    for (int i = 0; i < (int)sform.size(); ++i)
+    {
+        WeightCacheFile::addHashData(hasher, sform[i].data(), sform[i].size() * sizeof(float));
+    }
+    int32_t divInt = numDivisions, hasRoi = (roiFrame != NULL ? 1 : 0);
+    WeightCacheFile::addHashData(hasher, &divInt, sizeof(int32_t));
+    WeightCacheFile::addHashData(hasher, &hasRoi, sizeof(int32_t));
+    WeightCacheFile::addHashSurface(hasher, innerSurf);
+    WeightCacheFile::addHashSurface(hasher, outerSurf);
+    if (roiFrame != NULL)
+    {
+        WeightCacheFile::addHashData(hasher, roiFrame, dims[0] * dims[1] * dims[2] * sizeof(float));
+    }
+    return WeightCacheFile::getKey(hasher);
+}
+
+void RibbonMappingHelper::computeWeightsRibbonImpl(vector<vector<VoxelWeight> >& myWeightsOut, const VolumeSpace& myVolSpace, const SurfaceFile* innerSurf, const SurfaceFile* outerSurf,
+                                                   const float* roiFrame, const int& numDivisions)
 {
     if (!innerSurf->hasNodeCorrespondence(*outerSurf))
     {
@@ -330,3 +410,211 @@ void RibbonMappingHelper::computeWeightsRibbon(vector<vector<VoxelWeight> >& myW
         }
     }
 }
+
+namespace
+{
+    //weight file layout, native byte order: header, int64 row starts for each vertex plus one-after, int64 voxel offsets, float weights
+    const char RIBBON_FILE_MAGIC[8] = { 'w', 'b', 'r', 'i', 'b', 'b', 'o', 'n' };
+    const int32_t RIBBON_FILE_VERSION = 1;
+    
+    struct RibbonFileHeader
+    {
+        WeightCacheFile::Header common;
+        int64_t dims[3];
+        int64_t numNodes;
+        int64_t numElems;
+    };
+}
+
+RibbonMappingWeights::RibbonMappingWeights()
+{
+    m_dims[0] = 0;
+    m_dims[1] = 0;
+    m_dims[2] = 0;
+}
+
+RibbonMappingWeights::RibbonMappingWeights(const vector<vector<VoxelWeight> >& weightsIn, const int64_t dims[3])
+{
+    m_dims[0] = dims[0];
+    m_dims[1] = dims[1];
+    m_dims[2] = dims[2];
+    int64_t numNodes = (int64_t)weightsIn.size();
+    m_rowStart.resize(numNodes + 1);
+    m_rowStart[0] = 0;
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        m_rowStart[node + 1] = m_rowStart[node] + (int64_t)weightsIn[node].size();
+    }
+    m_voxelOffsets.resize(m_rowStart[numNodes]);
+    m_weights.resize(m_rowStart[numNodes]);
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        int64_t base = m_rowStart[node];
+        int numVoxels = (int)weightsIn[node].size();
+        for (int voxel = 0; voxel < numVoxels; ++voxel)
+        {
+            const VoxelWeight& thisWeight = weightsIn[node][voxel];
+            m_voxelOffsets[base + voxel] = thisWeight.ijk[0] + m_dims[0] * (thisWeight.ijk[1] + m_dims[1] * thisWeight.ijk[2]);
+            m_weights[base + voxel] = thisWeight.weight;
+        }
+    }
+    computeRowTotals();
+}
+
+void RibbonMappingWeights::computeRowTotals()
+{
+    int64_t numNodes = getNumberOfNodes();
+    m_rowTotals.resize(numNodes);
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        float totalWeight = 0.0f;
+        for (int64_t elem = m_rowStart[node]; elem < m_rowStart[node + 1]; ++elem)
+        {
+            totalWeight += m_weights[elem];
+        }
+        m_rowTotals[node] = totalWeight;
+    }
+}
+
+void RibbonMappingWeights::getVoxelWeights(vector<vector<VoxelWeight> >& weightsOut) const
+{
+    int64_t numNodes = getNumberOfNodes();
+    weightsOut.resize(numNodes);
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        weightsOut[node].resize(m_rowStart[node + 1] - m_rowStart[node]);
+        for (int64_t elem = m_rowStart[node]; elem < m_rowStart[node + 1]; ++elem)
+        {
+            VoxelWeight& thisWeight = weightsOut[node][elem - m_rowStart[node]];
+            int64_t offset = m_voxelOffsets[elem];
+            thisWeight.weight = m_weights[elem];
+            thisWeight.ijk[0] = offset % m_dims[0];
+            offset /= m_dims[0];
+            thisWeight.ijk[1] = offset % m_dims[1];
+            thisWeight.ijk[2] = offset / m_dims[1];
+        }
+    }
+}
+
+void RibbonMappingWeights::mapFrames(const float* const* frames, const int64_t& numFrames, float* output) const
+{
+    int64_t numNodes = getNumberOfNodes();
+#pragma omp CARET_PARFOR schedule(dynamic, 64)
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        float* outRow = output + node * numFrames;
+        for (int64_t f = 0; f < numFrames; ++f)
+        {
+            outRow[f] = 0.0f;
+        }
+        if (m_rowTotals[node] == 0.0f) continue;
+        for (int64_t elem = m_rowStart[node]; elem < m_rowStart[node + 1]; ++elem)
+        {
+            const float thisWeight = m_weights[elem];
+            const int64_t offset = m_voxelOffsets[elem];
+            for (int64_t f = 0; f < numFrames; ++f)
+            {
+                outRow[f] += thisWeight * frames[f][offset];
+            }
+        }
+        for (int64_t f = 0; f < numFrames; ++f)
+        {
+            outRow[f] /= m_rowTotals[node];
+        }
+    }
+}
+
+void RibbonMappingWeights::writeFile(const AString& filename, const AString& key) const
+{
+    RibbonFileHeader myHeader;
+    WeightCacheFile::initHeader(myHeader.common, RIBBON_FILE_MAGIC, RIBBON_FILE_VERSION, key);
+    for (int i = 0; i < 3; ++i) myHeader.dims[i] = m_dims[i];
+    myHeader.numNodes = getNumberOfNodes();
+    myHeader.numElems = (int64_t)m_weights.size();
+    CaretBinaryFile myFile(filename, CaretBinaryFile::WRITE_TRUNCATE);
+    myFile.write(&myHeader, sizeof(RibbonFileHeader));
+    if (myHeader.numNodes > 0) myFile.write(m_rowStart.data(), m_rowStart.size() * sizeof(int64_t));
+    if (myHeader.numElems > 0)
+    {
+        myFile.write(m_voxelOffsets.data(), m_voxelOffsets.size() * sizeof(int64_t));
+        myFile.write(m_weights.data(), m_weights.size() * sizeof(float));
+    }
+    myFile.close();
+}
+
+bool RibbonMappingWeights::readFile(const AString& filename, AString& errorOut, const AString& expectedKey)
+{
+    CaretAssert(sizeof(RibbonFileHeader) == 96);
+    RibbonFileHeader myHeader;
+    vector<int64_t> rowStart, voxelOffsets;
+    vector<float> weights;
+    try
+    {
+        CaretBinaryFile myFile(filename);
+        int64_t numRead = 0;
+        myFile.read(&myHeader, sizeof(RibbonFileHeader), &numRead);
+        if (numRead != (int64_t)sizeof(RibbonFileHeader))
+        {
+            errorOut = "file is too short";
+            return false;
+        }
+        if (!WeightCacheFile::checkHeader(myHeader.common, RIBBON_FILE_MAGIC, RIBBON_FILE_VERSION, expectedKey, "ribbon mapping weight", errorOut))
+        {
+            return false;
+        }
+        if (myHeader.numNodes < 0 || myHeader.numElems < 0 || myHeader.dims[0] < 1 || myHeader.dims[1] < 1 || myHeader.dims[2] < 1)
+        {
+            errorOut = "invalid header";
+            return false;
+        }
+        if (myHeader.numNodes > 0)
+        {
+            rowStart.resize(myHeader.numNodes + 1);
+            myFile.read(rowStart.data(), rowStart.size() * sizeof(int64_t));
+        }
+        if (myHeader.numElems > 0)
+        {
+            voxelOffsets.resize(myHeader.numElems);
+            weights.resize(myHeader.numElems);
+            myFile.read(voxelOffsets.data(), voxelOffsets.size() * sizeof(int64_t));
+            myFile.read(weights.data(), weights.size() * sizeof(float));
+        }
+    } catch (CaretException& e) {
+        errorOut = e.whatString();
+        return false;
+    }
+    if (myHeader.numNodes > 0)
+    {
+        if (rowStart[0] != 0 || rowStart[myHeader.numNodes] != myHeader.numElems)
+        {
+            errorOut = "weight offsets are corrupt";
+            return false;
+        }
+        for (int64_t node = 0; node < myHeader.numNodes; ++node)
+        {
+            if (rowStart[node + 1] < rowStart[node])
+            {
+                errorOut = "weight offsets are corrupt";
+                return false;
+            }
+        }
+    } else if (myHeader.numElems != 0) {
+        errorOut = "weight offsets are corrupt";
+        return false;
+    }
+    int64_t frameSize = myHeader.dims[0] * myHeader.dims[1] * myHeader.dims[2];
+    for (int64_t elem = 0; elem < myHeader.numElems; ++elem)
+    {
+        if (voxelOffsets[elem] < 0 || voxelOffsets[elem] >= frameSize)
+        {
+            errorOut = "weights refer to a voxel outside the volume";
+            return false;
+        }
+    }
+    for (int i = 0; i < 3; ++i) m_dims[i] = myHeader.dims[i];
+    m_rowStart.swap(rowStart);
+    m_voxelOffsets.swap(voxelOffsets);
+    m_weights.swap(weights);
+    computeRowTotals();
+    return true;
+}
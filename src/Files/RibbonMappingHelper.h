@@ -21,6 +21,8 @@
  */
 /*LICENSE_END*/
 
+#include "AString.h"
+
 #include "stdint.h"
 #include <cstddef>
 #include <vector>
@@ -45,12 +47,43 @@ namespace caret
         }
     };
     
+    class RibbonMappingWeights
+    {//compressed row storage of per-vertex voxel weights, with voxels as offsets into a frame
+        std::vector<int64_t> m_rowStart;//one per vertex, plus one-after
+        std::vector<int64_t> m_voxelOffsets;
+        std::vector<float> m_weights;
+        std::vector<float> m_rowTotals;//summed in the same order as the original mapping code, so results are identical
+        int64_t m_dims[3];
+        void computeRowTotals();
+    public:
+        RibbonMappingWeights();
+        RibbonMappingWeights(const std::vector<std::vector<VoxelWeight> >& weightsIn, const int64_t dims[3]);
+        int64_t getNumberOfNodes() const { return (m_rowStart.size() == 0 ? 0 : (int64_t)m_rowStart.size() - 1); }
+        const int64_t* getDims() const { return m_dims; }
+        ///expand back into the per-vertex lists used by computeWeightsRibbon
+        void getVoxelWeights(std::vector<std::vector<VoxelWeight> >& weightsOut) const;
+        ///weighted average of each vertex's voxels for a block of frames, output is vertex-major (numFrames values per vertex), vertices without weight get 0
+        void mapFrames(const float* const* frames, const int64_t& numFrames, float* output) const;
+        ///the key is only used by the weight cache, and can be empty
+        void writeFile(const AString& filename, const AString& key = "") const;
+        ///returns false and sets errorOut if the file can't be used, including when expectedKey is not empty and doesn't match
+        bool readFile(const AString& filename, AString& errorOut, const AString& expectedKey = "");
+    };
+    
     class RibbonMappingHelper
     {
+        static AString s_cacheDirectory;
+        static AString computeCacheKey(const VolumeSpace& myVolSpace, const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const float* roiFrame, const int& numDivisions);
+        static void computeWeightsRibbonImpl(std::vector<std::vector<VoxelWeight> >& myWeightsOut, const VolumeSpace& myVolSpace,
+                                             const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const float* roiFrame, const int& numDivisions);
     public:
         ///compute per-vertex ribbon mapping weights - surfaces must have vertex correspondence, or an exception is thrown
+        ///if a cache directory is set, weights for identical inputs are loaded from it instead of recomputed
         static void computeWeightsRibbon(std::vector<std::vector<VoxelWeight> >& myWeightsOut, const VolumeSpace& myVolSpace,
                                          const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const float* roiFrame = NULL, const int& numDivisions = 3);
+        ///directory to keep computed weights in, empty to disable caching
+        static void setCacheDirectory(const AString& directory) { s_cacheDirectory = directory; }
+        static const AString& getCacheDirectory() { return s_cacheDirectory; }
     };
 
 }
@@ -572,11 +572,11 @@ SurfaceFile::invalidateNormals()
 void 
 SurfaceFile::computeNormals()
 {
+    CaretMutexLocker locked(&m_normalsMutex);//batch mode shares input surfaces between commands running at the same time
     if (m_normalsComputed)//don't recompute when not needed
     {
         return;
     }
-    m_normalsComputed = true;
     int32_t numCoords = this->getNumberOfNodes();
     if (numCoords > 0) {
         this->normalVectors.resize(numCoords * 3);
@@ -634,6 +634,7 @@ SurfaceFile::computeNormals()
             }
         }
     }
+    m_normalsComputed = true;//set after computing, so another thread doesn't skip ahead to partial normals
 }
 
 std::vector<float> SurfaceFile::computeAverageNormals()
@@ -892,6 +893,7 @@ void SurfaceFile::invalidateHelpers()
 const BoundingBox* 
 SurfaceFile::getBoundingBox() const
 {
+    CaretMutexLocker locked(&m_boundingBoxMutex);
     if (this->boundingBox == NULL) {
         this->boundingBox = new BoundingBox();
         
@@ -26,24 +26,73 @@
 #include "SurfaceResamplingHelper.h"
 
 #include "CaretAssert.h"
+#include "CaretBinaryFile.h"
 #include "CaretException.h"
+#include "CaretLogger.h"
 #include "CaretOMP.h"
+#include "CaretProfiler.h"
 #include "GeodesicHelper.h"
+#include "MetricFile.h"
 #include "SignedDistanceHelper.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
 #include "Vector3D.h"
+#include "WeightCacheFile.h"
 
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+
+#include <cstring>
+#include <limits>
 #include <set>
 #include <map>
 
 using namespace std;
 using namespace caret;
 
+AString SurfaceResamplingHelper::s_cacheDirectory;
+
+namespace
+{
+    //weight file layout, native byte order: header, then int64 offsets for each new node plus one-after, then (int32 node, float weight) pairs
+    //everything after the header is 8-byte aligned, so the weights can be used directly out of a memory mapping
+    const char WEIGHT_FILE_MAGIC[8] = { 'w', 'b', 'r', 'e', 's', 'a', 'm', 'p' };
+    const int32_t WEIGHT_FILE_VERSION = 1;
+    
+    struct WeightFileHeader
+    {
+        WeightCacheFile::Header common;
+        int64_t numCurrentNodes;
+        int64_t numNewNodes;
+        int64_t numElems;
+    };
+}
+
 SurfaceResamplingHelper::SurfaceResamplingHelper(const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
                                                  const float* currentAreas, const float* newAreas, const float* currentRoi)
 {
     if (!checkSphere(currentSphere) || !checkSphere(newSphere)) throw CaretException("input surfaces to SurfaceResamplingHelper must be spheres");
+    m_numCurrentNodes = currentSphere->getNumberOfNodes();
+    AString cacheKey, cacheFile;
+    if (s_cacheDirectory != "")
+    {
+        cacheKey = computeCacheKey(myMethod, currentSphere, newSphere, currentAreas, newAreas, currentRoi);
+        cacheFile = WeightCacheFile::getCacheFileName(s_cacheDirectory, cacheKey, ".wbrsw");
+        if (QFile::exists(cacheFile))
+        {
+            AString errorMessage;
+            if (readWeightFile(cacheFile, cacheKey, errorMessage))
+            {
+                CaretLogFine("using cached resampling weights from '" + cacheFile + "'");
+                CaretProfiler::addCounter("resampling weight cache hits");
+                return;
+            }
+            CaretLogWarning("removing unusable resampling weight cache file '" + cacheFile + "': " + errorMessage);
+            QFile::remove(cacheFile);
+        }
+    }
+    CaretProfileScope profileScope("resampling weights");
     SurfaceFile currentSphereMod, newSphereMod;
     changeRadius(100.0f, currentSphere, &currentSphereMod);
     changeRadius(100.0f, newSphere, &newSphereMod);
@@ -58,6 +107,188 @@ SurfaceResamplingHelper::SurfaceResamplingHelper(const SurfaceResamplingMethodEn
             computeWeightsBarycentric(&currentSphereMod, &newSphereMod, currentRoi);
             break;
     }
+    if (cacheFile != "")
+    {
+        AString tempFile = WeightCacheFile::getTempFileName(cacheFile);
+        try
+        {
+            writeWeightFile(tempFile, cacheKey);
+            if (WeightCacheFile::moveIntoPlace(tempFile, cacheFile))
+            {
+                CaretLogFine("saved resampling weights to cache file '" + cacheFile + "'");
+            } else {
+                CaretLogWarning("failed to rename resampling weight cache file into place: '" + cacheFile + "'");
+            }
+        } catch (CaretException& e) {
+            QFile::remove(tempFile);
+            CaretLogWarning("failed to write resampling weight cache file '" + cacheFile + "': " + e.whatString());
+        }
+    }
+}
+
+SurfaceResamplingHelper::SurfaceResamplingHelper(const AString& weightFile)
+{
+    m_numCurrentNodes = 0;
+    AString errorMessage;
+    if (!readWeightFile(weightFile, "", errorMessage))
+    {
+        throw CaretException("failed to read resampling weight file '" + weightFile + "': " + errorMessage);
+    }
+}
+
+void SurfaceResamplingHelper::writeToFile(const AString& weightFile) const
+{
+    writeWeightFile(weightFile, "");
+}
+
+AString SurfaceResamplingHelper::computeCacheKey(const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
+                                                 const float* currentAreas, const float* newAreas, const float* currentRoi)
+{
+    QCryptographicHash hasher(QCryptographicHash::Sha1);
+    const char versionString[] = "SurfaceResamplingHelper weights 1";//change this if the weight computation changes, so old cache files don't get used
+    WeightCacheFile::addHashData(hasher, versionString, sizeof(versionString));
+    int32_t methodInt = (int32_t)myMethod;
+    WeightCacheFile::addHashData(hasher, &methodInt, sizeof(int32_t));
+    WeightCacheFile::addHashSurface(hasher, currentSphere);
+    WeightCacheFile::addHashSurface(hasher, newSphere);
+    int32_t flags = 0;//which optional inputs are used
+    if (myMethod == SurfaceResamplingMethodEnum::ADAP_BARY_AREA && currentAreas != NULL && newAreas != NULL) flags |= 1;
+    if (currentRoi != NULL) flags |= 2;
+    WeightCacheFile::addHashData(hasher, &flags, sizeof(int32_t));
+    if (flags & 1)
+    {
+        WeightCacheFile::addHashData(hasher, currentAreas, currentSphere->getNumberOfNodes() * sizeof(float));
+        WeightCacheFile::addHashData(hasher, newAreas, newSphere->getNumberOfNodes() * sizeof(float));
+    }
+    if (flags & 2)
+    {
+        WeightCacheFile::addHashData(hasher, currentRoi, currentSphere->getNumberOfNodes() * sizeof(float));
+    }
+    return WeightCacheFile::getKey(hasher);
+}
+
+bool SurfaceResamplingHelper::readWeightFile(const AString& filename, const AString& expectedKey, AString& errorOut)
+{
+    CaretAssert(sizeof(WeightElem) == 8 && sizeof(WeightFileHeader) == 80);
+    CaretPointer<CaretBinaryFile> myFile(new CaretBinaryFile());
+    WeightFileHeader myHeader;
+    int64_t fileSize = 0;
+    const char* mapped = NULL;
+    try
+    {
+        myFile->open(filename);
+        mapped = myFile->mapForRead(fileSize);
+        if (mapped == NULL)
+        {
+            fileSize = QFileInfo(filename).size();
+        }
+        if (fileSize < (int64_t)sizeof(WeightFileHeader))
+        {
+            errorOut = "file is too short";
+            return false;
+        }
+        if (mapped != NULL)
+        {
+            memcpy(&myHeader, mapped, sizeof(WeightFileHeader));
+        } else {
+            myFile->read(&myHeader, sizeof(WeightFileHeader));
+        }
+    } catch (CaretException& e) {
+        errorOut = e.whatString();
+        return false;
+    }
+    if (!WeightCacheFile::checkHeader(myHeader.common, WEIGHT_FILE_MAGIC, WEIGHT_FILE_VERSION, expectedKey, "resampling weight", errorOut))
+    {
+        return false;
+    }
+    const int64_t numNewNodes = myHeader.numNewNodes, numElems = myHeader.numElems;
+    if (myHeader.numCurrentNodes < 0 || myHeader.numCurrentNodes > numeric_limits<int>::max() ||
+        numNewNodes < 0 || numNewNodes >= numeric_limits<int>::max() || numElems < 0 ||
+        fileSize != (int64_t)sizeof(WeightFileHeader) + (numNewNodes + 1) * (int64_t)sizeof(int64_t) + numElems * (int64_t)sizeof(WeightElem))
+    {
+        errorOut = "file size does not match header";
+        return false;
+    }
+    const int64_t* offsets = NULL;
+    const WeightElem* elems = NULL;
+    vector<int64_t> offsetStorage;
+    CaretArray<WeightElem> elemStorage;
+    if (mapped != NULL)
+    {
+        offsets = (const int64_t*)(mapped + sizeof(WeightFileHeader));
+        elems = (const WeightElem*)(offsets + numNewNodes + 1);
+    } else {
+        try
+        {
+            offsetStorage.resize(numNewNodes + 1);
+            myFile->read(offsetStorage.data(), (numNewNodes + 1) * sizeof(int64_t));
+            elemStorage = CaretArray<WeightElem>(numElems);
+            if (numElems > 0) myFile->read(elemStorage.getArray(), numElems * sizeof(WeightElem));
+        } catch (CaretException& e) {
+            errorOut = e.whatString();
+            return false;
+        }
+        offsets = offsetStorage.data();
+        elems = elemStorage.getArray();
+    }
+    if (offsets[0] != 0 || offsets[numNewNodes] != numElems)
+    {
+        errorOut = "weight offsets are corrupt";
+        return false;
+    }
+    for (int64_t i = 0; i < numNewNodes; ++i)
+    {
+        if (offsets[i + 1] < offsets[i])
+        {
+            errorOut = "weight offsets are corrupt";
+            return false;
+        }
+    }
+    for (int64_t i = 0; i < numElems; ++i)
+    {
+        if (elems[i].node < 0 || elems[i].node >= myHeader.numCurrentNodes)
+        {
+            errorOut = "weights refer to a vertex outside the current mesh";
+            return false;
+        }
+    }
+    m_weights = CaretArray<const WeightElem*>(numNewNodes + 1);
+    for (int64_t i = 0; i <= numNewNodes; ++i)
+    {
+        m_weights[i] = elems + offsets[i];
+    }
+    m_numCurrentNodes = (int)myHeader.numCurrentNodes;
+    if (mapped != NULL)
+    {
+        m_mappedFile = myFile;
+        m_storagechunk = CaretArray<WeightElem>();
+    } else {
+        m_mappedFile.grabNew(NULL);
+        m_storagechunk = elemStorage;
+    }
+    return true;
+}
+
+void SurfaceResamplingHelper::writeWeightFile(const AString& filename, const AString& key) const
+{
+    if (m_weights.size() == 0) throw CaretException("no resampling weights to write");
+    const int64_t numNewNodes = m_weights.size() - 1;
+    const int64_t numElems = m_weights[numNewNodes] - m_weights[0];//weights are always one contiguous chunk
+    WeightFileHeader myHeader;
+    WeightCacheFile::initHeader(myHeader.common, WEIGHT_FILE_MAGIC, WEIGHT_FILE_VERSION, key);
+    myHeader.numCurrentNodes = m_numCurrentNodes;
+    myHeader.numNewNodes = numNewNodes;
+    myHeader.numElems = numElems;
+    vector<int64_t> offsets(numNewNodes + 1);
+    for (int64_t i = 0; i <= numNewNodes; ++i)
+    {
+        offsets[i] = m_weights[i] - m_weights[0];
+    }
+    CaretBinaryFile myFile(filename, CaretBinaryFile::WRITE_TRUNCATE);
+    myFile.write(&myHeader, sizeof(WeightFileHeader));
+    myFile.write(offsets.data(), offsets.size() * sizeof(int64_t));
+    if (numElems > 0) myFile.write(m_weights[0], numElems * sizeof(WeightElem));
+    myFile.close();
 }
 
 void SurfaceResamplingHelper::resampleNormal(const float* input, float* output, const float& invalidVal) const
@@ -66,7 +297,7 @@ void SurfaceResamplingHelper::resampleNormal(const float* input, float* output,
 #pragma omp CARET_PARFOR schedule(dynamic)
     for (int i = 0; i < numNodes; ++i)
     {
-        WeightElem* end = m_weights[i + 1], *elem = m_weights[i];
+        const WeightElem* end = m_weights[i + 1], *elem = m_weights[i];
         if (elem != end)
         {
             double accum = 0.0;
@@ -81,6 +312,85 @@ void SurfaceResamplingHelper::resampleNormal(const float* input, float* output,
     }
 }
 
+void SurfaceResamplingHelper::resampleNormalMultiple(const float* input, float* output, const int64_t& numColumns, const float& invalidVal) const
+{//one pass over the weights for the whole block, and each weight reads a contiguous run of input values
+    int numNodes = (int)m_weights.size() - 1;
+#pragma omp CARET_PAR
+    {
+        vector<double> accum(numColumns);
+#pragma omp CARET_FOR schedule(dynamic, 64)
+        for (int i = 0; i < numNodes; ++i)
+        {
+            float* outRow = output + i * numColumns;
+            const WeightElem* end = m_weights[i + 1], *elem = m_weights[i];
+            if (elem != end)
+            {
+                for (int64_t c = 0; c < numColumns; ++c)
+                {
+                    accum[c] = 0.0;
+                }
+                for (; elem != end; ++elem)
+                {
+                    const float* inRow = input + elem->node * numColumns;
+                    const float weight = elem->weight;
+                    for (int64_t c = 0; c < numColumns; ++c)
+                    {
+                        accum[c] += inRow[c] * weight;//same arithmetic as resampleNormal, so results are identical
+                    }
+                }
+                for (int64_t c = 0; c < numColumns; ++c)
+                {
+                    outRow[c] = accum[c];
+                }
+            } else {
+                for (int64_t c = 0; c < numColumns; ++c)
+                {
+                    outRow[c] = invalidVal;
+                }
+            }
+        }
+    }
+}
+
+void SurfaceResamplingHelper::resampleMetric(const MetricFile* metricIn, MetricFile* metricOut, const float& invalidVal) const
+{
+    CaretAssert(metricIn != NULL);
+    CaretAssert(metricOut != NULL);
+    int numColumns = metricIn->getNumberOfColumns(), numCurNodes = getNumberOfCurrentNodes(), numNewNodes = getNumberOfNewNodes();
+    if (metricIn->getNumberOfNodes() != numCurNodes)
+    {
+        throw CaretException("metric does not match the number of vertices of the current sphere");
+    }
+    if (metricOut->getNumberOfNodes() != numNewNodes || metricOut->getNumberOfColumns() != numColumns)
+    {
+        metricOut->setNumberOfNodesAndColumns(numNewNodes, numColumns);
+    }
+    const int BLOCK_COLUMNS = 64;//resample blocks of columns in interleaved form, so each pass over the weights does many columns
+    int blockCols = min(numColumns, BLOCK_COLUMNS);
+    vector<float> inBlock((int64_t)numCurNodes * blockCols), outBlock((int64_t)numNewNodes * blockCols), colScratch(numNewNodes);
+    for (int start = 0; start < numColumns; start += blockCols)
+    {
+        int thisBlock = min(blockCols, numColumns - start);
+        for (int b = 0; b < thisBlock; ++b)
+        {
+            const float* inCol = metricIn->getValuePointerForColumn(start + b);
+            for (int j = 0; j < numCurNodes; ++j)
+            {
+                inBlock[(int64_t)j * thisBlock + b] = inCol[j];
+            }
+        }
+        resampleNormalMultiple(inBlock.data(), outBlock.data(), thisBlock, invalidVal);
+        for (int b = 0; b < thisBlock; ++b)
+        {
+            for (int j = 0; j < numNewNodes; ++j)
+            {
+                colScratch[j] = outBlock[(int64_t)j * thisBlock + b];
+            }
+            metricOut->setValuesForColumn(start + b, colScratch.data());
+        }
+    }
+}
+
 void SurfaceResamplingHelper::resample3DCoord(const float* input, float* output) const
 {
     int numNodes = (int)m_weights.size() - 1;
@@ -88,8 +398,8 @@ void SurfaceResamplingHelper::resample3DCoord(const float* input, float* output)
     for (int i = 0; i < numNodes; ++i)
     {
         double tempvec[3] = { 0.0, 0.0, 0.0 };
-        WeightElem* end = m_weights[i + 1];
-        for (WeightElem* elem = m_weights[i]; elem != end; ++elem)
+        const WeightElem* end = m_weights[i + 1];
+        for (const WeightElem* elem = m_weights[i]; elem != end; ++elem)
         {
             const float* coord = input + elem->node * 3;
             tempvec[0] += coord[0] * elem->weight;//don't need to divide afterwards, because the weights already sum to 1
@@ -112,8 +422,8 @@ void SurfaceResamplingHelper::resamplePopular(const int32_t* input, int32_t* out
         map<int32_t, float> accum;
         float maxweight = -1.0f;
         int32_t bestlabel = invalidVal;
-        WeightElem* end = m_weights[i + 1];
-        for (WeightElem* elem = m_weights[i]; elem != end; ++elem)
+        const WeightElem* end = m_weights[i + 1];
+        for (const WeightElem* elem = m_weights[i]; elem != end; ++elem)
         {
             int32_t label = input[elem->node];
             map<int, float>::iterator iter = accum.find(label);
@@ -144,10 +454,10 @@ void SurfaceResamplingHelper::resampleLargest(const float* input, float* output,
 #pragma omp CARET_PARFOR schedule(dynamic)
     for (int i = 0; i < numNodes; ++i)
     {
-        WeightElem* end = m_weights[i + 1];
+        const WeightElem* end = m_weights[i + 1];
         float largest = -1.0f;
         int largestNode = -1;
-        for (WeightElem* elem = m_weights[i]; elem != end; ++elem)
+        for (const WeightElem* elem = m_weights[i]; elem != end; ++elem)
         {
             if (elem->weight > largest)
             {
@@ -170,10 +480,10 @@ void SurfaceResamplingHelper::resampleLargest(const int32_t* input, int32_t* out
 #pragma omp CARET_PARFOR schedule(dynamic)
     for (int i = 0; i < numNodes; ++i)
     {
-        WeightElem* end = m_weights[i + 1];
+        const WeightElem* end = m_weights[i + 1];
         float largest = -1.0f;
         int largestNode = -1;
-        for (WeightElem* elem = m_weights[i]; elem != end; ++elem)
+        for (const WeightElem* elem = m_weights[i]; elem != end; ++elem)
         {
             if (elem->weight > largest)
             {
@@ -537,7 +847,7 @@ void SurfaceResamplingHelper::compactWeights(const vector<map<int, float> >& wei
 {
     int compactsize = 0;
     int numNodes = (int)weights.size();
-    m_weights = CaretArray<WeightElem*>(numNodes + 1);//include a "one-after" pointer
+    m_weights = CaretArray<const WeightElem*>(numNodes + 1);//include a "one-after" pointer
     for (int i = 0; i < numNodes; ++i)
     {
         compactsize += (int)weights[i].size();
@@ -21,6 +21,7 @@
  */
 /*LICENSE_END*/
 
+#include "AString.h"
 #include "CaretPointer.h"
 #include "SurfaceResamplingMethodEnum.h"
 
@@ -29,6 +30,8 @@
 
 namespace caret {
 
+    class CaretBinaryFile;
+    class MetricFile;
     class SurfaceFile;
     
     class SurfaceResamplingHelper
@@ -41,7 +44,14 @@ namespace caret {
             WeightElem(const int& nodeIn, const float& weightIn) : node(nodeIn), weight(weightIn) { }
         };
         CaretArray<WeightElem> m_storagechunk;
-        CaretArray<WeightElem*> m_weights;
+        CaretArray<const WeightElem*> m_weights;//can point into m_storagechunk or into m_mappedFile
+        CaretPointer<CaretBinaryFile> m_mappedFile;//keeps a memory mapped weight file open while m_weights points into it
+        int m_numCurrentNodes;
+        static AString s_cacheDirectory;
+        static AString computeCacheKey(const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
+                                       const float* currentAreas, const float* newAreas, const float* currentRoi);
+        bool readWeightFile(const AString& filename, const AString& expectedKey, AString& errorOut);
+        void writeWeightFile(const AString& filename, const AString& key) const;
         static bool checkSphere(const SurfaceFile* surface);
         static void changeRadius(const float& radius, const SurfaceFile* input, SurfaceFile* output);
         void computeWeightsAdapBaryArea(const SurfaceFile* currentSphere, const SurfaceFile* newSphere, const float* currentAreas, const float* newAreas, const float* currentRoi);
@@ -49,11 +59,25 @@ namespace caret {
         static void makeBarycentricWeights(const SurfaceFile* from, const SurfaceFile* to, std::vector<std::map<int, float> >& weights, const float* currentRoi);
         void compactWeights(const std::vector<std::map<int, float> >& weights);
     public:
-        SurfaceResamplingHelper() { }
+        SurfaceResamplingHelper() { m_numCurrentNodes = 0; }
+        ///uses the cache directory, if set, to avoid recomputing weights for the same spheres, areas and roi
         SurfaceResamplingHelper(const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
                                 const float* currentAreas = NULL, const float* newAreas = NULL, const float* currentRoi = NULL);
+        ///load weights previously saved with writeToFile
+        explicit SurfaceResamplingHelper(const AString& weightFile);
+        ///save the weights to a file that can be memory mapped later
+        void writeToFile(const AString& weightFile) const;
+        int getNumberOfCurrentNodes() const { return m_numCurrentNodes; }
+        int getNumberOfNewNodes() const { return (m_weights.size() == 0 ? 0 : (int)m_weights.size() - 1); }
+        ///directory to keep computed weights in, empty to disable caching
+        static void setCacheDirectory(const AString& directory) { s_cacheDirectory = directory; }
+        static const AString& getCacheDirectory() { return s_cacheDirectory; }
         ///resample real-valued data by means of weights
         void resampleNormal(const float* input, float* output, const float& invalidVal = 0.0f) const;
+        ///resample many columns of real-valued data at once, input and output are interleaved (node-major, numColumns values per node)
+        void resampleNormalMultiple(const float* input, float* output, const int64_t& numColumns, const float& invalidVal = 0.0f) const;
+        ///resample every column of a metric with resampleNormalMultiple, in blocks of columns - only sets the data, not names or palettes
+        void resampleMetric(const MetricFile* metricIn, MetricFile* metricOut, const float& invalidVal = 0.0f) const;
         ///resample 3D coordinate data by means of weights
         void resample3DCoord(const float* input, float* output) const;
         ///resample label-like data according to which value gets the largest weight sum
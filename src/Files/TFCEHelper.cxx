@@ -0,0 +1,345 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "TFCEHelper.h"
+
+#include "CaretAssert.h"
+#include "CaretException.h"
+#include "CaretOMP.h"
+#include "TopologyHelper.h"
+#include "Vector3D.h"
+#include "VolumeSpace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+using namespace caret;
+using namespace std;
+
+/*
+ * This is the same algorithm as the original per-cluster member list implementation, which walked down from the peak values
+ * and, on every merge, rewrote the accumulated value and membership of every member of the smaller clusters.  Instead, clusters
+ * are nodes in a merge tree: membership lookup uses union-find with path compression, and the correction that used to be added to
+ * every member of a merged cluster is stored once on the tree node.  At the end, each element adds the corrections along its path
+ * to the root, in the same order the member rewrites used to happen, so the output is bit-identical to the old implementation.
+ */
+
+TFCEHelper::TFCEHelper(const TopologyHelper* topoHelp, const float* areaData, const float* roiData)
+{
+    CaretAssert(areaData != NULL);
+    int numNodes = topoHelp->getNumberOfNodes();
+    m_numTotal = numNodes;
+    vector<int> fullToCompact(numNodes, -1);
+    int numUsed = 0;
+    for (int i = 0; i < numNodes; ++i)
+    {
+        if (roiData == NULL || roiData[i] > 0.0f)
+        {
+            fullToCompact[i] = numUsed;
+            m_elemIndex.push_back(i);
+            m_elemSize.push_back(areaData[i]);
+            ++numUsed;
+        }
+    }
+    m_uniformSize = 0.0f;
+    m_neighStart.resize(numUsed + 1);
+    m_neighStart[0] = 0;
+    for (int i = 0; i < numUsed; ++i)
+    {
+        const vector<int32_t>& neighbors = topoHelp->getNodeNeighbors((int32_t)m_elemIndex[i]);
+        int numNeigh = (int)neighbors.size();
+        for (int j = 0; j < numNeigh; ++j)
+        {
+            int neighCompact = fullToCompact[neighbors[j]];
+            if (neighCompact != -1) m_neighbors.push_back(neighCompact);
+        }
+        m_neighStart[i + 1] = (int64_t)m_neighbors.size();
+    }
+}
+
+TFCEHelper::TFCEHelper(const VolumeSpace& volSpace, const float* roiData)
+{
+    const int64_t* dims = volSpace.getDims();
+    m_numTotal = dims[0] * dims[1] * dims[2];
+    if (m_numTotal > numeric_limits<int>::max()) throw CaretException("volume is too large for TFCE");
+    Vector3D ivec, jvec, kvec, origin;//compute the volume of a voxel so different resolutions have comparable values - as if it matters, but hey
+    volSpace.getSpacingVectors(ivec, jvec, kvec, origin);//who knows, maybe we'll have distortion correction in volume someday
+    m_uniformSize = abs(ivec.dot(jvec.cross(kvec)));
+    vector<int> fullToCompact(m_numTotal, -1);
+    int numUsed = 0;
+    for (int64_t i = 0; i < dims[0]; ++i)//NOTE: the old implementation pushed voxels to the heap in this order, keep it so that ties break the same way
+    {
+        for (int64_t j = 0; j < dims[1]; ++j)
+        {
+            for (int64_t k = 0; k < dims[2]; ++k)
+            {
+                int64_t index = volSpace.getIndex(i, j, k);
+                if (roiData == NULL || roiData[index] > 0.0f)
+                {
+                    fullToCompact[index] = numUsed;
+                    m_elemIndex.push_back(index);
+                    ++numUsed;
+                }
+            }
+        }
+    }
+    const int STENCIL_SIZE = 18;
+    const int64_t stencil[STENCIL_SIZE] = { 0, 0, -1,
+                                            0, -1, 0,
+                                            -1, 0, 0,
+                                            1, 0, 0,
+                                            0, 1, 0,
+                                            0, 0, 1 };
+    m_neighStart.resize(numUsed + 1);
+    m_neighStart[0] = 0;
+    m_neighbors.reserve(numUsed * 6);
+    for (int i = 0; i < numUsed; ++i)
+    {
+        int64_t index = m_elemIndex[i];
+        int64_t ijk[3] = { index % dims[0], (index / dims[0]) % dims[1], index / (dims[0] * dims[1]) };
+        for (int s = 0; s < STENCIL_SIZE; s += 3)
+        {
+            int64_t neighIJK[3] = { ijk[0] + stencil[s], ijk[1] + stencil[s + 1], ijk[2] + stencil[s + 2] };
+            if (volSpace.indexValid(neighIJK))
+            {
+                int neighCompact = fullToCompact[volSpace.getIndex(neighIJK)];
+                if (neighCompact != -1) m_neighbors.push_back(neighCompact);
+            }
+        }
+        m_neighStart[i + 1] = (int64_t)m_neighbors.size();
+    }
+}
+
+void TFCEHelper::computeAccum(const float* data, double* accumOut, const float& param_e, const float& param_h, Workspace& work) const
+{
+    int numUsed = (int)m_elemIndex.size();
+    work.m_accum.assign(numUsed, 0.0);
+    work.m_joinNode.assign(numUsed, -1);
+    tfcePass(data, false, param_e, param_h, work);
+    tfcePass(data, true, param_e, param_h, work);//negatives and positives don't overlap, so reuse the accum array - NOTE: output is still positive
+    for (int64_t i = 0; i < m_numTotal; ++i)
+    {
+        accumOut[i] = 0.0;
+    }
+    for (int i = 0; i < numUsed; ++i)
+    {
+        accumOut[m_elemIndex[i]] = work.m_accum[i];
+    }
+}
+
+void TFCEHelper::computeColumns(const vector<const float*>& dataColumns, const vector<float*>& outColumns, const float& param_e, const float& param_h) const
+{
+    CaretAssert(dataColumns.size() == outColumns.size());
+    int numCols = (int)dataColumns.size();
+#pragma omp CARET_PAR
+    {
+        Workspace myWork;
+        vector<double> accum(m_numTotal);
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int col = 0; col < numCols; ++col)
+        {
+            const float* data = dataColumns[col];
+            float* outData = outColumns[col];
+            computeAccum(data, accum.data(), param_e, param_h, myWork);
+            for (int64_t i = 0; i < m_numTotal; ++i)
+            {
+                if (data[i] < 0.0f)
+                {
+                    outData[i] = (float)-accum[i];
+                } else {
+                    outData[i] = (float)accum[i];
+                }
+            }
+        }
+    }
+}
+
+int TFCEHelper::findRoot(vector<Workspace::ClusterNode>& nodes, int node)
+{
+    int root = node;
+    while (nodes[root].ufParent != -1) root = nodes[root].ufParent;
+    while (nodes[node].ufParent != -1)
+    {
+        int next = nodes[node].ufParent;
+        if (next != root) nodes[node].ufParent = root;
+        node = next;
+    }
+    return root;
+}
+
+void TFCEHelper::updateNode(Workspace::ClusterNode& node, const float& bottomVal, const double& bottomPow, const float& param_e, const double& integrated_h)
+{
+    if (bottomVal != node.lastVal)//skip computing if there is no difference
+    {
+        CaretAssert(bottomVal < node.lastVal);
+        double newSlice = pow(node.totalSize, (double)param_e) * (node.lastPow - bottomPow) / integrated_h;//integral(x^h) = (x^(h + 1))/(h + 1) + C
+        node.accumVal += newSlice;
+        node.lastVal = bottomVal;//computing in double precision, with float for inputs, puts the smallest difference between values far greater than the instability of the computation
+        node.lastPow = bottomPow;
+    }
+}
+
+void TFCEHelper::tfcePass(const float* data, const bool& negate, const float& param_e, const float& param_h, Workspace& work) const
+{
+    int numUsed = (int)m_elemIndex.size();
+    vector<Workspace::ClusterNode>& nodes = work.m_nodes;
+    nodes.clear();
+    work.m_freeIds.clear();//min heap of reusable cluster ids
+    work.m_nextId = 0;
+    work.m_heap.clear();
+    for (int i = 0; i < numUsed; ++i)
+    {
+        float value = data[m_elemIndex[i]];
+        if (negate)
+        {
+            if (value < 0.0f) work.m_heap.push(i, -value);
+        } else {
+            if (value > 0.0f) work.m_heap.push(i, value);
+        }
+    }
+    double integrated_h = param_h + 1.0f;
+    float powVal = 0.0f;
+    double valPow = pow((double)powVal, integrated_h);//every cluster at the current level needs the same power, so only compute it when the value changes
+    double* accumData = work.m_accum.data();
+    int* joinNode = work.m_joinNode.data();
+    vector<int>& touching = work.m_touching;
+    while (!work.m_heap.isEmpty())
+    {
+        float value;
+        int elem = work.m_heap.pop(&value);
+        if (value != powVal)
+        {
+            powVal = value;
+            valPow = pow((double)value, integrated_h);
+        }
+        double elemSize = (m_elemSize.empty() ? m_uniformSize : m_elemSize[elem]);//old implementation added the float size to a double total
+        touching.clear();
+        for (int64_t n = m_neighStart[elem]; n < m_neighStart[elem + 1]; ++n)
+        {
+            int neighJoin = joinNode[m_neighbors[n]];
+            if (neighJoin != -1)
+            {
+                int root = findRoot(nodes, neighJoin);
+                if (find(touching.begin(), touching.end(), root) == touching.end())
+                {//keep sorted by alloc id, that was the iteration order of the old implementation
+                    vector<int>::iterator insertAt = touching.begin();
+                    while (insertAt != touching.end() && nodes[*insertAt].allocId < nodes[root].allocId) ++insertAt;
+                    touching.insert(insertAt, root);
+                }
+            }
+        }
+        int numTouching = (int)touching.size();
+        switch (numTouching)
+        {
+            case 0://make new cluster
+            {
+                Workspace::ClusterNode newNode;
+                newNode.accumVal = 0.0;
+                newNode.totalSize = 0.0;
+                newNode.totalSize += elemSize;
+                newNode.lastVal = value;
+                newNode.lastPow = valPow;
+                newNode.ufParent = -1;
+                newNode.treeParent = -1;
+                newNode.memberCount = 1;
+                if (work.m_freeIds.empty())
+                {
+                    newNode.allocId = work.m_nextId;
+                    ++work.m_nextId;
+                } else {
+                    pop_heap(work.m_freeIds.begin(), work.m_freeIds.end(), greater<int>());
+                    newNode.allocId = work.m_freeIds.back();
+                    work.m_freeIds.pop_back();
+                }
+                joinNode[elem] = (int)nodes.size();
+                nodes.push_back(newNode);
+                break;
+            }
+            case 1://add to cluster
+            {
+                Workspace::ClusterNode& thisNode = nodes[touching[0]];
+                updateNode(thisNode, value, valPow, param_e, integrated_h);
+                ++thisNode.memberCount;
+                thisNode.totalSize += elemSize;
+                joinNode[elem] = touching[0];
+                accumData[elem] -= thisNode.accumVal;//the accum value is the current amount less than the peak value that the edge of the cluster has (this element is on the edge)
+                break;//so, when the cluster merges or reaches 0, the correction or final accum value gets added to it, and we get the correct value in the end
+            }
+            default://merge all touching clusters
+            {
+                int mergedIndex = -1, biggestSize = 0;//find the biggest cluster (in number of members) and use as merged cluster, to keep merge tree paths short
+                for (int i = 0; i < numTouching; ++i)
+                {
+                    if (nodes[touching[i]].memberCount > biggestSize)
+                    {
+                        mergedIndex = touching[i];
+                        biggestSize = nodes[touching[i]].memberCount;
+                    }
+                }
+                CaretAssertVectorIndex(nodes, mergedIndex);
+                Workspace::ClusterNode& mergedNode = nodes[mergedIndex];
+                updateNode(mergedNode, value, valPow, param_e, integrated_h);//recalculate to align cluster bottoms
+                for (int i = 0; i < numTouching; ++i)
+                {
+                    if (touching[i] != mergedIndex)
+                    {
+                        Workspace::ClusterNode& thisNode = nodes[touching[i]];
+                        updateNode(thisNode, value, valPow, param_e, integrated_h);//recalculate to align cluster bottoms
+                        thisNode.accumVal = thisNode.accumVal - mergedNode.accumVal;//now the correction for all members, applied at the end instead of rewriting every member now
+                        thisNode.ufParent = mergedIndex;
+                        thisNode.treeParent = mergedIndex;
+                        mergedNode.memberCount += thisNode.memberCount;
+                        mergedNode.totalSize += thisNode.totalSize;
+                        work.m_freeIds.push_back(thisNode.allocId);
+                        push_heap(work.m_freeIds.begin(), work.m_freeIds.end(), greater<int>());
+                    }
+                }
+                ++mergedNode.memberCount;
+                mergedNode.totalSize += elemSize;
+                joinNode[elem] = mergedIndex;
+                accumData[elem] -= mergedNode.accumVal;//the element they merge on must not get the peak value of the cluster, obviously, so again, record its difference from peak
+                break;
+            }
+        }
+    }
+    int numNodes = (int)nodes.size();//final cleanup
+    double zeroPow = pow(0.0, integrated_h);
+    for (int i = 0; i < numNodes; ++i)
+    {
+        if (nodes[i].treeParent == -1)
+        {
+            updateNode(nodes[i], 0.0f, zeroPow, param_e, integrated_h);//update to include the to-zero slice
+        }
+    }
+    for (int i = 0; i < numUsed; ++i)
+    {
+        int node = joinNode[i];
+        if (node == -1) continue;
+        while (nodes[node].treeParent != -1)
+        {
+            accumData[i] += nodes[node].accumVal;//apply corrections in the order the merges happened
+            node = nodes[node].treeParent;
+        }
+        accumData[i] += nodes[node].accumVal;//their stored data contains the offset between the cluster peak and their correct value
+        joinNode[i] = -1;//reset for the next pass
+    }
+}
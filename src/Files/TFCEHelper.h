@@ -0,0 +1,91 @@
+#ifndef __TFCE_HELPER_H__
+#define __TFCE_HELPER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretHeap.h"
+
+#include "stdint.h"
+#include <cstddef>
+#include <vector>
+
+namespace caret
+{
+
+    class TopologyHelper;
+    class VolumeSpace;
+
+    ///threshold-free cluster enhancement over a fixed neighbor graph, built once and reused for any number of columns
+    class TFCEHelper
+    {
+    public:
+        ///per-thread scratch memory, reuse it across columns to avoid reallocation
+        class Workspace
+        {
+            struct ClusterNode
+            {
+                double accumVal;//while alive, the integral so far - after merging, the correction to apply to members
+                double totalSize;
+                double lastPow;//lastVal to the power of H + 1
+                float lastVal;
+                int ufParent;//path compressed, for finding the live cluster of an element
+                int treeParent;//merge history, never compressed, the order of corrections matters for exact results
+                int memberCount;
+                int allocId;//emulates reusing the lowest free cluster index, for tie breaking between equal size clusters
+            };
+            std::vector<ClusterNode> m_nodes;
+            std::vector<int> m_joinNode, m_touching, m_freeIds;
+            std::vector<double> m_accum;
+            CaretSimpleMaxHeap<int, float> m_heap;
+            int m_nextId;
+            friend class TFCEHelper;
+        };
+
+        ///surface neighbors, with per-vertex areas, vertices outside the roi are excluded from all clusters
+        TFCEHelper(const TopologyHelper* topoHelp, const float* areaData, const float* roiData = NULL);
+
+        ///face neighbors in a volume, with voxel volume taken from the spacing, voxels outside the roi are excluded from all clusters
+        TFCEHelper(const VolumeSpace& volSpace, const float* roiData = NULL);
+
+        int64_t getNumberOfElements() const { return m_numTotal; }
+
+        ///compute the enhancement of positive and negative values (both give positive results), zero for elements not in the roi
+        void computeAccum(const float* data, double* accumOut, const float& param_e, const float& param_h, Workspace& work) const;
+
+        ///compute many columns in parallel, one workspace per thread - output takes the sign of the input, elements not in the roi get 0
+        void computeColumns(const std::vector<const float*>& dataColumns, const std::vector<float*>& outColumns, const float& param_e, const float& param_h) const;
+    private:
+        int64_t m_numTotal;
+        std::vector<int64_t> m_elemIndex;//compact element to full index, in the order the elements get pushed to the heap
+        std::vector<int64_t> m_neighStart;//compressed row neighbor lists, in compact indices
+        std::vector<int> m_neighbors;
+        std::vector<float> m_elemSize;//empty when uniform
+        float m_uniformSize;
+
+        void setupCompact(const std::vector<int>& fullToCompact);
+        void tfcePass(const float* data, const bool& negate, const float& param_e, const float& param_h, Workspace& work) const;
+        static int findRoot(std::vector<Workspace::ClusterNode>& nodes, int node);
+        static void updateNode(Workspace::ClusterNode& node, const float& bottomVal, const double& bottomPow, const float& param_e, const double& integrated_h);
+    };
+
+}
+
+#endif //__TFCE_HELPER_H__
@@ -26,6 +26,7 @@
 
 #include "CaretHttpManager.h"
 #include "CaretLogger.h"
+#include "CaretProfiler.h"
 #include "CaretTemporaryFile.h"
 #include "ChartDataCartesian.h"
 #include "ChartDataSource.h"
@@ -197,6 +198,7 @@ VolumeFile::clear()
 
 void VolumeFile::readFile(const AString& filename)
 {
+    CaretProfileScope myProfile("volume read");
     ElapsedTimer timer;
     timer.start();
     
@@ -294,6 +296,7 @@ void VolumeFile::readFile(const AString& filename)
 void 
 VolumeFile::writeFile(const AString& filename)
 {
+    CaretProfileScope myProfile("volume write");
     if (!(filename.endsWith(".nii.gz") || filename.endsWith(".nii")))
     {
         CaretLogWarning("volume file '" + filename + "' should be saved ending in .nii.gz or .nii, other formats are not supported");
@@ -798,6 +801,7 @@ VolumeFile::setMapName(const int32_t mapIndex,
 const GiftiMetaData* VolumeFile::getMapMetaData(const int32_t mapIndex) const
 {
     CaretAssertVectorIndex(m_brickAttributes, mapIndex);
+    CaretMutexLocker locked(&m_metadataMutex);//lazily created, and batch mode can read a shared volume from several commands
     if (m_brickAttributes[mapIndex].m_metadata == NULL)
     {
         m_brickAttributes[mapIndex].m_metadata.grabNew(new GiftiMetaData());
@@ -1671,6 +1675,7 @@ VolumeFile::getDataRangeFromAllMaps(float& dataRangeMinimumOut,
         return false;
     }
     
+    CaretMutexLocker locked(&m_dataRangeMutex);//batch mode shares input volumes between commands running at the same time
     /*
      * If valid, no need to update
      */
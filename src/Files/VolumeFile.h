@@ -112,6 +112,8 @@ namespace caret {
         
         mutable float m_dataRangeMaximum;
         
+        mutable CaretMutex m_dataRangeMutex, m_metadataMutex;
+        
         /** Holds class and name hierarchy used for display selection */
         mutable CaretPointer<GroupAndNameHierarchyModel> m_classNameHierarchy;
         
@@ -0,0 +1,127 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "WeightCacheFile.h"
+
+#include "CaretAssert.h"
+#include "SurfaceFile.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QFile>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int32_t WEIGHT_CACHE_BYTE_ORDER = 0x01020304;
+    QAtomicInt s_tempCounter(0);//batch lines in one process can write the same cache file at once
+}
+
+void WeightCacheFile::initHeader(Header& header, const char magic[8], const int32_t& version, const AString& key)
+{
+    CaretAssert(sizeof(Header) == 56);//format-specific fields that follow are 8-byte aligned
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.magic, magic, 8);
+    header.version = version;
+    header.byteOrder = WEIGHT_CACHE_BYTE_ORDER;
+    QByteArray keyBytes = key.toLatin1();
+    memcpy(header.key, keyBytes.constData(), min(keyBytes.size(), 40));
+}
+
+bool WeightCacheFile::checkHeader(const Header& header, const char magic[8], const int32_t& version, const AString& expectedKey, const AString& fileType, AString& errorOut)
+{
+    if (memcmp(header.magic, magic, 8) != 0)
+    {
+        errorOut = "not a " + fileType + " file";
+        return false;
+    }
+    if (header.byteOrder != WEIGHT_CACHE_BYTE_ORDER)
+    {
+        errorOut = "file was written on a machine with different byte order";
+        return false;
+    }
+    if (header.version != version)
+    {
+        errorOut = "unsupported " + fileType + " file version " + AString::number(header.version);
+        return false;
+    }
+    if (expectedKey != "")
+    {
+        QByteArray keyBytes = expectedKey.toLatin1();
+        if (keyBytes.size() != 40 || memcmp(header.key, keyBytes.constData(), 40) != 0)
+        {
+            errorOut = "file was computed from different inputs";
+            return false;
+        }
+    }
+    return true;
+}
+
+void WeightCacheFile::addHashData(QCryptographicHash& hasher, const void* data, const int64_t& numBytes)
+{
+    const char* charData = (const char*)data;
+    const int64_t CHUNK = 1 << 30;
+    for (int64_t pos = 0; pos < numBytes; pos += CHUNK)
+    {
+        hasher.addData(charData + pos, (int)min(CHUNK, numBytes - pos));
+    }
+}
+
+void WeightCacheFile::addHashSurface(QCryptographicHash& hasher, const SurfaceFile* surface)
+{
+    int64_t numNodes = surface->getNumberOfNodes(), numTiles = surface->getNumberOfTriangles();
+    addHashData(hasher, &numNodes, sizeof(int64_t));
+    addHashData(hasher, &numTiles, sizeof(int64_t));
+    addHashData(hasher, surface->getCoordinateData(), numNodes * 3 * sizeof(float));
+    if (numTiles > 0) addHashData(hasher, surface->getTriangle(0), numTiles * 3 * sizeof(int32_t));
+}
+
+AString WeightCacheFile::getKey(QCryptographicHash& hasher)
+{
+    return QString(hasher.result().toHex());
+}
+
+AString WeightCacheFile::getCacheFileName(const AString& directory, const AString& key, const AString& extension)
+{
+    return directory + "/" + key + extension;
+}
+
+AString WeightCacheFile::getTempFileName(const AString& cacheFile)
+{
+    return cacheFile + "." + AString::number(QCoreApplication::applicationPid()) + "." + AString::number(s_tempCounter.fetchAndAddOrdered(1)) + ".tmp";
+}
+
+bool WeightCacheFile::moveIntoPlace(const AString& tempFile, const AString& cacheFile)
+{
+    if (QFile::rename(tempFile, cacheFile)) return true;
+    if (QFile::exists(cacheFile))
+    {//rename doesn't overwrite - another process finished the same weights first, or left an unusable file, either way ours is good
+        QFile::remove(cacheFile);
+        if (QFile::rename(tempFile, cacheFile)) return true;
+    }
+    QFile::remove(tempFile);
+    return false;
+}
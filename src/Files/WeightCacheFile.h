@@ -0,0 +1,70 @@
+#ifndef __WEIGHT_CACHE_FILE_H__
+#define __WEIGHT_CACHE_FILE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+
+#include "stdint.h"
+
+class QCryptographicHash;
+
+namespace caret
+{
+    
+    class SurfaceFile;
+    
+    ///helpers shared by the on-disk weight caches (surface resampling, metric smoothing, ribbon mapping), so they all use the same header and naming scheme
+    ///cache files are named by the sha1 of the inputs, and written to a temporary name and renamed, so other processes never see a partial file
+    class WeightCacheFile
+    {
+        WeightCacheFile();
+    public:
+        ///start of every weight file, native byte order, followed by the fields of the particular format
+        struct Header
+        {
+            char magic[8];
+            int32_t version;
+            int32_t byteOrder;
+            char key[40];//sha1 of the inputs as hex, all zeros if not created from the cache
+        };
+        
+        ///zeroes the header and fills in the magic, version, byte order marker and key (which can be empty)
+        static void initHeader(Header& header, const char magic[8], const int32_t& version, const AString& key);
+        ///returns false and sets errorOut if the magic, byte order or version is wrong, or if expectedKey is not empty and doesn't match
+        static bool checkHeader(const Header& header, const char magic[8], const int32_t& version, const AString& expectedKey, const AString& fileType, AString& errorOut);
+        
+        ///add data of any size to a hash, QCryptographicHash::addData takes an int
+        static void addHashData(QCryptographicHash& hasher, const void* data, const int64_t& numBytes);
+        ///add the vertex and triangle counts, coordinates and topology
+        static void addHashSurface(QCryptographicHash& hasher, const SurfaceFile* surface);
+        static AString getKey(QCryptographicHash& hasher);
+        
+        static AString getCacheFileName(const AString& directory, const AString& key, const AString& extension);
+        ///unique per process and call, in the same directory so the rename doesn't cross filesystems
+        static AString getTempFileName(const AString& cacheFile);
+        ///rename tempFile to cacheFile, replacing cacheFile if another process got there first - on failure, tempFile is removed and false is returned
+        static bool moveIntoPlace(const AString& tempFile, const AString& cacheFile);
+    };
+    
+}
+
+#endif //__WEIGHT_CACHE_FILE_H__
@@ -29,6 +29,7 @@
 #include "ByteSwapping.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "DataCompressZLib.h"
 
 //#include "FileUtilities.h"
@@ -43,8 +44,400 @@
 #include "SystemUtilities.h"
 #include "XmlWriter.h"
 
+#include "zlib.h"
+
 using namespace caret;
 
+namespace {
+    /**
+     * Base64 decoding that skips whitespace and can stop and resume
+     * at any output length, so that the data can be decoded in
+     * blocks straight into its destination.
+     */
+    class Base64StreamDecoder {
+    public:
+        Base64StreamDecoder(const char* text,
+                            const int64_t textLength)
+        : m_input((const unsigned char*)text),
+          m_end((const unsigned char*)text + textLength),
+          m_carryCount(0),
+          m_carryStart(0),
+          m_paddingFound(false)
+        {
+        }
+        
+        /**
+         * Decode up to maxBytes into output.
+         * @return number of bytes decoded, less than maxBytes only at the end of the input
+         */
+        uint64_t decode(unsigned char* output,
+                        const uint64_t maxBytes)
+        {
+            unsigned char* optr = output;
+            unsigned char* const oend = output + maxBytes;
+            while ((m_carryStart < m_carryCount) && (optr < oend)) {
+                *optr++ = m_carry[m_carryStart++];
+            }
+            const int8_t* table = getDecodeTable();
+            /*
+             * Fast path for unbroken runs of 4 valid characters
+             */
+            while (( ! m_paddingFound)
+                   && ((m_end - m_input) >= 4)
+                   && ((oend - optr) >= 3)) {
+                const int8_t c0 = table[m_input[0]];
+                const int8_t c1 = table[m_input[1]];
+                const int8_t c2 = table[m_input[2]];
+                const int8_t c3 = table[m_input[3]];
+                if ((c0 | c1 | c2 | c3) < 0) {
+                    break;//whitespace, padding or invalid, use the careful path
+                }
+                optr[0] = (unsigned char)((c0 << 2) | (c1 >> 4));
+                optr[1] = (unsigned char)((c1 << 4) | (c2 >> 2));
+                optr[2] = (unsigned char)((c2 << 6) | c3);
+                optr += 3;
+                m_input += 4;
+            }
+            while (optr < oend) {
+                if (m_carryStart < m_carryCount) {
+                    *optr++ = m_carry[m_carryStart++];
+                    continue;
+                }
+                if ( ! decodeQuad()) {
+                    break;
+                }
+            }
+            return optr - output;
+        }
+        
+        /**
+         * @return true if all of the input has been decoded and delivered
+         */
+        bool isFinished()
+        {
+            if (m_carryStart < m_carryCount) {
+                return false;
+            }
+            skipWhitespace();
+            return (m_input >= m_end) || m_paddingFound;
+        }
+        
+    private:
+        enum {
+            CHAR_WHITESPACE = -1,
+            CHAR_PADDING = -2,
+            CHAR_INVALID = -3
+        };
+        
+        static const int8_t* getDecodeTable()
+        {
+            static const DecodeTable table;
+            return table.values;
+        }
+        
+        struct DecodeTable {
+            int8_t values[256];
+            DecodeTable() {
+                for (int i = 0; i < 256; i++) {
+                    values[i] = CHAR_INVALID;
+                }
+                for (int i = 0; i < 26; i++) {
+                    values['A' + i] = i;
+                    values['a' + i] = 26 + i;
+                }
+                for (int i = 0; i < 10; i++) {
+                    values['0' + i] = 52 + i;
+                }
+                values[(int)'+'] = 62;
+                values[(int)'/'] = 63;
+                values[(int)'='] = CHAR_PADDING;
+                values[(int)' '] = CHAR_WHITESPACE;
+                values[(int)'\t'] = CHAR_WHITESPACE;
+                values[(int)'\n'] = CHAR_WHITESPACE;
+                values[(int)'\r'] = CHAR_WHITESPACE;
+            }
+        };
+        
+        void skipWhitespace()
+        {
+            const int8_t* table = getDecodeTable();
+            while ((m_input < m_end)
+                   && (table[*m_input] == CHAR_WHITESPACE)) {
+                m_input++;
+            }
+        }
+        
+        /**
+         * Decode the next 4 characters (ignoring whitespace) into the carry buffer.
+         * @return false at the end of the data.
+         */
+        bool decodeQuad()
+        {
+            if (m_paddingFound) {
+                return false;
+            }
+            const int8_t* table = getDecodeTable();
+            int8_t quad[4];
+            int32_t numChars = 0;
+            int32_t numPadding = 0;
+            while (numChars < 4) {
+                skipWhitespace();
+                if (m_input >= m_end) {
+                    if (numChars == 0) {
+                        return false;
+                    }
+                    throw GiftiException("Base64 data ends in the middle of a group of 4 characters.");
+                }
+                const int8_t value = table[*m_input];
+                if (value == CHAR_INVALID) {
+                    throw GiftiException("Invalid character in Base64 data: code "
+                                         + AString::number((int32_t)*m_input));
+                }
+                if (value == CHAR_PADDING) {
+                    if (numChars < 2) {
+                        throw GiftiException("Misplaced padding in Base64 data.");
+                    }
+                    numPadding++;
+                    quad[numChars] = 0;
+                }
+                else {
+                    if (numPadding > 0) {
+                        throw GiftiException("Misplaced padding in Base64 data.");
+                    }
+                    quad[numChars] = value;
+                }
+                numChars++;
+                m_input++;
+            }
+            m_carry[0] = (unsigned char)((quad[0] << 2) | (quad[1] >> 4));
+            m_carry[1] = (unsigned char)((quad[1] << 4) | (quad[2] >> 2));
+            m_carry[2] = (unsigned char)((quad[2] << 6) | quad[3]);
+            m_carryCount = 3 - numPadding;
+            m_carryStart = 0;
+            if (numPadding > 0) {
+                m_paddingFound = true;
+            }
+            return true;
+        }
+        
+        const unsigned char* m_input;
+        const unsigned char* m_end;
+        unsigned char m_carry[3];
+        int32_t m_carryCount;
+        int32_t m_carryStart;
+        bool m_paddingFound;
+    };
+    
+    /**
+     * Decode Base64 text of zlib compressed data, and inflate it
+     * into the output, which must be exactly the size of the
+     * uncompressed data.
+     */
+    void inflateBase64(const char* text,
+                       const int64_t textLength,
+                       unsigned char* output,
+                       const uint64_t outputLength)
+    {
+        const uint64_t BLOCK_SIZE = 65536;
+        std::vector<unsigned char> block(BLOCK_SIZE);
+        Base64StreamDecoder decoder(text, textLength);
+        
+        z_stream stream;
+        stream.zalloc = Z_NULL;
+        stream.zfree  = Z_NULL;
+        stream.opaque = Z_NULL;
+        stream.next_in = Z_NULL;
+        stream.avail_in = 0;
+        if (inflateInit(&stream) != Z_OK) {
+            throw GiftiException("Unable to initialize zlib for decompression.");
+        }
+        
+        uint64_t totalOut = 0;
+        int result = Z_OK;
+        AString errorMessage;
+        while (result != Z_STREAM_END) {
+            if (stream.avail_in == 0) {
+                const uint64_t numDecoded = decoder.decode(&block[0],
+                                                           BLOCK_SIZE);
+                if (numDecoded == 0) {
+                    errorMessage = "Compressed data is truncated.";
+                    break;
+                }
+                stream.next_in = &block[0];
+                stream.avail_in = numDecoded;
+            }
+            const uint64_t remaining = outputLength - totalOut;
+            const uint64_t MAX_OUT = 1 << 30;//avail_out is only 32 bits
+            stream.next_out = output + totalOut;
+            stream.avail_out = std::min(remaining, MAX_OUT);
+            const uInt availBefore = stream.avail_out;
+            result = inflate(&stream, Z_NO_FLUSH);
+            totalOut += availBefore - stream.avail_out;
+            if ((result != Z_OK)
+                && (result != Z_STREAM_END)) {
+                errorMessage = "zlib error while decompressing data: " + AString::number(result);
+                break;
+            }
+            if ((result == Z_OK)
+                && (totalOut == outputLength)
+                && (stream.avail_in > 0)) {
+                errorMessage = "Compressed data is larger than the data array.";
+                break;
+            }
+        }
+        inflateEnd(&stream);
+        if (errorMessage.isEmpty()
+            && (totalOut != outputLength)) {
+            errorMessage = ("Uncompressed " + AString::number(totalOut) + " bytes but should be "
+                            + AString::number(outputLength) + " bytes.");
+        }
+        if (errorMessage.isEmpty()
+            && ( ! decoder.isFinished())) {
+            errorMessage = "Extra data found after compressed data.";
+        }
+        if ( ! errorMessage.isEmpty()) {
+            throw GiftiException("Decompression of Binary data failed.\n" + errorMessage);
+        }
+    }
+    
+    /**
+     * Compress data into the zlib format.  Large data is split into
+     * blocks that are deflated in parallel, each primed with the end
+     * of the previous block as its dictionary, and joined into one
+     * ordinary zlib stream (the same approach as pigz).
+     */
+    void deflateData(const unsigned char* input,
+                     const uint64_t inputLength,
+                     const int32_t compressionLevel,
+                     std::vector<unsigned char>& output)
+    {
+        const uint64_t BLOCK_SIZE = 1 << 20;
+        const int64_t numBlocks = (inputLength + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        int numThreads = 1;
+#ifdef CARET_OMP
+        if ( ! omp_in_parallel()) {//when called while encoding several arrays in parallel, the blocks can't get more threads
+            numThreads = omp_get_max_threads();
+        }
+#endif
+        if ((numBlocks < 2) || (numThreads < 2)) {
+            DataCompressZLib compressor;
+            compressor.setCompressionLevel(compressionLevel);
+            output.resize(compressor.getMaximumCompressionSpace(inputLength));
+            const uint64_t compressedLength = compressor.compressData(input,
+                                                                      inputLength,
+                                                                      &output[0],
+                                                                      output.size());
+            if (compressedLength == 0) {
+                throw GiftiException("zlib error while compressing data.");
+            }
+            output.resize(compressedLength);
+            return;
+        }
+        
+        std::vector<std::vector<unsigned char> > blockOutput(numBlocks);
+        std::vector<uLong> blockAdler(numBlocks);
+        bool blockFailed = false;
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int64_t iBlock = 0; iBlock < numBlocks; iBlock++) {
+            const uint64_t blockStart = iBlock * BLOCK_SIZE;
+            const uint64_t blockLength = std::min(BLOCK_SIZE, inputLength - blockStart);
+            const bool lastBlock = (iBlock == (numBlocks - 1));
+            blockAdler[iBlock] = adler32(adler32(0L, Z_NULL, 0), input + blockStart, blockLength);
+            
+            z_stream stream;
+            stream.zalloc = Z_NULL;
+            stream.zfree  = Z_NULL;
+            stream.opaque = Z_NULL;
+            if (deflateInit2(&stream, compressionLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {//raw deflate, no zlib header
+                blockFailed = true;
+                continue;
+            }
+            if (iBlock > 0) {
+                const uint64_t dictionaryLength = std::min((uint64_t)32768, blockStart);
+                deflateSetDictionary(&stream, input + blockStart - dictionaryLength, dictionaryLength);
+            }
+            std::vector<unsigned char>& blockData = blockOutput[iBlock];
+            blockData.resize(deflateBound(&stream, blockLength) + 16);//room for the sync flush marker
+            stream.next_in = (Bytef*)(input + blockStart);
+            stream.avail_in = blockLength;
+            stream.next_out = &blockData[0];
+            stream.avail_out = blockData.size();
+            const int result = deflate(&stream, (lastBlock ? Z_FINISH : Z_SYNC_FLUSH));//sync flush ends the block on a byte boundary
+            if ((lastBlock && (result != Z_STREAM_END))
+                || (( ! lastBlock) && ((result != Z_OK) || (stream.avail_in != 0) || (stream.avail_out == 0)))) {
+                blockFailed = true;
+            }
+            blockData.resize(stream.total_out);
+            deflateEnd(&stream);
+        }
+        if (blockFailed) {
+            throw GiftiException("zlib error while compressing data.");
+        }
+        
+        uint64_t totalLength = 2 + 4;
+        uLong adler = adler32(0L, Z_NULL, 0);
+        for (int64_t iBlock = 0; iBlock < numBlocks; iBlock++) {
+            totalLength += blockOutput[iBlock].size();
+            const uint64_t blockLength = std::min(BLOCK_SIZE, inputLength - iBlock * BLOCK_SIZE);
+            adler = adler32_combine(adler, blockAdler[iBlock], blockLength);
+        }
+        output.resize(totalLength);
+        
+        /*
+         * zlib header, with the same compression level flags that zlib would use
+         */
+        int levelFlags = 3;
+        if (compressionLevel < 2) {
+            levelFlags = 0;
+        }
+        else if (compressionLevel < 6) {
+            levelFlags = 1;
+        }
+        else if (compressionLevel == 6) {
+            levelFlags = 2;
+        }
+        uint32_t header = ((Z_DEFLATED + ((15 - 8) << 4)) << 8) | (levelFlags << 6);
+        header += 31 - (header % 31);
+        output[0] = (unsigned char)(header >> 8);
+        output[1] = (unsigned char)(header & 0xff);
+        uint64_t offset = 2;
+        for (int64_t iBlock = 0; iBlock < numBlocks; iBlock++) {
+            std::copy(blockOutput[iBlock].begin(), blockOutput[iBlock].end(), output.begin() + offset);
+            offset += blockOutput[iBlock].size();
+            std::vector<unsigned char>().swap(blockOutput[iBlock]);
+        }
+        output[offset++] = (unsigned char)((adler >> 24) & 0xff);//adler32 checksum is big endian
+        output[offset++] = (unsigned char)((adler >> 16) & 0xff);
+        output[offset++] = (unsigned char)((adler >> 8) & 0xff);
+        output[offset++] = (unsigned char)(adler & 0xff);
+        CaretAssert(offset == totalLength);
+    }
+    
+    /**
+     * Base64 encode data, in parallel for large data.
+     */
+    void encodeBase64(const unsigned char* input,
+                      const uint64_t inputLength,
+                      std::vector<char>& output)
+    {
+        output.resize(((inputLength + 2) / 3) * 4);
+        if (inputLength == 0) {
+            return;
+        }
+        const uint64_t BLOCK_SIZE = 3 << 18;//must be a multiple of 3 so that only the last block has padding
+        const int64_t numBlocks = (inputLength + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        unsigned char* outputPointer = (unsigned char*)&output[0];
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int64_t iBlock = 0; iBlock < numBlocks; iBlock++) {
+            const uint64_t blockStart = iBlock * BLOCK_SIZE;
+            const uint64_t blockLength = std::min(BLOCK_SIZE, inputLength - blockStart);
+            Base64::encode(input + blockStart,
+                           blockLength,
+                           outputPointer + (blockStart / 3) * 4);
+        }
+    }
+}
+
 /**
  * constructor.
  */
@@ -577,9 +970,12 @@ GiftiDataArray::transferLabelIndices(const std::map<int32_t,int32_t>& indexConve
 /**
  * read a GIFTI data array from text.
  * Data array should already be initialized and allocated.
+ * Binary encodings are decoded straight into the array's storage,
+ * without intermediate copies of the text or the compressed data.
  */
 void 
-GiftiDataArray::readFromText(const AString text,
+GiftiDataArray::readFromText(const char* text,
+                             const int64_t textLength,
                              const GiftiEndianEnum::Enum dataEndianForReading,
                              const GiftiArrayIndexingOrderEnum::Enum arraySubscriptingOrderForReading,
                              const NiftiDataTypeEnum::Enum dataTypeForReading,
@@ -613,7 +1009,7 @@ GiftiDataArray::readFromText(const AString text,
       switch (encoding) {
           case GiftiEncodingEnum::ASCII:
             {
-                std::istringstream stream(text.toStdString());
+                std::istringstream stream(std::string(text, textLength));
                 
                switch (dataType) {
                   case NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32:
@@ -652,14 +1048,11 @@ GiftiDataArray::readFromText(const AString text,
             break;
           case GiftiEncodingEnum::BASE64_BINARY:
             {
-               //
-               // Decode the Base64 data using VTK's algorithm
-               //
-               const uint64_t numDecoded =
-                     Base64::decode((const unsigned char*)(text.toStdString().c_str()),
-                                                data.size(),
-                                                &data[0]);
-               if (numDecoded != data.size()) {
+               Base64StreamDecoder decoder(text, textLength);
+               const uint64_t numDecoded = decoder.decode((unsigned char*)&data[0],
+                                                          data.size());
+               if ((numDecoded != data.size())
+                   || ( ! decoder.isFinished())) {
                   std::ostringstream str;
                   str << "Decoding of Base64 Binary data failed.\n"
                    << "Decoded " << AString::number(numDecoded).toStdString() << " bytes but should be "
@@ -678,44 +1071,13 @@ GiftiDataArray::readFromText(const AString text,
           case GiftiEncodingEnum::GZIP_BASE64_BINARY:
             {
                //
-               // Decode the Base64 data using VTK's algorithm
-               //
-               unsigned char* dataBuffer = new unsigned char[data.size()];
-               //const char* textChars = text.toLatin1().constData();
-               const uint64_t numDecoded =
-                     Base64::decode((unsigned char*)text.toStdString().c_str(),
-                                                data.size(),
-                                                dataBuffer);
-               if (numDecoded == 0) {
-                   std::ostringstream str;
-                   str << "Decoding of GZip Base64 Binary data failed."
-                   << "Decoded " << AString::number(numDecoded).toStdString() << " bytes but should be "
-                   << AString::number(static_cast<int>(data.size())).toStdString() << " bytes.";
-                   throw GiftiException(AString::fromStdString(str.str()));
-               }
-               
-               
-               //
-               // Uncompress the data using VTK's algorithm
-               // 
-                DataCompressZLib compressor;
-                const uint64_t uncompressedDataLength = 
-                                   compressor.uncompressData(dataBuffer,
-                                                          numDecoded,
-                                                          (unsigned char*)&data[0],
-                                                          data.size());
-               if (uncompressedDataLength != data.size()) {
-                  std::ostringstream str;
-                  str << "Decompression of Binary data failed.\n"
-                   << "Uncompressed " << AString::number(uncompressedDataLength).toStdString() << " bytes but should be "
-                   << AString::number(static_cast<uint64_t>(data.size())).toStdString() << " bytes.";
-                  throw GiftiException(AString::fromStdString(str.str()));
-               }
-               
-               //
-               // Free memory
+               // Decode the Base64 data a block at a time, and inflate
+               // each block straight into the data array
                //
-               delete[] dataBuffer;
+               inflateBase64(text,
+                             textLength,
+                             (unsigned char*)&data[0],
+                             data.size());
                
                //
                // Is byte swapping needed ? 
@@ -1000,6 +1362,48 @@ GiftiDataArray::convertArrayIndexingOrder()
     }
 }
 
+/**
+ * Encode the data as Base64 text for writing, compressing it first
+ * for GZIP_BASE64_BINARY.  Large data is compressed and encoded in
+ * parallel, and this does not modify the data array, so several
+ * data arrays may also be encoded at the same time.
+ * @param encodingForWriting
+ *    BASE64_BINARY or GZIP_BASE64_BINARY.
+ * @param compressionLevel
+ *    zlib compression level, 0 to 9.
+ * @param encodedDataOut
+ *    Output containing the encoded text.
+ */
+void
+GiftiDataArray::encodeDataForWriting(const GiftiEncodingEnum::Enum encodingForWriting,
+                                     const int32_t compressionLevel,
+                                     std::vector<char>& encodedDataOut) const
+{
+    const unsigned char* dataPointer = (data.empty() ? NULL : &data[0]);
+    switch (encodingForWriting) {
+        case GiftiEncodingEnum::BASE64_BINARY:
+            encodeBase64(dataPointer,
+                         data.size(),
+                         encodedDataOut);
+            break;
+        case GiftiEncodingEnum::GZIP_BASE64_BINARY:
+        {
+            std::vector<unsigned char> compressedData;
+            deflateData(dataPointer,
+                        data.size(),
+                        compressionLevel,
+                        compressedData);
+            encodeBase64((compressedData.empty() ? NULL : &compressedData[0]),
+                         compressedData.size(),
+                         encodedDataOut);
+        }
+            break;
+        default:
+            throw GiftiException("Encoding " + GiftiEncodingEnum::toName(encodingForWriting)
+                                 + " is not a Base64 encoding.");
+    }
+}
+
 /**
  * write the data as XML.
  * @param stream
@@ -1008,11 +1412,18 @@ GiftiDataArray::convertArrayIndexingOrder()
  *    Stream for external binary file.
  * @param encodingForWriting
  *    GIFTI encoding used when writing the data.
+ * @param compressionLevel
+ *    zlib compression level for GZIP_BASE64_BINARY, 0 to 9.
+ * @param encodedDataForWriting
+ *    Data already encoded with encodeDataForWriting() for BASE64_BINARY
+ *    or GZIP_BASE64_BINARY, or NULL to encode the data here.
  */
 void 
 GiftiDataArray::writeAsXML(std::ostream& stream, 
                            std::ostream* externalBinaryOutputStream,
-                           GiftiEncodingEnum::Enum encodingForWriting) 
+                           GiftiEncodingEnum::Enum encodingForWriting,
+                           const int32_t compressionLevel,
+                           const std::vector<char>* encodedDataForWriting) 
                                                
 {
     this->encoding = encodingForWriting;
@@ -1169,72 +1580,26 @@ GiftiDataArray::writeAsXML(std::ostream& stream,
          }
          break;
        case GiftiEncodingEnum::BASE64_BINARY:
-         {
-            //
-            // Encode the data with VTK's Base64 algorithm
-            //
-            const uint64_t bufferLength = static_cast<uint64_t>(data.size() * 1.5);
-            char* buffer = new char[bufferLength];
-            const uint64_t compressedLength =
-               Base64::encode(&data[0],
-                                          data.size(),
-                                          (unsigned char*)buffer);
-            if (compressedLength >= bufferLength) {
-               throw GiftiException(
-                     "Base64 encoding buffer length ("
-                     + AString::number(bufferLength)
-                     + ") is too small but needs to be "
-                                    + AString::number(compressedLength));
-            }
-            buffer[compressedLength] = '\0';
-            
-            //
-            // Write the data  MUST BE NO space around data
-            //
-            xmlWriter.writeElementNoSpace(GiftiXmlElements::TAG_DATA, buffer);
-            
-            //
-            // Free memory
-            //
-            delete[] buffer;
-         }
-         break;
        case GiftiEncodingEnum::GZIP_BASE64_BINARY:
          {
-            //
-            // Compress the data with VTK's ZLIB algorithm
-            //
-             DataCompressZLib compressor;
-             unsigned long compressedDataBufferLength = 
-                              compressor.getMaximumCompressionSpace(data.size());
-            unsigned char* compressedDataBuffer = new unsigned char[compressedDataBufferLength];
-            unsigned long compressedDataLength =
-                          compressor.compressData(&data[0], 
-                                               data.size(),
-                                               compressedDataBuffer,
-                                               compressedDataBufferLength);
-            
-            //
-            // Encode the data with VTK's Base64 algorithm
-            //
-            char* buffer = new char[static_cast<int64_t>(compressedDataLength * 1.5)];
-            const uint64_t compressedLength =
-               Base64::encode(compressedDataBuffer,
-                                          compressedDataLength,
-                                          (unsigned char*)buffer);
-            buffer[compressedLength] = '\0';
-            
              //
-             // Write the data  MUST BE NO space around data
+             // Use the data encoded by the caller (possibly encoded in
+             // parallel with other data arrays), otherwise encode it now
              //
-             xmlWriter.writeElementNoSpace(GiftiXmlElements::TAG_DATA, buffer);
+             std::vector<char> encodedData;
+             if (encodedDataForWriting == NULL) {
+                 encodeDataForWriting(encoding,
+                                      compressionLevel,
+                                      encodedData);
+                 encodedDataForWriting = &encodedData;
+             }
              
-            
-            //
-            // Free memory
-            //
-            delete[] buffer;
-            delete[] compressedDataBuffer;
+             //
+             // Write the data  MUST BE NO space around data
+             //
+             xmlWriter.writeElementNoSpace(GiftiXmlElements::TAG_DATA,
+                                           (encodedDataForWriting->empty() ? "" : &(*encodedDataForWriting)[0]),
+                                           encodedDataForWriting->size());
          }
          break;
        case GiftiEncodingEnum::EXTERNAL_FILE_BINARY:
@@ -112,8 +112,9 @@ namespace caret {
         // get data offset 
         //int64_t getDataOffset(const int64_t nodeNum, const int64_t componentNum) const;//TSC: implementation was wrong, commenting out for now
         
-        // read a data array from text
-        void readFromText(const AString text,
+        // read a data array from the raw (UTF-8) text of the Data element
+        void readFromText(const char* text,
+                          const int64_t textLength,
                           const GiftiEndianEnum::Enum dataEndianForReading,
                           const GiftiArrayIndexingOrderEnum::Enum arraySubscriptingOrderForReading,
                           const NiftiDataTypeEnum::Enum dataTypeForReading,
@@ -126,7 +127,14 @@ namespace caret {
         // write the data as XML
         void writeAsXML(std::ostream& stream, 
                         std::ostream* externalBinaryOutputStream,
-                        GiftiEncodingEnum::Enum encodingForWriting);
+                        GiftiEncodingEnum::Enum encodingForWriting,
+                        const int32_t compressionLevel,
+                        const std::vector<char>* encodedDataForWriting = NULL);
+        
+        // encode the data as Base64 text for writing, compressing it first for GZIP_BASE64_BINARY
+        void encodeDataForWriting(const GiftiEncodingEnum::Enum encodingForWriting,
+                                  const int32_t compressionLevel,
+                                  std::vector<char>& encodedDataOut) const;
         
         /// get endian
         GiftiEndianEnum::Enum getEndian() const { return endian; }
@@ -24,6 +24,7 @@
 
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretProfiler.h"
 #include "DataFileException.h"
 #include "FileInformation.h"
 #include "GiftiEncodingEnum.h"
@@ -840,6 +841,7 @@ GiftiFile::removeDataArray(const GiftiDataArray* arrayPointer)
 void
 GiftiFile::readFile(const AString& filename)
 {
+    CaretProfileScope myProfile("gifti read");//self time is mostly xml parsing, decoding has its own scope
     this->clear();
     this->setFileName(filename);
     
@@ -891,6 +893,7 @@ GiftiFile::readFile(const AString& filename)
 void 
 GiftiFile::writeFile(const AString& filename)
 {
+    CaretProfileScope myProfile("gifti write");
     try {
         this->setFileName(filename);
         
@@ -917,11 +920,9 @@ GiftiFile::writeFile(const AString& filename)
                               &this->labelTable);
         
         //
-        // Write the data arrays
+        // Write the data arrays, encoding them in parallel
         //
-        for (int i = 0; i < numberOfDataArrays; i++) {
-            giftiFileWriter.writeDataArray(this->getDataArray(i));
-        }
+        giftiFileWriter.writeDataArrays(this->dataArrays);
         
         //
         // Finish writing the file
@@ -1236,6 +1237,38 @@ GiftiFile::setEncodingForWriting(const GiftiEncodingEnum::Enum encoding)
     this->encodingForWriting = encoding;
 }
 
+/**
+ * Set the zlib compression level used when writing GZIP_BASE64_BINARY
+ * data arrays.  Lower levels are faster but make larger files.
+ * @param level
+ *    Compression level, 0 (no compression) to 9 (best compression).
+ */
+void
+GiftiFile::setCompressionLevelForWriting(const int32_t level)
+{
+    if ((level < 0) || (level > 9)) {
+        throw GiftiException("GIFTI compression level must be between 0 and 9, "
+                             + AString::number(level) + " is invalid.");
+    }
+    GiftiFile::compressionLevelForWriting = level;
+}
+
+/**
+ * Set the size at which data arrays are written to an external binary
+ * file, regardless of the encoding of the file.  Writing an external
+ * file is much faster for very large arrays, as the data is not encoded.
+ * @param numberOfBytes
+ *    Minimum size of a data array in bytes, zero to never use an external file.
+ */
+void
+GiftiFile::setExternalBinaryThresholdForWriting(const int64_t numberOfBytes)
+{
+    if (numberOfBytes < 0) {
+        throw GiftiException("GIFTI external binary threshold must not be negative.");
+    }
+    GiftiFile::externalBinaryThresholdForWriting = numberOfBytes;
+}
+
 
     
 /**
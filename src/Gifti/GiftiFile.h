@@ -191,6 +191,16 @@ class GiftiFile : public DataFile {
     
     void setEncodingForWriting(const GiftiEncodingEnum::Enum encoding);
     
+    /** @return The zlib compression level (0-9) used when writing GZIP_BASE64_BINARY data. */
+    static int32_t getCompressionLevelForWriting() { return compressionLevelForWriting; }
+    
+    static void setCompressionLevelForWriting(const int32_t level);
+    
+    /** @return Data arrays of at least this many bytes are written as EXTERNAL_FILE_BINARY, zero for never. */
+    static int64_t getExternalBinaryThresholdForWriting() { return externalBinaryThresholdForWriting; }
+    
+    static void setExternalBinaryThresholdForWriting(const int64_t numberOfBytes);
+    
     virtual void clearModified();
     
     virtual bool isModified() const;
@@ -242,6 +252,12 @@ class GiftiFile : public DataFile {
     /** The default encoding for writing a GIFTI file. */
     static GiftiEncodingEnum::Enum defaultEncodingForWriting;
     
+    /** The zlib compression level for writing compressed data arrays. */
+    static int32_t compressionLevelForWriting;
+    
+    /** Size at which data arrays are written to an external binary file, zero for never. */
+    static int64_t externalBinaryThresholdForWriting;
+    
       /*!!!! be sure to update copyHelperGiftiFile if new member added !!!!*/
    
    // 
@@ -251,6 +267,8 @@ class GiftiFile : public DataFile {
 
 #ifdef __GIFTI_FILE_MAIN__
     GiftiEncodingEnum::Enum GiftiFile::defaultEncodingForWriting = GiftiEncodingEnum::GZIP_BASE64_BINARY;
+    int32_t GiftiFile::compressionLevelForWriting = 6;
+    int64_t GiftiFile::externalBinaryThresholdForWriting = 0;
 #endif // __GIFTI_FILE_MAIN__
     
 
@@ -21,6 +21,8 @@
 #include <sstream>
 
 #include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "CaretProfiler.h"
 #include "FileInformation.h"
 #include "GiftiEndianEnum.h"
 #include "GiftiLabel.h"
@@ -50,6 +52,7 @@ GiftiFileSaxReader::GiftiFileSaxReader(GiftiFile* giftiFileIn)
     this->labelTableSaxReader = NULL;
     this->metaDataSaxReader = NULL;
     this->dataArrayDataHasBeenRead = false;
+    this->pendingArraysTextSize = 0;
 }
 
 /**
@@ -214,6 +217,7 @@ GiftiFileSaxReader::startElement(const AString& namespaceURI,
    stateStack.push(previousState);
    
    elementText = "";
+   arrayDataText.clear();
 }
 
 /**
@@ -508,6 +512,10 @@ GiftiFileSaxReader::createDataArray(const XmlAttributes& attributes)
 
 /**
  * process the array data into numbers.
+ *
+ * Decoding of encoded text is deferred so that the data arrays
+ * can be decoded in parallel, at the end of the document or
+ * when the text waiting to be decoded becomes large.
  */
 void 
 GiftiFileSaxReader::processArrayData()
@@ -515,19 +523,97 @@ GiftiFileSaxReader::processArrayData()
     this->dataArrayDataHasBeenRead = true;
 
     CaretAssert(dataArray);
-    try {
-        dataArray->readFromText(elementText,
-                                this->endianForReadingArrayData,
-                                arraySubscriptingOrderForReadingArrayData,
-                                dataTypeForReadingArrayData,
-                                dimensionsForReadingArrayData,
-                                encodingForReadingArrayData,
-                                externalFileNameForReadingData,
-                                externalFileOffsetForReadingData,
-                                this->giftiFile->getReadMetaDataOnlyFlag());
+    const bool metaDataOnly = this->giftiFile->getReadMetaDataOnlyFlag();
+    if (metaDataOnly
+        || (encodingForReadingArrayData == GiftiEncodingEnum::EXTERNAL_FILE_BINARY)) {
+        try {
+            dataArray->readFromText(arrayDataText.data(),
+                                    arrayDataText.size(),
+                                    this->endianForReadingArrayData,
+                                    arraySubscriptingOrderForReadingArrayData,
+                                    dataTypeForReadingArrayData,
+                                    dimensionsForReadingArrayData,
+                                    encodingForReadingArrayData,
+                                    externalFileNameForReadingData,
+                                    externalFileOffsetForReadingData,
+                                    metaDataOnly);
+        }
+        catch (const GiftiException& e) {
+            throw XmlSaxParserException(e.whatString());
+        }
+        arrayDataText.clear();
+        return;
     }
-    catch (const GiftiException& e) {
-        throw XmlSaxParserException(e.whatString());
+    
+    pendingArrays.push_back(PendingArray());
+    PendingArray& pending = pendingArrays.back();
+    pending.dataArray = dataArray;
+    pending.text.swap(arrayDataText);
+    pending.endian = endianForReadingArrayData;
+    pending.arraySubscriptingOrder = arraySubscriptingOrderForReadingArrayData;
+    pending.dataType = dataTypeForReadingArrayData;
+    pending.dimensions = dimensionsForReadingArrayData;
+    pending.encoding = encodingForReadingArrayData;
+    pending.externalFileName = externalFileNameForReadingData;
+    pending.externalFileOffset = externalFileOffsetForReadingData;
+    pendingArraysTextSize += pending.text.size();
+    
+    const int64_t MAX_PENDING_TEXT_SIZE = ((int64_t)256) * 1024 * 1024;
+    if (pendingArraysTextSize > MAX_PENDING_TEXT_SIZE) {
+        decodePendingArrays();
+    }
+}
+
+/**
+ * decode the text of the pending data arrays, in parallel.
+ */
+void
+GiftiFileSaxReader::decodePendingArrays()
+{
+    const int64_t numPending = static_cast<int64_t>(pendingArrays.size());
+    if (numPending == 0) return;
+    CaretProfileScope myProfile("gifti decode arrays");
+    CaretProfiler::addCounter("openmp regions");
+    CaretProfiler::addCounter("gifti text bytes decoded", pendingArraysTextSize);
+    AString decodeErrorMessage;
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t i = 0; i < numPending; i++) {
+        PendingArray& pending = pendingArrays[i];
+        try {
+            pending.dataArray->readFromText(pending.text.data(),
+                                            pending.text.size(),
+                                            pending.endian,
+                                            pending.arraySubscriptingOrder,
+                                            pending.dataType,
+                                            pending.dimensions,
+                                            pending.encoding,
+                                            pending.externalFileName,
+                                            pending.externalFileOffset,
+                                            false);
+        }
+        catch (const GiftiException& e) {
+#pragma omp critical
+            {
+                if (decodeErrorMessage.isEmpty()) {
+                    decodeErrorMessage = e.whatString();
+                }
+            }
+        }
+        catch (...) {
+#pragma omp critical
+            {
+                if (decodeErrorMessage.isEmpty()) {
+                    decodeErrorMessage = "Unknown error while decoding data array.";
+                }
+            }
+        }
+        std::string().swap(pending.text);
+    }
+    pendingArrays.clear();
+    pendingArraysTextSize = 0;
+    
+    if ( ! decodeErrorMessage.isEmpty()) {
+        throw XmlSaxParserException(decodeErrorMessage);
     }
 }
 
@@ -543,6 +629,9 @@ GiftiFileSaxReader::characters(const char* ch)
     else if (this->labelTableSaxReader != NULL) {
         this->labelTableSaxReader->characters(ch);
     }
+    else if (this->state == STATE_DATA_ARRAY_DATA) {
+        arrayDataText += ch;
+    }
     else {
         elementText += ch;
     }
@@ -594,5 +683,6 @@ GiftiFileSaxReader::startDocument()
 void 
 GiftiFileSaxReader::endDocument()
 {
+    decodePendingArrays();
 }
 
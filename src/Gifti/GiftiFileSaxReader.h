@@ -23,6 +23,8 @@
 /*LICENSE_END*/
 
 #include <stack>
+#include <string>
+#include <vector>
 #include <AString.h>
 #include <stdint.h>
 
@@ -100,9 +102,25 @@ namespace caret {
             STATE_DATA_ARRAY_MATRIX_DATA
         };
         
+        /// text of a data array, waiting to be decoded
+        struct PendingArray {
+            GiftiDataArray* dataArray;
+            std::string text;
+            GiftiEndianEnum::Enum endian;
+            GiftiArrayIndexingOrderEnum::Enum arraySubscriptingOrder;
+            NiftiDataTypeEnum::Enum dataType;
+            std::vector<int64_t> dimensions;
+            GiftiEncodingEnum::Enum encoding;
+            AString externalFileName;
+            int64_t externalFileOffset;
+        };
+        
         // process the array data into numbers
         void processArrayData();
         
+        // decode the text of the pending data arrays, in parallel
+        void decodePendingArrays();
+        
         // create a data array
         void createDataArray(const XmlAttributes& attributes);
         
@@ -121,6 +139,15 @@ namespace caret {
         /// element text
         AString elementText;
         
+        /// raw text of the DataArray Data element, kept out of AString to avoid conversions
+        std::string arrayDataText;
+        
+        /// data arrays that have been parsed but not yet decoded
+        std::vector<PendingArray> pendingArrays;
+        
+        /// total size of the text of the pending data arrays
+        int64_t pendingArraysTextSize;
+        
         /// GIFTI data array being read
         CaretPointer<GiftiDataArray> dataArray;
         
@@ -26,6 +26,7 @@
 #include "GiftiFileWriter.h"
 #undef __GIFTI_FILE_WRITER_DECLARE__
 
+#include "CaretOMP.h"
 #include "FileInformation.h"
 #include "GiftiDataArray.h"
 #include "GiftiXmlElements.h"
@@ -61,6 +62,8 @@ GiftiFileWriter::GiftiFileWriter(const AString& filename,
     this->maximumExternalFileSize = 1024 * 1024 * 1024;
     this->filename = filename;
     this->encoding = encoding;
+    this->compressionLevel = GiftiFile::getCompressionLevelForWriting();
+    this->externalBinaryThreshold = GiftiFile::getExternalBinaryThresholdForWriting();
     this->xmlWriter = NULL;
     this->dataArraysWrittenCounter = 0;
 }
@@ -179,6 +182,115 @@ GiftiFileWriter::start(const int numberOfDataArrays,
  */
 void 
 GiftiFileWriter::writeDataArray(GiftiDataArray* gda)
+{
+    this->writeDataArrayHelper(gda, NULL);
+}
+
+/**
+ * Write GIFTI Data Arrays.  When there are enough of them, the
+ * data arrays are encoded in parallel (in batches to limit the
+ * memory used) before being written in order.
+ *
+ * @param dataArrays - The data arrays.
+ * @throws GiftiException - If an error occurs.
+ */
+void
+GiftiFileWriter::writeDataArrays(const std::vector<GiftiDataArray*>& dataArrays)
+{
+    int numThreads = 1;
+#ifdef CARET_OMP
+    numThreads = omp_get_max_threads();
+#endif
+    const int64_t MAX_BATCH_BYTES = ((int64_t)512) * 1024 * 1024;
+    const int64_t numArrays = static_cast<int64_t>(dataArrays.size());
+    int64_t batchStart = 0;
+    while (batchStart < numArrays) {
+        int64_t batchEnd = batchStart;
+        int64_t batchBytes = 0;
+        while ((batchEnd < numArrays)
+               && ((batchEnd == batchStart)
+                   || ((batchBytes + dataArrays[batchEnd]->getDataSizeInBytes()) <= MAX_BATCH_BYTES))) {
+            batchBytes += dataArrays[batchEnd]->getDataSizeInBytes();
+            batchEnd++;
+        }
+        
+        /*
+         * With fewer arrays than threads, each array is compressed
+         * and encoded in parallel by itself while it is written
+         */
+        std::vector<int64_t> arraysToEncode;
+        for (int64_t i = batchStart; i < batchEnd; i++) {
+            const GiftiEncodingEnum::Enum arrayEncoding = this->getEncodingForDataArray(dataArrays[i]);
+            if ((arrayEncoding == GiftiEncodingEnum::BASE64_BINARY)
+                || (arrayEncoding == GiftiEncodingEnum::GZIP_BASE64_BINARY)) {
+                arraysToEncode.push_back(i);
+            }
+        }
+        std::vector<std::vector<char> > encodedData(batchEnd - batchStart);
+        std::vector<char> isEncoded(batchEnd - batchStart, 0);
+        const int64_t numToEncode = static_cast<int64_t>(arraysToEncode.size());
+        if ((numThreads > 1)
+            && (numToEncode >= numThreads)) {
+            AString errorMessage;
+#pragma omp CARET_PARFOR schedule(dynamic)
+            for (int64_t i = 0; i < numToEncode; i++) {
+                const int64_t batchIndex = arraysToEncode[i] - batchStart;
+                try {
+                    dataArrays[arraysToEncode[i]]->encodeDataForWriting(this->encoding,
+                                                                        this->compressionLevel,
+                                                                        encodedData[batchIndex]);
+                    isEncoded[batchIndex] = 1;
+                }
+                catch (const GiftiException& e) {
+#pragma omp critical
+                    {
+                        errorMessage = e.whatString();
+                    }
+                }
+            }
+            if ( ! errorMessage.isEmpty()) {
+                this->closeFiles();
+                throw GiftiException(errorMessage);
+            }
+        }
+        
+        for (int64_t i = batchStart; i < batchEnd; i++) {
+            const int64_t batchIndex = i - batchStart;
+            this->writeDataArrayHelper(dataArrays[i],
+                                       (isEncoded[batchIndex] ? &encodedData[batchIndex] : NULL));
+            std::vector<char>().swap(encodedData[batchIndex]);
+        }
+        batchStart = batchEnd;
+    }
+}
+
+/**
+ * Get the encoding for writing a data array, very large arrays
+ * are written to the external file when the threshold is set.
+ *
+ * @param gda - The data array.
+ * @return The encoding for the data array.
+ */
+GiftiEncodingEnum::Enum
+GiftiFileWriter::getEncodingForDataArray(const GiftiDataArray* gda) const
+{
+    if ((this->externalBinaryThreshold > 0)
+        && (gda->getDataSizeInBytes() >= this->externalBinaryThreshold)) {
+        return GiftiEncodingEnum::EXTERNAL_FILE_BINARY;
+    }
+    return this->encoding;
+}
+
+/**
+ * Write a GIFTI Data Array.
+ *
+ * @param gda - The data array.
+ * @param encodedData - The data already encoded for Base64 encodings, or NULL.
+ * @throws GiftiException - If an error occurs.
+ */
+void 
+GiftiFileWriter::writeDataArrayHelper(GiftiDataArray* gda,
+                                      const std::vector<char>* encodedData)
 {
     this->verifyOpened();
     
@@ -189,17 +301,12 @@ GiftiFileWriter::writeDataArray(GiftiDataArray* gda)
                                  "passed to start.");
     }
     try {
-        //         //
-        //         // Get the external file name.
-        //         //
-        //         String externalFileName = "";
-        //         if (this.encoding == GiftiEncoding.EXTERNAL_FILE_BINARY) {
-        //            externalFileName = this.getExternalFileNameForWriting();
-        //         }
+        const GiftiEncodingEnum::Enum arrayEncoding = this->getEncodingForDataArray(gda);
+        
         //
         // Writing to an external binary data file?
         //
-        if (this->encoding == GiftiEncodingEnum::EXTERNAL_FILE_BINARY) {
+        if (arrayEncoding == GiftiEncodingEnum::EXTERNAL_FILE_BINARY) {
             if (this->externalFileOutputStream == NULL) {
                 char* name = this->getExternalFileNameForWriting().toCharArray();
                 this->externalFileOutputStream = new std::ofstream(name,std::fstream::binary);
@@ -215,13 +322,18 @@ GiftiFileWriter::writeDataArray(GiftiDataArray* gda)
             gda->setExternalFileInformation(myInfo.getFileName(),
                                             fileOffset);
         }
+        else {
+            gda->setExternalFileInformation("", 0);
+        }
         
         //
         // Write data array
         //
         gda->writeAsXML(*this->xmlFileOutputStream, 
                         this->externalFileOutputStream,
-                        this->encoding);
+                        arrayEncoding,
+                        this->compressionLevel,
+                        encodedData);
         
         //
         // Increment counter of data arrays written
@@ -289,6 +401,29 @@ GiftiFileWriter::setMaximumExternalFileSize(const long size)
     this->maximumExternalFileSize = size;
 }
 
+/**
+ * Get the zlib compression level.
+ *
+ * @return The compression level.
+ */
+int32_t
+GiftiFileWriter::getCompressionLevel() const
+{
+    return this->compressionLevel;
+}
+
+/**
+ * Set the zlib compression level used for GZIP_BASE64_BINARY,
+ * defaults to GiftiFile::getCompressionLevelForWriting().
+ *
+ * @param compressionLevel 0 (fastest) to 9 (smallest).
+ */
+void
+GiftiFileWriter::setCompressionLevel(const int32_t compressionLevel)
+{
+    this->compressionLevel = compressionLevel;
+}
+
 /**
  * Close any open files.
  */
@@ -22,6 +22,7 @@
 /*LICENSE_END*/
 
 #include <fstream>
+#include <vector>
 
 #include "CaretObject.h"
 #include "GiftiFile.h"
@@ -47,12 +48,18 @@ namespace caret {
                    GiftiLabelTable* labelTable);
         void writeDataArray(GiftiDataArray* gda);
         
+        void writeDataArrays(const std::vector<GiftiDataArray*>& dataArrays);
+        
         void finish();
         
         long getMaximumExternalFileSize() const;
         
         void setMaximumExternalFileSize(const long size);
         
+        int32_t getCompressionLevel() const;
+        
+        void setCompressionLevel(const int32_t compressionLevel);
+        
     private:
         GiftiFileWriter(const GiftiFileWriter&);
 
@@ -62,6 +69,11 @@ namespace caret {
         
         void verifyOpened();
         
+        GiftiEncodingEnum::Enum getEncodingForDataArray(const GiftiDataArray* gda) const;
+        
+        void writeDataArrayHelper(GiftiDataArray* gda,
+                                  const std::vector<char>* encodedData);
+        
         void removeExternalFiles();
         
         AString getExternalFileNamePrefix() const;
@@ -90,6 +102,12 @@ namespace caret {
         /** encoding of file. */
         GiftiEncodingEnum::Enum encoding;
         
+        /** zlib compression level for GZIP_BASE64_BINARY. */
+        int32_t compressionLevel;
+        
+        /** Data arrays at least this size are written to the external file, zero for never. */
+        int64_t externalBinaryThreshold;
+        
         /** The XML writer. */
         XmlWriter* xmlWriter;
         
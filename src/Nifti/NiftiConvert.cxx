@@ -0,0 +1,200 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "NiftiConvert.h"
+#include "NiftiConvertKernels.h"
+
+#include "nifti1.h"
+
+#ifdef CARET_DOTFCN
+extern "C"
+{//cpuinfo.h doesn't have c++ guards
+#include "cpuinfo.h"
+}
+#endif
+
+using namespace caret;
+
+void caret::niftiConvertNaiveKernels(NiftiConvertKernelTable& table)
+{
+    table.readUInt8 = niftiConvertNaiveRead<uint8_t>;
+    table.readInt8 = niftiConvertNaiveRead<int8_t>;
+    table.readUInt16 = niftiConvertNaiveRead<uint16_t>;
+    table.readInt16 = niftiConvertNaiveRead<int16_t>;
+    table.readUInt32 = niftiConvertNaiveRead<uint32_t>;
+    table.readInt32 = niftiConvertNaiveRead<int32_t>;
+    table.readFloat32 = niftiConvertNaiveRead<float>;
+    table.readFloat64 = niftiConvertNaiveRead<double>;
+    table.writeUInt8 = niftiConvertNaiveWrite<uint8_t>;
+    table.writeInt8 = niftiConvertNaiveWrite<int8_t>;
+    table.writeUInt16 = niftiConvertNaiveWrite<uint16_t>;
+    table.writeInt16 = niftiConvertNaiveWrite<int16_t>;
+    table.writeUInt32 = niftiConvertNaiveWrite<uint32_t>;
+    table.writeInt32 = niftiConvertNaiveWrite<int32_t>;
+    table.writeFloat32 = niftiConvertNaiveWrite<float>;
+    table.writeFloat64 = niftiConvertNaiveWrite<double>;
+}
+
+namespace
+{
+    NiftiConvert::Impl g_convertImpl = NiftiConvert::NAIVE;
+    
+    NiftiConvertKernelTable selectKernels(const NiftiConvert::Impl& impl)
+    {
+        NiftiConvertKernelTable ret;
+        niftiConvertNaiveKernels(ret);
+        g_convertImpl = NiftiConvert::NAIVE;
+#ifdef CARET_DOTFCN
+        if (hasAVX() && hasAVX2() && impl >= NiftiConvert::AVX2)
+        {
+            niftiConvertAVX2Kernels(ret);
+            g_convertImpl = NiftiConvert::AVX2;
+        } else if (hasSSE2() && impl >= NiftiConvert::SSE2) {
+            niftiConvertSSE2Kernels(ret);
+            g_convertImpl = NiftiConvert::SSE2;
+        }
+#endif
+        return ret;
+    }
+    
+    //select during static initialization, so that concurrent readers never see a partially filled table
+    NiftiConvertKernelTable g_convertKernels = selectKernels(NiftiConvert::AUTO);
+    
+    NiftiReadKernel getReadKernel(const int16_t& datatype)
+    {
+        switch (datatype)
+        {
+            case NIFTI_TYPE_UINT8:
+            case NIFTI_TYPE_RGB24://handled by components
+                return g_convertKernels.readUInt8;
+            case NIFTI_TYPE_INT8:
+                return g_convertKernels.readInt8;
+            case NIFTI_TYPE_UINT16:
+                return g_convertKernels.readUInt16;
+            case NIFTI_TYPE_INT16:
+                return g_convertKernels.readInt16;
+            case NIFTI_TYPE_UINT32:
+                return g_convertKernels.readUInt32;
+            case NIFTI_TYPE_INT32:
+                return g_convertKernels.readInt32;
+            case NIFTI_TYPE_FLOAT32:
+            case NIFTI_TYPE_COMPLEX64://components
+                return g_convertKernels.readFloat32;
+            case NIFTI_TYPE_FLOAT64:
+            case NIFTI_TYPE_COMPLEX128:
+                return g_convertKernels.readFloat64;
+            default://64-bit integers and long double don't fit in double exactly, leave them to the generic templates
+                return NULL;
+        }
+    }
+    
+    NiftiWriteKernel getWriteKernel(const int16_t& datatype)
+    {
+        switch (datatype)
+        {
+            case NIFTI_TYPE_UINT8:
+            case NIFTI_TYPE_RGB24:
+                return g_convertKernels.writeUInt8;
+            case NIFTI_TYPE_INT8:
+                return g_convertKernels.writeInt8;
+            case NIFTI_TYPE_UINT16:
+                return g_convertKernels.writeUInt16;
+            case NIFTI_TYPE_INT16:
+                return g_convertKernels.writeInt16;
+            case NIFTI_TYPE_UINT32:
+                return g_convertKernels.writeUInt32;
+            case NIFTI_TYPE_INT32:
+                return g_convertKernels.writeInt32;
+            case NIFTI_TYPE_FLOAT32:
+            case NIFTI_TYPE_COMPLEX64:
+                return g_convertKernels.writeFloat32;
+            case NIFTI_TYPE_FLOAT64:
+            case NIFTI_TYPE_COMPLEX128:
+                return g_convertKernels.writeFloat64;
+            default:
+                return NULL;
+        }
+    }
+    
+    NiftiConvertParams makeParams(const bool& swap, const bool& doScale, const double& mult, const double& offset)
+    {
+        NiftiConvertParams ret;
+        ret.swap = swap;
+        ret.doScale = doScale;
+        ret.mult = mult;
+        ret.offset = offset;
+        return ret;
+    }
+}
+
+NiftiConvert::Impl NiftiConvert::setImpl(const Impl& impl)
+{//not thread-safe, only meant for testing and benchmarking
+    g_convertKernels = selectKernels(impl);
+    return g_convertImpl;
+}
+
+NiftiConvert::Impl NiftiConvert::getImpl()
+{
+    return g_convertImpl;
+}
+
+const char* NiftiConvert::getImplName(const Impl& impl)
+{
+    switch (impl)
+    {
+        case NAIVE:
+            return "NAIVE";
+        case SSE2:
+            return "SSE2";
+        case AVX2:
+            return "AVX2";
+        case AUTO:
+            return "AUTO";
+    }
+    return "";
+}
+
+bool NiftiConvert::hasReadKernel(const int16_t& datatype)
+{
+    return getReadKernel(datatype) != NULL;
+}
+
+bool NiftiConvert::hasWriteKernel(const int16_t& datatype)
+{
+    return getWriteKernel(datatype) != NULL;
+}
+
+bool NiftiConvert::readToFloat(float* out, const char* in, const int16_t& datatype, const int64_t& count,
+                               const bool& swap, const bool& doScale, const double& mult, const double& offset)
+{
+    NiftiReadKernel kernel = getReadKernel(datatype);
+    if (kernel == NULL) return false;
+    if (count > 0) kernel(out, in, count, makeParams(swap, doScale, mult, offset));
+    return true;
+}
+
+bool NiftiConvert::writeFromFloat(char* out, const float* in, const int16_t& datatype, const int64_t& count,
+                                  const bool& swap, const bool& doScale, const double& mult, const double& offset)
+{
+    NiftiWriteKernel kernel = getWriteKernel(datatype);
+    if (kernel == NULL) return false;
+    if (count > 0) kernel(out, in, count, makeParams(swap, doScale, mult, offset));
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef __NIFTI_CONVERT_H__
+#define __NIFTI_CONVERT_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <stdint.h>
+
+namespace caret
+{
+    
+    ///fused byteswap + type conversion + scaling between nifti on-disk datatypes and float, with SIMD versions selected at runtime
+    class NiftiConvert
+    {
+        NiftiConvert();
+    public:
+        enum Impl
+        {
+            NAIVE = 1,//plain c++, computes scaling in double
+            SSE2 = 2,
+            AVX2 = 3,
+            AUTO = 100//best supported
+        };
+        //if the requested implementation isn't supported, selects the next best one, and returns which was selected
+        static Impl setImpl(const Impl& impl);
+        static Impl getImpl();
+        static const char* getImplName(const Impl& impl);
+        
+        static bool hasReadKernel(const int16_t& datatype);
+        static bool hasWriteKernel(const int16_t& datatype);
+        
+        //input is in the file's byte order if swap is true, and can be unaligned
+        //does out = offset + mult * in when doScale is true, same as scl_slope and scl_inter
+        //returns false without doing anything if there is no kernel for the datatype, so the caller can use the generic templates instead
+        static bool readToFloat(float* out, const char* in, const int16_t& datatype, const int64_t& count,
+                                const bool& swap, const bool& doScale, const double& mult, const double& offset);
+        
+        //inverse of the read scaling, and integer types are rounded to nearest and clamped to the range of the type
+        static bool writeFromFloat(char* out, const float* in, const int16_t& datatype, const int64_t& count,
+                                   const bool& swap, const bool& doScale, const double& mult, const double& offset);
+    };
+    
+}
+
+#endif //__NIFTI_CONVERT_H__
@@ -0,0 +1,322 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//this file is compiled with -mavx2, only call these kernels after checking the cpu supports it
+
+#include "NiftiConvertKernels.h"
+
+#ifdef CARET_DOTFCN
+
+#include <immintrin.h>
+
+using namespace caret;
+
+namespace
+{
+    //byte shuffles stay within 128-bit lanes, which is all a byteswap needs
+    inline __m128i swap16(const __m128i& in)
+    {
+        return _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+    }
+    
+    inline __m256i swap32(const __m256i& in)
+    {
+        return _mm256_shuffle_epi8(in, _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                         3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+    }
+    
+    inline __m256i swap64(const __m256i& in)
+    {
+        return _mm256_shuffle_epi8(in, _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                                         7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+    }
+    
+    inline __m128 scaleToFloat(const __m256d& in, const __m256d& mult, const __m256d& offset)
+    {//same order of operations as the naive kernel, and no FMA, so results are identical
+        return _mm256_cvtpd_ps(_mm256_add_pd(offset, _mm256_mul_pd(mult, in)));
+    }
+    
+    inline void storeFloats(float* out, const __m128& low, const __m128& high)
+    {
+        _mm256_storeu_ps(out, _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1));
+    }
+    
+    inline void storeInt32AsFloat(float* out, const __m256i& in, const NiftiConvertParams& params, const __m256d& mult, const __m256d& offset)
+    {
+        if (params.doScale)
+        {
+            storeFloats(out, scaleToFloat(_mm256_cvtepi32_pd(_mm256_castsi256_si128(in)), mult, offset),
+                             scaleToFloat(_mm256_cvtepi32_pd(_mm256_extracti128_si256(in, 1)), mult, offset));
+        } else {
+            _mm256_storeu_ps(out, _mm256_cvtepi32_ps(in));
+        }
+    }
+    
+    void readUInt8(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            storeInt32AsFloat(out + i, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + i))), params, mult, offset);
+        }
+        niftiConvertNaiveRead<uint8_t>(out + i, in + i, count - i, params);
+    }
+    
+    void readInt8(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            storeInt32AsFloat(out + i, _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(in + i))), params, mult, offset);
+        }
+        niftiConvertNaiveRead<int8_t>(out + i, in + i, count - i, params);
+    }
+    
+    void readUInt16(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i shorts = _mm_loadu_si128((const __m128i*)(in + i * 2));
+            if (params.swap) shorts = swap16(shorts);
+            storeInt32AsFloat(out + i, _mm256_cvtepu16_epi32(shorts), params, mult, offset);
+        }
+        niftiConvertNaiveRead<uint16_t>(out + i, in + i * 2, count - i, params);
+    }
+    
+    void readInt16(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i shorts = _mm_loadu_si128((const __m128i*)(in + i * 2));
+            if (params.swap) shorts = swap16(shorts);
+            storeInt32AsFloat(out + i, _mm256_cvtepi16_epi32(shorts), params, mult, offset);
+        }
+        niftiConvertNaiveRead<int16_t>(out + i, in + i * 2, count - i, params);
+    }
+    
+    void readUInt32(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {//no unsigned conversion instructions until avx512, so split off the top bit, which double handles exactly
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        const __m256i topBit = _mm256_set1_epi32((int)0x80000000u);
+        const __m256d topValue = _mm256_set1_pd(2147483648.0);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i ints = _mm256_loadu_si256((const __m256i*)(in + i * 4));
+            if (params.swap) ints = swap32(ints);
+            __m256i isBig = _mm256_srai_epi32(ints, 31);
+            __m256i lowBits = _mm256_andnot_si256(topBit, ints);
+            __m256d low = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(lowBits)),
+                                        _mm256_and_pd(_mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(isBig))), topValue));
+            __m256d high = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(lowBits, 1)),
+                                         _mm256_and_pd(_mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_extracti128_si256(isBig, 1))), topValue));
+            if (params.doScale)
+            {
+                storeFloats(out + i, scaleToFloat(low, mult, offset), scaleToFloat(high, mult, offset));
+            } else {
+                storeFloats(out + i, _mm256_cvtpd_ps(low), _mm256_cvtpd_ps(high));//rounding once from the exact double, same as the naive cast
+            }
+        }
+        niftiConvertNaiveRead<uint32_t>(out + i, in + i * 4, count - i, params);
+    }
+    
+    void readInt32(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i ints = _mm256_loadu_si256((const __m256i*)(in + i * 4));
+            if (params.swap) ints = swap32(ints);
+            storeInt32AsFloat(out + i, ints, params, mult, offset);
+        }
+        niftiConvertNaiveRead<int32_t>(out + i, in + i * 4, count - i, params);
+    }
+    
+    void readFloat32(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i raw = _mm256_loadu_si256((const __m256i*)(in + i * 4));
+            if (params.swap) raw = swap32(raw);
+            __m256 floats = _mm256_castsi256_ps(raw);
+            if (params.doScale)
+            {
+                storeFloats(out + i, scaleToFloat(_mm256_cvtps_pd(_mm256_castps256_ps128(floats)), mult, offset),
+                                     scaleToFloat(_mm256_cvtps_pd(_mm256_extractf128_ps(floats, 1)), mult, offset));
+            } else {
+                _mm256_storeu_ps(out + i, floats);
+            }
+        }
+        niftiConvertNaiveRead<float>(out + i, in + i * 4, count - i, params);
+    }
+    
+    void readFloat64(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i raw1 = _mm256_loadu_si256((const __m256i*)(in + i * 8)), raw2 = _mm256_loadu_si256((const __m256i*)(in + i * 8 + 32));
+            if (params.swap)
+            {
+                raw1 = swap64(raw1);
+                raw2 = swap64(raw2);
+            }
+            __m256d low = _mm256_castsi256_pd(raw1), high = _mm256_castsi256_pd(raw2);
+            if (params.doScale)
+            {
+                storeFloats(out + i, scaleToFloat(low, mult, offset), scaleToFloat(high, mult, offset));
+            } else {
+                storeFloats(out + i, _mm256_cvtpd_ps(low), _mm256_cvtpd_ps(high));
+            }
+        }
+        niftiConvertNaiveRead<double>(out + i, in + i * 8, count - i, params);
+    }
+    
+    inline __m256d unscaleDouble(const __m256d& in, const NiftiConvertParams& params, const __m256d& mult, const __m256d& offset)
+    {
+        if (params.doScale) return _mm256_div_pd(_mm256_sub_pd(in, offset), mult);
+        return in;
+    }
+    
+    inline __m128i roundClamp(const __m256d& in, const __m256d& lowest, const __m256d& highest)
+    {//floor(0.5 + x) of 4 doubles
+        __m256d clamped = _mm256_min_pd(_mm256_max_pd(in, lowest), highest);//NaN becomes lowest, like the naive kernel
+        return _mm256_cvttpd_epi32(_mm256_floor_pd(_mm256_add_pd(clamped, _mm256_set1_pd(0.5))));
+    }
+    
+    //8 floats to 4 int32 each in low and high
+    inline void roundClampFloats(const __m256& in, const NiftiConvertParams& params, const __m256d& mult, const __m256d& offset,
+                                 const __m256d& lowest, const __m256d& highest, __m128i& low, __m128i& high)
+    {
+        low = roundClamp(unscaleDouble(_mm256_cvtps_pd(_mm256_castps256_ps128(in)), params, mult, offset), lowest, highest);
+        high = roundClamp(unscaleDouble(_mm256_cvtps_pd(_mm256_extractf128_ps(in, 1)), params, mult, offset), lowest, highest);
+    }
+    
+    template<typename T>
+    void writeSmallInt(char* out, const float* in, const int64_t& count, const NiftiConvertParams& params)
+    {//8 and 16 bit integers, values are already clamped, so the saturating packs can't change anything
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        const __m256d lowest = _mm256_set1_pd((double)std::numeric_limits<T>::min()), highest = _mm256_set1_pd((double)std::numeric_limits<T>::max());
+        const bool isUnsigned = (std::numeric_limits<T>::min() == 0);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i low, high;
+            roundClampFloats(_mm256_loadu_ps(in + i), params, mult, offset, lowest, highest, low, high);
+            __m128i shorts = ((sizeof(T) == 2 && isUnsigned) ? _mm_packus_epi32(low, high) : _mm_packs_epi32(low, high));
+            if (sizeof(T) == 1)
+            {
+                __m128i bytes = (isUnsigned ? _mm_packus_epi16(shorts, shorts) : _mm_packs_epi16(shorts, shorts));
+                _mm_storel_epi64((__m128i*)(out + i), bytes);
+            } else {
+                if (params.swap) shorts = swap16(shorts);
+                _mm_storeu_si128((__m128i*)(out + i * 2), shorts);
+            }
+        }
+        niftiConvertNaiveWrite<T>(out + i * sizeof(T), in + i, count - i, params);
+    }
+    
+    void writeInt32(char* out, const float* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        const __m256d lowest = _mm256_set1_pd((double)std::numeric_limits<int32_t>::min()), highest = _mm256_set1_pd((double)std::numeric_limits<int32_t>::max());
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i low, high;
+            roundClampFloats(_mm256_loadu_ps(in + i), params, mult, offset, lowest, highest, low, high);
+            __m256i ints = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+            if (params.swap) ints = swap32(ints);
+            _mm256_storeu_si256((__m256i*)(out + i * 4), ints);
+        }
+        niftiConvertNaiveWrite<int32_t>(out + i * 4, in + i, count - i, params);
+    }
+    
+    void writeFloat32(char* out, const float* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 floats = _mm256_loadu_ps(in + i);
+            if (params.doScale)
+            {
+                __m128 low = _mm256_cvtpd_ps(unscaleDouble(_mm256_cvtps_pd(_mm256_castps256_ps128(floats)), params, mult, offset));
+                __m128 high = _mm256_cvtpd_ps(unscaleDouble(_mm256_cvtps_pd(_mm256_extractf128_ps(floats, 1)), params, mult, offset));
+                floats = _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+            }
+            __m256i raw = _mm256_castps_si256(floats);
+            if (params.swap) raw = swap32(raw);
+            _mm256_storeu_si256((__m256i*)(out + i * 4), raw);
+        }
+        niftiConvertNaiveWrite<float>(out + i * 4, in + i, count - i, params);
+    }
+    
+    void writeFloat64(char* out, const float* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m256d mult = _mm256_set1_pd(params.mult), offset = _mm256_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 floats = _mm256_loadu_ps(in + i);
+            __m256i low = _mm256_castpd_si256(unscaleDouble(_mm256_cvtps_pd(_mm256_castps256_ps128(floats)), params, mult, offset));
+            __m256i high = _mm256_castpd_si256(unscaleDouble(_mm256_cvtps_pd(_mm256_extractf128_ps(floats, 1)), params, mult, offset));
+            if (params.swap)
+            {
+                low = swap64(low);
+                high = swap64(high);
+            }
+            _mm256_storeu_si256((__m256i*)(out + i * 8), low);
+            _mm256_storeu_si256((__m256i*)(out + i * 8 + 32), high);
+        }
+        niftiConvertNaiveWrite<double>(out + i * 8, in + i, count - i, params);
+    }
+}
+
+void caret::niftiConvertAVX2Kernels(NiftiConvertKernelTable& table)
+{//uint32 writing stays naive, there is no unsigned 32-bit conversion before avx512
+    table.readUInt8 = readUInt8;
+    table.readInt8 = readInt8;
+    table.readUInt16 = readUInt16;
+    table.readInt16 = readInt16;
+    table.readUInt32 = readUInt32;
+    table.readInt32 = readInt32;
+    table.readFloat32 = readFloat32;
+    table.readFloat64 = readFloat64;
+    table.writeUInt8 = writeSmallInt<uint8_t>;
+    table.writeInt8 = writeSmallInt<int8_t>;
+    table.writeUInt16 = writeSmallInt<uint16_t>;
+    table.writeInt16 = writeSmallInt<int16_t>;
+    table.writeInt32 = writeInt32;
+    table.writeFloat32 = writeFloat32;
+    table.writeFloat64 = writeFloat64;
+}
+
+#endif //CARET_DOTFCN
@@ -0,0 +1,112 @@
+#ifndef __NIFTI_CONVERT_KERNELS_H__
+#define __NIFTI_CONVERT_KERNELS_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//internal to NiftiConvert, the SIMD files include this to get the naive kernels for the leftover elements at the end of an array
+
+#include "ByteSwapping.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdint.h>
+
+namespace caret
+{
+    
+    struct NiftiConvertParams
+    {
+        bool swap, doScale;
+        double mult, offset;
+    };
+    
+    typedef void (*NiftiReadKernel)(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params);
+    typedef void (*NiftiWriteKernel)(char* out, const float* in, const int64_t& count, const NiftiConvertParams& params);
+    
+    struct NiftiConvertKernelTable
+    {
+        NiftiReadKernel readUInt8, readInt8, readUInt16, readInt16, readUInt32, readInt32, readFloat32, readFloat64;
+        NiftiWriteKernel writeUInt8, writeInt8, writeUInt16, writeInt16, writeUInt32, writeInt32, writeFloat32, writeFloat64;
+    };
+    
+    void niftiConvertNaiveKernels(NiftiConvertKernelTable& table);//sets every entry
+#ifdef CARET_DOTFCN
+    //these only replace the entries they have SIMD versions of, so call naive first
+    void niftiConvertSSE2Kernels(NiftiConvertKernelTable& table);
+    void niftiConvertAVX2Kernels(NiftiConvertKernelTable& table);
+#endif
+    
+    //anonymous namespace, because the SIMD files are compiled with different instruction set flags, and we don't want the linker to pick their copies for the naive kernels
+    namespace
+    {
+        template<typename T>
+        inline T niftiConvertLoad(const char* in, const int64_t& index, const bool& swap)
+        {
+            T ret;
+            memcpy(&ret, in + index * sizeof(T), sizeof(T));//input may be unaligned, when it comes from a memory mapping
+            if (swap) ByteSwapping::swap(ret);
+            return ret;
+        }
+        
+        template<typename T>
+        void niftiConvertNaiveRead(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+        {
+            if (params.doScale)
+            {
+                for (int64_t i = 0; i < count; ++i)
+                {
+                    out[i] = (float)(params.offset + params.mult * (double)niftiConvertLoad<T>(in, i, params.swap));//SIMD versions do exactly this math, so all versions give identical results
+                }
+            } else {
+                for (int64_t i = 0; i < count; ++i)
+                {
+                    out[i] = (float)niftiConvertLoad<T>(in, i, params.swap);
+                }
+            }
+        }
+        
+        template<typename T>
+        void niftiConvertNaiveWrite(char* out, const float* in, const int64_t& count, const NiftiConvertParams& params)
+        {
+            for (int64_t i = 0; i < count; ++i)
+            {
+                double value = in[i];
+                if (params.doScale) value = (value - params.offset) / params.mult;
+                T result;
+                if (std::numeric_limits<T>::is_integer)
+                {
+                    const double lowest = (double)std::numeric_limits<T>::min(), highest = (double)std::numeric_limits<T>::max();
+                    if (!(value >= lowest)) value = lowest;//same as SIMD max(), NaN becomes the lowest value
+                    if (value > highest) value = highest;
+                    result = (T)floor(0.5 + value);
+                } else {
+                    result = (T)value;
+                }
+                if (params.swap) ByteSwapping::swap(result);
+                memcpy(out + i * sizeof(T), &result, sizeof(T));
+            }
+        }
+    }
+    
+}
+
+#endif //__NIFTI_CONVERT_KERNELS_H__
@@ -0,0 +1,308 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//this file is compiled with -msse2, only call these kernels after checking the cpu supports it
+
+#include "NiftiConvertKernels.h"
+
+#ifdef CARET_DOTFCN
+
+#include <emmintrin.h>
+
+using namespace caret;
+
+namespace
+{
+    inline __m128i swap16(const __m128i& in)
+    {//sse2 has no byte shuffle, use shifts
+        return _mm_or_si128(_mm_slli_epi16(in, 8), _mm_srli_epi16(in, 8));
+    }
+    
+    inline __m128i swap32(const __m128i& in)
+    {
+        __m128i temp = swap16(in);
+        return _mm_or_si128(_mm_slli_epi32(temp, 16), _mm_srli_epi32(temp, 16));
+    }
+    
+    inline __m128i swap64(const __m128i& in)
+    {
+        return _mm_shuffle_epi32(swap32(in), _MM_SHUFFLE(2, 3, 0, 1));
+    }
+    
+    inline __m128 scaleToFloat(const __m128d& low, const __m128d& high, const __m128d& mult, const __m128d& offset)
+    {//same order of operations as the naive kernel
+        return _mm_movelh_ps(_mm_cvtpd_ps(_mm_add_pd(offset, _mm_mul_pd(mult, low))),
+                             _mm_cvtpd_ps(_mm_add_pd(offset, _mm_mul_pd(mult, high))));
+    }
+    
+    inline void storeInt32AsFloat(float* out, const __m128i& in, const NiftiConvertParams& params, const __m128d& mult, const __m128d& offset)
+    {
+        if (params.doScale)
+        {
+            _mm_storeu_ps(out, scaleToFloat(_mm_cvtepi32_pd(in), _mm_cvtepi32_pd(_mm_shuffle_epi32(in, _MM_SHUFFLE(1, 0, 3, 2))), mult, offset));
+        } else {
+            _mm_storeu_ps(out, _mm_cvtepi32_ps(in));
+        }
+    }
+    
+    void readUInt8(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m128d mult = _mm_set1_pd(params.mult), offset = _mm_set1_pd(params.offset);
+        const __m128i zero = _mm_setzero_si128();
+        int64_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(in + i));
+            __m128i low16 = _mm_unpacklo_epi8(bytes, zero), high16 = _mm_unpackhi_epi8(bytes, zero);
+            storeInt32AsFloat(out + i, _mm_unpacklo_epi16(low16, zero), params, mult, offset);
+            storeInt32AsFloat(out + i + 4, _mm_unpackhi_epi16(low16, zero), params, mult, offset);
+            storeInt32AsFloat(out + i + 8, _mm_unpacklo_epi16(high16, zero), params, mult, offset);
+            storeInt32AsFloat(out + i + 12, _mm_unpackhi_epi16(high16, zero), params, mult, offset);
+        }
+        niftiConvertNaiveRead<uint8_t>(out + i, in + i, count - i, params);
+    }
+    
+    void readInt8(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m128d mult = _mm_set1_pd(params.mult), offset = _mm_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {//sign extend by putting the byte in the high half, then arithmetic shift
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(in + i));
+            __m128i low16 = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8), high16 = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+            storeInt32AsFloat(out + i, _mm_srai_epi32(_mm_unpacklo_epi16(low16, low16), 16), params, mult, offset);
+            storeInt32AsFloat(out + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(low16, low16), 16), params, mult, offset);
+            storeInt32AsFloat(out + i + 8, _mm_srai_epi32(_mm_unpacklo_epi16(high16, high16), 16), params, mult, offset);
+            storeInt32AsFloat(out + i + 12, _mm_srai_epi32(_mm_unpackhi_epi16(high16, high16), 16), params, mult, offset);
+        }
+        niftiConvertNaiveRead<int8_t>(out + i, in + i, count - i, params);
+    }
+    
+    void readUInt16(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m128d mult = _mm_set1_pd(params.mult), offset = _mm_set1_pd(params.offset);
+        const __m128i zero = _mm_setzero_si128();
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i shorts = _mm_loadu_si128((const __m128i*)(in + i * 2));
+            if (params.swap) shorts = swap16(shorts);
+            storeInt32AsFloat(out + i, _mm_unpacklo_epi16(shorts, zero), params, mult, offset);
+            storeInt32AsFloat(out + i + 4, _mm_unpackhi_epi16(shorts, zero), params, mult, offset);
+        }
+        niftiConvertNaiveRead<uint16_t>(out + i, in + i * 2, count - i, params);
+    }
+    
+    void readInt16(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m128d mult = _mm_set1_pd(params.mult), offset = _mm_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i shorts = _mm_loadu_si128((const __m128i*)(in + i * 2));
+            if (params.swap) shorts = swap16(shorts);
+            storeInt32AsFloat(out + i, _mm_srai_epi32(_mm_unpacklo_epi16(shorts, shorts), 16), params, mult, offset);
+            storeInt32AsFloat(out + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(shorts, shorts), 16), params, mult, offset);
+        }
+        niftiConvertNaiveRead<int16_t>(out + i, in + i * 2, count - i, params);
+    }
+    
+    void readInt32(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m128d mult = _mm_set1_pd(params.mult), offset = _mm_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i ints = _mm_loadu_si128((const __m128i*)(in + i * 4));
+            if (params.swap) ints = swap32(ints);
+            storeInt32AsFloat(out + i, ints, params, mult, offset);
+        }
+        niftiConvertNaiveRead<int32_t>(out + i, in + i * 4, count - i, params);
+    }
+    
+    void readFloat32(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m128d mult = _mm_set1_pd(params.mult), offset = _mm_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i raw = _mm_loadu_si128((const __m128i*)(in + i * 4));
+            if (params.swap) raw = swap32(raw);
+            __m128 floats = _mm_castsi128_ps(raw);
+            if (params.doScale)
+            {
+                _mm_storeu_ps(out + i, scaleToFloat(_mm_cvtps_pd(floats), _mm_cvtps_pd(_mm_movehl_ps(floats, floats)), mult, offset));
+            } else {
+                _mm_storeu_ps(out + i, floats);
+            }
+        }
+        niftiConvertNaiveRead<float>(out + i, in + i * 4, count - i, params);
+    }
+    
+    void readFloat64(float* out, const char* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m128d mult = _mm_set1_pd(params.mult), offset = _mm_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i raw1 = _mm_loadu_si128((const __m128i*)(in + i * 8)), raw2 = _mm_loadu_si128((const __m128i*)(in + i * 8 + 16));
+            if (params.swap)
+            {
+                raw1 = swap64(raw1);
+                raw2 = swap64(raw2);
+            }
+            __m128d low = _mm_castsi128_pd(raw1), high = _mm_castsi128_pd(raw2);
+            if (params.doScale)
+            {
+                _mm_storeu_ps(out + i, scaleToFloat(low, high, mult, offset));
+            } else {
+                _mm_storeu_ps(out + i, _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high)));
+            }
+        }
+        niftiConvertNaiveRead<double>(out + i, in + i * 8, count - i, params);
+    }
+    
+    inline __m128d unscaleDouble(const __m128d& in, const NiftiConvertParams& params, const __m128d& mult, const __m128d& offset)
+    {
+        if (params.doScale) return _mm_div_pd(_mm_sub_pd(in, offset), mult);
+        return in;
+    }
+    
+    inline __m128i roundClampPair(const __m128d& in, const __m128d& lowest, const __m128d& highest)
+    {//floor(0.5 + x) of 2 doubles, result in the low 2 int32 lanes
+        __m128d clamped = _mm_min_pd(_mm_max_pd(in, lowest), highest);//NaN becomes lowest, like the naive kernel
+        __m128d shifted = _mm_add_pd(clamped, _mm_set1_pd(0.5));
+        __m128i truncated = _mm_cvttpd_epi32(shifted);//no floor in sse2, truncate and then fix negative non-integers
+        __m128d tooBig = _mm_cmpgt_pd(_mm_cvtepi32_pd(truncated), shifted);
+        return _mm_add_epi32(truncated, _mm_shuffle_epi32(_mm_castpd_si128(tooBig), _MM_SHUFFLE(3, 3, 2, 0)));//mask is -1 where we need to subtract 1
+    }
+    
+    inline __m128i roundClampFloats(const __m128& in, const NiftiConvertParams& params, const __m128d& mult, const __m128d& offset,
+                                    const __m128d& lowest, const __m128d& highest)
+    {//4 floats to 4 int32
+        __m128i low = roundClampPair(unscaleDouble(_mm_cvtps_pd(in), params, mult, offset), lowest, highest);
+        __m128i high = roundClampPair(unscaleDouble(_mm_cvtps_pd(_mm_movehl_ps(in, in)), params, mult, offset), lowest, highest);
+        return _mm_unpacklo_epi64(low, high);
+    }
+    
+    template<typename T>
+    void writeSmallInt(char* out, const float* in, const int64_t& count, const NiftiConvertParams& params)
+    {//8 and 16 bit integers, values are already clamped, so the saturating packs can't change anything
+        const __m128d mult = _mm_set1_pd(params.mult), offset = _mm_set1_pd(params.offset);
+        const __m128d lowest = _mm_set1_pd((double)std::numeric_limits<T>::min()), highest = _mm_set1_pd((double)std::numeric_limits<T>::max());
+        const bool isUnsigned = (std::numeric_limits<T>::min() == 0);
+        const __m128i bias = _mm_set1_epi32(32768), unbias = _mm_set1_epi16(-32768);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i low = roundClampFloats(_mm_loadu_ps(in + i), params, mult, offset, lowest, highest);
+            __m128i high = roundClampFloats(_mm_loadu_ps(in + i + 4), params, mult, offset, lowest, highest);
+            __m128i shorts;
+            if (sizeof(T) == 2 && isUnsigned)
+            {//sse2 has no unsigned 32 to 16 pack, so shift into signed range and back
+                shorts = _mm_add_epi16(_mm_packs_epi32(_mm_sub_epi32(low, bias), _mm_sub_epi32(high, bias)), unbias);
+            } else {
+                shorts = _mm_packs_epi32(low, high);
+            }
+            if (sizeof(T) == 1)
+            {
+                __m128i bytes = (isUnsigned ? _mm_packus_epi16(shorts, shorts) : _mm_packs_epi16(shorts, shorts));
+                _mm_storel_epi64((__m128i*)(out + i), bytes);
+            } else {
+                if (params.swap) shorts = swap16(shorts);
+                _mm_storeu_si128((__m128i*)(out + i * 2), shorts);
+            }
+        }
+        niftiConvertNaiveWrite<T>(out + i * sizeof(T), in + i, count - i, params);
+    }
+    
+    void writeInt32(char* out, const float* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m128d mult = _mm_set1_pd(params.mult), offset = _mm_set1_pd(params.offset);
+        const __m128d lowest = _mm_set1_pd((double)std::numeric_limits<int32_t>::min()), highest = _mm_set1_pd((double)std::numeric_limits<int32_t>::max());
+        int64_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i ints = roundClampFloats(_mm_loadu_ps(in + i), params, mult, offset, lowest, highest);
+            if (params.swap) ints = swap32(ints);
+            _mm_storeu_si128((__m128i*)(out + i * 4), ints);
+        }
+        niftiConvertNaiveWrite<int32_t>(out + i * 4, in + i, count - i, params);
+    }
+    
+    void writeFloat32(char* out, const float* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m128d mult = _mm_set1_pd(params.mult), offset = _mm_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 floats = _mm_loadu_ps(in + i);
+            if (params.doScale)
+            {
+                floats = _mm_movelh_ps(_mm_cvtpd_ps(unscaleDouble(_mm_cvtps_pd(floats), params, mult, offset)),
+                                       _mm_cvtpd_ps(unscaleDouble(_mm_cvtps_pd(_mm_movehl_ps(floats, floats)), params, mult, offset)));
+            }
+            __m128i raw = _mm_castps_si128(floats);
+            if (params.swap) raw = swap32(raw);
+            _mm_storeu_si128((__m128i*)(out + i * 4), raw);
+        }
+        niftiConvertNaiveWrite<float>(out + i * 4, in + i, count - i, params);
+    }
+    
+    void writeFloat64(char* out, const float* in, const int64_t& count, const NiftiConvertParams& params)
+    {
+        const __m128d mult = _mm_set1_pd(params.mult), offset = _mm_set1_pd(params.offset);
+        int64_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 floats = _mm_loadu_ps(in + i);
+            __m128i low = _mm_castpd_si128(unscaleDouble(_mm_cvtps_pd(floats), params, mult, offset));
+            __m128i high = _mm_castpd_si128(unscaleDouble(_mm_cvtps_pd(_mm_movehl_ps(floats, floats)), params, mult, offset));
+            if (params.swap)
+            {
+                low = swap64(low);
+                high = swap64(high);
+            }
+            _mm_storeu_si128((__m128i*)(out + i * 8), low);
+            _mm_storeu_si128((__m128i*)(out + i * 8 + 16), high);
+        }
+        niftiConvertNaiveWrite<double>(out + i * 8, in + i, count - i, params);
+    }
+}
+
+void caret::niftiConvertSSE2Kernels(NiftiConvertKernelTable& table)
+{//uint32 doesn't fit sse2 integer conversions, so it stays naive
+    table.readUInt8 = readUInt8;
+    table.readInt8 = readInt8;
+    table.readUInt16 = readUInt16;
+    table.readInt16 = readInt16;
+    table.readInt32 = readInt32;
+    table.readFloat32 = readFloat32;
+    table.readFloat64 = readFloat64;
+    table.writeUInt8 = writeSmallInt<uint8_t>;
+    table.writeInt8 = writeSmallInt<int8_t>;
+    table.writeUInt16 = writeSmallInt<uint16_t>;
+    table.writeInt16 = writeSmallInt<int16_t>;
+    table.writeInt32 = writeInt32;
+    table.writeFloat32 = writeFloat32;
+    table.writeFloat64 = writeFloat64;
+}
+
+#endif //CARET_DOTFCN
@@ -25,8 +25,11 @@
 using namespace std;
 using namespace caret;
 
-void NiftiIO::openRead(const QString& filename)
+void NiftiIO::openRead(const QString& filename, const bool& tryMap)
 {
+    CaretProfileScope myProfile("nifti open");
+    m_mapped = NULL;
+    m_mappedSize = 0;
     m_file.open(filename);
     m_header.read(m_file);
     if (m_header.getDataType() == DT_BINARY)
@@ -34,6 +37,10 @@ void NiftiIO::openRead(const QString& filename)
         throw DataFileException("file uses the binary datatype, which is unsupported: " + filename);
     }
     m_dims = m_header.getDimensions();
+    if (tryMap)
+    {
+        m_mapped = m_file.mapForRead(m_mappedSize);//returns NULL for compressed files, then we just use the normal read path
+    }
 }
 
 void NiftiIO::writeNew(const QString& filename, const NiftiHeader& header, const int& version, const bool& withRead, const bool& swapEndian)
@@ -42,6 +49,8 @@ void NiftiIO::writeNew(const QString& filename, const NiftiHeader& header, const
     {
         throw DataFileException("writing NIFTI with binary datatype is unsupported");
     }
+    m_mapped = NULL;//we never map files we are writing
+    m_mappedSize = 0;
     if (withRead)
     {
         m_file.open(filename, CaretBinaryFile::READ_WRITE_TRUNCATE);//for cifti on-disk writing, replace structure with along row needs to RMW
@@ -55,6 +64,8 @@ void NiftiIO::writeNew(const QString& filename, const NiftiHeader& header, const
 
 void NiftiIO::close()
 {
+    m_mapped = NULL;//closing the file releases the mapping
+    m_mappedSize = 0;
     m_file.close();
     m_dims.clear();
 }
@@ -90,7 +101,103 @@ int NiftiIO::getNumComponents() const
     }
 }
 
-int NiftiIO::numBytesPerElem()
+CaretPointer<vector<char> > NiftiIO::acquireScratch(const int64_t& size)
+{
+    CaretPointer<vector<char> > ret;
+    {
+        CaretMutexLocker locked(&m_poolMutex);
+        if (!m_scratchPool.empty())
+        {
+            ret = m_scratchPool.back();
+            m_scratchPool.pop_back();
+        }
+    }
+    if (ret == NULL) ret.grabNew(new vector<char>());
+    ret->resize(size);//outside the lock, this may allocate
+    return ret;
+}
+
+void NiftiIO::releaseScratch(const CaretPointer<vector<char> >& buffer)
+{
+    CaretMutexLocker locked(&m_poolMutex);
+    m_scratchPool.push_back(buffer);
+}
+
+bool NiftiIO::isConversionNeeded() const
+{
+    double mult, offset;
+    return m_header.isSwapped() || m_header.getDataScaling(mult, offset);
+}
+
+void NiftiIO::computeSelection(const int& fullDims, const vector<int64_t>& indexSelect, int64_t& numElemsOut, int64_t& numSkipOut) const
+{
+    CaretAssert(fullDims >= 0 && fullDims <= (int)m_dims.size());
+    CaretAssert((size_t)fullDims + indexSelect.size() == m_dims.size());//could be >=, but should catch more stupid mistakes as ==
+    numElemsOut = getNumComponents();//for now, calculate read size on the fly, as the read call will be the slowest part
+    int curDim;
+    for (curDim = 0; curDim < fullDims; ++curDim)
+    {
+        numElemsOut *= m_dims[curDim];
+    }
+    int64_t numDimSkip = numElemsOut;
+    numSkipOut = 0;
+    for (; curDim < (int)m_dims.size(); ++curDim)
+    {
+        CaretAssert(indexSelect[curDim - fullDims] >= 0 && indexSelect[curDim - fullDims] < m_dims[curDim]);
+        numSkipOut += indexSelect[curDim - fullDims] * numDimSkip;
+        numDimSkip *= m_dims[curDim];
+    }
+}
+
+const char* NiftiIO::getMappedData(const int& fullDims, const vector<int64_t>& indexSelect) const
+{
+    if (m_mapped == NULL) return NULL;
+    int64_t numElems, numSkip;
+    computeSelection(fullDims, indexSelect, numElems, numSkip);
+    int64_t start = numSkip * numBytesPerElem() + m_header.getDataOffset();
+    if (start + numElems * numBytesPerElem() > m_mappedSize) return NULL;//truncated file, let the caller fall back to readData to get the error
+    return m_mapped + start;
+}
+
+bool NiftiIO::convertReadFast(float* dataOut, const char* in, const int64_t& numElems, const bool& swap)
+{
+    double mult, offset;
+    bool doScale = m_header.getDataScaling(mult, offset);
+    return NiftiConvert::readToFloat(dataOut, in, m_header.getDataType(), numElems, swap, doScale, mult, offset);
+}
+
+bool NiftiIO::convertWriteFast(char* out, const float* dataIn, const int64_t& numElems)
+{
+    double mult, offset;
+    bool doScale = m_header.getDataScaling(mult, offset);
+    return NiftiConvert::writeFromFloat(out, dataIn, m_header.getDataType(), numElems, m_header.isSwapped(), doScale, mult, offset);
+}
+
+void NiftiIO::swapScratch(char* data, const int64_t& count)
+{//swap each component, the same way the typed conversion would see them
+    switch (numBytesPerElem())
+    {
+        case 1:
+            break;
+        case 2:
+            ByteSwapping::swapArray((uint16_t*)data, count);
+            break;
+        case 4:
+            ByteSwapping::swapArray((uint32_t*)data, count);
+            break;
+        case 8:
+            ByteSwapping::swapArray((uint64_t*)data, count);
+            break;
+        case 16:
+            ByteSwapping::swapArray((long double*)data, count);
+            break;
+        default:
+            CaretAssert(0);
+            throw DataFileException("internal error, report what you did to the developers");
+    }
+}
+
+int NiftiIO::numBytesPerElem() const
 {
     switch (m_header.getDataType())
     {
@@ -25,12 +25,17 @@
 #include "CaretAssert.h"
 #include "CaretBinaryFile.h"
 #include "CaretMutex.h"
+#include "CaretPointer.h"
+#include "CaretProfiler.h"
 #include "DataFileException.h"
+#include "NiftiConvert.h"
 #include "NiftiHeader.h"
 
 #include <QString>
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 #include <vector>
 
@@ -42,15 +47,44 @@ namespace caret
         CaretBinaryFile m_file;
         NiftiHeader m_header;
         std::vector<int64_t> m_dims;
-        std::vector<char> m_scratch;//scratch memory for byteswapping, type conversion, etc
-        CaretMutex m_mutex;//protect multithreaded calls from each other
-        int numBytesPerElem();//for resizing scratch
+        std::vector<CaretPointer<std::vector<char> > > m_scratchPool;//scratch memory for byteswapping, type conversion, etc, one buffer per concurrent call
+        CaretMutex m_poolMutex;//only held while taking or returning a scratch buffer, file access itself uses positional reads/writes
+        class ScratchHolder
+        {//returns the buffer to the pool even if the read throws
+            NiftiIO* m_io;
+            CaretPointer<std::vector<char> > m_buffer;
+        public:
+            ScratchHolder(NiftiIO* io, const int64_t& size) : m_io(io), m_buffer(io->acquireScratch(size)) { }
+            ~ScratchHolder() { m_io->releaseScratch(m_buffer); }
+            char* data() { return m_buffer->data(); }
+        };
+        friend class ScratchHolder;
+        CaretPointer<std::vector<char> > acquireScratch(const int64_t& size);
+        void releaseScratch(const CaretPointer<std::vector<char> >& buffer);
+        const char* m_mapped;//whole file memory mapping, when requested and available - reading from it needs no scratch space, so no lock
+        int64_t m_mappedSize;
+        int numBytesPerElem() const;//for resizing scratch
+        void computeSelection(const int& fullDims, const std::vector<int64_t>& indexSelect, int64_t& numElemsOut, int64_t& numSkipOut) const;
+        void swapScratch(char* data, const int64_t& count);
+        template<typename T>
+        bool convertReadFast(T*, const char*, const int64_t&, const bool&) { return false; }//fused SIMD kernels only exist for float in memory
+        bool convertReadFast(float* dataOut, const char* in, const int64_t& numElems, const bool& swap);
+        template<typename T>
+        bool convertWriteFast(char*, const T*, const int64_t&) { return false; }
+        bool convertWriteFast(char* out, const float* dataIn, const int64_t& numElems);
+        template<typename T>
+        void convertReadFrom(T* dataOut, const char* in, const int64_t& numElems);//switch on the file datatype
         template<typename TO, typename FROM>
-        void convertRead(TO* out, FROM* in, const int64_t& count);//for reading from file
+        void convertRead(TO* out, const FROM* in, const int64_t& count);//for reading from file, input must already be byteswapped
         template<typename TO, typename FROM>
         void convertWrite(TO* out, const FROM* in, const int64_t& count);//for writing to file
     public:
-        void openRead(const QString& filename);
+        NiftiIO() { m_mapped = NULL; m_mappedSize = 0; }
+        void openRead(const QString& filename, const bool& tryMap = false);//tryMap memory maps uncompressed files, allowing concurrent reads without locking
+        bool isMapped() const { return m_mapped != NULL; }
+        bool isConversionNeeded() const;//true if reading requires byteswapping or scaling
+        //pointer into the mapping at the start of the selection, NULL if not mapped or if the file is too short - data is in the file datatype and byte order
+        const char* getMappedData(const int& fullDims, const std::vector<int64_t>& indexSelect) const;
         void writeNew(const QString& filename, const NiftiHeader& header, const int& version = 1, const bool& withRead = false, const bool& swapEndian = false);
         QString getFilename() const { return m_file.getFilename(); }
         void overrideDimensions(const std::vector<int64_t>& newDims) { m_dims = newDims; }//HACK: deal with reading/writing CIFTI-1's broken headers
@@ -69,70 +103,92 @@ namespace caret
     template<typename T>
     void NiftiIO::readData(T* dataOut, const int& fullDims, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead)
     {
-        CaretAssert(fullDims >= 0 && fullDims <= (int)m_dims.size());
-        CaretAssert((size_t)fullDims + indexSelect.size() == m_dims.size());//could be >=, but should catch more stupid mistakes as ==
-        int64_t numElems = getNumComponents();//for now, calculate read size on the fly, as the read call will be the slowest part
-        int curDim;
-        for (curDim = 0; curDim < fullDims; ++curDim)
-        {
-            numElems *= m_dims[curDim];
-        }
-        int64_t numDimSkip = numElems, numSkip = 0;
-        for (; curDim < (int)m_dims.size(); ++curDim)
-        {
-            CaretAssert(indexSelect[curDim - fullDims] >= 0 && indexSelect[curDim - fullDims] < m_dims[curDim]);
-            numSkip += indexSelect[curDim - fullDims] * numDimSkip;
-            numDimSkip *= m_dims[curDim];
+        int64_t numElems, numSkip;
+        computeSelection(fullDims, indexSelect, numElems, numSkip);
+        CaretProfiler::addCounter("nifti bytes read", numElems * numBytesPerElem());
+        if (m_mapped != NULL)
+        {//convert straight out of the mapping into the output, so no scratch memory and no lock
+            int64_t start = numSkip * numBytesPerElem() + m_header.getDataOffset();
+            int64_t available = std::max(int64_t(0), (m_mappedSize - start) / numBytesPerElem());
+            if (available < numElems)
+            {
+                if (!tolerateShortRead)
+                {
+                    throw DataFileException("error while reading from nifti file '" + m_file.getFilename() + "'");
+                }
+                numElems = available;
+            }
+            if (numElems <= 0 || convertReadFast(dataOut, m_mapped + start, numElems, m_header.isSwapped())) return;
+            if (!m_header.isSwapped())
+            {
+                convertReadFrom(dataOut, m_mapped + start, numElems);
+                return;
+            }
+            ScratchHolder scratch(this, numElems * numBytesPerElem());//can't swap in place in a read-only mapping
+            memcpy(scratch.data(), m_mapped + start, numElems * numBytesPerElem());
+            swapScratch(scratch.data(), numElems);
+            convertReadFrom(dataOut, scratch.data(), numElems);
+            return;
         }
-        CaretMutexLocker locked(&m_mutex);//protect starting with resizing until we are done converting, because we use an internal variable for scratch space
         //we can't guarantee that the output memory is enough to use as scratch space, as we might be doing a narrowing conversion
-        //we are doing FILE ACCESS, so cpu performance isn't really something to worry about
-        m_scratch.resize(numElems * numBytesPerElem());
-        m_file.seek(numSkip * numBytesPerElem() + m_header.getDataOffset());
+        //each call gets its own scratch buffer and uses a positional read, so concurrent calls (different rows from an OpenMP loop) don't serialize
+        const int64_t numBytes = numElems * numBytesPerElem();
+        ScratchHolder scratch(this, numBytes);
         int64_t numRead = 0;
-        m_file.read(m_scratch.data(), m_scratch.size(), &numRead);
-        if ((numRead != (int64_t)m_scratch.size() && !tolerateShortRead) || numRead < 0)//for now, assume read giving -1 is always a problem
+        m_file.readAt(scratch.data(), numBytes, numSkip * numBytesPerElem() + m_header.getDataOffset(), &numRead);
+        if ((numRead != numBytes && !tolerateShortRead) || numRead < 0)//for now, assume read giving -1 is always a problem
         {
             throw DataFileException("error while reading from nifti file '" + m_file.getFilename() + "'");
         }
+        if (convertReadFast(dataOut, scratch.data(), numElems, m_header.isSwapped())) return;//swaps as part of the conversion
+        if (m_header.isSwapped())
+        {
+            swapScratch(scratch.data(), numElems);
+        }
+        convertReadFrom(dataOut, scratch.data(), numElems);
+    }
+    
+    template<typename T>
+    void NiftiIO::convertReadFrom(T* dataOut, const char* in, const int64_t& numElems)
+    {
         switch (m_header.getDataType())
         {
             case NIFTI_TYPE_UINT8:
             case NIFTI_TYPE_RGB24://handled by components
-                convertRead(dataOut, (uint8_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (const uint8_t*)in, numElems);
                 break;
             case NIFTI_TYPE_INT8:
-                convertRead(dataOut, (int8_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (const int8_t*)in, numElems);
                 break;
             case NIFTI_TYPE_UINT16:
-                convertRead(dataOut, (uint16_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (const uint16_t*)in, numElems);
                 break;
             case NIFTI_TYPE_INT16:
-                convertRead(dataOut, (int16_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (const int16_t*)in, numElems);
                 break;
             case NIFTI_TYPE_UINT32:
-                convertRead(dataOut, (uint32_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (const uint32_t*)in, numElems);
                 break;
             case NIFTI_TYPE_INT32:
-                convertRead(dataOut, (int32_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (const int32_t*)in, numElems);
                 break;
             case NIFTI_TYPE_UINT64:
-                convertRead(dataOut, (uint64_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (const uint64_t*)in, numElems);
                 break;
             case NIFTI_TYPE_INT64:
-                convertRead(dataOut, (int64_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (const int64_t*)in, numElems);
                 break;
             case NIFTI_TYPE_FLOAT32:
             case NIFTI_TYPE_COMPLEX64://components
-                convertRead(dataOut, (float*)m_scratch.data(), numElems);
+                convertRead(dataOut, (const float*)in, numElems);
                 break;
             case NIFTI_TYPE_FLOAT64:
             case NIFTI_TYPE_COMPLEX128:
-                convertRead(dataOut, (double*)m_scratch.data(), numElems);
+                convertRead(dataOut, (const double*)in, numElems);
                 break;
             case NIFTI_TYPE_FLOAT128:
             case NIFTI_TYPE_COMPLEX256:
-                convertRead(dataOut, (long double*)m_scratch.data(), numElems);
+                convertRead(dataOut, (const long double*)in, numElems);
                 break;
             default:
                 CaretAssert(0);
@@ -143,78 +199,66 @@ namespace caret
     template<typename T>
     void NiftiIO::writeData(const T* dataIn, const int& fullDims, const std::vector<int64_t>& indexSelect)
     {
-        CaretAssert(fullDims >= 0 && fullDims <= (int)m_dims.size());
-        CaretAssert((size_t)fullDims + indexSelect.size() == m_dims.size());//could be >=, but should catch more stupid mistakes as ==
-        int64_t numElems = getNumComponents();//for now, calculate read size on the fly, as the read call will be the slowest part
-        int curDim;
-        for (curDim = 0; curDim < fullDims; ++curDim)
-        {
-            numElems *= m_dims[curDim];
-        }
-        int64_t numDimSkip = numElems, numSkip = 0;
-        for (; curDim < (int)m_dims.size(); ++curDim)
-        {
-            CaretAssert(indexSelect[curDim - fullDims] >= 0 && indexSelect[curDim - fullDims] < m_dims[curDim]);
-            numSkip += indexSelect[curDim - fullDims] * numDimSkip;
-            numDimSkip *= m_dims[curDim];
+        int64_t numElems, numSkip;
+        computeSelection(fullDims, indexSelect, numElems, numSkip);
+        const int64_t numBytes = numElems * numBytesPerElem();
+        CaretProfiler::addCounter("nifti bytes written", numBytes);
+        ScratchHolder scratch(this, numBytes);
+        char* scratchData = scratch.data();
+        if (convertWriteFast(scratchData, dataIn, numElems))
+        {//also does the byteswapping
+            m_file.writeAt(scratchData, numBytes, numSkip * numBytesPerElem() + m_header.getDataOffset());
+            return;
         }
-        CaretMutexLocker locked(&m_mutex);//protect starting with resizing until we are done writing, because we use an internal variable for scratch space
-        //we are doing FILE ACCESS, so cpu performance isn't really something to worry about
-        m_scratch.resize(numElems * numBytesPerElem());
-        m_file.seek(numSkip * numBytesPerElem() + m_header.getDataOffset());
         switch (m_header.getDataType())
         {
             case NIFTI_TYPE_UINT8:
             case NIFTI_TYPE_RGB24://handled by components
-                convertWrite((uint8_t*)m_scratch.data(), dataIn, numElems);
+                convertWrite((uint8_t*)scratchData, dataIn, numElems);
                 break;
             case NIFTI_TYPE_INT8:
-                convertWrite((int8_t*)m_scratch.data(), dataIn, numElems);
+                convertWrite((int8_t*)scratchData, dataIn, numElems);
                 break;
             case NIFTI_TYPE_UINT16:
-                convertWrite((uint16_t*)m_scratch.data(), dataIn, numElems);
+                convertWrite((uint16_t*)scratchData, dataIn, numElems);
                 break;
             case NIFTI_TYPE_INT16:
-                convertWrite((int16_t*)m_scratch.data(), dataIn, numElems);
+                convertWrite((int16_t*)scratchData, dataIn, numElems);
                 break;
             case NIFTI_TYPE_UINT32:
-                convertWrite((uint32_t*)m_scratch.data(), dataIn, numElems);
+                convertWrite((uint32_t*)scratchData, dataIn, numElems);
                 break;
             case NIFTI_TYPE_INT32:
-                convertWrite((int32_t*)m_scratch.data(), dataIn, numElems);
+                convertWrite((int32_t*)scratchData, dataIn, numElems);
                 break;
             case NIFTI_TYPE_UINT64:
-                convertWrite((uint64_t*)m_scratch.data(), dataIn, numElems);
+                convertWrite((uint64_t*)scratchData, dataIn, numElems);
                 break;
             case NIFTI_TYPE_INT64:
-                convertWrite((int64_t*)m_scratch.data(), dataIn, numElems);
+                convertWrite((int64_t*)scratchData, dataIn, numElems);
                 break;
             case NIFTI_TYPE_FLOAT32:
             case NIFTI_TYPE_COMPLEX64://components
-                convertWrite((float*)m_scratch.data(), dataIn, numElems);
+                convertWrite((float*)scratchData, dataIn, numElems);
                 break;
             case NIFTI_TYPE_FLOAT64:
             case NIFTI_TYPE_COMPLEX128:
-                convertWrite((double*)m_scratch.data(), dataIn, numElems);
+                convertWrite((double*)scratchData, dataIn, numElems);
                 break;
             case NIFTI_TYPE_FLOAT128:
             case NIFTI_TYPE_COMPLEX256:
-                convertWrite((long double*)m_scratch.data(), dataIn, numElems);
+                convertWrite((long double*)scratchData, dataIn, numElems);
                 break;
             default:
                 CaretAssert(0);
                 throw DataFileException("internal error, tell the developers what you just tried to do");
         }
-        m_file.write(m_scratch.data(), m_scratch.size());
+        m_file.writeAt(scratchData, numBytes, numSkip * numBytesPerElem() + m_header.getDataOffset());
     }
     
     template<typename TO, typename FROM>
-    void NiftiIO::convertRead(TO* out, FROM* in, const int64_t& count)
+    void NiftiIO::convertRead(TO* out, const FROM* in, const int64_t& count)
     {
-        if (m_header.isSwapped())
-        {
-            ByteSwapping::swapArray(in, count);
-        }
         double mult, offset;
         bool doScale = m_header.getDataScaling(mult, offset);
         if (std::numeric_limits<TO>::is_integer)//do round to nearest when integer output type
@@ -27,6 +27,7 @@
 #include "CiftiXML.h"
 #include "FloatMatrix.h"
 #include "GiftiFile.h"
+#include "MathFunctions.h"
 #include "VolumeFile.h"
 
 #include <fstream>
@@ -106,8 +107,15 @@ OperationParameters* OperationCiftiConvert::getParameters()
     ftresetTimeunitsOpt->addStringParameter(1, "unit", "unit identifier (default SECOND)");
     fromText->createOptionalParameter(6, "-reset-scalars", "reset mapping along rows to scalars, taking length from the text file");
     
+    OptionalParameter* toInt16 = ret->createOptionalParameter(7, "-to-int16", "convert to a CIFTI file stored as scaled 16-bit integers");
+    toInt16->addCiftiParameter(1, "cifti-in", "the input cifti file");
+    toInt16->addCiftiOutputParameter(2, "cifti-out", "the output cifti file");
+    OptionalParameter* toInt16RangeOpt = toInt16->createOptionalParameter(3, "-range", "specify the range of values to store, instead of using the range of the input data");
+    toInt16RangeOpt->addDoubleParameter(1, "min", "the lowest value that can be stored");
+    toInt16RangeOpt->addDoubleParameter(2, "max", "the highest value that can be stored");
+    
     AString myText = AString("This command is used to convert a full CIFTI matrix to/from formats that can be used by programs that don't understand CIFTI.  ") +
-        "You must specify exactly one of -to-gifti-ext, -from-gifti-ext, -to-nifti, -from-nifti, -to-text, or -from-text.\n\n" +
+        "You must specify exactly one of -to-gifti-ext, -from-gifti-ext, -to-nifti, -from-nifti, -to-text, -from-text, or -to-int16.\n\n" +
         "If you want to write an existing CIFTI file with a different CIFTI version, see -file-convert, and its -cifti-version-convert option.\n\n" +
         "If you want part of the CIFTI file as a metric, label, or volume file, see -cifti-separate.  " +
         "If you want to create a CIFTI file from metric and/or volume files, see the -cifti-create-* commands.\n\n" +
@@ -115,6 +123,10 @@ OperationParameters* OperationCiftiConvert::getParameters()
         "After importing to CIFTI, you can then expand the file into a standard brainordinates space with -cifti-create-dense-from-template.  " +
         "If you want to export only part of a CIFTI file, first create an roi-restricted CIFTI file with -cifti-restrict-dense-mapping.\n\n" +
         "The -transpose option to -from-gifti-ext is needed if the replacement binary file is in column-major order.\n\n" +
+        "The -to-int16 option writes the same CIFTI file with the INT16 datatype and a scaling slope and intercept in the nifti header, halving the file size.  " +
+        "The data is read back as floating point transparently, with a precision of 1/65535 of the stored range.  " +
+        "Values outside the range given to -range are clamped, NaNs are stored as the minimum value.  " +
+        "To convert back to floating point storage, use -cifti-math with the expression 'x'.\n\n" +
         "The -unit options accept these values:\n";
     vector<CiftiSeriesMap::Unit> units = CiftiSeriesMap::getAllUnits();
     for (int i = 0; i < (int)units.size(); ++i)
@@ -135,12 +147,14 @@ void OperationCiftiConvert::useParameters(OperationParameters* myParams, Progres
     OptionalParameter* fromNifti = myParams->getOptionalParameter(4);
     OptionalParameter* toText = myParams->getOptionalParameter(5);
     OptionalParameter* fromText = myParams->getOptionalParameter(6);
+    OptionalParameter* toInt16 = myParams->getOptionalParameter(7);
     if (toGiftiExt->m_present) ++modes;
     if (fromGiftiExt->m_present) ++modes;
     if (toNifti->m_present) ++modes;
     if (fromNifti->m_present) ++modes;
     if (toText->m_present) ++modes;
     if (fromText->m_present) ++modes;
+    if (toInt16->m_present) ++modes;
     if (modes != 1)
     {
         throw OperationException("you must specify exactly one conversion mode");
@@ -491,4 +505,49 @@ void OperationCiftiConvert::useParameters(OperationParameters* myParams, Progres
             ciftiOut->setRow(temprow.data(), j);
         }
     }
+    if (toInt16->m_present)
+    {
+        CiftiFile* ciftiIn = toInt16->getCifti(1);
+        CiftiFile* ciftiOut = toInt16->getOutputCifti(2);
+        const vector<int64_t>& dims = ciftiIn->getDimensions();
+        vector<float> scratchRow(dims[0]);
+        double minval, maxval;
+        OptionalParameter* rangeOpt = toInt16->getOptionalParameter(3);
+        if (rangeOpt->m_present)
+        {
+            minval = rangeOpt->getDouble(1);
+            maxval = rangeOpt->getDouble(2);
+            if (!(minval < maxval)) throw OperationException("-range minimum must be less than maximum");
+        } else {
+            bool first = true;
+            minval = 0.0;
+            maxval = 0.0;
+            for (MultiDimIterator<int64_t> iter = ciftiIn->getIteratorOverRows(); !iter.atEnd(); ++iter)
+            {
+                ciftiIn->getRow(scratchRow.data(), *iter);
+                for (int64_t i = 0; i < dims[0]; ++i)
+                {
+                    if (MathFunctions::isNumeric(scratchRow[i]))
+                    {
+                        if (first)
+                        {
+                            minval = scratchRow[i];
+                            maxval = scratchRow[i];
+                            first = false;
+                        } else {
+                            if (scratchRow[i] < minval) minval = scratchRow[i];
+                            if (scratchRow[i] > maxval) maxval = scratchRow[i];
+                        }
+                    }
+                }
+            }
+        }
+        ciftiOut->setCiftiXML(ciftiIn->getCiftiXML());
+        ciftiOut->setWritingDataTypeAndScaling(NIFTI_TYPE_INT16, minval, maxval);
+        for (MultiDimIterator<int64_t> iter = ciftiIn->getIteratorOverRows(); !iter.atEnd(); ++iter)
+        {
+            ciftiIn->getRow(scratchRow.data(), *iter);
+            ciftiOut->setRow(scratchRow.data(), *iter);
+        }
+    }
 }
@@ -0,0 +1,213 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "OperationSurfaceGeodesicDistanceAllToAll.h"
+#include "OperationException.h"
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "CiftiFile.h"
+#include "GeodesicHelper.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+AString OperationSurfaceGeodesicDistanceAllToAll::getCommandSwitch()
+{
+    return "-surface-geodesic-distance-all-to-all";
+}
+
+AString OperationSurfaceGeodesicDistanceAllToAll::getShortDescription()
+{
+    return "COMPUTE GEODESIC DISTANCE BETWEEN ALL PAIRS OF VERTICES AS A DCONN";
+}
+
+OperationParameters* OperationSurfaceGeodesicDistanceAllToAll::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    ret->addSurfaceParameter(1, "surface", "the surface to compute on");
+    
+    ret->addCiftiOutputParameter(2, "cifti-out", "the output dconn file");
+    
+    OptionalParameter* roiOpt = ret->createOptionalParameter(3, "-roi", "only output distances between vertices within an roi");
+    roiOpt->addMetricParameter(1, "roi-metric", "the roi to use, as a metric");
+    
+    OptionalParameter* limitOpt = ret->createOptionalParameter(4, "-limit", "stop at a certain distance");
+    limitOpt->addDoubleParameter(1, "limit-mm", "distance in mm to stop at");
+    
+    OptionalParameter* corrAreaOpt = ret->createOptionalParameter(5, "-corrected-areas", "vertex areas to use instead of computing them from the surface");
+    corrAreaOpt->addMetricParameter(1, "area-metric", "the corrected vertex areas, as a metric");
+    
+    ret->createOptionalParameter(6, "-naive", "use only neighbors, don't crawl triangles (not recommended)");
+    
+    OptionalParameter* int16Opt = ret->createOptionalParameter(7, "-int16", "store the output as scaled 16-bit integers, for half the file size");
+    int16Opt->addDoubleParameter(1, "max-mm", "the largest distance that can be stored, larger distances are clamped to it");
+    
+    ret->createOptionalParameter(8, "-symmetric-half", "only compute the distances to vertices at or after each row's vertex");
+    
+    OptionalParameter* memLimitOpt = ret->createOptionalParameter(9, "-mem-limit", "restrict memory used for rows waiting to be written");
+    memLimitOpt->addDoubleParameter(1, "limit-GB", "memory limit in gigabytes, default 1");
+    
+    ret->setHelpText(
+        AString("Computes the geodesic distance from every vertex to every other vertex, and writes it as a dconn file, one row per vertex.  ") +
+        "Rows are computed in parallel in blocks, as many as fit in the memory limit, and each block is written to disk before the next is started, so the whole matrix is never in memory.  " +
+        "Elements that the distance was not computed for, due to -limit, -symmetric-half, or vertices that are not connected, have a value of -1.  " +
+        "The paths used for the distances are allowed to go outside the roi.\n\n" +
+        "The -int16 option writes the output with the INT16 datatype and a scaling slope and intercept in the nifti header, covering the range from -1 to <max-mm>, " +
+        "which gives a precision of about (<max-mm> + 1) / 65535 mm.  " +
+        "When using -limit, <max-mm> can usually be the same as <limit-mm>.\n\n" +
+        "The -symmetric-half option computes each row only until the distances to the row's vertex and all vertices after it are found, leaving the rest of the row as -1.  " +
+        "Since geodesic distance is symmetric, except for small differences due to crawling across triangles, the full matrix is the upper triangle plus its transpose.  " +
+        "This is faster, because the later rows stop early.\n\n" +
+        "If -naive is not specified, it uses not just immediate neighbors, but also neighbors derived from crawling across pairs of triangles that share an edge.  " +
+        "The surface must have its structure set."
+    );
+    return ret;
+}
+
+void OperationSurfaceGeodesicDistanceAllToAll::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    SurfaceFile* mySurf = myParams->getSurface(1);
+    CiftiFile* myCiftiOut = myParams->getOutputCifti(2);
+    int32_t numNodes = mySurf->getNumberOfNodes();
+    const float* roiData = NULL;
+    OptionalParameter* roiOpt = myParams->getOptionalParameter(3);
+    if (roiOpt->m_present)
+    {
+        MetricFile* myRoi = roiOpt->getMetric(1);
+        if (myRoi->getNumberOfNodes() != numNodes) throw OperationException("roi metric does not match surface in number of vertices");
+        roiData = myRoi->getValuePointerForColumn(0);
+    }
+    float limit = -1.0f;
+    OptionalParameter* limitOpt = myParams->getOptionalParameter(4);
+    if (limitOpt->m_present)
+    {
+        limit = (float)limitOpt->getDouble(1);
+        if (limit < 0.0f) throw OperationException("distance limit cannot be negative");
+    }
+    const float* areaData = NULL;
+    OptionalParameter* corrAreaOpt = myParams->getOptionalParameter(5);
+    if (corrAreaOpt->m_present)
+    {
+        MetricFile* corrAreaMetric = corrAreaOpt->getMetric(1);
+        if (corrAreaMetric->getNumberOfNodes() != numNodes) throw OperationException("corrected vertex areas metric does not match surface in number of vertices");
+        areaData = corrAreaMetric->getValuePointerForColumn(0);
+    }
+    bool smooth = !(myParams->getOptionalParameter(6)->m_present);
+    OptionalParameter* int16Opt = myParams->getOptionalParameter(7);
+    if (int16Opt->m_present)
+    {
+        double maxDist = int16Opt->getDouble(1);
+        if (!(maxDist > 0.0)) throw OperationException("-int16 maximum distance must be positive");
+        myCiftiOut->setWritingDataTypeAndScaling(NIFTI_TYPE_INT16, -1.0, maxDist);//must happen before any rows are written
+    }
+    bool symmetricHalf = myParams->getOptionalParameter(8)->m_present;
+    float memLimitGB = 1.0f;
+    OptionalParameter* memLimitOpt = myParams->getOptionalParameter(9);
+    if (memLimitOpt->m_present)
+    {
+        memLimitGB = (float)memLimitOpt->getDouble(1);
+        if (memLimitGB <= 0.0f) throw OperationException("memory limit must be positive");
+    }
+    if (mySurf->getStructure() == StructureEnum::INVALID)
+    {
+        throw OperationException("surface must have a structure set for cifti output");
+    }
+    CiftiBrainModelsMap denseMap;
+    denseMap.addSurfaceModel(numNodes, mySurf->getStructure(), roiData);
+    CiftiXML myXML;
+    myXML.setNumberOfDimensions(2);
+    myXML.setMap(CiftiXML::ALONG_COLUMN, denseMap);
+    myXML.setMap(CiftiXML::ALONG_ROW, denseMap);
+    myCiftiOut->setCiftiXML(myXML);
+    vector<CiftiBrainModelsMap::SurfaceMap> myMap = denseMap.getSurfaceMap(mySurf->getStructure());
+    int64_t numRows = (int64_t)myMap.size();
+    if (numRows == 0) throw OperationException("roi contains no vertices");
+    vector<int32_t> rowNodes(numRows);//cifti index to vertex
+    for (int64_t i = 0; i < numRows; ++i)
+    {
+        rowNodes[myMap[i].m_ciftiIndex] = (int32_t)myMap[i].m_surfaceNode;
+    }
+    int64_t rowsPerBlock = max((int64_t)1, min(numRows, (int64_t)(memLimitGB * 1024 * 1024 * 1024 / (numRows * sizeof(float)))));
+    if (rowsPerBlock < numRows) CaretLogInfo("computing " + AString::number(rowsPerBlock) + " rows at a time");
+    vector<float> blockData(rowsPerBlock * numRows);
+    CaretPointer<GeodesicHelperBase> myGeoBase(new GeodesicHelperBase(mySurf, areaData));//one copy of the neighbor information, shared by the per-thread helpers
+    for (int64_t blockStart = 0; blockStart < numRows; blockStart += rowsPerBlock)
+    {
+        int64_t blockEnd = min(numRows, blockStart + rowsPerBlock);
+#pragma omp CARET_PAR
+        {
+            CaretPointer<GeodesicHelper> myGeoHelp(new GeodesicHelper(myGeoBase));//helpers hold the search state, so one per thread
+            vector<float> surfDists(numNodes), dists;
+            vector<int32_t> nodes, targets;
+#pragma omp CARET_FOR schedule(dynamic)
+            for (int64_t row = blockStart; row < blockEnd; ++row)
+            {
+                float* rowOut = blockData.data() + (row - blockStart) * numRows;
+                int32_t root = rowNodes[row];
+                int64_t firstCol = (symmetricHalf ? row : 0);
+                for (int64_t col = 0; col < firstCol; ++col)
+                {
+                    rowOut[col] = -1.0f;
+                }
+                if (limit >= 0.0f)
+                {
+                    myGeoHelp->getNodesToGeoDist(root, limit, nodes, dists, smooth);
+                    surfDists.assign(numNodes, -1.0f);
+                    for (int64_t i = 0; i < (int64_t)nodes.size(); ++i)
+                    {
+                        surfDists[nodes[i]] = dists[i];
+                    }
+                    for (int64_t col = firstCol; col < numRows; ++col)
+                    {
+                        rowOut[col] = surfDists[rowNodes[col]];
+                    }
+                } else if (symmetricHalf) {
+                    targets.assign(rowNodes.begin() + firstCol, rowNodes.end());
+                    myGeoHelp->getGeoToTheseNodes(root, targets, dists, smooth);//stops once all targets are found
+                    CaretAssert((int64_t)dists.size() == numRows - firstCol);
+                    for (int64_t col = firstCol; col < numRows; ++col)
+                    {
+                        rowOut[col] = dists[col - firstCol];
+                    }
+                } else {
+                    surfDists.assign(numNodes, -1.0f);//the full surface search leaves unreachable vertices untouched
+                    myGeoHelp->getGeoFromNode(root, surfDists, smooth);
+                    for (int64_t col = 0; col < numRows; ++col)
+                    {
+                        rowOut[col] = surfDists[rowNodes[col]];
+                    }
+                }
+            }
+        }
+        for (int64_t row = blockStart; row < blockEnd; ++row)
+        {
+            myCiftiOut->setRow(blockData.data() + (row - blockStart) * numRows, row);
+        }
+        myProgress.reportProgress(((float)blockEnd) / numRows);
+    }
+}
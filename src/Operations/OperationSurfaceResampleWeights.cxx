@@ -0,0 +1,236 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "OperationSurfaceResampleWeights.h"
+#include "OperationException.h"
+
+#include "GiftiLabelTable.h"
+#include "LabelFile.h"
+#include "MetricFile.h"
+#include "PaletteColorMapping.h"
+#include "SurfaceFile.h"
+#include "SurfaceResamplingHelper.h"
+
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+AString OperationSurfaceResampleWeights::getCommandSwitch()
+{
+    return "-surface-resample-weights";
+}
+
+AString OperationSurfaceResampleWeights::getShortDescription()
+{
+    return "PRECOMPUTE OR APPLY SURFACE RESAMPLING WEIGHTS";
+}
+
+OperationParameters* OperationSurfaceResampleWeights::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    
+    OptionalParameter* createOpt = ret->createOptionalParameter(1, "-create", "compute resampling weights and save them to a file");
+    createOpt->addSurfaceParameter(1, "current-sphere", "a sphere surface with the mesh that the data is currently on");
+    createOpt->addSurfaceParameter(2, "new-sphere", "a sphere surface that is in register with <current-sphere> and has the desired output mesh");
+    createOpt->addStringParameter(3, "method", "the method name");
+    createOpt->addStringParameter(4, "weights-out", "output - the weight file to write");
+    OptionalParameter* areaSurfsOpt = createOpt->createOptionalParameter(5, "-area-surfs", "specify surfaces to do vertex area correction based on");
+    areaSurfsOpt->addSurfaceParameter(1, "current-area", "a relevant anatomical surface with <current-sphere> mesh");
+    areaSurfsOpt->addSurfaceParameter(2, "new-area", "a relevant anatomical surface with <new-sphere> mesh");
+    OptionalParameter* areaMetricsOpt = createOpt->createOptionalParameter(6, "-area-metrics", "specify vertex area metrics to do area correction based on");
+    areaMetricsOpt->addMetricParameter(1, "current-area", "a metric file with vertex areas for <current-sphere> mesh");
+    areaMetricsOpt->addMetricParameter(2, "new-area", "a metric file with vertex areas for <new-sphere> mesh");
+    OptionalParameter* roiOpt = createOpt->createOptionalParameter(7, "-current-roi", "use an input roi on the current mesh to exclude non-data vertices");
+    roiOpt->addMetricParameter(1, "roi-metric", "the roi, as a metric file");
+    
+    OptionalParameter* applyMetricOpt = ret->createOptionalParameter(2, "-apply-metric", "resample a metric file with precomputed weights");
+    applyMetricOpt->addStringParameter(1, "weights", "the weight file");
+    applyMetricOpt->addMetricParameter(2, "metric-in", "the metric file to resample");
+    applyMetricOpt->addMetricOutputParameter(3, "metric-out", "the output metric");
+    OptionalParameter* metricValidRoiOpt = applyMetricOpt->createOptionalParameter(4, "-valid-roi-out", "output the ROI of vertices that got data from valid source vertices");
+    metricValidRoiOpt->addMetricOutputParameter(1, "roi-out", "the output roi as a metric");
+    applyMetricOpt->createOptionalParameter(5, "-largest", "use only the value of the vertex with the largest weight");
+    
+    OptionalParameter* applyLabelOpt = ret->createOptionalParameter(3, "-apply-label", "resample a label file with precomputed weights");
+    applyLabelOpt->addStringParameter(1, "weights", "the weight file");
+    applyLabelOpt->addLabelParameter(2, "label-in", "the label file to resample");
+    applyLabelOpt->addLabelOutputParameter(3, "label-out", "the output label file");
+    OptionalParameter* labelValidRoiOpt = applyLabelOpt->createOptionalParameter(4, "-valid-roi-out", "output the ROI of vertices that got data from valid source vertices");
+    labelValidRoiOpt->addMetricOutputParameter(1, "roi-out", "the output roi as a metric");
+    applyLabelOpt->createOptionalParameter(5, "-largest", "use only the label of the vertex with the largest weight");
+    
+    AString myHelpText =
+        AString("Computing resampling weights is the slowest part of -metric-resample and -label-resample.  ") +
+        "Use -create to compute the weights for a pair of spheres once, then use -apply-metric or -apply-label to resample any number of files with them.  " +
+        "The options to -create have the same meaning as in -metric-resample, and the -apply modes give the same results as -metric-resample and -label-resample would.\n\n" +
+        "Weight files are stored in the native byte order of the machine, and are memory mapped when read.  " +
+        "To reuse weights automatically in all resampling commands instead, use the global option -resample-cache.\n\n" +
+        "You must specify exactly one of -create, -apply-metric, or -apply-label.\n\n" +
+        "The <method> argument must be one of the following:\n\n";
+    vector<SurfaceResamplingMethodEnum::Enum> allEnums;
+    SurfaceResamplingMethodEnum::getAllEnums(allEnums);
+    for (int i = 0; i < (int)allEnums.size(); ++i)
+    {
+        myHelpText += SurfaceResamplingMethodEnum::toName(allEnums[i]) + "\n";
+    }
+    ret->setHelpText(myHelpText);
+    return ret;
+}
+
+void OperationSurfaceResampleWeights::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    int modes = 0;
+    OptionalParameter* createOpt = myParams->getOptionalParameter(1);
+    OptionalParameter* applyMetricOpt = myParams->getOptionalParameter(2);
+    OptionalParameter* applyLabelOpt = myParams->getOptionalParameter(3);
+    if (createOpt->m_present) ++modes;
+    if (applyMetricOpt->m_present) ++modes;
+    if (applyLabelOpt->m_present) ++modes;
+    if (modes != 1)
+    {
+        throw OperationException("you must specify exactly one of -create, -apply-metric, or -apply-label");
+    }
+    if (createOpt->m_present)
+    {
+        SurfaceFile* curSphere = createOpt->getSurface(1);
+        SurfaceFile* newSphere = createOpt->getSurface(2);
+        bool ok = false;
+        SurfaceResamplingMethodEnum::Enum myMethod = SurfaceResamplingMethodEnum::fromName(createOpt->getString(3), &ok);
+        if (!ok)
+        {
+            throw OperationException("invalid method name");
+        }
+        AString weightsOut = createOpt->getString(4);
+        vector<float> curAreasTemp, newAreasTemp;
+        const float* curAreaData = NULL, *newAreaData = NULL;
+        OptionalParameter* areaSurfsOpt = createOpt->getOptionalParameter(5);
+        OptionalParameter* areaMetricsOpt = createOpt->getOptionalParameter(6);
+        if (areaSurfsOpt->m_present && areaMetricsOpt->m_present)
+        {
+            throw OperationException("only one of -area-surfs and -area-metrics can be specified");
+        }
+        if (areaSurfsOpt->m_present)
+        {
+            SurfaceFile* curAreaSurf = areaSurfsOpt->getSurface(1);
+            SurfaceFile* newAreaSurf = areaSurfsOpt->getSurface(2);
+            if (curAreaSurf->getNumberOfNodes() != curSphere->getNumberOfNodes()) throw OperationException("current area surface has different number of vertices than current sphere");
+            if (newAreaSurf->getNumberOfNodes() != newSphere->getNumberOfNodes()) throw OperationException("new area surface has different number of vertices than new sphere");
+            curAreaSurf->computeNodeAreas(curAreasTemp);
+            newAreaSurf->computeNodeAreas(newAreasTemp);
+            curAreaData = curAreasTemp.data();
+            newAreaData = newAreasTemp.data();
+        }
+        if (areaMetricsOpt->m_present)
+        {
+            MetricFile* curAreas = areaMetricsOpt->getMetric(1);
+            MetricFile* newAreas = areaMetricsOpt->getMetric(2);
+            if (curAreas->getNumberOfNodes() != curSphere->getNumberOfNodes()) throw OperationException("current vertex area data has different number of vertices than current sphere");
+            if (newAreas->getNumberOfNodes() != newSphere->getNumberOfNodes()) throw OperationException("new vertex area data has different number of vertices than new sphere");
+            curAreaData = curAreas->getValuePointerForColumn(0);
+            newAreaData = newAreas->getValuePointerForColumn(0);
+        }
+        if (myMethod != SurfaceResamplingMethodEnum::BARYCENTRIC && curAreaData == NULL)
+        {
+            throw OperationException("specified method does area correction, but no vertex area data given");
+        }
+        const float* roiData = NULL;
+        OptionalParameter* roiOpt = createOpt->getOptionalParameter(7);
+        if (roiOpt->m_present)
+        {
+            MetricFile* currentRoi = roiOpt->getMetric(1);
+            if (currentRoi->getNumberOfNodes() != curSphere->getNumberOfNodes()) throw OperationException("roi metric has different number of vertices than current sphere");
+            roiData = currentRoi->getValuePointerForColumn(0);
+        }
+        SurfaceResamplingHelper myHelp(myMethod, curSphere, newSphere, curAreaData, newAreaData, roiData);
+        myHelp.writeToFile(weightsOut);
+    }
+    if (applyMetricOpt->m_present)
+    {
+        SurfaceResamplingHelper myHelp(applyMetricOpt->getString(1));
+        MetricFile* metricIn = applyMetricOpt->getMetric(2);
+        MetricFile* metricOut = applyMetricOpt->getOutputMetric(3);
+        if (metricIn->getNumberOfNodes() != myHelp.getNumberOfCurrentNodes()) throw OperationException("input metric has different number of vertices than the weight file expects");
+        int numColumns = metricIn->getNumberOfColumns(), numNewNodes = myHelp.getNumberOfNewNodes();
+        bool largest = applyMetricOpt->getOptionalParameter(5)->m_present;
+        metricOut->setNumberOfNodesAndColumns(numNewNodes, numColumns);
+        metricOut->setStructure(metricIn->getStructure());
+        vector<float> colScratch(numNewNodes, 0.0f);
+        OptionalParameter* validRoiOpt = applyMetricOpt->getOptionalParameter(4);
+        if (validRoiOpt->m_present)
+        {
+            MetricFile* validRoiOut = validRoiOpt->getOutputMetric(1);
+            validRoiOut->setNumberOfNodesAndColumns(numNewNodes, 1);
+            validRoiOut->setStructure(metricIn->getStructure());
+            myHelp.getResampleValidROI(colScratch.data());
+            validRoiOut->setValuesForColumn(0, colScratch.data());
+        }
+        for (int i = 0; i < numColumns; ++i)
+        {
+            metricOut->setColumnName(i, metricIn->getColumnName(i));
+            *metricOut->getPaletteColorMapping(i) = *metricIn->getPaletteColorMapping(i);
+            if (largest)
+            {
+                myHelp.resampleLargest(metricIn->getValuePointerForColumn(i), colScratch.data());
+                metricOut->setValuesForColumn(i, colScratch.data());
+            }
+        }
+        if (!largest)
+        {
+            myHelp.resampleMetric(metricIn, metricOut);
+        }
+    }
+    if (applyLabelOpt->m_present)
+    {
+        SurfaceResamplingHelper myHelp(applyLabelOpt->getString(1));
+        LabelFile* labelIn = applyLabelOpt->getLabel(2);
+        LabelFile* labelOut = applyLabelOpt->getOutputLabel(3);
+        if (labelIn->getNumberOfNodes() != myHelp.getNumberOfCurrentNodes()) throw OperationException("input label file has different number of vertices than the weight file expects");
+        int numColumns = labelIn->getNumberOfColumns(), numNewNodes = myHelp.getNumberOfNewNodes();
+        bool largest = applyLabelOpt->getOptionalParameter(5)->m_present;
+        labelOut->setNumberOfNodesAndColumns(numNewNodes, numColumns);
+        labelOut->setStructure(labelIn->getStructure());
+        *labelOut->getLabelTable() = *labelIn->getLabelTable();
+        OptionalParameter* validRoiOpt = applyLabelOpt->getOptionalParameter(4);
+        if (validRoiOpt->m_present)
+        {
+            MetricFile* validRoiOut = validRoiOpt->getOutputMetric(1);
+            validRoiOut->setNumberOfNodesAndColumns(numNewNodes, 1);
+            validRoiOut->setStructure(labelIn->getStructure());
+            vector<float> scratch(numNewNodes);
+            myHelp.getResampleValidROI(scratch.data());
+            validRoiOut->setValuesForColumn(0, scratch.data());
+        }
+        int32_t unusedLabel = labelIn->getLabelTable()->getUnassignedLabelKey();
+        vector<int32_t> colScratch(numNewNodes, unusedLabel);
+        for (int i = 0; i < numColumns; ++i)
+        {
+            labelOut->setColumnName(i, labelIn->getColumnName(i));
+            if (largest)
+            {
+                myHelp.resampleLargest(labelIn->getLabelKeyPointerForColumn(i), colScratch.data(), unusedLabel);
+            } else {
+                myHelp.resamplePopular(labelIn->getLabelKeyPointerForColumn(i), colScratch.data(), unusedLabel);
+            }
+            labelOut->setLabelKeysForColumn(i, colScratch.data());
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "OperationWbsparseConvert.h"
+#include "OperationException.h"
+
+#include "CaretSparseFile.h"
+
+using namespace caret;
+using namespace std;
+
+AString OperationWbsparseConvert::getCommandSwitch()
+{
+    return "-wbsparse-convert";
+}
+
+AString OperationWbsparseConvert::getShortDescription()
+{
+    return "CHANGE THE ENCODING OF A WBSPARSE FILE";
+}
+
+OperationParameters* OperationWbsparseConvert::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    ret->addStringParameter(1, "wbsparse-in", "the input wbsparse file");
+    
+    ret->addStringParameter(2, "wbsparse-out", "output - the output wbsparse file");//HACK: fake the output format since we don't have a wbsparse parameter type (or file type, really)
+    
+    OptionalParameter* versionOpt = ret->createOptionalParameter(3, "-version", "specify the format version of the output file");
+    versionOpt->addIntegerParameter(1, "version", "the version number, default 2");
+    
+    ret->createOptionalParameter(4, "-compress-rows", "also compress each row with zlib, only for version 2");
+    
+    ret->setHelpText(
+        AString("Version 1 wbsparse files store each nonzero value as two 64-bit integers.  ") +
+        "Version 2 files store delta-encoded column indices and the values as variable length integers, and have an index of row offsets, " +
+        "which usually makes them several times smaller, and faster to read.  " +
+        "Use -compress-rows to make the file smaller still, at the cost of decompression time when reading rows.  " +
+        "Other commands write version 1 unless asked otherwise, because older versions of wb_command can only read version 1."
+    );
+    return ret;
+}
+
+void OperationWbsparseConvert::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    AString inputName = myParams->getString(1);
+    AString outputName = myParams->getString(2);
+    int version = 2;
+    OptionalParameter* versionOpt = myParams->getOptionalParameter(3);
+    if (versionOpt->m_present)
+    {
+        version = (int)versionOpt->getInteger(1);
+        if (version != 1 && version != 2) throw OperationException("version must be 1 or 2");
+    }
+    bool compressRows = myParams->getOptionalParameter(4)->m_present;
+    if (compressRows && version != 2) throw OperationException("-compress-rows requires version 2");
+    if (inputName == outputName) throw OperationException("input and output files must be different");
+    CaretSparseFile inFile(inputName);
+    CaretSparseFileWriter outFile(outputName, inFile.getCiftiXML(), version, compressRows);
+    const int64_t numRows = inFile.getDimensions()[1];
+    vector<int64_t> indices, values;
+    for (int64_t i = 0; i < numRows; ++i)
+    {
+        inFile.getRowSparse(i, indices, values);
+        if (indices.size() != 0)
+        {
+            outFile.writeRowSparse(i, indices, values);
+        }
+    }
+    outFile.finish();
+}
@@ -46,8 +46,12 @@ OperationParameters* OperationWbsparseMergeDense::getParameters()
     ParameterComponent* wbsparseOpt = ret->createRepeatableParameter(3, "-wbsparse", "specify an input wbsparse file");
     wbsparseOpt->addStringParameter(1, "wbsparse-in", "a wbsparse file to merge");
     
+    OptionalParameter* versionOpt = ret->createOptionalParameter(4, "-version", "specify the format version of the output file");
+    versionOpt->addIntegerParameter(1, "version", "the version number, default 1");
+    
     ret->setHelpText(
-        AString("The input wbsparse files must have matching mappings along the direction not specified, and the mapping along the specified direction must be brain models.")
+        AString("The input wbsparse files must have matching mappings along the direction not specified, and the mapping along the specified direction must be brain models.  ") +
+        "Version 2 output is usually several times smaller, but can't be read by older versions of wb_command, see -wbsparse-convert."
     );
     return ret;
 }
@@ -66,6 +70,13 @@ void OperationWbsparseMergeDense::useParameters(OperationParameters* myParams, P
         throw OperationException("incorrect string for direction, use ROW or COLUMN");
     }
     AString outputName = myParams->getString(2);
+    int version = 1;
+    OptionalParameter* versionOpt = myParams->getOptionalParameter(4);
+    if (versionOpt->m_present)
+    {
+        version = (int)versionOpt->getInteger(1);
+        if (version != 1 && version != 2) throw OperationException("version must be 1 or 2");
+    }
     const vector<ParameterComponent*>& myInstances = *(myParams->getRepeatableParameterInstances(3));
     vector<CaretPointer<CaretSparseFile> > wbsparseList;
     int numCifti = (int)myInstances.size();
@@ -152,7 +163,7 @@ void OperationWbsparseMergeDense::useParameters(OperationParameters* myParams, P
     int numOutModels = (int)sourceWbsparse.size();
     CaretAssert(numOutModels == (int)newDenseMap.getModelInfo().size());
     int64_t outColSize = outXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
-    CaretSparseFileWriter myWriter(outputName, outXML);
+    CaretSparseFileWriter myWriter(outputName, outXML, version);
     vector<CiftiBrainModelsMap::ModelInfo> outModelInfo = newDenseMap.getModelInfo();
     switch (myDir)
     {
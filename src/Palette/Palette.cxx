@@ -18,6 +18,7 @@
  */
 /*LICENSE_END*/
 
+#include <cmath>
 #include <limits>
 
 #include "CaretAssert.h"
@@ -491,6 +492,67 @@ Palette::getPaletteColor(
     }
 }
 
+/**
+ * Get a lookup table of this palette's colors, so that many scalars can be
+ * colored without searching the palette for each one.  The table is built
+ * the first time it is requested, and rebuilt if the palette has changed.
+ *
+ * @param interpolateColorFlag
+ *    Same as the parameter to getPaletteColor().
+ * @return
+ *    Shared lookup table, it stays valid even if the palette changes later.
+ */
+CaretPointer<const PaletteLookupTable>
+Palette::getLookupTable(const bool interpolateColorFlag) const
+{
+    const int32_t numScalarColors = this->getNumberOfScalarsAndColors();
+    std::vector<float> source;
+    source.reserve(numScalarColors * 6);
+    for (int32_t i = 0; i < numScalarColors; i++) {
+        const PaletteScalarAndColor* psac = this->getScalarAndColor(i);
+        source.push_back(psac->getScalar());
+        const float* rgba = psac->getColor();
+        source.insert(source.end(), rgba, rgba + 4);
+        source.push_back(psac->isNoneColor() ? 1.0f : 0.0f);
+    }
+    
+    CaretMutexLocker locked(&this->lookupTablesMutex);
+    if (source != this->lookupTablesSource) {
+        this->lookupTables[0] = CaretPointer<const PaletteLookupTable>();
+        this->lookupTables[1] = CaretPointer<const PaletteLookupTable>();
+        this->lookupTablesSource = source;
+    }
+    const int32_t whichTable = (interpolateColorFlag ? 1 : 0);
+    if (this->lookupTables[whichTable] == NULL) {
+        const int32_t numSteps = PaletteLookupTable::NUM_STEPS;
+        const float halfSteps = numSteps / 2;
+        PaletteLookupTable* table = new PaletteLookupTable();
+        table->rgba.resize((numSteps + 1) * 4);
+        for (int32_t i = 0; i <= numSteps; i++) {
+            this->getPaletteColor(i / halfSteps - 1.0f,
+                                  interpolateColorFlag,
+                                  &table->rgba[i * 4]);
+        }
+        /*
+         * Colors are linear in the normalized value between palette scalars,
+         * so only intervals containing a palette scalar need a full search.
+         * Also mark the neighboring intervals, so that rounding in the
+         * interval computation can't cross a palette scalar.
+         */
+        table->linearFlags.resize(numSteps, 1);
+        for (int32_t i = 0; i < numScalarColors; i++) {
+            const int32_t step = (int32_t)std::floor((this->getScalarAndColor(i)->getScalar() + 1.0f) * halfSteps);
+            for (int32_t j = step - 1; j <= step + 1; j++) {
+                if ((j >= 0) && (j < numSteps)) {
+                    table->linearFlags[j] = 0;
+                }
+            }
+        }
+        this->lookupTables[whichTable].grabNew(table);
+    }
+    return this->lookupTables[whichTable];
+}
+
 /**
  * Set this object has been modified.
  *
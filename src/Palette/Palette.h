@@ -25,7 +25,9 @@
 #include <vector>
 
 #include "CaretAssert.h"
+#include "CaretMutex.h"
 #include "CaretObject.h"
+#include "CaretPointer.h"
 #include "TracksModificationInterface.h"
 
 
@@ -33,6 +35,20 @@ namespace caret {
 
     class PaletteScalarAndColor;
 
+    /**
+     * Palette colors sampled at evenly spaced normalized values, for coloring many scalars quickly.
+     */
+    struct PaletteLookupTable {
+        /**number of intervals between -1.0 and 1.0, so there are NUM_STEPS + 1 sampled colors */
+        static const int32_t NUM_STEPS = 4096;
+        
+        /**RGBA at each interval boundary, from -1.0 to 1.0 */
+        std::vector<float> rgba;
+        
+        /**per interval, nonzero when no palette scalar lies within it, so interpolating between the boundary colors matches getPaletteColor() */
+        std::vector<uint8_t> linearFlags;
+    };
+    
     /**
      * A color palette.
      */
@@ -96,6 +112,8 @@ namespace caret {
                              const bool interpolateColorFlag,
                              float rgbaOut[4]) const;
         
+        CaretPointer<const PaletteLookupTable> getLookupTable(const bool interpolateColorFlag) const;
+        
         void setModified();
         
         void clearModified();
@@ -125,6 +143,15 @@ namespace caret {
         /**The scalars in the palette. */
         std::vector<PaletteScalarAndColor*> paletteScalars;
         
+        /**Lookup tables without and with interpolation, built on demand (DO NOT CLONE) */
+        mutable CaretPointer<const PaletteLookupTable> lookupTables[2];
+        
+        /**Scalars and colors the lookup tables were built from, palette entries can be modified through getScalarAndColor() */
+        mutable std::vector<float> lookupTablesSource;
+        
+        /**Protects the lookup tables when coloring from multiple threads */
+        mutable CaretMutex lookupTablesMutex;
+        
     };
 
     
@@ -0,0 +1,336 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "BatchRunnerTest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "CaretException.h"
+#include "CommandBatchRunner.h"
+#include "CommandFileCache.h"
+#include "CommandOperationManager.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace caret;
+using namespace std;
+
+BatchRunnerTest::BatchRunnerTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    vector<AString> makeList(const char* a, const char* b = NULL, const char* c = NULL, const char* d = NULL)
+    {
+        vector<AString> ret;
+        const char* items[4] = { a, b, c, d };
+        for (int i = 0; i < 4 && items[i] != NULL; ++i)
+        {
+            ret.push_back(items[i]);
+        }
+        return ret;
+    }
+
+    vector<AString> tokensOf(const AString& line)
+    {
+        vector<AString> ret;
+        if (!CommandBatchRunner::tokenizeLine(line, ret)) throw CaretException("failed to tokenize '" + line + "'");
+        return ret;
+    }
+
+    bool contains(const vector<AString>& list, const AString& item)
+    {
+        return find(list.begin(), list.end(), item) != list.end();
+    }
+
+    void writeMetric(const AString& fileName, const vector<float>& values)
+    {
+        MetricFile myMetric;
+        myMetric.setNumberOfNodesAndColumns(values.size(), 1);
+        myMetric.setStructure(StructureEnum::CORTEX_LEFT);
+        myMetric.setValuesForColumn(0, values.data());
+        myMetric.writeFile(fileName);
+    }
+
+    void writeScript(const AString& fileName, const AString& contents)
+    {
+        QFile myFile(fileName);
+        if (!myFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) throw CaretException("failed to open '" + fileName + "' for writing");
+        myFile.write(contents.toLocal8Bit());
+    }
+}
+
+void BatchRunnerTest::checkTokens(const AString& line, const vector<AString>& expected)
+{
+    vector<AString> tokens;
+    if (!CommandBatchRunner::tokenizeLine(line, tokens))
+    {
+        setFailed("tokenizing <" + line + "> reported an incomplete line");
+        return;
+    }
+    if (tokens != expected)
+    {
+        AString got;
+        for (int i = 0; i < (int)tokens.size(); ++i)
+        {
+            got += "<" + tokens[i] + ">";
+        }
+        setFailed("tokenizing <" + line + "> gave " + got);
+    }
+}
+
+void BatchRunnerTest::tokenizeTest()
+{
+    checkTokens("-metric-math 'x + 1' out.func.gii", makeList("-metric-math", "x + 1", "out.func.gii"));
+    checkTokens("  a\t b  ", makeList("a", "b"));
+    checkTokens("\"say \\\"hi\\\" \\\\ \\n\"", makeList("say \"hi\" \\ \\n"));//only quote and backslash are escaped inside double quotes
+    checkTokens("'it\\'s", makeList("it\\s"));//no escapes inside single quotes, the quote ends the string
+    checkTokens("a\\ b c", makeList("a b", "c"));
+    checkTokens("pre'fix'\"ed\" next", makeList("prefixed", "next"));
+    checkTokens("'' \"\"", makeList("", ""));//empty quoted arguments are still arguments
+    checkTokens("a # comment 'unterminated", makeList("a"));
+    checkTokens("a#b", makeList("a#b"));//only a comment at the start of a word
+    checkTokens("# only a comment", vector<AString>());
+    checkTokens("wb_command -version", makeList("-version"));
+    checkTokens("/opt/workbench/bin/wb_command -version", makeList("-version"));
+    vector<AString> tokens;
+    if (CommandBatchRunner::tokenizeLine("a 'unterminated", tokens)) setFailed("unterminated single quote was accepted");
+    if (CommandBatchRunner::tokenizeLine("a \"unterminated", tokens)) setFailed("unterminated double quote was accepted");
+    if (CommandBatchRunner::tokenizeLine("a continued \\", tokens)) setFailed("trailing continuation backslash was accepted");
+}
+
+void BatchRunnerTest::lineFilesTest(const AString& tempDir)
+{
+    CommandOperationManager* manager = CommandOperationManager::getCommandOperationManager();
+    const AString metricA = tempDir + "/a.func.gii", metricB = tempDir + "/b.func.gii", labelList = tempDir + "/labels.txt",
+        labelOut = tempDir + "/out.label.gii", sphere = tempDir + "/sphere.surf.gii";
+    vector<AString> inputs, outputs, shared;
+    if (!CommandBatchRunner::getLineFiles(manager, tokensOf("-metric-math 'x * 2' " + metricB + " -var x " + metricA), inputs, outputs, shared))
+    {
+        setFailed("-metric-math line was treated as a barrier");
+    } else {
+        if (inputs != vector<AString>(1, metricA)) setFailed("-metric-math line has the wrong inputs");
+        if (outputs != vector<AString>(1, metricB)) setFailed("-metric-math line has the wrong outputs");
+        if (!shared.empty()) setFailed("metrics should not be shared between commands");
+    }
+    if (!CommandBatchRunner::getLineFiles(manager, tokensOf("-metric-label-import " + metricA + " " + labelList + " " + labelOut), inputs, outputs, shared))
+    {
+        setFailed("-metric-label-import line was treated as a barrier");
+    } else {//a file name in a string parameter of a command with outputs is only read, so many commands can share a label list
+        if (!contains(inputs, labelList)) setFailed("label list file was not treated as an input");
+        if (contains(outputs, labelList)) setFailed("label list file was treated as an output");
+    }
+    if (!CommandBatchRunner::getLineFiles(manager, tokensOf("-set-structure " + metricA + " CORTEX_LEFT"), inputs, outputs, shared))
+    {
+        setFailed("-set-structure line was treated as a barrier");
+    } else {//no outputs of its own, so it modifies the string-named file in place
+        if (!contains(outputs, metricA)) setFailed("in-place modified file was not treated as an output");
+    }
+    if (!CommandBatchRunner::getLineFiles(manager, tokensOf("-metric-smoothing " + sphere + " " + metricA + " 2 " + metricB), inputs, outputs, shared))
+    {
+        setFailed("-metric-smoothing line was treated as a barrier");
+    } else {
+        if (shared != vector<AString>(1, sphere)) setFailed("surface input was not marked as shared");
+    }
+    if (CommandBatchRunner::getLineFiles(manager, tokensOf("-metric-math 'x' " + metricB + " -var x " + metricA + " -logging INFO"), inputs, outputs, shared))
+    {
+        setFailed("line with a global option was not treated as a barrier");
+    }
+    if (CommandBatchRunner::getLineFiles(manager, tokensOf("-version"), inputs, outputs, shared)) setFailed("-version was not treated as a barrier");
+    if (CommandBatchRunner::getLineFiles(manager, tokensOf("-metric-math 'x' " + metricB + " -nonexistent-option"), inputs, outputs, shared))
+    {
+        setFailed("line with a parse error was not treated as a barrier");
+    }
+}
+
+void BatchRunnerTest::cacheTest(const AString& tempDir)
+{
+    const AString metricName = tempDir + "/cached.func.gii", sphereName = tempDir + "/cached.surf.gii";
+    const int NUM_NODES = 100;
+    vector<float> values(NUM_NODES);
+    for (int i = 0; i < NUM_NODES; ++i)
+    {
+        values[i] = i;
+    }
+    writeMetric(metricName, values);
+    SurfaceFile sphere;
+    AlgorithmSurfaceCreateSphere(NULL, 500, &sphere);
+    sphere.writeFile(sphereName);
+    CommandFileCache::enable();
+    CommandFileCache::resetThreadStatistics();
+    int64_t hits = 0, misses = 0;
+    {
+        CaretPointer<MetricFile> first = CommandFileCache::getMetric(metricName);
+        first->setValue(0, 0, -1000.0f);//commands may modify their inputs
+        CaretPointer<MetricFile> second = CommandFileCache::getMetric(metricName);
+        CommandFileCache::getThreadStatistics(hits, misses);
+        if (hits != 1 || misses != 1) setFailed("reading a metric twice should be one miss and one hit, got " + AString::number(misses) + " and " + AString::number(hits));
+        if (first == second) setFailed("cached metrics should be given out as copies");
+        if (second->getValue(0, 0) != 0.0f) setFailed("modifying a cached metric changed the next copy given out");
+        if (second->getNumberOfNodes() != NUM_NODES || second->getValue(NUM_NODES - 1, 0) != NUM_NODES - 1) setFailed("cached metric copy has the wrong contents");
+        if (second->getFileName() != first->getFileName()) setFailed("cached metric copy lost its file name");
+    }
+    {//invalidated before an output is written over it
+        CommandFileCache::invalidate(metricName);
+        CommandFileCache::resetThreadStatistics();
+        CommandFileCache::getMetric(metricName);
+        CommandFileCache::getThreadStatistics(hits, misses);
+        if (misses != 1) setFailed("invalidated metric was not read again");
+    }
+    {//changed on disk by something other than a batch command
+        values.push_back(NUM_NODES);
+        writeMetric(metricName, values);
+        CommandFileCache::resetThreadStatistics();
+        CaretPointer<MetricFile> changed = CommandFileCache::getMetric(metricName);
+        CommandFileCache::getThreadStatistics(hits, misses);
+        if (misses != 1 || changed->getNumberOfNodes() != NUM_NODES + 1) setFailed("metric changed on disk was not read again");
+    }
+    {//surfaces are shared to keep their helpers, and dropped when modified
+        CommandFileCache::resetThreadStatistics();
+        CaretPointer<SurfaceFile> first = CommandFileCache::getSurface(sphereName);
+        CaretPointer<SurfaceFile> second = CommandFileCache::getSurface(sphereName);
+        if (first != second) setFailed("cached surface was not shared");
+        CommandFileCache::releaseModified();
+        CaretPointer<SurfaceFile> third = CommandFileCache::getSurface(sphereName);
+        if (third != first) setFailed("unmodified surface was dropped from the cache");
+        third->setModified();
+        CommandFileCache::releaseModified();
+        CaretPointer<SurfaceFile> fourth = CommandFileCache::getSurface(sphereName);
+        if (fourth == first) setFailed("modified surface was not dropped from the cache");
+        CommandFileCache::getThreadStatistics(hits, misses);
+        if (hits != 2 || misses != 2) setFailed("surface reads should be two misses and two hits, got " + AString::number(misses) + " and " + AString::number(hits));
+    }
+    CommandFileCache::disable();
+}
+
+void BatchRunnerTest::scheduleTest(const AString& tempDir)
+{
+    CommandOperationManager* manager = CommandOperationManager::getCommandOperationManager();
+    const int NUM_NODES = 100, NUM_BIG_NODES = 300000, NUM_INDEPENDENT = 6;
+    vector<float> values(NUM_NODES);
+    for (int i = 0; i < NUM_NODES; ++i)
+    {
+        values[i] = i;
+    }
+    vector<float> bigValues(NUM_BIG_NODES);
+    for (int i = 0; i < NUM_BIG_NODES; ++i)
+    {
+        bigValues[i] = i;
+    }
+    const AString metricA = tempDir + "/a.func.gii", metricB = tempDir + "/b.func.gii", metricC = tempDir + "/c.func.gii", metricD = tempDir + "/d.func.gii";
+    const AString bigMetric = tempDir + "/big.func.gii";
+    writeMetric(metricA, values);
+    writeMetric(bigMetric, bigValues);
+    QFile::remove(metricB);
+    //b = a + 1, c = 2b, then a is overwritten after line 1 reads it, and d reads the new a: d = (c - 3) + b = 3a
+    AString script = "# dependent commands, run with more jobs than the chain allows\n"
+                     "wb_command -metric-math 'x + 1' " + metricB + " -var x " + metricA + "\n"
+                     "-metric-math 'x * 2' " + metricC + " \\\n   -var x " + metricB + "\n"
+                     "\n"
+                     "-metric-math 'x - 3' " + metricA + " -var x " + metricC + "\n"
+                     "-metric-math 'x + y' " + metricD + " -var x " + metricA + " -var y " + metricB + "\n"
+                     "# independent uses of the same command, these should run alongside each other and the chain\n";
+    for (int k = 0; k < NUM_INDEPENDENT; ++k)
+    {
+        script += "-metric-math 'x * " + AString::number(k + 2) + "' " + tempDir + "/scaled" + AString::number(k) + ".func.gii -var x " + bigMetric + "\n";
+    }
+    const AString scriptName = tempDir + "/script.txt";
+    writeScript(scriptName, script);
+    CommandBatchRunner::run(manager, scriptName, 4);
+    MetricFile result;
+    result.readFile(metricD);
+    if (result.getNumberOfNodes() != NUM_NODES)
+    {
+        setFailed("batch output has the wrong number of vertices");
+    } else {
+        for (int i = 0; i < NUM_NODES; ++i)
+        {
+            if (result.getValue(i, 0) != 3.0f * i)
+            {
+                setFailed("batch commands ran out of order, vertex " + AString::number(i) + " is " + AString::number(result.getValue(i, 0)) + ", expected " + AString::number(3 * i));
+                break;
+            }
+        }
+    }
+    for (int k = 0; k < NUM_INDEPENDENT; ++k)
+    {
+        MetricFile scaled;
+        scaled.readFile(tempDir + "/scaled" + AString::number(k) + ".func.gii");
+        if (scaled.getNumberOfNodes() != NUM_BIG_NODES)
+        {
+            setFailed("independent batch output " + AString::number(k) + " has the wrong number of vertices");
+            continue;
+        }
+        const float* scaledData = scaled.getValuePointerForColumn(0);
+        for (int i = 0; i < NUM_BIG_NODES; ++i)
+        {
+            if (scaledData[i] != (float)(k + 2) * i)
+            {
+                setFailed("independent batch output " + AString::number(k) + " is wrong at vertex " + AString::number(i) + ": " + AString::number(scaledData[i]));
+                break;
+            }
+        }
+    }
+    if (CommandBatchRunner::getLastPeakJobs() < 2) setFailed("independent batch lines never ran at the same time");
+    if (CommandBatchRunner::getLastPeakJobs() > 4) setFailed("batch ran more lines at once than the number of jobs");
+    if (CommandFileCache::isEnabled() || CommandBatchRunner::isRunning()) setFailed("batch mode did not clean up after finishing");
+    //process-wide settings on a batch line would leak into later lines
+    writeScript(scriptName, "-metric-math 'x' " + metricB + " -var x " + metricA + " -gifti-compression 9\n");
+    bool threw = false;
+    try
+    {
+        CommandBatchRunner::run(manager, scriptName, 1);
+    } catch (CaretException& e) {
+        threw = true;
+        if (!e.whatString().contains("-gifti-compression")) setFailed("unexpected error for a global option on a batch line: " + e.whatString());
+    }
+    if (!threw) setFailed("global option on a batch line was accepted");
+    if (CommandFileCache::isEnabled() || CommandBatchRunner::isRunning()) setFailed("batch mode did not clean up after a failure");
+}
+
+void BatchRunnerTest::execute()
+{
+    tokenizeTest();
+    QString tempDir = QDir::tempPath() + "/wb_batch_test_" + QString::number(QCoreApplication::applicationPid());
+    QDir().mkpath(tempDir);
+    try
+    {
+        lineFilesTest(tempDir);
+        cacheTest(tempDir);
+        scheduleTest(tempDir);
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    CommandFileCache::disable();
+    QDir myDir(tempDir);
+    QStringList fileList = myDir.entryList(QDir::Files);
+    for (int i = 0; i < fileList.size(); ++i)
+    {
+        myDir.remove(fileList[i]);
+    }
+    QDir().rmdir(tempDir);
+}
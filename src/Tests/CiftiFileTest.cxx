@@ -20,6 +20,7 @@
 
 #include "CiftiFileTest.h"
 #include "CiftiFile.h"
+#include <cmath>
 using namespace caret;
 CiftiFileTest::CiftiFileTest(const AString &identifier) : TestInterface(identifier)
 {
@@ -35,6 +36,10 @@ void CiftiFileTest::execute()
     if(this->failed()) return;
     testCiftiReadWriteOnDisk();
     if(this->failed()) return;
+    testCiftiReadWriteInt16();
+    if(this->failed()) return;
+    testCiftiColumnSidecar();
+    if(this->failed()) return;
 }
 
 void CiftiFileTest::testObjectCreateDestroy()
@@ -199,3 +204,137 @@ void CiftiFileTest::testCiftiReadWriteOnDisk()
     delete [] testRow;
 }
 
+
+void CiftiFileTest::testCiftiReadWriteInt16()
+{
+    std::cout << "Testing Cifti int16 writing." << std::endl;
+
+    CiftiFile reader(this->m_default_path + "/cifti/DenseTimeSeries.dtseries.nii");
+
+    std::vector <int64_t> dim = reader.getDimensions();
+    if (dim.size() != 2)
+    {
+        setFailed("input file must have 2 dimensions");
+        return;
+    }
+    int64_t rowSize = dim[0];
+    int64_t columnSize = dim[1];
+    std::vector<float> row(rowSize), testRow(rowSize);
+    float minval = 0.0f, maxval = 0.0f;
+    for(int64_t i = 0;i<columnSize;i++)
+    {
+        reader.getRow(row.data(),i);
+        for(int64_t j = 0;j<rowSize;j++)
+        {
+            if((i == 0 && j == 0) || row[j] < minval) minval = row[j];
+            if((i == 0 && j == 0) || row[j] > maxval) maxval = row[j];
+        }
+    }
+
+    AString outFile = this->m_default_path + "/cifti/testOutInt16.dtseries.nii";
+    if(QFile::exists(outFile)) QFile::remove(outFile);
+    CiftiFile writer;
+    writer.setWritingFile(outFile);
+    writer.setCiftiXML(reader.getCiftiXML());
+    writer.setWritingDataTypeAndScaling(NIFTI_TYPE_INT16, minval, maxval);
+    for(int64_t i = 0;i<columnSize;i++)
+    {
+        reader.getRow(row.data(),i);
+        writer.setRow(row.data(),i);
+    }
+    writer.writeFile(outFile);
+
+    //reopen output file, and check that values are within half of a quantization step
+    CiftiFile test(outFile);
+    double tolerance = 0.5001 * (maxval - minval) / 65535.0;
+    for(int64_t i = 0;i<columnSize;i++)
+    {
+        reader.getRow(row.data(),i);
+        test.getRow(testRow.data(),i);
+        for(int64_t j = 0;j<rowSize;j++)
+        {
+            if(std::abs(row[j] - testRow[j]) > tolerance + 1e-6 * std::abs(row[j]))
+            {
+                this->setFailed("Int16 Cifti file row " + AString::number(i) + " differs from input by more than the quantization step.");
+                return;
+            }
+        }
+    }
+    std::cout << "Int16 writing of Cifti was within tolerance for all frames." << std::endl;
+
+    //writing onto the same file with a different scaling range must rewrite it, values above the new range are clamped
+    const float halfMax = minval + (maxval - minval) / 2.0f;
+    test.setWritingDataTypeAndScaling(NIFTI_TYPE_INT16, minval, halfMax);
+    test.writeFile(outFile);
+    CiftiFile rescaled(outFile);
+    for(int64_t i = 0;i<columnSize;i++)
+    {
+        rescaled.getRow(testRow.data(),i);
+        for(int64_t j = 0;j<rowSize;j++)
+        {
+            if(testRow[j] > halfMax + tolerance + 1e-6 * std::abs(halfMax))
+            {
+                this->setFailed("Int16 Cifti file rewritten in place with a new scaling range kept the old scaling.");
+                return;
+            }
+        }
+    }
+}
+
+void CiftiFileTest::testCiftiColumnSidecar()
+{
+    std::cout << "Testing Cifti column sidecar." << std::endl;
+
+    CiftiFile reader(this->m_default_path + "/cifti/DenseTimeSeries.dtseries.nii");
+    std::vector <int64_t> dim = reader.getDimensions();
+    if (dim.size() != 2)
+    {
+        setFailed("input file must have 2 dimensions");
+        return;
+    }
+    int64_t rowSize = dim[0];
+    int64_t columnSize = dim[1];
+    AString outFile = this->m_default_path + "/cifti/testOutSidecar.dtseries.nii";
+    if(QFile::exists(outFile)) QFile::remove(outFile);
+    reader.writeFile(outFile);
+
+    CiftiFile onDisk(outFile);
+    if(onDisk.hasColumnSidecar())
+    {
+        setFailed("new Cifti file should not have a column sidecar");
+        return;
+    }
+    onDisk.buildColumnSidecar();
+    CiftiFile reopened(outFile);//should find the sidecar by itself
+    if(!reopened.hasColumnSidecar())
+    {
+        setFailed("reopened Cifti file did not find its column sidecar");
+        return;
+    }
+    reader.convertToInMemory();
+    std::vector<float> column(columnSize), testColumn(columnSize);
+    for(int64_t i = 0;i<rowSize;i++)
+    {
+        reader.getColumn(column.data(),i);
+        reopened.getColumn(testColumn.data(),i);
+        if(memcmp((void *)column.data(),(void *)testColumn.data(),columnSize*sizeof(float)))
+        {
+            this->setFailed("Cifti column " + AString::number(i) + " from sidecar differs from the data.");
+            return;
+        }
+    }
+    reopened.convertToInMemory();//release the file, so it can be rewritten
+    std::vector<float> row(rowSize);
+    reader.getRow(row.data(), columnSize - 1);
+    row[rowSize - 1] += 1.0f;//change the end of the file, keeping its size
+    reader.setRow(row.data(), columnSize - 1);
+    reader.writeFile(outFile);//a rewritten file must not use the old sidecar
+    CiftiFile rewritten(outFile);
+    if(rewritten.hasColumnSidecar())
+    {
+        this->setFailed("rewritten Cifti file used a stale column sidecar");
+        return;
+    }
+    QFile::remove(CiftiColumnSidecar::getSidecarFileName(outFile));
+    std::cout << "Cifti column sidecar matched all columns." << std::endl;
+}
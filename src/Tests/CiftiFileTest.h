@@ -32,6 +32,8 @@ public:
     void testCiftiRead();
     void testCiftiReadWriteInMemory();
     void testCiftiReadWriteOnDisk();
+    void testCiftiReadWriteInt16();
+    void testCiftiColumnSidecar();
 };
 
 } // namespace caret
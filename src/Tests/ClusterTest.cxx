@@ -0,0 +1,214 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ClusterTest.h"
+
+#include "CaretOMP.h"
+#include "ClusterHelper.h"
+#include "SurfaceFile.h"
+#include "TopologyHelper.h"
+#include "VolumeSpace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+ClusterTest::ClusterTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{//the flood fill that ClusterHelper replaced, as the reference for cluster order and membership
+    void floodFill(const vector<vector<int64_t> >& neighbors, const vector<char>& mask, vector<vector<int64_t> >& clustersOut)
+    {
+        vector<char> marked(mask);
+        clustersOut.clear();
+        for (int64_t i = 0; i < (int64_t)marked.size(); ++i)
+        {
+            if (!marked[i]) continue;
+            vector<int64_t> members(1, i);
+            marked[i] = 0;
+            for (size_t index = 0; index < members.size(); ++index)//NOTE: vector grows inside loop
+            {
+                const vector<int64_t>& myNeighbors = neighbors[members[index]];
+                for (size_t n = 0; n < myNeighbors.size(); ++n)
+                {
+                    if (marked[myNeighbors[n]])
+                    {
+                        members.push_back(myNeighbors[n]);
+                        marked[myNeighbors[n]] = 0;
+                    }
+                }
+            }
+            sort(members.begin(), members.end());
+            clustersOut.push_back(members);
+        }
+    }
+
+    //spatially smooth enough to give clusters of many sizes, including ones that cross any slab boundary
+    void makeMask(const int64_t& numElements, const vector<vector<int64_t> >& neighbors, vector<char>& maskOut)
+    {
+        vector<float> data(numElements), scratch(numElements);
+        for (int64_t i = 0; i < numElements; ++i)
+        {
+            data[i] = ((float)rand()) / RAND_MAX - 0.5f;
+        }
+        for (int blur = 0; blur < 3; ++blur)
+        {
+            scratch.swap(data);
+            for (int64_t i = 0; i < numElements; ++i)
+            {
+                float sum = scratch[i];
+                for (size_t n = 0; n < neighbors[i].size(); ++n)
+                {
+                    sum += scratch[neighbors[i][n]];
+                }
+                data[i] = sum / (neighbors[i].size() + 1);
+            }
+        }
+        maskOut.resize(numElements);
+        for (int64_t i = 0; i < numElements; ++i)
+        {
+            maskOut[i] = (data[i] > 0.02f ? 1 : 0);
+        }
+    }
+
+    void compareClusters(ClusterTest* theTest, const AString& condition, const vector<vector<int64_t> >& reference, const ClusterHelper::ClusterList& found,
+                         const vector<float>& sizes)
+    {
+        if ((int64_t)reference.size() != found.getNumberOfClusters())
+        {
+            theTest->setFailed(condition + ", found " + AString::number(found.getNumberOfClusters()) + " clusters, expected " + AString::number(reference.size()));
+            return;
+        }
+        for (size_t c = 0; c < reference.size(); ++c)
+        {
+            int64_t start = found.m_memberStart[c], count = found.m_memberStart[c + 1] - start;
+            if (count != (int64_t)reference[c].size() || !equal(reference[c].begin(), reference[c].end(), found.m_members.begin() + start))
+            {
+                theTest->setFailed(condition + ", cluster " + AString::number(c) + " has different members");
+                return;
+            }
+            double expectSize = 0.0;
+            for (size_t i = 0; i < reference[c].size(); ++i)
+            {
+                expectSize += (sizes.empty() ? 1.0 : sizes[reference[c][i]]);
+            }
+            if (abs(expectSize - found.m_sizes[c]) > 1e-6 * expectSize)
+            {
+                theTest->setFailed(condition + ", cluster " + AString::number(c) + " has size " + AString::number(found.m_sizes[c]) + ", expected " + AString::number(expectSize));
+                return;
+            }
+        }
+    }
+}
+
+void ClusterTest::execute()
+{
+    {//volume, serial and with parallel slabs
+        const int64_t dims[3] = { 61, 53, 47 };
+        const float sform[12] = { 2.0f, 0.0f, 0.0f, -60.0f,
+                                  0.0f, 2.0f, 0.0f, -52.0f,
+                                  0.0f, 0.0f, 2.0f, -46.0f };
+        VolumeSpace mySpace(dims, sform);
+        int64_t frameSize = dims[0] * dims[1] * dims[2];
+        vector<vector<int64_t> > neighbors(frameSize);
+        const int64_t stencil[18] = { 1, 0, 0, -1, 0, 0, 0, 1, 0, 0, -1, 0, 0, 0, 1, 0, 0, -1 };
+        for (int64_t k = 0; k < dims[2]; ++k)
+        {
+            for (int64_t j = 0; j < dims[1]; ++j)
+            {
+                for (int64_t i = 0; i < dims[0]; ++i)
+                {
+                    for (int s = 0; s < 18; s += 3)
+                    {
+                        int64_t neighIJK[3] = { i + stencil[s], j + stencil[s + 1], k + stencil[s + 2] };
+                        if (mySpace.indexValid(neighIJK)) neighbors[mySpace.getIndex(i, j, k)].push_back(mySpace.getIndex(neighIJK));
+                    }
+                }
+            }
+        }
+        vector<char> mask;
+        makeMask(frameSize, neighbors, mask);
+        vector<vector<int64_t> > reference;
+        floodFill(neighbors, mask, reference);
+        ClusterHelper myHelper(mySpace);
+        ClusterHelper::Workspace myWork;
+        ClusterHelper::ClusterList found;
+        myHelper.findClusters(mask.data(), found, myWork);//not in a parallel region, so this uses slabs if there are multiple threads
+        compareClusters(this, "volume", reference, found, vector<float>());
+        bool failedSerial = false;
+#pragma omp CARET_PAR
+        {
+#pragma omp CARET_SINGLE
+            {//inside a parallel region, a single slab
+                ClusterHelper::Workspace singleWork;
+                ClusterHelper::ClusterList singleFound;
+                myHelper.findClusters(mask.data(), singleFound, singleWork);
+                failedSerial = (singleFound.m_members != found.m_members || singleFound.m_memberStart != found.m_memberStart);
+            }
+        }
+        if (failedSerial) setFailed("volume clusters differ between slab and single pass labeling");
+    }
+    {//surface, a triangulated grid
+        const int GRID_SIZE = 150;
+        SurfaceFile mySurf;
+        mySurf.setNumberOfNodesAndTriangles(GRID_SIZE * GRID_SIZE, (GRID_SIZE - 1) * (GRID_SIZE - 1) * 2);
+        int32_t triIndex = 0;
+        for (int j = 0; j < GRID_SIZE; ++j)
+        {
+            for (int i = 0; i < GRID_SIZE; ++i)
+            {
+                mySurf.setCoordinate(i + j * GRID_SIZE, i, j + 0.1f * sin(i * 0.3f), 0.0f);//make the areas vary a bit
+                if (i + 1 < GRID_SIZE && j + 1 < GRID_SIZE)
+                {
+                    int32_t base = i + j * GRID_SIZE;
+                    mySurf.setTriangle(triIndex++, base, base + 1, base + GRID_SIZE + 1);
+                    mySurf.setTriangle(triIndex++, base, base + GRID_SIZE + 1, base + GRID_SIZE);
+                }
+            }
+        }
+        int numNodes = mySurf.getNumberOfNodes();
+        CaretPointer<TopologyHelper> myTopoHelp = mySurf.getTopologyHelper();
+        vector<vector<int64_t> > neighbors(numNodes);
+        for (int i = 0; i < numNodes; ++i)
+        {
+            const vector<int32_t>& nodeNeighbors = myTopoHelp->getNodeNeighbors(i);
+            neighbors[i].assign(nodeNeighbors.begin(), nodeNeighbors.end());
+        }
+        vector<float> areas;
+        mySurf.computeNodeAreas(areas);
+        vector<char> mask;
+        makeMask(numNodes, neighbors, mask);
+        vector<vector<int64_t> > reference;
+        floodFill(neighbors, mask, reference);
+        ClusterHelper myHelper(myTopoHelp, areas.data());
+        ClusterHelper::Workspace myWork;
+        ClusterHelper::ClusterList found;
+        myHelper.findClusters(mask.data(), found, myWork);
+        compareClusters(this, "surface", reference, found, areas);
+        myHelper.findClusters(mask.data(), found, myWork);//reused workspace and output
+        compareClusters(this, "surface, second run", reference, found, areas);
+    }
+}
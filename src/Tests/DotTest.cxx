@@ -113,6 +113,51 @@ void DotTest::checkVal(const float& correct, const float& test, const AString& d
     if (!(abs(test - correct) < TOLER_ABS + TOLER_RATIO * abs(correct))) setFailed(descrip + " got " + AString::number(test) + ", expected " + AString::number(correct));
 }//use "not less than" in order to catch NaNs
 
+void DotTest::checkDotMat(const AString& implName)
+{//sddotmat must give exactly what sddot does, including odd lengths, edge rows/columns of the register blocks, and unaligned rows
+    const int NUM_A = 5, NUM_B = 7;
+    const int lengths[] = { 1, 3, 4, 5, 7, 13, 100, 1001 };
+    for (int whichLength = 0; whichLength < (int)(sizeof(lengths) / sizeof(lengths[0])); ++whichLength)
+    {
+        const int length = lengths[whichLength];
+        vector<vector<float> > aData(NUM_A), bData(NUM_B);
+        vector<const float*> aPtrs(NUM_A), bPtrs(NUM_B);
+        for (int i = 0; i < NUM_A; ++i)
+        {
+            aData[i] = vectorAdd(randVector01(length + 1), -0.5f);
+            aPtrs[i] = aData[i].data() + (i % 3 == 1 ? 1 : 0);//offset some rows to make them unaligned
+        }
+        for (int j = 0; j < NUM_B; ++j)
+        {
+            bData[j] = vectorAdd(randVector01(length + 1), -0.5f);
+            bPtrs[j] = bData[j].data() + (j % 4 == 2 ? 1 : 0);
+        }
+        vector<double> result(NUM_A * NUM_B), symResult(NUM_A * NUM_A);
+        sddotmat(aPtrs.data(), NUM_A, bPtrs.data(), NUM_B, length, result.data(), NUM_B);
+        for (int i = 0; i < NUM_A; ++i)
+        {
+            for (int j = 0; j < NUM_B; ++j)
+            {
+                if (result[i * NUM_B + j] != sddot(aPtrs[i], bPtrs[j], length))
+                {
+                    setFailed(implName + " sddotmat differs from sddot at " + AString::number(i) + ", " + AString::number(j) + " with length " + AString::number(length));
+                }
+            }
+        }
+        sddotmat(aPtrs.data(), NUM_A, aPtrs.data(), NUM_A, length, symResult.data(), NUM_A);
+        for (int i = 0; i < NUM_A; ++i)
+        {
+            for (int j = i + 1; j < NUM_A; ++j)
+            {
+                if (symResult[i * NUM_A + j] != symResult[j * NUM_A + i])
+                {
+                    setFailed(implName + " sddotmat is not symmetric at " + AString::number(i) + ", " + AString::number(j) + " with length " + AString::number(length));
+                }
+            }
+        }
+    }
+}
+
 void DotTest::execute()
 {
     dot_flags impl_in_use = dot_set_impl(DOT_NAIVE);
@@ -130,6 +175,7 @@ void DotTest::execute()
     const float midsnr_naive = correlate(midsnrA, midsnrB);
     const float highsnr_naive = correlate(highsnrA, highsnrB);
     const float cross_snr_naive = correlate(lowsnrA, highsnrB);
+    checkDotMat("naive");
     //sse2
     impl_in_use = dot_set_impl(DOT_SSE2);
     if (impl_in_use == DOT_SSE2)
@@ -140,6 +186,7 @@ void DotTest::execute()
         checkVal(midsnr_naive, correlate(midsnrA, midsnrB), "sse2 mid snr correlation");
         checkVal(highsnr_naive, correlate(highsnrA, highsnrB), "sse2 high snr correlation");
         checkVal(cross_snr_naive, correlate(lowsnrA, highsnrB), "sse2 cross snr correlation");
+        checkDotMat("sse2");
     } else {
         cout << "skipping SSE2, not supported" << endl;
     }
@@ -153,6 +200,7 @@ void DotTest::execute()
         checkVal(midsnr_naive, correlate(midsnrA, midsnrB), "avx mid snr correlation");
         checkVal(highsnr_naive, correlate(highsnrA, highsnrB), "avx high snr correlation");
         checkVal(cross_snr_naive, correlate(lowsnrA, highsnrB), "avx cross snr correlation");
+        checkDotMat("avx");
     } else {
         cout << "skipping AVX, not supported" << endl;
     }
@@ -166,6 +214,7 @@ void DotTest::execute()
         checkVal(midsnr_naive, correlate(midsnrA, midsnrB), "avxfma mid snr correlation");
         checkVal(highsnr_naive, correlate(highsnrA, highsnrB), "avxfma high snr correlation");
         checkVal(cross_snr_naive, correlate(lowsnrA, highsnrB), "avxfma cross snr correlation");
+        checkDotMat("avxfma");
     } else {
         cout << "skipping AVXFMA, not supported" << endl;
     }
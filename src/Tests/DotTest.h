@@ -27,6 +27,7 @@ namespace caret {
     class DotTest : public TestInterface
     {
         void checkVal(const float& correct, const float& test, const AString& descrip);
+        void checkDotMat(const AString& implName);
     public:
         DotTest(const AString& identifier);
         virtual void execute();
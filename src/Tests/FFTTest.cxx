@@ -0,0 +1,151 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "FFTTest.h"
+
+#include "CaretFFT.h"
+
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+FFTTest::FFTTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    complex<double> randComplex()
+    {
+        return complex<double>(((double)rand()) / RAND_MAX - 0.5, ((double)rand()) / RAND_MAX - 0.5);
+    }
+
+    void naiveDFT(const vector<complex<double> >& input, vector<complex<double> >& output, const bool& inverse, const int64_t& stride = 1)
+    {
+        int64_t size = (int64_t)(input.size() + stride - 1) / stride;
+        double sign = (inverse ? 1.0 : -1.0);
+        output.resize(size);
+        for (int64_t k = 0; k < size; ++k)
+        {
+            complex<double> accum(0.0, 0.0);
+            for (int64_t n = 0; n < size; ++n)
+            {
+                double phase = sign * 2.0 * 3.14159265358979323846 * ((n * k) % size) / size;
+                accum += input[n * stride] * complex<double>(cos(phase), sin(phase));
+            }
+            output[k] = accum;
+        }
+    }
+
+    //largest difference relative to the largest magnitude in the reference
+    double relativeError(const vector<complex<double> >& reference, const vector<complex<double> >& test)
+    {
+        double maxMag = 0.0, maxDiff = 0.0;
+        for (size_t i = 0; i < reference.size(); ++i)
+        {
+            maxMag = max(maxMag, abs(reference[i]));
+            maxDiff = max(maxDiff, abs(reference[i] - test[i]));
+        }
+        if (maxMag == 0.0) return maxDiff;
+        return maxDiff / maxMag;
+    }
+}
+
+void FFTTest::execute()
+{
+    const double TOLERANCE = 1e-10;
+    const int64_t sizes[] = { 1, 2, 3, 4, 5, 7, 8, 9, 12, 13, 17, 30, 31, 49, 64, 97, 100, 121, 210, 211, 256 };//powers of 2, odd, primes, prime squares, mixed radix
+    const int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+    for (int s = 0; s < numSizes; ++s)
+    {
+        int64_t size = sizes[s];
+        CaretFFT myFFT(size);
+        vector<complex<double> > input(size), expected, output(size), roundTrip(size);
+        for (int64_t i = 0; i < size; ++i)
+        {
+            input[i] = randComplex();
+        }
+        for (int inverse = 0; inverse < 2; ++inverse)
+        {
+            naiveDFT(input, expected, inverse);
+            myFFT.transform(input.data(), output.data(), inverse);
+            if (relativeError(expected, output) > TOLERANCE)
+            {
+                setFailed(AString(inverse ? "inverse" : "forward") + " FFT of size " + AString::number(size) + " differs from naive DFT");
+            }
+        }
+        myFFT.transform(input.data(), output.data());
+        myFFT.transform(output.data(), roundTrip.data(), true);
+        for (int64_t i = 0; i < size; ++i)
+        {
+            roundTrip[i] /= (double)size;
+        }
+        if (relativeError(input, roundTrip) > TOLERANCE) setFailed("FFT of size " + AString::number(size) + " does not invert");
+        const int64_t STRIDE = 3;//as used for the non-contiguous axes of 3D transforms
+        vector<complex<double> > strided(size * STRIDE);
+        for (int64_t i = 0; i < size * STRIDE; ++i)
+        {
+            strided[i] = randComplex();
+        }
+        naiveDFT(strided, expected, false, STRIDE);
+        myFFT.transform(strided.data(), output.data(), false, STRIDE);
+        if (relativeError(expected, output) > TOLERANCE) setFailed("strided FFT of size " + AString::number(size) + " differs from naive DFT");
+    }
+    const int64_t goodIn[] = { 1, 7, 11, 13, 97, 101 }, goodOut[] = { 1, 8, 12, 15, 100, 108 };
+    for (int i = 0; i < 6; ++i)
+    {
+        if (CaretFFT::goodSize(goodIn[i]) != goodOut[i]) setFailed("goodSize(" + AString::number(goodIn[i]) + ") returned " + AString::number(CaretFFT::goodSize(goodIn[i])));
+    }
+    const int64_t dims[3] = { 4, 5, 7 };
+    const int64_t total = dims[0] * dims[1] * dims[2];
+    CaretFFT3D my3D(dims);
+    vector<complex<double> > volume(total), expected(total, complex<double>(0.0, 0.0));
+    for (int64_t i = 0; i < total; ++i)
+    {
+        volume[i] = randComplex();
+    }
+    for (int64_t k2 = 0; k2 < dims[2]; ++k2)
+    {
+        for (int64_t j2 = 0; j2 < dims[1]; ++j2)
+        {
+            for (int64_t i2 = 0; i2 < dims[0]; ++i2)
+            {
+                complex<double>& accum = expected[i2 + dims[0] * (j2 + dims[1] * k2)];
+                for (int64_t k = 0; k < dims[2]; ++k)
+                {
+                    for (int64_t j = 0; j < dims[1]; ++j)
+                    {
+                        for (int64_t i = 0; i < dims[0]; ++i)
+                        {
+                            double phase = -2.0 * 3.14159265358979323846 * ((double)(i * i2) / dims[0] + (double)(j * j2) / dims[1] + (double)(k * k2) / dims[2]);
+                            accum += volume[i + dims[0] * (j + dims[1] * k)] * complex<double>(cos(phase), sin(phase));
+                        }
+                    }
+                }
+            }
+        }
+    }
+    my3D.transform(volume.data());
+    if (relativeError(expected, volume) > TOLERANCE) setFailed("3D FFT differs from naive DFT");
+}
@@ -0,0 +1,226 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "GeodesicAllToAllTest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "CaretException.h"
+#include "CiftiFile.h"
+#include "CommandOperationManager.h"
+#include "GeodesicHelper.h"
+#include "MetricFile.h"
+#include "ProgramParameters.h"
+#include "SurfaceFile.h"
+
+#include <QCoreApplication>
+#include <QDir>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+GeodesicAllToAllTest::GeodesicAllToAllTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    //a sphere plus a small tetrahedron off to the side, so some pairs of vertices are not connected
+    void makeSurface(SurfaceFile& surfaceOut)
+    {
+        SurfaceFile sphere;
+        AlgorithmSurfaceCreateSphere(NULL, 500, &sphere);//radius 100
+        const int32_t numSphereNodes = sphere.getNumberOfNodes(), numSphereTiles = sphere.getNumberOfTriangles();
+        surfaceOut.setNumberOfNodesAndTriangles(numSphereNodes + 4, numSphereTiles + 4);
+        for (int32_t i = 0; i < numSphereNodes; ++i)
+        {
+            const float* coord = sphere.getCoordinate(i);
+            surfaceOut.setCoordinate(i, coord[0], coord[1], coord[2]);
+        }
+        for (int32_t i = 0; i < numSphereTiles; ++i)
+        {
+            surfaceOut.setTriangle(i, sphere.getTriangle(i));
+        }
+        const int32_t a = numSphereNodes, b = a + 1, c = a + 2, d = a + 3;
+        surfaceOut.setCoordinate(a, 300.0f, 0.0f, 0.0f);
+        surfaceOut.setCoordinate(b, 310.0f, 0.0f, 0.0f);
+        surfaceOut.setCoordinate(c, 300.0f, 10.0f, 0.0f);
+        surfaceOut.setCoordinate(d, 300.0f, 0.0f, 10.0f);
+        surfaceOut.setTriangle(numSphereTiles, a, c, b);
+        surfaceOut.setTriangle(numSphereTiles + 1, a, b, d);
+        surfaceOut.setTriangle(numSphereTiles + 2, a, d, c);
+        surfaceOut.setTriangle(numSphereTiles + 3, b, c, d);
+        surfaceOut.setStructure(StructureEnum::CORTEX_LEFT);
+    }
+    
+    void runAllToAll(const vector<AString>& arguments)
+    {
+        ProgramParameters myParams;
+        myParams.addParameter("-surface-geodesic-distance-all-to-all");
+        for (int i = 0; i < (int)arguments.size(); ++i)
+        {
+            myParams.addParameter(arguments[i]);
+        }
+        CommandOperationManager::getCommandOperationManager()->runCommand(myParams);
+    }
+    
+    vector<AString> makeArguments(const AString& surfaceName, const AString& outName)
+    {
+        vector<AString> ret;
+        ret.push_back(surfaceName);
+        ret.push_back(outName);
+        return ret;
+    }
+}
+
+void GeodesicAllToAllTest::checkOutput(const AString& condition, const AString& ciftiName, const vector<vector<float> >& reference, const vector<int32_t>& rowNodes,
+                                       const float& limit, const bool& symmetricHalf, const float& tolerance)
+{
+    CiftiFile myCifti(ciftiName);
+    const int64_t numRows = (int64_t)rowNodes.size();
+    if (myCifti.getNumberOfRows() != numRows || myCifti.getNumberOfColumns() != numRows)
+    {
+        setFailed(condition + ": output has the wrong dimensions");
+        return;
+    }
+    vector<float> row(numRows);
+    for (int64_t r = 0; r < numRows; ++r)
+    {
+        myCifti.getRow(row.data(), r);
+        for (int64_t c = 0; c < numRows; ++c)
+        {
+            float expected = reference[rowNodes[r]][rowNodes[c]];
+            if (symmetricHalf && c < r) expected = -1.0f;
+            if (limit >= 0.0f && expected > limit)
+            {
+                if (expected - limit < 0.01f) continue;//whether a vertex right at the limit is included depends on rounding
+                expected = -1.0f;
+            }
+            if (abs(row[c] - expected) > tolerance)
+            {
+                setFailed(condition + ": row " + AString::number(r) + ", column " + AString::number(c) + " is " + AString::number(row[c]) + ", expected " + AString::number(expected));
+                return;
+            }
+        }
+    }
+}
+
+void GeodesicAllToAllTest::execute()
+{
+    SurfaceFile mySurf;
+    makeSurface(mySurf);
+    const int32_t numNodes = mySurf.getNumberOfNodes();
+    vector<vector<float> > reference(numNodes);
+    {//the plain per-root search on the whole surface, which leaves unreachable vertices untouched
+        CaretPointer<GeodesicHelper> myGeoHelp = mySurf.getGeodesicHelper();
+        for (int32_t i = 0; i < numNodes; ++i)
+        {
+            reference[i].assign(numNodes, -1.0f);
+            myGeoHelp->getGeoFromNode(i, reference[i]);
+        }
+    }
+    int64_t numDisconnected = 0;
+    float maxDist = 0.0f;
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        for (int32_t j = 0; j < numNodes; ++j)
+        {
+            if (reference[i][j] < 0.0f) ++numDisconnected;
+            maxDist = max(maxDist, reference[i][j]);
+        }
+    }
+    if (numDisconnected == 0) setFailed("test surface has no disconnected vertices");
+    vector<int32_t> allNodes(numNodes), roiNodes;
+    MetricFile roiMetric;
+    roiMetric.setNumberOfNodesAndColumns(numNodes, 1);
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        allNodes[i] = i;
+        bool inRoi = (mySurf.getCoordinate(i)[2] > -30.0f || i >= numNodes - 4);//includes the tetrahedron, so the roi output has disconnected pairs too
+        roiMetric.setValue(i, 0, (inRoi ? 1.0f : 0.0f));
+        if (inRoi) roiNodes.push_back(i);
+    }
+    QString tempDir = QDir::tempPath() + "/wb_geodesic_all_to_all_test_" + QString::number(QCoreApplication::applicationPid());
+    QDir().mkpath(tempDir);
+    try
+    {
+        const AString surfaceName = tempDir + "/test.surf.gii", roiName = tempDir + "/roi.func.gii", outName = tempDir + "/out.dconn.nii";
+        mySurf.writeFile(surfaceName);
+        roiMetric.writeFile(roiName);
+        const float tolerance = 0.001f;
+        //rows are float, so this is about 37 rows per block: many blocks, and a short last block
+        const AString fullBlocksGB = AString::number(37.5 * numNodes * sizeof(float) / (1024.0 * 1024.0 * 1024.0));
+        const AString roiBlocksGB = AString::number(37.5 * roiNodes.size() * sizeof(float) / (1024.0 * 1024.0 * 1024.0));
+        {
+            vector<AString> args = makeArguments(surfaceName, outName);
+            args.push_back("-mem-limit");
+            args.push_back(fullBlocksGB);
+            runAllToAll(args);
+            checkOutput("full matrix in blocks", outName, reference, allNodes, -1.0f, false, tolerance);
+        }
+        {
+            vector<AString> args = makeArguments(surfaceName, outName);
+            args.push_back("-roi");
+            args.push_back(roiName);
+            args.push_back("-limit");
+            args.push_back("50");
+            args.push_back("-mem-limit");
+            args.push_back(roiBlocksGB);
+            runAllToAll(args);
+            checkOutput("roi and limit", outName, reference, roiNodes, 50.0f, false, tolerance);
+        }
+        {
+            vector<AString> args = makeArguments(surfaceName, outName);
+            args.push_back("-symmetric-half");
+            args.push_back("-mem-limit");
+            args.push_back(fullBlocksGB);
+            runAllToAll(args);
+            checkOutput("symmetric half", outName, reference, allNodes, -1.0f, true, tolerance);
+        }
+        {
+            vector<AString> args = makeArguments(surfaceName, outName);
+            args.push_back("-roi");
+            args.push_back(roiName);
+            args.push_back("-symmetric-half");
+            runAllToAll(args);
+            checkOutput("symmetric half with roi", outName, reference, roiNodes, -1.0f, true, tolerance);
+        }
+        {
+            const float int16Max = ceil(maxDist) + 1.0f;
+            vector<AString> args = makeArguments(surfaceName, outName);
+            args.push_back("-int16");
+            args.push_back(AString::number(int16Max));
+            runAllToAll(args);
+            checkOutput("int16", outName, reference, allNodes, -1.0f, false, (int16Max + 1.0f) / 65535.0f + tolerance);//within one quantization step
+        }
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    QDir myDir(tempDir);
+    QStringList fileList = myDir.entryList(QDir::Files);
+    for (int i = 0; i < fileList.size(); ++i)
+    {
+        myDir.remove(fileList[i]);
+    }
+    QDir().rmdir(tempDir);
+}
@@ -0,0 +1,180 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "GiftiReadTest.h"
+
+#include "FileInformation.h"
+#include "GiftiDataArray.h"
+#include "GiftiFile.h"
+#include "GiftiFileWriter.h"
+#include "MetricFile.h"
+#include "SystemUtilities.h"
+
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+GiftiReadTest::GiftiReadTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    //restores the global gifti writing settings even if a write throws
+    struct GiftiSettingsRestorer
+    {
+        int32_t m_level;
+        int64_t m_threshold;
+        GiftiSettingsRestorer()
+        {
+            m_level = GiftiFile::getCompressionLevelForWriting();
+            m_threshold = GiftiFile::getExternalBinaryThresholdForWriting();
+        }
+        ~GiftiSettingsRestorer()
+        {
+            GiftiFile::setCompressionLevelForWriting(m_level);
+            GiftiFile::setExternalBinaryThresholdForWriting(m_threshold);
+        }
+    };
+}
+
+void GiftiReadTest::largeArrayTest()
+{//one array of several MB, so that it is deflated as multiple blocks in parallel, written through GiftiFileWriter with its own compression level
+    const int64_t NUM_VALUES = 1536 * 1024;//6MB of floats, the blocks are 1MB
+    const AString largeName = SystemUtilities::getTempDirectory() + "/wb_test_giftiread_large.func.gii";
+    vector<int64_t> dims(1, NUM_VALUES);
+    GiftiDataArray outArray(NiftiIntentEnum::NIFTI_INTENT_NONE, NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32, dims, GiftiEncodingEnum::GZIP_BASE64_BINARY);
+    float* outData = outArray.getDataPointerFloat();
+    for (int64_t i = 0; i < NUM_VALUES; ++i)
+    {
+        outData[i] = (float)((i / 1000) % 7);//long runs, so the levels make very different sizes, and matches across block boundaries
+        if (i % 13 == 0) outData[i] = (float)rand() / RAND_MAX;
+    }
+    const int NUM_LEVELS = 3;
+    const int32_t levels[NUM_LEVELS] = { 0, 1, 9 };
+    int64_t sizes[NUM_LEVELS];
+    for (int whichLevel = 0; whichLevel < NUM_LEVELS; ++whichLevel)
+    {
+        {
+            GiftiFileWriter myWriter(largeName, GiftiEncodingEnum::GZIP_BASE64_BINARY);
+            myWriter.setCompressionLevel(levels[whichLevel]);//global level stays at the default
+            myWriter.start(1, NULL, NULL);
+            myWriter.writeDataArray(&outArray);
+            myWriter.finish();
+        }
+        FileInformation fileInfo(largeName);
+        sizes[whichLevel] = fileInfo.size();
+        GiftiFile inFile;
+        inFile.readFile(largeName);
+        fileInfo.remove();
+        if (inFile.getNumberOfDataArrays() != 1 || inFile.getDataArray(0)->getTotalNumberOfElements() != NUM_VALUES)
+        {
+            setFailed("large gifti array read with compression level " + AString::number(levels[whichLevel]) + " has wrong dimensions");
+            continue;
+        }
+        const float* inData = inFile.getDataArray(0)->getDataPointerFloat();
+        for (int64_t i = 0; i < NUM_VALUES; ++i)
+        {
+            if (inData[i] != outData[i])
+            {
+                setFailed("large gifti array read with compression level " + AString::number(levels[whichLevel]) + " has wrong value at index " + AString::number(i));
+                break;
+            }
+        }
+    }
+    if (!(sizes[0] > sizes[1] && sizes[1] >= sizes[2]))
+    {
+        setFailed("GiftiFileWriter compression level does not change the file size, sizes " +
+                  AString::number(sizes[0]) + ", " + AString::number(sizes[1]) + ", " + AString::number(sizes[2]));
+    }
+}
+
+void GiftiReadTest::execute()
+{
+    const int32_t NUM_NODES = 32492, NUM_COLUMNS = 100;
+    const AString gzipName = SystemUtilities::getTempDirectory() + "/wb_test_giftiread_gzip.func.gii";
+    const AString base64Name = SystemUtilities::getTempDirectory() + "/wb_test_giftiread_base64.func.gii";
+    const AString fastGzipName = SystemUtilities::getTempDirectory() + "/wb_test_giftiread_fastgzip.func.gii";
+    const AString externalName = SystemUtilities::getTempDirectory() + "/wb_test_giftiread_external.func.gii";
+    MetricFile outMetric;
+    outMetric.setNumberOfNodesAndColumns(NUM_NODES, NUM_COLUMNS);
+    vector<float> columnData(NUM_NODES);
+    for (int32_t col = 0; col < NUM_COLUMNS; ++col)
+    {
+        for (int32_t node = 0; node < NUM_NODES; ++node)
+        {
+            columnData[node] = (float)rand() / RAND_MAX - 0.5f;//random values, so the compression is realistic
+        }
+        outMetric.setValuesForColumn(col, columnData.data());
+    }
+    outMetric.writeFile(gzipName);//default encoding is gzip base64
+    {
+        GiftiFile convertFile;
+        convertFile.readFile(gzipName);
+        convertFile.setEncodingForWriting(GiftiEncodingEnum::BASE64_BINARY);
+        convertFile.writeFile(base64Name);
+    }
+    {
+        GiftiSettingsRestorer restoreSettings;
+        GiftiFile::setCompressionLevelForWriting(1);
+        outMetric.writeFile(fastGzipName);
+    }
+    {
+        GiftiSettingsRestorer restoreSettings;
+        GiftiFile::setExternalBinaryThresholdForWriting(NUM_NODES * sizeof(float));//every column goes to the external file
+        outMetric.writeFile(externalName);
+    }
+    const int NUM_FILES = 4;
+    const AString names[NUM_FILES] = { gzipName, base64Name, fastGzipName, externalName };
+    const char* encodingNames[NUM_FILES] = { "gzip base64", "base64", "gzip base64, level 1", "external binary" };
+    for (int whichFile = 0; whichFile < NUM_FILES; ++whichFile)
+    {
+        MetricFile inMetric;
+        inMetric.readFile(names[whichFile]);
+        if (inMetric.getNumberOfNodes() != NUM_NODES || inMetric.getNumberOfColumns() != NUM_COLUMNS)
+        {
+            setFailed(AString("metric read with ") + encodingNames[whichFile] + " encoding has wrong dimensions");
+            continue;
+        }
+        bool good = true;
+        for (int32_t col = 0; good && col < NUM_COLUMNS; ++col)
+        {
+            const float* inData = inMetric.getValuePointerForColumn(col);
+            const float* outData = outMetric.getValuePointerForColumn(col);
+            for (int32_t node = 0; node < NUM_NODES; ++node)
+            {
+                if (inData[node] != outData[node])
+                {
+                    setFailed(AString("metric read with ") + encodingNames[whichFile] + " encoding has wrong value in column " +
+                              AString::number(col + 1) + ", node " + AString::number(node));
+                    good = false;
+                    break;
+                }
+            }
+        }
+        FileInformation fileInfo(names[whichFile]);
+        fileInfo.remove();
+    }
+    FileInformation externalDataInfo(externalName + ".data");
+    externalDataInfo.remove();
+    largeArrayTest();
+}
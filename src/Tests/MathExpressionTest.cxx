@@ -55,4 +55,58 @@ void MathExpressionTest::execute()
     {
         setFailed("output value incorrect, expected " + AString::number(correctresult) + ", got " + AString::number(testresult));
     }
+    testEvaluateMultiple();
+}
+
+void MathExpressionTest::testEvaluateMultiple()
+{//the block evaluator must give exactly the same answers as evaluate()
+    const char* expressions[] = {
+        "x",
+        "3 * 4 - 1",
+        "x * 2.5 + y - z / 3",
+        "(x > y) + (x < z) * 2 + (x >= 0.25) * 4 + (y <= z) * 8 + (x == y) * 16 + (x != z) * 32",
+        "!x || y && !(z > 0.5) || x > y > z",
+        "-x ^ 2 ^ -y + PI * z",
+        "sin(x) + cos(y) + tan(z) + asin(x) + acos(y) + atan(z) + atan2(x, y)",
+        "sinh(x) + cosh(y) + tanh(z) + asinh(x) + acosh(y * 4) + atanh(z)",
+        "ln(x) + exp(y) + log(z) + sqrt(x) + abs(y) + floor(z * 3) + round(x * 5) + ceil(y * 7)",
+        "min(x, y) + max(y, z) + mod(x * 10, y - z) + clamp(x, y, z)",
+        "x / (y - y) + clamp(z, 2, 1) * mod(x, 0)"
+    };
+    const int numExpressions = sizeof(expressions) / sizeof(const char*);
+    const int64_t numElems = 10000;//multiple blocks, with a partial block at the end
+    vector<vector<float> > data(3, vector<float>(numElems));
+    for (int64_t i = 0; i < numElems; ++i)
+    {
+        data[0][i] = sin(i * 0.37) * 1.5;//some values out of range of asin, etc
+        data[1][i] = cos(i * 0.11) * (i % 7 - 3) / 2.0;
+        data[2][i] = (i % 13) / 12.0f;//exact values for comparisons
+        if (i % 101 == 0) data[1][i] = data[0][i];
+    }
+    for (int e = 0; e < numExpressions; ++e)
+    {
+        CaretMathExpression myExpr(expressions[e]);
+        vector<AString> varNames = myExpr.getVarNames();
+        vector<const float*> varArrays(varNames.size());
+        for (int v = 0; v < (int)varNames.size(); ++v)
+        {
+            varArrays[v] = data[varNames[v][0].toLatin1() - 'x'].data();
+        }
+        vector<float> results(numElems), values(varNames.size());
+        myExpr.evaluateMultiple(varArrays, numElems, results.data());
+        for (int64_t i = 0; i < numElems; ++i)
+        {
+            for (int v = 0; v < (int)varNames.size(); ++v)
+            {
+                values[v] = varArrays[v][i];
+            }
+            float expected = (float)myExpr.evaluate(values);
+            if (expected != results[i] && !(expected != expected && results[i] != results[i]))//NaN compares unequal to itself
+            {
+                setFailed("evaluateMultiple gave " + AString::number(results[i]) + " instead of " + AString::number(expected) +
+                          " for element " + AString::number(i) + " of expression '" + expressions[e] + "'");
+                return;
+            }
+        }
+    }
 }
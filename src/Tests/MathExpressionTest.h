@@ -29,6 +29,7 @@ namespace caret {
    public:
       MathExpressionTest(const AString& identifier);
       virtual void execute();
+      void testEvaluateMultiple();
    };
 
 }
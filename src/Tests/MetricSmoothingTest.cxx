@@ -0,0 +1,332 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "MetricSmoothingTest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "CaretException.h"
+#include "GeodesicHelper.h"
+#include "MetricFile.h"
+#include "MetricSmoothingObject.h"
+#include "SurfaceFile.h"
+#include "TopologyHelper.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+MetricSmoothingTest::MetricSmoothingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    struct RefWeight
+    {
+        int32_t node;
+        float weight;
+        RefWeight(const int32_t& nodeIn, const float& weightIn) : node(nodeIn), weight(weightIn) { }
+    };
+    
+    //gathering kernels built the way the per-node weight lists used to be, for GEO_GAUSS and GEO_GAUSS_AREA: area kernels are scattering kernels, appended to the gathering lists in scattering node order
+    void referenceWeights(const SurfaceFile& mySurf, const float& kernel, const float* roi, const MetricSmoothingObject::Method& method, vector<vector<RefWeight> >& gatherOut)
+    {
+        const int32_t numNodes = mySurf.getNumberOfNodes();
+        const float gaussianDenom = -0.5f / kernel / kernel;
+        vector<float> areas;
+        mySurf.computeNodeAreas(areas);
+        CaretPointer<GeodesicHelperBase> myGeoBase(new GeodesicHelperBase(&mySurf, (method == MetricSmoothingObject::GEO_GAUSS_AREA ? areas.data() : NULL)));
+        GeodesicHelper myGeoHelp(myGeoBase);
+        CaretPointer<TopologyHelper> myTopoHelp = mySurf.getTopologyHelper();
+        gatherOut.assign(numNodes, vector<RefWeight>());
+        vector<int32_t> nodes;
+        vector<float> dists;
+        for (int32_t i = 0; i < numNodes; ++i)
+        {
+            if (roi != NULL && !(roi[i] > 0.0f)) continue;
+            myGeoHelp.getNodesToGeoDist(i, kernel * 3.0f, nodes, dists, true);
+            const vector<int32_t>& neighbors = myTopoHelp->getNodeNeighbors(i);
+            if (method == MetricSmoothingObject::GEO_GAUSS_AREA ? dists.size() <= neighbors.size() : dists.size() < 7)
+            {
+                nodes = neighbors;
+                nodes.push_back(i);
+                myGeoHelp.getGeoToTheseNodes(i, nodes, dists, true);
+            }
+            if (method == MetricSmoothingObject::GEO_GAUSS)
+            {
+                for (int j = 0; j < (int)nodes.size(); ++j)
+                {
+                    if (roi != NULL && !(roi[nodes[j]] > 0.0f)) continue;
+                    gatherOut[i].push_back(RefWeight(nodes[j], exp(dists[j] * dists[j] * gaussianDenom)));
+                }
+            } else {
+                float scatterSum = 0.0f;//includes neighbors outside the roi, so edge vertices don't get extra influence
+                vector<float> weights(nodes.size());
+                for (int j = 0; j < (int)nodes.size(); ++j)
+                {
+                    weights[j] = exp(dists[j] * dists[j] * gaussianDenom) * areas[nodes[j]];
+                    scatterSum += weights[j];
+                }
+                float factor = areas[i] / scatterSum;
+                for (int j = 0; j < (int)nodes.size(); ++j)
+                {
+                    if (roi != NULL && !(roi[nodes[j]] > 0.0f)) continue;
+                    gatherOut[nodes[j]].push_back(RefWeight(i, weights[j] * factor));
+                }
+            }
+        }
+    }
+    
+    //straightforward gather, one column and one vertex at a time, in double
+    void referenceSmooth(const vector<vector<RefWeight> >& gather, const MetricFile& input, MetricFile& output, const float* roi, const bool& fixZeros)
+    {
+        const int32_t numNodes = input.getNumberOfNodes();
+        output.setNumberOfNodesAndColumns(numNodes, input.getNumberOfColumns());
+        vector<float> scratch(numNodes);
+        for (int c = 0; c < input.getNumberOfColumns(); ++c)
+        {
+            const float* inCol = input.getValuePointerForColumn(c);
+            for (int32_t i = 0; i < numNodes; ++i)
+            {
+                scratch[i] = 0.0f;
+                if (roi != NULL && !(roi[i] > 0.0f)) continue;
+                double sum = 0.0, weightSum = 0.0;
+                for (int j = 0; j < (int)gather[i].size(); ++j)
+                {
+                    const RefWeight& elem = gather[i][j];
+                    if (roi != NULL && !(roi[elem.node] > 0.0f)) continue;
+                    if (fixZeros && inCol[elem.node] == 0.0f) continue;
+                    sum += elem.weight * (double)inCol[elem.node];
+                    weightSum += elem.weight;
+                }
+                if (weightSum != 0.0) scratch[i] = sum / weightSum;
+            }
+            output.setValuesForColumn(c, scratch.data());
+        }
+    }
+    
+    //compare the compressed rows in a saved weight file (72 byte header, int64 row starts, int32 nodes, float weights) to the reference lists, to check the gather/scatter conversion directly
+    AString compareWeightFile(const AString& weightFile, const vector<vector<RefWeight> >& gather)
+    {
+        QFile myFile(weightFile);
+        if (!myFile.open(QIODevice::ReadOnly)) return "failed to open saved weights";
+        QByteArray contents = myFile.readAll();
+        const int64_t numNodes = (int64_t)gather.size();
+        int64_t header[2];
+        if (contents.size() < 72) return "saved weights are too short";
+        memcpy(header, contents.constData() + 56, 2 * sizeof(int64_t));
+        if (header[0] != numNodes) return "saved weights have the wrong number of vertices";
+        const int64_t numElems = header[1];
+        if (contents.size() != 72 + (numNodes + 1) * 8 + numElems * 8) return "saved weights have the wrong size";
+        vector<int64_t> rowStart(numNodes + 1);
+        vector<int32_t> nodes(numElems);
+        vector<float> weights(numElems);
+        memcpy(rowStart.data(), contents.constData() + 72, rowStart.size() * sizeof(int64_t));
+        if (numElems > 0)
+        {
+            memcpy(nodes.data(), contents.constData() + 72 + (numNodes + 1) * 8, numElems * sizeof(int32_t));
+            memcpy(weights.data(), contents.constData() + 72 + (numNodes + 1) * 8 + numElems * 4, numElems * sizeof(float));
+        }
+        for (int64_t i = 0; i < numNodes; ++i)
+        {
+            if (rowStart[i + 1] - rowStart[i] != (int64_t)gather[i].size()) return "vertex " + AString::number(i) + " has " + AString::number(rowStart[i + 1] - rowStart[i]) +
+                                                                                     " weights, expected " + AString::number(gather[i].size());
+            for (int64_t j = 0; j < (int64_t)gather[i].size(); ++j)
+            {
+                const RefWeight& elem = gather[i][j];
+                if (nodes[rowStart[i] + j] != elem.node) return "vertex " + AString::number(i) + " has weights from the wrong vertices or in the wrong order";
+                if (abs(weights[rowStart[i] + j] - elem.weight) > 1e-6f * abs(elem.weight)) return "vertex " + AString::number(i) + " has a wrong weight";
+            }
+        }
+        return "";
+    }
+    
+    float maxDifference(const MetricFile& first, const MetricFile& second)
+    {
+        float ret = 0.0f;
+        for (int i = 0; i < first.getNumberOfColumns(); ++i)
+        {
+            const float* firstCol = first.getValuePointerForColumn(i), *secondCol = second.getValuePointerForColumn(i);
+            for (int j = 0; j < first.getNumberOfNodes(); ++j)
+            {
+                ret = max(ret, abs(firstCol[j] - secondCol[j]));
+            }
+        }
+        return ret;
+    }
+    
+    //smooths every column separately, the pre-blocking way
+    void smoothByColumn(const MetricSmoothingObject& mySmooth, const MetricFile& input, MetricFile& output, const MetricFile* roi, const bool& fixZeros)
+    {
+        output.setNumberOfNodesAndColumns(input.getNumberOfNodes(), input.getNumberOfColumns());
+        for (int i = 0; i < input.getNumberOfColumns(); ++i)
+        {
+            mySmooth.smoothColumn(&input, i, &output, i, roi, 0, fixZeros);
+        }
+    }
+
+    bool sameValues(const MetricFile& first, const MetricFile& second)
+    {
+        if (first.getNumberOfNodes() != second.getNumberOfNodes() || first.getNumberOfColumns() != second.getNumberOfColumns()) return false;
+        for (int i = 0; i < first.getNumberOfColumns(); ++i)
+        {
+            const float* firstCol = first.getValuePointerForColumn(i), *secondCol = second.getValuePointerForColumn(i);
+            for (int j = 0; j < first.getNumberOfNodes(); ++j)
+            {
+                if (firstCol[j] != secondCol[j]) return false;
+            }
+        }
+        return true;
+    }
+}
+
+void MetricSmoothingTest::execute()
+{
+    SurfaceFile mySphere;
+    AlgorithmSurfaceCreateSphere(NULL, 2000, &mySphere);
+    int numNodes = mySphere.getNumberOfNodes();
+    const int NUM_COLUMNS = 70;//more than one block of columns, and a partial block
+    MetricFile input, roi;
+    input.setNumberOfNodesAndColumns(numNodes, NUM_COLUMNS);
+    roi.setNumberOfNodesAndColumns(numNodes, 1);
+    vector<float> scratch(numNodes);
+    for (int i = 0; i < NUM_COLUMNS; ++i)
+    {
+        for (int j = 0; j < numNodes; ++j)
+        {
+            scratch[j] = (rand() % 5 == 0 ? 0.0f : ((float)rand()) / RAND_MAX - 0.5f);//zeros for -fix-zeros
+        }
+        input.setValuesForColumn(i, scratch.data());
+    }
+    for (int j = 0; j < numNodes; ++j)
+    {
+        scratch[j] = (mySphere.getCoordinate(j)[2] > -50.0f ? 1.0f : 0.0f);
+    }
+    roi.setValuesForColumn(0, scratch.data());
+    const MetricSmoothingObject::Method methods[3] = { MetricSmoothingObject::GEO_GAUSS_AREA, MetricSmoothingObject::GEO_GAUSS_EQUAL, MetricSmoothingObject::GEO_GAUSS };
+    const char* methodNames[3] = { "GEO_GAUSS_AREA", "GEO_GAUSS_EQUAL", "GEO_GAUSS" };
+    for (int m = 0; m < 3; ++m)
+    {
+        for (int buildRoi = 0; buildRoi < 2; ++buildRoi)
+        {
+            MetricSmoothingObject mySmooth(&mySphere, 8.0f, (buildRoi ? &roi : NULL), methods[m]);
+            for (int useRoi = 0; useRoi < 2; ++useRoi)
+            {
+                for (int fixZeros = 0; fixZeros < 2; ++fixZeros)
+                {
+                    AString condition = AString(methodNames[m]) + (buildRoi ? ", roi weights" : "") + (useRoi ? ", roi" : "") + (fixZeros ? ", fix zeros" : "");
+                    MetricFile byColumn, blocked;
+                    smoothByColumn(mySmooth, input, byColumn, (useRoi ? &roi : NULL), fixZeros);
+                    mySmooth.smoothMetric(&input, &blocked, (useRoi ? &roi : NULL), fixZeros);
+                    if (!sameValues(byColumn, blocked)) setFailed(condition + ", blocked smoothing differs from smoothing each column");
+                }
+            }
+        }
+    }
+    QString tempDir = QDir::tempPath() + "/wb_smoothing_test_" + QString::number(QCoreApplication::applicationPid());
+    QDir().mkpath(tempDir);
+    const float* roiColumn = roi.getValuePointerForColumn(0);
+    MetricFile ones;
+    ones.setNumberOfNodesAndColumns(numNodes, 1);
+    ones.initializeColumn(0, 1.0f);
+    try
+    {//compare against weights and smoothing computed independently, covering both the gathering (GEO_GAUSS) and scattering (GEO_GAUSS_AREA) conversions
+        AString weightFile = tempDir + "/reference.wbsmw";
+        const MetricSmoothingObject::Method refMethods[2] = { MetricSmoothingObject::GEO_GAUSS, MetricSmoothingObject::GEO_GAUSS_AREA };
+        for (int m = 0; m < 2; ++m)
+        {
+            for (int buildRoi = 0; buildRoi < 2; ++buildRoi)
+            {
+                AString condition = AString(refMethods[m] == MetricSmoothingObject::GEO_GAUSS ? "GEO_GAUSS" : "GEO_GAUSS_AREA") + (buildRoi ? " with roi weights" : "");
+                vector<vector<RefWeight> > refGather;
+                referenceWeights(mySphere, 8.0f, (buildRoi ? roiColumn : NULL), refMethods[m], refGather);
+                MetricSmoothingObject mySmooth(&mySphere, 8.0f, (buildRoi ? &roi : NULL), refMethods[m]);
+                mySmooth.writeToFile(weightFile);
+                AString weightError = compareWeightFile(weightFile, refGather);
+                if (weightError != "") setFailed(condition + ": " + weightError);
+                QFile::remove(weightFile);
+                for (int useRoi = 0; useRoi < 2; ++useRoi)
+                {
+                    for (int fixZeros = 0; fixZeros < 2; ++fixZeros)
+                    {
+                        MetricFile refOut, output;
+                        referenceSmooth(refGather, input, refOut, (useRoi || buildRoi ? roiColumn : NULL), fixZeros);
+                        mySmooth.smoothMetric(&input, &output, (useRoi ? &roi : NULL), fixZeros);
+                        float diff = maxDifference(refOut, output);
+                        if (diff > 1e-5f) setFailed(condition + (useRoi ? ", roi" : "") + (fixZeros ? ", fix zeros" : "") + ": smoothing differs from the reference by " + AString::number(diff));
+                    }
+                }
+                MetricFile onesOut;//with the stored weight sums, a constant stays constant where there are weights, and is 0 elsewhere
+                mySmooth.smoothMetric(&ones, &onesOut);
+                const float* onesData = onesOut.getValuePointerForColumn(0);
+                for (int32_t i = 0; i < numNodes; ++i)
+                {
+                    float expect = (refGather[i].empty() ? 0.0f : 1.0f);
+                    if (abs(onesData[i] - expect) > 1e-5f)
+                    {
+                        setFailed(condition + ": weight sum of vertex " + AString::number(i) + " is wrong, smoothing a constant gave " + AString::number(onesData[i]));
+                        break;
+                    }
+                }
+            }
+        }
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    MetricSmoothingObject mySmooth(&mySphere, 8.0f, &roi);
+    MetricFile expected, output;
+    mySmooth.smoothMetric(&input, &expected, NULL, true);
+    try
+    {
+        AString weightFile = tempDir + "/weights.wbsmw";
+        mySmooth.writeToFile(weightFile);
+        MetricSmoothingObject fromFile(weightFile);
+        fromFile.smoothMetric(&input, &output, NULL, true);
+        if (!sameValues(expected, output)) setFailed("smoothing with saved weights differs");
+        QFile::remove(weightFile);
+        MetricSmoothingObject::setCacheDirectory(tempDir);
+        MetricSmoothingObject cacheFill(&mySphere, 8.0f, &roi);
+        if (QDir(tempDir).entryList(QDir::Files).size() != 1) setFailed("smoothing weights were not saved to the cache directory");
+        MetricSmoothingObject fromCache(&mySphere, 8.0f, &roi);
+        fromCache.smoothMetric(&input, &output, NULL, true);
+        if (!sameValues(expected, output)) setFailed("smoothing with cached weights differs");
+        MetricSmoothingObject otherKernel(&mySphere, 6.0f, &roi);
+        if (QDir(tempDir).entryList(QDir::Files).size() != 2) setFailed("a different kernel should not reuse the cached weights");
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    MetricSmoothingObject::setCacheDirectory("");
+    QDir myDir(tempDir);
+    QStringList fileList = myDir.entryList(QDir::Files);
+    for (int i = 0; i < fileList.size(); ++i)
+    {
+        myDir.remove(fileList[i]);
+    }
+    QDir().rmdir(tempDir);
+}
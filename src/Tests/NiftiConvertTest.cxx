@@ -0,0 +1,181 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "NiftiConvertTest.h"
+
+#include "ElapsedTimer.h"
+#include "NiftiConvert.h"
+#include "nifti1.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+NiftiConvertTest::NiftiConvertTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t NUM_ELEMS = 1 << 22;//16MB of float, big enough to get past the caches
+    const int NUM_REPEATS = 4;
+    const double MULT = 0.37, OFFSET = -3.1;//arbitrary scaling that isn't exact in binary
+    
+    //runs all combinations of swapping and scaling, so the benchmark covers the fused paths
+    double timeRead(float* out, const char* in, const int16_t& datatype, const int64_t& count)
+    {
+        ElapsedTimer myTimer;
+        myTimer.start();
+        for (int rep = 0; rep < NUM_REPEATS; ++rep)
+        {
+            for (int combo = 0; combo < 4; ++combo)
+            {
+                NiftiConvert::readToFloat(out, in, datatype, count, (combo & 1) != 0, (combo & 2) != 0, MULT, OFFSET);
+            }
+        }
+        return myTimer.getElapsedTimeSeconds();
+    }
+    
+    double timeWrite(char* out, const float* in, const int16_t& datatype, const int64_t& count)
+    {
+        ElapsedTimer myTimer;
+        myTimer.start();
+        for (int rep = 0; rep < NUM_REPEATS; ++rep)
+        {
+            for (int combo = 0; combo < 4; ++combo)
+            {
+                NiftiConvert::writeFromFloat(out, in, datatype, count, (combo & 1) != 0, (combo & 2) != 0, MULT, OFFSET);
+            }
+        }
+        return myTimer.getElapsedTimeSeconds();
+    }
+    
+    AString gbPerSec(const int64_t& bytes, const double& seconds)
+    {
+        if (seconds <= 0.0) return "inf";
+        return AString::number(bytes * 4.0 * NUM_REPEATS / seconds / 1e9, 'f', 2);
+    }
+}
+
+void NiftiConvertTest::testDatatype(const int16_t& datatype, const int& byteSize, const char* name)
+{
+    vector<char> fileData(NUM_ELEMS * byteSize + 1);//offset by one byte to test unaligned input, like a mapping gives
+    char* unaligned = fileData.data() + 1;
+    for (size_t i = 0; i < fileData.size(); ++i)
+    {
+        fileData[i] = (char)rand();
+    }
+    if (datatype == NIFTI_TYPE_FLOAT32 || datatype == NIFTI_TYPE_FLOAT64)
+    {//random bytes give NaNs and huge values, use something realistic instead
+        for (int64_t i = 0; i < NUM_ELEMS; ++i)
+        {
+            double value = (rand() - RAND_MAX / 2) / 1000.0;
+            if (datatype == NIFTI_TYPE_FLOAT32)
+            {
+                float temp = (float)value;
+                memcpy(unaligned + i * 4, &temp, 4);
+            } else {
+                memcpy(unaligned + i * 8, &value, 8);
+            }
+        }
+    }
+    vector<float> memData(NUM_ELEMS);
+    for (int64_t i = 0; i < NUM_ELEMS; ++i)
+    {
+        memData[i] = (rand() - RAND_MAX / 2) / (float)(RAND_MAX / 100000);//beyond int16 range, to test clamping
+    }
+    memData[0] = 0.5f;//rounding edge cases
+    memData[1] = -0.5f;
+    memData[2] = -1.5f;
+    memData[3] = 1e30f;
+    memData[4] = -1e30f;
+    const int64_t testCount = NUM_ELEMS - 3;//not a multiple of the vector width, to exercise the leftovers
+    vector<float> naiveRead(NUM_ELEMS), simdRead(NUM_ELEMS);
+    vector<char> naiveWrite(NUM_ELEMS * byteSize), simdWrite(NUM_ELEMS * byteSize);
+    vector<NiftiConvert::Impl> impls;
+    impls.push_back(NiftiConvert::SSE2);
+    impls.push_back(NiftiConvert::AVX2);
+    for (int combo = 0; combo < 4; ++combo)
+    {
+        bool swap = (combo & 1) != 0, doScale = (combo & 2) != 0;
+        if (NiftiConvert::setImpl(NiftiConvert::NAIVE) != NiftiConvert::NAIVE)
+        {
+            setFailed("failed to set implementation to NAIVE");
+            return;
+        }
+        if (!NiftiConvert::readToFloat(naiveRead.data(), unaligned, datatype, testCount, swap, doScale, MULT, OFFSET) ||
+            !NiftiConvert::writeFromFloat(naiveWrite.data(), memData.data(), datatype, testCount, swap, doScale, MULT, OFFSET))
+        {
+            setFailed(AString("no conversion kernel for ") + name);
+            return;
+        }
+        for (int i = 0; i < (int)impls.size(); ++i)
+        {
+            NiftiConvert::Impl inUse = NiftiConvert::setImpl(impls[i]);
+            if (inUse != impls[i]) continue;
+            NiftiConvert::readToFloat(simdRead.data(), unaligned, datatype, testCount, swap, doScale, MULT, OFFSET);
+            NiftiConvert::writeFromFloat(simdWrite.data(), memData.data(), datatype, testCount, swap, doScale, MULT, OFFSET);
+            //simd kernels do the same double math as the naive ones, so require identical results
+            if (memcmp(naiveRead.data(), simdRead.data(), testCount * sizeof(float)) != 0)
+            {
+                setFailed(AString(NiftiConvert::getImplName(inUse)) + " reading " + name + " doesn't match naive, swap = " +
+                          AString::number(swap) + ", scale = " + AString::number(doScale));
+            }
+            if (memcmp(naiveWrite.data(), simdWrite.data(), testCount * byteSize) != 0)
+            {
+                setFailed(AString(NiftiConvert::getImplName(inUse)) + " writing " + name + " doesn't match naive, swap = " +
+                          AString::number(swap) + ", scale = " + AString::number(doScale));
+            }
+        }
+    }
+    impls.insert(impls.begin(), NiftiConvert::NAIVE);
+    for (int i = 0; i < (int)impls.size(); ++i)
+    {
+        NiftiConvert::Impl inUse = NiftiConvert::setImpl(impls[i]);
+        if (inUse != impls[i])
+        {
+            cout << "skipping " << NiftiConvert::getImplName(impls[i]) << ", not supported" << endl;
+            continue;
+        }
+        double readTime = timeRead(simdRead.data(), unaligned, datatype, NUM_ELEMS);
+        double writeTime = timeWrite(simdWrite.data(), memData.data(), datatype, NUM_ELEMS);
+        cout << setw(8) << name << " " << setw(5) << NiftiConvert::getImplName(inUse)
+             << ": read " << gbPerSec(NUM_ELEMS * byteSize, readTime) << " GB/s, write " << gbPerSec(NUM_ELEMS * byteSize, writeTime) << " GB/s (file bytes)" << endl;
+    }
+    NiftiConvert::setImpl(NiftiConvert::AUTO);
+}
+
+void NiftiConvertTest::execute()
+{
+    testDatatype(NIFTI_TYPE_UINT8, 1, "UINT8");
+    testDatatype(NIFTI_TYPE_INT8, 1, "INT8");
+    testDatatype(NIFTI_TYPE_UINT16, 2, "UINT16");
+    testDatatype(NIFTI_TYPE_INT16, 2, "INT16");
+    testDatatype(NIFTI_TYPE_UINT32, 4, "UINT32");
+    testDatatype(NIFTI_TYPE_INT32, 4, "INT32");
+    testDatatype(NIFTI_TYPE_FLOAT32, 4, "FLOAT32");
+    testDatatype(NIFTI_TYPE_FLOAT64, 8, "FLOAT64");
+}
@@ -0,0 +1,182 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "PaletteColoringTest.h"
+
+#include "FastStatistics.h"
+#include "NodeAndVoxelColoring.h"
+#include "Palette.h"
+#include "PaletteColorMapping.h"
+#include "PaletteFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+PaletteColoringTest::PaletteColoringTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const float positiveGreen[4] = { 115.0f / 255.0f, 255.0f / 255.0f, 180.0f / 255.0f, 255.0f / 255.0f };
+    const float negativeGreen[4] = { 180.0f / 255.0f, 255.0f / 255.0f, 115.0f / 255.0f, 255.0f / 255.0f };
+    
+    //coloring a scalar at a time by searching the palette, as it was done before the lookup table, including thresholding
+    void referenceColoring(const FastStatistics* myStats, const PaletteColorMapping* myMapping, const Palette* myPalette,
+                           const float* scalars, const float* thresholds, const int64_t& numScalars, float* rgbaOut)
+    {
+        vector<float> normalized(numScalars);
+        myMapping->mapDataToPaletteNormalizedValues(myStats, scalars, normalized.data(), numScalars);
+        const bool interpolate = myMapping->isInterpolatePaletteFlag();
+        const PaletteThresholdTypeEnum::Enum thresholdType = myMapping->getThresholdType();
+        const float thresholdMinimum = myMapping->getThresholdMinimum(thresholdType);
+        const float thresholdMaximum = myMapping->getThresholdMaximum(thresholdType);
+        const bool showOutside = (myMapping->getThresholdTest() == PaletteThresholdTestEnum::THRESHOLD_TEST_SHOW_OUTSIDE);
+        for (int64_t i = 0; i < numScalars; ++i)
+        {
+            float* thisRGBA = rgbaOut + i * 4;
+            for (int j = 0; j < 4; ++j) thisRGBA[j] = 0.0f;
+            float normalValue = normalized[i];
+            if (scalars[i] > PaletteColorMapping::SMALL_POSITIVE)
+            {
+                if (!myMapping->isDisplayPositiveDataFlag()) continue;
+            } else if (scalars[i] < PaletteColorMapping::SMALL_NEGATIVE) {
+                if (!myMapping->isDisplayNegativeDataFlag()) continue;
+            } else {
+                normalValue = 0.0f;
+                if (!myMapping->isDisplayZeroDataFlag()) continue;
+            }
+            myPalette->getPaletteColor(max(-1.0f, min(1.0f, normalValue)), interpolate, thisRGBA);
+            if (thisRGBA[3] <= 0.0f)
+            {
+                for (int j = 0; j < 4; ++j) thisRGBA[j] = 0.0f;
+            }
+            if (thresholdType == PaletteThresholdTypeEnum::THRESHOLD_TYPE_OFF) continue;
+            const float threshold = thresholds[i];
+            bool passed;
+            if (showOutside)
+            {
+                passed = (threshold > thresholdMaximum || threshold < thresholdMinimum);
+            } else {
+                passed = (threshold >= thresholdMinimum && threshold <= thresholdMaximum);
+            }
+            if (passed) continue;
+            thisRGBA[3] = 0.0f;
+            if (myMapping->isShowThresholdFailureInGreen() && thresholdType == PaletteThresholdTypeEnum::THRESHOLD_TYPE_MAPPED)
+            {
+                if (threshold > 0.0f && threshold < myMapping->getThresholdMappedMaximum() && threshold > myMapping->getThresholdMappedAverageAreaMaximum())
+                {
+                    for (int j = 0; j < 4; ++j) thisRGBA[j] = positiveGreen[j];
+                } else if (threshold < 0.0f && threshold > myMapping->getThresholdMappedMinimum() && threshold < myMapping->getThresholdMappedAverageAreaMinimum()) {
+                    for (int j = 0; j < 4; ++j) thisRGBA[j] = negativeGreen[j];
+                }
+            }
+        }
+    }
+    
+    void setThresholding(PaletteColorMapping& myMapping, const int& mode)
+    {
+        switch (mode)
+        {
+            case 0:
+                myMapping.setThresholdType(PaletteThresholdTypeEnum::THRESHOLD_TYPE_OFF);
+                break;
+            case 1:
+            case 2:
+                myMapping.setThresholdType(PaletteThresholdTypeEnum::THRESHOLD_TYPE_NORMAL);
+                myMapping.setThresholdTest(mode == 1 ? PaletteThresholdTestEnum::THRESHOLD_TEST_SHOW_INSIDE : PaletteThresholdTestEnum::THRESHOLD_TEST_SHOW_OUTSIDE);
+                myMapping.setThresholdNormalMinimum(-2.0f);
+                myMapping.setThresholdNormalMaximum(3.0f);
+                break;
+            case 3:
+                myMapping.setThresholdType(PaletteThresholdTypeEnum::THRESHOLD_TYPE_MAPPED);
+                myMapping.setThresholdTest(PaletteThresholdTestEnum::THRESHOLD_TEST_SHOW_OUTSIDE);
+                myMapping.setThresholdMappedMinimum(-4.0f);
+                myMapping.setThresholdMappedMaximum(4.0f);
+                myMapping.setThresholdMappedAverageAreaMinimum(-1.0f);
+                myMapping.setThresholdMappedAverageAreaMaximum(1.0f);
+                myMapping.setShowThresholdFailureInGreen(true);
+                break;
+        }
+    }
+    
+    const char* THRESHOLD_NAMES[4] = { "no threshold", "threshold inside", "threshold outside", "mapped threshold in green" };
+}
+
+void PaletteColoringTest::execute()
+{
+    const int64_t NUM_SCALARS = 91282;//grayordinates in a standard dscalar
+    const int NUM_THRESHOLD_MODES = 4;
+    vector<float> scalars(NUM_SCALARS), thresholds(NUM_SCALARS);
+    for (int64_t i = 0; i < NUM_SCALARS; ++i)
+    {
+        if (i % 10 == 0)
+        {
+            scalars[i] = 0.0f;//some exact zeros, and some small values near the palette zero zone
+        } else if (i % 10 == 1) {
+            scalars[i] = (rand() - RAND_MAX / 2) * 1e-9f;
+        } else {
+            scalars[i] = (rand() - RAND_MAX / 2) * 10.0f / RAND_MAX;
+        }
+        thresholds[i] = (rand() - RAND_MAX / 2) * 10.0f / RAND_MAX;
+        if (i % 100 == 0) thresholds[i] = 3.0f;//exactly on a threshold boundary
+    }
+    FastStatistics myStats(scalars.data(), NUM_SCALARS);
+    PaletteFile myPaletteFile;
+    vector<float> rgba(NUM_SCALARS * 4), refRGBA(NUM_SCALARS * 4);
+    for (int p = 0; p < myPaletteFile.getNumberOfPalettes(); ++p)
+    {
+        const Palette* myPalette = myPaletteFile.getPalette(p);
+        for (int interp = 0; interp < 2; ++interp)
+        {
+            for (int thresh = 0; thresh < NUM_THRESHOLD_MODES; ++thresh)
+            {
+                PaletteColorMapping myMapping;
+                myMapping.setScaleMode(PaletteScaleModeEnum::MODE_AUTO_SCALE);
+                myMapping.setDisplayNegativeDataFlag(true);
+                myMapping.setDisplayPositiveDataFlag(true);
+                myMapping.setDisplayZeroDataFlag(true);
+                myMapping.setInterpolatePaletteFlag(interp != 0);
+                setThresholding(myMapping, thresh);
+                referenceColoring(&myStats, &myMapping, myPalette, scalars.data(), thresholds.data(), NUM_SCALARS, refRGBA.data());
+                NodeAndVoxelColoring::colorScalarsWithPalette(&myStats, &myMapping, myPalette, scalars.data(), thresholds.data(), NUM_SCALARS, rgba.data());
+                //without interpolation, the table is constant between palette scalars, so the colors are exact, interpolated colors differ by float rounding
+                //the threshold outcome (transparent or green) must always be exact
+                const float tolerance = (interp != 0 ? 0.00001f : 0.0f);
+                for (int64_t i = 0; i < NUM_SCALARS * 4; ++i)
+                {
+                    bool alphaMismatch = (i % 4 == 3 && (rgba[i] > 0.0f) != (refRGBA[i] > 0.0f));
+                    if (alphaMismatch || abs(rgba[i] - refRGBA[i]) > tolerance)
+                    {
+                        setFailed("palette '" + myPalette->getName() + "' lookup color differs from palette search with " + THRESHOLD_NAMES[thresh] +
+                                  (interp != 0 ? ", interpolated" : "") + " at scalar " + AString::number(scalars[i / 4]) +
+                                  ": " + AString::number(rgba[i]) + " vs " + AString::number(refRGBA[i]));
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,144 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "PointLocatorTest.h"
+
+#include "CaretPointLocator.h"
+#include "CaretPointLocatorOld.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+PointLocatorTest::PointLocatorTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    //points on a bumpy sphere, like a surface, with some exact duplicates
+    void makePoints(const int64_t& numPoints, vector<float>& coordsOut)
+    {
+        coordsOut.resize(numPoints * 3);
+        for (int64_t i = 0; i < numPoints; ++i)
+        {
+            float z = 2.0f * rand() / RAND_MAX - 1.0f, angle = 6.2831853f * rand() / RAND_MAX;
+            float radius = 100.0f + 5.0f * sin(angle * 7.0f) * z;
+            float xyRadius = sqrt(max(0.0f, 1.0f - z * z));
+            coordsOut[i * 3] = radius * xyRadius * cos(angle);
+            coordsOut[i * 3 + 1] = radius * xyRadius * sin(angle);
+            coordsOut[i * 3 + 2] = radius * z;
+        }
+        for (int64_t i = 1; i < numPoints; i += 97)
+        {
+            for (int k = 0; k < 3; ++k) coordsOut[i * 3 + k] = coordsOut[(i - 1) * 3 + k];
+        }
+    }
+
+    float dist2(const float* coords, const int64_t& index, const float target[3])
+    {
+        float dx = coords[index * 3] - target[0], dy = coords[index * 3 + 1] - target[1], dz = coords[index * 3 + 2] - target[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+}
+
+void PointLocatorTest::execute()
+{
+    const int64_t NUM_POINTS = 164000, NUM_TARGETS = 20000;
+    vector<float> coords, targets;
+    makePoints(NUM_POINTS, coords);
+    makePoints(NUM_TARGETS, targets);
+    for (int64_t i = 0; i < NUM_TARGETS * 3; ++i)
+    {
+        targets[i] *= 1.0f + 0.1f * rand() / RAND_MAX;//some off the surface
+    }
+    CaretPointLocatorOld oldLocator(coords.data(), NUM_POINTS);
+    CaretPointLocator newLocator(coords.data(), NUM_POINTS);
+    vector<int64_t> oldClosest(NUM_TARGETS), newClosest(NUM_TARGETS);
+    for (int64_t i = 0; i < NUM_TARGETS; ++i)
+    {
+        oldClosest[i] = oldLocator.closestPoint(targets.data() + i * 3);
+    }
+    newLocator.closestPoints(targets.data(), NUM_TARGETS, newClosest.data());
+    const float RANGE = 3.0f;
+    vector<int64_t> rangeScratch;
+    for (int64_t i = 0; i < NUM_TARGETS; ++i)
+    {
+        const float* target = targets.data() + i * 3;
+        if (dist2(coords.data(), oldClosest[i], target) != dist2(coords.data(), newClosest[i], target))
+        {//ties can pick different points, but the distance must be the same
+            setFailed("closest point differs for target " + AString::number(i));
+            return;
+        }
+        if (newLocator.closestPoint(target) != newClosest[i])
+        {
+            setFailed("batched closest point differs from single query for target " + AString::number(i));
+            return;
+        }
+        int64_t oldLimited = oldLocator.closestPointLimited(target, RANGE), newLimited = newLocator.closestPointLimited(target, RANGE);
+        if ((oldLimited == -1) != (newLimited == -1) || (newLimited != -1 && dist2(coords.data(), oldLimited, target) != dist2(coords.data(), newLimited, target)))
+        {
+            setFailed("limited closest point differs for target " + AString::number(i));
+            return;
+        }
+        if (i % 10 == 0)
+        {
+            set<LocatorInfo> oldRange = oldLocator.pointsInRange(target, RANGE), newRange = newLocator.pointsInRange(target, RANGE);
+            if (oldRange != newRange)
+            {
+                setFailed("points in range differ for target " + AString::number(i));
+                return;
+            }
+            newLocator.pointsInRange(target, RANGE, rangeScratch);
+            if (rangeScratch.size() != newRange.size())
+            {
+                setFailed("points in range into a buffer differ for target " + AString::number(i));
+                return;
+            }
+            if (oldLocator.anyInRange(target, RANGE) != newLocator.anyInRange(target, RANGE))
+            {
+                setFailed("any in range differs for target " + AString::number(i));
+                return;
+            }
+        }
+    }
+    {//multiple point sets
+        CaretPointLocator multiLocator(coords.data(), NUM_POINTS / 2);
+        int32_t secondSet = multiLocator.addPointSet(coords.data() + (NUM_POINTS / 2) * 3, NUM_POINTS - NUM_POINTS / 2);
+        for (int64_t i = 0; i < 1000; ++i)
+        {
+            LocatorInfo myInfo(-1, -1, Vector3D());
+            int64_t found = multiLocator.closestPoint(targets.data() + i * 3, &myInfo);
+            int64_t fullIndex = (myInfo.whichSet == secondSet ? found + NUM_POINTS / 2 : found);
+            if (dist2(coords.data(), fullIndex, targets.data() + i * 3) != dist2(coords.data(), newClosest[i], targets.data() + i * 3))
+            {
+                setFailed("closest point across two point sets differs for target " + AString::number(i));
+                return;
+            }
+        }
+        multiLocator.removePointSet(secondSet);
+        LocatorInfo myInfo(-1, -1, Vector3D());
+        multiLocator.closestPoint(targets.data(), &myInfo);
+        if (myInfo.whichSet != 0) setFailed("removed point set was still searched");
+    }
+}
@@ -0,0 +1,183 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ProfilerTest.h"
+
+#include "CaretException.h"
+#include "CaretOMP.h"
+#include "CaretProfiler.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QThread>
+
+using namespace caret;
+using namespace std;
+
+ProfilerTest::ProfilerTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int NUM_ROWS = 10000;
+    const int NUM_CHUNKS = 16;
+    const char* QUOTED_NAME = "profiler test \"quoted\" \\ scope";
+
+    class ProfilerTestThread : public QThread
+    {
+    public:
+        void run()
+        {//state of this thread is merged when it exits, before the report is made
+            CaretProfileScope myScope("profiler test thread");
+            CaretProfiler::addCounter("profiler test thread counter", 5);
+        }
+    };
+
+    //report lines are total, self and calls in columns of 12, 12 and 9, then two spaces, then the name indented by 2 per level
+    bool findScopeLine(const AString& report, const AString& name, int64_t& callsOut, int& depthOut)
+    {
+        QStringList lines = report.split('\n');
+        for (int i = 0; i < lines.size(); ++i)
+        {
+            if (lines[i].size() <= 35) continue;
+            QString nameField = lines[i].mid(35);
+            QString trimmed = nameField.trimmed();
+            if (trimmed != name) continue;
+            callsOut = lines[i].mid(24, 9).trimmed().toLongLong();
+            depthOut = (nameField.size() - nameField.trimmed().size()) / 2;
+            return true;
+        }
+        return false;
+    }
+}
+
+void ProfilerTest::checkScope(const AString& report, const AString& name, const int64_t& calls, const int& depth)
+{
+    int64_t foundCalls = -1;
+    int foundDepth = -1;
+    if (!findScopeLine(report, name, foundCalls, foundDepth))
+    {
+        setFailed("scope '" + name + "' is missing from the report");
+        return;
+    }
+    if (foundCalls != calls) setFailed("scope '" + name + "' has " + AString::number(foundCalls) + " calls, expected " + AString::number(calls));
+    if (foundDepth != depth) setFailed("scope '" + name + "' is at depth " + AString::number(foundDepth) + ", expected " + AString::number(depth));
+}
+
+void ProfilerTest::checkCounter(const AString& report, const AString& name, const int64_t& total)
+{
+    int start = report.indexOf("counter totals:\n");
+    if (start == -1 || !report.mid(start).contains("  " + name + ": " + AString::number(total) + "\n"))
+    {
+        setFailed("counter total for '" + name + "' should be " + AString::number(total) + ", report:\n" + report);
+    }
+}
+
+void ProfilerTest::traceTest(const AString& traceFile)
+{
+    CaretProfiler::writeTrace(traceFile);
+    AString text = AString::fromUtf8(readBytes(traceFile));
+    if (!text.startsWith("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n") || !text.endsWith("\n]}\n")) setFailed("trace file has the wrong framing");
+    if (text.count("{\"name\": \"profiler test inner\", \"ph\": \"X\"") != 3) setFailed("trace file should have 3 events for the inner scope");
+    if (text.count("{\"name\": \"profiler test chunk\", \"ph\": \"X\"") != NUM_CHUNKS) setFailed("trace file should have an event for each worker scope");
+    if (!text.contains("{\"name\": \"profiler test \\\"quoted\\\" \\\\ scope\", \"ph\": \"X\"")) setFailed("scope name was not escaped in the trace file");
+    //counter samples are per thread increments, the trace must show a running total that ends at the full count
+    QStringList lines = text.split('\n');
+    int64_t lastValue = -1;
+    bool increasing = true;
+    const QString counterStart = "{\"name\": \"profiler test rows\", \"ph\": \"C\"", valueKey = "\"value\": ";
+    for (int i = 0; i < lines.size(); ++i)
+    {
+        if (!lines[i].startsWith(counterStart)) continue;
+        int valueStart = lines[i].indexOf(valueKey) + valueKey.size();
+        int64_t value = lines[i].mid(valueStart, lines[i].indexOf('}', valueStart) - valueStart).toLongLong();
+        if (value < lastValue) increasing = false;
+        lastValue = value;
+    }
+    if (lastValue != NUM_ROWS) setFailed("last trace sample of the row counter is " + AString::number(lastValue) + ", expected " + AString::number(NUM_ROWS));
+    if (!increasing) setFailed("trace samples of the row counter decrease");
+}
+
+void ProfilerTest::execute()
+{
+    QString tempDir = QDir::tempPath() + "/wb_profiler_test_" + QString::number(QCoreApplication::applicationPid());
+    QDir().mkpath(tempDir);
+    QString traceFile = tempDir + "/trace.json";
+    try
+    {
+        CaretProfiler::enable(true);
+        {
+            CaretProfileScope outer("profiler test outer");
+            for (int i = 0; i < 3; ++i)
+            {
+                CaretProfileScope inner("profiler test inner");
+                CaretProfiler::addCounter("profiler test inner counter", 2);
+            }
+            {
+                CaretProfileScope quoted(QUOTED_NAME);
+            }
+            //workers without scopes of their own count toward the scope that started the loop
+#pragma omp CARET_PARFOR schedule(dynamic, 7)
+            for (int i = 0; i < NUM_ROWS; ++i)
+            {
+                CaretProfiler::addCounter("profiler test rows");
+            }
+#pragma omp CARET_PARFOR schedule(dynamic)
+            for (int i = 0; i < NUM_CHUNKS; ++i)
+            {
+                CaretProfileScope chunk("profiler test chunk");
+            }
+            ProfilerTestThread myThread;
+            myThread.start();
+            myThread.wait();
+        }
+        AString report = CaretProfiler::getReport();
+        checkScope(report, "profiler test outer", 1, 0);
+        checkScope(report, "profiler test inner", 3, 1);
+        checkScope(report, "profiler test chunk", NUM_CHUNKS, 1);
+        checkScope(report, "profiler test thread", 1, 1);
+        checkCounter(report, "profiler test rows", NUM_ROWS);
+        checkCounter(report, "profiler test inner counter", 6);
+        checkCounter(report, "profiler test thread counter", 5);
+        if (!report.contains("[profiler test rows: " + AString::number(NUM_ROWS) + "]")) setFailed("row counter was not attributed to a scope");
+        CaretProfiler::disable();
+        CaretProfiler::addCounter("profiler test rows");
+        {
+            CaretProfileScope ignored("profiler test disabled");
+        }
+        report = CaretProfiler::getReport();
+        checkCounter(report, "profiler test rows", NUM_ROWS);
+        if (report.contains("profiler test disabled")) setFailed("scope was recorded while disabled");
+        traceTest(traceFile);
+        CaretProfiler::enable(false);//restarting must forget the previous run
+        report = CaretProfiler::getReport();
+        if (report.contains("profiler test outer") || report.contains("counter totals:")) setFailed("restarting the profiler kept the previous results");
+        CaretProfiler::writeTrace(traceFile);
+        if (readBytes(traceFile) != QByteArray("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n\n]}\n")) setFailed("trace file after a restart should be empty");
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    CaretProfiler::disable();
+    QFile::remove(traceFile);
+    QDir().rmdir(tempDir);
+}
@@ -0,0 +1,316 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "RemoteCiftiTest.h"
+
+#include "ByteOrderEnum.h"
+#include "ByteSwapping.h"
+#include "CaretMutex.h"
+#include "CiftiFile.h"
+#include "CiftiRemoteBlockCache.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QSemaphore>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+RemoteCiftiTest::RemoteCiftiTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t NUM_ROWS = 50, ROW_LENGTH = 65536;//4 rows per block, and every value is exact as a float
+
+    float expectedValue(const int64_t& row, const int64_t& col)
+    {
+        return row * ROW_LENGTH + col;
+    }
+
+    //stand-in for the data server, on its own thread so the blocking client can talk to it
+    //answers one request per connection and then closes it, so connections never wait on each other
+    class RowServer : public QThread
+    {
+        CaretMutex m_mutex;
+        QSemaphore m_ready;
+        QByteArray m_metadata;
+        AString m_etag;
+        bool m_supportRowCount, m_stop;
+        int64_t m_rowRequests;
+        int m_port;
+        void handle(QTcpSocket* socket);
+    protected:
+        void run();
+    public:
+        RowServer(const CiftiXML& xml)
+        {
+            m_metadata = xml.writeXMLToQByteArray();
+            m_etag = "\"version1\"";
+            m_supportRowCount = true;
+            m_stop = false;
+            m_rowRequests = 0;
+            m_port = -1;
+        }
+        int startServer()
+        {
+            start();
+            m_ready.acquire();
+            return m_port;
+        }
+        void stopServer()
+        {
+            {
+                CaretMutexLocker locked(&m_mutex);
+                m_stop = true;
+            }
+            wait();
+        }
+        void setSupportRowCount(const bool& support) { CaretMutexLocker locked(&m_mutex); m_supportRowCount = support; }
+        void setETag(const AString& etag) { CaretMutexLocker locked(&m_mutex); m_etag = etag; }
+        int64_t takeRowRequests()
+        {
+            CaretMutexLocker locked(&m_mutex);
+            int64_t ret = m_rowRequests;
+            m_rowRequests = 0;
+            return ret;
+        }
+    };
+
+    void RowServer::run()
+    {
+        QTcpServer myServer;
+        if (myServer.listen(QHostAddress::LocalHost, 0)) m_port = myServer.serverPort();
+        m_ready.release();
+        if (m_port < 0) return;
+        while (true)
+        {
+            {
+                CaretMutexLocker locked(&m_mutex);
+                if (m_stop) break;
+            }
+            if (!myServer.waitForNewConnection(50)) continue;
+            QTcpSocket* mySocket = myServer.nextPendingConnection();
+            while (mySocket != NULL)
+            {
+                handle(mySocket);
+                delete mySocket;
+                mySocket = myServer.nextPendingConnection();
+            }
+        }
+    }
+
+    void RowServer::handle(QTcpSocket* socket)
+    {
+        QByteArray received;
+        int headerEnd = -1;
+        while ((headerEnd = received.indexOf("\r\n\r\n")) < 0)
+        {
+            if (!socket->waitForReadyRead(5000)) return;
+            received += socket->readAll();
+        }
+        QList<QByteArray> headerLines = received.left(headerEnd).split('\n');
+        int64_t contentLength = 0;
+        for (int i = 1; i < headerLines.size(); ++i)
+        {
+            if (headerLines[i].toLower().startsWith("content-length:")) contentLength = headerLines[i].mid(15).trimmed().toLongLong();
+        }
+        while (received.size() < headerEnd + 4 + contentLength)
+        {//the post body isn't used, but read it so the client sees a normal exchange
+            if (!socket->waitForReadyRead(5000)) return;
+            received += socket->readAll();
+        }
+        QList<QByteArray> requestLine = headerLines[0].trimmed().split(' ');
+        map<QString, QString> queries;
+        if (requestLine.size() > 1 && requestLine[1].contains('?'))
+        {
+            QList<QByteArray> items = requestLine[1].mid(requestLine[1].indexOf('?') + 1).split('&');
+            for (int i = 0; i < items.size(); ++i)
+            {
+                int equals = items[i].indexOf('=');
+                if (equals < 0)
+                {
+                    queries[QString(QByteArray::fromPercentEncoding(items[i]))] = "";
+                } else {
+                    queries[QString(QByteArray::fromPercentEncoding(items[i].left(equals)))] = QString(QByteArray::fromPercentEncoding(items[i].mid(equals + 1)));
+                }
+            }
+        }
+        QByteArray body, status = "200 OK";
+        AString etag;
+        {
+            CaretMutexLocker locked(&m_mutex);
+            etag = m_etag;
+            if (queries.find("metadata") != queries.end())
+            {
+                body = m_metadata;
+            } else if (queries.find("row-index") != queries.end()) {
+                ++m_rowRequests;
+                int64_t firstRow = queries["row-index"].toLongLong(), numRows = 1;
+                if (m_supportRowCount && queries.find("row-count") != queries.end()) numRows = queries["row-count"].toLongLong();
+                if (firstRow < 0 || numRows < 1 || firstRow + numRows > NUM_ROWS)
+                {
+                    status = "404 Not Found";
+                } else {
+                    vector<float> values(numRows * ROW_LENGTH);
+                    for (int64_t row = 0; row < numRows; ++row)
+                    {
+                        for (int64_t col = 0; col < ROW_LENGTH; ++col)
+                        {
+                            values[row * ROW_LENGTH + col] = expectedValue(firstRow + row, col);
+                        }
+                    }
+                    int32_t numItems = (int32_t)values.size();
+                    if (ByteOrderEnum::isSystemBigEndian())
+                    {
+                        ByteSwapping::swap(numItems);
+                        ByteSwapping::swapArray(values.data(), values.size());
+                    }
+                    body.append((const char*)&numItems, sizeof(int32_t));
+                    body.append((const char*)values.data(), values.size() * sizeof(float));
+                }
+            } else {
+                status = "404 Not Found";
+            }
+        }
+        QByteArray reply = "HTTP/1.1 " + status + "\r\nContent-Type: application/octet-stream\r\nContent-Length: " + QByteArray::number(body.size()) +
+                           "\r\nETag: " + etag.toLatin1() + "\r\nConnection: close\r\n\r\n" + body;
+        socket->write(reply);
+        while (socket->bytesToWrite() > 0)
+        {
+            if (!socket->waitForBytesWritten(5000)) return;
+        }
+        socket->disconnectFromHost();
+        if (socket->state() != QAbstractSocket::UnconnectedState) socket->waitForDisconnected(5000);
+    }
+
+    void removeCacheDir(const QString& cacheDir)
+    {
+        CiftiRemoteBlockCache::setDirectory("");
+        QDir myDir(cacheDir);
+        QStringList blockList = myDir.entryList(QDir::Files);
+        for (int i = 0; i < blockList.size(); ++i)
+        {
+            myDir.remove(blockList[i]);
+        }
+        QDir().rmdir(cacheDir);
+    }
+
+    bool readAllRows(RemoteCiftiTest* theTest, const AString& url, const AString& condition)
+    {
+        CiftiFile myFile;
+        myFile.openURL(url);
+        if (myFile.getNumberOfRows() != NUM_ROWS || myFile.getNumberOfColumns() != ROW_LENGTH)
+        {
+            theTest->setFailed(condition + ", wrong dimensions");
+            return false;
+        }
+        vector<float> scratch(ROW_LENGTH);
+        for (int64_t row = 0; row < NUM_ROWS; ++row)
+        {
+            myFile.getRow(scratch.data(), row);
+            for (int64_t col = 0; col < ROW_LENGTH; ++col)
+            {
+                if (scratch[col] != expectedValue(row, col))
+                {
+                    theTest->setFailed(condition + ", wrong value in row " + AString::number(row) + ", column " + AString::number(col));
+                    return false;
+                }
+            }
+        }
+        myFile.getRow(scratch.data(), 0);//should still be in memory
+        return true;
+    }
+}
+
+void RemoteCiftiTest::execute()
+{
+    CiftiXML myXML;
+    myXML.setNumberOfDimensions(2);
+    myXML.setMap(CiftiXML::ALONG_ROW, CiftiSeriesMap(ROW_LENGTH));
+    myXML.setMap(CiftiXML::ALONG_COLUMN, CiftiScalarsMap(NUM_ROWS));
+    RowServer myServer(myXML);
+    int port = myServer.startServer();
+    if (port < 0)
+    {
+        setFailed("unable to listen on a local port");
+        return;
+    }
+    AString url = "http://127.0.0.1:" + AString::number(port) + "/cifti?searchID=test";
+    const int64_t rowsPerBlock = (((int64_t)1) << 20) / (ROW_LENGTH * sizeof(float)), numBlocks = (NUM_ROWS + rowsPerBlock - 1) / rowsPerBlock;
+    QString cacheDir = QDir::tempPath() + "/wb_remote_cifti_test_" + QString::number(QCoreApplication::applicationPid());
+    try
+    {
+        if (readAllRows(this, url, "ranged requests"))
+        {
+            int64_t numRequests = myServer.takeRowRequests();
+            if (numRequests != numBlocks) setFailed("expected " + AString::number(numBlocks) + " ranged row requests, server got " + AString::number(numRequests));
+        }
+        myServer.setSupportRowCount(false);
+        if (readAllRows(this, url, "server without row-count"))
+        {
+            int64_t numRequests = myServer.takeRowRequests();
+            if (numRequests != NUM_ROWS) setFailed("expected " + AString::number(NUM_ROWS) + " row requests after falling back, server got " + AString::number(numRequests));
+        }
+        myServer.setSupportRowCount(true);
+        QDir().mkpath(cacheDir);
+        CiftiRemoteBlockCache::setDirectory(cacheDir);
+        readAllRows(this, url, "filling disk cache");
+        myServer.takeRowRequests();
+        if (readAllRows(this, url, "from disk cache"))
+        {
+            int64_t numRequests = myServer.takeRowRequests();
+            if (numRequests != 0) setFailed("disk cache should have answered every row, server got " + AString::number(numRequests) + " requests");
+        }
+        myServer.setETag("\"version2\"");
+        if (readAllRows(this, url, "changed etag"))
+        {
+            int64_t numRequests = myServer.takeRowRequests();
+            if (numRequests != numBlocks) setFailed("a changed ETag should not use cached blocks, server got " + AString::number(numRequests) + " requests");
+        }
+        const int64_t blockBytes = rowsPerBlock * ROW_LENGTH * sizeof(float);
+        CiftiRemoteBlockCache::setMaxBytes(3 * blockBytes + 1024);//three blocks and their headers
+        myServer.setETag("\"version3\"");
+        readAllRows(this, url, "bounded cache");
+        QFileInfoList blockList = QDir(cacheDir).entryInfoList(QStringList("*.wbblock"), QDir::Files);
+        int64_t totalBytes = 0;
+        for (int i = 0; i < blockList.size(); ++i)
+        {
+            totalBytes += blockList[i].size();
+        }
+        if (totalBytes > CiftiRemoteBlockCache::getMaxBytes()) setFailed("disk cache is " + AString::number(totalBytes) + " bytes, over its limit");
+        cout << numBlocks << " blocks of " << rowsPerBlock << " rows, disk cache holds " << blockList.size() << " blocks after bounding" << endl;
+    } catch (...) {
+        removeCacheDir(cacheDir);
+        myServer.stopServer();
+        throw;
+    }
+    removeCacheDir(cacheDir);
+    myServer.stopServer();
+}
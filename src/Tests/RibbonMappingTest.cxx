@@ -0,0 +1,222 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "RibbonMappingTest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "CaretException.h"
+#include "RibbonMappingHelper.h"
+#include "SurfaceFile.h"
+#include "VolumeFile.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+RibbonMappingTest::RibbonMappingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    //the per-vertex loop over the weight lists that ribbon mapping used before the weights were compacted, one frame at a time, output is vertex-major like mapFrames
+    vector<float> mapByVertex(const vector<vector<VoxelWeight> >& weights, const VolumeFile& volume, const int& numFrames)
+    {
+        const int64_t numNodes = (int64_t)weights.size();
+        vector<float> ret(numNodes * numFrames);
+        for (int f = 0; f < numFrames; ++f)
+        {
+            for (int64_t node = 0; node < numNodes; ++node)
+            {
+                float value = 0.0f, totalWeight = 0.0f;
+                for (int voxel = 0; voxel < (int)weights[node].size(); ++voxel)
+                {
+                    float thisWeight = weights[node][voxel].weight;
+                    totalWeight += thisWeight;
+                    value += thisWeight * volume.getValue(weights[node][voxel].ijk, f);
+                }
+                ret[node * numFrames + f] = (totalWeight != 0.0f ? value / totalWeight : 0.0f);
+            }
+        }
+        return ret;
+    }
+    
+    vector<float> mapCompact(const RibbonMappingWeights& weights, const VolumeFile& volume, const int& numFrames)
+    {
+        vector<const float*> frames(numFrames);
+        for (int f = 0; f < numFrames; ++f)
+        {
+            frames[f] = volume.getFrame(f);
+        }
+        vector<float> ret(weights.getNumberOfNodes() * numFrames);
+        weights.mapFrames(frames.data(), numFrames, ret.data());
+        return ret;
+    }
+    
+    bool sameWeights(const vector<vector<VoxelWeight> >& first, const vector<vector<VoxelWeight> >& second)
+    {
+        if (first.size() != second.size()) return false;
+        for (int64_t node = 0; node < (int64_t)first.size(); ++node)
+        {
+            if (first[node].size() != second[node].size()) return false;
+            for (int voxel = 0; voxel < (int)first[node].size(); ++voxel)
+            {
+                const VoxelWeight& firstWeight = first[node][voxel], &secondWeight = second[node][voxel];
+                if (firstWeight.weight != secondWeight.weight || firstWeight.ijk[0] != secondWeight.ijk[0] ||
+                    firstWeight.ijk[1] != secondWeight.ijk[1] || firstWeight.ijk[2] != secondWeight.ijk[2]) return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool RibbonMappingTest::readsWithoutError(const AString& filename)
+{
+    RibbonMappingWeights fromFile;
+    AString errorMessage;
+    return fromFile.readFile(filename, errorMessage);
+}
+
+void RibbonMappingTest::execute()
+{
+    const int NUM_FRAMES = 5;
+    vector<int64_t> dims(4, 30);
+    dims[3] = NUM_FRAMES;
+    vector<vector<float> > sform(3, vector<float>(4, 0.0f));
+    for (int i = 0; i < 3; ++i)
+    {
+        sform[i][i] = 2.0f;
+        sform[i][3] = -29.0f;//centered on the origin
+    }
+    VolumeFile input(dims, sform);
+    const int64_t frameSize = dims[0] * dims[1] * dims[2];
+    vector<float> frame(frameSize), roiFrame(frameSize);
+    for (int f = 0; f < NUM_FRAMES; ++f)
+    {
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            frame[i] = ((float)rand()) / RAND_MAX;
+        }
+        input.setFrame(frame.data(), f);
+    }
+    for (int64_t i = 0; i < frameSize; ++i)
+    {
+        roiFrame[i] = (i % dims[0] < dims[0] / 2 ? 1.0f : 0.0f);//half the volume, so some vertices get no weights
+    }
+    SurfaceFile sphere, innerSurf, outerSurf;
+    AlgorithmSurfaceCreateSphere(NULL, 2000, &sphere);//radius 100
+    scaleSurface(sphere, 0.15f, innerSurf);
+    scaleSurface(sphere, 0.25f, outerSurf);
+    const int64_t numNodes = sphere.getNumberOfNodes();
+    RibbonMappingHelper::setCacheDirectory("");
+    vector<vector<VoxelWeight> > weights, roiWeights;
+    RibbonMappingHelper::computeWeightsRibbon(weights, input.getVolumeSpace(), &innerSurf, &outerSurf);
+    RibbonMappingHelper::computeWeightsRibbon(roiWeights, input.getVolumeSpace(), &innerSurf, &outerSurf, roiFrame.data());
+    RibbonMappingWeights compact(weights, dims.data()), roiCompact(roiWeights, dims.data());
+    if (compact.getNumberOfNodes() != numNodes) setFailed("compact weights have the wrong number of vertices");
+    //the compact form must map exactly as the weight lists did, including vertices without weights
+    vector<float> expected = mapByVertex(weights, input, NUM_FRAMES);
+    if (mapCompact(compact, input, NUM_FRAMES) != expected) setFailed("mapping with compact weights differs from mapping with the weight lists");
+    vector<float> roiExpected = mapByVertex(roiWeights, input, NUM_FRAMES);
+    if (mapCompact(roiCompact, input, NUM_FRAMES) != roiExpected) setFailed("mapping with compact roi weights differs from mapping with the weight lists");
+    int numEmpty = 0;
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        if (roiWeights[node].empty()) ++numEmpty;
+    }
+    if (numEmpty == 0 || numEmpty == numNodes) setFailed("roi should remove the weights of some but not all vertices, vertices without weights are untested");
+    vector<vector<VoxelWeight> > expanded;
+    compact.getVoxelWeights(expanded);
+    if (!sameWeights(weights, expanded)) setFailed("expanding compact weights does not give the original weight lists");
+    QString tempDir = QDir::tempPath() + "/wb_ribbon_test_" + QString::number(QCoreApplication::applicationPid());
+    QDir().mkpath(tempDir);
+    try
+    {
+        AString weightFile = tempDir + "/weights.wbribw";
+        const AString key = "0123456789abcdef0123456789abcdef01234567";
+        for (int useRoi = 0; useRoi < 2; ++useRoi)
+        {
+            const RibbonMappingWeights& toWrite = (useRoi ? roiCompact : compact);
+            toWrite.writeFile(weightFile, key);
+            RibbonMappingWeights fromFile;
+            AString errorMessage;
+            if (!fromFile.readFile(weightFile, errorMessage, key))
+            {
+                setFailed("failed to read saved weights: " + errorMessage);
+                continue;
+            }
+            const int64_t* readDims = fromFile.getDims();
+            if (fromFile.getNumberOfNodes() != numNodes || readDims[0] != dims[0] || readDims[1] != dims[1] || readDims[2] != dims[2])
+            {
+                setFailed("saved weights have the wrong dimensions");
+                continue;
+            }
+            vector<vector<VoxelWeight> > readWeights;
+            fromFile.getVoxelWeights(readWeights);
+            if (!sameWeights((useRoi ? roiWeights : weights), readWeights)) setFailed("saved weights differ after reading");
+            if (mapCompact(fromFile, input, NUM_FRAMES) != (useRoi ? roiExpected : expected)) setFailed("mapping with saved weights differs");
+            if (fromFile.readFile(weightFile, errorMessage, "fedcba9876543210fedcba9876543210fedcba98")) setFailed("saved weights were accepted with the wrong key");
+        }
+        compact.writeFile(weightFile);
+        QByteArray goodWeights = readBytes(weightFile);
+        checkCorruptedFiles(weightFile, goodWeights, 96);
+        QByteArray badBytes = goodWeights;
+        int64_t firstOffset = 96 + (numNodes + 1) * sizeof(int64_t), badOffset = frameSize;//header, then row starts, then voxel offsets
+        memcpy(badBytes.data() + firstOffset, &badOffset, sizeof(int64_t));
+        checkBadFile(weightFile, badBytes, "out of range voxel");
+        QFile::remove(weightFile);
+        
+        RibbonMappingHelper::setCacheDirectory(tempDir);
+        vector<vector<VoxelWeight> > cacheWeights;
+        RibbonMappingHelper::computeWeightsRibbon(cacheWeights, input.getVolumeSpace(), &innerSurf, &outerSurf);
+        if (!sameWeights(weights, cacheWeights)) setFailed("weights differ while filling the cache");
+        QStringList fileList = QDir(tempDir).entryList(QDir::Files);
+        if (fileList.size() != 1) throw CaretException("ribbon weights were not saved to the cache directory");
+        QString cacheFile = tempDir + "/" + fileList[0];
+        QByteArray goodCache = readBytes(cacheFile);
+        RibbonMappingHelper::computeWeightsRibbon(cacheWeights, input.getVolumeSpace(), &innerSurf, &outerSurf);
+        if (!sameWeights(weights, cacheWeights)) setFailed("weights from the cache differ");
+        if (QDir(tempDir).entryList(QDir::Files).size() != 1) setFailed("the same inputs should reuse the cached weights");
+        RibbonMappingHelper::computeWeightsRibbon(cacheWeights, input.getVolumeSpace(), &innerSurf, &outerSurf, roiFrame.data());
+        if (!sameWeights(roiWeights, cacheWeights)) setFailed("roi weights differ while filling the cache");
+        if (QDir(tempDir).entryList(QDir::Files).size() != 2) setFailed("adding an roi should not reuse the cached weights");
+        writeBytes(cacheFile, goodCache.left(goodCache.size() / 2));
+        RibbonMappingHelper::computeWeightsRibbon(cacheWeights, input.getVolumeSpace(), &innerSurf, &outerSurf);
+        if (!sameWeights(weights, cacheWeights)) setFailed("weights after a truncated cache file differ");
+        if (readBytes(cacheFile) != goodCache) setFailed("a truncated cache file was not replaced");
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    RibbonMappingHelper::setCacheDirectory("");
+    QDir myDir(tempDir);
+    QStringList fileList = myDir.entryList(QDir::Files);
+    for (int i = 0; i < fileList.size(); ++i)
+    {
+        myDir.remove(fileList[i]);
+    }
+    QDir().rmdir(tempDir);
+}
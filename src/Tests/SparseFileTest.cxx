@@ -0,0 +1,237 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "SparseFileTest.h"
+
+#include "CaretException.h"
+#include "CaretSparseFile.h"
+#include "CiftiScalarsMap.h"
+#include "CiftiXML.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+SparseFileTest::SparseFileTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    CiftiXML makeXML(const int64_t& numRows, const int64_t& rowLength)
+    {
+        CiftiXML ret;
+        ret.setNumberOfDimensions(2);
+        CiftiScalarsMap rowMap, columnMap;
+        rowMap.setLength(rowLength);
+        columnMap.setLength(numRows);
+        ret.setMap(CiftiXML::ALONG_ROW, rowMap);
+        ret.setMap(CiftiXML::ALONG_COLUMN, columnMap);
+        return ret;
+    }
+}
+
+bool SparseFileTest::readsWithoutError(const AString& filename)
+{
+    try
+    {
+        CaretSparseFile myFile(filename);
+        vector<int64_t> indices, values;
+        for (int64_t i = 0; i < myFile.getDimensions()[1]; ++i)
+        {
+            myFile.getRowSparse(i, indices, values);
+        }
+    } catch (CaretException&) {
+        return false;//it should throw, not crash or return garbage
+    }
+    return true;
+}
+
+void SparseFileTest::execute()
+{
+    const int64_t NUM_ROWS = 40, ROW_LENGTH = 500, DENSE_ROW = 5;
+    vector<vector<int64_t> > rowIndices(NUM_ROWS), rowValues(NUM_ROWS);
+    for (int64_t row = 0; row < NUM_ROWS; ++row)
+    {
+        if (row % 7 == 3) continue;//some empty rows
+        for (int64_t i = 0; i < ROW_LENGTH; ++i)
+        {
+            if (row == DENSE_ROW)
+            {
+                rowIndices[row].push_back(i);
+                rowValues[row].push_back(7);//compresses well
+            } else if (rand() % 10 == 0 || (row == 0 && (i == 0 || i == ROW_LENGTH - 1))) {//include both ends of the row
+                rowIndices[row].push_back(i);
+                switch (rand() % 3)
+                {
+                    case 0:
+                        rowValues[row].push_back(rand() % 100 + 1);//small counts
+                        break;
+                    case 1:
+                        rowValues[row].push_back(-(int64_t)rand() * 1000000 - 1);//negative, all high bits set
+                        break;
+                    default:
+                        rowValues[row].push_back(((int64_t)rand() << 32) | (uint32_t)rand());//like encoded fiber fractions
+                        break;
+                }
+            }
+        }
+    }
+    CiftiXML myXML = makeXML(NUM_ROWS, ROW_LENGTH);
+    QString tempDir = QDir::tempPath() + "/wb_sparse_test_" + QString::number(QCoreApplication::applicationPid());
+    QDir().mkpath(tempDir);
+    try
+    {
+        AString filename = tempDir + "/test.trajTEMP.wbsparse";
+        const int versions[3] = { 1, 2, 2 };
+        const bool compress[3] = { false, false, true };
+        int64_t fileSizes[3] = { 0, 0, 0 };
+        QByteArray goodFiles[3];
+        vector<int64_t> denseRow(ROW_LENGTH), readRow(ROW_LENGTH), indices, values;
+        for (int config = 0; config < 3; ++config)
+        {
+            AString condition = "version " + AString::number(versions[config]) + (compress[config] ? ", compressed rows" : "");
+            for (int dense = 0; dense < 2; ++dense)
+            {
+                {
+                    CaretSparseFileWriter myWriter(filename, myXML, versions[config], compress[config]);
+                    for (int64_t row = 0; row < NUM_ROWS; ++row)
+                    {
+                        if (dense)
+                        {
+                            denseRow.assign(ROW_LENGTH, 0);
+                            for (size_t i = 0; i < rowIndices[row].size(); ++i)
+                            {
+                                denseRow[rowIndices[row][i]] = rowValues[row][i];
+                            }
+                            myWriter.writeRow(row, denseRow.data());
+                        } else if (!rowIndices[row].empty()) {//also tests skipping rows
+                            myWriter.writeRowSparse(row, rowIndices[row], rowValues[row]);
+                        }
+                    }
+                    myWriter.finish();
+                }
+                CaretSparseFile myFile(filename);
+                if (myFile.getVersion() != versions[config]) setFailed("wbsparse file has the wrong version, " + condition);
+                if (myFile.getDimensions()[0] != ROW_LENGTH || myFile.getDimensions()[1] != NUM_ROWS)
+                {
+                    setFailed("wbsparse file has the wrong dimensions, " + condition);
+                    continue;
+                }
+                for (int64_t row = 0; row < NUM_ROWS; ++row)
+                {
+                    myFile.getRowSparse(row, indices, values);
+                    if (indices != rowIndices[row] || values != rowValues[row])
+                    {
+                        setFailed("sparse row " + AString::number(row) + " differs after round trip, " + condition + (dense ? ", written dense" : ""));
+                        break;
+                    }
+                    myFile.getRow(row, readRow.data());
+                    denseRow.assign(ROW_LENGTH, 0);
+                    for (size_t i = 0; i < rowIndices[row].size(); ++i)
+                    {
+                        denseRow[rowIndices[row][i]] = rowValues[row][i];
+                    }
+                    if (readRow != denseRow)
+                    {
+                        setFailed("dense row " + AString::number(row) + " differs after round trip, " + condition + (dense ? ", written dense" : ""));
+                        break;
+                    }
+                }
+            }
+            fileSizes[config] = QFileInfo(filename).size();
+            goodFiles[config] = readBytes(filename);
+        }
+        if (fileSizes[1] >= fileSizes[0]) setFailed("version 2 wbsparse file is not smaller than version 1");
+        if (fileSizes[2] >= fileSizes[1]) setFailed("compressing rows did not make the wbsparse file smaller");
+        {
+            CaretSparseFileWriter defaultWriter(filename, myXML);
+            defaultWriter.finish();
+        }
+        if (CaretSparseFile(filename).getVersion() != 1) setFailed("wbsparse writer should default to version 1, for older wb_command");
+        
+        const int64_t headerSize = 8 + 2 * sizeof(int64_t);//magic, then dimensions
+        for (int config = 0; config < 3; ++config)
+        {
+            AString condition = " version " + AString::number(versions[config]) + (compress[config] ? " compressed" : "");
+            const QByteArray& good = goodFiles[config];
+            checkCorruptedFiles(filename, good, headerSize, condition);
+            QByteArray badBytes = good;
+            badBytes[7] = 5;
+            checkBadFile(filename, badBytes, "unknown version" + condition);
+            badBytes = good;
+            int64_t badLength = ROW_LENGTH + 1;//version 1: more nonzeros than the row length, version 2: the first row offset must be 0
+            memcpy(badBytes.data() + headerSize, &badLength, sizeof(int64_t));
+            checkBadFile(filename, badBytes, "impossible index" + condition);
+        }
+        {
+            QByteArray badBytes = goodFiles[2];
+            int64_t badOffset = 1LL << 40;//second row offset past the end of the data
+            memcpy(badBytes.data() + headerSize + sizeof(int64_t), &badOffset, sizeof(int64_t));
+            checkBadFile(filename, badBytes, "version 2 row offset out of range");
+            badBytes = goodFiles[2];
+            int64_t hugeOffset = -16;//read as unsigned, the end of the data would overflow a file offset
+            memcpy(badBytes.data() + headerSize + NUM_ROWS * sizeof(int64_t), &hugeOffset, sizeof(int64_t));
+            checkBadFile(filename, badBytes, "version 2 row offset overflowing the file offset");
+            badBytes = goodFiles[1];
+            int64_t valuesOffset = headerSize + (NUM_ROWS + 1) * sizeof(int64_t);
+            badBytes[(int)valuesOffset] = 9;//row 0 isn't empty, give it an unknown encoding type
+            checkBadFile(filename, badBytes, "unknown row encoding");
+        }
+        {//a row payload that is one overlong varint, the bits past 64 must not be silently dropped
+            CiftiXML smallXML = makeXML(2, 10);
+            vector<int64_t> smallIndices(2), smallValues(2);
+            smallIndices[0] = 0; smallIndices[1] = 1;
+            smallValues[0] = 0x10000; smallValues[1] = 200;//encoding, count, 2 deltas, then 1 + 3 and 1 + 2 bytes for the values: 11 bytes
+            {
+                CaretSparseFileWriter smallWriter(filename, smallXML, 2);
+                smallWriter.writeRowSparse(0, smallIndices, smallValues);
+                smallWriter.finish();
+            }
+            QByteArray badBytes = readBytes(filename);
+            int64_t valuesOffset = headerSize + 3 * sizeof(int64_t);
+            int64_t rowEnd;
+            memcpy(&rowEnd, badBytes.data() + headerSize + sizeof(int64_t), sizeof(int64_t));
+            if (rowEnd != 11) throw CaretException("unexpected size of wbsparse row: " + AString::number(rowEnd));
+            for (int i = 1; i < 10; ++i)
+            {
+                badBytes[(int)valuesOffset + i] = (char)0x80;//zero bits, continued
+            }
+            badBytes[(int)valuesOffset + 10] = 2;//at shift 63, this bit would overflow into nothing, leaving a count of 0
+            checkBadFile(filename, badBytes, "overflowing varint");
+        }
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    QDir myDir(tempDir);
+    QStringList fileList = myDir.entryList(QDir::Files);
+    for (int i = 0; i < fileList.size(); ++i)
+    {
+        myDir.remove(fileList[i]);
+    }
+    QDir().rmdir(tempDir);
+}
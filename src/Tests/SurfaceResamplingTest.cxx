@@ -0,0 +1,218 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "SurfaceResamplingTest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "CaretException.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+#include "SurfaceResamplingHelper.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+SurfaceResamplingTest::SurfaceResamplingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    vector<float> resampleWith(const SurfaceResamplingHelper& myHelp, const vector<float>& input)
+    {
+        vector<float> ret(myHelp.getNumberOfNewNodes());
+        myHelp.resampleNormal(input.data(), ret.data());
+        return ret;
+    }
+
+    int countFiles(const QString& directory)
+    {
+        return QDir(directory).entryList(QDir::Files).size();
+    }
+}
+
+bool SurfaceResamplingTest::readsWithoutError(const AString& filename)
+{
+    try
+    {
+        SurfaceResamplingHelper myHelp(filename);
+    } catch (CaretException&) {
+        return false;//it should throw CaretException, not crash
+    }
+    return true;
+}
+
+void SurfaceResamplingTest::execute()
+{
+    SurfaceFile curSphere, newSphere;
+    AlgorithmSurfaceCreateSphere(NULL, 3000, &curSphere);
+    AlgorithmSurfaceCreateSphere(NULL, 2000, &newSphere);
+    const int numCurNodes = curSphere.getNumberOfNodes();
+    vector<float> input(numCurNodes), roi(numCurNodes), curAreas, newAreas;
+    for (int i = 0; i < numCurNodes; ++i)
+    {
+        input[i] = ((float)rand()) / RAND_MAX - 0.5f;
+        roi[i] = (curSphere.getCoordinate(i)[2] > -50.0f ? 1.0f : 0.0f);
+    }
+    curSphere.computeNodeAreas(curAreas);
+    newSphere.computeNodeAreas(newAreas);
+    SurfaceResamplingHelper::setCacheDirectory("");
+    vector<float> expected;
+    {
+        SurfaceResamplingHelper direct(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, &curSphere, &newSphere, curAreas.data(), newAreas.data());
+        expected = resampleWith(direct, input);
+    }
+    {//blocked resampling must give exactly what resampling each column separately does, including the invalid value outside the roi
+        SurfaceResamplingHelper withRoi(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, &curSphere, &newSphere, curAreas.data(), newAreas.data(), roi.data());
+        const int NUM_COLUMNS = 70;//more than one block of columns, and a partial block
+        const float INVALID = -7.0f;
+        MetricFile metricIn, metricOut;
+        metricIn.setNumberOfNodesAndColumns(numCurNodes, NUM_COLUMNS);
+        vector<float> scratch(numCurNodes), byColumn(withRoi.getNumberOfNewNodes());
+        for (int i = 0; i < NUM_COLUMNS; ++i)
+        {
+            for (int j = 0; j < numCurNodes; ++j)
+            {
+                scratch[j] = ((float)rand()) / RAND_MAX - 0.5f;
+            }
+            metricIn.setValuesForColumn(i, scratch.data());
+        }
+        withRoi.resampleMetric(&metricIn, &metricOut, INVALID);
+        if (metricOut.getNumberOfNodes() != withRoi.getNumberOfNewNodes() || metricOut.getNumberOfColumns() != NUM_COLUMNS)
+        {
+            setFailed("blocked resampling output has the wrong dimensions");
+        } else {
+            int numInvalid = 0;
+            for (int i = 0; i < NUM_COLUMNS; ++i)
+            {
+                withRoi.resampleNormal(metricIn.getValuePointerForColumn(i), byColumn.data(), INVALID);
+                const float* blocked = metricOut.getValuePointerForColumn(i);
+                for (int j = 0; j < (int)byColumn.size(); ++j)
+                {
+                    if (blocked[j] != byColumn[j])
+                    {
+                        setFailed("blocked resampling differs from resampling each column, column " + AString::number(i) + ", vertex " + AString::number(j));
+                        break;
+                    }
+                    if (blocked[j] == INVALID) ++numInvalid;
+                }
+            }
+            if (numInvalid == 0) setFailed("roi did not exclude any vertices, invalid value is untested");
+        }
+    }
+    QString tempDir = QDir::tempPath() + "/wb_resampling_test_" + QString::number(QCoreApplication::applicationPid());
+    QDir().mkpath(tempDir);
+    try
+    {
+        AString weightFile = tempDir + "/weights.wbrsw";
+        {
+            SurfaceResamplingHelper direct(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, &curSphere, &newSphere, curAreas.data(), newAreas.data());
+            direct.writeToFile(weightFile);
+            SurfaceResamplingHelper fromFile(weightFile);
+            if (fromFile.getNumberOfCurrentNodes() != numCurNodes || fromFile.getNumberOfNewNodes() != newSphere.getNumberOfNodes())
+            {
+                setFailed("saved weights have the wrong number of vertices");
+            } else {
+                if (resampleWith(fromFile, input) != expected) setFailed("resampling with saved weights differs");
+            }
+        }
+        QByteArray goodWeights = readBytes(weightFile);
+        checkCorruptedFiles(weightFile, goodWeights, 80);
+        QByteArray badBytes = goodWeights;
+        int64_t firstElem = 80 + (newSphere.getNumberOfNodes() + 1) * sizeof(int64_t);//header, then offsets, then (node, weight) pairs
+        int32_t badNode = numCurNodes + 5;
+        memcpy(badBytes.data() + firstElem, &badNode, sizeof(int32_t));
+        checkBadFile(weightFile, badBytes, "out of range vertex");
+        QFile::remove(weightFile);
+
+        SurfaceResamplingHelper::setCacheDirectory(tempDir);
+        {
+            SurfaceResamplingHelper cacheFill(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, &curSphere, &newSphere, curAreas.data(), newAreas.data());
+            if (resampleWith(cacheFill, input) != expected) setFailed("resampling while filling the cache differs");
+        }
+        if (countFiles(tempDir) != 1) throw CaretException("resampling weights were not saved to the cache directory");
+        QString cacheFile = tempDir + "/" + QDir(tempDir).entryList(QDir::Files)[0];
+        QByteArray goodCache = readBytes(cacheFile);
+        {
+            SurfaceResamplingHelper fromCache(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, &curSphere, &newSphere, curAreas.data(), newAreas.data());
+            if (resampleWith(fromCache, input) != expected) setFailed("resampling with cached weights differs");
+        }
+        if (countFiles(tempDir) != 1) setFailed("the same inputs should reuse the cached weights");
+        //every input that affects the weights must change the key
+        {
+            SurfaceResamplingHelper withRoi(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, &curSphere, &newSphere, curAreas.data(), newAreas.data(), roi.data());
+        }
+        if (countFiles(tempDir) != 2) setFailed("adding an roi should not reuse the cached weights");
+        QString roiCacheFile;
+        QStringList fileList = QDir(tempDir).entryList(QDir::Files);
+        for (int i = 0; i < fileList.size(); ++i)
+        {
+            if (tempDir + "/" + fileList[i] != cacheFile) roiCacheFile = tempDir + "/" + fileList[i];
+        }
+        vector<float> changedAreas = curAreas;
+        changedAreas[0] *= 1.5f;
+        {
+            SurfaceResamplingHelper withChangedAreas(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, &curSphere, &newSphere, changedAreas.data(), newAreas.data());
+        }
+        if (countFiles(tempDir) != 3) setFailed("changing the areas should not reuse the cached weights");
+        {
+            SurfaceResamplingHelper barycentric(SurfaceResamplingMethodEnum::BARYCENTRIC, &curSphere, &newSphere);
+        }
+        if (countFiles(tempDir) != 4) setFailed("changing the method should not reuse the cached weights");
+        SurfaceFile movedSphere = curSphere;
+        const float* firstCoord = curSphere.getCoordinate(0);
+        movedSphere.setCoordinate(0, firstCoord[0] * 1.0002f, firstCoord[1] * 1.0002f, firstCoord[2] * 1.0002f);//stays within the sphere tolerance
+        {
+            SurfaceResamplingHelper withMovedSphere(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, &movedSphere, &newSphere, curAreas.data(), newAreas.data());
+        }
+        if (countFiles(tempDir) != 5) setFailed("changing a sphere coordinate should not reuse the cached weights");
+        //unusable cache files must be recomputed and replaced, not used or thrown from
+        const char* badNames[3] = { "truncated", "corrupt", "stale" };
+        QByteArray badContents[3] = { goodCache.left(goodCache.size() / 2), goodCache, readBytes(roiCacheFile) };//stale: valid weight file with another key
+        memcpy(badContents[1].data() + firstElem, &badNode, sizeof(int32_t));
+        for (int i = 0; i < 3; ++i)
+        {
+            writeBytes(cacheFile, badContents[i]);
+            {
+                SurfaceResamplingHelper afterBad(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, &curSphere, &newSphere, curAreas.data(), newAreas.data());
+                if (resampleWith(afterBad, input) != expected) setFailed(AString("resampling after a ") + badNames[i] + " cache file differs");
+            }
+            if (readBytes(cacheFile) != goodCache) setFailed(AString("a ") + badNames[i] + " cache file was not replaced");
+        }
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    SurfaceResamplingHelper::setCacheDirectory("");
+    QDir myDir(tempDir);
+    QStringList fileList = myDir.entryList(QDir::Files);
+    for (int i = 0; i < fileList.size(); ++i)
+    {
+        myDir.remove(fileList[i]);
+    }
+    QDir().rmdir(tempDir);
+}
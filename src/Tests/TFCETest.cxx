@@ -0,0 +1,546 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "TFCETest.h"
+
+#include "AlgorithmMetricTFCE.h"
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "CaretHeap.h"
+#include "ElapsedTimer.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+#include "TFCEHelper.h"
+#include "TopologyHelper.h"
+#include "Vector3D.h"
+#include "VolumeSpace.h"
+#include "VoxelIJK.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+TFCETest::TFCETest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{//the member list implementation that TFCEHelper replaced, as the reference for exact results and for timing
+    template <typename T>
+    struct OldCluster
+    {
+        double accumVal, totalVolume;
+        vector<T> members;
+        float lastVal;
+        bool first;
+        OldCluster()
+        {
+            first = true;
+            accumVal = 0.0;
+            totalVolume = 0.0;
+        }
+        void addMember(const T& voxel, const float& val, const float& voxel_volume, const float& param_e, const float& param_h)
+        {
+            update(val, param_e, param_h);
+            members.push_back(voxel);
+            totalVolume += voxel_volume;
+        }
+        void update(const float& bottomVal, const float& param_e, const float& param_h)
+        {
+            if (first)
+            {
+                lastVal = bottomVal;
+                first = false;
+            } else {
+                if (bottomVal != lastVal)
+                {
+                    double integrated_h = param_h + 1.0f;
+                    double newSlice = pow(totalVolume, (double)param_e) * (pow((double)lastVal, integrated_h) - pow((double)bottomVal, integrated_h)) / integrated_h;
+                    accumVal += newSlice;
+                    lastVal = bottomVal;
+                }
+            }
+        }
+    };
+
+    template <typename T>
+    int64_t oldAllocCluster(vector<OldCluster<T> >& clusterList, set<int64_t>& deadClusters)
+    {
+        if (deadClusters.empty())
+        {
+            clusterList.push_back(OldCluster<T>());
+            return (int64_t)(clusterList.size() - 1);
+        } else {
+            set<int64_t>::iterator iter = deadClusters.begin();
+            int64_t ret = *iter;
+            deadClusters.erase(iter);
+            clusterList[ret] = OldCluster<T>();
+            return ret;
+        }
+    }
+
+    void oldTFCE(const VolumeSpace& mySpace, const float* frameData, double* accumData, const float& param_e, const float& param_h, const bool& negate)
+    {
+        const int64_t* dims = mySpace.getDims();
+        Vector3D ivec, jvec, kvec, origin;
+        mySpace.getSpacingVectors(ivec, jvec, kvec, origin);
+        float voxelVolume = abs(ivec.dot(jvec.cross(kvec)));
+        vector<int64_t> membership(dims[0] * dims[1] * dims[2], -1);
+        vector<OldCluster<VoxelIJK> > clusterList;
+        set<int64_t> deadClusters;
+        CaretSimpleMaxHeap<VoxelIJK, float> voxelHeap;
+        for (int64_t i = 0; i < dims[0]; ++i)
+        {
+            for (int64_t j = 0; j < dims[1]; ++j)
+            {
+                for (int64_t k = 0; k < dims[2]; ++k)
+                {
+                    int64_t index = mySpace.getIndex(i, j, k);
+                    float value = (negate ? -frameData[index] : frameData[index]);
+                    if (value > 0.0f) voxelHeap.push(VoxelIJK(i, j, k), value);
+                }
+            }
+        }
+        const int64_t stencil[18] = { 0, 0, -1, 0, -1, 0, -1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+        while (!voxelHeap.isEmpty())
+        {
+            float value;
+            VoxelIJK voxel = voxelHeap.pop(&value);
+            int64_t voxelIndex = mySpace.getIndex(voxel.m_ijk);
+            set<int64_t> touchingClusters;
+            for (int i = 0; i < 18; i += 3)
+            {
+                int64_t neighIJK[3] = { voxel.m_ijk[0] + stencil[i], voxel.m_ijk[1] + stencil[i + 1], voxel.m_ijk[2] + stencil[i + 2] };
+                if (mySpace.indexValid(neighIJK))
+                {
+                    int64_t neighIndex = mySpace.getIndex(neighIJK);
+                    if (membership[neighIndex] != -1) touchingClusters.insert(membership[neighIndex]);
+                }
+            }
+            switch (touchingClusters.size())
+            {
+                case 0:
+                {
+                    int64_t newCluster = oldAllocCluster(clusterList, deadClusters);
+                    clusterList[newCluster].addMember(voxel, value, voxelVolume, param_e, param_h);
+                    membership[voxelIndex] = newCluster;
+                    break;
+                }
+                case 1:
+                {
+                    int64_t whichCluster = *(touchingClusters.begin());
+                    clusterList[whichCluster].addMember(voxel, value, voxelVolume, param_e, param_h);
+                    membership[voxelIndex] = whichCluster;
+                    accumData[voxelIndex] -= clusterList[whichCluster].accumVal;
+                    break;
+                }
+                default:
+                {
+                    int64_t mergedIndex = -1, biggestSize = 0;
+                    for (set<int64_t>::iterator iter = touchingClusters.begin(); iter != touchingClusters.end(); ++iter)
+                    {
+                        if ((int64_t)clusterList[*iter].members.size() > biggestSize)
+                        {
+                            mergedIndex = *iter;
+                            biggestSize = (int64_t)clusterList[*iter].members.size();
+                        }
+                    }
+                    OldCluster<VoxelIJK>& mergedCluster = clusterList[mergedIndex];
+                    mergedCluster.update(value, param_e, param_h);
+                    for (set<int64_t>::iterator iter = touchingClusters.begin(); iter != touchingClusters.end(); ++iter)
+                    {
+                        if (*iter != mergedIndex)
+                        {
+                            OldCluster<VoxelIJK>& thisCluster = clusterList[*iter];
+                            thisCluster.update(value, param_e, param_h);
+                            double correctionVal = thisCluster.accumVal - mergedCluster.accumVal;
+                            for (size_t j = 0; j < thisCluster.members.size(); ++j)
+                            {
+                                int64_t memberIndex = mySpace.getIndex(thisCluster.members[j].m_ijk);
+                                accumData[memberIndex] += correctionVal;
+                                membership[memberIndex] = mergedIndex;
+                            }
+                            mergedCluster.members.insert(mergedCluster.members.end(), thisCluster.members.begin(), thisCluster.members.end());
+                            mergedCluster.totalVolume += thisCluster.totalVolume;
+                            deadClusters.insert(*iter);
+                            vector<VoxelIJK>().swap(thisCluster.members);
+                        }
+                    }
+                    mergedCluster.addMember(voxel, value, voxelVolume, param_e, param_h);
+                    accumData[voxelIndex] -= mergedCluster.accumVal;
+                    membership[voxelIndex] = mergedIndex;
+                    break;
+                }
+            }
+        }
+        for (int64_t i = 0; i < (int64_t)clusterList.size(); ++i)
+        {
+            if (deadClusters.find(i) != deadClusters.end()) continue;
+            OldCluster<VoxelIJK>& thisCluster = clusterList[i];
+            thisCluster.update(0.0f, param_e, param_h);
+            for (size_t j = 0; j < thisCluster.members.size(); ++j)
+            {
+                accumData[mySpace.getIndex(thisCluster.members[j].m_ijk)] += thisCluster.accumVal;
+            }
+        }
+    }
+
+    //the old -metric-tfce implementation, same algorithm over surface neighbors, with vertex areas and an roi
+    void oldSurfaceTFCE(const TopologyHelper* myHelper, const float* colData, double* accumData, const float* roiData, const float& param_e, const float& param_h,
+                        const float* areaData, const bool& negate)
+    {
+        int numNodes = myHelper->getNumberOfNodes();
+        vector<int64_t> membership(numNodes, -1);
+        vector<OldCluster<int> > clusterList;
+        set<int64_t> deadClusters;
+        CaretSimpleMaxHeap<int, float> nodeHeap;
+        for (int i = 0; i < numNodes; ++i)
+        {
+            float value = (negate ? -colData[i] : colData[i]);
+            if ((roiData == NULL || roiData[i] > 0.0f) && value > 0.0f) nodeHeap.push(i, value);
+        }
+        while (!nodeHeap.isEmpty())
+        {
+            float value;
+            int node = nodeHeap.pop(&value);
+            const vector<int32_t>& neighbors = myHelper->getNodeNeighbors(node);
+            set<int64_t> touchingClusters;
+            for (int i = 0; i < (int)neighbors.size(); ++i)
+            {
+                if (membership[neighbors[i]] != -1) touchingClusters.insert(membership[neighbors[i]]);
+            }
+            switch (touchingClusters.size())
+            {
+                case 0:
+                {
+                    int64_t newCluster = oldAllocCluster(clusterList, deadClusters);
+                    clusterList[newCluster].addMember(node, value, areaData[node], param_e, param_h);
+                    membership[node] = newCluster;
+                    break;
+                }
+                case 1:
+                {
+                    int64_t whichCluster = *(touchingClusters.begin());
+                    clusterList[whichCluster].addMember(node, value, areaData[node], param_e, param_h);
+                    membership[node] = whichCluster;
+                    accumData[node] -= clusterList[whichCluster].accumVal;
+                    break;
+                }
+                default:
+                {
+                    int64_t mergedIndex = -1, biggestSize = 0;
+                    for (set<int64_t>::iterator iter = touchingClusters.begin(); iter != touchingClusters.end(); ++iter)
+                    {
+                        if ((int64_t)clusterList[*iter].members.size() > biggestSize)
+                        {
+                            mergedIndex = *iter;
+                            biggestSize = (int64_t)clusterList[*iter].members.size();
+                        }
+                    }
+                    OldCluster<int>& mergedCluster = clusterList[mergedIndex];
+                    mergedCluster.update(value, param_e, param_h);
+                    for (set<int64_t>::iterator iter = touchingClusters.begin(); iter != touchingClusters.end(); ++iter)
+                    {
+                        if (*iter != mergedIndex)
+                        {
+                            OldCluster<int>& thisCluster = clusterList[*iter];
+                            thisCluster.update(value, param_e, param_h);
+                            double correctionVal = thisCluster.accumVal - mergedCluster.accumVal;
+                            for (size_t j = 0; j < thisCluster.members.size(); ++j)
+                            {
+                                accumData[thisCluster.members[j]] += correctionVal;
+                                membership[thisCluster.members[j]] = mergedIndex;
+                            }
+                            mergedCluster.members.insert(mergedCluster.members.end(), thisCluster.members.begin(), thisCluster.members.end());
+                            mergedCluster.totalVolume += thisCluster.totalVolume;
+                            deadClusters.insert(*iter);
+                            vector<int>().swap(thisCluster.members);
+                        }
+                    }
+                    mergedCluster.addMember(node, value, areaData[node], param_e, param_h);
+                    accumData[node] -= mergedCluster.accumVal;
+                    membership[node] = mergedIndex;
+                    break;
+                }
+            }
+        }
+        for (int64_t i = 0; i < (int64_t)clusterList.size(); ++i)
+        {
+            if (deadClusters.find(i) != deadClusters.end()) continue;
+            OldCluster<int>& thisCluster = clusterList[i];
+            thisCluster.update(0.0f, param_e, param_h);
+            for (size_t j = 0; j < thisCluster.members.size(); ++j)
+            {
+                accumData[thisCluster.members[j]] += thisCluster.accumVal;
+            }
+        }
+    }
+
+    //old -metric-tfce output for one column: signed, zero outside the roi
+    vector<float> oldSurfaceOutput(const TopologyHelper* myHelper, const float* colData, const float* roiData, const float& param_e, const float& param_h, const float* areaData)
+    {
+        int numNodes = myHelper->getNumberOfNodes();
+        vector<double> accum(numNodes, 0.0);
+        oldSurfaceTFCE(myHelper, colData, accum.data(), roiData, param_e, param_h, areaData, false);
+        oldSurfaceTFCE(myHelper, colData, accum.data(), roiData, param_e, param_h, areaData, true);
+        vector<float> ret(numNodes, 0.0f);
+        for (int i = 0; i < numNodes; ++i)
+        {
+            if (roiData == NULL || roiData[i] > 0.0f) ret[i] = (colData[i] < 0.0f ? (float)-accum[i] : (float)accum[i]);
+        }
+        return ret;
+    }
+
+    //neighbor averaging of uniform noise on a surface, quantized for ties, like makeTestData
+    void makeSurfaceTestData(const TopologyHelper* myHelper, vector<float>& data)
+    {
+        const int NUM_BLURS = 3;
+        int numNodes = myHelper->getNumberOfNodes();
+        vector<float> scratch(numNodes);
+        data.resize(numNodes);
+        for (int i = 0; i < numNodes; ++i)
+        {
+            data[i] = ((float)rand()) / RAND_MAX - 0.5f;
+        }
+        for (int blur = 0; blur < NUM_BLURS; ++blur)
+        {
+            scratch.swap(data);
+            for (int i = 0; i < numNodes; ++i)
+            {
+                const vector<int32_t>& neighbors = myHelper->getNodeNeighbors(i);
+                float sum = scratch[i];
+                for (int j = 0; j < (int)neighbors.size(); ++j)
+                {
+                    sum += scratch[neighbors[j]];
+                }
+                data[i] = sum / (neighbors.size() + 1) * 4.0f;
+            }
+        }
+        for (int i = 0; i < numNodes; ++i)
+        {
+            data[i] = floor(data[i] * 20.0f) / 20.0f;
+        }
+    }
+
+    //repeated box blur of uniform noise, quantized to make lots of ties, so clusters form, merge, and tie-break
+    void makeTestData(const int64_t* dims, vector<float>& data)
+    {
+        const int NUM_BLURS = 3;
+        int64_t frameSize = dims[0] * dims[1] * dims[2];
+        vector<float> scratch(frameSize);
+        data.resize(frameSize);
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            data[i] = ((float)rand()) / RAND_MAX - 0.5f;
+        }
+        for (int blur = 0; blur < NUM_BLURS; ++blur)
+        {
+            scratch.swap(data);
+            for (int64_t k = 0; k < dims[2]; ++k)
+            {
+                for (int64_t j = 0; j < dims[1]; ++j)
+                {
+                    for (int64_t i = 0; i < dims[0]; ++i)
+                    {
+                        float sum = 0.0f;
+                        int count = 0;
+                        for (int64_t dk = max((int64_t)0, k - 1); dk <= min(dims[2] - 1, k + 1); ++dk)
+                        {
+                            for (int64_t dj = max((int64_t)0, j - 1); dj <= min(dims[1] - 1, j + 1); ++dj)
+                            {
+                                for (int64_t di = max((int64_t)0, i - 1); di <= min(dims[0] - 1, i + 1); ++di)
+                                {
+                                    sum += scratch[di + dims[0] * (dj + dims[1] * dk)];
+                                    ++count;
+                                }
+                            }
+                        }
+                        data[i + dims[0] * (j + dims[1] * k)] = sum / count * 4.0f;
+                    }
+                }
+            }
+        }
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            data[i] = floor(data[i] * 20.0f) / 20.0f;
+        }
+    }
+}
+
+void TFCETest::execute()
+{
+    const int64_t dims[3] = { 64, 72, 56 };
+    const float sform[12] = { 2.0f, 0.0f, 0.0f, -64.0f,
+                              0.0f, 2.0f, 0.0f, -72.0f,
+                              0.0f, 0.0f, 2.5f, -70.0f };
+    const int NUM_COLUMNS = 8;
+    const float param_e = 0.5f, param_h = 2.0f;
+    VolumeSpace mySpace(dims, sform);
+    int64_t frameSize = dims[0] * dims[1] * dims[2];
+    vector<vector<float> > inputs(NUM_COLUMNS), oldOutputs(NUM_COLUMNS, vector<float>(frameSize)), newOutputs(NUM_COLUMNS, vector<float>(frameSize));
+    for (int col = 0; col < NUM_COLUMNS; ++col)
+    {
+        makeTestData(dims, inputs[col]);
+    }
+    ElapsedTimer myTimer;
+    myTimer.start();
+    vector<double> accum(frameSize);
+    for (int col = 0; col < NUM_COLUMNS; ++col)
+    {
+        accum.assign(frameSize, 0.0);
+        oldTFCE(mySpace, inputs[col].data(), accum.data(), param_e, param_h, false);
+        oldTFCE(mySpace, inputs[col].data(), accum.data(), param_e, param_h, true);
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            oldOutputs[col][i] = (inputs[col][i] < 0.0f ? (float)-accum[i] : (float)accum[i]);
+        }
+    }
+    double oldTime = myTimer.getElapsedTimeSeconds();
+    myTimer.start();
+    TFCEHelper myTFCE(mySpace);
+    TFCEHelper::Workspace myWork;
+    vector<double> newAccum(frameSize);
+    for (int col = 0; col < NUM_COLUMNS; ++col)
+    {
+        myTFCE.computeAccum(inputs[col].data(), newAccum.data(), param_e, param_h, myWork);
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            newOutputs[col][i] = (inputs[col][i] < 0.0f ? (float)-newAccum[i] : (float)newAccum[i]);
+        }
+    }
+    double newTime = myTimer.getElapsedTimeSeconds();
+    for (int col = 0; col < NUM_COLUMNS; ++col)
+    {
+        if (memcmp(oldOutputs[col].data(), newOutputs[col].data(), frameSize * sizeof(float)) != 0)
+        {
+            setFailed("TFCEHelper output differs from member list implementation in column " + AString::number(col));
+        }
+    }
+    vector<const float*> inPointers(NUM_COLUMNS);
+    vector<float*> outPointers(NUM_COLUMNS);
+    for (int col = 0; col < NUM_COLUMNS; ++col)
+    {
+        newOutputs[col].assign(frameSize, 0.0f);
+        inPointers[col] = inputs[col].data();
+        outPointers[col] = newOutputs[col].data();
+    }
+    myTimer.start();
+    myTFCE.computeColumns(inPointers, outPointers, param_e, param_h);
+    double batchTime = myTimer.getElapsedTimeSeconds();
+    for (int col = 0; col < NUM_COLUMNS; ++col)
+    {
+        if (memcmp(oldOutputs[col].data(), newOutputs[col].data(), frameSize * sizeof(float)) != 0)
+        {
+            setFailed("TFCEHelper batched output differs from member list implementation in column " + AString::number(col));
+        }
+    }
+    cout << NUM_COLUMNS << " columns of " << frameSize << " voxels: member lists " << oldTime << "s, union-find " << newTime << "s, union-find batched " << batchTime << "s" << endl;
+    surfaceTest();
+}
+
+void TFCETest::surfaceTest()
+{
+    SurfaceFile mySphere;
+    AlgorithmSurfaceCreateSphere(NULL, 5000, &mySphere);
+    mySphere.setStructure(StructureEnum::CORTEX_LEFT);
+    CaretPointer<TopologyHelper> myTopoHelp = mySphere.getTopologyHelper();
+    const int numNodes = mySphere.getNumberOfNodes();
+    const int NUM_COLUMNS = 4;
+    const float param_e = 1.0f, param_h = 2.0f;//-metric-tfce defaults
+    MetricFile input, roi, corrAreas;
+    input.setNumberOfNodesAndColumns(numNodes, NUM_COLUMNS);
+    roi.setNumberOfNodesAndColumns(numNodes, 1);
+    corrAreas.setNumberOfNodesAndColumns(numNodes, 1);
+    vector<float> scratch, areas;
+    for (int col = 0; col < NUM_COLUMNS; ++col)
+    {
+        makeSurfaceTestData(myTopoHelp, scratch);
+        input.setValuesForColumn(col, scratch.data());
+    }
+    mySphere.computeNodeAreas(areas);
+    scratch.resize(numNodes);
+    for (int i = 0; i < numNodes; ++i)
+    {
+        scratch[i] = (mySphere.getCoordinate(i)[2] > -50.0f ? 1.0f : 0.0f);
+    }
+    roi.setValuesForColumn(0, scratch.data());
+    for (int i = 0; i < numNodes; ++i)
+    {
+        scratch[i] = areas[i] * (1.0f + 0.5f * ((float)rand()) / RAND_MAX);//non-uniform, different from the surface areas
+    }
+    corrAreas.setValuesForColumn(0, scratch.data());
+    const float* roiData = roi.getValuePointerForColumn(0), *corrAreaData = corrAreas.getValuePointerForColumn(0);
+    vector<double> accum(numNodes);
+    for (int useRoi = 0; useRoi < 2; ++useRoi)
+    {//the helper directly, with vertex areas
+        TFCEHelper myTFCE(myTopoHelp, areas.data(), (useRoi ? roiData : NULL));
+        TFCEHelper::Workspace myWork;
+        for (int col = 0; col < NUM_COLUMNS; ++col)
+        {
+            const float* colData = input.getValuePointerForColumn(col);
+            vector<float> expected = oldSurfaceOutput(myTopoHelp, colData, (useRoi ? roiData : NULL), param_e, param_h, areas.data());
+            myTFCE.computeAccum(colData, accum.data(), param_e, param_h, myWork);
+            for (int i = 0; i < numNodes; ++i)
+            {
+                if (useRoi && roiData[i] <= 0.0f) continue;//computeAccum leaves elements outside the roi at zero, sign and masking are the caller's job
+                float value = (colData[i] < 0.0f ? (float)-accum[i] : (float)accum[i]);
+                if (value != expected[i])
+                {
+                    setFailed("surface TFCEHelper differs from member list implementation" + AString(useRoi ? " with roi" : "") + " in column " + AString::number(col));
+                    break;
+                }
+            }
+        }
+    }
+    for (int useRoi = 0; useRoi < 2; ++useRoi)
+    {//the command, all columns and a single column, with surface areas and with corrected areas
+        for (int useCorr = 0; useCorr < 2; ++useCorr)
+        {
+            AString condition = AString(useRoi ? ", roi" : "") + (useCorr ? ", corrected areas" : "");
+            const float* areaData = (useCorr ? corrAreaData : areas.data());
+            MetricFile output, singleOutput;
+            AlgorithmMetricTFCE(NULL, &mySphere, &input, &output, 0.0f, (useRoi ? &roi : NULL), param_e, param_h, -1, (useCorr ? &corrAreas : NULL));
+            AlgorithmMetricTFCE(NULL, &mySphere, &input, &singleOutput, 0.0f, (useRoi ? &roi : NULL), param_e, param_h, NUM_COLUMNS - 1, (useCorr ? &corrAreas : NULL));
+            if (output.getNumberOfColumns() != NUM_COLUMNS || singleOutput.getNumberOfColumns() != 1)
+            {
+                setFailed("-metric-tfce output has the wrong number of columns" + condition);
+                continue;
+            }
+            for (int col = 0; col < NUM_COLUMNS; ++col)
+            {
+                vector<float> expected = oldSurfaceOutput(myTopoHelp, input.getValuePointerForColumn(col), (useRoi ? roiData : NULL), param_e, param_h, areaData);
+                if (memcmp(expected.data(), output.getValuePointerForColumn(col), numNodes * sizeof(float)) != 0)
+                {
+                    setFailed("-metric-tfce differs from member list implementation in column " + AString::number(col) + condition);
+                }
+                if (col == NUM_COLUMNS - 1 && memcmp(expected.data(), singleOutput.getValuePointerForColumn(0), numNodes * sizeof(float)) != 0)
+                {
+                    setFailed("-metric-tfce -column differs from member list implementation" + condition);
+                }
+            }
+        }
+    }
+}
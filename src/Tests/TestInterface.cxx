@@ -20,8 +20,62 @@
 
 #include "TestInterface.h"
 
+#include "CaretException.h"
+#include "SurfaceFile.h"
+
+#include <QFile>
+
+#include <vector>
+
 using namespace caret;
+using namespace std;
 
 TestInterface::~TestInterface()
 {
 }
+
+QByteArray TestInterface::readBytes(const AString& filename)
+{
+    QFile myFile(filename);
+    if (!myFile.open(QIODevice::ReadOnly)) throw CaretException("failed to open '" + filename + "' for reading");
+    return myFile.readAll();
+}
+
+void TestInterface::writeBytes(const AString& filename, const QByteArray& data)
+{
+    QFile myFile(filename);
+    if (!myFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) throw CaretException("failed to open '" + filename + "' for writing");
+    myFile.write(data);
+}
+
+void TestInterface::scaleSurface(const SurfaceFile& input, const float& scale, SurfaceFile& output)
+{
+    output = input;
+    vector<float> coords(input.getCoordinateData(), input.getCoordinateData() + input.getNumberOfNodes() * 3);
+    for (int i = 0; i < (int)coords.size(); ++i)
+    {
+        coords[i] *= scale;
+    }
+    output.setCoordinates(coords.data());
+}
+
+bool TestInterface::readsWithoutError(const AString&)
+{
+    setFailed("checkBadFile was used without overriding readsWithoutError");
+    return false;
+}
+
+void TestInterface::checkBadFile(const AString& filename, const QByteArray& contents, const AString& descrip)
+{
+    writeBytes(filename, contents);
+    if (readsWithoutError(filename)) setFailed("reading a " + descrip + " file did not report an error");
+}
+
+void TestInterface::checkCorruptedFiles(const AString& filename, const QByteArray& goodContents, const int& headerBytes, const AString& descripSuffix)
+{
+    checkBadFile(filename, goodContents.left(goodContents.size() / 2), "truncated" + descripSuffix);
+    checkBadFile(filename, goodContents.left(headerBytes - 4), "headerless" + descripSuffix);
+    QByteArray badBytes = goodContents;
+    badBytes[0] = 'x';
+    checkBadFile(filename, badBytes, "wrong magic" + descripSuffix);
+}
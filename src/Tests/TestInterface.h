@@ -22,8 +22,12 @@
 /*LICENSE_END*/
 #include <AString.h>
 
+#include <QByteArray>
+
 namespace caret {
 
+   class SurfaceFile;
+
    class TestInterface
    {
       AString m_identifier, m_failMessage;
@@ -37,6 +41,16 @@ namespace caret {
          m_failed = false;
          m_default_path = "../../wb_files";
       }
+      //helpers shared by tests of file formats and surface-based mapping
+      static QByteArray readBytes(const AString& filename);
+      static void writeBytes(const AString& filename, const QByteArray& data);
+      static void scaleSurface(const SurfaceFile& input, const float& scale, SurfaceFile& output);
+      //for checkBadFile, override to read the file the way its format is used, return true if it was read without an error
+      virtual bool readsWithoutError(const AString& filename);
+      //write contents to filename, and fail if reading it doesn't report an error
+      void checkBadFile(const AString& filename, const QByteArray& contents, const AString& descrip);
+      //the corruptions every binary format must reject: truncated, cut off inside the header, and wrong magic in the first byte
+      void checkCorruptedFiles(const AString& filename, const QByteArray& goodContents, const int& headerBytes, const AString& descripSuffix = "");
    public:
       void setFailed(const AString failMessage)
       {
@@ -0,0 +1,147 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeMappingStreamTest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "AlgorithmVolumeToSurfaceMapping.h"
+#include "AlgorithmVolumeToSurfaceMappingStream.h"
+#include "CaretException.h"
+#include "CiftiFile.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+#include "VolumeFile.h"
+
+#include <QCoreApplication>
+#include <QDir>
+
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+VolumeMappingStreamTest::VolumeMappingStreamTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    bool sameAsMetric(const MetricFile& expected, const MetricFile& test)
+    {
+        if (expected.getNumberOfNodes() != test.getNumberOfNodes() || expected.getNumberOfColumns() != test.getNumberOfColumns()) return false;
+        for (int i = 0; i < expected.getNumberOfColumns(); ++i)
+        {
+            const float* expectCol = expected.getValuePointerForColumn(i), *testCol = test.getValuePointerForColumn(i);
+            for (int j = 0; j < expected.getNumberOfNodes(); ++j)
+            {
+                if (expectCol[j] != testCol[j]) return false;
+            }
+        }
+        return true;
+    }
+
+    bool sameAsMetric(const MetricFile& expected, const CiftiFile& test)
+    {
+        if (expected.getNumberOfNodes() != test.getNumberOfRows() || expected.getNumberOfColumns() != test.getNumberOfColumns()) return false;
+        vector<float> row(test.getNumberOfColumns());
+        for (int j = 0; j < expected.getNumberOfNodes(); ++j)
+        {
+            test.getRow(row.data(), j);
+            for (int i = 0; i < expected.getNumberOfColumns(); ++i)
+            {
+                if (expected.getValue(j, i) != row[i]) return false;
+            }
+        }
+        return true;
+    }
+}
+
+void VolumeMappingStreamTest::execute()
+{
+    const int NUM_FRAMES = 8;
+    vector<int64_t> dims(4, 30);
+    dims[3] = NUM_FRAMES;
+    vector<vector<float> > sform(3, vector<float>(4, 0.0f));
+    for (int i = 0; i < 3; ++i)
+    {
+        sform[i][i] = 2.0f;
+        sform[i][3] = -29.0f;//centered on the origin
+    }
+    VolumeFile input(dims, sform);
+    const int64_t frameSize = dims[0] * dims[1] * dims[2];
+    vector<float> frame(frameSize);
+    for (int f = 0; f < NUM_FRAMES; ++f)
+    {
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            frame[i] = ((float)rand()) / RAND_MAX;
+        }
+        input.setFrame(frame.data(), f);
+    }
+    SurfaceFile sphere, innerSurf, outerSurf, midSurf;
+    AlgorithmSurfaceCreateSphere(NULL, 2000, &sphere);//radius 100
+    scaleSurface(sphere, 0.15f, innerSurf);
+    scaleSurface(sphere, 0.25f, outerSurf);
+    scaleSurface(sphere, 0.2f, midSurf);
+    midSurf.setStructure(StructureEnum::CORTEX_LEFT);
+    MetricFile expected;
+    AlgorithmVolumeToSurfaceMapping(NULL, &input, &midSurf, &expected, &innerSurf, &outerSurf);
+    QString tempDir = QDir::tempPath() + "/wb_mapping_stream_test_" + QString::number(QCoreApplication::applicationPid());
+    QDir().mkpath(tempDir);
+    try
+    {
+        AString inputName = tempDir + "/input.nii", outputName = tempDir + "/output.dtseries.nii";
+        input.writeFile(inputName);
+        const float smallLimitGB = 3.5f * frameSize * sizeof(float) / (1024.0f * 1024.0f * 1024.0f);//blocks of 3, 3 and 2 frames
+        {//both outputs, cifti on disk
+            MetricFile metricOut;
+            CiftiFile ciftiOut;
+            ciftiOut.setWritingFile(outputName);
+            AlgorithmVolumeToSurfaceMappingStream(NULL, inputName, &midSurf, &innerSurf, &outerSurf, &metricOut, &ciftiOut, NULL, 3, smallLimitGB);
+            ciftiOut.writeFile(outputName);//finishes the on-disk file, as the command parser does
+            if (!sameAsMetric(expected, metricOut)) setFailed("streamed metric output differs from ribbon mapping");
+            CiftiFile readBack(outputName);
+            if (!sameAsMetric(expected, readBack)) setFailed("streamed on-disk cifti output differs from ribbon mapping");
+        }
+        if (QDir(tempDir).entryList(QDir::Files).size() != 2) setFailed("scratch file was not removed");
+        {//cifti only, in memory, scratch file goes to the temp directory
+            CiftiFile ciftiOut;
+            AlgorithmVolumeToSurfaceMappingStream(NULL, inputName, &midSurf, &innerSurf, &outerSurf, NULL, &ciftiOut, NULL, 3, smallLimitGB);
+            if (!sameAsMetric(expected, ciftiOut)) setFailed("streamed in-memory cifti output differs from ribbon mapping");
+        }
+        {//everything in one block
+            MetricFile metricOut;
+            CiftiFile ciftiOut;
+            AlgorithmVolumeToSurfaceMappingStream(NULL, inputName, &midSurf, &innerSurf, &outerSurf, &metricOut, &ciftiOut);
+            if (!sameAsMetric(expected, metricOut)) setFailed("single block metric output differs from ribbon mapping");
+            if (!sameAsMetric(expected, ciftiOut)) setFailed("single block cifti output differs from ribbon mapping");
+        }
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    QDir myDir(tempDir);
+    QStringList fileList = myDir.entryList(QDir::Files);
+    for (int i = 0; i < fileList.size(); ++i)
+    {
+        myDir.remove(fileList[i]);
+    }
+    QDir().rmdir(tempDir);
+}
@@ -0,0 +1,121 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeSmoothingTest.h"
+
+#include "AlgorithmVolumeSmoothing.h"
+#include "CaretException.h"
+#include "VolumeFile.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+VolumeSmoothingTest::VolumeSmoothingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    //largest absolute difference over all voxels, or -1 if the dimensions differ
+    float maxDifference(const VolumeFile& first, const VolumeFile& second)
+    {
+        vector<int64_t> firstDims, secondDims;
+        first.getDimensions(firstDims);
+        second.getDimensions(secondDims);
+        if (firstDims != secondDims) return -1.0f;
+        int64_t numElems = firstDims[0] * firstDims[1] * firstDims[2] * firstDims[3] * firstDims[4];
+        const float* firstData = first.getFrame(), *secondData = second.getFrame();
+        float ret = 0.0f;
+        for (int64_t i = 0; i < numElems; ++i)
+        {
+            ret = max(ret, abs(firstData[i] - secondData[i]));
+        }
+        return ret;
+    }
+}
+
+void VolumeSmoothingTest::execute()
+{
+    const int NUM_FRAMES = 2;
+    const float KERNEL = 3.0f, TOLERANCE = 1e-4f;//data is within [-0.5, 0.5], separable and direct smoothing accumulate in float
+    vector<int64_t> dims(4);
+    dims[0] = 23; dims[1] = 20; dims[2] = 17; dims[3] = NUM_FRAMES;//odd and prime sizes, so the FFT padding isn't a power of 2
+    const int64_t frameSize = dims[0] * dims[1] * dims[2];
+    vector<vector<float> > orthSform(3, vector<float>(4, 0.0f)), shearSform;
+    for (int i = 0; i < 3; ++i)
+    {
+        orthSform[i][i] = 2.0f;
+        orthSform[i][3] = -20.0f;
+    }
+    shearSform = orthSform;
+    shearSform[0][1] = 0.7f;//non-orthogonal, uses the direct 3D kernel instead of separable passes
+    vector<float> frame(frameSize), roiFrame(frameSize);
+    for (int64_t k = 0; k < dims[2]; ++k)
+    {
+        for (int64_t j = 0; j < dims[1]; ++j)
+        {
+            for (int64_t i = 0; i < dims[0]; ++i)
+            {
+                roiFrame[i + dims[0] * (j + dims[1] * k)] = ((i - 8) * (i - 8) + (j - 10) * (j - 10) + (k - 7) * (k - 7) < 50 ? 1.0f : 0.0f);
+            }
+        }
+    }
+    for (int useShear = 0; useShear < 2; ++useShear)
+    {
+        const vector<vector<float> >& sform = (useShear ? shearSform : orthSform);
+        VolumeFile input(dims, sform), roi(vector<int64_t>(dims.begin(), dims.begin() + 3), sform);
+        for (int f = 0; f < NUM_FRAMES; ++f)
+        {
+            for (int64_t i = 0; i < frameSize; ++i)
+            {
+                frame[i] = (rand() % 5 == 0 ? 0.0f : ((float)rand()) / RAND_MAX - 0.5f);//some zeros for -fix-zeros
+            }
+            input.setFrame(frame.data(), f);
+        }
+        roi.setFrame(roiFrame.data());
+        for (int useRoi = 0; useRoi < 2; ++useRoi)
+        {
+            for (int fixZeros = 0; fixZeros < 2; ++fixZeros)
+            {
+                AString condition = AString(useShear ? "direct" : "separable") + (useRoi ? ", roi" : "") + (fixZeros ? ", fix zeros" : "");
+                VolumeFile withoutFFT, withFFT;
+                try
+                {
+                    AlgorithmVolumeSmoothing(NULL, &input, KERNEL, &withoutFFT, (useRoi ? &roi : NULL), fixZeros, -1, AlgorithmVolumeSmoothing::FFT_NEVER);
+                    AlgorithmVolumeSmoothing(NULL, &input, KERNEL, &withFFT, (useRoi ? &roi : NULL), fixZeros, -1, AlgorithmVolumeSmoothing::FFT_ALWAYS);
+                } catch (CaretException& e) {
+                    setFailed("caught exception (" + condition + "): " + e.whatString());
+                    continue;
+                }
+                float diff = maxDifference(withoutFFT, withFFT);
+                if (diff < 0.0f)
+                {
+                    setFailed("FFT smoothing output has different dimensions than " + condition);
+                } else if (diff > TOLERANCE) {
+                    setFailed("FFT smoothing differs from " + condition + " smoothing by " + AString::number(diff));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,560 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//program for timing the hot algorithms and file I/O on deterministic synthetic data, and comparing against a previous run
+//
+//usage: benchmark_driver [-quick] [-repeat <n>] [-json <out.json>] [-baseline <baseline.json> [-tolerance <fraction>]] [benchmark names...]
+//
+//the json output is a flat object of benchmark name to best time in seconds, so a previous output file can be used directly as a baseline
+
+#include <QCoreApplication>
+#include <QFile>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "AlgorithmCiftiCorrelation.h"
+#include "AlgorithmCiftiResample.h"
+#include "AlgorithmMetricResample.h"
+#include "AlgorithmMetricSmoothing.h"
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "AlgorithmVolumeSmoothing.h"
+#include "CaretCommandLine.h"
+#include "CaretException.h"
+#include "CaretHttpManager.h"
+#include "CaretJsonObject.h"
+#include "CaretOMP.h"
+#include "CaretPointer.h"
+#include "CaretPointLocator.h"
+#include "CaretPointLocatorOld.h"
+#include "CiftiFile.h"
+#include "ClusterHelper.h"
+#include "ElapsedTimer.h"
+#include "FastStatistics.h"
+#include "FileInformation.h"
+#include "GiftiFile.h"
+#include "MetricFile.h"
+#include "NodeAndVoxelColoring.h"
+#include "Palette.h"
+#include "PaletteColorMapping.h"
+#include "PaletteFile.h"
+#include "SessionManager.h"
+#include "SurfaceFile.h"
+#include "SystemUtilities.h"
+#include "VolumeFile.h"
+
+using namespace std;
+using namespace caret;
+
+namespace
+{
+    //xorshift, so that the data is the same on every platform (rand() isn't)
+    class SyntheticRandom
+    {
+        uint64_t m_state;
+    public:
+        SyntheticRandom(const uint64_t& seed) { m_state = seed * 2654435761ULL + 1; }
+        float next()
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 7;
+            m_state ^= m_state << 17;
+            return (m_state >> 40) / (float)(1 << 24) - 0.5f;
+        }
+    };
+
+    struct BenchmarkSizes
+    {
+        int32_t sphereVertices, smallSphereVertices, metricColumns, smoothingColumns, timepoints, correlationTimepoints, volumeFrames;
+        int64_t volumeDims[3];
+    };
+
+    struct BenchmarkData
+    {//generated once, shared by all benchmarks
+        BenchmarkSizes m_sizes;
+        AString m_tempDir;
+        SurfaceFile m_sphere, m_smallSphere;
+        MetricFile m_metric;
+        CaretPointer<CiftiFile> m_dtseries, m_smallDtseries, m_smallTemplate;
+        VolumeFile m_volume;
+        PaletteFile m_paletteFile;
+    };
+
+    typedef void (*BenchmarkFunction)(BenchmarkData& data);
+
+    struct BenchmarkInfo
+    {
+        const char* m_name;
+        BenchmarkFunction m_function;
+    };
+
+    void fillMetric(MetricFile& metric, const int32_t& numNodes, const int32_t& numColumns, const uint64_t& seed)
+    {
+        SyntheticRandom myRandom(seed);
+        metric.setNumberOfNodesAndColumns(numNodes, numColumns);
+        vector<float> column(numNodes);
+        for (int32_t col = 0; col < numColumns; ++col)
+        {
+            for (int32_t node = 0; node < numNodes; ++node)
+            {
+                column[node] = myRandom.next();
+            }
+            metric.setValuesForColumn(col, column.data());
+        }
+    }
+
+    CaretPointer<CiftiFile> makeSurfaceCifti(const int32_t& numNodes, const int32_t& numTimepoints, const bool& bothHemispheres, const uint64_t& seed)
+    {
+        CiftiBrainModelsMap myModels;
+        myModels.addSurfaceModel(numNodes, StructureEnum::CORTEX_LEFT);
+        if (bothHemispheres) myModels.addSurfaceModel(numNodes, StructureEnum::CORTEX_RIGHT);
+        CiftiSeriesMap mySeries;
+        mySeries.setLength(numTimepoints);
+        mySeries.setStart(0.0f);
+        mySeries.setStep(0.72f);
+        mySeries.setUnit(CiftiSeriesMap::SECOND);
+        CiftiXML myXML;
+        myXML.setNumberOfDimensions(2);
+        myXML.setMap(CiftiXML::ALONG_ROW, mySeries);
+        myXML.setMap(CiftiXML::ALONG_COLUMN, myModels);
+        CaretPointer<CiftiFile> ret(new CiftiFile());
+        ret->setCiftiXML(myXML);
+        SyntheticRandom myRandom(seed);
+        vector<float> row(numTimepoints);
+        int64_t numRows = myModels.getLength();
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            float offset = myRandom.next() * 100.0f;//give rows different means, like real data
+            for (int32_t t = 0; t < numTimepoints; ++t)
+            {
+                row[t] = offset + myRandom.next();
+            }
+            ret->setRow(row.data(), i);
+        }
+        return ret;
+    }
+
+    void generateData(BenchmarkData& data)
+    {
+        const BenchmarkSizes& sizes = data.m_sizes;
+        AlgorithmSurfaceCreateSphere(NULL, sizes.sphereVertices, &data.m_sphere);
+        AlgorithmSurfaceCreateSphere(NULL, sizes.smallSphereVertices, &data.m_smallSphere);
+        data.m_sphere.setStructure(StructureEnum::CORTEX_LEFT);
+        data.m_smallSphere.setStructure(StructureEnum::CORTEX_LEFT);
+        fillMetric(data.m_metric, data.m_sphere.getNumberOfNodes(), sizes.metricColumns, 1);
+        data.m_dtseries = makeSurfaceCifti(data.m_sphere.getNumberOfNodes(), sizes.timepoints, true, 2);
+        data.m_smallDtseries = makeSurfaceCifti(data.m_smallSphere.getNumberOfNodes(), sizes.correlationTimepoints, false, 3);
+        data.m_smallTemplate = makeSurfaceCifti(data.m_sphere.getNumberOfNodes(), 1, false, 4);
+        vector<int64_t> dims(sizes.volumeDims, sizes.volumeDims + 3);
+        dims.push_back(sizes.volumeFrames);
+        vector<vector<float> > sform(3, vector<float>(4, 0.0f));
+        for (int i = 0; i < 3; ++i)
+        {//2mm MNI-like space
+            sform[i][i] = 2.0f;
+            sform[i][3] = -2.0f * (sizes.volumeDims[i] / 2);
+        }
+        data.m_volume.reinitialize(dims, sform);
+        SyntheticRandom myRandom(5);
+        const int64_t frameSize = sizes.volumeDims[0] * sizes.volumeDims[1] * sizes.volumeDims[2];
+        vector<float> frame(frameSize);
+        for (int32_t f = 0; f < sizes.volumeFrames; ++f)
+        {
+            for (int64_t i = 0; i < frameSize; ++i)
+            {
+                frame[i] = 1000.0f + myRandom.next() * 100.0f;
+            }
+            data.m_volume.setFrame(frame.data(), f);
+        }
+    }
+
+    void benchGiftiWrite(BenchmarkData& data)
+    {
+        data.m_metric.writeFile(data.m_tempDir + "/wb_benchmark.func.gii");
+    }
+
+    void benchGiftiRead(BenchmarkData& data)
+    {
+        MetricFile inMetric;
+        inMetric.readFile(data.m_tempDir + "/wb_benchmark.func.gii");
+    }
+
+    void benchGiftiLevel1Write(BenchmarkData& data)
+    {//fastest deflate level, compare to gifti-metric-write for the default level
+        int32_t savedLevel = GiftiFile::getCompressionLevelForWriting();
+        GiftiFile::setCompressionLevelForWriting(1);
+        try
+        {
+            data.m_metric.writeFile(data.m_tempDir + "/wb_benchmark_level1.func.gii");
+        } catch (...) {
+            GiftiFile::setCompressionLevelForWriting(savedLevel);
+            throw;
+        }
+        GiftiFile::setCompressionLevelForWriting(savedLevel);
+    }
+
+    void benchGiftiExternalWrite(BenchmarkData& data)
+    {//every column in the external binary file
+        int64_t savedThreshold = GiftiFile::getExternalBinaryThresholdForWriting();
+        GiftiFile::setExternalBinaryThresholdForWriting(data.m_metric.getNumberOfNodes() * sizeof(float));
+        try
+        {
+            data.m_metric.writeFile(data.m_tempDir + "/wb_benchmark_external.func.gii");
+        } catch (...) {
+            GiftiFile::setExternalBinaryThresholdForWriting(savedThreshold);
+            throw;
+        }
+        GiftiFile::setExternalBinaryThresholdForWriting(savedThreshold);
+    }
+
+    void benchGiftiExternalRead(BenchmarkData& data)
+    {
+        MetricFile inMetric;
+        inMetric.readFile(data.m_tempDir + "/wb_benchmark_external.func.gii");
+    }
+
+    void benchCiftiWrite(BenchmarkData& data)
+    {
+        data.m_dtseries->writeFile(data.m_tempDir + "/wb_benchmark.dtseries.nii");
+    }
+
+    void benchCiftiRead(BenchmarkData& data)
+    {//read every row, like most algorithms do
+        CiftiFile inCifti;
+        inCifti.openFile(data.m_tempDir + "/wb_benchmark.dtseries.nii");
+        const vector<int64_t> dims = inCifti.getDimensions();
+        vector<float> row(dims[0]);
+        for (int64_t i = 0; i < dims[1]; ++i)
+        {
+            inCifti.getRow(row.data(), i);
+        }
+    }
+
+    void benchNiftiWrite(BenchmarkData& data)
+    {
+        data.m_volume.writeFile(data.m_tempDir + "/wb_benchmark.nii.gz");
+    }
+
+    void benchNiftiRead(BenchmarkData& data)
+    {
+        VolumeFile inVolume;
+        inVolume.readFile(data.m_tempDir + "/wb_benchmark.nii.gz");
+    }
+
+    void benchMetricSmoothing(BenchmarkData& data)
+    {
+        MetricFile inMetric, outMetric;
+        fillMetric(inMetric, data.m_sphere.getNumberOfNodes(), data.m_sizes.smoothingColumns, 6);
+        AlgorithmMetricSmoothing(NULL, &data.m_sphere, &inMetric, 4.0, &outMetric);
+    }
+
+    void benchMetricResample(BenchmarkData& data)
+    {
+        MetricFile outMetric;
+        AlgorithmMetricResample(NULL, &data.m_metric, &data.m_sphere, &data.m_smallSphere, SurfaceResamplingMethodEnum::BARYCENTRIC, &outMetric);
+    }
+
+    void benchCiftiResample(BenchmarkData& data)
+    {//the surface part, from the small sphere to the big one
+        CiftiFile outCifti;
+        AlgorithmCiftiResample(NULL, data.m_smallDtseries, CiftiXML::ALONG_COLUMN, data.m_smallTemplate, CiftiXML::ALONG_COLUMN,
+                               SurfaceResamplingMethodEnum::BARYCENTRIC, VolumeFile::CUBIC, &outCifti, false, 0.0f, 0.0f, (const VolumeFile*)NULL,
+                               &data.m_smallSphere, &data.m_sphere, NULL, NULL,
+                               NULL, NULL, NULL, NULL,
+                               NULL, NULL, NULL, NULL);
+    }
+
+    void benchPointLocator(BenchmarkData& data)
+    {//build on the big sphere, look up every vertex of the small one, then some radius searches
+        CaretPointLocator myLocator(data.m_sphere.getCoordinateData(), data.m_sphere.getNumberOfNodes());
+        int numTargets = data.m_smallSphere.getNumberOfNodes();
+        const float* targets = data.m_smallSphere.getCoordinateData();
+        vector<int64_t> closest(numTargets), inRange;
+        myLocator.closestPoints(targets, numTargets, closest.data());
+        for (int i = 0; i < numTargets; i += 16)
+        {
+            myLocator.pointsInRange(targets + i * 3, 5.0f, inRange);
+        }
+    }
+
+    void benchPointLocatorOctree(BenchmarkData& data)
+    {//same searches as point-locator, with the octree it replaced
+        CaretPointLocatorOld myLocator(data.m_sphere.getCoordinateData(), data.m_sphere.getNumberOfNodes());
+        int numTargets = data.m_smallSphere.getNumberOfNodes();
+        const float* targets = data.m_smallSphere.getCoordinateData();
+        vector<int64_t> closest(numTargets);
+        for (int i = 0; i < numTargets; ++i)
+        {
+            closest[i] = myLocator.closestPoint(targets + i * 3);
+        }
+        for (int i = 0; i < numTargets; i += 16)
+        {
+            myLocator.pointsInRange(targets + i * 3, 5.0f);
+        }
+    }
+
+    void benchVolumeClusters(BenchmarkData& data)
+    {//threshold the noise at its mean, which leaves many clusters of all sizes
+        ClusterHelper myHelper(data.m_volume.getVolumeSpace());
+        ClusterHelper::Workspace myWork;
+        ClusterHelper::ClusterList found;
+        const int64_t frameSize = myHelper.getNumberOfElements();
+        vector<char> mask(frameSize);
+        int32_t numFrames = min(data.m_sizes.volumeFrames, 10);
+        for (int32_t f = 0; f < numFrames; ++f)
+        {
+            const float* frame = data.m_volume.getFrame(f);
+            for (int64_t i = 0; i < frameSize; ++i)
+            {
+                mask[i] = (frame[i] > 1000.0f ? 1 : 0);
+            }
+            myHelper.findClusters(mask.data(), found, myWork);
+        }
+    }
+
+    void benchPaletteColoring(BenchmarkData& data)
+    {//every column of the metric, with the default palette settings
+        PaletteColorMapping myMapping;
+        const Palette* myPalette = data.m_paletteFile.getPaletteByName(myMapping.getSelectedPaletteName());
+        if (myPalette == NULL) myPalette = data.m_paletteFile.getPalette(0);
+        const int32_t numNodes = data.m_metric.getNumberOfNodes();
+        vector<float> rgba(numNodes * 4);
+        for (int32_t col = 0; col < data.m_metric.getNumberOfColumns(); ++col)
+        {
+            const float* scalars = data.m_metric.getValuePointerForColumn(col);
+            FastStatistics myStats(scalars, numNodes);
+            NodeAndVoxelColoring::colorScalarsWithPalette(&myStats, &myMapping, myPalette, scalars, scalars, numNodes, rgba.data());
+        }
+    }
+
+    void benchCiftiCorrelation(BenchmarkData& data)
+    {
+        CiftiFile outCifti;
+        AlgorithmCiftiCorrelation(NULL, data.m_smallDtseries, &outCifti);
+    }
+
+    void benchVolumeSmoothing(BenchmarkData& data)
+    {
+        VolumeFile outVolume;
+        AlgorithmVolumeSmoothing(NULL, &data.m_volume, 4.0f, &outVolume);
+    }
+
+    //order matters, reads use the files from the writes
+    const BenchmarkInfo BENCHMARKS[] = {
+        { "gifti-metric-write", benchGiftiWrite },
+        { "gifti-metric-read", benchGiftiRead },
+        { "gifti-level1-write", benchGiftiLevel1Write },
+        { "gifti-external-write", benchGiftiExternalWrite },
+        { "gifti-external-read", benchGiftiExternalRead },
+        { "cifti-dtseries-write", benchCiftiWrite },
+        { "cifti-dtseries-read", benchCiftiRead },
+        { "nifti-volume-write", benchNiftiWrite },
+        { "nifti-volume-read", benchNiftiRead },
+        { "metric-smoothing", benchMetricSmoothing },
+        { "metric-resample", benchMetricResample },
+        { "cifti-resample", benchCiftiResample },
+        { "point-locator", benchPointLocator },
+        { "point-locator-octree", benchPointLocatorOctree },
+        { "volume-clusters", benchVolumeClusters },
+        { "palette-coloring", benchPaletteColoring },
+        { "cifti-correlation", benchCiftiCorrelation },
+        { "volume-smoothing", benchVolumeSmoothing }
+    };
+    const int NUM_BENCHMARKS = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+    void usage()
+    {
+        cout << "usage: benchmark_driver [-quick] [-repeat <n>] [-json <out.json>]" << endl;
+        cout << "                        [-baseline <baseline.json> [-tolerance <fraction>]]" << endl;
+        cout << "                        [benchmark names...]" << endl;
+        cout << "available benchmarks:" << endl;
+        for (int i = 0; i < NUM_BENCHMARKS; ++i)
+        {
+            cout << "   " << BENCHMARKS[i].m_name << endl;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int ret = 0;
+    {
+        QCoreApplication myApp(argc, argv);
+        caret_global_commandLine_init(argc, argv);
+        SessionManager::createSessionManager(ApplicationTypeEnum::APPLICATION_TYPE_COMMAND_LINE);
+        bool quick = false;
+        int repeats = 3;
+        float tolerance = 0.2f;
+        AString jsonName, baselineName;
+        vector<AString> selected;
+        for (int i = 1; i < argc; ++i)
+        {
+            AString arg = argv[i];
+            if (arg == "-quick")
+            {
+                quick = true;
+            } else if (arg == "-repeat" && i + 1 < argc) {
+                repeats = max(1, AString(argv[++i]).toInt());
+            } else if (arg == "-json" && i + 1 < argc) {
+                jsonName = argv[++i];
+            } else if (arg == "-baseline" && i + 1 < argc) {
+                baselineName = argv[++i];
+            } else if (arg == "-tolerance" && i + 1 < argc) {
+                tolerance = AString(argv[++i]).toFloat();
+            } else if (arg.startsWith("-")) {
+                usage();
+                return 1;
+            } else {
+                selected.push_back(arg);
+            }
+        }
+        for (size_t i = 0; i < selected.size(); ++i)
+        {
+            bool found = false;
+            for (int j = 0; j < NUM_BENCHMARKS; ++j)
+            {
+                if (selected[i] == BENCHMARKS[j].m_name) found = true;
+            }
+            if (!found)
+            {
+                cout << "unknown benchmark: " << selected[i] << endl;
+                usage();
+                return 1;
+            }
+        }
+        BenchmarkData myData;
+        BenchmarkSizes& sizes = myData.m_sizes;
+        if (quick)
+        {//small enough to run as a test
+            sizes.sphereVertices = 10242; sizes.smallSphereVertices = 2562; sizes.metricColumns = 10; sizes.smoothingColumns = 2;
+            sizes.timepoints = 100; sizes.correlationTimepoints = 100; sizes.volumeFrames = 2;
+            sizes.volumeDims[0] = 46; sizes.volumeDims[1] = 55; sizes.volumeDims[2] = 46;
+        } else {//roughly HCP sizes: 32k surfaces, 1200 timepoints, 2mm MNI volumes
+            sizes.sphereVertices = 32492; sizes.smallSphereVertices = 10242; sizes.metricColumns = 100; sizes.smoothingColumns = 10;
+            sizes.timepoints = 1200; sizes.correlationTimepoints = 1200; sizes.volumeFrames = 100;
+            sizes.volumeDims[0] = 91; sizes.volumeDims[1] = 109; sizes.volumeDims[2] = 91;
+        }
+        myData.m_tempDir = SystemUtilities::getTempDirectory();
+        int numThreads = 1;
+#ifdef CARET_OMP
+        numThreads = omp_get_max_threads();
+#endif
+        try
+        {
+            ElapsedTimer setupTimer;
+            setupTimer.start();
+            generateData(myData);
+            cout << "generated synthetic data in " << setupTimer.getElapsedTimeSeconds() << "s, using " << numThreads << " threads" << endl;
+            vector<const char*> names;
+            vector<double> bestTimes;
+            for (int i = 0; i < NUM_BENCHMARKS; ++i)
+            {
+                if (!selected.empty() && find(selected.begin(), selected.end(), AString(BENCHMARKS[i].m_name)) == selected.end())
+                {
+                    bool neededForRead = false;//reads need the file the matching write makes
+                    AString name = BENCHMARKS[i].m_name;
+                    if (name.endsWith("-write"))
+                    {
+                        AString readName = name.left(name.size() - 5) + "read";
+                        neededForRead = find(selected.begin(), selected.end(), readName) != selected.end();
+                    }
+                    if (!neededForRead) continue;
+                    BENCHMARKS[i].m_function(myData);
+                    continue;
+                }
+                vector<double> times;
+                for (int r = 0; r < repeats; ++r)
+                {
+                    ElapsedTimer myTimer;
+                    myTimer.start();
+                    BENCHMARKS[i].m_function(myData);
+                    times.push_back(myTimer.getElapsedTimeSeconds());
+                }
+                sort(times.begin(), times.end());
+                cout << BENCHMARKS[i].m_name << ": best " << times[0] << "s, median " << times[times.size() / 2] << "s" << endl;
+                names.push_back(BENCHMARKS[i].m_name);
+                bestTimes.push_back(times[0]);
+            }
+            const char* tempFiles[] = { "/wb_benchmark.func.gii", "/wb_benchmark_level1.func.gii", "/wb_benchmark_external.func.gii",
+                                        "/wb_benchmark_external.func.gii.data", "/wb_benchmark.dtseries.nii", "/wb_benchmark.nii.gz" };
+            for (int i = 0; i < 6; ++i)
+            {
+                FileInformation tempInfo(myData.m_tempDir + tempFiles[i]);
+                if (tempInfo.exists()) tempInfo.remove();
+            }
+            if (jsonName != "")
+            {//flat, so CaretJsonObject can read it back as a baseline
+                AString jsonText = "{\n    \"benchmark-threads\": " + AString::number(numThreads) + ",\n    \"benchmark-quick\": " + (quick ? "true" : "false");
+                for (size_t i = 0; i < names.size(); ++i)
+                {
+                    jsonText += ",\n    \"" + AString(names[i]) + "\": " + AString::number(bestTimes[i], 'g', 6);
+                }
+                jsonText += "\n}\n";
+                QFile jsonFile(jsonName);
+                if (!jsonFile.open(QIODevice::WriteOnly | QIODevice::Truncate) || jsonFile.write(jsonText.toUtf8()) == -1)
+                {
+                    throw CaretException("failed to write json file '" + jsonName + "'");
+                }
+            }
+            if (baselineName != "")
+            {
+                QFile baselineFile(baselineName);
+                if (!baselineFile.open(QIODevice::ReadOnly))
+                {
+                    throw CaretException("failed to open baseline file '" + baselineName + "'");
+                }
+                CaretJsonObject baseline(AString::fromUtf8(baselineFile.readAll()));
+                if (baseline.value("benchmark-quick") != (quick ? "true" : "false") || baseline.value("benchmark-threads") != AString::number(numThreads))
+                {
+                    cout << "warning: baseline was run with different size or thread settings" << endl;
+                }
+                int numRegressed = 0;
+                for (size_t i = 0; i < names.size(); ++i)
+                {
+                    if (!baseline.hasKey(names[i])) continue;
+                    bool ok = false;
+                    double baseTime = baseline.value(names[i]).toDouble(&ok);
+                    if (!ok || baseTime <= 0.0) continue;
+                    double ratio = bestTimes[i] / baseTime;
+                    cout << names[i] << ": " << ratio << "x baseline time";
+                    if (ratio > 1.0 + tolerance)
+                    {
+                        cout << " - REGRESSION";
+                        ++numRegressed;
+                    }
+                    cout << endl;
+                }
+                if (numRegressed != 0)
+                {
+                    cout << numRegressed << " benchmarks are more than " << tolerance * 100.0f << "% slower than the baseline" << endl;
+                    ret = 1;
+                }
+            }
+        } catch (CaretException& e) {
+            cout << "benchmark failed, exception: " << e.whatString() << endl;
+            ret = 1;
+        }
+        SessionManager::deleteSessionManager();
+        CaretHttpManager::deleteHttpManager();
+        myApp.processEvents();
+    }
+    return ret;
+}
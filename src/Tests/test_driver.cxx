@@ -31,23 +31,41 @@
 #include "CaretHttpManager.h"
 #include "CaretCommandLine.h"
 #include "CaretException.h"
+#include "CommandOperationManager.h"
 
 //tests
+#include "BatchRunnerTest.h"
 #include "CiftiFileTest.h"
+#include "ClusterTest.h"
 #include "DotTest.h"
+#include "FFTTest.h"
+#include "GeodesicAllToAllTest.h"
 #include "GeodesicHelperTest.h"
+#include "GiftiReadTest.h"
 #include "HttpTest.h"
 #include "HeapTest.h"
 #include "LookupTest.h"
 #include "MathExpressionTest.h"
+#include "MetricSmoothingTest.h"
+#include "NiftiConvertTest.h"
 #include "NiftiTest.h"
+#include "PaletteColoringTest.h"
 #include "PointerTest.h"
+#include "PointLocatorTest.h"
+#include "ProfilerTest.h"
 #include "ProgressTest.h"
 #include "QuatTest.h"
+#include "RemoteCiftiTest.h"
+#include "RibbonMappingTest.h"
+#include "SparseFileTest.h"
 #include "StatisticsTest.h"
+#include "SurfaceResamplingTest.h"
+#include "TFCETest.h"
 #include "TimerTest.h"
 #include "TopologyHelperTest.h"
 #include "VolumeFileTest.h"
+#include "VolumeMappingStreamTest.h"
+#include "VolumeSmoothingTest.h"
 #include "XnatTest.h"
 
 using namespace std;
@@ -69,22 +87,39 @@ int main(int argc, char** argv)
         caret_global_commandLine_init(argc, argv);
         SessionManager::createSessionManager(ApplicationTypeEnum::APPLICATION_TYPE_COMMAND_LINE);
         vector<TestInterface*> mytests;
+        mytests.push_back(new BatchRunnerTest("batchrunner"));
         mytests.push_back(new CiftiFileTest("ciftifile"));
+        mytests.push_back(new ClusterTest("cluster"));
         mytests.push_back(new DotTest("dotsimd"));
+        mytests.push_back(new FFTTest("fft"));
+        mytests.push_back(new GeodesicAllToAllTest("geodesicalltoall"));
         mytests.push_back(new GeodesicHelperTest("geohelp"));
+        mytests.push_back(new GiftiReadTest("giftiread"));
         mytests.push_back(new HeapTest("heap"));
         mytests.push_back(new HttpTest("http"));
         mytests.push_back(new LookupTest("lookup"));
         mytests.push_back(new MathExpressionTest("mathexpression"));
+        mytests.push_back(new MetricSmoothingTest("metricsmoothing"));
+        mytests.push_back(new NiftiConvertTest("nifticonvert"));
         mytests.push_back(new NiftiFileTest("niftifile"));
         mytests.push_back(new NiftiHeaderTest("niftiheader"));
+        mytests.push_back(new PaletteColoringTest("palettecoloring"));
         mytests.push_back(new PointerTest("pointer"));
+        mytests.push_back(new PointLocatorTest("pointlocator"));
+        mytests.push_back(new ProfilerTest("profiler"));
         mytests.push_back(new ProgressTest("progress"));
         mytests.push_back(new QuatTest("quaternion"));
+        mytests.push_back(new RemoteCiftiTest("remotecifti"));
+        mytests.push_back(new RibbonMappingTest("ribbonmapping"));
+        mytests.push_back(new SparseFileTest("sparsefile"));
         mytests.push_back(new StatisticsTest("statistics"));
+        mytests.push_back(new SurfaceResamplingTest("surfaceresampling"));
+        mytests.push_back(new TFCETest("tfce"));
         mytests.push_back(new TimerTest("timer"));
         mytests.push_back(new TopologyHelperTest("topohelp"));
         mytests.push_back(new VolumeFileTest("volumefile"));
+        mytests.push_back(new VolumeMappingStreamTest("volumemappingstream"));
+        mytests.push_back(new VolumeSmoothingTest("volumesmoothing"));
         mytests.push_back(new XnatTest("xnat"));
         if (argc < 2)
         {
@@ -125,6 +160,7 @@ int main(int argc, char** argv)
             cout << "Total of " << failCount << " tests failed!" << endl;
             return 1;
         }
+        CommandOperationManager::deleteCommandOperationManager();
         SessionManager::deleteSessionManager();
         CaretHttpManager::deleteHttpManager();
         myApp.processEvents();
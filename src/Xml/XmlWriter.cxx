@@ -296,6 +296,31 @@ XmlWriter::writeElementNoSpace(const AString& localName, const AString& text) {
    this->writeTextToOutputStream("</" + localName + ">\n");
 }
 
+/**
+ * Write an element with no spacing between start and end tags, where
+ * the text is plain ASCII (such as Base64 encoded data).  The text is
+ * written without conversion, which matters for large data.
+ *
+ * @param localName - local name of tag to write.
+ * @param text - text to write.
+ * @param textLength - number of characters in the text.
+ * @throws XmlAttributes if an I/O error occurs.
+ */
+void
+XmlWriter::writeElementNoSpace(const AString& localName, const char* text, const int64_t textLength) {
+   this->writeIndentation();
+   this->writeTextToOutputStream("<" + localName + ">");
+   switch (this->outputStreamType) {
+       case OUTPUT_STREAM_Q_TEXT_STREAM:
+           *qTextStreamWriter << QString::fromLatin1(text, textLength);
+           break;
+       case OUTPUT_STREAM_STD_OUTPUT_STREAM:
+           stdOutputStreamWriter->write(text, textLength);
+           break;
+   }
+   this->writeTextToOutputStream("</" + localName + ">\n");
+}
+
 /**
  * Writes a start tag to the output.
  *
@@ -79,6 +79,9 @@ namespace caret {
                                const AString& text);
         
         void writeElementNoSpace(const AString& localName, const AString& text);
+        
+        void writeElementNoSpace(const AString& localName, const char* text, const int64_t textLength);
+        
         void writeStartElement(const AString& localName);
         
         void writeStartElement(const AString& localName,
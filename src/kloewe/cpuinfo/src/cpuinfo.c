@@ -43,6 +43,7 @@ typedef struct {                    /* --- processor ids --- */
   Global Variables
 ----------------------------------------------------------------------------*/
 static int cpuinfo[5];              /* cpu information */
+static int cpuinfo7[5];             /* extended features (leaf 7) */
 
 /*----------------------------------------------------------------------------
   Functions
@@ -326,6 +327,22 @@ int hasFMA3 (void)
 
 /*--------------------------------------------------------------------------*/
 
+int hasAVX2 (void)
+{                                   /* --- check for AVX2 instructions */
+  int regs[4];
+  if (!cpuinfo7[4]) {               /* leaf 7 must be supported */
+    cpuid(regs, 0);                 /* before it can be queried */
+    if (regs[0] >= 7) cpuid(cpuinfo7, 7);
+    cpuinfo7[4] = -1; }
+  return (cpuinfo7[1] & (1 <<  5)) != 0;
+}  /* hasAVX2() */
+
+/*----------------------------------------------------------------------------
+References (hasAVX2):
+  CPUID.(EAX=07H, ECX=0H):EBX.AVX2[bit 5]
+  en.wikipedia.org/wiki/CPUID#EAX=7,_ECX=0:_Extended_Features
+----------------------------------------------------------------------------*/
+
 void getVendorID (char *buf)
 {                                   /* --- get vendor id */
   /* the string is going to be exactly 12 characters long, allocate
@@ -362,6 +379,7 @@ int main (int argc, char* argv[])
   printf("POPCNT             %d\n", hasPOPCNT());
   printf("AVX                %d\n", hasAVX());
   printf("FMA3               %d\n", hasFMA3());
+  printf("AVX2               %d\n", hasAVX2());
 
 /* corecnt    -> number of processor cores
    proccnt    -> number of logical processors
@@ -33,6 +33,8 @@ typedef enum {
 typedef float  (sdot_func)  (const float  *a, const float  *b, int n);
 typedef double (ddot_func)  (const double *a, const double *b, int n);
 typedef double (sddot_func) (const float  *a, const float  *b, int n);
+typedef void   (sddotmat_func) (const float **a, int na, const float **b,
+                                int nb, int n, double *c, int ldc);
 
 /*----------------------------------------------------------------------------
   Global Variables
@@ -40,6 +42,7 @@ typedef double (sddot_func) (const float  *a, const float  *b, int n);
 extern sdot_func  *sdot_ptr;
 extern ddot_func  *ddot_ptr;
 extern sddot_func *sddot_ptr;
+extern sddotmat_func *sddotmat_ptr;
 
 /*----------------------------------------------------------------------------
   Function Prototypes
@@ -48,6 +51,19 @@ inline float  sdot         (const float  *a, const float  *b, int n);
 inline double ddot         (const double *a, const double *b, int n);
 inline double sddot        (const float  *a, const float  *b, int n);
 
+/* sddotmat
+ * --------
+ * matrix of dot products between two sets of vectors, with the same
+ * precision as sddot: c[i*ldc+j] = sddot(a[i], b[j], n)
+ *
+ * The vectors are given as arrays of pointers, so that they don't need to
+ * be copied into a contiguous matrix first.  Register blocking reuses each
+ * load for several products, which makes this much faster than calling
+ * sddot for every pair.
+ */
+inline void   sddotmat     (const float **a, int na, const float **b,
+                            int nb, int n, double *c, int ldc);
+
 /* dot_set_impl
  * ------------
  * specify the set of implementations that is used
@@ -73,24 +89,34 @@ extern dot_flags    dot_set_impl (dot_flags   impl);
 extern float  sdot_select  (const float  *a, const float  *b, int n);
 extern double ddot_select  (const double *a, const double *b, int n);
 extern double sddot_select (const float  *a, const float  *b, int n);
+extern void   sddotmat_select (const float **a, int na, const float **b,
+                               int nb, int n, double *c, int ldc);
 
 #ifndef DOT_NOFMA
 extern float  sdot_avxfma  (const float  *a, const float  *b, int n);
 extern double ddot_avxfma  (const double *a, const double *b, int n);
 extern double sddot_avxfma (const float  *a, const float  *b, int n);
+extern void   sddotmat_avxfma (const float **a, int na, const float **b,
+                               int nb, int n, double *c, int ldc);
 #endif
 
 extern float  sdot_avx     (const float  *a, const float  *b, int n);
 extern double ddot_avx     (const double *a, const double *b, int n);
 extern double sddot_avx    (const float  *a, const float  *b, int n);
+extern void   sddotmat_avx    (const float **a, int na, const float **b,
+                               int nb, int n, double *c, int ldc);
 
 extern float  sdot_sse2    (const float  *a, const float  *b, int n);
 extern double ddot_sse2    (const double *a, const double *b, int n);
 extern double sddot_sse2   (const float  *a, const float  *b, int n);
+extern void   sddotmat_sse2   (const float **a, int na, const float **b,
+                               int nb, int n, double *c, int ldc);
 
 extern float  sdot_naive   (const float  *a, const float  *b, int n);
 extern double ddot_naive   (const double *a, const double *b, int n);
 extern double sddot_naive  (const float  *a, const float  *b, int n);
+extern void   sddotmat_naive  (const float **a, int na, const float **b,
+                               int nb, int n, double *c, int ldc);
 
 /*----------------------------------------------------------------------------
   Inline Functions
@@ -108,6 +134,11 @@ inline double sddot (const float *a, const float *b, int n) {
   return (*sddot_ptr)(a,b,n);
 }
 
+inline void sddotmat (const float **a, int na, const float **b,
+                      int nb, int n, double *c, int ldc) {
+  (*sddotmat_ptr)(a,na,b,nb,n,c,ldc);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -12,8 +12,12 @@
 extern float  sdot_avxfma  (const float  *a, const float  *b, int n);
 extern double ddot_avxfma  (const double *a, const double *b, int n);
 extern double sddot_avxfma (const float  *a, const float  *b, int n);
+extern void   sddotmat_avxfma (const float **a, int na, const float **b,
+                               int nb, int n, double *c, int ldc);
 #else
 extern float  sdot_avx     (const float  *a, const float  *b, int n);
 extern double ddot_avx     (const double *a, const double *b, int n);
 extern double sddot_avx    (const float  *a, const float  *b, int n);
+extern void   sddotmat_avx    (const float **a, int na, const float **b,
+                               int nb, int n, double *c, int ldc);
 #endif
@@ -19,10 +19,14 @@
 inline float  sdot_avxfma  (const float  *a, const float  *b, int n);
 inline double ddot_avxfma  (const double *a, const double *b, int n);
 inline double sddot_avxfma (const float  *a, const float  *b, int n);
+inline void   sddotmat_avxfma (const float **a, int na, const float **b,
+                               int nb, int n, double *c, int ldc);
 #else
 inline float  sdot_avx     (const float  *a, const float  *b, int n);
 inline double ddot_avx     (const double *a, const double *b, int n);
 inline double sddot_avx    (const float  *a, const float  *b, int n);
+inline void   sddotmat_avx    (const float **a, int na, const float **b,
+                               int nb, int n, double *c, int ldc);
 #endif
 
 /*----------------------------------------------------------------------------
@@ -136,4 +140,95 @@ inline double sddot_avx    (const float *a, const float *b, int n)
   return s;
 }  // sddot_avx()
 
+/*--------------------------------------------------------------------------*/
+
+// --- horizontal sum of 4 doubles plus the remaining products,
+//     in the same order as sddot_avx(), so the results are identical
+static inline double sddot_tail_avx (__m256d s4, const float *a,
+                                     const float *b, int n)
+{
+  __m128d sh = _mm_add_pd(_mm256_extractf128_pd(s4, 0),
+                          _mm256_extractf128_pd(s4, 1));
+  sh = _mm_add_pd(sh, _mm_shuffle_pd(sh, sh, 1));
+  double s = _mm_cvtsd_f64(sh);
+  for (int k = 4*(n/4); k < n; k++)
+    s += a[k] * b[k];
+  return s;
+}  // sddot_tail_avx()
+
+/*--------------------------------------------------------------------------*/
+
+// --- accumulate one product of 4 floats into 4 double sums, same as sddot
+#ifdef __FMA__
+#define SDDOT_ACC_AVX(s, x, y) s = _mm256_fmadd_pd(x, y, s)
+#define SDDOT_LOAD_AVX(p) _mm256_cvtps_pd(_mm_loadu_ps(p))
+#define SDDOT_SINGLE_AVX sddot_avxfma
+#else
+#define SDDOT_ACC_AVX(s, x, y) \
+  s = _mm256_add_pd(_mm256_cvtps_pd(_mm_mul_ps(x, y)), s)
+#define SDDOT_LOAD_AVX(p) _mm_loadu_ps(p)
+#define SDDOT_SINGLE_AVX sddot_avx
+#endif
+
+// --- matrix of dot products: c[i*ldc+j] = sddot(a[i], b[j], n)
+// 2x4 register blocks, so that each load is used for 2 or 4 products,
+// which makes this compute bound rather than memory bound
+#ifdef __FMA__
+inline void sddotmat_avxfma (const float **a, int na, const float **b,
+                             int nb, int n, double *c, int ldc)
+#else
+inline void sddotmat_avx    (const float **a, int na, const float **b,
+                             int nb, int n, double *c, int ldc)
+#endif
+{
+  int i = 0, nq = 4*(n/4);
+  for ( ; i+2 <= na; i += 2) {
+    const float *a0 = a[i], *a1 = a[i+1];
+    int j = 0;
+    for ( ; j+4 <= nb; j += 4) {
+      const float *b0 = b[j], *b1 = b[j+1], *b2 = b[j+2], *b3 = b[j+3];
+      __m256d s00 = _mm256_setzero_pd(), s01 = _mm256_setzero_pd();
+      __m256d s02 = _mm256_setzero_pd(), s03 = _mm256_setzero_pd();
+      __m256d s10 = _mm256_setzero_pd(), s11 = _mm256_setzero_pd();
+      __m256d s12 = _mm256_setzero_pd(), s13 = _mm256_setzero_pd();
+      for (int k = 0; k < nq; k += 4) {
+        #ifdef __FMA__
+        __m256d x0 = SDDOT_LOAD_AVX(a0+k), x1 = SDDOT_LOAD_AVX(a1+k);
+        __m256d y;
+        #else
+        __m128  x0 = SDDOT_LOAD_AVX(a0+k), x1 = SDDOT_LOAD_AVX(a1+k);
+        __m128  y;
+        #endif
+        y = SDDOT_LOAD_AVX(b0+k);
+        SDDOT_ACC_AVX(s00, x0, y); SDDOT_ACC_AVX(s10, x1, y);
+        y = SDDOT_LOAD_AVX(b1+k);
+        SDDOT_ACC_AVX(s01, x0, y); SDDOT_ACC_AVX(s11, x1, y);
+        y = SDDOT_LOAD_AVX(b2+k);
+        SDDOT_ACC_AVX(s02, x0, y); SDDOT_ACC_AVX(s12, x1, y);
+        y = SDDOT_LOAD_AVX(b3+k);
+        SDDOT_ACC_AVX(s03, x0, y); SDDOT_ACC_AVX(s13, x1, y);
+      }
+      c[ i   *ldc+j  ] = sddot_tail_avx(s00, a0, b0, n);
+      c[ i   *ldc+j+1] = sddot_tail_avx(s01, a0, b1, n);
+      c[ i   *ldc+j+2] = sddot_tail_avx(s02, a0, b2, n);
+      c[ i   *ldc+j+3] = sddot_tail_avx(s03, a0, b3, n);
+      c[(i+1)*ldc+j  ] = sddot_tail_avx(s10, a1, b0, n);
+      c[(i+1)*ldc+j+1] = sddot_tail_avx(s11, a1, b1, n);
+      c[(i+1)*ldc+j+2] = sddot_tail_avx(s12, a1, b2, n);
+      c[(i+1)*ldc+j+3] = sddot_tail_avx(s13, a1, b3, n);
+    }
+    for ( ; j < nb; j++) {      // remaining columns of the block row
+      c[ i   *ldc+j] = SDDOT_SINGLE_AVX(a0, b[j], n);
+      c[(i+1)*ldc+j] = SDDOT_SINGLE_AVX(a1, b[j], n);
+    }
+  }
+  for ( ; i < na; i++)          // remaining row
+    for (int j = 0; j < nb; j++)
+      c[i*ldc+j] = SDDOT_SINGLE_AVX(a[i], b[j], n);
+}  // sddotmat_avx()
+
+#undef SDDOT_ACC_AVX
+#undef SDDOT_LOAD_AVX
+#undef SDDOT_SINGLE_AVX
+
 #endif // DOT_AVX_H
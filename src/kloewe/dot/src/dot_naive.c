@@ -11,3 +11,5 @@
 extern float  sdot_naive  (const float  *a, const float  *b, int n);
 extern double ddot_naive  (const double *a, const double *b, int n);
 extern double sddot_naive (const float  *a, const float  *b, int n);
+extern void   sddotmat_naive (const float **a, int na, const float **b,
+                              int nb, int n, double *c, int ldc);
@@ -12,6 +12,8 @@
 inline float  sdot_naive  (const float  *a, const float  *b, int n);
 inline double ddot_naive  (const double *a, const double *b, int n);
 inline double sddot_naive (const float  *a, const float  *b, int n);
+inline void   sddotmat_naive (const float **a, int na, const float **b,
+                              int nb, int n, double *c, int ldc);
 
 /*----------------------------------------------------------------------------
   Inline Functions
@@ -60,4 +62,15 @@ inline double sddot_naive (const float *a, const float *b, int n)
   return sum;
 }  // sddot_naive()
 
+/*--------------------------------------------------------------------------*/
+
+// --- matrix of dot products: c[i*ldc+j] = sddot(a[i], b[j], n)
+inline void sddotmat_naive (const float **a, int na, const float **b,
+                            int nb, int n, double *c, int ldc)
+{
+  for (int i = 0; i < na; i++)
+    for (int j = 0; j < nb; j++)
+      c[i*ldc+j] = sddot_naive(a[i], b[j], n);
+}  // sddotmat_naive()
+
 #endif // DOT_NAIVE_H
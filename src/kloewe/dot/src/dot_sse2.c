@@ -11,3 +11,5 @@
 extern float  sdot_sse2  (const float  *a, const float  *b, int n);
 extern double ddot_sse2  (const double *a, const double *b, int n);
 extern double sddot_sse2 (const float  *a, const float  *b, int n);
+extern void   sddotmat_sse2 (const float **a, int na, const float **b,
+                             int nb, int n, double *c, int ldc);
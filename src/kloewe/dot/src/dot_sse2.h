@@ -39,6 +39,8 @@
 inline float  sdot_sse2  (const float  *a, const float  *b, int n);
 inline double ddot_sse2  (const double *a, const double *b, int n);
 inline double sddot_sse2 (const float  *a, const float  *b, int n);
+inline void   sddotmat_sse2 (const float **a, int na, const float **b,
+                             int nb, int n, double *c, int ldc);
 
 /*----------------------------------------------------------------------------
   Inline Functions
@@ -188,4 +190,85 @@ inline double sddot_sse2 (const float *a, const float *b, int n)
   return s;
 }  // sddot_sse2()
 
+/*--------------------------------------------------------------------------*/
+
+// --- horizontal sum of the two pairs of sums plus the remaining products,
+//     in the same order as the aligned path of sddot_sse2(), so the results
+//     are identical
+static inline double sddot_tail_sse2 (__m128d s2, __m128d s2u,
+                                      const float *a, const float *b, int n)
+{
+  double s = 0.0;
+  s2 = _mm_add_pd(s2, s2u);
+  #ifdef HORZSUM_SSE3
+  s2 = _mm_hadd_pd(s2, s2);
+  #else
+  s2 = _mm_add_pd(s2, _mm_shuffle_pd(s2, s2, 1));
+  #endif
+  s += _mm_cvtsd_f64(s2);
+  for (int k = 4*(n/4); k < n; k++)
+    s += a[k] * b[k];
+  return s;
+}  // sddot_tail_sse2()
+
+/*--------------------------------------------------------------------------*/
+
+// --- accumulate the products of 4 floats into the lower and upper sums
+#define SDDOT_ACC_SSE2(s, su, p) \
+  s  = _mm_add_pd(s,  _mm_cvtps_pd(p)); \
+  su = _mm_add_pd(su, _mm_cvtps_pd(_mm_movehl_ps(p, p)))
+
+// --- matrix of dot products: c[i*ldc+j] = sddot(a[i], b[j], n)
+// 2x2 register blocks, so that each load is used for two products; sddot_sse2
+// handles unaligned input with a scalar prefix, so blocks that contain an
+// unaligned vector fall back to it to keep the results identical
+inline void sddotmat_sse2 (const float **a, int na, const float **b,
+                           int nb, int n, double *c, int ldc)
+{
+  int i = 0, nq = 4*(n/4);
+  for ( ; i+2 <= na; i += 2) {
+    const float *a0 = a[i], *a1 = a[i+1];
+    int aligned = is_aligned(a0, 16) && is_aligned(a1, 16);
+    int j = 0;
+    for ( ; j+2 <= nb; j += 2) {
+      const float *b0 = b[j], *b1 = b[j+1];
+      if (!aligned || !is_aligned(b0, 16) || !is_aligned(b1, 16)) {
+        c[ i   *ldc+j  ] = sddot_sse2(a0, b0, n);
+        c[ i   *ldc+j+1] = sddot_sse2(a0, b1, n);
+        c[(i+1)*ldc+j  ] = sddot_sse2(a1, b0, n);
+        c[(i+1)*ldc+j+1] = sddot_sse2(a1, b1, n);
+        continue;
+      }
+      __m128d s00 = _mm_setzero_pd(), s00u = _mm_setzero_pd();
+      __m128d s01 = _mm_setzero_pd(), s01u = _mm_setzero_pd();
+      __m128d s10 = _mm_setzero_pd(), s10u = _mm_setzero_pd();
+      __m128d s11 = _mm_setzero_pd(), s11u = _mm_setzero_pd();
+      for (int k = 0; k < nq; k += 4) {
+        __m128 x0 = _mm_load_ps(a0+k), x1 = _mm_load_ps(a1+k);
+        __m128 y0 = _mm_load_ps(b0+k), y1 = _mm_load_ps(b1+k);
+        __m128 p00 = _mm_mul_ps(x0, y0), p01 = _mm_mul_ps(x0, y1);
+        __m128 p10 = _mm_mul_ps(x1, y0), p11 = _mm_mul_ps(x1, y1);
+        // note that _mm_cvtps_pd() converts *the lower two* SPFP values
+        SDDOT_ACC_SSE2(s00, s00u, p00);
+        SDDOT_ACC_SSE2(s01, s01u, p01);
+        SDDOT_ACC_SSE2(s10, s10u, p10);
+        SDDOT_ACC_SSE2(s11, s11u, p11);
+      }
+      c[ i   *ldc+j  ] = sddot_tail_sse2(s00, s00u, a0, b0, n);
+      c[ i   *ldc+j+1] = sddot_tail_sse2(s01, s01u, a0, b1, n);
+      c[(i+1)*ldc+j  ] = sddot_tail_sse2(s10, s10u, a1, b0, n);
+      c[(i+1)*ldc+j+1] = sddot_tail_sse2(s11, s11u, a1, b1, n);
+    }
+    for ( ; j < nb; j++) {      // remaining column of the block row
+      c[ i   *ldc+j] = sddot_sse2(a0, b[j], n);
+      c[(i+1)*ldc+j] = sddot_sse2(a1, b[j], n);
+    }
+  }
+  for ( ; i < na; i++)          // remaining row
+    for (int j = 0; j < nb; j++)
+      c[i*ldc+j] = sddot_sse2(a[i], b[j], n);
+}  // sddotmat_sse2()
+
+#undef SDDOT_ACC_SSE2
+
 #endif // DOT_SSE2_H